@@ -0,0 +1,110 @@
+// ChecksumBench.cpp — пропускная способность реализаций Checksum::Sum на типичных длинах пакетов.
+//
+// Запуск: ChecksumBench [МиБ на замер (1024)]
+
+#include "Core/Checksum.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Длины: заголовки, мелкие пакеты, MTU, jumbo, GSO-суперпакет.
+    constexpr std::size_t kLengths[] = {40, 64, 576, 1500, 9000, 65536};
+
+    /**
+     * @brief Гбит/с суммы на буферах длины len; начало сдвигается на 0..7 байт — разные выравнивания.
+     */
+    template <typename F>
+    double Measure(F &&sum, const std::vector<std::uint8_t> &buf, std::size_t len, std::size_t bytes)
+    {
+        const std::size_t iterations = bytes / len + 1;
+        std::uint32_t sink = 0;
+        const auto t0 = Clock::now();
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+            sink += sum(buf.data() + (i & 7), len);
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+        // Результат должен где-то использоваться, иначе компилятор выбросит цикл.
+        if (sink == 0x5A5A5A5Au)
+        {
+            std::puts("");
+        }
+        return static_cast<double>(iterations * len) * 8.0 / seconds / 1e9;
+    }
+
+    void Row(const char *name, const std::vector<double> &gbps)
+    {
+        std::printf("%-10s", name);
+        for (const double g : gbps)
+        {
+            std::printf(" %9.1f", g);
+        }
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const std::size_t mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    if (mib == 0)
+    {
+        std::fprintf(stderr, "usage: ChecksumBench [MiB per measurement]\n");
+        return EXIT_FAILURE;
+    }
+    const std::size_t bytes = mib << 20;
+
+    std::mt19937_64 rng(1);
+    std::vector<std::uint8_t> buf(65536 + 8);
+    for (std::uint8_t &b : buf)
+    {
+        b = static_cast<std::uint8_t>(rng());
+    }
+
+    std::printf("Gbit/s by length (Sum uses %s)\n%-10s", Checksum::Backend(), "");
+    for (const std::size_t len : kLengths)
+    {
+        std::printf(" %9zu", len);
+    }
+    std::printf("\n");
+
+    std::vector<double> gbps;
+    for (const char *name : {"scalar", "sse2", "avx2", "neon"})
+    {
+        const Checksum::SumFn sum = Checksum::Implementation(name);
+        if (!sum)
+        {
+            continue;
+        }
+        gbps.clear();
+        for (const std::size_t len : kLengths)
+        {
+            gbps.push_back(Measure(sum, buf, len, bytes));
+        }
+        Row(name, gbps);
+    }
+
+    gbps.clear();
+    for (const std::size_t len : kLengths)
+    {
+        gbps.push_back(Measure([](const std::uint8_t *p, std::size_t n) { return Checksum::Sum(p, n); }, buf, len, bytes));
+    }
+    Row("Sum", gbps);
+
+    gbps.clear();
+    for (const std::size_t len : kLengths)
+    {
+        gbps.push_back(Measure([](const std::uint8_t *p, std::size_t n) { return Checksum::Reference(p, n); }, buf, len,
+                               bytes / 8));
+    }
+    Row("Reference", gbps);
+    return EXIT_SUCCESS;
+}
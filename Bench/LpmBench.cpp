@@ -0,0 +1,186 @@
+// LpmBench.cpp — скорость поиска Lpm на таблице в миллион префиксов: поштучно и пачками PacketMeta.
+//
+// Запуск: LpmBench [префиксов (1000000)] [повторов (3)]
+
+#include "Core/Lpm.hpp"
+#include "Core/PacketMeta.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Пакетов в прогоне: больше кэшей, как на реальном трафике.
+    constexpr std::size_t kPackets = std::size_t{1} << 20;
+
+    /// @brief Пакет в буфере: заголовок IP и начало UDP.
+    constexpr std::size_t kSlot = 64;
+
+    double NsPer(Clock::time_point from, Clock::time_point to, std::size_t n)
+    {
+        return std::chrono::duration<double, std::nano>(to - from).count() / static_cast<double>(n);
+    }
+
+    /**
+     * @brief Таблица, похожая на полную таблицу BGP.
+     *
+     * IPv4: 60% /24, остальное /16–/23; IPv6: половина /48, остальное /32–/47 внутри 2000::/3.
+     */
+    std::vector<Lpm::Route> MakeRoutes(bool v6, std::size_t count, std::mt19937_64 &rng)
+    {
+        std::vector<Lpm::Route> routes(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Lpm::Route &r = routes[i];
+            std::uint8_t *a = r.prefix.addr.data();
+            if (v6)
+            {
+                const std::uint64_t hi = std::uint64_t{2} << 60 | rng() >> 4;
+                for (std::size_t k = 0; k < 8; ++k)
+                {
+                    a[k] = static_cast<std::uint8_t>(hi >> (56 - 8 * k));
+                }
+                r.prefix.len = i % 2 != 0 ? 48 : 32 + static_cast<unsigned>(rng() % 16);
+            }
+            else
+            {
+                const auto v4 = static_cast<std::uint32_t>(rng());
+                a[10] = 0xFF;
+                a[11] = 0xFF;
+                for (std::size_t k = 0; k < 4; ++k)
+                {
+                    a[12 + k] = static_cast<std::uint8_t>(v4 >> (24 - 8 * k));
+                }
+                r.prefix.len = 96 + (i % 10 < 6 ? 24 : 16 + static_cast<unsigned>(rng() % 8));
+            }
+            r.target = static_cast<unsigned>(i % Lpm::kMaxTarget);
+        }
+        return routes;
+    }
+
+    /// @brief UDP-пакеты на случайные адреса внутри случайных префиксов таблицы.
+    void MakePackets(bool v6, const std::vector<Lpm::Route> &routes, std::mt19937_64 &rng,
+                     std::vector<std::uint8_t> &buf, std::vector<const std::uint8_t *> &pkts,
+                     std::vector<std::size_t> &lens)
+    {
+        buf.assign(kPackets * kSlot, 0);
+        pkts.resize(kPackets);
+        lens.resize(kPackets);
+        for (std::size_t i = 0; i < kPackets; ++i)
+        {
+            std::uint8_t *p = &buf[i * kSlot];
+            const std::uint8_t *a = routes[rng() % routes.size()].prefix.addr.data();
+            pkts[i] = p;
+            if (v6)
+            {
+                p[0] = 0x60;
+                p[5] = 8;
+                p[6] = 17;
+                std::memcpy(p + 24, a, 16);
+                for (std::size_t k = 6; k < 16; ++k)
+                {
+                    p[24 + k] = static_cast<std::uint8_t>(rng());
+                }
+                lens[i] = 48;
+            }
+            else
+            {
+                p[0] = 0x45;
+                p[3] = 28;
+                p[9] = 17;
+                std::memcpy(p + 16, a + 12, 4);
+                p[19] = static_cast<std::uint8_t>(rng());
+                lens[i] = 28;
+            }
+        }
+    }
+
+    void Run(bool v6, std::size_t prefixes, unsigned rounds)
+    {
+        std::mt19937_64 rng(v6 ? 6 : 4);
+        const std::vector<Lpm::Route> routes = MakeRoutes(v6, prefixes, rng);
+
+        const auto t0 = Clock::now();
+        const Lpm lpm(routes);
+        const auto t1 = Clock::now();
+        std::printf("IPv%d: %zu prefixes, build %.0f ms, %.1f MiB\n", v6 ? 6 : 4, lpm.Size(),
+                    std::chrono::duration<double, std::milli>(t1 - t0).count(),
+                    static_cast<double>(lpm.MemoryBytes()) / (1024.0 * 1024.0));
+
+        std::vector<std::uint8_t>         buf;
+        std::vector<const std::uint8_t *> pkts;
+        std::vector<std::size_t>          lens;
+        MakePackets(v6, routes, rng, buf, pkts, lens);
+
+        const std::size_t batch = PacketMeta::kDefaultCapacity;
+        PacketMeta meta(batch);
+        std::vector<unsigned> out(batch);
+        unsigned sink = 0;
+        for (unsigned round = 0; round < rounds; ++round)
+        {
+            // Разбор пачки — общий для всех потребителей PacketMeta: из цены поиска он вычитается.
+            auto a = Clock::now();
+            for (std::size_t o = 0; o < kPackets; o += batch)
+            {
+                meta.Parse(&pkts[o], &lens[o], batch);
+            }
+            auto b = Clock::now();
+            const double parse = NsPer(a, b, kPackets);
+
+            a = Clock::now();
+            for (std::size_t o = 0; o < kPackets; o += batch)
+            {
+                meta.Parse(&pkts[o], &lens[o], batch);
+                for (std::size_t j = 0; j < batch; ++j)
+                {
+                    sink += lpm.Lookup(meta, j, 0);
+                }
+            }
+            b = Clock::now();
+            const double single = NsPer(a, b, kPackets) - parse;
+
+            a = Clock::now();
+            for (std::size_t o = 0; o < kPackets; o += batch)
+            {
+                meta.Parse(&pkts[o], &lens[o], batch);
+                lpm.LookupBatch(meta, 0, out.data());
+                for (std::size_t j = 0; j < batch; ++j)
+                {
+                    sink += out[j];
+                }
+            }
+            b = Clock::now();
+            const double batched = NsPer(a, b, kPackets) - parse;
+
+            std::printf("  round %u: parse %.1f ns/pkt; lookup %.1f ns (%.1f M/s); batch %.1f ns (%.1f M/s)\n",
+                        round + 1, parse, single, 1e3 / single, batched, 1e3 / batched);
+        }
+        // Результат поиска должен где-то использоваться, иначе компилятор выбросит цикл.
+        if (sink == 0x5A5A5A5Au)
+        {
+            std::puts("");
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const std::size_t prefixes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const unsigned    rounds   = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : 3;
+    if (prefixes == 0 || rounds == 0)
+    {
+        std::fprintf(stderr, "usage: LpmBench [prefixes] [rounds]\n");
+        return EXIT_FAILURE;
+    }
+    Run(false, prefixes, rounds);
+    Run(true, prefixes, rounds);
+    return EXIT_SUCCESS;
+}
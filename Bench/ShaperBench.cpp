@@ -0,0 +1,197 @@
+// ShaperBench.cpp — точность и цена Shaper на синтетическом трафике в виртуальном времени.
+//
+// Запуск: ShaperBench [секунд виртуального времени (20)]
+//
+// Корень 50 Мбит/с, четыре класса; источники перегружают bulk, backup и capped:
+//   interactive  rate 10, ceil 50, prio 0  — 2 Мбит/с по 200 байт: уходит всё, задержка — доли мс;
+//   bulk         rate 20, ceil 50          — 60 Мбит/с: своя rate и половина остатка;
+//   backup       rate 5,  ceil 20          — 60 Мбит/с на порт 443: своя rate и половина остатка;
+//   capped       rate 1,  ceil 10, 1 Мбит/с на поток — три потока по 5 Мбит/с в 8.0.0.0/8:9000–9002.
+// Остаток 50 - 2 - 3 - 20 - 5 = 20 Мбит/с bulk и backup (один prio, равные пакеты) делят поровну.
+
+#include "Core/Shaper.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    using namespace std::chrono_literals;
+
+    /// @brief Шаг виртуальных часов.
+    constexpr auto kStep = 50us;
+
+    /// @brief Классы сценария в порядке Options::classes.
+    enum Class : std::size_t
+    {
+        kInteractive,
+        kBulk,
+        kBackup,
+        kCapped,
+        kClasses
+    };
+
+    constexpr const char *kNames[kClasses]    = {"interactive", "bulk", "backup", "capped"};
+    constexpr double      kExpected[kClasses] = {2.0, 30.0, 15.0, 3.0};   ///< Мбит/с.
+
+    /// @brief TCP/IPv4 от 10.0.0.src к 8.0.0.8 (порт назначения — признак класса при выдаче).
+    void MakePacket(std::uint8_t *p, std::size_t len, std::uint8_t src, std::uint16_t sport, std::uint16_t dport)
+    {
+        std::memset(p, 0, len);
+        p[0]  = 0x45;
+        p[2]  = static_cast<std::uint8_t>(len >> 8);
+        p[3]  = static_cast<std::uint8_t>(len);
+        p[9]  = 6;
+        p[12] = 10;
+        p[15] = src;
+        p[16] = 8;
+        p[19] = 8;
+        p[20] = static_cast<std::uint8_t>(sport >> 8);
+        p[21] = static_cast<std::uint8_t>(sport);
+        p[22] = static_cast<std::uint8_t>(dport >> 8);
+        p[23] = static_cast<std::uint8_t>(dport);
+    }
+
+    Shaper::Options MakeOptions()
+    {
+        Shaper::Options o;
+        o.rate_kbps      = 50000;
+        o.leaf.seed      = 1;
+        o.leaf.slot_size = 1500;
+        o.classes.push_back({"interactive", -1, 10000, 50000, 0, 0, 256});
+        o.classes.push_back({"bulk", -1, 20000, 50000, 4, 0, 256});
+        o.classes.push_back({"backup", -1, 5000, 20000, 4, 0, 256});
+        o.classes.push_back({"capped", -1, 1000, 10000, 4, 1000, 256});
+
+        Classifier::Rule backup;
+        backup.proto    = 6;
+        backup.dport_lo = backup.dport_hi = 443;
+        backup.target   = kBackup;
+        o.rules.push_back(backup);
+
+        Classifier::Rule interactive;
+        interactive.dport_lo = interactive.dport_hi = 3389;
+        interactive.target   = kInteractive;
+        o.rules.push_back(interactive);
+
+        Classifier::Rule capped;
+        Classifier::ParsePrefix("8.0.0.0/8", &capped.dst);
+        capped.dport_lo = 9000;
+        capped.dport_hi = 9010;
+        capped.target   = kCapped;
+        o.rules.push_back(capped);
+
+        o.default_class = kBulk;
+        return o;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const long seconds = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 20;
+    if (seconds <= 0)
+    {
+        std::fprintf(stderr, "usage: ShaperBench [virtual seconds]\n");
+        return EXIT_FAILURE;
+    }
+
+    Shaper shaper(MakeOptions());
+    const auto start = Shaper::Clock::time_point{} + 1s;
+    const auto end   = start + std::chrono::seconds(seconds);
+
+    std::uint8_t  pkt[1500];
+    std::uint8_t  out[1500];
+    std::uint64_t bytes[kClasses] = {};
+    std::uint64_t flow_bytes[3]   = {};
+    double        max_delay_ms    = 0;
+    std::uint64_t ops             = 0;
+    std::chrono::nanoseconds spent{0};
+
+    std::uint64_t tick = 0;
+    for (auto now = start; now < end; now += kStep, ++tick)
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        // bulk и backup: 1500 байт раз в 200 мкс (60 Мбит/с); interactive: 200 байт раз в 800 мкс;
+        // capped: три потока по 1500 байт раз в 2.4 мс (5 Мбит/с).
+        if (tick % 4 == 0)
+        {
+            MakePacket(pkt, 1500, 1, 1000, 80);
+            shaper.Enqueue(pkt, 1500, now);
+            MakePacket(pkt, 1500, 1, 1001, 443);
+            shaper.Enqueue(pkt, 1500, now);
+            ops += 2;
+        }
+        if (tick % 16 == 0)
+        {
+            // Время постановки — в нагрузке: по нему при выдаче считается задержка.
+            MakePacket(pkt, 200, 2, 5000, 3389);
+            std::memcpy(pkt + 40, &now, sizeof now);
+            shaper.Enqueue(pkt, 200, now);
+            ++ops;
+        }
+        if (tick % 48 == 0)
+        {
+            for (std::uint16_t f = 0; f < 3; ++f)
+            {
+                MakePacket(pkt, 1500, 3, 7000, static_cast<std::uint16_t>(9000 + f));
+                shaper.Enqueue(pkt, 1500, now);
+                ++ops;
+            }
+        }
+        while (const std::size_t n = shaper.Dequeue(out, sizeof out, now))
+        {
+            ++ops;
+            const auto dport = static_cast<std::uint16_t>(out[22] << 8 | out[23]);
+            if (dport == 3389)
+            {
+                bytes[kInteractive] += n;
+                Shaper::Clock::time_point at;
+                std::memcpy(&at, out + 40, sizeof at);
+                max_delay_ms = std::max(max_delay_ms, std::chrono::duration<double, std::milli>(now - at).count());
+            }
+            else if (dport == 80)
+            {
+                bytes[kBulk] += n;
+            }
+            else if (dport == 443)
+            {
+                bytes[kBackup] += n;
+            }
+            else
+            {
+                bytes[kCapped] += n;
+                flow_bytes[dport - 9000] += n;
+            }
+        }
+        spent += std::chrono::steady_clock::now() - t0;
+    }
+
+    const auto mbps = [seconds](std::uint64_t b) { return static_cast<double>(b) * 8.0 / (static_cast<double>(seconds) * 1e6); };
+    std::printf("%-12s %9s %9s %7s %9s %7s\n", "class", "expected", "measured", "error", "borrowed", "drops");
+    double total = 0;
+    double worst = 0;
+    for (std::size_t i = 0; i < kClasses; ++i)
+    {
+        Shaper::ClassStats cs;
+        shaper.GetClassStats(i, &cs);
+        const double got   = mbps(bytes[i]);
+        const double error = 100.0 * (got - kExpected[i]) / kExpected[i];
+        total += got;
+        worst = std::max(worst, std::fabs(error));
+        std::printf("%-12s %9.2f %9.2f %6.2f%% %9llu %7llu\n", kNames[i], kExpected[i], got, error,
+                    static_cast<unsigned long long>(cs.borrowed), static_cast<unsigned long long>(cs.drops));
+    }
+    std::printf("total %.2f Mbit/s of 50; worst class error %.2f%%\n", total, worst);
+    std::printf("interactive max delay %.2f ms; capped flows %.2f %.2f %.2f Mbit/s (limit 1)\n", max_delay_ms,
+                mbps(flow_bytes[0]), mbps(flow_bytes[1]), mbps(flow_bytes[2]));
+    std::printf("cost %.0f ns per Enqueue/Dequeue (%llu calls, %lld s virtual in %.2f s)\n",
+                static_cast<double>(spent.count()) / static_cast<double>(ops), static_cast<unsigned long long>(ops),
+                static_cast<long long>(seconds), std::chrono::duration<double>(spent).count());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+// Aggregator.cpp — реализация сборщика кадров Bundle.
+
+#include "Aggregator.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    /// @brief Кратчайший IPv4-пакет: если и он не помещается, кадр закрывается сразу.
+    constexpr std::size_t kMinItem = 20;
+
+    /// @brief Нагрузка кадра ограничена полем длины BE16.
+    constexpr std::size_t kMaxFrame = CoreFrame::kHeaderSize + 0xFFFF;
+}
+
+Aggregator::Aggregator(const Options &opts)
+    : opts_(opts)
+    , slot_size_(std::max(opts.mtu, opts.max_packet))
+{
+    if (opts.max_item == 0 || opts.max_packet < opts.max_item || opts.mtu > kMaxFrame ||
+        CoreFrame::kHeaderSize + 2 * (kItemHeaderSize + opts.max_item) > opts.mtu ||
+        opts.max_delay.count() < 0)
+    {
+        throw std::invalid_argument("Aggregator: invalid options");
+    }
+    open_.resize(opts.mtu);
+    ready_.resize(kReady * slot_size_);
+}
+
+std::uint8_t *Aggregator::ReadySlot(std::uint64_t tag,
+                                    std::size_t len) noexcept
+{
+    const unsigned i = (ready_head_ + ready_count_) % kReady;
+    ready_len_[i] = len;
+    ready_tag_[i] = tag;
+    ++ready_count_;
+    return ready_.data() + i * slot_size_;
+}
+
+void Aggregator::Seal() noexcept
+{
+    if (open_count_ == 0)
+    {
+        return;
+    }
+    if (open_count_ == 1)
+    {
+        // Попутчиков не нашлось: пакет уходит как есть, без заголовков кадра.
+        const std::size_t len = open_len_ - CoreFrame::kHeaderSize - kItemHeaderSize;
+        std::memcpy(ReadySlot(open_tag_, len), open_.data() + CoreFrame::kHeaderSize + kItemHeaderSize, len);
+        ++stats_.singles;
+    }
+    else
+    {
+        CoreFrame::BuildHeader(CoreFrame::Type::Bundle, open_len_ - CoreFrame::kHeaderSize, open_.data());
+        std::memcpy(ReadySlot(open_tag_, open_len_), open_.data(), open_len_);
+        ++stats_.bundles;
+        stats_.bundled += open_count_;
+    }
+    open_count_ = 0;
+    open_len_   = 0;
+}
+
+bool Aggregator::Offer(const std::uint8_t *pkt,
+                       std::size_t len,
+                       Clock::time_point now,
+                       std::uint64_t tag) noexcept
+{
+    ++stats_.packets;
+    const bool fits = len != 0 && len <= opts_.max_item;
+    // Готовые кадры не вынуты (нарушен порядок вызовов) или пакет длиннее буфера — не задерживать.
+    if (ready_count_ != 0 || len == 0 || len > opts_.max_packet)
+    {
+        ++stats_.passthrough;
+        ++stats_.frames;
+        return false;
+    }
+
+    if (open_count_ != 0 &&
+        (tag != open_tag_ || !fits || open_len_ + kItemHeaderSize + len > opts_.mtu))
+    {
+        const bool same = tag == open_tag_;
+        Seal();
+        if (!fits && same)
+        {
+            // Крупный пакет не обгоняет задержанные мелкие той же метки.
+            std::memcpy(ReadySlot(tag, len), pkt, len);
+            ++stats_.passthrough;
+            return true;
+        }
+    }
+    if (!fits)
+    {
+        ++stats_.passthrough;
+        ++stats_.frames;
+        return false;
+    }
+
+    if (open_count_ == 0)
+    {
+        open_len_ = CoreFrame::kHeaderSize;
+        open_tag_ = tag;
+        deadline_ = now + opts_.max_delay;
+    }
+    std::uint8_t *p = open_.data() + open_len_;
+    p[0] = static_cast<std::uint8_t>(len >> 8);
+    p[1] = static_cast<std::uint8_t>(len);
+    std::memcpy(p + kItemHeaderSize, pkt, len);
+    open_len_ += kItemHeaderSize + len;
+    ++open_count_;
+
+    if (open_len_ + kItemHeaderSize + kMinItem > opts_.mtu)
+    {
+        Seal();
+    }
+    return true;
+}
+
+std::size_t Aggregator::PopReady(std::uint8_t *out,
+                                 std::size_t size,
+                                 std::uint64_t *tag) noexcept
+{
+    if (ready_count_ == 0 || ready_len_[ready_head_] > size)
+    {
+        return 0;
+    }
+    const std::size_t len = ready_len_[ready_head_];
+    std::memcpy(out, ready_.data() + ready_head_ * slot_size_, len);
+    if (tag != nullptr)
+    {
+        *tag = ready_tag_[ready_head_];
+    }
+    ready_head_ = (ready_head_ + 1) % kReady;
+    --ready_count_;
+    ++stats_.frames;
+    return len;
+}
+
+std::size_t Aggregator::Poll(std::uint8_t *out,
+                             std::size_t size,
+                             Clock::time_point now,
+                             std::uint64_t *tag) noexcept
+{
+    if (ready_count_ == 0 && open_count_ != 0 && now >= deadline_)
+    {
+        Seal();
+        ++stats_.expired;
+    }
+    return PopReady(out, size, tag);
+}
+
+std::size_t Aggregator::Flush(std::uint8_t *out,
+                              std::size_t size,
+                              std::uint64_t *tag) noexcept
+{
+    if (ready_count_ == 0)
+    {
+        Seal();
+    }
+    return PopReady(out, size, tag);
+}
+
+void Aggregator::Reset() noexcept
+{
+    open_count_  = 0;
+    open_len_    = 0;
+    ready_head_  = 0;
+    ready_count_ = 0;
+}
+
+std::size_t Aggregator::Validate(const std::uint8_t *payload,
+                                 std::size_t len) noexcept
+{
+    std::size_t count = 0;
+    for (std::size_t off = 0; off < len;)
+    {
+        if (len - off < kItemHeaderSize)
+        {
+            return 0;
+        }
+        const std::size_t item = (static_cast<std::size_t>(payload[off]) << 8) | payload[off + 1];
+        off += kItemHeaderSize;
+        if (item == 0 || item > len - off)
+        {
+            return 0;
+        }
+        const std::uint8_t *p = payload + off;
+        if (CoreFrame::IsCoreFrame(p, item) && p[1] == static_cast<std::uint8_t>(CoreFrame::Type::Bundle))
+        {
+            return 0;
+        }
+        off += item;
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,176 @@
+#pragma once
+// Aggregator.hpp — сборка мелких пакетов туннеля в кадры Bundle и разбор таких кадров.
+
+#include "CoreFrame.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Формат кадра CoreFrame::Type::Bundle (нагрузка):
+ *   [длина BE16][пакет][длина BE16][пакет]...
+ * Пакет — IP-пакет или служебный кадр, кроме самого Bundle; длина не нулевая.
+ */
+
+/**
+ * @brief Сборщик мелких пакетов в кадры Bundle отправителя.
+ *
+ * На ACK-нагруженном трафике туннель несёт поток пакетов по 40–80 байт, и
+ * каждый стоит транспорту отдельного кадра: заголовков, шифрования, системного
+ * вызова. Сборщик держит открытый кадр: мелкий пакет (не длиннее max_item)
+ * дописывается в него, кадр уходит, когда следующий не помещается в mtu,
+ * когда приходит крупный пакет (порядок сохраняется) или когда первый пакет
+ * кадра ждёт дольше max_delay. Кадр с единственным пакетом уходит самим
+ * пакетом — на редком трафике накладных расходов нет, только задержка.
+ *
+ * Метка (tag) разделяет адресатов: пакеты с разными метками в один кадр не
+ * попадают (у сервера метка — сессия).
+ *
+ * Порядок вызовов: Poll, пока он отдаёт кадры, затем Offer следующего пакета.
+ * Срок max_delay проверяется в Poll, поэтому его точность — частота опроса.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class Aggregator
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Накладные расходы пакета в кадре: длина BE16.
+    static constexpr std::size_t kItemHeaderSize = 2;
+
+    /**
+     * @brief Параметры сборщика.
+     */
+    struct Options
+    {
+        /// @brief Наибольший кадр Bundle вместе с заголовком.
+        std::size_t mtu = 1500;
+        /// @brief Наибольший пакет, предъявляемый Offer (размер буфера отложенной копии).
+        std::size_t max_packet = 1500;
+        /// @brief Пакеты не длиннее — собираются в кадры.
+        std::size_t max_item = 256;
+        /// @brief Сколько первый пакет кадра может ждать попутчиков (0 — уходит с ближайшим Poll).
+        std::chrono::microseconds max_delay{500};
+    };
+
+    /**
+     * @brief Счётчики сборщика.
+     */
+    struct Stats
+    {
+        std::uint64_t packets     = 0;   ///< Пакетов предъявлено.
+        std::uint64_t bundled     = 0;   ///< Пакетов отправлено в кадрах Bundle.
+        std::uint64_t bundles     = 0;   ///< Кадров Bundle отправлено.
+        std::uint64_t singles     = 0;   ///< Кадров из одного пакета, отправленных самим пакетом.
+        std::uint64_t passthrough = 0;   ///< Пакетов, не задержанных сборщиком.
+        std::uint64_t frames      = 0;   ///< Всего кадров на выходе (с учётом passthrough).
+        std::uint64_t expired     = 0;   ///< Кадров, закрытых по max_delay.
+    };
+
+    /**
+     * @brief Создать сборщик (вся память выделяется здесь).
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    explicit Aggregator(const Options &opts);
+
+    Aggregator(const Aggregator &) = delete;
+    Aggregator &operator=(const Aggregator &) = delete;
+
+    /**
+     * @brief Предъявить пакет.
+     * @return true — пакет взят (скопирован), его выдаст Poll; false — пакет
+     *         нужно отправить как есть сейчас (крупный, а задержанных пакетов
+     *         с той же меткой нет).
+     */
+    bool Offer(const std::uint8_t *pkt, std::size_t len, Clock::time_point now, std::uint64_t tag = 0) noexcept;
+
+    /**
+     * @brief Следующий готовый кадр: закрытый или открытый с истёкшим сроком.
+     * @param tag Если не nullptr — метка кадра.
+     * @return Длина кадра в out; 0 — слать нечего.
+     */
+    std::size_t Poll(std::uint8_t *out, std::size_t size, Clock::time_point now,
+                     std::uint64_t *tag = nullptr) noexcept;
+
+    /**
+     * @brief Как Poll, но открытый кадр отдаётся, не дожидаясь срока.
+     */
+    std::size_t Flush(std::uint8_t *out, std::size_t size, std::uint64_t *tag = nullptr) noexcept;
+
+    /** @brief Есть ли задержанные пакеты. */
+    bool Pending() const noexcept { return open_count_ != 0 || ready_count_ != 0; }
+
+    /** @brief Срок открытого кадра (time_point::max() — кадра нет). */
+    Clock::time_point Deadline() const noexcept { return open_count_ != 0 ? deadline_ : Clock::time_point::max(); }
+
+    /**
+     * @brief Новое соединение: задержанное отбрасывается.
+     */
+    void Reset() noexcept;
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+    /**
+     * @brief Разобрать кадр Bundle: fn(const std::uint8_t *pkt, std::size_t len) на каждый пакет.
+     *        Кадр сначала проверяется целиком — при ошибке fn не вызывается ни разу.
+     * @return false — не кадр Bundle, длины не сходятся или вложен Bundle.
+     */
+    template <typename Fn>
+    static bool Unbundle(const std::uint8_t *frame, std::size_t len, Fn &&fn);
+
+private:
+    Options     opts_;
+    std::size_t slot_size_;                  ///< Ёмкость буфера готового кадра.
+
+    std::vector<std::uint8_t> open_;         ///< Открытый кадр (заголовок заполняется при закрытии).
+    std::size_t       open_len_   = 0;       ///< Байт открытого кадра вместе с заголовком.
+    unsigned          open_count_ = 0;       ///< Пакетов в открытом кадре.
+    std::uint64_t     open_tag_   = 0;
+    Clock::time_point deadline_;
+
+    // Готовые кадры: закрытый Bundle и, возможно, крупный пакет следом за ним.
+    static constexpr unsigned kReady = 2;
+    std::vector<std::uint8_t> ready_;        ///< kReady буферов по slot_size_.
+    std::size_t       ready_len_[kReady] = {};
+    std::uint64_t     ready_tag_[kReady] = {};
+    unsigned          ready_head_  = 0;
+    unsigned          ready_count_ = 0;
+
+    Stats stats_;
+
+    /// @brief Закрыть открытый кадр в очередь готовых.
+    void Seal() noexcept;
+
+    /// @brief Буфер следующего готового кадра.
+    std::uint8_t *ReadySlot(std::uint64_t tag, std::size_t len) noexcept;
+
+    /// @brief Выдать голову очереди готовых.
+    std::size_t PopReady(std::uint8_t *out, std::size_t size, std::uint64_t *tag) noexcept;
+
+    /// @brief Разбор без вызова fn; число пакетов, 0 — ошибка.
+    static std::size_t Validate(const std::uint8_t *payload, std::size_t len) noexcept;
+};
+
+template <typename Fn>
+bool Aggregator::Unbundle(const std::uint8_t *frame, std::size_t len, Fn &&fn)
+{
+    CoreFrame::Type type;
+    const std::uint8_t *payload = nullptr;
+    std::size_t payload_len = 0;
+    if (!CoreFrame::Parse(frame, len, &type, &payload, &payload_len) || type != CoreFrame::Type::Bundle ||
+        Validate(payload, payload_len) == 0)
+    {
+        return false;
+    }
+    for (std::size_t off = 0; off < payload_len;)
+    {
+        const std::size_t item = (static_cast<std::size_t>(payload[off]) << 8) | payload[off + 1];
+        fn(payload + off + kItemHeaderSize, item);
+        off += kItemHeaderSize + item;
+    }
+    return true;
+}
@@ -0,0 +1,265 @@
+// Checksum.cpp — реализации Sum (scalar / SSE2 / AVX2 / NEON).
+
+#include "Checksum.hpp"
+
+#include <bit>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CHECKSUM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CHECKSUM_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(CHECKSUM_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CHECKSUM_TARGET(x) __attribute__((target(x)))
+#else
+#define CHECKSUM_TARGET(x)
+#endif
+
+namespace
+{
+    constexpr bool kLittle = std::endian::native == std::endian::little;
+
+    /// @brief Итераций векторного цикла до расширения 32-битных полос (в каждую — до 4 * 0xFFFF за итерацию).
+    constexpr std::size_t kLaneIterations = 8192;
+
+    /**
+     * @brief Несвёрнутая сумма слов в родном порядке байт (хвост в 1 байт — как у слова по этому адресу).
+     */
+    std::uint64_t SumNative(const std::uint8_t *p,
+                            std::size_t n) noexcept
+    {
+        std::uint64_t s = 0;
+        for (; n >= 8; p += 8, n -= 8)
+        {
+            std::uint64_t w;
+            std::memcpy(&w, p, 8);
+            s += (w & 0xFFFFFFFF) + (w >> 32);
+        }
+        if (n >= 4)
+        {
+            std::uint32_t w;
+            std::memcpy(&w, p, 4);
+            s += w;
+            p += 4;
+            n -= 4;
+        }
+        if (n >= 2)
+        {
+            std::uint16_t h;
+            std::memcpy(&h, p, 2);
+            s += h;
+            p += 2;
+            n -= 2;
+        }
+        if (n != 0)
+        {
+            s += kLittle ? p[0] : static_cast<std::uint32_t>(p[0]) << 8;
+        }
+        return s;
+    }
+
+    /// @brief Свернуть родную сумму в частичную сумму в порядке байт сети.
+    inline std::uint32_t ToNetwork(std::uint64_t native) noexcept
+    {
+        const std::uint32_t f = Checksum::Fold(native);
+        return kLittle ? Checksum::Swap(f) : f;
+    }
+
+    std::uint32_t SumScalar(const std::uint8_t *data,
+                            std::size_t len) noexcept
+    {
+        return ToNetwork(SumNative(data, len));
+    }
+
+#if defined(CHECKSUM_X86)
+    CHECKSUM_TARGET("sse2")
+    std::uint32_t SumSse2(const std::uint8_t *data,
+                          std::size_t len) noexcept
+    {
+        const __m128i lo16 = _mm_set1_epi32(0xFFFF);
+        std::uint64_t total = 0;
+        while (len >= 32)
+        {
+            __m128i a = _mm_setzero_si128();
+            __m128i b = _mm_setzero_si128();
+            for (std::size_t i = 0; i < kLaneIterations && len >= 32; ++i, data += 32, len -= 32)
+            {
+                const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+                const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+                a = _mm_add_epi32(a, _mm_add_epi32(_mm_and_si128(x, lo16), _mm_srli_epi32(x, 16)));
+                b = _mm_add_epi32(b, _mm_add_epi32(_mm_and_si128(y, lo16), _mm_srli_epi32(y, 16)));
+            }
+            alignas(16) std::uint32_t lanes[8];
+            _mm_store_si128(reinterpret_cast<__m128i *>(lanes), a);
+            _mm_store_si128(reinterpret_cast<__m128i *>(lanes + 4), b);
+            for (const std::uint32_t v : lanes)
+            {
+                total += v;
+            }
+        }
+        // Векторный цикл съедает кратное 32 байтам: чётность хвоста та же.
+        return ToNetwork(total + SumNative(data, len));
+    }
+
+    CHECKSUM_TARGET("avx2")
+    std::uint32_t SumAvx2(const std::uint8_t *data,
+                          std::size_t len) noexcept
+    {
+        const __m256i lo16 = _mm256_set1_epi32(0xFFFF);
+        std::uint64_t total = 0;
+        while (len >= 64)
+        {
+            __m256i a = _mm256_setzero_si256();
+            __m256i b = _mm256_setzero_si256();
+            for (std::size_t i = 0; i < kLaneIterations && len >= 64; ++i, data += 64, len -= 64)
+            {
+                const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+                const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32));
+                a = _mm256_add_epi32(a, _mm256_add_epi32(_mm256_and_si256(x, lo16), _mm256_srli_epi32(x, 16)));
+                b = _mm256_add_epi32(b, _mm256_add_epi32(_mm256_and_si256(y, lo16), _mm256_srli_epi32(y, 16)));
+            }
+            alignas(32) std::uint32_t lanes[16];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), a);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes + 8), b);
+            for (const std::uint32_t v : lanes)
+            {
+                total += v;
+            }
+        }
+        return ToNetwork(total + SumNative(data, len));
+    }
+
+    bool HasAvx2() noexcept
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int r[4];
+        __cpuid(r, 0);
+        if (r[0] < 7)
+        {
+            return false;
+        }
+        __cpuid(r, 1);
+        // OSXSAVE + AVX, и ОС сохраняет YMM-регистры.
+        if ((r[2] & (1 << 27)) == 0 || (r[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+        __cpuidex(r, 7, 0);
+        return (r[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    bool HasSse2() noexcept
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int r[4];
+        __cpuid(r, 1);
+        return (r[3] & (1 << 26)) != 0;
+#else
+        return __builtin_cpu_supports("sse2");
+#endif
+    }
+#endif
+
+#if defined(CHECKSUM_NEON)
+    std::uint32_t SumNeon(const std::uint8_t *data,
+                          std::size_t len) noexcept
+    {
+        std::uint64_t total = 0;
+        while (len >= 32)
+        {
+            uint32x4_t a = vdupq_n_u32(0);
+            uint32x4_t b = vdupq_n_u32(0);
+            for (std::size_t i = 0; i < kLaneIterations && len >= 32; ++i, data += 32, len -= 32)
+            {
+                // Попарное сложение соседних 16-битных слов с накоплением в 32-битные полосы.
+                a = vpadalq_u16(a, vreinterpretq_u16_u8(vld1q_u8(data)));
+                b = vpadalq_u16(b, vreinterpretq_u16_u8(vld1q_u8(data + 16)));
+            }
+            total += vaddlvq_u32(a) + vaddlvq_u32(b);
+        }
+        return ToNetwork(total + SumNative(data, len));
+    }
+#endif
+
+    struct Impl
+    {
+        Checksum::SumFn fn;
+        const char     *name;
+    };
+
+    Impl Select() noexcept
+    {
+#if defined(CHECKSUM_X86)
+        if (HasAvx2())
+        {
+            return {&SumAvx2, "avx2"};
+        }
+        if (HasSse2())
+        {
+            return {&SumSse2, "sse2"};
+        }
+#elif defined(CHECKSUM_NEON)
+        return {&SumNeon, "neon"};
+#endif
+        return {&SumScalar, "scalar"};
+    }
+
+    const Impl &Selected() noexcept
+    {
+        static const Impl impl = Select();
+        return impl;
+    }
+}
+
+namespace Checksum
+{
+    std::uint32_t Sum(const std::uint8_t *data,
+                      std::size_t len,
+                      std::uint32_t initial) noexcept
+    {
+        // Заголовки короче вектора: вызов выбранной реализации дороже самой суммы.
+        const std::uint32_t s = len < 64 ? SumScalar(data, len) : Selected().fn(data, len);
+        return Add(s, initial);
+    }
+
+    const char *Backend() noexcept
+    {
+        return Selected().name;
+    }
+
+    SumFn Implementation(const char *name) noexcept
+    {
+        const std::string_view n = name ? name : "";
+        if (n == "scalar")
+        {
+            return &SumScalar;
+        }
+#if defined(CHECKSUM_X86)
+        if (n == "avx2")
+        {
+            return HasAvx2() ? &SumAvx2 : nullptr;
+        }
+        if (n == "sse2")
+        {
+            return HasSse2() ? &SumSse2 : nullptr;
+        }
+#elif defined(CHECKSUM_NEON)
+        if (n == "neon")
+        {
+            return &SumNeon;
+        }
+#endif
+        return nullptr;
+    }
+}
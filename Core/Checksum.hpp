@@ -0,0 +1,122 @@
+#pragma once
+// Checksum.hpp — контрольная сумма Интернета (RFC 1071): полная, по частям и инкрементальная (RFC 1624).
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Сумма с дополнением до единицы 16-битных слов в порядке байт сети.
+ *
+ * Частичная сумма — свёрнутое число 0..0xFFFF (uint32_t, чтобы складывать
+ * без переполнения); поле заголовка — Finish(сумма). Куски одного буфера
+ * складываются Add, если кусок начинается с чётного смещения; кусок с
+ * нечётного смещения сначала проходит Swap.
+ *
+ * Sum на больших буферах — горячая операция (GRO, GSO): 32-битные слова
+ * складываются в родном порядке байт (сумма с дополнением от порядка не
+ * зависит до свёртки), на x86 — по 32 (AVX2) или 16 (SSE2) байт за раз,
+ * на ARM — NEON. Реализация выбирается один раз по CPUID; Reference —
+ * побайтовый эталон, constexpr (для заголовков в десятки байт и проверки).
+ */
+namespace Checksum
+{
+    /** @brief Свернуть сумму до 16 бит. */
+    constexpr std::uint32_t Fold(std::uint64_t sum) noexcept
+    {
+        while (sum >> 16)
+        {
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        }
+        return static_cast<std::uint32_t>(sum);
+    }
+
+    /** @brief Сложить частичные суммы. */
+    constexpr std::uint32_t Add(std::uint32_t a, std::uint32_t b) noexcept
+    {
+        return Fold(static_cast<std::uint64_t>(a) + b);
+    }
+
+    /** @brief Частичная сумма куска, лежащего с нечётного смещения (байты слов меняются местами). */
+    constexpr std::uint32_t Swap(std::uint32_t sum) noexcept
+    {
+        return ((sum & 0xFF) << 8) | ((sum >> 8) & 0xFF);
+    }
+
+    /** @brief Значение поля суммы: дополнение свёрнутой суммы. */
+    constexpr std::uint16_t Finish(std::uint32_t sum) noexcept
+    {
+        return static_cast<std::uint16_t>(~Fold(sum) & 0xFFFF);
+    }
+
+    /** @brief Эталон: побайтовая сумма (нечётный хвост — старший байт слова) плюс initial. */
+    constexpr std::uint32_t Reference(const std::uint8_t *data, std::size_t len, std::uint32_t initial = 0) noexcept
+    {
+        std::uint64_t s = initial;
+        std::size_t i = 0;
+        for (; i + 1 < len; i += 2)
+        {
+            s += static_cast<std::uint32_t>(data[i] << 8 | data[i + 1]);
+        }
+        if (i < len)
+        {
+            s += static_cast<std::uint32_t>(data[i]) << 8;
+        }
+        return Fold(s);
+    }
+
+    /**
+     * @brief Частичная сумма буфера плюс initial (выбранная реализация).
+     */
+    std::uint32_t Sum(const std::uint8_t *data, std::size_t len, std::uint32_t initial = 0) noexcept;
+
+    /**
+     * @brief Сумма псевдозаголовка TCP/UDP по заголовку IP (версия — по первому полубайту).
+     * @param ip     Заголовок IPv4 (>= 20 байт) или IPv6 (>= 40 байт).
+     * @param proto  Номер протокола L4.
+     * @param l4_len Длина заголовка L4 с данными.
+     */
+    constexpr std::uint32_t Pseudo(const std::uint8_t *ip, std::uint8_t proto, std::size_t l4_len) noexcept
+    {
+        const std::uint32_t addrs = (ip[0] >> 4) == 6 ? Reference(ip + 8, 32) : Reference(ip + 12, 8);
+        return Fold(static_cast<std::uint64_t>(addrs) + proto + (l4_len >> 16) + (l4_len & 0xFFFF));
+    }
+
+    /**
+     * @brief Поле суммы после замены 16-битного слова old_word на new_word (RFC 1624, формула 3).
+     */
+    constexpr std::uint16_t Update16(std::uint16_t check, std::uint16_t old_word, std::uint16_t new_word) noexcept
+    {
+        return Finish(static_cast<std::uint32_t>(static_cast<std::uint16_t>(~check)) +
+                      static_cast<std::uint16_t>(~old_word) + new_word);
+    }
+
+    /** @brief Как Update16 для 32-битного поля (адрес IPv4, seq). */
+    constexpr std::uint16_t Update32(std::uint16_t check, std::uint32_t old_value, std::uint32_t new_value) noexcept
+    {
+        check = Update16(check, static_cast<std::uint16_t>(old_value >> 16), static_cast<std::uint16_t>(new_value >> 16));
+        return Update16(check, static_cast<std::uint16_t>(old_value), static_cast<std::uint16_t>(new_value));
+    }
+
+    /**
+     * @brief Как Update16 для поля из len байт с чётного смещения (адрес IPv6).
+     */
+    constexpr std::uint16_t UpdateBytes(std::uint16_t check, const std::uint8_t *old_bytes,
+                                        const std::uint8_t *new_bytes, std::size_t len) noexcept
+    {
+        const std::uint32_t removed = static_cast<std::uint16_t>(~Reference(old_bytes, len));
+        return Finish(static_cast<std::uint32_t>(static_cast<std::uint16_t>(~check)) + removed +
+                      Reference(new_bytes, len));
+    }
+
+    /** @brief Имя выбранной реализации Sum: "avx2", "sse2", "neon" или "scalar". */
+    const char *Backend() noexcept;
+
+    /** @brief Реализация Sum: частичная сумма буфера без initial и без порога по длине. */
+    using SumFn = std::uint32_t (*)(const std::uint8_t *data, std::size_t len) noexcept;
+
+    /**
+     * @brief Реализация Sum по имени (как у Backend) — для сверки с Reference и замеров.
+     * @return nullptr — не собрана под эту архитектуру или процессор её не поддерживает.
+     */
+    SumFn Implementation(const char *name) noexcept;
+}
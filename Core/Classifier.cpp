@@ -0,0 +1,362 @@
+// Classifier.cpp — компиляция правил в интервалы с масками и поиск по ним.
+
+#include "Classifier.hpp"
+
+#include "PacketMeta.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    constexpr std::uint8_t kV4Mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+
+    inline std::uint64_t LoadBe64(const std::uint8_t *p) noexcept
+    {
+        // Развёрнуто: компиляторы сводят это к одной загрузке с bswap (цикл — нет).
+        return (std::uint64_t{p[0]} << 56) | (std::uint64_t{p[1]} << 48) | (std::uint64_t{p[2]} << 40) |
+               (std::uint64_t{p[3]} << 32) | (std::uint64_t{p[4]} << 24) | (std::uint64_t{p[5]} << 16) |
+               (std::uint64_t{p[6]} << 8)  |  std::uint64_t{p[7]};
+    }
+
+    /**
+     * @brief Элементарные интервалы поля: starts[i] — начало i-го, masks[i] — правила, которым он удовлетворяет.
+     */
+    template <typename K>
+    void BuildDim(const std::vector<std::pair<K, K>> &ranges,
+                  K min,
+                  K max,
+                  K (*next)(K),
+                  std::vector<K> &starts,
+                  std::vector<std::uint64_t> &masks)
+    {
+        starts.assign(1, min);
+        for (const auto &[lo, hi] : ranges)
+        {
+            starts.push_back(lo);
+            if (hi != max)
+            {
+                starts.push_back(next(hi));
+            }
+        }
+        std::sort(starts.begin(), starts.end());
+        starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+        masks.assign(starts.size(), 0);
+        for (std::size_t i = 0; i < starts.size(); ++i)
+        {
+            for (std::size_t r = 0; r < ranges.size(); ++r)
+            {
+                if (ranges[r].first <= starts[i] && starts[i] <= ranges[r].second)
+                {
+                    masks[i] |= std::uint64_t{1} << r;
+                }
+            }
+        }
+    }
+
+    template <typename K>
+    inline std::uint64_t Lookup(const std::vector<K> &starts,
+                                const std::vector<std::uint64_t> &masks,
+                                K key) noexcept
+    {
+        const auto it = std::upper_bound(starts.begin(), starts.end(), key);
+        return masks[static_cast<std::size_t>(it - starts.begin()) - 1];
+    }
+
+    inline bool HasPorts(std::uint8_t proto) noexcept
+    {
+        return proto == 6 || proto == 17 || proto == 132;   // TCP, UDP, SCTP
+    }
+}
+
+Classifier::Classifier(const std::vector<Rule> &rules)
+{
+    if (rules.size() > kMaxRules)
+    {
+        throw std::invalid_argument("Classifier: too many rules");
+    }
+    using KeyRange  = std::pair<Key, Key>;
+    using PortRange = std::pair<std::uint32_t, std::uint32_t>;
+    std::vector<KeyRange>  src, dst;
+    std::vector<PortRange> sport, dport;
+
+    auto to_range = [](const Prefix &p) -> KeyRange
+    {
+        const Key k{LoadBe64(p.addr.data()), LoadBe64(p.addr.data() + 8)};
+        // Маска старших len бит в 128-битном ключе.
+        const std::uint64_t mhi = p.len == 0 ? 0 : (p.len >= 64 ? ~std::uint64_t{0} : ~std::uint64_t{0} << (64 - p.len));
+        const std::uint64_t mlo = p.len <= 64 ? 0 : (p.len >= 128 ? ~std::uint64_t{0} : ~std::uint64_t{0} << (128 - p.len));
+        return {Key{k.hi & mhi, k.lo & mlo}, Key{k.hi | ~mhi, k.lo | ~mlo}};
+    };
+
+    for (std::size_t i = 0; i < rules.size(); ++i)
+    {
+        const Rule &r = rules[i];
+        if (r.proto > 255 || r.dscp > 63 || r.src.len > 128 || r.dst.len > 128 ||
+            r.sport_lo > r.sport_hi || r.dport_lo > r.dport_hi)
+        {
+            throw std::invalid_argument("Classifier: invalid rule " + std::to_string(i));
+        }
+        const std::uint64_t bit = std::uint64_t{1} << i;
+        targets_.push_back(r.target);
+        for (unsigned v = 0; v < proto_.size(); ++v)
+        {
+            if (r.proto < 0 || static_cast<unsigned>(r.proto) == v)
+            {
+                proto_[v] |= bit;
+            }
+        }
+        for (unsigned v = 0; v < dscp_.size(); ++v)
+        {
+            if (r.dscp < 0 || static_cast<unsigned>(r.dscp) == v)
+            {
+                dscp_[v] |= bit;
+            }
+        }
+        src.push_back(to_range(r.src));
+        dst.push_back(to_range(r.dst));
+        sport.emplace_back(r.sport_lo, r.sport_hi);
+        dport.emplace_back(r.dport_lo, r.dport_hi);
+        if (r.sport_lo == 0 && r.sport_hi == 65535 && r.dport_lo == 0 && r.dport_hi == 65535)
+        {
+            portless_ |= bit;
+        }
+    }
+
+    constexpr Key kMaxKey{~std::uint64_t{0}, ~std::uint64_t{0}};
+    BuildDim<Key>(src, Key{}, kMaxKey, [](Key k) { return k.lo == ~std::uint64_t{0} ? Key{k.hi + 1, 0} : Key{k.hi, k.lo + 1}; },
+                  src_starts_, src_masks_);
+    BuildDim<Key>(dst, Key{}, kMaxKey, [](Key k) { return k.lo == ~std::uint64_t{0} ? Key{k.hi + 1, 0} : Key{k.hi, k.lo + 1}; },
+                  dst_starts_, dst_masks_);
+    BuildDim<std::uint32_t>(sport, 0, 65535, [](std::uint32_t v) { return v + 1; }, sport_starts_, sport_masks_);
+    BuildDim<std::uint32_t>(dport, 0, 65535, [](std::uint32_t v) { return v + 1; }, dport_starts_, dport_masks_);
+}
+
+int Classifier::MatchIndex(const std::uint8_t *pkt,
+                           std::size_t len) const noexcept
+{
+    if (targets_.empty() || len < 20)
+    {
+        return -1;
+    }
+    std::uint8_t proto;
+    unsigned     dscp;
+    Key          src;
+    Key          dst;
+    std::size_t  l4 = 0;   ///< Смещение заголовка L4; 0 — портов нет.
+
+    if ((pkt[0] >> 4) == 4)
+    {
+        const std::size_t ihl = static_cast<std::size_t>(pkt[0] & 0x0F) * 4;
+        proto = pkt[9];
+        dscp  = pkt[1] >> 2;
+        src   = Key{0, 0x0000FFFF00000000ull | (std::uint64_t{pkt[12]} << 24) | (std::uint64_t{pkt[13]} << 16) |
+                       (std::uint64_t{pkt[14]} << 8) | pkt[15]};
+        dst   = Key{0, 0x0000FFFF00000000ull | (std::uint64_t{pkt[16]} << 24) | (std::uint64_t{pkt[17]} << 16) |
+                       (std::uint64_t{pkt[18]} << 8) | pkt[19]};
+        const bool first = ((pkt[6] & 0x1F) | pkt[7]) == 0;
+        if (first && ihl >= 20)
+        {
+            l4 = ihl;
+        }
+    }
+    else if ((pkt[0] >> 4) == 6 && len >= 40)
+    {
+        dscp  = static_cast<unsigned>(((pkt[0] & 0x0F) << 2) | (pkt[1] >> 6));
+        src   = Key{LoadBe64(pkt + 8), LoadBe64(pkt + 16)};
+        dst   = Key{LoadBe64(pkt + 24), LoadBe64(pkt + 32)};
+        proto = pkt[6];
+        std::size_t off = 40;
+        // Заголовки расширений до L4: hop-by-hop, routing, destination, fragment, AH.
+        for (int hops = 0; hops < 8; ++hops)
+        {
+            if (proto == 0 || proto == 43 || proto == 60 || proto == 51)
+            {
+                if (len < off + 8)
+                {
+                    off = 0;
+                    break;
+                }
+                const std::size_t ext = proto == 51 ? (static_cast<std::size_t>(pkt[off + 1]) + 2) * 4
+                                                    : (static_cast<std::size_t>(pkt[off + 1]) + 1) * 8;
+                proto = pkt[off];
+                off += ext;
+            }
+            else if (proto == 44)
+            {
+                if (len < off + 8)
+                {
+                    off = 0;
+                    break;
+                }
+                const bool first = ((pkt[off + 2] << 8 | pkt[off + 3]) & 0xFFF8) == 0;
+                proto = pkt[off];
+                off = first ? off + 8 : 0;
+                if (off == 0)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                break;
+            }
+        }
+        l4 = off;
+    }
+    else
+    {
+        return -1;
+    }
+
+    const bool ports = l4 != 0 && HasPorts(proto) && len >= l4 + 4;
+    return MatchFields(proto, dscp, src, dst, ports,
+                       ports ? static_cast<std::uint32_t>(pkt[l4] << 8 | pkt[l4 + 1]) : 0,
+                       ports ? static_cast<std::uint32_t>(pkt[l4 + 2] << 8 | pkt[l4 + 3]) : 0);
+}
+
+int Classifier::MatchIndex(const PacketMeta &meta,
+                           std::size_t i) const noexcept
+{
+    if (targets_.empty() || !meta.Ip(i))
+    {
+        return -1;
+    }
+    const Key src{LoadBe64(meta.Src(i)), LoadBe64(meta.Src(i) + 8)};
+    const Key dst{LoadBe64(meta.Dst(i)), LoadBe64(meta.Dst(i) + 8)};
+    const bool ports = (meta.Flags(i) & PacketMeta::kPorts) != 0 && HasPorts(meta.Proto(i));
+    return MatchFields(meta.Proto(i), meta.Dscp(i), src, dst, ports, meta.SrcPort(i), meta.DstPort(i));
+}
+
+int Classifier::MatchFields(std::uint8_t proto,
+                            unsigned dscp,
+                            const Key &src,
+                            const Key &dst,
+                            bool ports,
+                            std::uint32_t sport,
+                            std::uint32_t dport) const noexcept
+{
+    std::uint64_t m = proto_[proto] & dscp_[dscp] &
+                      Lookup(src_starts_, src_masks_, src) & Lookup(dst_starts_, dst_masks_, dst);
+    if (m == 0)
+    {
+        return -1;
+    }
+    if (ports)
+    {
+        m &= Lookup(sport_starts_, sport_masks_, sport) & Lookup(dport_starts_, dport_masks_, dport);
+    }
+    else
+    {
+        m &= portless_;
+    }
+    return m == 0 ? -1 : std::countr_zero(m);
+}
+
+bool Classifier::ParsePrefix(const std::string &text,
+                             Prefix *out)
+{
+    const auto slash = text.find('/');
+    const std::string ip = text.substr(0, slash);
+    Prefix p;
+    unsigned max_len;
+    std::uint8_t v4[4];
+    if (::inet_pton(AF_INET, ip.c_str(), v4) == 1)
+    {
+        std::memcpy(p.addr.data(), kV4Mapped, sizeof(kV4Mapped));
+        std::memcpy(p.addr.data() + 12, v4, sizeof(v4));
+        max_len = 32;
+    }
+    else if (::inet_pton(AF_INET6, ip.c_str(), p.addr.data()) == 1)
+    {
+        max_len = 128;
+    }
+    else
+    {
+        return false;
+    }
+    unsigned plen = max_len;
+    if (slash != std::string::npos)
+    {
+        const char *b = text.data() + slash + 1;
+        const char *e = text.data() + text.size();
+        const auto [ptr, ec] = std::from_chars(b, e, plen);
+        if (ec != std::errc{} || ptr != e || b == e || plen > max_len)
+        {
+            return false;
+        }
+    }
+    p.len = max_len == 32 ? 96 + plen : plen;
+    *out = p;
+    return true;
+}
+
+bool Classifier::ParsePorts(const std::string &text,
+                            std::uint16_t *lo,
+                            std::uint16_t *hi)
+{
+    const char *b = text.data();
+    const char *e = text.data() + text.size();
+    unsigned a = 0;
+    const auto first = std::from_chars(b, e, a);
+    if (first.ec != std::errc{} || first.ptr == b || a > 65535)
+    {
+        return false;
+    }
+    unsigned z = a;
+    if (first.ptr != e)
+    {
+        if (*first.ptr != '-')
+        {
+            return false;
+        }
+        const char *c = first.ptr + 1;
+        const auto second = std::from_chars(c, e, z);
+        if (second.ec != std::errc{} || second.ptr != e || second.ptr == c || z > 65535 || z < a)
+        {
+            return false;
+        }
+    }
+    *lo = static_cast<std::uint16_t>(a);
+    *hi = static_cast<std::uint16_t>(z);
+    return true;
+}
+
+int Classifier::ParseProto(const std::string &text)
+{
+    static const std::pair<const char *, int> kNames[] = {
+        {"icmp", 1}, {"tcp", 6}, {"udp", 17}, {"gre", 47}, {"esp", 50}, {"icmpv6", 58}, {"sctp", 132},
+    };
+    for (const auto &[name, num] : kNames)
+    {
+        if (text == name)
+        {
+            return num;
+        }
+    }
+    unsigned v = 0;
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), v);
+    if (ec != std::errc{} || ptr != text.data() + text.size() || text.empty() || v > 255)
+    {
+        return -1;
+    }
+    return static_cast<int>(v);
+}
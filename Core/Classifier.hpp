@@ -0,0 +1,138 @@
+#pragma once
+// Classifier.hpp — сопоставление IP-пакета со списком правил (битовые векторы по полям заголовка).
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class PacketMeta;
+
+/**
+ * @brief Классификатор пакетов по правилам «протокол / DSCP / адреса / порты».
+ *
+ * Правила компилируются в конструкторе: по каждому полю значения разбиваются
+ * на элементарные интервалы, и каждому интервалу сопоставляется битовая маска
+ * правил, которым он удовлетворяет (протокол и DSCP — прямые таблицы). Поиск —
+ * по бинарному поиску на поле и AND масок; побеждает первое по порядку правило
+ * (младший установленный бит). Стоимость не зависит от порядка и числа правил
+ * (до kMaxRules), память — O(правил) на поле.
+ *
+ * Адреса IPv4 хранятся как IPv4-mapped IPv6 (::ffff:a.b.c.d), поэтому правило
+ * с IPv4-префиксом не совпадает с IPv6-пакетом и наоборот.
+ *
+ * После создания только читается: Match можно звать из нескольких потоков.
+ */
+class Classifier
+{
+public:
+    /// @brief Предел числа правил (ширина маски).
+    static constexpr std::size_t kMaxRules = 64;
+
+    /**
+     * @brief Префикс адреса в пространстве IPv6 (IPv4 — ::ffff:0:0/96 + длина).
+     */
+    struct Prefix
+    {
+        std::array<std::uint8_t, 16> addr{};
+        /// @brief Длина префикса; 0 — любой адрес.
+        unsigned len = 0;
+    };
+
+    /**
+     * @brief Правило: все заданные условия должны выполниться.
+     */
+    struct Rule
+    {
+        /// @brief Протокол IP (-1 — любой).
+        int proto = -1;
+        /// @brief DSCP 0..63 (-1 — любой).
+        int dscp = -1;
+        Prefix src;
+        Prefix dst;
+        /// @brief Диапазоны портов; не [0, 65535] — только TCP/UDP/SCTP с портами.
+        std::uint16_t sport_lo = 0;
+        std::uint16_t sport_hi = 65535;
+        std::uint16_t dport_lo = 0;
+        std::uint16_t dport_hi = 65535;
+        /// @brief Результат совпадения (класс, приоритет — на усмотрение владельца).
+        unsigned target = 0;
+    };
+
+    /**
+     * @brief Скомпилировать правила.
+     * @throw std::invalid_argument Правил больше kMaxRules или некорректное правило.
+     */
+    explicit Classifier(const std::vector<Rule> &rules = {});
+
+    /**
+     * @brief Номер первого совпавшего правила; -1 — ни одно не подошло.
+     */
+    int MatchIndex(const std::uint8_t *pkt, std::size_t len) const noexcept;
+
+    /**
+     * @brief MatchIndex по разобранному пакету i пачки (заголовки не читаются).
+     */
+    int MatchIndex(const PacketMeta &meta, std::size_t i) const noexcept;
+
+    /**
+     * @brief target первого совпавшего правила; fallback — ни одно не подошло.
+     */
+    unsigned Match(const std::uint8_t *pkt, std::size_t len, unsigned fallback) const noexcept
+    {
+        const int i = MatchIndex(pkt, len);
+        return i < 0 ? fallback : targets_[static_cast<std::size_t>(i)];
+    }
+
+    /** @brief Match по разобранному пакету i пачки. */
+    unsigned Match(const PacketMeta &meta, std::size_t i, unsigned fallback) const noexcept
+    {
+        const int r = MatchIndex(meta, i);
+        return r < 0 ? fallback : targets_[static_cast<std::size_t>(r)];
+    }
+
+    /** @brief Число правил. */
+    std::size_t Size() const noexcept { return targets_.size(); }
+
+    /**
+     * @brief Разобрать "addr[/len]" (IPv4 или IPv6).
+     */
+    static bool ParsePrefix(const std::string &text, Prefix *out);
+
+    /**
+     * @brief Разобрать "port" или "lo-hi".
+     */
+    static bool ParsePorts(const std::string &text, std::uint16_t *lo, std::uint16_t *hi);
+
+    /**
+     * @brief Разобрать протокол: "tcp", "udp", "icmp", "icmpv6", "sctp" или номер.
+     * @return -1 — не распознан.
+     */
+    static int ParseProto(const std::string &text);
+
+private:
+    struct Key
+    {
+        std::uint64_t hi = 0;
+        std::uint64_t lo = 0;
+        auto operator<=>(const Key &) const = default;
+    };
+
+    /// @brief Пересечение масок по полям; ports == false — портов нет.
+    int MatchFields(std::uint8_t proto, unsigned dscp, const Key &src, const Key &dst,
+                    bool ports, std::uint32_t sport, std::uint32_t dport) const noexcept;
+
+    std::vector<unsigned>             targets_;
+    std::array<std::uint64_t, 256>    proto_{};
+    std::array<std::uint64_t, 64>     dscp_{};
+    std::vector<Key>                  src_starts_;
+    std::vector<std::uint64_t>        src_masks_;
+    std::vector<Key>                  dst_starts_;
+    std::vector<std::uint64_t>        dst_masks_;
+    std::vector<std::uint32_t>        sport_starts_;
+    std::vector<std::uint64_t>        sport_masks_;
+    std::vector<std::uint32_t>        dport_starts_;
+    std::vector<std::uint64_t>        dport_masks_;
+    std::uint64_t                     portless_ = 0;   ///< Правила без условий на порты.
+};
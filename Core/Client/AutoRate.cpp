@@ -0,0 +1,60 @@
+// AutoRate.cpp — реализация подбора скорости по задержке.
+
+#include "AutoRate.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+AutoRate::AutoRate(const Options &opts)
+    : opts_(opts)
+{
+    if (opts_.min_kbps == 0 || opts_.max_kbps < opts_.min_kbps ||
+        opts_.delay.count() <= 0 || opts_.period.count() <= 0 ||
+        opts_.decrease <= 0 || opts_.decrease >= 1 || opts_.increase <= 0)
+    {
+        throw std::invalid_argument("AutoRate: invalid options");
+    }
+    Reset();
+}
+
+bool AutoRate::Update(std::uint64_t rtt_us,
+                      bool busy,
+                      Clock::time_point now) noexcept
+{
+    last_ = now;
+    if (rtt_us == 0)
+    {
+        return false;
+    }
+    if (base_us_ == 0 || rtt_us < base_us_)
+    {
+        base_us_ = rtt_us;
+    }
+    else
+    {
+        // ~1/256 разницы за период: реальный рост базы догоняется за десятки секунд,
+        // а собственная очередь не успевает стать «нормой».
+        base_us_ += std::max<std::uint64_t>((rtt_us - base_us_) >> 8, 1);
+    }
+
+    const std::uint64_t old = rate_kbps_;
+    const auto delay_us = static_cast<std::uint64_t>(opts_.delay.count());
+    if (rtt_us > base_us_ + delay_us)
+    {
+        rate_kbps_ = static_cast<std::uint64_t>(static_cast<double>(rate_kbps_) * opts_.decrease);
+    }
+    else if (busy)
+    {
+        rate_kbps_ += std::max<std::uint64_t>(static_cast<std::uint64_t>(static_cast<double>(rate_kbps_) * opts_.increase), 1);
+    }
+    rate_kbps_ = std::clamp(rate_kbps_, opts_.min_kbps, opts_.max_kbps);
+    return rate_kbps_ != old;
+}
+
+void AutoRate::Reset() noexcept
+{
+    rate_kbps_ = std::clamp(opts_.start_kbps != 0 ? opts_.start_kbps : opts_.min_kbps,
+                            opts_.min_kbps, opts_.max_kbps);
+    base_us_ = 0;
+    last_    = {};
+}
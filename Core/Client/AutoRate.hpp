@@ -0,0 +1,85 @@
+#pragma once
+// AutoRate.hpp — оценка пропускной способности канала к серверу по росту RTT.
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Подбор скорости выдачи FQ-CoDel по задержке.
+ *
+ * Очередь нужна у нас (там ею управляет CoDel), а не в модеме провайдера;
+ * для этого скорость выдачи должна быть чуть ниже реальной пропускной
+ * способности, которая заранее неизвестна и меняется.
+ *
+ * Раз в period по свежему SRTT:
+ * - база — наименьший RTT (медленно подтягивается вверх: маршрут мог смениться);
+ * - RTT выше базы больше чем на delay — очередь копится дальше по пути,
+ *   скорость умножается на decrease;
+ * - иначе, если за период выдачу сдерживала именно скорость (канал нагружен),
+ *   она растёт на долю increase.
+ * Без нагрузки скорость не меняется: по простою нельзя узнать, сколько канал выдержит.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class AutoRate
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Параметры оценки.
+     */
+    struct Options
+    {
+        /// @brief Нижняя граница скорости, кбит/с.
+        std::uint64_t min_kbps = 1000;
+        /// @brief Верхняя граница скорости, кбит/с.
+        std::uint64_t max_kbps = 100000;
+        /// @brief Начальная скорость, кбит/с (0 — min_kbps: разгон снизу не создаёт очереди).
+        std::uint64_t start_kbps = 0;
+        /// @brief Рост RTT над базой, означающий очередь за нами.
+        std::chrono::microseconds delay{15000};
+        /// @brief Период пересчёта.
+        std::chrono::milliseconds period{200};
+        /// @brief Множитель при росте задержки (0..1).
+        double decrease = 0.9;
+        /// @brief Доля прироста за период под нагрузкой.
+        double increase = 0.05;
+    };
+
+    /**
+     * @brief Создать оценку.
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    explicit AutoRate(const Options &opts);
+
+    /**
+     * @brief Пора ли пересчитывать (прошёл period с прошлого Update).
+     */
+    bool Due(Clock::time_point now) const noexcept { return now - last_ >= opts_.period; }
+
+    /**
+     * @brief Пересчитать скорость.
+     * @param rtt_us Свежий SRTT (0 — ещё не измерен, шаг пропускается).
+     * @param busy   Выдачу за период сдерживала скорость.
+     * @return true — скорость изменилась.
+     */
+    bool Update(std::uint64_t rtt_us, bool busy, Clock::time_point now) noexcept;
+
+    /**
+     * @brief Новое соединение: путь мог смениться — база и скорость заново.
+     */
+    void Reset() noexcept;
+
+    /** @brief Текущая скорость, кбит/с. */
+    std::uint64_t Rate() const noexcept { return rate_kbps_; }
+
+    /** @brief Базовый RTT, мкс (0 — ещё не измерен). */
+    std::uint64_t BaseRttUs() const noexcept { return base_us_; }
+
+private:
+    Options           opts_;
+    std::uint64_t     rate_kbps_;
+    std::uint64_t     base_us_ = 0;
+    Clock::time_point last_;
+};
@@ -1,11 +1,28 @@
 #include "Core/PluginWrapper.hpp"
 #include "Core/TUN.hpp"
 #include "Core/Logger.hpp"
+#include "Core/Config.hpp"
+#include "Core/CoreFrame.hpp"
+#include "Core/ReorderBuffer.hpp"
+#include "Core/Fec.hpp"
+#include "Core/Aggregator.hpp"
+#include "Core/Compressor.hpp"
+#include "Core/Gro.hpp"
+#include "Core/FqCodel.hpp"
+#include "Core/Shaper.hpp"
+#include "Core/PriorityQueue.hpp"
+#include "Core/TimerService.hpp"
+#include "Core/PacketCapture.hpp"
 #include "Network.hpp"
 #include "FirewallRules.hpp"
 #include "NetWatcher.hpp"
 #include "DNS.hpp"
 #include "NetworkRollback.hpp"
+#include "Reconnect.hpp"
+#include "Liveness.hpp"
+#include "PathScheduler.hpp"
+#include "AutoRate.hpp"
+#include "ClientPipeline.hpp"
 #include "Client.hpp"
 
 #ifndef WIN32_LEAN_AND_MEAN
@@ -20,11 +37,12 @@
 #include <windows.h>
 using ssize_t = SSIZE_T;
 
+#include <atomic>
 #include <chrono>
 #include <csignal>
 #include <cstdint>
-#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <set>
 #include <vector>
@@ -37,6 +55,16 @@ static std::atomic<bool> g_started { false };
 static volatile sig_atomic_t g_working = 1;
 static std::thread g_thread;
 
+// Движок переподключения и контроль живости текущего ClientMain (для Stop()/GetLinkStats()).
+static std::mutex g_reconnect_mtx;
+static Reconnect *g_reconnect = nullptr;
+static Liveness  *g_liveness  = nullptr;
+static PathScheduler *g_paths = nullptr;
+static ClientPipeline *g_pipeline = nullptr;
+
+// Захват пакетов туннеля (StartCapture/StopCapture); живёт дольше ClientMain.
+static PacketCapture g_capture;
+
 static std::string strip_brackets(std::string s)
 {
     if (!s.empty() && s.front() == '[' && s.back() == ']')
@@ -46,6 +74,19 @@ static std::string strip_brackets(std::string s)
     return s;
 }
 
+static std::string to_hex(const std::string &s)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(s.size() * 2);
+    for (unsigned char c : s)
+    {
+        out.push_back(digits[c >> 4]);
+        out.push_back(digits[c & 0x0f]);
+    }
+    return out;
+}
+
 static std::wstring utf8_to_wide(const std::string &s)
 {
     if (s.empty())
@@ -62,41 +103,6 @@ static std::wstring utf8_to_wide(const std::string &s)
     return ws;
 }
 
-static void debug_packet_info(const std::uint8_t *data,
-                              std::size_t len,
-                              const char *direction)
-{
-    if (len < 20)
-    {
-        return;
-    }
-
-    std::uint8_t version = (data[0] >> 4) & 0x0f;
-    if (version == 4)
-    {
-        std::uint32_t src = (data[12] << 24) | (data[13] << 16) | (data[14] << 8) | data[15];
-        std::uint32_t dst = (data[16] << 24) | (data[17] << 16) | (data[18] << 8) | data[19];
-        LOGT("tun") << "[" << direction << "] IPv4: "
-                    << ((src >> 24) & 0xff) << "."
-                    << ((src >> 16) & 0xff) << "."
-                    << ((src >> 8) & 0xff)  << "."
-                    << (src & 0xff) << " -> "
-                    << ((dst >> 24) & 0xff) << "."
-                    << ((dst >> 16) & 0xff) << "."
-                    << ((dst >> 8) & 0xff)  << "."
-                    << (dst & 0xff) << " (len=" << len << ")";
-    }
-    else if (version == 6)
-    {
-        LOGT("tun") << "[" << direction << "] IPv6 packet (len=" << len << ")";
-    }
-    else
-    {
-        LOGW("tun") << "[" << direction << "] Unknown packet version=" << static_cast<int>(version)
-                    << " (len=" << len << ")";
-    }
-}
-
 bool IsElevated() noexcept
 {
     HANDLE h_token = nullptr;
@@ -204,6 +210,165 @@ static std::wstring ResolveFirewallAddressesW(const std::string &host)
     return out;
 }
 
+/**
+ * @brief Разбирает поля совпадения правила классификатора (proto, dscp, src, dst, sport, dport).
+ * @param section Имя объекта конфига для сообщений об ошибках.
+ * @throw std::runtime_error при ошибке в конфиге.
+ */
+static Classifier::Rule ParseRuleMatch(const boost::json::object &ro, const char *section)
+{
+    const std::string where = std::string("'") + section + "' rule: ";
+    Classifier::Rule r;
+    const std::string proto = Config::OptionalString(ro, "proto", "");
+    if (!proto.empty() && (r.proto = Classifier::ParseProto(proto)) < 0)
+        throw std::runtime_error(where + "invalid proto '" + proto + "'");
+    r.dscp = Config::OptionalInt(ro, "dscp", -1);
+    if (r.dscp < -1 || r.dscp > 63)
+        throw std::runtime_error(where + "dscp must be in [0..63]");
+    const std::string src = Config::OptionalString(ro, "src", "");
+    if (!src.empty() && !Classifier::ParsePrefix(src, &r.src))
+        throw std::runtime_error(where + "invalid src '" + src + "'");
+    const std::string dst = Config::OptionalString(ro, "dst", "");
+    if (!dst.empty() && !Classifier::ParsePrefix(dst, &r.dst))
+        throw std::runtime_error(where + "invalid dst '" + dst + "'");
+    const std::string sport = Config::OptionalString(ro, "sport", "");
+    if (!sport.empty() && !Classifier::ParsePorts(sport, &r.sport_lo, &r.sport_hi))
+        throw std::runtime_error(where + "invalid sport '" + sport + "'");
+    const std::string dport = Config::OptionalString(ro, "dport", "");
+    if (!dport.empty() && !Classifier::ParsePorts(dport, &r.dport_lo, &r.dport_hi))
+        throw std::runtime_error(where + "invalid dport '" + dport + "'");
+    return r;
+}
+
+/**
+ * @brief Разбирает объект "shaper": общий предел, классы и правила (классы — по имени).
+ * @throw std::runtime_error при ошибке в конфиге.
+ */
+static Shaper::Options ParseShaperOptions(const boost::json::object &so)
+{
+    Shaper::Options out;
+    const int rate_kbps = Config::OptionalInt(so, "rate_kbps", 0);
+    if (rate_kbps < 0)
+        throw std::runtime_error("'shaper.rate_kbps' must be non-negative");
+    out.rate_kbps = static_cast<std::uint64_t>(rate_kbps);
+    const int burst_us = Config::OptionalInt(so, "burst_us", static_cast<int>(out.burst.count()));
+    if (burst_us < 100 || burst_us > 1000000)
+        throw std::runtime_error("'shaper.burst_us' must be in [100..1000000]");
+    out.burst = std::chrono::microseconds(burst_us);
+
+    const boost::json::value *cv = so.if_contains("classes");
+    if (!cv || !cv->is_array() || cv->as_array().empty())
+        throw std::runtime_error("'shaper.classes' must be a non-empty array");
+    auto class_index = [&out](const std::string &name) -> int
+    {
+        for (std::size_t i = 0; i < out.classes.size(); ++i)
+        {
+            if (out.classes[i].name == name)
+                return static_cast<int>(i);
+        }
+        return -1;
+    };
+    for (const boost::json::value &x : cv->as_array())
+    {
+        if (!x.is_object())
+            throw std::runtime_error("'shaper.classes' must contain objects");
+        const boost::json::object &co = x.as_object();
+        Shaper::ClassOptions c;
+        c.name = Config::OptionalString(co, "name", "");
+        const std::string parent = Config::OptionalString(co, "parent", "");
+        if (!parent.empty())
+        {
+            c.parent = class_index(parent);
+            if (c.parent < 0)
+                throw std::runtime_error("'shaper' class '" + c.name + "': parent '" + parent + "' must be declared before it");
+        }
+        const int rate  = Config::OptionalInt(co, "rate_kbps", 0);
+        const int ceil  = Config::OptionalInt(co, "ceil_kbps", 0);
+        const int prio  = Config::OptionalInt(co, "prio", static_cast<int>(c.prio));
+        const int flow  = Config::OptionalInt(co, "flow_kbps", 0);
+        const int limit = Config::OptionalInt(co, "limit", static_cast<int>(c.limit));
+        if (rate < 0 || ceil < 0 || flow < 0 || prio < 0 || prio > 7 || limit < 1 || limit > 65536)
+            throw std::runtime_error("'shaper' class '" + c.name + "': invalid rate/ceil/prio/flow/limit");
+        c.rate_kbps = static_cast<std::uint64_t>(rate);
+        c.ceil_kbps = static_cast<std::uint64_t>(ceil);
+        c.prio      = static_cast<unsigned>(prio);
+        c.flow_kbps = static_cast<std::uint64_t>(flow);
+        c.limit     = static_cast<std::size_t>(limit);
+        out.classes.push_back(std::move(c));
+    }
+
+    const std::string def = Config::OptionalString(so, "default", out.classes.back().name);
+    const int def_index = class_index(def);
+    if (def_index < 0)
+        throw std::runtime_error("'shaper.default' refers to unknown class '" + def + "'");
+    out.default_class = static_cast<unsigned>(def_index);
+
+    if (const boost::json::value *rv = so.if_contains("rules"))
+    {
+        if (!rv->is_array())
+            throw std::runtime_error("'shaper.rules' must be an array");
+        for (const boost::json::value &x : rv->as_array())
+        {
+            if (!x.is_object())
+                throw std::runtime_error("'shaper.rules' must contain objects");
+            const boost::json::object &ro = x.as_object();
+            const std::string cls = Config::OptionalString(ro, "class", "");
+            const int target = class_index(cls);
+            if (target < 0)
+                throw std::runtime_error("'shaper' rule refers to unknown class '" + cls + "'");
+            Classifier::Rule r = ParseRuleMatch(ro, "shaper");
+            r.target = static_cast<unsigned>(target);
+            out.rules.push_back(r);
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief Разбирает объект "priority": число полос, ёмкость, защита от голодания и правила.
+ * @throw std::runtime_error при ошибке в конфиге.
+ */
+static PriorityQueue::Options ParsePriorityOptions(const boost::json::object &po)
+{
+    PriorityQueue::Options out;
+    const int bands = Config::OptionalInt(po, "bands", static_cast<int>(out.bands));
+    if (bands < 1 || bands > static_cast<int>(PriorityQueue::kMaxBands))
+        throw std::runtime_error("'priority.bands' must be in [1.." + std::to_string(PriorityQueue::kMaxBands) + "]");
+    out.bands = static_cast<unsigned>(bands);
+    const int limit = Config::OptionalInt(po, "limit", static_cast<int>(out.limit));
+    if (limit < 16 || limit > 65536)
+        throw std::runtime_error("'priority.limit' must be in [16..65536]");
+    out.limit = static_cast<std::size_t>(limit);
+    const int max_wait_ms = Config::OptionalInt(po, "max_wait_ms",
+        static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(out.max_wait).count()));
+    if (max_wait_ms < 1 || max_wait_ms > 10000)
+        throw std::runtime_error("'priority.max_wait_ms' must be in [1..10000]");
+    out.max_wait = std::chrono::milliseconds(max_wait_ms);
+    const int rate_kbps = Config::OptionalInt(po, "rate_kbps", 0);
+    if (rate_kbps < 0)
+        throw std::runtime_error("'priority.rate_kbps' must be non-negative");
+    out.rate_kbps = static_cast<std::uint64_t>(rate_kbps);
+
+    if (const boost::json::value *rv = po.if_contains("rules"))
+    {
+        if (!rv->is_array())
+            throw std::runtime_error("'priority.rules' must be an array");
+        for (const boost::json::value &x : rv->as_array())
+        {
+            if (!x.is_object())
+                throw std::runtime_error("'priority.rules' must contain objects");
+            const boost::json::object &ro = x.as_object();
+            const int band = Config::OptionalInt(ro, "band", -1);
+            if (band < 0 || band >= bands)
+                throw std::runtime_error("'priority' rule: band must be in [0.." + std::to_string(bands - 1) + "]");
+            Classifier::Rule r = ParseRuleMatch(ro, "priority");
+            r.target = static_cast<unsigned>(band);
+            out.rules.push_back(r);
+        }
+    }
+    return out;
+}
+
 static int ClientMain(std::string& config)
 {
     Logger::Options logger_options;
@@ -344,6 +509,288 @@ static int ClientMain(std::string& config)
         if (mtu < 576 || mtu > 9200)
             throw std::runtime_error("'mtu' must be in [576..9200]");
 
+    // reconnect: необязательный объект; по умолчанию переподключение включено.
+    Reconnect::Options reconnect_options;
+    int gap_queue_packets = 1024;
+    bool resume_enabled = true;
+    if (const boost::json::value* rv = o.if_contains("reconnect"))
+    {
+        if (!rv->is_object())
+            throw std::runtime_error("'reconnect' must be an object");
+        const boost::json::object &ro = rv->as_object();
+        reconnect_options.enabled      = Config::OptionalBool(ro, "enabled", reconnect_options.enabled);
+        reconnect_options.min_backoff  = std::chrono::milliseconds(
+            Config::OptionalInt(ro, "min_backoff_ms", static_cast<int>(reconnect_options.min_backoff.count())));
+        reconnect_options.max_backoff  = std::chrono::milliseconds(
+            Config::OptionalInt(ro, "max_backoff_ms", static_cast<int>(reconnect_options.max_backoff.count())));
+        const int max_attempts         = Config::OptionalInt(ro, "max_attempts", 0);
+        if (max_attempts < 0)
+            throw std::runtime_error("'reconnect.max_attempts' must be >= 0");
+        reconnect_options.max_attempts = static_cast<unsigned>(max_attempts);
+        gap_queue_packets              = Config::OptionalInt(ro, "queue_packets", gap_queue_packets);
+        if (gap_queue_packets <= 0 || gap_queue_packets > 65536)
+            throw std::runtime_error("'reconnect.queue_packets' must be in [1..65536]");
+        resume_enabled                 = Config::OptionalBool(ro, "resume", resume_enabled);
+    }
+    // keepalive: необязательный объект; по умолчанию пробы в простое включены (разрыв — только если сервер
+    // понимает служебные кадры: старый Server_Serve на пробы не отвечает).
+    Liveness::Options liveness_options;
+    if (const boost::json::value* kv = o.if_contains("keepalive"))
+    {
+        if (!kv->is_object())
+            throw std::runtime_error("'keepalive' must be an object");
+        const boost::json::object &ko = kv->as_object();
+        liveness_options.enabled    = Config::OptionalBool(ko, "enabled", liveness_options.enabled);
+        liveness_options.idle       = std::chrono::milliseconds(
+            Config::OptionalInt(ko, "idle_ms", static_cast<int>(liveness_options.idle.count())));
+        liveness_options.max_rto    = std::chrono::milliseconds(
+            Config::OptionalInt(ko, "max_rto_ms", static_cast<int>(liveness_options.max_rto.count())));
+        const int dead_after        = Config::OptionalInt(ko, "dead_after", static_cast<int>(liveness_options.dead_after));
+        if (dead_after < 1 || dead_after > 100)
+            throw std::runtime_error("'keepalive.dead_after' must be in [1..100]");
+        liveness_options.dead_after = static_cast<unsigned>(dead_after);
+    }
+    // multipath: необязательный объект; по умолчанию выключен (один канал до сервера).
+    bool multipath_enabled = false;
+    PathScheduler::Options path_options;
+    ReorderBuffer::Options reorder_options;
+    if (const boost::json::value* mv = o.if_contains("multipath"))
+    {
+        if (!mv->is_object())
+            throw std::runtime_error("'multipath' must be an object");
+        const boost::json::object &mo = mv->as_object();
+        multipath_enabled              = Config::OptionalBool(mo, "enabled", multipath_enabled);
+        const int max_paths            = Config::OptionalInt(mo, "max_paths", static_cast<int>(path_options.max_paths));
+        if (max_paths < 2 || max_paths > 8)
+            throw std::runtime_error("'multipath.max_paths' must be in [2..8]");
+        path_options.max_paths         = static_cast<unsigned>(max_paths);
+        const int min_capacity         = Config::OptionalInt(mo, "min_capacity_kbps", static_cast<int>(path_options.min_capacity_kbps));
+        if (min_capacity <= 0)
+            throw std::runtime_error("'multipath.min_capacity_kbps' must be positive");
+        path_options.min_capacity_kbps = static_cast<std::uint64_t>(min_capacity);
+        path_options.rtt_interval      = std::chrono::milliseconds(
+            Config::OptionalInt(mo, "rtt_interval_ms", static_cast<int>(path_options.rtt_interval.count())));
+        if (path_options.rtt_interval.count() <= 0)
+            throw std::runtime_error("'multipath.rtt_interval_ms' must be positive");
+        const int reorder_window       = Config::OptionalInt(mo, "reorder_window", static_cast<int>(reorder_options.window));
+        if (reorder_window < 2 || reorder_window > 4096)
+            throw std::runtime_error("'multipath.reorder_window' must be in [2..4096]");
+        reorder_options.window         = static_cast<std::size_t>(reorder_window);
+        reorder_options.hold           = std::chrono::milliseconds(
+            Config::OptionalInt(mo, "reorder_hold_ms", static_cast<int>(reorder_options.hold.count())));
+        if (reorder_options.hold.count() < 1 || reorder_options.hold.count() > 1000)
+            throw std::runtime_error("'multipath.reorder_hold_ms' must be in [1..1000]");
+    }
+    reorder_options.slot_size = static_cast<std::size_t>(mtu);
+    path_options.probe = liveness_options;
+    // fec: необязательный объект; по умолчанию выключен. k и max_m должны совпадать с сервером.
+    bool fec_enabled = false;
+    FecEncoder::Options fec_tx_options;
+    if (const boost::json::value* fv = o.if_contains("fec"))
+    {
+        if (!fv->is_object())
+            throw std::runtime_error("'fec' must be an object");
+        const boost::json::object &fo = fv->as_object();
+        fec_enabled              = Config::OptionalBool(fo, "enabled", fec_enabled);
+        const int k              = Config::OptionalInt(fo, "k", static_cast<int>(fec_tx_options.k));
+        if (k < 1 || k > static_cast<int>(FecEncoder::kMaxSources))
+            throw std::runtime_error("'fec.k' must be in [1..64]");
+        fec_tx_options.k         = static_cast<unsigned>(k);
+        const int max_m          = Config::OptionalInt(fo, "max_m", static_cast<int>(fec_tx_options.max_m));
+        if (max_m < 1 || max_m > static_cast<int>(FecEncoder::kMaxRepairs))
+            throw std::runtime_error("'fec.max_m' must be in [1..32]");
+        fec_tx_options.max_m     = static_cast<unsigned>(max_m);
+        const int min_m          = Config::OptionalInt(fo, "min_m", static_cast<int>(fec_tx_options.min_m));
+        if (min_m < 0 || min_m > max_m)
+            throw std::runtime_error("'fec.min_m' must be in [0..max_m]");
+        fec_tx_options.min_m     = static_cast<unsigned>(min_m);
+        fec_tx_options.flush     = std::chrono::milliseconds(
+            Config::OptionalInt(fo, "flush_ms", static_cast<int>(fec_tx_options.flush.count())));
+        if (fec_tx_options.flush.count() < 1 || fec_tx_options.flush.count() > 1000)
+            throw std::runtime_error("'fec.flush_ms' must be in [1..1000]");
+    }
+    fec_tx_options.mtu = static_cast<std::size_t>(mtu) + CoreFrame::kSeqHeaderSize;
+    FecDecoder::Options fec_rx_options;
+    fec_rx_options.max_k = fec_tx_options.k;
+    fec_rx_options.max_m = fec_tx_options.max_m;
+    fec_rx_options.mtu   = fec_tx_options.mtu;
+    // aggregation: необязательный объект; по умолчанию выключен. Сервер разбирает Bundle всегда.
+    bool aggregation_enabled = false;
+    Aggregator::Options aggregation_options;
+    if (const boost::json::value* gv = o.if_contains("aggregation"))
+    {
+        if (!gv->is_object())
+            throw std::runtime_error("'aggregation' must be an object");
+        const boost::json::object &go = gv->as_object();
+        aggregation_enabled      = Config::OptionalBool(go, "enabled", aggregation_enabled);
+        const int max_item       = Config::OptionalInt(go, "max_item", static_cast<int>(aggregation_options.max_item));
+        if (max_item < 40 || max_item > mtu / 2 - 8)
+            throw std::runtime_error("'aggregation.max_item' must be in [40..mtu/2-8]");
+        aggregation_options.max_item = static_cast<std::size_t>(max_item);
+        const int max_delay_us   = Config::OptionalInt(go, "max_delay_us",
+                                                       static_cast<int>(aggregation_options.max_delay.count()));
+        if (max_delay_us < 0 || max_delay_us > 10000)
+            throw std::runtime_error("'aggregation.max_delay_us' must be in [0..10000]");
+        aggregation_options.max_delay = std::chrono::microseconds(max_delay_us);
+    }
+    aggregation_options.mtu        = static_cast<std::size_t>(mtu);
+    aggregation_options.max_packet = static_cast<std::size_t>(mtu);
+    // compression: необязательный объект; по умолчанию выключен. Сервер распаковывает Compressed и Header всегда.
+    bool compression_enabled = false;
+    bool compression_headers = true;
+    Compressor::Options compression_options;
+    if (const boost::json::value* cv = o.if_contains("compression"))
+    {
+        if (!cv->is_object())
+            throw std::runtime_error("'compression' must be an object");
+        const boost::json::object &co = cv->as_object();
+        compression_enabled      = Config::OptionalBool(co, "enabled", compression_enabled);
+        compression_headers      = Config::OptionalBool(co, "headers", compression_headers);
+        const int min_size       = Config::OptionalInt(co, "min_size", static_cast<int>(compression_options.min_size));
+        if (min_size < 64 || min_size > mtu)
+            throw std::runtime_error("'compression.min_size' must be in [64..mtu]");
+        compression_options.min_size = static_cast<std::size_t>(min_size);
+        const int min_gain_pct   = Config::OptionalInt(co, "min_gain_pct", static_cast<int>(compression_options.min_gain_pct));
+        if (min_gain_pct < 0 || min_gain_pct > 90)
+            throw std::runtime_error("'compression.min_gain_pct' must be in [0..90]");
+        compression_options.min_gain_pct = static_cast<unsigned>(min_gain_pct);
+        const int backoff_ms     = Config::OptionalInt(co, "backoff_ms", static_cast<int>(compression_options.backoff.count()));
+        if (backoff_ms < 0 || backoff_ms > 600000)
+            throw std::runtime_error("'compression.backoff_ms' must be in [0..600000]");
+        compression_options.backoff = std::chrono::milliseconds(backoff_ms);
+        const int flows          = Config::OptionalInt(co, "flows", static_cast<int>(compression_options.flows));
+        if (flows < 1 || flows > 65536)
+            throw std::runtime_error("'compression.flows' must be in [1..65536]");
+        compression_options.flows = static_cast<std::size_t>(flows);
+    }
+    // gro: необязательный объект; по умолчанию выключен. Wintun без GSO: склейка в пределах MTU.
+    bool gro_enabled = false;
+    Gro::Options gro_options;
+    if (const boost::json::value* rv = o.if_contains("gro"))
+    {
+        if (!rv->is_object())
+            throw std::runtime_error("'gro' must be an object");
+        const boost::json::object &ro = rv->as_object();
+        gro_enabled          = Config::OptionalBool(ro, "enabled", gro_enabled);
+        const int hold_us    = Config::OptionalInt(ro, "hold_us", static_cast<int>(gro_options.hold.count()));
+        if (hold_us < 0 || hold_us > 10000)
+            throw std::runtime_error("'gro.hold_us' must be in [0..10000]");
+        gro_options.hold = std::chrono::microseconds(hold_us);
+    }
+    gro_options.max_size     = static_cast<std::size_t>(mtu);
+    gro_options.partial_csum = false;
+    // aqm: необязательный объект; по умолчанию выключен (пакеты уходят в порядке Wintun).
+    bool aqm_enabled = false;
+    bool aqm_auto    = false;
+    FqCodel::Options aqm_options;
+    AutoRate::Options rate_options;
+    if (const boost::json::value* av = o.if_contains("aqm"))
+    {
+        if (!av->is_object())
+            throw std::runtime_error("'aqm' must be an object");
+        const boost::json::object &ao = av->as_object();
+        aqm_enabled              = Config::OptionalBool(ao, "enabled", aqm_enabled);
+        const int rate_kbps      = Config::OptionalInt(ao, "rate_kbps", 0);
+        if (rate_kbps < 0)
+            throw std::runtime_error("'aqm.rate_kbps' must be non-negative");
+        aqm_options.rate_kbps    = static_cast<std::uint64_t>(rate_kbps);
+        const int target_ms      = Config::OptionalInt(ao, "target_ms", 5);
+        if (target_ms < 1 || target_ms > 1000)
+            throw std::runtime_error("'aqm.target_ms' must be in [1..1000]");
+        aqm_options.target       = std::chrono::milliseconds(target_ms);
+        const int interval_ms    = Config::OptionalInt(ao, "interval_ms", 100);
+        if (interval_ms < target_ms || interval_ms > 10000)
+            throw std::runtime_error("'aqm.interval_ms' must be in [target_ms..10000]");
+        aqm_options.interval     = std::chrono::milliseconds(interval_ms);
+        const int flows          = Config::OptionalInt(ao, "flows", static_cast<int>(aqm_options.flows));
+        if (flows < 1 || flows > 65536)
+            throw std::runtime_error("'aqm.flows' must be in [1..65536]");
+        aqm_options.flows        = static_cast<std::size_t>(flows);
+        const int limit          = Config::OptionalInt(ao, "limit", static_cast<int>(aqm_options.limit));
+        if (limit < 16 || limit > 65536)
+            throw std::runtime_error("'aqm.limit' must be in [16..65536]");
+        aqm_options.limit        = static_cast<std::size_t>(limit);
+        aqm_options.ecn          = Config::OptionalBool(ao, "ecn", aqm_options.ecn);
+        aqm_auto                 = Config::OptionalBool(ao, "auto_rate", aqm_auto);
+        const int min_rate       = Config::OptionalInt(ao, "min_rate_kbps", static_cast<int>(rate_options.min_kbps));
+        const int max_rate       = Config::OptionalInt(ao, "max_rate_kbps", static_cast<int>(rate_options.max_kbps));
+        if (min_rate <= 0 || max_rate < min_rate)
+            throw std::runtime_error("'aqm.min_rate_kbps'/'aqm.max_rate_kbps' must satisfy 0 < min <= max");
+        rate_options.min_kbps    = static_cast<std::uint64_t>(min_rate);
+        rate_options.max_kbps    = static_cast<std::uint64_t>(max_rate);
+        rate_options.start_kbps  = aqm_options.rate_kbps;
+        const int delay_ms       = Config::OptionalInt(ao, "delay_ms", 15);
+        if (delay_ms < 1 || delay_ms > 1000)
+            throw std::runtime_error("'aqm.delay_ms' must be in [1..1000]");
+        rate_options.delay       = std::chrono::milliseconds(delay_ms);
+        if (aqm_enabled && aqm_auto && !liveness_options.enabled && !multipath_enabled)
+            throw std::runtime_error("'aqm.auto_rate' needs RTT samples: enable 'keepalive'");
+    }
+    aqm_options.slot_size = static_cast<std::size_t>(mtu);
+    // shaper: необязательный объект; по умолчанию выключен. Заменяет одиночную очередь aqm:
+    // листья классов берут её параметры CoDel, auto_rate двигает общий предел шейпера.
+    std::unique_ptr<Shaper> shaper;
+    if (const boost::json::value* sv = o.if_contains("shaper"))
+    {
+        if (!sv->is_object())
+            throw std::runtime_error("'shaper' must be an object");
+        const boost::json::object &so = sv->as_object();
+        if (Config::OptionalBool(so, "enabled", false))
+        {
+            Shaper::Options shaper_options = ParseShaperOptions(so);
+            shaper_options.leaf = aqm_options;
+            try
+            {
+                shaper = std::make_unique<Shaper>(shaper_options);
+            }
+            catch (const std::invalid_argument &e)
+            {
+                throw std::runtime_error(std::string("'shaper': ") + e.what());
+            }
+        }
+    }
+    // priority: необязательный объект; по умолчанию выключен. Полосы строгого приоритета
+    // по DSCP и правилам вместо очереди aqm; auto_rate двигает их скорость выдачи.
+    std::unique_ptr<PriorityQueue> prio;
+    if (const boost::json::value* pv = o.if_contains("priority"))
+    {
+        if (!pv->is_object())
+            throw std::runtime_error("'priority' must be an object");
+        const boost::json::object &po = pv->as_object();
+        if (Config::OptionalBool(po, "enabled", false))
+        {
+            if (shaper)
+                throw std::runtime_error("'priority' and 'shaper' are mutually exclusive");
+            PriorityQueue::Options prio_options = ParsePriorityOptions(po);
+            prio_options.slot_size = static_cast<std::size_t>(mtu);
+            try
+            {
+                prio = std::make_unique<PriorityQueue>(prio_options);
+            }
+            catch (const std::invalid_argument &e)
+            {
+                throw std::runtime_error(std::string("'priority': ") + e.what());
+            }
+        }
+    }
+    if (aqm_enabled && aqm_auto && liveness_options.interval.count() == 0)
+    {
+        // Оценке скорости нужен RTT под нагрузкой, а не только в простое.
+        liveness_options.interval = rate_options.period;
+    }
+    const std::size_t pin_paths = multipath_enabled ? path_options.max_paths : 1;
+
+    LOGD("client") << "Reconnect: enabled=" << reconnect_options.enabled
+                   << " backoff=" << reconnect_options.min_backoff.count()
+                   << ".." << reconnect_options.max_backoff.count() << "ms"
+                   << " queue=" << gap_queue_packets << " resume=" << resume_enabled
+                   << " keepalive=" << liveness_options.enabled << " idle=" << liveness_options.idle.count() << "ms"
+                   << " multipath=" << multipath_enabled
+                   << " fec=" << fec_enabled
+                   << " aqm=" << aqm_enabled << " rate=" << aqm_options.rate_kbps << "kbps auto=" << aqm_auto
+                   << " shaper=" << (shaper ? shaper->Classes() : 0) << " classes"
+                   << " priority=" << (prio ? prio->Bands() : 0) << " bands";
+
     server_ip = strip_brackets(server_ip);
     LOGD("client") << "Normalized server: " << server_ip;
 
@@ -447,7 +894,8 @@ static int ClientMain(std::string& config)
         {
             Network::ConfigureNetwork(adapter,
                                       server_ip,
-                                      Network::IpVersion::V4);
+                                      Network::IpVersion::V4,
+                                      pin_paths);
             v4_ok = true;
             LOGI("netwatcher") << "IPv4 configured";
         }
@@ -460,7 +908,8 @@ static int ClientMain(std::string& config)
         {
             Network::ConfigureNetwork(adapter,
                                       server_ip,
-                                      Network::IpVersion::V6);
+                                      Network::IpVersion::V6,
+                                      pin_paths);
             v6_ok = true;
             LOGI("netwatcher") << "IPv6 configured";
         }
@@ -475,7 +924,9 @@ static int ClientMain(std::string& config)
         }
     };
 
-    NetWatcher nw(reapply, std::chrono::milliseconds(1000));
+    // Общие таймеры клиента (дебаунс NetWatcher и др.); живут дольше всех своих пользователей.
+    TimerService timers;
+    NetWatcher nw(timers, reapply, std::chrono::milliseconds(1000));
     LOGD("netwatcher") << "NetWatcher armed (interval=1000ms)";
 
     WINTUN_SESSION_HANDLE sess = Wintun.Start(adapter, 0x20000);
@@ -490,67 +941,166 @@ static int ClientMain(std::string& config)
     LOGI("tun") << "Session started (ring=0x20000)";
     LOGI("tun") << "Up: " << tun;
 
-    if (!PluginWrapper::Client_Connect(plugin, o))
+    // Живость туннеля: пробы в простое, RTT, «пир мёртв» -> переподключение.
+    Reconnect *reconnect_ptr = nullptr;
+    Liveness liveness(liveness_options, [&reconnect_ptr](const char *reason)
     {
-        LOGE("pluginwrapper") << "Client_Connect failed";
-        Wintun.End(sess);
-        Wintun.Close(adapter);
-        PluginWrapper::Unload(plugin);
-        WSACleanup();
-        return 1;
-    }
-    LOGI("pluginwrapper") << "Connected to " << server_ip << ":" << port;
+        if (reconnect_ptr)
+            reconnect_ptr->Fail(reason);
+    });
 
-    auto send_to_net = [sess](const std::uint8_t *data,
-                              std::size_t len) -> ssize_t
+    // Многопутевой режим: по транспорту на канал, путь каждому пакету выбирает планировщик.
+    // Активен в соединении, если плагин умеет Client_ServeMultipath и каналов хотя бы два.
+    PathScheduler paths(path_options, [&reconnect_ptr](const char *reason)
     {
-        debug_packet_info(data, len, "TO_NET");
-        BYTE *out = Wintun.AllocSend(sess, static_cast<DWORD>(len));
-        if (!out)
-        {
-            LOGW("tun") << "AllocSend returned null (drop)";
-            return 0;
-        }
-        std::memcpy(out, data, len);
-        Wintun.Send(sess, out);
-        LOGT("tun") << "TO_NET len=" << len;
-        return static_cast<ssize_t>(len);
-    };
+        if (reconnect_ptr)
+            reconnect_ptr->Fail(reason);
+    });
+    const Network::IpVersion server_ver = server_ip.find(':') != std::string::npos ? Network::IpVersion::V6
+                                                                                   : Network::IpVersion::V4;
 
-    auto receive_from_net = [sess](std::uint8_t *buffer,
-                                   std::size_t size) -> ssize_t
-    {
-        DWORD pkt_size = 0;
-        BYTE *pkt = Wintun.Recv(sess, &pkt_size);
-        if (!pkt)
-        {
-            LOGT("tun") << "Recv returned null (no packet)";
-            return 0;
-        }
+    // Стадии пакетов Wintun <-> плагин; шейпер и полосы приоритета переходят во владение конвейера.
+    ClientPipeline::Options pipeline_options;
+    pipeline_options.mtu                 = static_cast<std::size_t>(mtu);
+    pipeline_options.gap_queue           = static_cast<std::size_t>(gap_queue_packets);
+    pipeline_options.reorder             = reorder_options;
+    pipeline_options.fec                 = fec_enabled;
+    pipeline_options.fec_tx              = fec_tx_options;
+    pipeline_options.fec_rx              = fec_rx_options;
+    pipeline_options.aggregation         = aggregation_enabled;
+    pipeline_options.agg                 = aggregation_options;
+    pipeline_options.compression         = compression_enabled;
+    pipeline_options.compression_headers = compression_headers;
+    pipeline_options.compress_tx         = compression_options;
+    pipeline_options.gro                 = gro_enabled;
+    pipeline_options.gro_opts            = gro_options;
+    pipeline_options.aqm                 = aqm_enabled;
+    pipeline_options.aqm_auto            = aqm_auto;
+    pipeline_options.aqm_opts            = aqm_options;
+    pipeline_options.rate                = rate_options;
+    ClientPipeline pipeline(pipeline_options, sess, liveness, paths, g_capture, std::move(shaper), std::move(prio));
 
-        debug_packet_info(pkt, pkt_size, "FROM_NET");
+    const ClientPathApi     path_api     = pipeline.PathApi();
+    const ClientPriorityApi priority_api = pipeline.PriorityApi();
 
-        if (pkt_size > size)
+    Reconnect reconnect(
+        reconnect_options,
+        [&]() -> bool
         {
-            LOGW("tun") << "FROM_NET oversized pkt_size=" << pkt_size << " > buf=" << size;
-            Wintun.RecvRelease(sess, pkt);
-            return -1;
-        }
-        std::memcpy(buffer, pkt, pkt_size);
-        Wintun.RecvRelease(sess, pkt);
-        LOGT("tun") << "FROM_NET len=" << pkt_size;
-        return static_cast<ssize_t>(pkt_size);
-    };
+            // Плагин может модифицировать конфиг — каждой попытке свою копию.
+            boost::json::object attempt_cfg = o;
+            if (resume_enabled)
+            {
+                // Тикет прошлой сессии: сервер восстановит её без полного handshake.
+                const std::string ticket = pipeline.ResumeTicket();
+                if (!ticket.empty())
+                {
+                    attempt_cfg["resume_ticket"] = to_hex(ticket);
+                    LOGD("client") << "Presenting resumption ticket";
+                }
+            }
+            // Каналы пересчитываются на каждую попытку: Wi-Fi/LTE могли появиться или пропасть.
+            pipeline.BeginConnect();
+            std::size_t uplink_count = 0;
+            if (multipath_enabled && PluginWrapper::HasClientMultipath(plugin))
+            {
+                try
+                {
+                    std::vector<Network::Uplink> uplinks = Network::list_uplinks(luid, server_ver);
+                    if (uplinks.size() > path_options.max_paths)
+                        uplinks.resize(path_options.max_paths);
+                    boost::json::array arr;
+                    for (std::size_t i = 0; i < uplinks.size(); ++i)
+                    {
+                        boost::json::object u;
+                        u["index"]    = static_cast<std::int64_t>(i);
+                        u["local"]    = uplinks[i].local;
+                        u["if_index"] = static_cast<std::int64_t>(uplinks[i].if_index);
+                        arr.push_back(std::move(u));
+                    }
+                    if (uplinks.size() >= 2)
+                    {
+                        attempt_cfg["uplinks"] = std::move(arr);
+                        uplink_count = uplinks.size();
+                    }
+                    else
+                    {
+                        LOGI("multipath") << "Only " << uplinks.size() << " uplink(s); single-path connect";
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    LOGW("multipath") << "Uplink discovery failed: " << e.what();
+                }
+            }
+            if (!PluginWrapper::Client_Connect(plugin, attempt_cfg))
+            {
+                LOGE("pluginwrapper") << "Client_Connect failed";
+                return false;
+            }
+            LOGI("pluginwrapper") << "Connected to " << server_ip << ":" << port;
+            liveness.Reset();
+            pipeline.Connected(static_cast<unsigned>(uplink_count));
+            return true;
+        },
+        [&](const volatile sig_atomic_t *serve_flag) -> int
+        {
+            LOGI("pluginwrapper") << "Serve loop started";
+            // Многопутевой цикл важнее полос: порядок выдачи полос сохраняется и в нём.
+            int serve_rc = 0;
+            if (pipeline.Multipath())
+                serve_rc = PluginWrapper::Client_ServeMultipath(plugin, path_api, paths.Paths(), serve_flag);
+            else if (PluginWrapper::HasClientPriority(plugin))
+                serve_rc = PluginWrapper::Client_ServePriority(plugin, priority_api, pipeline.PriorityBands(), serve_flag);
+            else
+                serve_rc = PluginWrapper::Client_Serve(plugin,
+                                                       [&pipeline](std::uint8_t *buffer, std::size_t size)
+                                                       {
+                                                           return pipeline.ReceiveFromNet(buffer, size);
+                                                       },
+                                                       [&pipeline](const std::uint8_t *data, std::size_t len)
+                                                       {
+                                                           return pipeline.SendToNet(data, len);
+                                                       },
+                                                       serve_flag);
+            LOGI("pluginwrapper") << "Serve loop exited rc=" << serve_rc;
+            return serve_rc;
+        },
+        [&]()
+        {
+            LOGD("pluginwrapper") << "Disconnecting client";
+            PluginWrapper::Client_Disconnect(plugin);
+            const Liveness::Stats ls = liveness.GetStats();
+            LOGI("liveness") << "Link: srtt=" << ls.srtt_us << "us rttvar=" << ls.rttvar_us << "us"
+                             << " probes=" << ls.probes << " acks=" << ls.acks << " lost=" << ls.lost
+                             << " dead=" << ls.dead;
+            pipeline.LogStats();
+        },
+        // Перекачка Wintun -> gap-очередь, пока плагин не обслуживает трафик.
+        [&pipeline]()
+        {
+            pipeline.PumpGap();
+        });
 
-    LOGI("pluginwrapper") << "Serve loop started";
-    int rc = PluginWrapper::Client_Serve(plugin,
-                                         receive_from_net,
-                                         send_to_net,
-                                         &g_working);
-    LOGI("pluginwrapper") << "Serve loop exited rc=" << rc;
+    reconnect_ptr = &reconnect;
+    {
+        std::lock_guard<std::mutex> lk(g_reconnect_mtx);
+        g_reconnect = &reconnect;
+        g_liveness  = &liveness;
+        g_paths     = &paths;
+        g_pipeline  = &pipeline;
+    }
+    int rc = reconnect.Run(&g_working);
+    {
+        std::lock_guard<std::mutex> lk(g_reconnect_mtx);
+        g_reconnect = nullptr;
+        g_liveness  = nullptr;
+        g_paths     = nullptr;
+        g_pipeline  = nullptr;
+    }
+    reconnect_ptr = nullptr;
+    LOGI("reconnect") << "Stopped rc=" << rc << " reconnects=" << reconnect.Reconnects();
 
-    LOGD("pluginwrapper") << "Disconnecting client";
-    PluginWrapper::Client_Disconnect(plugin);
     LOGD("tun") << "Ending session";
     Wintun.End(sess);
     LOGD("tun") << "Closing adapter";
@@ -595,6 +1145,13 @@ EXPORT int32_t Stop(void)
         return -2; // не запущено
     }
     g_working = 0;
+    {
+        std::lock_guard<std::mutex> lk(g_reconnect_mtx);
+        if (g_reconnect)
+        {
+            g_reconnect->Cancel();
+        }
+    }
 
     // Фоновое ожидание завершения рабочего потока.
     std::thread([]()
@@ -614,3 +1171,126 @@ EXPORT int32_t IsRunning(void)
 {
     return g_started.load() ? 1 : 0;
 }
+
+// Состояние канала: RTT и потери keepalive-проб.
+EXPORT int32_t GetLinkStats(LinkStats *out)
+{
+    if (!out)
+    {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lk(g_reconnect_mtx);
+    if (!g_liveness)
+    {
+        return -2; // не запущено
+    }
+    const Liveness::Stats ls = g_liveness->GetStats();
+    out->srtt_us    = ls.srtt_us;
+    out->rttvar_us  = ls.rttvar_us;
+    out->rto_us     = ls.rto_us;
+    out->probes     = ls.probes;
+    out->acks       = ls.acks;
+    out->lost       = ls.lost;
+    out->dead       = ls.dead ? 1 : 0;
+    out->reconnects = g_reconnect ? g_reconnect->Reconnects() : 0;
+    return 0;
+}
+
+// Число путей многопутевого режима в текущем соединении.
+EXPORT int32_t GetPathCount(void)
+{
+    std::lock_guard<std::mutex> lk(g_reconnect_mtx);
+    if (!g_paths || !g_pipeline)
+    {
+        return -2; // не запущено
+    }
+    return g_pipeline->Multipath() ? static_cast<int32_t>(g_paths->Paths()) : 0;
+}
+
+// Состояние одного пути: RTT, оценка пропускной способности, счётчики.
+EXPORT int32_t GetPathStats(uint32_t path, PathStats *out)
+{
+    if (!out)
+    {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lk(g_reconnect_mtx);
+    if (!g_paths)
+    {
+        return -2; // не запущено
+    }
+    PathScheduler::PathStats ps;
+    if (!g_paths->GetStats(path, &ps))
+    {
+        return -1;
+    }
+    out->srtt_us       = ps.srtt_us;
+    out->capacity_kbps = ps.capacity_kbps;
+    out->tx_packets    = ps.tx_packets;
+    out->tx_bytes      = ps.tx_bytes;
+    out->rx_packets    = ps.rx_packets;
+    out->rx_bytes      = ps.rx_bytes;
+    out->probes        = ps.probes;
+    out->lost          = ps.lost;
+    out->up            = ps.up ? 1 : 0;
+    return 0;
+}
+
+// Начать захват пакетов туннеля в кольцевой файл pcapng.
+EXPORT int32_t StartCapture(const char *path, uint32_t ring_mb, uint32_t snaplen, const char *filter)
+{
+    if (!path || !*path || ring_mb > 65536)
+    {
+        return -1;
+    }
+    PacketCapture::Options opts;
+    opts.path       = path;
+    opts.ring_bytes = static_cast<std::size_t>(ring_mb == 0 ? 64 : ring_mb) << 20;
+    opts.snaplen    = snaplen;
+    opts.max_packet = 9200;   // наибольший MTU клиента: захват не зависит от текущего конфига
+    opts.queue      = 2048;
+    opts.filter     = filter ? filter : "";
+    opts.ifname     = "tunnel";
+    try
+    {
+        g_capture.Start(opts);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        LOGW("capture") << "StartCapture: " << e.what();
+        return -1;
+    }
+    catch (const std::logic_error &)
+    {
+        return -3; // уже идёт
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("capture") << "StartCapture: " << e.what();
+        return -4;
+    }
+    return 0;
+}
+
+// Остановить захват и закрыть файл.
+EXPORT int32_t StopCapture(void)
+{
+    return g_capture.Stop() ? 0 : -1;
+}
+
+// Счётчики захвата.
+EXPORT int32_t GetCaptureStats(CaptureStats *out)
+{
+    if (!out)
+    {
+        return -1;
+    }
+    const PacketCapture::Stats cs = g_capture.GetStats();
+    out->packets  = cs.packets;
+    out->bytes    = cs.bytes;
+    out->filtered = cs.filtered;
+    out->dropped  = cs.dropped;
+    out->wraps    = cs.wraps;
+    out->active   = cs.active ? 1 : 0;
+    return 0;
+}
@@ -14,3 +14,66 @@ EXPORT int32_t Stop(void);
 
 // Статус работы: 1 — запущен, 0 — остановлен
 EXPORT int32_t IsRunning(void);
+
+// Состояние канала (см. GetLinkStats).
+typedef struct LinkStats
+{
+    uint64_t srtt_us;     // сглаженный RTT (0 — ещё не измерен)
+    uint64_t rttvar_us;   // разброс RTT
+    uint64_t rto_us;      // текущий таймаут keepalive-пробы
+    uint64_t probes;      // отправлено проб
+    uint64_t acks;        // получено ответов
+    uint64_t lost;        // проб без ответа
+    uint64_t reconnects;  // переподключений
+    int32_t  dead;        // 1 — пир объявлен мёртвым в текущем соединении
+} LinkStats;
+
+// Снимок состояния канала: 0 — успех, -1 — out == nullptr, -2 — клиент не запущен
+EXPORT int32_t GetLinkStats(LinkStats *out);
+
+// Состояние одного канала многопутевого режима (см. GetPathStats).
+typedef struct PathStats
+{
+    uint64_t srtt_us;        // сглаженный RTT пути (0 — ещё не измерен)
+    uint64_t capacity_kbps;  // оценка пропускной способности
+    uint64_t tx_packets;     // отправлено пакетов этим путём
+    uint64_t tx_bytes;
+    uint64_t rx_packets;     // получено пакетов этим путём
+    uint64_t rx_bytes;
+    uint64_t probes;         // отправлено проб
+    uint64_t lost;           // проб без ответа
+    int32_t  up;             // 1 — путь в ротации
+} PathStats;
+
+// Число путей текущего соединения (0 — многопутевой режим не активен), -2 — клиент не запущен
+EXPORT int32_t GetPathCount(void);
+
+// Снимок состояния пути: 0 — успех, -1 — out == nullptr или нет такого пути, -2 — клиент не запущен
+EXPORT int32_t GetPathStats(uint32_t path, PathStats *out);
+
+// Счётчики захвата пакетов (см. GetCaptureStats).
+typedef struct CaptureStats
+{
+    uint64_t packets;     // записано пакетов
+    uint64_t bytes;       // записано байт (после snaplen)
+    uint64_t filtered;    // отвергнуто фильтром
+    uint64_t dropped;     // отброшено: фоновый поток не успевал
+    uint64_t wraps;       // оборотов кольца (старые записи перезаписаны)
+    int32_t  active;      // 1 — захват идёт
+} CaptureStats;
+
+// Начать запись внутренних пакетов туннеля (оба направления) в кольцевой файл pcapng.
+// path    — файл (UTF-8, перезаписывается);
+// ring_mb — размер кольца в МиБ (0 — 64); при заполнении перезаписываются самые старые пакеты;
+// snaplen — байт пакета в записи (0 — целиком);
+// filter  — выражение в духе tcpdump: "tcp port 443 and host 1.1.1.1", "in", "not icmp" (nullptr или "" — всё).
+// Не зависит от Start/Stop клиента. 0 — успех, -1 — неверные аргументы или фильтр, -3 — захват уже идёт,
+// -4 — файл не создан
+EXPORT int32_t StartCapture(const char *path, uint32_t ring_mb, uint32_t snaplen, const char *filter);
+
+// Остановить захват: очередь дописывается, файл упорядочивается по времени и обрезается.
+// 0 — успех, -1 — захват не шёл
+EXPORT int32_t StopCapture(void);
+
+// Снимок счётчиков текущего (или последнего) захвата: 0 — успех, -1 — out == nullptr
+EXPORT int32_t GetCaptureStats(CaptureStats *out);
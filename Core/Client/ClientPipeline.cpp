@@ -0,0 +1,924 @@
+// ClientPipeline.cpp — реализация стадий пакетов клиента.
+
+#include "ClientPipeline.hpp"
+#include "Core/CoreFrame.hpp"
+#include "Core/Logger.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    void DebugPacketInfo(const std::uint8_t *data,
+                         std::size_t len,
+                         const char *direction)
+    {
+        if (len < 20)
+        {
+            return;
+        }
+
+        std::uint8_t version = (data[0] >> 4) & 0x0f;
+        if (version == 4)
+        {
+            std::uint32_t src = (data[12] << 24) | (data[13] << 16) | (data[14] << 8) | data[15];
+            std::uint32_t dst = (data[16] << 24) | (data[17] << 16) | (data[18] << 8) | data[19];
+            LOGT("tun") << "[" << direction << "] IPv4: "
+                        << ((src >> 24) & 0xff) << "."
+                        << ((src >> 16) & 0xff) << "."
+                        << ((src >> 8) & 0xff)  << "."
+                        << (src & 0xff) << " -> "
+                        << ((dst >> 24) & 0xff) << "."
+                        << ((dst >> 16) & 0xff) << "."
+                        << ((dst >> 8) & 0xff)  << "."
+                        << (dst & 0xff) << " (len=" << len << ")";
+        }
+        else if (version == 6)
+        {
+            LOGT("tun") << "[" << direction << "] IPv6 packet (len=" << len << ")";
+        }
+        else
+        {
+            LOGW("tun") << "[" << direction << "] Unknown packet version=" << static_cast<int>(version)
+                        << " (len=" << len << ")";
+        }
+    }
+
+    void DebugPacketMeta(const PacketMeta &meta,
+                         std::size_t i,
+                         const char *direction)
+    {
+        const unsigned version = meta.Version(i);
+        if (version == 4)
+        {
+            const std::uint8_t *src = meta.Src(i) + 12;
+            const std::uint8_t *dst = meta.Dst(i) + 12;
+            LOGT("tun") << "[" << direction << "] IPv4: "
+                        << static_cast<unsigned>(src[0]) << "." << static_cast<unsigned>(src[1]) << "."
+                        << static_cast<unsigned>(src[2]) << "." << static_cast<unsigned>(src[3]) << ":" << meta.SrcPort(i) << " -> "
+                        << static_cast<unsigned>(dst[0]) << "." << static_cast<unsigned>(dst[1]) << "."
+                        << static_cast<unsigned>(dst[2]) << "." << static_cast<unsigned>(dst[3]) << ":" << meta.DstPort(i)
+                        << " proto=" << static_cast<unsigned>(meta.Proto(i)) << " (len=" << meta.Length(i) << ")";
+        }
+        else if (version == 6)
+        {
+            LOGT("tun") << "[" << direction << "] IPv6 packet proto=" << static_cast<unsigned>(meta.Proto(i))
+                        << " (len=" << meta.Length(i) << ")";
+        }
+        else
+        {
+            LOGW("tun") << "[" << direction << "] Unknown packet (len=" << meta.Length(i) << ")";
+        }
+    }
+}
+
+ClientPipeline::ClientPipeline(const Options                 &opts,
+                               WINTUN_SESSION_HANDLE          sess,
+                               Liveness                      &liveness,
+                               PathScheduler                 &paths,
+                               PacketCapture                 &capture,
+                               std::unique_ptr<Shaper>        shaper,
+                               std::unique_ptr<PriorityQueue> prio)
+    : opts_(opts),
+      sess_(sess),
+      liveness_(liveness),
+      paths_(paths),
+      capture_(capture),
+      gap_queue_(opts.gap_queue, opts.mtu),
+      // Окно порядка — перед кольцом Wintun: TCP не принимает переупорядочивание путей за потерю.
+      reorder_(opts.reorder, [this](const std::uint8_t *data, std::size_t len)
+      {
+          WriteTun(data, len);
+      }),
+      shaper_(std::move(shaper)),
+      prio_(std::move(prio)),
+      egress_meta_(PacketMeta::kDefaultCapacity)
+{
+    if (opts_.gro)
+    {
+        gro_ = std::make_unique<Gro>(opts_.gro_opts, [this](const Gro::Packet &pkt)
+        {
+            WintunWrite(pkt.data, pkt.len);
+        });
+    }
+    if (opts_.fec)
+    {
+        fec_tx_ = std::make_unique<FecEncoder>(opts_.fec_tx);
+        fec_rx_ = std::make_unique<FecDecoder>(opts_.fec_rx, [this](const std::uint8_t *data, std::size_t len)
+        {
+            DeliverInner(data, len);
+        });
+    }
+    if (opts_.compression)
+    {
+        compress_tx_ = std::make_unique<Compressor>(opts_.compress_tx);
+        Decompressor::Options decompress_options;
+        decompress_options.mtu = opts_.mtu;
+        compress_rx_ = std::make_unique<Decompressor>(decompress_options);
+        if (opts_.compression_headers)
+        {
+            header_tx_ = std::make_unique<HeaderCompressor>(HeaderCompressor::Options{});
+        }
+        // Сервер сжимает заголовки сессиям, которые сжимают сами: распаковщик нужен и без headers.
+        HeaderDecompressor::Options header_options;
+        header_options.mtu = opts_.mtu;
+        header_rx_ = std::make_unique<HeaderDecompressor>(header_options);
+    }
+    if (opts_.aqm && !shaper_ && !prio_)
+    {
+        aqm_ = std::make_unique<FqCodel>(opts_.aqm_opts);
+    }
+    if (opts_.aqm && opts_.aqm_auto)
+    {
+        aqm_rate_ = std::make_unique<AutoRate>(opts_.rate);
+        SetEgressRate(aqm_rate_->Rate());
+    }
+    if (opts_.aggregation)
+    {
+        agg_ = std::make_unique<Aggregator>(opts_.agg);
+    }
+}
+
+ssize_t ClientPipeline::ReceiveFromNet(std::uint8_t *buf,
+                                       std::size_t size)
+{
+    ExpireReorder();
+    PollGro();
+    if (const std::size_t fec = PollFec(buf, size))
+    {
+        return static_cast<ssize_t>(fec);
+    }
+    if (const std::size_t ack = PollCompress(buf, size))
+    {
+        return static_cast<ssize_t>(ack);
+    }
+    const ssize_t n = ReadAggregated(buf, size);
+    if (n == 0)
+    {
+        // Простой: самое время для keepalive-пробы.
+        return static_cast<ssize_t>(liveness_.Poll(buf, size));
+    }
+    if (n < 0)
+    {
+        return n;
+    }
+    return static_cast<ssize_t>(ProtectFec(buf, static_cast<std::size_t>(n), size));
+}
+
+ssize_t ClientPipeline::SendToNet(const std::uint8_t *buf,
+                                  std::size_t len)
+{
+    liveness_.OnActivity();
+    if (CoreFrame::IsCoreFrame(buf, len))
+    {
+        if (buf[1] == static_cast<std::uint8_t>(CoreFrame::Type::Bundle))
+        {
+            HandleBundle(buf, len);
+        }
+        else
+        {
+            HandleCoreFrame(buf, len);
+        }
+        return static_cast<ssize_t>(len);
+    }
+    return WriteTun(buf, len);
+}
+
+ClientPathApi ClientPipeline::PathApi()
+{
+    ClientPathApi api;
+    api.receive_from_net = [this](unsigned *path, std::uint8_t *buf, std::size_t size)
+    {
+        return ReceiveFromPath(path, buf, size);
+    };
+    api.send_to_net = [this](unsigned path, const std::uint8_t *buf, std::size_t len)
+    {
+        paths_.OnReceive(path, len);
+        return SendToNet(buf, len);
+    };
+    api.path_state = [this](unsigned path, bool up)
+    {
+        paths_.SetUp(path, up);
+    };
+    return api;
+}
+
+ClientPriorityApi ClientPipeline::PriorityApi()
+{
+    ClientPriorityApi api;
+    api.receive_from_net = [this](unsigned *band, std::uint8_t *buf, std::size_t size)
+    {
+        return ReceiveFromBand(band, buf, size);
+    };
+    api.send_to_net = [this](const std::uint8_t *buf, std::size_t len)
+    {
+        return SendToNet(buf, len);
+    };
+    return api;
+}
+
+void ClientPipeline::PumpGap()
+{
+    // Кольцо Wintun не переполняется, а приложения видят паузу вместо потерь.
+    DWORD pkt_size = 0;
+    while (BYTE *pkt = Wintun.Recv(sess_, &pkt_size))
+    {
+        gap_queue_.Push(pkt, pkt_size);
+        Wintun.RecvRelease(sess_, pkt);
+    }
+}
+
+void ClientPipeline::Connected(unsigned uplinks)
+{
+    {
+        // Новое соединение — новая нумерация в обе стороны.
+        std::lock_guard<std::mutex> lk(reorder_mtx_);
+        reorder_.Reset();
+        reorder_pending_.store(false, std::memory_order_relaxed);
+        tx_seq_.store(0, std::memory_order_relaxed);
+    }
+    if (fec_tx_)
+    {
+        std::scoped_lock lk(fec_tx_mtx_, fec_rx_mtx_);
+        fec_tx_->Reset();
+        fec_rx_->Reset();
+    }
+    if (agg_)
+    {
+        std::lock_guard<std::mutex> lk(agg_mtx_);
+        agg_->Reset();
+    }
+    if (compress_tx_)
+    {
+        // Словари и контексты прошлого соединения сервер забыл вместе с сессией.
+        std::scoped_lock lk(compress_tx_mtx_, compress_rx_mtx_);
+        compress_tx_->Reset();
+        compress_rx_->Reset();
+        if (header_tx_)
+        {
+            header_tx_->Reset();
+        }
+        header_rx_->Reset();
+    }
+    if (gro_)
+    {
+        // Удержанное прошлым соединением — целые пакеты: отдать их стеку, а не терять.
+        std::lock_guard<std::mutex> lk(gro_mtx_);
+        gro_->Flush();
+    }
+    if (aqm_rate_)
+    {
+        std::lock_guard<std::mutex> lk(aqm_mtx_);
+        aqm_rate_->Reset();
+        SetEgressRate(aqm_rate_->Rate());
+    }
+    if (uplinks != 0)
+    {
+        paths_.Reset(uplinks);
+        multipath_.store(true, std::memory_order_relaxed);
+        LOGI("multipath") << "Multipath connect over " << uplinks << " uplinks";
+    }
+}
+
+std::string ClientPipeline::ResumeTicket() const
+{
+    std::lock_guard<std::mutex> lk(ticket_mtx_);
+    return resume_ticket_;
+}
+
+void ClientPipeline::LogStats()
+{
+    if (Multipath())
+    {
+        {
+            std::lock_guard<std::mutex> lk(reorder_mtx_);
+            const ReorderBuffer::Stats &rs = reorder_.GetStats();
+            LOGI("multipath") << "Reorder: in_order=" << rs.in_order << " reordered=" << rs.reordered
+                              << " late=" << rs.late << " skipped=" << rs.skipped
+                              << " max_depth=" << rs.max_depth;
+        }
+        for (unsigned i = 0; i < paths_.Paths(); ++i)
+        {
+            PathScheduler::PathStats ps;
+            if (paths_.GetStats(i, &ps))
+            {
+                LOGI("multipath") << "Path " << i << ": up=" << ps.up << " srtt=" << ps.srtt_us << "us"
+                                  << " capacity=" << ps.capacity_kbps << "kbps"
+                                  << " tx=" << ps.tx_packets << " rx=" << ps.rx_packets
+                                  << " lost=" << ps.lost;
+            }
+        }
+    }
+    if (fec_tx_)
+    {
+        std::scoped_lock lk(fec_tx_mtx_, fec_rx_mtx_);
+        const FecEncoder::Stats &ts = fec_tx_->GetStats();
+        const FecDecoder::Stats &rs = fec_rx_->GetStats();
+        LOGI("fec") << "Tx: sources=" << ts.sources << " repairs=" << ts.repairs << " m=" << ts.m
+                    << " peer_loss=" << ts.peer_loss_ppm << "ppm; Rx: sources=" << rs.sources
+                    << " repairs=" << rs.repairs << " recovered=" << rs.recovered
+                    << " unrecovered=" << rs.unrecovered << " loss=" << rs.loss_ppm << "ppm";
+    }
+    if (agg_)
+    {
+        std::lock_guard<std::mutex> lk(agg_mtx_);
+        const Aggregator::Stats &gs = agg_->GetStats();
+        LOGI("aggregation") << "Packets=" << gs.packets << " frames=" << gs.frames
+                            << " bundles=" << gs.bundles << " bundled=" << gs.bundled
+                            << " singles=" << gs.singles << " expired=" << gs.expired;
+    }
+    if (compress_tx_)
+    {
+        std::scoped_lock lk(compress_tx_mtx_, compress_rx_mtx_);
+        const Compressor::Stats &cs = compress_tx_->GetStats();
+        const Decompressor::Stats &ds = compress_rx_->GetStats();
+        LOGI("compression") << "Tx: packets=" << cs.packets << " compressed=" << cs.compressed
+                            << " bytes=" << cs.bytes_in << "->" << cs.bytes_out
+                            << " entropy_skip=" << cs.skipped_entropy << " off_skip=" << cs.skipped_off
+                            << " flows_off=" << cs.flows_off << " dicts=" << cs.dict_acks << "/" << cs.dict_sets
+                            << "; Rx: frames=" << ds.frames << " bytes=" << ds.bytes_in << "->" << ds.bytes_out
+                            << " no_dict=" << ds.no_dict << " malformed=" << ds.malformed;
+        const HeaderDecompressor::Stats &hr = header_rx_->GetStats();
+        if (header_tx_)
+        {
+            const HeaderCompressor::Stats &ht = header_tx_->GetStats();
+            LOGI("compression") << "Headers tx: packets=" << ht.packets << " compressed=" << ht.compressed
+                                << " contexts=" << ht.contexts << " skipped=" << ht.skipped
+                                << " bytes=" << ht.bytes_in << "->" << ht.bytes_out
+                                << " refs=" << ht.acks << "/" << ht.refs;
+        }
+        LOGI("compression") << "Headers rx: frames=" << hr.frames << " contexts=" << hr.contexts
+                            << " bytes=" << hr.bytes_in << "->" << hr.bytes_out
+                            << " no_context=" << hr.no_context << " stale=" << hr.stale
+                            << " malformed=" << hr.malformed;
+    }
+    if (gro_)
+    {
+        std::lock_guard<std::mutex> lk(gro_mtx_);
+        const Gro::Stats &rs = gro_->GetStats();
+        LOGI("gro") << "Packets=" << rs.packets << " coalesced=" << rs.coalesced
+                    << " supers=" << rs.supers << " passthrough=" << rs.passthrough
+                    << " bad_csum=" << rs.bad_csum << " expired=" << rs.expired;
+    }
+    if (aqm_)
+    {
+        std::lock_guard<std::mutex> lk(aqm_mtx_);
+        const FqCodel::Stats &as = aqm_->GetStats();
+        LOGI("aqm") << "FQ-CoDel: dequeued=" << as.dequeued << " codel_drops=" << as.codel_drops
+                    << " ecn_marks=" << as.ecn_marks << " overlimit=" << as.overlimit_drops
+                    << " new_flows=" << as.new_flows << " max_sojourn=" << as.max_sojourn_us << "us"
+                    << " rate=" << aqm_->Rate() << "kbps";
+    }
+    if (shaper_)
+    {
+        std::lock_guard<std::mutex> lk(aqm_mtx_);
+        for (std::size_t i = 0; i < shaper_->Classes(); ++i)
+        {
+            Shaper::ClassStats cs;
+            if (shaper_->GetClassStats(i, &cs))
+            {
+                LOGI("shaper") << "Class " << shaper_->ClassName(i) << ": packets=" << cs.packets
+                               << " bytes=" << cs.bytes << " borrowed=" << cs.borrowed
+                               << " drops=" << cs.drops << " backlog=" << cs.backlog;
+            }
+        }
+    }
+    if (prio_)
+    {
+        std::lock_guard<std::mutex> lk(aqm_mtx_);
+        for (unsigned b = 0; b < prio_->Bands(); ++b)
+        {
+            PriorityQueue::BandStats bs;
+            if (prio_->GetBandStats(b, &bs))
+            {
+                LOGI("priority") << "Band " << b << ": enqueued=" << bs.enqueued << " dequeued=" << bs.dequeued
+                                 << " dropped=" << bs.dropped << " aged=" << bs.aged
+                                 << " max_wait=" << bs.max_wait_us << "us backlog=" << bs.backlog;
+            }
+        }
+    }
+    if (gap_queue_.Dropped() != 0)
+    {
+        LOGD("tun") << "Gap queue dropped total=" << gap_queue_.Dropped();
+    }
+}
+
+ssize_t ClientPipeline::WintunWrite(const std::uint8_t *buf,
+                                    std::size_t len)
+{
+    BYTE *out = Wintun.AllocSend(sess_, static_cast<DWORD>(len));
+    if (!out)
+    {
+        LOGW("tun") << "AllocSend returned null (drop)";
+        return 0;
+    }
+    std::memcpy(out, buf, len);
+    Wintun.Send(sess_, out);
+    LOGT("tun") << "TO_NET len=" << len;
+    return static_cast<ssize_t>(len);
+}
+
+ssize_t ClientPipeline::WriteTun(const std::uint8_t *buf,
+                                 std::size_t len)
+{
+    DebugPacketInfo(buf, len, "TO_NET");
+    capture_.Tap(buf, len, PacketCapture::Direction::Inbound);
+    if (!gro_)
+    {
+        return WintunWrite(buf, len);
+    }
+    // Под мьютексом: удержанное потока уходит в Push раньше этого пакета.
+    std::lock_guard<std::mutex> lk(gro_mtx_);
+    if (gro_->Push(buf, len, Gro::Clock::now()))
+    {
+        return static_cast<ssize_t>(len);
+    }
+    return WintunWrite(buf, len);
+}
+
+void ClientPipeline::PollGro()
+{
+    if (!gro_)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lk(gro_mtx_);
+    gro_->Poll(Gro::Clock::now());
+}
+
+void ClientPipeline::ExpireReorder()
+{
+    if (!reorder_pending_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lk(reorder_mtx_);
+    reorder_.Expire(ReorderBuffer::Clock::now());
+    reorder_pending_.store(reorder_.Held() != 0, std::memory_order_relaxed);
+}
+
+bool ClientPipeline::Inflate(const std::uint8_t *frame,
+                             std::size_t len,
+                             const std::uint8_t **pkt,
+                             std::size_t *pkt_len)
+{
+    CoreFrame::Type type;
+    const std::uint8_t *payload = nullptr;
+    std::size_t payload_len = 0;
+    bool ok = compress_rx_ && CoreFrame::Parse(frame, len, &type, &payload, &payload_len);
+    if (ok && type == CoreFrame::Type::Compressed)
+    {
+        ok = compress_rx_->Decompress(payload, payload_len, pkt, pkt_len);
+    }
+    else if (ok && type == CoreFrame::Type::Header)
+    {
+        ok = header_rx_->Decompress(payload, payload_len, pkt, pkt_len);
+    }
+    else
+    {
+        ok = false;
+    }
+    if (!ok)
+    {
+        LOGD("client") << "Undecodable compressed frame len=" << len << " (drop)";
+        return false;
+    }
+    return true;
+}
+
+void ClientPipeline::HandleCoreFrame(const std::uint8_t *buf,
+                                     std::size_t len)
+{
+    CoreFrame::Type type;
+    const std::uint8_t *payload = nullptr;
+    std::size_t payload_len = 0;
+    if (!CoreFrame::Parse(buf, len, &type, &payload, &payload_len))
+    {
+        LOGD("client") << "Malformed core frame len=" << len << " (drop)";
+        return;
+    }
+    switch (type)
+    {
+        case CoreFrame::Type::Ticket:
+        {
+            std::lock_guard<std::mutex> lk(ticket_mtx_);
+            resume_ticket_.assign(reinterpret_cast<const char *>(payload), payload_len);
+            LOGD("client") << "Resumption ticket received (" << payload_len << " bytes)";
+            liveness_.Arm();
+            break;
+        }
+        case CoreFrame::Type::Ack:
+            if (Multipath())
+                paths_.OnAck(payload, payload_len);
+            else
+                liveness_.OnAck(payload, payload_len);
+            break;
+        case CoreFrame::Type::Seq:
+        {
+            std::uint32_t seq = 0;
+            const std::uint8_t *pkt = nullptr;
+            std::size_t pkt_len = 0;
+            if (!CoreFrame::ParseSeq(payload, payload_len, &seq, &pkt, &pkt_len))
+            {
+                LOGD("client") << "Malformed seq frame (drop)";
+                break;
+            }
+            // Сжатый пакет распаковывается до окна; буфер распаковщика занят, пока окно его копирует.
+            std::unique_lock<std::mutex> clk(compress_rx_mtx_, std::defer_lock);
+            if (CoreFrame::IsCoreFrame(pkt, pkt_len))
+            {
+                clk.lock();
+                if (!Inflate(pkt, pkt_len, &pkt, &pkt_len))
+                    break;
+            }
+            std::lock_guard<std::mutex> lk(reorder_mtx_);
+            reorder_.Push(seq, pkt, pkt_len, ReorderBuffer::Clock::now());
+            if (reorder_.Held() != 0)
+                reorder_pending_.store(true, std::memory_order_relaxed);
+            break;
+        }
+        case CoreFrame::Type::Fec:
+            if (fec_rx_)
+            {
+                std::lock_guard<std::mutex> lk(fec_rx_mtx_);
+                fec_rx_->Push(payload, payload_len, FecDecoder::Clock::now());
+            }
+            break;
+        case CoreFrame::Type::FecReport:
+            if (fec_tx_)
+            {
+                std::lock_guard<std::mutex> lk(fec_tx_mtx_);
+                fec_tx_->OnReport(payload, payload_len);
+            }
+            break;
+        case CoreFrame::Type::Compressed:
+        case CoreFrame::Type::Header:
+        {
+            std::lock_guard<std::mutex> lk(compress_rx_mtx_);
+            const std::uint8_t *pkt = nullptr;
+            std::size_t pkt_len = 0;
+            if (Inflate(buf, len, &pkt, &pkt_len))
+                WriteTun(pkt, pkt_len);
+            break;
+        }
+        case CoreFrame::Type::DictAck:
+            if (compress_tx_)
+            {
+                std::lock_guard<std::mutex> lk(compress_tx_mtx_);
+                compress_tx_->OnAck(payload, payload_len);
+            }
+            break;
+        case CoreFrame::Type::HeaderAck:
+            if (header_tx_)
+            {
+                std::lock_guard<std::mutex> lk(compress_tx_mtx_);
+                header_tx_->OnAck(payload, payload_len);
+            }
+            break;
+        default:
+            LOGT("client") << "Unknown core frame type=" << static_cast<int>(type);
+            break;
+    }
+}
+
+void ClientPipeline::DeliverInner(const std::uint8_t *buf,
+                                  std::size_t len)
+{
+    // Вызывается под fec_rx_mtx_: вложенный Fec заблокировал бы его, поэтому из кадров — только Seq, Compressed, Header.
+    auto deliver = [this](const std::uint8_t *pkt, std::size_t pkt_len)
+    {
+        if (!CoreFrame::IsCoreFrame(pkt, pkt_len))
+            WriteTun(pkt, pkt_len);
+        else if (pkt[1] == static_cast<std::uint8_t>(CoreFrame::Type::Seq) ||
+                 pkt[1] == static_cast<std::uint8_t>(CoreFrame::Type::Compressed) ||
+                 pkt[1] == static_cast<std::uint8_t>(CoreFrame::Type::Header))
+            HandleCoreFrame(pkt, pkt_len);
+    };
+    if (CoreFrame::IsCoreFrame(buf, len) && buf[1] == static_cast<std::uint8_t>(CoreFrame::Type::Bundle))
+    {
+        if (!Aggregator::Unbundle(buf, len, deliver))
+            LOGD("client") << "Malformed bundle len=" << len << " (drop)";
+    }
+    else
+    {
+        deliver(buf, len);
+    }
+}
+
+void ClientPipeline::HandleBundle(const std::uint8_t *buf,
+                                  std::size_t len)
+{
+    const bool ok = Aggregator::Unbundle(buf, len, [this](const std::uint8_t *pkt, std::size_t pkt_len)
+    {
+        if (CoreFrame::IsCoreFrame(pkt, pkt_len))
+            HandleCoreFrame(pkt, pkt_len);
+        else
+            WriteTun(pkt, pkt_len);
+    });
+    if (!ok)
+    {
+        LOGD("client") << "Malformed bundle len=" << len << " (drop)";
+    }
+}
+
+std::size_t ClientPipeline::PollFec(std::uint8_t *buf,
+                                    std::size_t size)
+{
+    if (!fec_tx_)
+    {
+        return 0;
+    }
+    const auto now = FecEncoder::Clock::now();
+    {
+        std::lock_guard<std::mutex> lk(fec_tx_mtx_);
+        if (const std::size_t n = fec_tx_->Poll(buf, size, now))
+        {
+            return n;
+        }
+    }
+    std::lock_guard<std::mutex> lk(fec_rx_mtx_);
+    return fec_rx_->Poll(buf, size, now);
+}
+
+std::size_t ClientPipeline::ProtectFec(std::uint8_t *buf,
+                                       std::size_t len,
+                                       std::size_t size)
+{
+    if (!fec_tx_)
+    {
+        return len;
+    }
+    std::lock_guard<std::mutex> lk(fec_tx_mtx_);
+    const std::size_t n = fec_tx_->Protect(buf, len, size, FecEncoder::Clock::now());
+    return n != 0 ? n : len;
+}
+
+std::size_t ClientPipeline::PollCompress(std::uint8_t *buf,
+                                         std::size_t size)
+{
+    if (!compress_rx_)
+    {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lk(compress_rx_mtx_);
+    if (const std::size_t n = compress_rx_->Poll(buf, size))
+    {
+        return n;
+    }
+    return header_rx_->Poll(buf, size);
+}
+
+std::size_t ClientPipeline::Deflate(std::uint8_t *buf,
+                                    std::size_t len,
+                                    std::size_t size)
+{
+    if (!compress_tx_)
+    {
+        return len;
+    }
+    const auto now = Compressor::Clock::now();
+    std::lock_guard<std::mutex> lk(compress_tx_mtx_);
+    const std::size_t n = compress_tx_->Compress(buf, len, size, now);
+    return n != len || !header_tx_ ? n : header_tx_->Compress(buf, len, size, now);
+}
+
+void ClientPipeline::SetEgressRate(std::uint64_t kbps)
+{
+    if (shaper_)
+        shaper_->SetRate(kbps);
+    else if (prio_)
+        prio_->SetRate(kbps);
+    else if (aqm_)
+        aqm_->SetRate(kbps);
+}
+
+std::uint64_t ClientPipeline::CurrentRtt() const
+{
+    if (!Multipath())
+    {
+        return liveness_.GetStats().srtt_us;
+    }
+    std::uint64_t best = 0;
+    for (unsigned i = 0; i < paths_.Paths(); ++i)
+    {
+        PathScheduler::PathStats ps;
+        if (paths_.GetStats(i, &ps) && ps.up && ps.srtt_us != 0 && (best == 0 || ps.srtt_us < best))
+        {
+            best = ps.srtt_us;
+        }
+    }
+    return best;
+}
+
+template <typename Stage>
+ssize_t ClientPipeline::EgressRead(Stage &stage,
+                                   std::uint8_t *buf,
+                                   std::size_t size)
+{
+    constexpr std::size_t kAqmBurst = PacketMeta::kDefaultCapacity;
+    std::lock_guard<std::mutex> lk(aqm_mtx_);
+    const auto now = std::chrono::steady_clock::now();
+    // Кольцо Wintun вычерпывается в очереди: что отбросить, решает CoDel, а не переполнение кольца.
+    // Пачка держится в кольце до конца: классификация читает метаданные, а не пакеты по одному.
+    BYTE       *pkts[kAqmBurst];
+    std::size_t lens[kAqmBurst];
+    std::size_t count = 0;
+    for (; count < kAqmBurst; ++count)
+    {
+        DWORD pkt_size = 0;
+        pkts[count] = Wintun.Recv(sess_, &pkt_size);
+        if (!pkts[count])
+            break;
+        lens[count] = pkt_size;
+    }
+    egress_meta_.Parse(pkts, lens, count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        DebugPacketMeta(egress_meta_, i, "FROM_NET");
+        if (!stage.Enqueue(pkts[i], lens[i], now, egress_meta_, i))
+            LOGW("tun") << "FROM_NET oversized pkt_size=" << lens[i] << " (drop)";
+    }
+    for (std::size_t i = 0; i < count; ++i)
+        Wintun.RecvRelease(sess_, pkts[i]);
+    if (aqm_rate_ && aqm_rate_->Due(now))
+    {
+        const std::uint64_t throttled = stage.GetStats().throttled;
+        if (aqm_rate_->Update(CurrentRtt(), throttled != aqm_throttled_, now))
+        {
+            stage.SetRate(aqm_rate_->Rate());
+            LOGD("aqm") << "Rate " << aqm_rate_->Rate() << "kbps (base rtt=" << aqm_rate_->BaseRttUs() << "us)";
+        }
+        aqm_throttled_ = throttled;
+    }
+    const std::size_t n = stage.Dequeue(buf, size, now);
+    if (n != 0)
+    {
+        LOGT("tun") << "FROM_NET (egress) len=" << n;
+    }
+    return static_cast<ssize_t>(n);
+}
+
+ssize_t ClientPipeline::NextTun(std::uint8_t *buf,
+                                std::size_t size)
+{
+    if (!gap_queue_.Empty())
+    {
+        const std::size_t n = gap_queue_.Pop(buf, size);
+        LOGT("tun") << "FROM_NET (gap queue) len=" << n;
+        return static_cast<ssize_t>(n);
+    }
+    if (shaper_)
+    {
+        return EgressRead(*shaper_, buf, size);
+    }
+    if (prio_)
+    {
+        return EgressRead(*prio_, buf, size);
+    }
+    if (aqm_)
+    {
+        return EgressRead(*aqm_, buf, size);
+    }
+
+    DWORD pkt_size = 0;
+    BYTE *pkt = Wintun.Recv(sess_, &pkt_size);
+    if (!pkt)
+    {
+        return 0;
+    }
+
+    DebugPacketInfo(pkt, pkt_size, "FROM_NET");
+
+    if (pkt_size > size)
+    {
+        LOGW("tun") << "FROM_NET oversized pkt_size=" << pkt_size << " > buf=" << size;
+        Wintun.RecvRelease(sess_, pkt);
+        return -1;
+    }
+    std::memcpy(buf, pkt, pkt_size);
+    Wintun.RecvRelease(sess_, pkt);
+    LOGT("tun") << "FROM_NET len=" << pkt_size;
+    return static_cast<ssize_t>(pkt_size);
+}
+
+ssize_t ClientPipeline::ReadTun(std::uint8_t *buf,
+                                std::size_t size)
+{
+    const ssize_t n = NextTun(buf, size);
+    if (n > 0)
+    {
+        capture_.Tap(buf, static_cast<std::size_t>(n), PacketCapture::Direction::Outbound);
+    }
+    return n;
+}
+
+ssize_t ClientPipeline::ReadCompressed(std::uint8_t *buf,
+                                       std::size_t size)
+{
+    const ssize_t n = ReadTun(buf, size);
+    if (n <= 0)
+    {
+        return n;
+    }
+    return static_cast<ssize_t>(Deflate(buf, static_cast<std::size_t>(n), size));
+}
+
+ssize_t ClientPipeline::ReadAggregated(std::uint8_t *buf,
+                                       std::size_t size)
+{
+    if (!agg_)
+    {
+        return ReadCompressed(buf, size);
+    }
+    std::lock_guard<std::mutex> lk(agg_mtx_);
+    for (;;)
+    {
+        const auto now = Aggregator::Clock::now();
+        if (const std::size_t n = agg_->Poll(buf, size, now))
+        {
+            return static_cast<ssize_t>(n);
+        }
+        const ssize_t n = ReadCompressed(buf, size);
+        if (n <= 0 || !agg_->Offer(buf, static_cast<std::size_t>(n), now))
+        {
+            return n;
+        }
+    }
+}
+
+ssize_t ClientPipeline::ReceiveFromPath(unsigned *path,
+                                        std::uint8_t *buf,
+                                        std::size_t size)
+{
+    ExpireReorder();
+    PollGro();
+    // Пробы путей идут и под нагрузкой: RTT нужен планировщику.
+    if (const std::size_t probe = paths_.Poll(path, buf, size))
+    {
+        return static_cast<ssize_t>(probe);
+    }
+    if (const std::size_t fec = PollFec(buf, size))
+    {
+        *path = paths_.Pick(fec);
+        return static_cast<ssize_t>(fec);
+    }
+    if (const std::size_t ack = PollCompress(buf, size))
+    {
+        *path = paths_.Pick(ack);
+        return static_cast<ssize_t>(ack);
+    }
+    if (size <= CoreFrame::kSeqHeaderSize)
+    {
+        return -1;
+    }
+    // Пакет читается сразу за заголовком Seq: сервер восстановит порядок между путями.
+    const ssize_t n = ReadCompressed(buf + CoreFrame::kSeqHeaderSize, size - CoreFrame::kSeqHeaderSize);
+    if (n <= 0)
+    {
+        return n;
+    }
+    const std::size_t framed = CoreFrame::BuildSeqHeader(tx_seq_.fetch_add(1, std::memory_order_relaxed),
+                                                         static_cast<std::size_t>(n), buf);
+    // FEC — снаружи Seq: восстановленный пакет сервер тоже поставит по порядку.
+    const std::size_t out = ProtectFec(buf, framed, size);
+    *path = paths_.Pick(out);
+    return static_cast<ssize_t>(out);
+}
+
+ssize_t ClientPipeline::ReceiveFromBand(unsigned *band,
+                                        std::uint8_t *buf,
+                                        std::size_t size)
+{
+    const unsigned bands = PriorityBands();
+    ExpireReorder();
+    PollGro();
+    if (const std::size_t fec = PollFec(buf, size))
+    {
+        // Ремонт FEC нужен, пока пакеты группы ещё в пути, но не раньше реального времени.
+        *band = PriorityQueue::DscpBand(0, bands);
+        return static_cast<ssize_t>(fec);
+    }
+    if (const std::size_t ack = PollCompress(buf, size))
+    {
+        *band = PriorityQueue::DscpBand(0, bands);
+        return static_cast<ssize_t>(ack);
+    }
+    // Полосы читают ReadTun, а не ReadCompressed: полоса — по DSCP несжатого пакета.
+    const ssize_t n = ReadTun(buf, size);
+    if (n == 0)
+    {
+        // Проба keepalive меряет RTT — в очереди транспорта ей стоять нельзя.
+        *band = 0;
+        return static_cast<ssize_t>(liveness_.Poll(buf, size));
+    }
+    if (n < 0)
+    {
+        return n;
+    }
+    // Полоса — по внутреннему пакету, до сжатия и обёртки FEC (Band только читает правила).
+    const auto len = static_cast<std::size_t>(n);
+    *band = prio_ ? prio_->Band(buf, len)
+                  : PriorityQueue::DscpBand(PriorityQueue::PacketDscp(buf, len), bands);
+    return static_cast<ssize_t>(ProtectFec(buf, Deflate(buf, len, size), size));
+}
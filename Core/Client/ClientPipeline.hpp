@@ -0,0 +1,317 @@
+#pragma once
+// ClientPipeline.hpp — стадии пакетов клиента: Wintun -> сервер (очереди выдачи, сжатие, сборка, FEC) и обратно.
+
+#include "Core/TUN.hpp"
+#include "Core/PathApi.hpp"
+#include "Core/PriorityApi.hpp"
+#include "Core/PacketQueue.hpp"
+#include "Core/ReorderBuffer.hpp"
+#include "Core/Fec.hpp"
+#include "Core/Aggregator.hpp"
+#include "Core/Compressor.hpp"
+#include "Core/HeaderCompressor.hpp"
+#include "Core/Gro.hpp"
+#include "Core/FqCodel.hpp"
+#include "Core/Shaper.hpp"
+#include "Core/PriorityQueue.hpp"
+#include "Core/PacketMeta.hpp"
+#include "Core/PacketCapture.hpp"
+#include "Liveness.hpp"
+#include "PathScheduler.hpp"
+#include "AutoRate.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Путь пакетов клиента между кольцом Wintun и плагином.
+ *
+ * - Wintun -> сервер: gap-очередь, затем очередь выдачи (Shaper, PriorityQueue
+ *   или FqCodel с AutoRate), точка захвата, сжатие (нагрузка, иначе заголовок),
+ *   сборка мелких пакетов в Bundle (только одноканальный цикл), нумерация Seq
+ *   (многопутевой цикл) и FEC снаружи всего. В простое — keepalive-проба.
+ * - Сервер -> Wintun: служебные кадры (тикет, Ack, Seq через окно порядка,
+ *   Fec через декодер, Compressed/Header через распаковщики, подтверждения
+ *   словарей), Bundle — по пакетам; пакеты — через точку захвата и склейку Gro.
+ *
+ * Стадии соответствуют методам SessionRouter на стороне сервера. У каждой
+ * стадии своё состояние под своим мьютексом: плагин зовёт колбэки приёма и
+ * отправки из разных потоков. Одноканальный цикл — ReceiveFromNet/SendToNet,
+ * многопутевой — PathApi, с полосами — PriorityApi.
+ *
+ * BeginConnect/Connected/LogStats вызываются, пока Serve не идёт.
+ */
+class ClientPipeline
+{
+public:
+    /**
+     * @brief Параметры стадий (разобранные из конфига клиента).
+     */
+    struct Options
+    {
+        /// @brief MTU туннеля: размер слотов очередей и буферов распаковки.
+        std::size_t mtu = 1400;
+        /// @brief Ёмкость gap-очереди (пакеты между сессиями плагина).
+        std::size_t gap_queue = 1024;
+        /// @brief Окно порядка пронумерованных пакетов сервера (многопутевой режим).
+        ReorderBuffer::Options reorder;
+        /// @brief FEC в обе стороны.
+        bool fec = false;
+        FecEncoder::Options fec_tx;
+        FecDecoder::Options fec_rx;
+        /// @brief Сборка мелких пакетов к серверу в кадры Bundle.
+        bool aggregation = false;
+        Aggregator::Options agg;
+        /// @brief Сжатие к серверу (и распаковка его сжатых ответов).
+        bool compression = false;
+        /// @brief Сжимать и заголовки пакетов, чья нагрузка не сжалась.
+        bool compression_headers = true;
+        Compressor::Options compress_tx;
+        /// @brief Склейка TCP-сегментов сервера перед Wintun.
+        bool gro = false;
+        Gro::Options gro_opts;
+        /// @brief FQ-CoDel на выдаче (без шейпера и полос) и подстройка скорости по RTT.
+        bool aqm = false;
+        bool aqm_auto = false;
+        FqCodel::Options aqm_opts;
+        AutoRate::Options rate;
+    };
+
+    /**
+     * @brief Собрать стадии.
+     * @param sess     Сессия Wintun (живёт дольше конвейера).
+     * @param liveness Пробы одноканального режима.
+     * @param paths    Планировщик многопутевого режима.
+     * @param capture  Точка захвата пакетов туннеля.
+     * @param shaper   Шейпер выдачи (nullptr — нет); взаимоисключён с prio.
+     * @param prio     Полосы приоритета выдачи (nullptr — нет).
+     * @throw std::invalid_argument Некорректные Options стадий.
+     */
+    ClientPipeline(const Options                 &opts,
+                   WINTUN_SESSION_HANDLE          sess,
+                   Liveness                      &liveness,
+                   PathScheduler                 &paths,
+                   PacketCapture                 &capture,
+                   std::unique_ptr<Shaper>        shaper = nullptr,
+                   std::unique_ptr<PriorityQueue> prio   = nullptr);
+
+    ClientPipeline(const ClientPipeline &) = delete;
+    ClientPipeline &operator=(const ClientPipeline &) = delete;
+
+    /**
+     * @brief Следующий кадр к серверу одноканального цикла: служебное FEC и сжатия, затем пакет
+     *        (через сборщик и FEC), в простое — проба.
+     * @return Длина; 0 — слать нечего; -1 — буфер мал.
+     */
+    ssize_t ReceiveFromNet(std::uint8_t *buf, std::size_t size);
+
+    /**
+     * @brief Кадр от сервера: служебный — обработать, Bundle — по пакетам, пакет — в Wintun.
+     */
+    ssize_t SendToNet(const std::uint8_t *buf, std::size_t len);
+
+    /**
+     * @brief Колбэки для Client_ServeMultipath (пакеты нумеруются, путь выбирает планировщик).
+     */
+    ClientPathApi PathApi();
+
+    /**
+     * @brief Колбэки для Client_ServePriority (полоса — по внутреннему пакету).
+     */
+    ClientPriorityApi PriorityApi();
+
+    /** @brief Число полос для Client_ServePriority: без полос приоритета — kDefaultBands по DSCP. */
+    unsigned PriorityBands() const noexcept { return prio_ ? prio_->Bands() : PriorityQueue::kDefaultBands; }
+
+    /**
+     * @brief Перекачать Wintun в gap-очередь (плагин не обслуживает трафик).
+     */
+    void PumpGap();
+
+    /**
+     * @brief Начало попытки соединения: многопутевой режим снимается до её итога.
+     */
+    void BeginConnect() noexcept { multipath_.store(false, std::memory_order_relaxed); }
+
+    /**
+     * @brief Соединение установлено: сбросить нумерацию, FEC, сборку, сжатие, скорость выдачи;
+     *        удержанное склейкой — в Wintun.
+     * @param uplinks Каналов многопутевого режима (0 — одноканальное соединение).
+     */
+    void Connected(unsigned uplinks);
+
+    /** @brief Идёт ли многопутевое соединение. */
+    bool Multipath() const noexcept { return multipath_.load(std::memory_order_relaxed); }
+
+    /** @brief Последний тикет возобновления от сервера (пустой — не было). */
+    std::string ResumeTicket() const;
+
+    /**
+     * @brief Записать в журнал счётчики стадий соединения.
+     */
+    void LogStats();
+
+private:
+    Options               opts_;
+    WINTUN_SESSION_HANDLE sess_;
+    Liveness             &liveness_;
+    PathScheduler        &paths_;
+    PacketCapture        &capture_;
+
+    // Пакеты, прочитанные из Wintun в «окне» между сессиями плагина; вычитываются первыми.
+    PacketQueue       gap_queue_;
+    std::atomic<bool> multipath_{false};
+
+    std::mutex           gro_mtx_;
+    std::unique_ptr<Gro> gro_;                       ///< nullptr — склейка выключена.
+
+    std::mutex                 reorder_mtx_;
+    ReorderBuffer              reorder_;
+    std::atomic<bool>          reorder_pending_{false};
+    std::atomic<std::uint32_t> tx_seq_{0};
+
+    std::mutex                  fec_tx_mtx_;
+    std::mutex                  fec_rx_mtx_;
+    std::unique_ptr<FecEncoder> fec_tx_;             ///< nullptr — FEC выключен (тогда и fec_rx_).
+    std::unique_ptr<FecDecoder> fec_rx_;
+
+    std::mutex                          compress_tx_mtx_;
+    std::mutex                          compress_rx_mtx_;
+    std::unique_ptr<Compressor>         compress_tx_;   ///< nullptr — сжатие выключено.
+    std::unique_ptr<Decompressor>       compress_rx_;
+    std::unique_ptr<HeaderCompressor>   header_tx_;     ///< nullptr без compression_headers.
+    std::unique_ptr<HeaderDecompressor> header_rx_;
+
+    mutable std::mutex ticket_mtx_;
+    std::string        resume_ticket_;
+
+    // Очередь выдачи (под aqm_mtx_): действует одна из shaper_, prio_, aqm_.
+    std::mutex                     aqm_mtx_;
+    std::unique_ptr<Shaper>        shaper_;
+    std::unique_ptr<PriorityQueue> prio_;
+    std::unique_ptr<FqCodel>       aqm_;
+    std::unique_ptr<AutoRate>      aqm_rate_;
+    std::uint64_t                  aqm_throttled_ = 0;   ///< throttled на прошлом шаге AutoRate.
+    PacketMeta                     egress_meta_;         ///< Метаданные пачки из кольца Wintun.
+
+    std::mutex                  agg_mtx_;
+    std::unique_ptr<Aggregator> agg_;                ///< nullptr — сборка выключена.
+
+    /**
+     * @brief Пакет в кольцо Wintun (без склейки).
+     * @return Длина; 0 — кольцо полно.
+     */
+    ssize_t WintunWrite(const std::uint8_t *buf, std::size_t len);
+
+    /**
+     * @brief Пакет сервера в Wintun: точка захвата, затем склейка, если она включена.
+     */
+    ssize_t WriteTun(const std::uint8_t *buf, std::size_t len);
+
+    /**
+     * @brief Вытолкнуть удержанное склейкой по сроку.
+     */
+    void PollGro();
+
+    /**
+     * @brief Выпустить из окна порядка пакеты, чьё удержание истекло.
+     */
+    void ExpireReorder();
+
+    /**
+     * @brief Кадр Compressed или Header -> IP-пакет в буфере распаковщика (звать под compress_rx_mtx_).
+     * @return false — кадр не восстанавливается (отброшен).
+     */
+    bool Inflate(const std::uint8_t *frame, std::size_t len, const std::uint8_t **pkt, std::size_t *pkt_len);
+
+    /**
+     * @brief Служебный кадр от сервера.
+     */
+    void HandleCoreFrame(const std::uint8_t *buf, std::size_t len);
+
+    /**
+     * @brief Пакет, вынутый из блока FEC: IP-пакет, кадр Seq, Compressed, Header или Bundle из них.
+     */
+    void DeliverInner(const std::uint8_t *buf, std::size_t len);
+
+    /**
+     * @brief Кадр Bundle: вложенные пакеты и кадры по одному, как если бы они пришли отдельно.
+     */
+    void HandleBundle(const std::uint8_t *buf, std::size_t len);
+
+    /**
+     * @brief Служебное FEC к серверу: избыточные символы закрытых блоков, затем отчёт о потерях.
+     * @return Длина кадра; 0 — слать нечего.
+     */
+    std::size_t PollFec(std::uint8_t *buf, std::size_t size);
+
+    /**
+     * @brief Обернуть кадр к серверу в блок FEC (на месте).
+     * @return Новая длина; без FEC — прежняя.
+     */
+    std::size_t ProtectFec(std::uint8_t *buf, std::size_t len, std::size_t size);
+
+    /**
+     * @brief Подтверждения словарей и опор заголовков сервера (DictAck, HeaderAck).
+     * @return Длина кадра; 0 — слать нечего.
+     */
+    std::size_t PollCompress(std::uint8_t *buf, std::size_t size);
+
+    /**
+     * @brief Сжать пакет к серверу (на месте): нагрузку, а если она не сжалась — заголовок.
+     * @return Новая длина; без сжатия или без выигрыша — прежняя.
+     */
+    std::size_t Deflate(std::uint8_t *buf, std::size_t len, std::size_t size);
+
+    /**
+     * @brief Скорость выдачи действующей очереди (под aqm_mtx_).
+     */
+    void SetEgressRate(std::uint64_t kbps);
+
+    /**
+     * @brief RTT до сервера для AutoRate: keepalive, в многопутевом режиме — лучший из живых путей.
+     */
+    std::uint64_t CurrentRtt() const;
+
+    /**
+     * @brief Пачка из кольца Wintun в очередь выдачи stage, затем пакет из неё.
+     * @return Длина; 0 — очереди пусты или скорость исчерпана.
+     */
+    template <typename Stage>
+    ssize_t EgressRead(Stage &stage, std::uint8_t *buf, std::size_t size);
+
+    /**
+     * @brief Следующий пакет из Wintun: сначала gap-очередь, затем очередь выдачи (если есть).
+     * @return Длина; 0 — читать нечего; -1 — буфер мал.
+     */
+    ssize_t NextTun(std::uint8_t *buf, std::size_t size);
+
+    /**
+     * @brief NextTun через точку захвата: всё, что уходит в туннель, — в порядке отправки.
+     */
+    ssize_t ReadTun(std::uint8_t *buf, std::size_t size);
+
+    /**
+     * @brief Пакет к серверу после сжатия.
+     */
+    ssize_t ReadCompressed(std::uint8_t *buf, std::size_t size);
+
+    /**
+     * @brief Кадр к серверу через сборщик: готовый Bundle или пакет, не подходящий для сборки.
+     */
+    ssize_t ReadAggregated(std::uint8_t *buf, std::size_t size);
+
+    /**
+     * @brief Кадр к серверу многопутевого цикла: пробы путей, служебное, пакет в кадре Seq.
+     */
+    ssize_t ReceiveFromPath(unsigned *path, std::uint8_t *buf, std::size_t size);
+
+    /**
+     * @brief Кадр к серверу цикла с полосами: полоса — по внутреннему пакету до сжатия.
+     */
+    ssize_t ReceiveFromBand(unsigned *band, std::uint8_t *buf, std::size_t size);
+};
@@ -0,0 +1,228 @@
+// Liveness.cpp — реализация keepalive/RTT/dead-peer.
+
+#include "Liveness.hpp"
+#include "Core/Logger.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    /// @brief Нагрузка пробы: seq (BE32) + метка отправки в мкс (BE64).
+    constexpr std::size_t kProbePayload = 12;
+
+    /// @brief Гранулярность часов G из RFC 6298.
+    constexpr auto kClockGranularity = std::chrono::milliseconds(1);
+
+    template <typename D>
+    std::uint64_t ToUs(D d) noexcept
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+}
+
+Liveness::Liveness(const Options &opts,
+                   DeadFn         dead)
+    : opts_(opts)
+    , dead_(std::move(dead))
+    , rto_(opts.initial_rto)
+{
+    if (opts_.idle.count() <= 0 || opts_.min_rto.count() <= 0 ||
+        opts_.max_rto < opts_.min_rto || opts_.dead_after == 0)
+    {
+        throw std::invalid_argument("Liveness: invalid options");
+    }
+    rto_ = std::clamp<Clock::duration>(rto_, opts_.min_rto, opts_.max_rto);
+    stats_.rto_us = ToUs(rto_);
+    last_rx_ = Clock::now();
+    armed_   = !opts_.await_peer;
+}
+
+void Liveness::Reset()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    outstanding_      = false;
+    consecutive_lost_ = 0;
+    armed_            = !opts_.await_peer;
+    muted_            = false;
+    stats_.dead       = false;
+    seen_activity_    = activity_.load(std::memory_order_relaxed);
+    last_rx_          = Clock::now();
+    // После разрыва путь мог смениться: RTO заново из SRTT, без накопленного backoff.
+    if (srtt_.count() != 0)
+    {
+        rto_ = std::clamp<Clock::duration>(srtt_ + std::max<Clock::duration>(kClockGranularity, 4 * rttvar_),
+                                           opts_.min_rto, opts_.max_rto);
+    }
+    else
+    {
+        rto_ = std::clamp<Clock::duration>(opts_.initial_rto, opts_.min_rto, opts_.max_rto);
+    }
+    stats_.rto_us = ToUs(rto_);
+}
+
+void Liveness::NoteActivityLocked(Clock::time_point now)
+{
+    last_rx_ = now;
+    consecutive_lost_ = 0;
+}
+
+void Liveness::SampleLocked(Clock::duration rtt)
+{
+    if (srtt_.count() == 0)
+    {
+        // 2.2: первый замер.
+        srtt_   = rtt;
+        rttvar_ = rtt / 2;
+    }
+    else
+    {
+        // 2.3: beta = 1/4, alpha = 1/8.
+        const Clock::duration diff = srtt_ > rtt ? srtt_ - rtt : rtt - srtt_;
+        rttvar_ = (3 * rttvar_ + diff) / 4;
+        srtt_   = (7 * srtt_ + rtt) / 8;
+    }
+    rto_ = std::clamp<Clock::duration>(srtt_ + std::max<Clock::duration>(kClockGranularity, 4 * rttvar_),
+                                       opts_.min_rto, opts_.max_rto);
+
+    stats_.srtt_us   = ToUs(srtt_);
+    stats_.rttvar_us = ToUs(rttvar_);
+    stats_.rto_us    = ToUs(rto_);
+}
+
+std::size_t Liveness::Poll(std::uint8_t *out,
+                           std::size_t size)
+{
+    if (!opts_.enabled)
+    {
+        return 0;
+    }
+
+    const auto now = Clock::now();
+    bool declare_dead = false;
+    std::size_t frame_len = 0;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+
+        const std::uint64_t activity = activity_.load(std::memory_order_relaxed);
+        if (activity != seen_activity_)
+        {
+            seen_activity_ = activity;
+            NoteActivityLocked(now);
+        }
+
+        if (outstanding_ && now - probe_sent_ >= rto_)
+        {
+            // 5.5: таймаут — backoff RTO; замер по этой пробе уже не берём (Karn).
+            outstanding_ = false;
+            ++stats_.lost;
+            ++consecutive_lost_;
+            rto_ = std::min<Clock::duration>(rto_ * 2, opts_.max_rto);
+            stats_.rto_us = ToUs(rto_);
+            LOGD("liveness") << "Probe " << seq_ << " lost (consecutive=" << consecutive_lost_
+                             << ", rto=" << stats_.rto_us / 1000 << "ms)";
+
+            if (consecutive_lost_ >= opts_.dead_after && !armed_ && !muted_)
+            {
+                // Ни одного ответа и ни одного служебного кадра: сервер проб не понимает.
+                muted_ = true;
+                LOGI("liveness") << "Server does not answer probes: keepalive off for this connection";
+            }
+            else if (consecutive_lost_ >= opts_.dead_after && armed_ && !stats_.dead)
+            {
+                stats_.dead  = true;
+                declare_dead = true;
+            }
+        }
+
+        const bool idle = now - last_rx_ >= opts_.idle;
+        const bool due  = opts_.interval.count() > 0 && now - probe_sent_ >= opts_.interval;
+        if (!stats_.dead && !muted_ && !outstanding_ && (idle || due || consecutive_lost_ != 0))
+        {
+            std::uint8_t payload[kProbePayload];
+            const std::uint32_t seq = (static_cast<std::uint32_t>(opts_.tag) << 24) | ((seq_ + 1) & 0x00FFFFFFu);
+            seq_ = seq;
+            const std::uint64_t ts  = ToUs(now.time_since_epoch());
+            for (int i = 0; i < 4; ++i)
+            {
+                payload[i] = static_cast<std::uint8_t>(seq >> (24 - 8 * i));
+            }
+            for (int i = 0; i < 8; ++i)
+            {
+                payload[4 + i] = static_cast<std::uint8_t>(ts >> (56 - 8 * i));
+            }
+            frame_len = CoreFrame::Build(CoreFrame::Type::Probe, payload, sizeof(payload), out, size);
+            if (frame_len != 0)
+            {
+                outstanding_ = true;
+                probe_sent_  = now;
+                ++stats_.probes;
+                LOGT("liveness") << "Probe " << seq << " sent";
+            }
+        }
+    }
+
+    if (declare_dead)
+    {
+        LOGW("liveness") << "Peer dead: " << opts_.dead_after << " probes unanswered";
+        if (dead_)
+        {
+            dead_("peer is not responding to keepalive probes");
+        }
+    }
+    return frame_len;
+}
+
+void Liveness::OnAck(const std::uint8_t *payload,
+                     std::size_t len)
+{
+    OnActivity();
+    if (len != kProbePayload)
+    {
+        return;
+    }
+    std::uint32_t seq = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        seq = (seq << 8) | payload[i];
+    }
+
+    const auto now = Clock::now();
+    std::lock_guard<std::mutex> lk(mtx_);
+    ++stats_.acks;
+    armed_ = true;
+    muted_ = false;
+    NoteActivityLocked(now);
+    if (outstanding_ && seq == seq_)
+    {
+        outstanding_ = false;
+        SampleLocked(now - probe_sent_);
+        LOGT("liveness") << "Ack " << seq << " rtt=" << ToUs(now - probe_sent_) << "us srtt=" << stats_.srtt_us << "us";
+    }
+}
+
+void Liveness::Arm()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    armed_ = true;
+    muted_ = false;
+}
+
+bool Liveness::AckTag(const std::uint8_t *payload,
+                      std::size_t len,
+                      std::uint8_t *tag) noexcept
+{
+    if (len != kProbePayload)
+    {
+        return false;
+    }
+    *tag = payload[0];
+    return true;
+}
+
+Liveness::Stats Liveness::GetStats() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return stats_;
+}
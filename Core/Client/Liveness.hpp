@@ -0,0 +1,156 @@
+#pragma once
+// Liveness.hpp — keepalive-пробы в простое, оценка RTT (RFC 6298) и обнаружение мёртвого пира.
+
+#include "Core/CoreFrame.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+/**
+ * @brief Контроль живости туннеля.
+ *
+ * - Пока от сервера идут пакеты, Liveness ничего не шлёт: входящий трафик сам
+ *   доказывает живость, а горячий путь платит одним relaxed-инкрементом (OnActivity).
+ * - После idle без входящих пакетов шлётся проба (CoreFrame::Type::Probe);
+ *   сервер отвечает Ack с той же нагрузкой.
+ * - По ответам считаются SRTT/RTTVAR/RTO по RFC 6298; проба без ответа за RTO
+ *   считается потерянной, RTO удваивается (до max_rto), сразу уходит следующая.
+ * - dead_after потерь подряд без какого-либо входящего трафика — пир мёртв,
+ *   вызывается колбэк (обычно Reconnect::Fail).
+ * - Пир мёртв, только если сервер уже показал, что понимает служебные кадры
+ *   (пришёл Ticket или Ack, см. Arm; Options::await_peer). Старый сервер (Server_Serve) пробы не
+ *   понимает и не отвечает: после dead_after потерь пробы до следующего
+ *   соединения не шлются, туннель не рвётся.
+ *
+ * Poll вызывается только когда читать нечего (простой), поэтому часы
+ * при активном трафике не читаются вовсе.
+ */
+class Liveness
+{
+public:
+    /**
+     * @brief Параметры контроля живости.
+     */
+    struct Options
+    {
+        /** @brief Включён ли контроль. */
+        bool enabled = true;
+        /** @brief Сколько ждать входящего трафика, прежде чем послать пробу. */
+        std::chrono::milliseconds idle{2000};
+        /** @brief RTO до первого измерения. */
+        std::chrono::milliseconds initial_rto{1000};
+        /** @brief Нижняя граница RTO. */
+        std::chrono::milliseconds min_rto{200};
+        /** @brief Верхняя граница RTO. */
+        std::chrono::milliseconds max_rto{10000};
+        /** @brief Потерянных проб подряд до объявления пира мёртвым. */
+        unsigned dead_after = 4;
+        /** @brief Пробовать не реже этого и при активном трафике — ради замеров RTT (0 — только в простое). */
+        std::chrono::milliseconds interval{0};
+        /** @brief Старший байт seq проб: по нему ответ находит свой путь (PathScheduler). */
+        std::uint8_t tag = 0;
+        /** @brief Объявлять пира мёртвым только после его первого служебного кадра (Arm, Ack). */
+        bool await_peer = true;
+    };
+
+    /**
+     * @brief Снимок счётчиков.
+     */
+    struct Stats
+    {
+        std::uint64_t srtt_us   = 0;   ///< Сглаженный RTT (0 — ещё не измерен).
+        std::uint64_t rttvar_us = 0;   ///< Разброс RTT.
+        std::uint64_t rto_us    = 0;   ///< Текущий таймаут пробы.
+        std::uint64_t probes    = 0;   ///< Отправлено проб.
+        std::uint64_t acks      = 0;   ///< Получено ответов.
+        std::uint64_t lost      = 0;   ///< Проб без ответа за RTO.
+        bool          dead      = false;
+    };
+
+    /** @brief Колбэк «пир мёртв» (вызывается один раз на соединение, вне блокировок). */
+    using DeadFn = std::function<void(const char *reason)>;
+
+    /**
+     * @brief Создать контроль живости.
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    Liveness(const Options &opts, DeadFn dead);
+
+    Liveness(const Liveness &) = delete;
+    Liveness &operator=(const Liveness &) = delete;
+
+    /**
+     * @brief Начать новое соединение: сбросить пробы и признак смерти (SRTT сохраняется).
+     */
+    void Reset();
+
+    /**
+     * @brief Отметить входящий пакет от сервера (горячий путь).
+     */
+    void OnActivity() noexcept { activity_.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Проверить таймеры в простое и, если пора, собрать пробу.
+     * @param out  Буфер для кадра пробы.
+     * @param size Размер буфера.
+     * @return Длина кадра для отправки серверу; 0 — слать нечего.
+     */
+    std::size_t Poll(std::uint8_t *out, std::size_t size);
+
+    /**
+     * @brief Обработать служебный кадр Ack.
+     */
+    void OnAck(const std::uint8_t *payload, std::size_t len);
+
+    /**
+     * @brief Сервер понимает служебные кадры (пришёл Ticket): потери проб ведут к объявлению смерти.
+     *
+     * Ack делает то же сам; Reset снимает признак.
+     */
+    void Arm();
+
+    /**
+     * @brief Тег пробы, на которую отвечает Ack (Options::tag отправителя).
+     * @return false — нагрузка не от пробы Liveness.
+     */
+    static bool AckTag(const std::uint8_t *payload, std::size_t len, std::uint8_t *tag) noexcept;
+
+    /** @brief Снимок счётчиков. */
+    Stats GetStats() const;
+
+    /** @brief Включён ли контроль. */
+    bool Enabled() const noexcept { return opts_.enabled; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Options opts_;
+    DeadFn  dead_;
+
+    std::atomic<std::uint64_t> activity_{0};
+
+    mutable std::mutex mtx_;
+    std::uint64_t      seen_activity_ = 0;
+    Clock::time_point  last_rx_;
+    Clock::time_point  probe_sent_;
+    bool               outstanding_ = false;
+    std::uint32_t      seq_ = 0;
+    unsigned           consecutive_lost_ = 0;
+    bool               armed_ = false;    ///< Сервер отвечает на служебные кадры.
+    bool               muted_ = false;    ///< Пробы без ответа до Arm: сервер их не понимает.
+
+    Clock::duration    srtt_{0};
+    Clock::duration    rttvar_{0};
+    Clock::duration    rto_;
+    Stats              stats_;
+
+    /// @brief Учесть входящую активность (под mtx_).
+    void NoteActivityLocked(Clock::time_point now);
+
+    /// @brief Обновить SRTT/RTTVAR/RTO по замеру (RFC 6298, 2.2–2.4).
+    void SampleLocked(Clock::duration rtt);
+};
@@ -19,7 +19,6 @@
 #include "NetWatcher.hpp"
 #include "Core/Logger.hpp"
 
-#include <cassert>
 #include <utility>
 
 namespace
@@ -58,9 +57,11 @@ namespace
 
 // ---- NetWatcher ----
 
-NetWatcher::NetWatcher(ReapplyFn reapply,
+NetWatcher::NetWatcher(TimerService &timers,
+                       ReapplyFn reapply,
                        std::chrono::milliseconds debounce)
-    : debounce_ms_(static_cast<unsigned>(debounce.count()))
+    : timers_(&timers)
+    , debounce_ms_(static_cast<unsigned>(debounce.count()))
     , reapply_(std::move(reapply))
 {
     LOGD("netwatcher") << "ctor: debounce_ms=" << debounce_ms_;
@@ -94,9 +95,13 @@ NetWatcher &NetWatcher::operator=(NetWatcher &&other) noexcept
         LOGT("netwatcher") << "move-assign";
         try { StopCore(); } catch (...) { LOGW("netwatcher") << "move-assign: StopCore swallowed exception"; }
 
-        h_stop_        = other.h_stop_;        other.h_stop_ = nullptr;
-        h_kick_        = other.h_kick_;        other.h_kick_ = nullptr;
-        h_thread_      = other.h_thread_;      other.h_thread_ = nullptr;
+        // Колбэк таймера держит other: снимаем его, следующий Kick поставит новый.
+        if (other.timers_)
+        {
+            try { other.timers_->CancelWait(other.debounce_timer_); } catch (...) { LOGW("netwatcher") << "move-assign: CancelWait swallowed exception"; }
+        }
+        timers_        = other.timers_;
+        debounce_timer_ = TimerService::kNoTimer; other.debounce_timer_ = TimerService::kNoTimer;
         h_if_notif_    = other.h_if_notif_;    other.h_if_notif_ = nullptr;
         h_route_notif_ = other.h_route_notif_; other.h_route_notif_ = nullptr;
 
@@ -116,8 +121,22 @@ bool NetWatcher::IsRunning() const noexcept
 void NetWatcher::Kick() noexcept
 {
     const ULONGLONG until = suppress_until_ms_.load(std::memory_order_relaxed);
-    if (NowMs() < until) { return; }
-    if (h_kick_) { ::SetEvent(H(h_kick_)); }
+    if (NowMs() < until || !started_) { return; }
+    try
+    {
+        std::lock_guard<std::mutex> lk(timer_mtx_);
+        const auto debounce = std::chrono::milliseconds(debounce_ms_);
+        // Новый «пинок» во время ожидания — ждём «тишину» заново.
+        if (!timers_->Restart(debounce_timer_, debounce))
+        {
+            debounce_timer_ = timers_->After(debounce, [this] { OnDebounce(); });
+            LOGT("netwatcher") << "Kick: debounce armed, " << debounce_ms_ << "ms";
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOGW("netwatcher") << "Kick: " << e.what();
+    }
 }
 
 void NetWatcher::Suppress(std::chrono::milliseconds dur) noexcept
@@ -132,67 +151,22 @@ void NetWatcher::Stop()
     StopCore();
 }
 
-unsigned long __stdcall NetWatcher::ThreadMain(void *param)
+void NetWatcher::OnDebounce()
 {
-    auto *w = reinterpret_cast<NetWatcher *>(param);
-    assert(w);
-    LOGD("netwatcher") << "ThreadMain: started";
-
-    HANDLE wait_set[2] = {H(w->h_stop_), H(w->h_kick_)};
-
-    for (;;)
+    try
     {
-        DWORD dw = ::WaitForMultipleObjects(2, wait_set, FALSE, INFINITE);
-        if (dw == WAIT_OBJECT_0)
+        LOGI("netwatcher") << "OnDebounce: debounce timeout -> reapply()";
+        if (reapply_)
         {
-            LOGD("netwatcher") << "ThreadMain: stop signaled";
-            break; // stop
-        }
-        if (dw == WAIT_OBJECT_0 + 1)
-        {
-            LOGT("netwatcher") << "ThreadMain: kick received, debounce=" << w->debounce_ms_ << "ms";
-            // коалессация: ждём «тишину»
-            for (;;)
-            {
-                DWORD dw2 = ::WaitForMultipleObjects(2, wait_set, FALSE, w->debounce_ms_);
-                if (dw2 == WAIT_OBJECT_0)
-                {
-                    LOGD("netwatcher") << "ThreadMain: stop during debounce";
-                    return 0; // остановка
-                }
-                else if (dw2 == WAIT_TIMEOUT)
-                {
-                    try
-                    {
-                        LOGI("netwatcher") << "ThreadMain: debounce timeout -> reapply()";
-                        if (w->reapply_)
-                        {
-                            // Не ловим собственные Notify* в течение окна дебаунса
-                            w->Suppress(std::chrono::milliseconds(w->debounce_ms_));
-                            w->reapply_();
-                        }
-                    }
-                    catch (...)
-                    {
-                        LOGE("netwatcher") << "ThreadMain: reapply() threw, swallowed";
-                    }
-                    break;
-                }
-                else if (dw2 == WAIT_OBJECT_0 + 1)
-                {
-                    LOGT("netwatcher") << "ThreadMain: extra kick during debounce";
-                    continue; // новый «kick» — ждём ещё
-                }
-                else
-                {
-                    LOGW("netwatcher") << "ThreadMain: unexpected WaitForMultipleObjects result=" << dw2;
-                    break;
-                }
-            }
+            // Не ловим собственные Notify* в течение окна дебаунса
+            Suppress(std::chrono::milliseconds(debounce_ms_));
+            reapply_();
         }
     }
-    LOGD("netwatcher") << "ThreadMain: exiting";
-    return 0;
+    catch (...)
+    {
+        LOGE("netwatcher") << "OnDebounce: reapply() threw, swallowed";
+    }
 }
 
 void NetWatcher::StartCore()
@@ -203,27 +177,14 @@ void NetWatcher::StartCore()
         throw std::logic_error("NetWatcher already started");
     }
     LOGD("netwatcher") << "StartCore: begin";
-
-    HANDLE h_stop = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);   // manual-reset
-    HANDLE h_kick = ::CreateEventW(nullptr, FALSE, FALSE, nullptr);  // auto-reset
-    if (!h_stop || !h_kick)
-    {
-        if (h_stop) ::CloseHandle(h_stop);
-        if (h_kick) ::CloseHandle(h_kick);
-        LOGE("netwatcher") << "StartCore: CreateEventW failed";
-        throw std::runtime_error("CreateEventW failed");
-    }
-    h_stop_ = h_stop;
-    h_kick_ = h_kick;
-    LOGT("netwatcher") << "StartCore: events created";
+    // Уведомление может прийти сразу после подписки: Kick должен его принять.
+    started_ = true;
 
     HANDLE h_if = nullptr;
     if (NotifyIpInterfaceChange(AF_UNSPEC, IpIfChangeCb, this, FALSE, &h_if) != NO_ERROR)
     {
         LOGE("netwatcher") << "StartCore: NotifyIpInterfaceChange failed";
-        ::CloseHandle(H(h_stop_));
-        ::CloseHandle(H(h_kick_));
-        h_stop_ = h_kick_ = nullptr;
+        started_ = false;
         throw std::runtime_error("NotifyIpInterfaceChange failed");
     }
     h_if_notif_ = h_if;
@@ -233,31 +194,12 @@ void NetWatcher::StartCore()
     if (NotifyRouteChange2(AF_UNSPEC, RouteChangeCb, this, FALSE, &h_route) != NO_ERROR)
     {
         LOGE("netwatcher") << "StartCore: NotifyRouteChange2 failed";
-        CancelMibChangeNotify2(h_if);
-        ::CloseHandle(H(h_stop_));
-        ::CloseHandle(H(h_kick_));
-        h_stop_ = h_kick_ = nullptr;
-        h_if_notif_ = nullptr;
+        StopCore();
         throw std::runtime_error("NotifyRouteChange2 failed");
     }
     h_route_notif_ = h_route;
     LOGT("netwatcher") << "StartCore: route change subscribed";
 
-    HANDLE th = ::CreateThread(nullptr, 0, &NetWatcher::ThreadMain, this, 0, nullptr);
-    if (!th)
-    {
-        LOGE("netwatcher") << "StartCore: CreateThread failed";
-        CancelMibChangeNotify2(h_if);
-        CancelMibChangeNotify2(h_route);
-        ::CloseHandle(H(h_stop_));
-        ::CloseHandle(H(h_kick_));
-        h_stop_ = h_kick_ = nullptr;
-        h_if_notif_ = h_route_notif_ = nullptr;
-        throw std::runtime_error("CreateThread failed");
-    }
-    h_thread_ = th;
-
-    started_ = true;
     LOGI("netwatcher") << "StartCore: started";
 }
 
@@ -272,19 +214,20 @@ void NetWatcher::StopCore()
 
     if (h_if_notif_)   { CancelMibChangeNotify2(H(h_if_notif_));   h_if_notif_ = nullptr; LOGT("netwatcher") << "StopCore: interface notify canceled"; }
     if (h_route_notif_){ CancelMibChangeNotify2(H(h_route_notif_));h_route_notif_ = nullptr; LOGT("netwatcher") << "StopCore: route notify canceled"; }
+    started_ = false;
 
-    if (h_stop_) { ::SetEvent(H(h_stop_)); LOGT("netwatcher") << "StopCore: stop event signaled"; }
-    if (h_thread_)
+    // Уведомлений больше нет; ждём reapply(), если он уже выполняется.
+    TimerService::Handle h;
     {
-        ::WaitForSingleObject(H(h_thread_), INFINITE);
-        ::CloseHandle(H(h_thread_));
-        h_thread_ = nullptr;
-        LOGT("netwatcher") << "StopCore: worker joined";
+        std::lock_guard<std::mutex> lk(timer_mtx_);
+        h = debounce_timer_;
+        debounce_timer_ = TimerService::kNoTimer;
+    }
+    if (timers_)
+    {
+        timers_->CancelWait(h);
+        LOGT("netwatcher") << "StopCore: debounce timer canceled";
     }
 
-    if (h_stop_) { ::CloseHandle(H(h_stop_)); h_stop_ = nullptr; LOGT("netwatcher") << "StopCore: stop handle closed"; }
-    if (h_kick_) { ::CloseHandle(H(h_kick_)); h_kick_ = nullptr; LOGT("netwatcher") << "StopCore: kick handle closed"; }
-
-    started_ = false;
     LOGI("netwatcher") << "StopCore: done";
 }
@@ -1,19 +1,20 @@
 #pragma once
 // NetWatcher.hpp — RAII вотчер изменений сети для Windows.
 
-#include <chrono>
-#include <functional>
-#include <stdexcept>
+#include "Core/TimerService.hpp"
+
 #include <chrono>
 #include <functional>
 #include <stdexcept>
 #include <atomic>
+#include <mutex>
 
 /**
  * @brief RAII-класс: следит за изменениями сети и вызывает колбэк после дебаунса.
  *
- * Конструктор создаёт события/подписки и запускает рабочий поток.
- * Деструктор автоматически отписывается и останавливает поток.
+ * Конструктор подписывается на изменения интерфейсов и маршрутов; каждое
+ * изменение переставляет таймер дебаунса в общем TimerService, колбэк
+ * выполняется в его потоке после «тишины». Деструктор отписывается и снимает таймер.
  */
 class NetWatcher
 {
@@ -25,12 +26,14 @@ public:
 
     /**
      * @brief Запустить вотчер.
+     * @param timers   Сервис таймеров (должен пережить вотчер).
      * @param reapply  Колбэк (может быть пустым — тогда ничего не вызовется).
      * @param debounce Интервал дебаунса (по умолчанию 1500 мс).
-     * @throw std::runtime_error Ошибка WinAPI/регистрации/создания потока.
+     * @throw std::runtime_error Ошибка WinAPI/регистрации.
      */
-    explicit NetWatcher(ReapplyFn reapply,
-                        std::chrono::milliseconds debounce = std::chrono::milliseconds(1500));
+    NetWatcher(TimerService &timers,
+               ReapplyFn reapply,
+               std::chrono::milliseconds debounce = std::chrono::milliseconds(1500));
 
     /**
      * @brief Деструктор. Останавливает вотчер; исключения подавляются.
@@ -67,7 +70,7 @@ public:
     void Stop();
 
     /**
-     * @brief Принудительно «пнуть» вотчер: просигналить событие коалессации.
+     * @brief Принудительно «пнуть» вотчер: (пере)запустить таймер дебаунса.
      */
     void Kick() noexcept;
 
@@ -79,18 +82,18 @@ public:
 
     /**
      * @brief Проверить, запущен ли вотчер.
-     * @return true, если поток и подписки активны.
+     * @return true, если подписки активны.
      */
     bool IsRunning() const noexcept;
 
 private:
-    /** @brief HANDLE (manual-reset) события остановки (как void*, без windows.h в .hpp). */
-    void *h_stop_ = nullptr;
-    /** @brief HANDLE (auto-reset) события «пинка». */
-    void *h_kick_ = nullptr;
-    /** @brief HANDLE рабочего потока. */
-    void *h_thread_ = nullptr;
-    /** @brief HANDLE подписки NotifyIpInterfaceChange. */
+    /** @brief Сервис таймеров (дебаунс). */
+    TimerService *timers_ = nullptr;
+    /** @brief Таймер дебаунса (kNoTimer — не стоит). */
+    TimerService::Handle debounce_timer_ = TimerService::kNoTimer;
+    /** @brief Защищает debounce_timer_ (Kick приходит из потоков уведомлений). */
+    std::mutex timer_mtx_;
+    /** @brief HANDLE подписки NotifyIpInterfaceChange (как void*, без windows.h в .hpp). */
     void *h_if_notif_ = nullptr;
     /** @brief HANDLE подписки NotifyRouteChange2. */
     void *h_route_notif_ = nullptr;
@@ -105,21 +108,19 @@ private:
     std::atomic<unsigned long long> suppress_until_ms_{0};
 
     /**
-     * @brief Запуск ядра: создать события, подписаться, поднять поток.
+     * @brief Запуск ядра: подписаться на изменения.
      * @throw std::runtime_error При любой ошибке WinAPI.
      */
     void StartCore();
 
     /**
-     * @brief Останов ядра: отписки, остановка потока, закрытие хендлов.
+     * @brief Останов ядра: отписки, снятие таймера (с ожиданием колбэка).
      * @throw std::runtime_error При сбоях остановки.
      */
     void StopCore();
 
     /**
-     * @brief Рабочая функция потока (LPTHREAD_START_ROUTINE).
-     * @param param this
-     * @return 0
+     * @brief Срабатывание таймера дебаунса (поток TimerService).
      */
-    static unsigned long __stdcall ThreadMain(void *param);
+    void OnDebounce();
 };
@@ -1,6 +1,9 @@
 #include "Network.hpp"
 #include "Core/Logger.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 // ============================ HELPERS ============================
 
 namespace Network
@@ -33,6 +36,112 @@ namespace
         return (ver == IpVersion::V6) ? "v6" : "v4";
     }
 
+    /// @brief Строка host-маршрута (/32 или /128) до host через интерфейс и next-hop маршрута via.
+    MIB_IPFORWARD_ROW2 make_host_row_(const char *who,
+                                      const char *host,
+                                      const MIB_IPFORWARD_ROW2 &via,
+                                      ULONG metric,
+                                      IpVersion ver)
+    {
+        if (via.DestinationPrefix.Prefix.si_family != fam(ver))
+        {
+            LOGE("tun") << who << ": family mismatch";
+            throw std::invalid_argument(std::string(who) + ": family mismatch");
+        }
+
+        MIB_IPFORWARD_ROW2 desired{};
+        InitializeIpForwardEntry(&desired);
+        desired.InterfaceLuid = via.InterfaceLuid;
+
+        desired.DestinationPrefix.Prefix.si_family = fam(ver);
+        if (ver == IpVersion::V6)
+        {
+            desired.DestinationPrefix.Prefix.Ipv6.sin6_family = AF_INET6;
+            if (!ipv6_from_string_(host, desired.DestinationPrefix.Prefix.Ipv6.sin6_addr))
+            {
+                LOGE("tun") << who << ": invalid IPv6 '" << host << "'";
+                throw std::invalid_argument(std::string(who) + ": invalid IPv6");
+            }
+            desired.DestinationPrefix.PrefixLength = 128;
+        }
+        else
+        {
+            if (!ipv4_from_string_(host, desired.DestinationPrefix.Prefix.Ipv4.sin_addr))
+            {
+                LOGE("tun") << who << ": invalid IPv4 '" << host << "'";
+                throw std::invalid_argument(std::string(who) + ": invalid IPv4");
+            }
+            desired.DestinationPrefix.PrefixLength = 32;
+        }
+
+        // next-hop: если в via задан gateway — используем его, иначе on-link
+        if (via.NextHop.si_family == fam(ver))
+        {
+            desired.NextHop = via.NextHop;
+        }
+        else
+        {
+            desired.NextHop.si_family = fam(ver);
+            if (ver == IpVersion::V6)
+            {
+                desired.NextHop.Ipv6.sin6_family = AF_INET6;
+                std::memset(&desired.NextHop.Ipv6.sin6_addr, 0, sizeof(IN6_ADDR)); // on-link
+            }
+            else
+            {
+                desired.NextHop.Ipv4.sin_addr.S_un.S_addr = 0; // 0.0.0.0 on-link
+            }
+        }
+
+        desired.Metric   = metric;
+        desired.Protocol = MIB_IPPROTO_NETMGMT;
+        return desired;
+    }
+
+    /// @brief Совпадает ли адрес назначения host-маршрута.
+    bool same_destination_(const MIB_IPFORWARD_ROW2 &row,
+                           const MIB_IPFORWARD_ROW2 &desired,
+                           IpVersion ver)
+    {
+        if (row.DestinationPrefix.Prefix.si_family != fam(ver)) return false;
+        if (row.DestinationPrefix.PrefixLength != desired.DestinationPrefix.PrefixLength) return false;
+        if (ver == IpVersion::V6)
+        {
+            return std::memcmp(&row.DestinationPrefix.Prefix.Ipv6.sin6_addr,
+                               &desired.DestinationPrefix.Prefix.Ipv6.sin6_addr,
+                               sizeof(IN6_ADDR)) == 0;
+        }
+        return row.DestinationPrefix.Prefix.Ipv4.sin_addr.S_un.S_addr ==
+               desired.DestinationPrefix.Prefix.Ipv4.sin_addr.S_un.S_addr;
+    }
+
+    /// @brief Пригоден ли адрес для bind транспорта (не link-local, не loopback, DAD пройден).
+    bool usable_local_address_(const MIB_UNICASTIPADDRESS_ROW &row)
+    {
+        if (row.DadState != IpDadStatePreferred) return false;
+        if (row.Address.si_family == AF_INET6)
+        {
+            const IN6_ADDR &a = row.Address.Ipv6.sin6_addr;
+            return !IN6_IS_ADDR_LINKLOCAL(&a) && !IN6_IS_ADDR_LOOPBACK(&a);
+        }
+        const std::uint8_t first = row.Address.Ipv4.sin_addr.S_un.S_un_b.s_b1;
+        const std::uint8_t second = row.Address.Ipv4.sin_addr.S_un.S_un_b.s_b2;
+        return first != 127 && !(first == 169 && second == 254);
+    }
+
+    std::string address_to_string_(const SOCKADDR_INET &addr)
+    {
+        char buf[INET6_ADDRSTRLEN]{};
+        const void *src = (addr.si_family == AF_INET6)
+                              ? static_cast<const void *>(&addr.Ipv6.sin6_addr)
+                              : static_cast<const void *>(&addr.Ipv4.sin_addr);
+        if (!InetNtopA(addr.si_family, src, buf, sizeof(buf)))
+        {
+            return std::string();
+        }
+        return buf;
+    }
+
     static std::string g_LOCAL4 = "10.200.0.2";
     static std::string g_PEER4  = "10.200.0.1";
     static std::string g_LOCAL6 = "fd00:dead:beef::2";
@@ -343,58 +452,7 @@ void add_or_update_host_route_via(const char *host,
                                   ULONG metric,
                                   IpVersion ver)
 {
-    if (via.DestinationPrefix.Prefix.si_family != fam(ver))
-    {
-        LOGE("tun") << "add_or_update_host_route_via: family mismatch";
-        throw std::invalid_argument("add_or_update_host_route_via: family mismatch");
-    }
-
-    MIB_IPFORWARD_ROW2 desired{};
-    InitializeIpForwardEntry(&desired);
-    desired.InterfaceLuid = via.InterfaceLuid;
-
-    desired.DestinationPrefix.Prefix.si_family = fam(ver);
-    if (ver == IpVersion::V6)
-    {
-        desired.DestinationPrefix.Prefix.Ipv6.sin6_family = AF_INET6;
-        if (!ipv6_from_string_(host, desired.DestinationPrefix.Prefix.Ipv6.sin6_addr))
-        {
-            LOGE("tun") << "add_or_update_host_route_via: invalid IPv6 '" << host << "'";
-            throw std::invalid_argument("add_or_update_host_route_via: invalid IPv6");
-        }
-        desired.DestinationPrefix.PrefixLength = 128;
-    }
-    else
-    {
-        if (!ipv4_from_string_(host, desired.DestinationPrefix.Prefix.Ipv4.sin_addr))
-        {
-            LOGE("tun") << "add_or_update_host_route_via: invalid IPv4 '" << host << "'";
-            throw std::invalid_argument("add_or_update_host_route_via: invalid IPv4");
-        }
-        desired.DestinationPrefix.PrefixLength = 32;
-    }
-
-    // next-hop: если в via задан gateway — используем его, иначе on-link
-    if (via.NextHop.si_family == fam(ver))
-    {
-        desired.NextHop = via.NextHop;
-    }
-    else
-    {
-        desired.NextHop.si_family = fam(ver);
-        if (ver == IpVersion::V6)
-        {
-            desired.NextHop.Ipv6.sin6_family = AF_INET6;
-            std::memset(&desired.NextHop.Ipv6.sin6_addr, 0, sizeof(IN6_ADDR)); // on-link
-        }
-        else
-        {
-            desired.NextHop.Ipv4.sin_addr.S_un.S_addr = 0; // 0.0.0.0 on-link
-        }
-    }
-
-    desired.Metric   = metric;
-    desired.Protocol = MIB_IPPROTO_NETMGMT;
+    MIB_IPFORWARD_ROW2 desired = make_host_row_("add_or_update_host_route_via", host, via, metric, ver);
 
     // Пытаемся обновить существующую запись /32 или /128
     PMIB_IPFORWARD_TABLE2 tbl = nullptr;
@@ -477,6 +535,192 @@ void add_or_update_host_route_via(const char *host,
     LOGI("tun") << "Host route (legacy) created/ensured: v4 " << host << " metric=" << metric;
 }
 
+void add_or_update_host_route_on_if(const char *host,
+                                    const MIB_IPFORWARD_ROW2 &via,
+                                    ULONG metric,
+                                    IpVersion ver)
+{
+    MIB_IPFORWARD_ROW2 desired = make_host_row_("add_or_update_host_route_on_if", host, via, metric, ver);
+
+    // Обновляем только запись на том же интерфейсе: маршруты через другие каналы остаются.
+    PMIB_IPFORWARD_TABLE2 tbl = nullptr;
+    if (GetIpForwardTable2(fam(ver), &tbl) == NO_ERROR)
+    {
+        for (ULONG i = 0; i < tbl->NumEntries; ++i)
+        {
+            auto &row = tbl->Table[i];
+            if (row.InterfaceLuid.Value != desired.InterfaceLuid.Value) continue;
+            if (!same_destination_(row, desired, ver))                 continue;
+
+            row.NextHop  = desired.NextHop;
+            row.Metric   = desired.Metric;
+            row.Protocol = MIB_IPPROTO_NETMGMT;
+            DWORD rc = SetIpForwardEntry2(&row);
+            FreeMibTable(tbl);
+            if (rc != NO_ERROR)
+            {
+                LOGE("tun") << "SetIpForwardEntry2(/host on if) failed rc=" << rc;
+                throw std::runtime_error("SetIpForwardEntry2(/host on if) failed");
+            }
+            LOGD("tun") << "Host route updated: " << family_tag(ver) << " " << host
+                        << " IfLuid=" << desired.InterfaceLuid.Value << " metric=" << metric;
+            return;
+        }
+        FreeMibTable(tbl);
+    }
+
+    DWORD rc = CreateIpForwardEntry2(&desired);
+    if (rc != NO_ERROR && rc != ERROR_OBJECT_ALREADY_EXISTS)
+    {
+        LOGE("tun") << "CreateIpForwardEntry2(/host on if) rc=" << rc;
+        throw std::runtime_error("CreateIpForwardEntry2(/host on if) failed");
+    }
+    LOGD("tun") << "Host route created/ensured: " << family_tag(ver) << " " << host
+                << " IfLuid=" << desired.InterfaceLuid.Value << " metric=" << metric;
+}
+
+std::vector<Uplink> list_uplinks(const NET_LUID &exclude,
+                                 IpVersion ver)
+{
+    PMIB_IPFORWARD_TABLE2 routes = nullptr;
+    DWORD rc = GetIpForwardTable2(fam(ver), &routes);
+    if (rc != NO_ERROR)
+    {
+        LOGE("tun") << "list_uplinks: GetIpForwardTable2 failed rc=" << rc;
+        throw std::runtime_error("GetIpForwardTable2 failed");
+    }
+
+    // Лучший default-маршрут каждого интерфейса.
+    std::vector<Uplink> uplinks;
+    for (ULONG i = 0; i < routes->NumEntries; ++i)
+    {
+        const auto &row = routes->Table[i];
+        if (row.InterfaceLuid.Value == exclude.Value)           continue;
+        if (row.DestinationPrefix.Prefix.si_family != fam(ver)) continue;
+        if (row.DestinationPrefix.PrefixLength != 0)            continue;
+
+        auto it = std::find_if(uplinks.begin(), uplinks.end(), [&](const Uplink &u)
+        {
+            return u.luid.Value == row.InterfaceLuid.Value;
+        });
+        if (it == uplinks.end())
+        {
+            Uplink u;
+            u.luid     = row.InterfaceLuid;
+            u.if_index = row.InterfaceIndex;
+            u.route    = row;
+            uplinks.push_back(u);
+        }
+        else if (row.Metric < it->route.Metric)
+        {
+            it->route = row;
+        }
+    }
+    FreeMibTable(routes);
+
+    PMIB_UNICASTIPADDRESS_TABLE addrs = nullptr;
+    rc = GetUnicastIpAddressTable(fam(ver), &addrs);
+    if (rc != NO_ERROR)
+    {
+        LOGE("tun") << "list_uplinks: GetUnicastIpAddressTable failed rc=" << rc;
+        throw std::runtime_error("GetUnicastIpAddressTable failed");
+    }
+    for (auto &u : uplinks)
+    {
+        for (ULONG i = 0; i < addrs->NumEntries && u.local.empty(); ++i)
+        {
+            const auto &row = addrs->Table[i];
+            if (row.InterfaceLuid.Value == u.luid.Value && usable_local_address_(row))
+            {
+                u.local = address_to_string_(row.Address);
+            }
+        }
+
+        // Итоговая метрика, как её считает стек: маршрут + интерфейс.
+        MIB_IPINTERFACE_ROW ifrow{};
+        InitializeIpInterfaceEntry(&ifrow);
+        ifrow.Family        = fam(ver);
+        ifrow.InterfaceLuid = u.luid;
+        u.metric = u.route.Metric;
+        if (GetIpInterfaceEntry(&ifrow) == NO_ERROR)
+        {
+            u.metric += ifrow.Metric;
+        }
+    }
+    FreeMibTable(addrs);
+
+    uplinks.erase(std::remove_if(uplinks.begin(), uplinks.end(), [](const Uplink &u)
+    {
+        return u.local.empty();
+    }), uplinks.end());
+    std::stable_sort(uplinks.begin(), uplinks.end(), [](const Uplink &a, const Uplink &b)
+    {
+        return a.metric < b.metric;
+    });
+
+    LOGD("tun") << "list_uplinks: " << family_tag(ver) << " found=" << uplinks.size();
+    return uplinks;
+}
+
+std::size_t pin_server_multipath(const NET_LUID &exclude,
+                                 const std::string &server_ip,
+                                 std::size_t max_paths,
+                                 IpVersion ver)
+{
+    std::vector<Uplink> uplinks = list_uplinks(exclude, ver);
+    if (uplinks.size() > max_paths)
+    {
+        uplinks.resize(max_paths);
+    }
+
+    std::size_t pinned = 0;
+    for (std::size_t i = 0; i < uplinks.size(); ++i)
+    {
+        try
+        {
+            add_or_update_host_route_on_if(server_ip.c_str(), uplinks[i].route,
+                                           static_cast<ULONG>(1 + i), ver);
+            ++pinned;
+            LOGI("tun") << "Pinned " << family_tag(ver) << " host route to " << server_ip
+                        << " via uplink " << i << " (IfLuid=" << uplinks[i].luid.Value
+                        << ", local=" << uplinks[i].local << ")";
+        }
+        catch (const std::exception &e)
+        {
+            LOGW("tun") << "Uplink " << i << " pin failed: " << e.what();
+        }
+    }
+
+    // Пины на интерфейсах, выпавших из набора (канал пропал или ушёл за max_paths).
+    PMIB_IPFORWARD_TABLE2 tbl = nullptr;
+    if (pinned != 0 && GetIpForwardTable2(fam(ver), &tbl) == NO_ERROR)
+    {
+        const MIB_IPFORWARD_ROW2 probe = make_host_row_("pin_server_multipath", server_ip.c_str(),
+                                                        uplinks.front().route, 0, ver);
+        std::vector<MIB_IPFORWARD_ROW2> stale;
+        for (ULONG i = 0; i < tbl->NumEntries; ++i)
+        {
+            const auto &row = tbl->Table[i];
+            if (row.Protocol != MIB_IPPROTO_NETMGMT) continue;
+            if (!same_destination_(row, probe, ver)) continue;
+            const bool in_set = std::any_of(uplinks.begin(), uplinks.end(), [&](const Uplink &u)
+            {
+                return u.luid.Value == row.InterfaceLuid.Value;
+            });
+            if (!in_set) stale.push_back(row);
+        }
+        FreeMibTable(tbl);
+        for (auto &row : stale)
+        {
+            const DWORD rc = DeleteIpForwardEntry2(&row);
+            LOGD("tun") << "Stale server pin removed IfLuid=" << row.InterfaceLuid.Value << " rc=" << rc;
+        }
+    }
+
+    LOGI("tun") << "Multipath pin: " << family_tag(ver) << " " << pinned << "/" << uplinks.size() << " uplinks";
+    return pinned;
+}
+
 void add_route_via_gateway(const NET_LUID &ifLuid,
                            const char *prefix,
                            UINT8 prefixLen,
@@ -548,7 +792,8 @@ void add_route_via_gateway(const NET_LUID &ifLuid,
 
 void ConfigureNetwork(WINTUN_ADAPTER_HANDLE adapter,
                       const std::string &server_ip,
-                      IpVersion ver)
+                      IpVersion ver,
+                      std::size_t max_paths)
 {
     if (!adapter)
     {
@@ -582,7 +827,15 @@ void ConfigureNetwork(WINTUN_ADAPTER_HANDLE adapter,
     const bool need_pin = ((ver == IpVersion::V6) == server_is_v6);
     bool pinned = false;
 
-    if (need_pin)
+    if (need_pin && max_paths > 1)
+    {
+        pinned = pin_server_multipath(luid, server_ip, max_paths, ver) != 0;
+        if (!pinned)
+        {
+            LOGW("tun") << "No " << family_tag(ver) << " uplinks to server before switch";
+        }
+    }
+    else if (need_pin)
     {
         auto best = get_best_route_to_generic(server_ip.c_str(), ver);
         if (!best)
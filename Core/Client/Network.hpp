@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <string>
 #include <stdexcept>
+#include <vector>
 
 #include "Core/TUN.hpp"
 
@@ -133,6 +134,63 @@ void add_or_update_host_route_via(const char *host,
                                   ULONG metric,
                                   IpVersion ver);
 
+/**
+ * @brief Добавляет/обновляет pinned-маршрут до хоста только на интерфейсе via (IPv4/IPv6).
+ *        В отличие от add_or_update_host_route_via не трогает маршруты до того же хоста
+ *        через другие интерфейсы — для многопутевого режима.
+ * @param host   Целевой хост.
+ * @param via    Default-маршрут интерфейса.
+ * @param metric Метрика.
+ * @param ver    Версия IP.
+ * @throw std::invalid_argument Невалидный адрес или несоответствие семейства.
+ * @throw std::runtime_error    Ошибка WinAPI.
+ */
+void add_or_update_host_route_on_if(const char *host,
+                                    const MIB_IPFORWARD_ROW2 &via,
+                                    ULONG metric,
+                                    IpVersion ver);
+
+/**
+ * @brief Физический канал выхода в сеть (Wi-Fi, LTE, Ethernet).
+ */
+struct Uplink
+{
+    NET_LUID           luid{};        ///< Интерфейс.
+    NET_IFINDEX        if_index = 0;  ///< Индекс интерфейса.
+    MIB_IPFORWARD_ROW2 route{};       ///< Default-маршрут интерфейса (через него пинуется сервер).
+    ULONG              metric = 0;    ///< Метрика маршрута + метрика интерфейса.
+    std::string        local;         ///< Локальный адрес (для bind сокета транспорта на этот канал).
+};
+
+/**
+ * @brief Перечисляет каналы с default-маршрутом, исключая указанный интерфейс (VPN).
+ *        По одному на интерфейс, по возрастанию итоговой метрики; каналы без
+ *        пригодного локального адреса пропускаются.
+ * @param exclude Интерфейс, который нужно исключить.
+ * @param ver     Версия IP.
+ * @return Список каналов (может быть пустым).
+ * @throw std::runtime_error Ошибка WinAPI.
+ */
+std::vector<Uplink> list_uplinks(const NET_LUID &exclude,
+                                 IpVersion ver);
+
+/**
+ * @brief Пинует маршрут до сервера сразу через несколько каналов (метрики 1, 2, ...).
+ *        Pinned-маршруты до сервера на прочих интерфейсах снимаются. При strong host
+ *        model Windows сокет, привязанный к Uplink::local, уходит через свой канал.
+ * @param exclude   Интерфейс VPN.
+ * @param server_ip IP-адрес сервера.
+ * @param max_paths Сколько каналов задействовать (первые по метрике).
+ * @param ver       Версия IP.
+ * @return Сколько каналов запинено (0 — ни одного).
+ * @throw std::invalid_argument Невалидный адрес.
+ * @throw std::runtime_error    Ошибка WinAPI.
+ */
+std::size_t pin_server_multipath(const NET_LUID &exclude,
+                                 const std::string &server_ip,
+                                 std::size_t max_paths,
+                                 IpVersion ver);
+
 /**
  * @brief Добавляет маршрут по префиксу через указанный gateway (IPv4/IPv6).
  * @param ifLuid    Интерфейс.
@@ -157,12 +215,14 @@ void add_route_via_gateway(const NET_LUID &ifLuid,
  * @param adapter  Хэндл адаптера Wintun.
  * @param server_ip IP-адрес сервера (IPv4/IPv6 строкой).
  * @param ver      Какое семейство настраивать.
+ * @param max_paths Больше 1 — многопутевой режим: пин через несколько каналов (pin_server_multipath).
  * @throw std::invalid_argument Невалидные аргументы.
  * @throw std::runtime_error    Ошибки WinAPI/настройки.
  */
 void ConfigureNetwork(WINTUN_ADAPTER_HANDLE adapter,
                       const std::string &server_ip,
-                      IpVersion ver);
+                      IpVersion ver,
+                      std::size_t max_paths = 1);
 
 /**
  * @brief Параметры адресного плана интерфейса VPN.
@@ -0,0 +1,299 @@
+// PathScheduler.cpp — реализация многопутевого планировщика.
+
+#include "PathScheduler.hpp"
+#include "Core/Logger.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    /// @brief Окно с меньшим объёмом не снижает оценку скорости (путь мог просто простаивать).
+    constexpr std::uint64_t kMinSampleBytes = 16 * 1024;
+
+    /// @brief Номер пути кодируется в байте тега пробы.
+    constexpr unsigned kMaxPaths = 255;
+
+    template <typename D>
+    std::int64_t ToUs(D d) noexcept
+    {
+        return static_cast<std::int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+}
+
+PathScheduler::PathScheduler(const Options &opts,
+                             Liveness::DeadFn all_dead)
+    : opts_(opts)
+    , all_dead_(std::move(all_dead))
+    , min_capacity_(static_cast<double>(opts.min_capacity_kbps) * 1000.0 / 8.0)
+{
+    if (opts_.max_paths == 0 || opts_.max_paths > kMaxPaths || opts_.min_capacity_kbps == 0 ||
+        opts_.capacity_window.count() <= 0 || opts_.retry.count() <= 0 || opts_.rtt_interval.count() <= 0)
+    {
+        throw std::invalid_argument("PathScheduler: invalid options");
+    }
+}
+
+void PathScheduler::Reset(unsigned paths)
+{
+    if (paths == 0)
+    {
+        throw std::invalid_argument("PathScheduler: no paths");
+    }
+    paths = std::min(paths, opts_.max_paths);
+
+    const auto now = Clock::now();
+    std::vector<std::unique_ptr<Path>> fresh;
+    fresh.reserve(paths);
+    for (unsigned i = 0; i < paths; ++i)
+    {
+        Liveness::Options lo = opts_.probe;
+        lo.tag        = static_cast<std::uint8_t>(i);
+        lo.interval   = opts_.rtt_interval;
+        lo.await_peer = false;   // многопутевость — только с сервером, понимающим пробы: молчащий путь мёртв
+
+        auto p = std::make_unique<Path>();
+        p->liveness = std::make_unique<Liveness>(lo, [this, i](const char *reason)
+        {
+            MarkDead(i, reason);
+        });
+        p->backlog_at   = now;
+        p->window_start = now;
+        p->capacity     = min_capacity_;
+        fresh.push_back(std::move(p));
+    }
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    paths_ = std::move(fresh);
+    poll_next_ = 0;
+    next_poll_us_.store(0, std::memory_order_relaxed);
+    LOGI("multipath") << "Scheduler reset: paths=" << paths;
+}
+
+unsigned PathScheduler::Pick(std::size_t len)
+{
+    const auto now = Clock::now();
+    const double fallback_rtt_us = static_cast<double>(ToUs(opts_.probe.initial_rto));
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    unsigned best = static_cast<unsigned>(paths_.size());
+    double best_delay = std::numeric_limits<double>::infinity();
+    for (unsigned i = 0; i < paths_.size(); ++i)
+    {
+        Path &p = *paths_[i];
+        if (!p.up)
+        {
+            continue;
+        }
+        // Виртуальная очередь тает со скоростью канала.
+        const double elapsed = std::chrono::duration<double>(now - p.backlog_at).count();
+        p.backlog    = std::max(0.0, p.backlog - elapsed * p.capacity);
+        p.backlog_at = now;
+
+        const double rtt_us = p.srtt_us != 0 ? static_cast<double>(p.srtt_us) : fallback_rtt_us;
+        const double delay  = rtt_us / 2 + (p.backlog + static_cast<double>(len)) * 1e6 / p.capacity;
+        if (delay < best_delay)
+        {
+            best_delay = delay;
+            best       = i;
+        }
+    }
+    if (best < paths_.size())
+    {
+        Path &p = *paths_[best];
+        p.backlog += static_cast<double>(len);
+        ++p.stats.tx_packets;
+        p.stats.tx_bytes += len;
+        return best;
+    }
+    return 0;
+}
+
+void PathScheduler::OnReceive(unsigned path,
+                              std::size_t len)
+{
+    if (path >= paths_.size())
+    {
+        return;
+    }
+    Path &p = *paths_[path];
+    p.liveness->OnActivity();
+
+    const auto now = Clock::now();
+    std::lock_guard<std::mutex> lk(mtx_);
+    ++p.stats.rx_packets;
+    p.stats.rx_bytes += len;
+    p.window_bytes   += len;
+
+    const auto window = now - p.window_start;
+    if (window >= opts_.capacity_window)
+    {
+        const double rate = static_cast<double>(p.window_bytes) / std::chrono::duration<double>(window).count();
+        if (rate > p.capacity)
+        {
+            p.capacity = (p.capacity + 3 * rate) / 4;
+        }
+        else if (p.window_bytes >= kMinSampleBytes)
+        {
+            p.capacity = std::max(min_capacity_, (7 * p.capacity + rate) / 8);
+        }
+        p.window_bytes = 0;
+        p.window_start = now;
+    }
+}
+
+void PathScheduler::OnAck(const std::uint8_t *payload,
+                          std::size_t len)
+{
+    std::uint8_t tag = 0;
+    if (!Liveness::AckTag(payload, len, &tag) || tag >= paths_.size())
+    {
+        return;
+    }
+    Path &p = *paths_[tag];
+    p.liveness->OnAck(payload, len);
+    const Liveness::Stats ls = p.liveness->GetStats();
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    p.srtt_us = ls.srtt_us;
+    if (!p.up && !ls.dead)
+    {
+        p.up         = true;
+        p.backlog    = 0;
+        p.backlog_at = Clock::now();
+        LOGI("multipath") << "Path " << static_cast<unsigned>(tag) << " is back (srtt=" << ls.srtt_us << "us)";
+    }
+}
+
+void PathScheduler::SetUp(unsigned path,
+                          bool up)
+{
+    if (path >= paths_.size())
+    {
+        return;
+    }
+    Path &p = *paths_[path];
+    if (up)
+    {
+        p.liveness->Reset();
+    }
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (p.up == up)
+    {
+        return;
+    }
+    p.up = up;
+    if (up)
+    {
+        p.backlog    = 0;
+        p.backlog_at = Clock::now();
+    }
+    else
+    {
+        p.down_since = Clock::now();
+    }
+    LOGI("multipath") << "Path " << path << (up ? " up" : " down") << " (transport)";
+}
+
+std::size_t PathScheduler::Poll(unsigned *path,
+                                std::uint8_t *out,
+                                std::size_t size)
+{
+    if (!opts_.probe.enabled || paths_.empty())
+    {
+        return 0;
+    }
+    // На горячем пути — не чаще раза в четверть min_rto: проба нужна и путям без трафика.
+    const auto now = Clock::now();
+    const std::int64_t now_us = ToUs(now.time_since_epoch());
+    if (now_us < next_poll_us_.load(std::memory_order_relaxed))
+    {
+        return 0;
+    }
+
+    const unsigned n = static_cast<unsigned>(paths_.size());
+    unsigned first = 0;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        first = poll_next_;
+    }
+    for (unsigned k = 0; k < n; ++k)
+    {
+        const unsigned i = (first + k) % n;
+        Path &p = *paths_[i];
+        bool retry = false;
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            if (!p.up && now - p.down_since >= opts_.retry)
+            {
+                p.down_since = now;
+                retry = true;
+            }
+        }
+        if (retry)
+        {
+            LOGD("multipath") << "Path " << i << ": probing again";
+            p.liveness->Reset();
+        }
+
+        const std::size_t frame_len = p.liveness->Poll(out, size);
+        if (frame_len != 0)
+        {
+            // Остальным путям — на следующем вызове, без ожидания периода.
+            *path = i;
+            std::lock_guard<std::mutex> lk(mtx_);
+            poll_next_ = (i + 1) % n;
+            const Liveness::Stats ls = p.liveness->GetStats();
+            p.stats.probes = ls.probes;
+            p.stats.lost   = ls.lost;
+            return frame_len;
+        }
+    }
+    next_poll_us_.store(now_us + ToUs(opts_.probe.min_rto) / 4, std::memory_order_relaxed);
+    return 0;
+}
+
+void PathScheduler::MarkDead(unsigned path,
+                             const char *reason)
+{
+    bool all_down = true;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (path < paths_.size() && paths_[path]->up)
+        {
+            paths_[path]->up         = false;
+            paths_[path]->down_since = Clock::now();
+            LOGW("multipath") << "Path " << path << " down: " << reason;
+        }
+        for (const auto &p : paths_)
+        {
+            all_down = all_down && !p->up;
+        }
+    }
+    if (all_down && all_dead_)
+    {
+        all_dead_("all paths are down");
+    }
+}
+
+bool PathScheduler::GetStats(unsigned path,
+                             PathStats *out) const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!out || path >= paths_.size())
+    {
+        return false;
+    }
+    const Path &p = *paths_[path];
+    *out = p.stats;
+    const Liveness::Stats ls = p.liveness->GetStats();
+    out->up            = p.up;
+    out->srtt_us       = ls.srtt_us;
+    out->probes        = ls.probes;
+    out->lost          = ls.lost;
+    out->capacity_kbps = static_cast<std::uint64_t>(p.capacity * 8.0 / 1000.0);
+    return true;
+}
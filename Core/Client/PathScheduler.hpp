@@ -0,0 +1,152 @@
+#pragma once
+// PathScheduler.hpp — распределение пакетов по нескольким каналам (lowest-delay-first).
+
+#include "Liveness.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Планировщик многопутевого режима.
+ *
+ * - Каждый путь — отдельный Liveness: свои пробы (в простое и раз в rtt_interval
+ *   под нагрузкой), SRTT и признак смерти.
+ *   Старший байт seq пробы — номер пути, поэтому Ack находит свой путь,
+ *   каким бы каналом сервер его ни вернул.
+ * - Пакет уходит путём с наименьшей ожидаемой задержкой доставки:
+ *   SRTT/2 + (очередь пути + пакет) / пропускная способность. Очередь —
+ *   виртуальная: растёт на отправленные байты и тает со скоростью канала.
+ * - Пропускная способность — оценка по входящему трафику пути (быстро вверх,
+ *   медленно вниз), не ниже min_capacity_kbps.
+ * - Мёртвый путь выводится из ротации и раз в retry пробуется заново;
+ *   когда мертвы все — вызывается колбэк (обычно Reconnect::Fail).
+ *
+ * Reset вызывается, пока Serve не идёт; остальные методы — из потоков плагина.
+ */
+class PathScheduler
+{
+public:
+    /**
+     * @brief Параметры планировщика.
+     */
+    struct Options
+    {
+        /** @brief Максимум одновременно используемых каналов. */
+        unsigned max_paths = 4;
+        /** @brief Нижняя граница оценки пропускной способности, кбит/с. */
+        std::uint64_t min_capacity_kbps = 1000;
+        /** @brief Окно замера входящей скорости. */
+        std::chrono::milliseconds capacity_window{100};
+        /** @brief Через сколько снова пробовать мёртвый путь. */
+        std::chrono::milliseconds retry{5000};
+        /** @brief Период замера RTT пути под нагрузкой. */
+        std::chrono::milliseconds rtt_interval{1000};
+        /** @brief Параметры проб каждого пути (tag и interval выставляет планировщик). */
+        Liveness::Options probe;
+    };
+
+    /**
+     * @brief Снимок счётчиков пути.
+     */
+    struct PathStats
+    {
+        bool          up            = false;
+        std::uint64_t srtt_us       = 0;   ///< 0 — ещё не измерен.
+        std::uint64_t capacity_kbps = 0;   ///< Текущая оценка.
+        std::uint64_t tx_packets    = 0;
+        std::uint64_t tx_bytes      = 0;
+        std::uint64_t rx_packets    = 0;
+        std::uint64_t rx_bytes      = 0;
+        std::uint64_t probes        = 0;
+        std::uint64_t lost          = 0;
+    };
+
+    /**
+     * @brief Создать планировщик (без путей до первого Reset).
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    PathScheduler(const Options &opts, Liveness::DeadFn all_dead);
+
+    PathScheduler(const PathScheduler &) = delete;
+    PathScheduler &operator=(const PathScheduler &) = delete;
+
+    /**
+     * @brief Новое соединение с paths путями (не больше max_paths); все пути подняты.
+     * @throw std::invalid_argument paths == 0.
+     */
+    void Reset(unsigned paths);
+
+    /** @brief Число путей текущего соединения. */
+    unsigned Paths() const noexcept { return static_cast<unsigned>(paths_.size()); }
+
+    /**
+     * @brief Выбрать путь для пакета длиной len и учесть его в очереди пути.
+     * @return Номер пути; если все пути лежат — 0.
+     */
+    unsigned Pick(std::size_t len);
+
+    /**
+     * @brief Пакет от сервера пришёл по пути path.
+     */
+    void OnReceive(unsigned path, std::size_t len);
+
+    /**
+     * @brief Служебный кадр Ack (путь определяется по тегу пробы).
+     */
+    void OnAck(const std::uint8_t *payload, std::size_t len);
+
+    /**
+     * @brief Плагин сообщил о состоянии транспорта пути.
+     */
+    void SetUp(unsigned path, bool up);
+
+    /**
+     * @brief Если пора — собрать пробу какого-либо пути.
+     * @param path Путь, которым отправить пробу.
+     * @param out  Буфер для кадра.
+     * @param size Размер буфера.
+     * @return Длина кадра; 0 — слать нечего.
+     */
+    std::size_t Poll(unsigned *path, std::uint8_t *out, std::size_t size);
+
+    /**
+     * @brief Снимок счётчиков пути.
+     * @return false — нет такого пути.
+     */
+    bool GetStats(unsigned path, PathStats *out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Path
+    {
+        std::unique_ptr<Liveness> liveness;
+        bool              up = true;
+        Clock::time_point down_since;
+        double            backlog = 0;          ///< Байт в виртуальной очереди.
+        Clock::time_point backlog_at;
+        double            capacity = 0;         ///< Байт/с.
+        std::uint64_t     srtt_us = 0;
+        std::uint64_t     window_bytes = 0;
+        Clock::time_point window_start;
+        PathStats         stats;
+    };
+
+    Options          opts_;
+    Liveness::DeadFn all_dead_;
+    double           min_capacity_;             ///< Байт/с.
+
+    mutable std::mutex                 mtx_;
+    std::vector<std::unique_ptr<Path>> paths_;
+    unsigned                           poll_next_ = 0;
+    std::atomic<std::int64_t>          next_poll_us_{0};
+
+    /// @brief Вывести путь из ротации (колбэк Liveness, вне её блокировки).
+    void MarkDead(unsigned path, const char *reason);
+};
@@ -0,0 +1,192 @@
+// Reconnect.cpp — реализация цикла переподключения.
+
+#include "Reconnect.hpp"
+#include "Core/Logger.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+Reconnect::Reconnect(const Options &opts,
+                     ConnectFn      connect,
+                     ServeFn        serve,
+                     DisconnectFn   disconnect,
+                     GapFn          gap)
+    : opts_(opts)
+    , connect_(std::move(connect))
+    , serve_(std::move(serve))
+    , disconnect_(std::move(disconnect))
+    , gap_(std::move(gap))
+    , rng_(std::random_device{}())
+{
+    if (!connect_ || !serve_ || !disconnect_)
+    {
+        throw std::invalid_argument("Reconnect: connect/serve/disconnect must be set");
+    }
+    if (opts_.min_backoff.count() <= 0 || opts_.max_backoff < opts_.min_backoff)
+    {
+        throw std::invalid_argument("Reconnect: invalid backoff range");
+    }
+    if (opts_.jitter < 0.0 || opts_.jitter > 1.0)
+    {
+        throw std::invalid_argument("Reconnect: jitter must be in [0..1]");
+    }
+    if (opts_.gap_poll.count() <= 0)
+    {
+        opts_.gap_poll = std::chrono::milliseconds(5);
+    }
+    LOGD("reconnect") << "ctor: enabled=" << opts_.enabled
+                      << " backoff=" << opts_.min_backoff.count() << ".." << opts_.max_backoff.count() << "ms"
+                      << " jitter=" << opts_.jitter;
+}
+
+bool Reconnect::Stopping(const volatile sig_atomic_t *working) const noexcept
+{
+    return (working && *working == 0) || cancelled_.load(std::memory_order_relaxed);
+}
+
+std::chrono::milliseconds Reconnect::NextBackoff(unsigned attempt)
+{
+    const double min_ms = static_cast<double>(opts_.min_backoff.count());
+    const double max_ms = static_cast<double>(opts_.max_backoff.count());
+
+    double base = min_ms;
+    for (unsigned i = 0; i < attempt && base < max_ms; ++i)
+    {
+        base *= 2.0;
+    }
+    base = std::min(base, max_ms);
+
+    std::uniform_real_distribution<double> dist(1.0 - opts_.jitter, 1.0 + opts_.jitter);
+    const double ms = std::clamp(base * dist(rng_), 1.0, max_ms);
+    return std::chrono::milliseconds(static_cast<long long>(ms));
+}
+
+bool Reconnect::WaitGap(std::chrono::milliseconds dur,
+                        const volatile sig_atomic_t *working)
+{
+    const auto deadline = std::chrono::steady_clock::now() + dur;
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (!Stopping(working))
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+            return true;
+        }
+        const auto slice = std::min<std::chrono::steady_clock::duration>(deadline - now, opts_.gap_poll);
+        cv_.wait_for(lk, slice);
+
+        if (gap_)
+        {
+            lk.unlock();
+            try
+            {
+                gap_();
+            }
+            catch (...)
+            {
+                LOGW("reconnect") << "gap callback threw, swallowed";
+            }
+            lk.lock();
+        }
+    }
+    return false;
+}
+
+int Reconnect::Run(const volatile sig_atomic_t *working)
+{
+    unsigned attempt = 0;
+    int rc = 1;
+    bool ever_connected = false;
+
+    while (!Stopping(working))
+    {
+        serve_flag_ = 1;
+
+        if (!connect_())
+        {
+            ++attempt;
+            LOGW("reconnect") << "Connect failed (attempt " << attempt << ")";
+            if (!opts_.enabled || (opts_.max_attempts != 0 && attempt >= opts_.max_attempts))
+            {
+                LOGE("reconnect") << "Giving up after " << attempt << " attempt(s)";
+                return ever_connected ? rc : 1;
+            }
+            const auto delay = NextBackoff(attempt - 1);
+            LOGI("reconnect") << "Retrying in " << delay.count() << "ms";
+            if (!WaitGap(delay, working))
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (ever_connected)
+        {
+            reconnects_.fetch_add(1, std::memory_order_relaxed);
+            LOGI("reconnect") << "Session re-established (reconnects=" << Reconnects() << ")";
+        }
+        ever_connected = true;
+
+        const auto started = std::chrono::steady_clock::now();
+        serving_.store(true, std::memory_order_relaxed);
+        // Cancel() мог прийти между проверкой цикла и стартом Serve.
+        if (Stopping(working))
+        {
+            serve_flag_ = 0;
+        }
+        rc = serve_(&serve_flag_);
+        serving_.store(false, std::memory_order_relaxed);
+        const auto lived = std::chrono::steady_clock::now() - started;
+
+        disconnect_();
+
+        if (Stopping(working))
+        {
+            break;
+        }
+        if (!opts_.enabled)
+        {
+            LOGI("reconnect") << "Serve exited rc=" << rc << "; reconnect disabled";
+            break;
+        }
+
+        // Долго живущая сессия — начинаем backoff заново, иначе растим экспоненту (защита от флаппинга).
+        if (lived >= opts_.stable_after)
+        {
+            attempt = 0;
+        }
+        const auto delay = NextBackoff(attempt++);
+        LOGW("reconnect") << "Serve exited rc=" << rc
+                          << " after " << std::chrono::duration_cast<std::chrono::milliseconds>(lived).count()
+                          << "ms; reconnecting in " << delay.count() << "ms";
+        if (!WaitGap(delay, working))
+        {
+            break;
+        }
+    }
+
+    LOGD("reconnect") << "Run: exiting rc=" << rc;
+    return rc;
+}
+
+void Reconnect::Cancel() noexcept
+{
+    cancelled_.store(true, std::memory_order_relaxed);
+    serve_flag_ = 0;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+    }
+    cv_.notify_all();
+}
+
+void Reconnect::Fail(const char *reason) noexcept
+{
+    if (!serving_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    LOGW("reconnect") << "Liveness failure: " << (reason ? reason : "unknown") << "; dropping session";
+    serve_flag_ = 0;
+}
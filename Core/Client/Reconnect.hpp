@@ -0,0 +1,125 @@
+#pragma once
+// Reconnect.hpp — make-before-break переподключение плагина без сноса TUN/маршрутов/DNS.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+
+/**
+ * @brief Цикл переподключения: Connect → Serve → Disconnect → backoff → Connect ...
+ *
+ * Сессия Wintun, адреса, маршруты и DNS живут снаружи и не трогаются:
+ * между попытками приложения видят лишь кратковременную паузу.
+ * На время «окна» между Serve вызывается колбэк gap (например, перекачка
+ * пакетов из кольца Wintun в ограниченную очередь).
+ *
+ * Плагину передаётся собственный флаг работы; его можно сбросить из любого
+ * потока через Fail() (отказ живости) или Cancel() (остановка клиента).
+ */
+class Reconnect
+{
+public:
+    /**
+     * @brief Параметры переподключения.
+     */
+    struct Options
+    {
+        /** @brief Переподключаться после выхода Serve/ошибки Connect. false — одна попытка. */
+        bool enabled = true;
+        /** @brief Минимальная задержка перед повтором. */
+        std::chrono::milliseconds min_backoff{250};
+        /** @brief Максимальная задержка перед повтором. */
+        std::chrono::milliseconds max_backoff{30000};
+        /** @brief Доля случайного разброса задержки (0..1). */
+        double jitter = 0.2;
+        /** @brief Сессия, прожившая дольше, сбрасывает экспоненту backoff. */
+        std::chrono::milliseconds stable_after{10000};
+        /** @brief Максимум подряд неудачных попыток Connect (0 — без ограничения). */
+        unsigned max_attempts = 0;
+        /** @brief Период вызова gap-колбэка во время ожидания. */
+        std::chrono::milliseconds gap_poll{5};
+    };
+
+    /** @brief Подключение плагина (Client_Connect). */
+    using ConnectFn    = std::function<bool()>;
+    /** @brief Цикл обработки трафика (Client_Serve) с переданным флагом работы. */
+    using ServeFn      = std::function<int(const volatile sig_atomic_t *working_flag)>;
+    /** @brief Отключение плагина (Client_Disconnect). */
+    using DisconnectFn = std::function<void()>;
+    /** @brief Периодическая работа в «окне» между сессиями. */
+    using GapFn        = std::function<void()>;
+
+    /**
+     * @brief Создать движок (ничего не запускает).
+     * @throw std::invalid_argument Некорректные Options или пустые колбэки.
+     */
+    Reconnect(const Options &opts,
+              ConnectFn      connect,
+              ServeFn        serve,
+              DisconnectFn   disconnect,
+              GapFn          gap = {});
+
+    Reconnect(const Reconnect &) = delete;
+    Reconnect &operator=(const Reconnect &) = delete;
+
+    /**
+     * @brief Крутить цикл, пока *working != 0 и не вызван Cancel().
+     * @param working Глобальный флаг работы клиента.
+     * @return Код последнего Serve; 1 — если подключиться так и не удалось.
+     */
+    int Run(const volatile sig_atomic_t *working);
+
+    /**
+     * @brief Остановить цикл: прервать текущий Serve и ожидание backoff. Потокобезопасно.
+     */
+    void Cancel() noexcept;
+
+    /**
+     * @brief Сообщить об отказе живости: текущий Serve прерывается, затем переподключение.
+     * @param reason Причина (для лога).
+     */
+    void Fail(const char *reason) noexcept;
+
+    /** @brief Сколько раз сессия была переустановлена. */
+    std::uint64_t Reconnects() const noexcept { return reconnects_.load(std::memory_order_relaxed); }
+
+    /** @brief Идёт ли сейчас Serve. */
+    bool Serving() const noexcept { return serving_.load(std::memory_order_relaxed); }
+
+private:
+    Options      opts_;
+    ConnectFn    connect_;
+    ServeFn      serve_;
+    DisconnectFn disconnect_;
+    GapFn        gap_;
+
+    /** @brief Флаг работы, который видит плагин. */
+    volatile sig_atomic_t serve_flag_ = 1;
+
+    std::atomic<bool>          cancelled_{false};
+    std::atomic<bool>          serving_{false};
+    std::atomic<std::uint64_t> reconnects_{0};
+
+    std::mutex              mtx_;
+    std::condition_variable cv_;
+    std::mt19937_64         rng_;
+
+    /**
+     * @brief Задержка перед попыткой номер attempt (экспонента + jitter).
+     */
+    std::chrono::milliseconds NextBackoff(unsigned attempt);
+
+    /**
+     * @brief Подождать dur, периодически вызывая gap_.
+     * @return false, если ожидание прервано остановкой.
+     */
+    bool WaitGap(std::chrono::milliseconds dur, const volatile sig_atomic_t *working);
+
+    /** @brief Нужно ли выходить из цикла. */
+    bool Stopping(const volatile sig_atomic_t *working) const noexcept;
+};
@@ -0,0 +1,449 @@
+// Compressor.cpp — сжатие пакетов по потокам и распаковка кадров Compressed.
+
+#include "Compressor.hpp"
+#include "Headers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <stdexcept>
+
+namespace
+{
+    /// @brief Подтверждений в очереди приёмника не больше (повтор придёт со следующим словарём).
+    constexpr std::size_t kMaxAcks = 256;
+
+    /// @brief Пакет помещается в окно вместе с полным словарём.
+    constexpr std::size_t kMaxPacket = Lz4::kMaxWindow - Compressor::kDictSize;
+
+    /// @brief Нагрузка короче не оценивается: по десятку байт энтропия не видна.
+    constexpr std::size_t kMinSample = 16;
+
+    /// @brief Выборка длинной нагрузки — столько отрезков подряд идущих байт.
+    constexpr std::size_t kChunks = 4;
+
+    inline void StoreBe16(std::uint8_t *p, std::uint16_t v) noexcept
+    {
+        p[0] = static_cast<std::uint8_t>(v >> 8);
+        p[1] = static_cast<std::uint8_t>(v);
+    }
+
+    inline std::uint16_t LoadBe16(const std::uint8_t *p) noexcept
+    {
+        return static_cast<std::uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    /// @brief Смещение нагрузки L4 (за заголовком TCP/UDP); len — не IP.
+    std::size_t PayloadOffset(const std::uint8_t *pkt, std::size_t len) noexcept
+    {
+        std::size_t  off   = 0;
+        std::uint8_t proto = 0;
+        if (const Headers::Ip4View<const std::uint8_t> ip{pkt, len})
+        {
+            off   = ip.HeaderSize();
+            proto = ip.IsFragment() ? 0 : ip.Protocol();
+        }
+        else if (const Headers::Ip6View<const std::uint8_t> ip6{pkt, len})
+        {
+            off   = Headers::Ip6View<const std::uint8_t>::kSize;
+            proto = ip6.NextHeader();
+        }
+        else
+        {
+            return len;
+        }
+        if (proto == Headers::kProtoTcp)
+        {
+            if (const Headers::TcpView<const std::uint8_t> tcp{pkt + off, len - off})
+            {
+                off += tcp.HeaderSize();
+            }
+        }
+        else if (proto == Headers::kProtoUdp && len - off >= Headers::UdpView<const std::uint8_t>::kSize)
+        {
+            off += Headers::UdpView<const std::uint8_t>::kSize;
+        }
+        return off;
+    }
+
+    /// @brief c * log2(c) для c = 0..kSample.
+    const std::array<float, Compressor::kSample + 1> &CLog2() noexcept
+    {
+        static const std::array<float, Compressor::kSample + 1> table = []
+        {
+            std::array<float, Compressor::kSample + 1> t{};
+            for (std::size_t c = 2; c < t.size(); ++c)
+            {
+                t[c] = static_cast<float>(static_cast<double>(c) * std::log2(static_cast<double>(c)));
+            }
+            return t;
+        }();
+        return table;
+    }
+}
+
+// ---- Compressor ----
+
+Compressor::Compressor(const Options &opts)
+    : opts_(opts)
+    , table_(FlowTable::Options{opts.flows, opts.idle, std::chrono::milliseconds(100), 0},
+             [this](FlowTable::FlowId id, const FlowTable::Key &, FlowTable::Reason) { Clear(flows_[id]); })
+{
+    if (opts.flows == 0 || opts.flows > 0x10000 || opts.min_size < CoreFrame::kCompressedHeaderSize + kMinSample ||
+        !(opts.max_entropy > 0.0 && opts.max_entropy <= 8.0) || opts.min_gain_pct > 100 || opts.probe == 0 ||
+        opts.refresh == 0 || opts.backoff.count() < 0)
+    {
+        throw std::invalid_argument("Compressor: invalid options");
+    }
+    flows_.resize(opts.flows);
+    window_.resize(Lz4::kMaxWindow);
+    block_.resize(Lz4::Bound(Lz4::kMaxWindow));
+    CLog2();
+}
+
+void Compressor::Clear(Flow &f) noexcept
+{
+    std::vector<std::uint8_t>().swap(f.acked);
+    std::vector<std::uint8_t>().swap(f.pending);
+    f.acked_gen   = 0;
+    f.pending_gen = 0;
+    f.since       = 0;
+    f.window      = 0;
+    f.window_in   = 0;
+    f.window_out  = 0;
+    f.off_until   = Clock::time_point{};
+}
+
+double Compressor::Entropy(const std::uint8_t *data,
+                           std::size_t len) noexcept
+{
+    std::uint8_t hist[256] = {};
+    std::size_t  n        = 0;
+    unsigned     distinct = 0;
+    auto count = [&](const std::uint8_t *p, std::size_t k)
+    {
+        for (std::size_t i = 0; i < k; ++i)
+        {
+            distinct += hist[p[i]]++ == 0;
+        }
+        n += k;
+    };
+    if (len <= kSample)
+    {
+        count(data, len);
+    }
+    else
+    {
+        // Отрезки подряд идущих байт: структура текста (ключи, пробелы) видна и в выборке.
+        constexpr std::size_t chunk = kSample / kChunks;
+        for (std::size_t i = 0; i < kChunks; ++i)
+        {
+            count(data + i * (len - chunk) / (kChunks - 1), chunk);
+        }
+    }
+    if (n == 0)
+    {
+        return 0.0;
+    }
+
+    const auto &clog = CLog2();
+    double sum = 0.0;
+    for (unsigned b = 0; b < 256; ++b)
+    {
+        sum += clog[hist[b]];
+    }
+    // Выборка в 128 байт занижает энтропию случайных данных почти на бит: поправка Миллера — Мэдоу.
+    const double dn = static_cast<double>(n);
+    const double h  = std::log2(dn) - sum / dn + (distinct - 1) / (2.0 * dn * std::numbers::ln2);
+    return std::clamp(h, 0.0, 8.0);
+}
+
+void Compressor::Account(Flow &f,
+                         std::size_t in,
+                         std::size_t out,
+                         Clock::time_point now) noexcept
+{
+    f.window_in  += in;
+    f.window_out += out;
+    if (++f.window < opts_.probe)
+    {
+        return;
+    }
+    if ((f.window_in - f.window_out) * 100 < f.window_in * opts_.min_gain_pct)
+    {
+        f.off_until = now + opts_.backoff;
+        ++stats_.flows_off;
+    }
+    f.window     = 0;
+    f.window_in  = 0;
+    f.window_out = 0;
+}
+
+std::size_t Compressor::Compress(std::uint8_t *buf,
+                                 std::size_t len,
+                                 std::size_t size,
+                                 Clock::time_point now) noexcept
+{
+    ++stats_.packets;
+    stats_.bytes_in  += len;
+    stats_.bytes_out += len;
+    FlowTable::Key key;
+    if (len < opts_.min_size || len > kMaxPacket || len > size || !FlowTable::ExtractKey(buf, len, &key))
+    {
+        ++stats_.skipped_small;
+        return len;
+    }
+
+    FlowTable::FlowId id = FlowTable::kNone;
+    try
+    {
+        table_.Expire(now);
+        bool created = false;
+        id = table_.Touch(key, now, &created);
+        if (created)
+        {
+            Clear(flows_[id]);
+        }
+    }
+    catch (...)
+    {
+        return len;
+    }
+    Flow &f = flows_[id];
+    if (now < f.off_until)
+    {
+        ++stats_.skipped_off;
+        return len;
+    }
+    const std::size_t off = PayloadOffset(buf, len);
+    if (len - off >= kMinSample && Entropy(buf + off, len - off) > opts_.max_entropy)
+    {
+        ++stats_.skipped_entropy;
+        Account(f, len, len, now);
+        return len;
+    }
+
+    // Окно: подтверждённый словарь, сразу за ним пакет.
+    const std::size_t prefix = f.acked.size();
+    if (prefix != 0)
+    {
+        std::memcpy(window_.data(), f.acked.data(), prefix);
+    }
+    std::memcpy(window_.data() + prefix, buf, len);
+    const bool offer = (f.acked_gen == 0 && f.pending_gen == 0) || f.since >= opts_.refresh;
+    ++f.since;
+
+    // Кадр строго короче пакета.
+    const std::size_t n = Lz4::Compress(window_.data(), prefix, len, block_.data(),
+                                        len - CoreFrame::kCompressedHeaderSize - 1, hash_);
+    if (n == 0)
+    {
+        ++stats_.incompressible;
+        Account(f, len, len, now);
+        return len;
+    }
+
+    std::uint16_t gen = 0;
+    if (offer)
+    {
+        try
+        {
+            const std::size_t total = prefix + len;
+            const std::size_t keep  = std::min(total, kDictSize);
+            f.pending.assign(window_.begin() + static_cast<std::ptrdiff_t>(total - keep),
+                             window_.begin() + static_cast<std::ptrdiff_t>(total));
+            gen = ++f.gen != 0 ? f.gen : ++f.gen;
+            f.pending_gen = gen;
+            f.since       = 0;
+            ++stats_.dict_sets;
+        }
+        catch (...)
+        {
+            gen = 0;
+        }
+    }
+
+    const std::size_t frame = CoreFrame::kCompressedHeaderSize + n;
+    CoreFrame::BuildHeader(CoreFrame::Type::Compressed, frame - CoreFrame::kHeaderSize, buf);
+    StoreBe16(buf + CoreFrame::kHeaderSize, static_cast<std::uint16_t>(id));
+    StoreBe16(buf + CoreFrame::kHeaderSize + 2, f.acked_gen);
+    StoreBe16(buf + CoreFrame::kHeaderSize + 4, gen);
+    std::memcpy(buf + CoreFrame::kCompressedHeaderSize, block_.data(), n);
+
+    ++stats_.compressed;
+    stats_.bytes_out -= len - frame;
+    Account(f, len, frame, now);
+    return frame;
+}
+
+void Compressor::OnAck(const std::uint8_t *payload,
+                       std::size_t len) noexcept
+{
+    for (std::size_t i = 0; i + 4 <= len; i += 4)
+    {
+        const std::uint16_t slot = LoadBe16(payload + i);
+        const std::uint16_t gen  = LoadBe16(payload + i + 2);
+        if (slot >= flows_.size())
+        {
+            continue;
+        }
+        // Номер мог перейти к другому потоку: его поколения другие, подтверждение не совпадёт.
+        Flow &f = flows_[slot];
+        if (gen == 0 || f.pending_gen != gen)
+        {
+            continue;
+        }
+        f.acked.swap(f.pending);
+        f.acked_gen   = gen;
+        f.pending_gen = 0;
+        f.pending.clear();
+        ++stats_.dict_acks;
+    }
+}
+
+void Compressor::Reset()
+{
+    std::vector<FlowTable::FlowId> live;
+    live.reserve(table_.Size());
+    table_.ForEach([&live](FlowTable::FlowId id, const FlowTable::Key &) { live.push_back(id); });
+    for (const FlowTable::FlowId id : live)
+    {
+        table_.Erase(id);
+        Clear(flows_[id]);
+    }
+}
+
+// ---- Decompressor ----
+
+Decompressor::Decompressor(const Options &opts)
+    : opts_(opts)
+{
+    if (opts.mtu == 0 || opts.mtu > kMaxPacket || opts.flows == 0)
+    {
+        throw std::invalid_argument("Decompressor: invalid options");
+    }
+    window_.resize(Compressor::kDictSize + opts.mtu);
+    dict_.reserve(Compressor::kDictSize);
+    acks_.reserve(kMaxAcks);
+}
+
+bool Decompressor::Decompress(const std::uint8_t *payload,
+                              std::size_t len,
+                              const std::uint8_t **pkt,
+                              std::size_t *pkt_len) noexcept
+{
+    constexpr std::size_t kFields = CoreFrame::kCompressedHeaderSize - CoreFrame::kHeaderSize;
+    if (len <= kFields)
+    {
+        ++stats_.malformed;
+        return false;
+    }
+    const std::uint16_t flow = LoadBe16(payload);
+    const std::uint16_t used = LoadBe16(payload + 2);
+    const std::uint16_t gen  = LoadBe16(payload + 4);
+
+    Slot *slot = nullptr;
+    const std::vector<std::uint8_t> *dict = nullptr;
+    if (auto it = slots_.find(flow); it != slots_.end())
+    {
+        slot = &it->second;
+    }
+    if (used != 0)
+    {
+        if (slot && used == slot->cur_gen)
+            dict = &slot->cur;
+        else if (slot && used == slot->prev_gen)
+            dict = &slot->prev;
+        if (!dict)
+        {
+            // Словарь сменился раньше, чем дошёл этот (опоздавший) кадр.
+            ++stats_.no_dict;
+            return false;
+        }
+    }
+
+    const std::size_t prefix = dict ? dict->size() : 0;
+    if (prefix != 0)
+    {
+        std::memcpy(window_.data(), dict->data(), prefix);
+    }
+    const std::size_t n = Lz4::Decompress(payload + kFields, len - kFields, window_.data(), prefix, opts_.mtu);
+    const std::uint8_t *out = window_.data() + prefix;
+    // Распакованное — целый IP-пакет: длина из заголовка совпадает.
+    const bool ip = (n >= Headers::Ip4View<const std::uint8_t>::kMinSize && (out[0] >> 4) == 4 &&
+                     LoadBe16(out + 2) == n) ||
+                    (n >= Headers::Ip6View<const std::uint8_t>::kSize && (out[0] >> 4) == 6 &&
+                     Headers::Ip6View<const std::uint8_t>::kSize + LoadBe16(out + 4) == n);
+    if (!ip)
+    {
+        ++stats_.malformed;
+        return false;
+    }
+
+    if (gen != 0)
+    {
+        try
+        {
+            if (!slot && slots_.size() < opts_.flows)
+            {
+                slot = &slots_[flow];
+            }
+            if (slot)
+            {
+                // Новый словарь — хвост «словарь + пакет»; отправитель до подтверждения сжимает прежним (used).
+                const std::size_t total = prefix + n;
+                const std::size_t keep  = std::min(total, Compressor::kDictSize);
+                dict_.assign(window_.begin() + static_cast<std::ptrdiff_t>(total - keep),
+                             window_.begin() + static_cast<std::ptrdiff_t>(total));
+                if (used == 0 || used != slot->prev_gen)
+                {
+                    slot->prev.swap(slot->cur);
+                    slot->prev_gen = slot->cur_gen;
+                }
+                slot->cur.swap(dict_);
+                slot->cur_gen = gen;
+                ++stats_.dict_sets;
+                if (acks_.size() < kMaxAcks)
+                {
+                    acks_.emplace_back(flow, gen);
+                }
+            }
+        }
+        catch (...)
+        {
+        }
+    }
+
+    ++stats_.frames;
+    stats_.bytes_in  += len + CoreFrame::kHeaderSize;
+    stats_.bytes_out += n;
+    *pkt     = out;
+    *pkt_len = n;
+    return true;
+}
+
+std::size_t Decompressor::Poll(std::uint8_t *out,
+                               std::size_t size) noexcept
+{
+    if (acks_.empty() || size < CoreFrame::kHeaderSize + 4)
+    {
+        return 0;
+    }
+    const std::size_t fit = std::min(acks_.size(), (std::min(size, CoreFrame::kHeaderSize + 0xFFFF) - CoreFrame::kHeaderSize) / 4);
+    std::uint8_t *p = out + CoreFrame::kHeaderSize;
+    for (std::size_t i = 0; i < fit; ++i, p += 4)
+    {
+        StoreBe16(p, acks_[i].first);
+        StoreBe16(p + 2, acks_[i].second);
+    }
+    acks_.erase(acks_.begin(), acks_.begin() + static_cast<std::ptrdiff_t>(fit));
+    return CoreFrame::BuildHeader(CoreFrame::Type::DictAck, fit * 4, out) + fit * 4;
+}
+
+void Decompressor::Reset()
+{
+    slots_.clear();
+    acks_.clear();
+}
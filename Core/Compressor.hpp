@@ -0,0 +1,255 @@
+#pragma once
+// Compressor.hpp — сжатие пакетов туннеля по потокам: оценка энтропии, словарь потока, отключение без выигрыша.
+
+#include "CoreFrame.hpp"
+#include "FlowTable.hpp"
+#include "Lz4.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Формат кадра CoreFrame::Type::Compressed (нагрузка):
+ *   [поток BE16][словарь BE16][новый словарь BE16][блок LZ4]
+ * Поток — номер потока отправителя. Словарь — поколение словаря потока, с
+ * которым сжат пакет (0 — без словаря). Новый словарь — не 0: приёмник
+ * запоминает под этим поколением последние kDictSize байт «словарь + пакет»
+ * и подтверждает его кадром DictAck.
+ *
+ * Отправитель сжимает только подтверждённым словарём: потеря кадра с новым
+ * словарём или подтверждения не рассинхронизирует стороны — словарь просто
+ * не сменится, и через refresh пакетов будет предложен снова. Приёмник держит
+ * два словаря потока: новый и тот, которым отправитель пользуется до
+ * подтверждения.
+ */
+
+/**
+ * @brief Сжатие IP-пакетов отправителя.
+ *
+ * Текстовые протоколы (HTTP/1, JSON API, SIP, логи) внутри туннеля несут одни
+ * и те же заголовки и ключи в каждом пакете потока. Пакет сжимается LZ4 со
+ * словарём — последними kDictSize байт предыдущих пакетов того же потока
+ * (FlowTable по 5-tuple), поэтому выигрыш есть и на пакетах, которые поодиночке
+ * почти не сжимаются. Кадр уходит, только если он короче пакета: MTU и запас
+ * Seq/FEC не меняются.
+ *
+ * Без лишней работы на несжимаемом:
+ * - пакеты короче min_size (ACK, DNS) не трогаются;
+ * - энтропия нагрузки L4 оценивается по выборке до kSample байт (гистограмма,
+ *   с поправкой Миллера — Мэдоу); выше max_entropy бит/байт (TLS, QUIC, видео,
+ *   архивы) пакет уходит как есть, не доходя до LZ4;
+ * - по окну из probe пакетов потока считается выигрыш; ниже min_gain_pct поток
+ *   выключается на backoff — его пакеты стоят одного поиска в FlowTable.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class Compressor
+{
+public:
+    using Clock = FlowTable::Clock;
+
+    /// @brief Словарь потока, байт (одинаков у обеих сторон).
+    static constexpr std::size_t kDictSize = 2048;
+
+    /// @brief Байт нагрузки в выборке энтропии.
+    static constexpr std::size_t kSample = 128;
+
+    /**
+     * @brief Параметры сжатия.
+     */
+    struct Options
+    {
+        /// @brief Наибольшее число потоков со своим словарём (не больше 65536).
+        std::size_t flows = 1024;
+        /// @brief Пакеты короче не сжимаются.
+        std::size_t min_size = 128;
+        /// @brief Оценка энтропии нагрузки выше — пакет не сжимается, бит/байт.
+        double max_entropy = 6.5;
+        /// @brief Выигрыш потока за окно ниже — поток выключается, %.
+        unsigned min_gain_pct = 5;
+        /// @brief Окно оценки выигрыша, пакетов потока.
+        unsigned probe = 64;
+        /// @brief Новый словарь предлагается раз в столько пакетов потока.
+        unsigned refresh = 256;
+        /// @brief На сколько выключается поток без выигрыша.
+        std::chrono::milliseconds backoff{10000};
+        /// @brief Простой, после которого поток (и его словарь) забывается.
+        std::chrono::milliseconds idle{60000};
+    };
+
+    /**
+     * @brief Счётчики сжатия.
+     */
+    struct Stats
+    {
+        std::uint64_t packets         = 0;   ///< Пакетов предъявлено.
+        std::uint64_t compressed      = 0;   ///< Отправлено кадрами Compressed.
+        std::uint64_t skipped_small   = 0;   ///< Короче min_size (или не IP).
+        std::uint64_t skipped_entropy = 0;   ///< Энтропия выше max_entropy.
+        std::uint64_t skipped_off     = 0;   ///< Поток выключен.
+        std::uint64_t incompressible  = 0;   ///< Сжатое не короче пакета.
+        std::uint64_t bytes_in        = 0;   ///< Байт пакетов.
+        std::uint64_t bytes_out       = 0;   ///< Байт на выходе (кадры и несжатые пакеты).
+        std::uint64_t dict_sets       = 0;   ///< Новых словарей предложено.
+        std::uint64_t dict_acks       = 0;   ///< Из них подтверждено.
+        std::uint64_t flows_off       = 0;   ///< Выключений потоков.
+    };
+
+    /**
+     * @brief Создать компрессор (вся память, кроме словарей потоков, выделяется здесь).
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    explicit Compressor(const Options &opts);
+
+    Compressor(const Compressor &) = delete;
+    Compressor &operator=(const Compressor &) = delete;
+
+    /**
+     * @brief Сжать IP-пакет на месте.
+     * @param buf  Пакет; при сжатии — кадр Compressed.
+     * @param len  Длина пакета.
+     * @param size Ёмкость buf.
+     * @return Длина кадра или len (пакет оставлен как есть).
+     */
+    std::size_t Compress(std::uint8_t *buf, std::size_t len, std::size_t size, Clock::time_point now) noexcept;
+
+    /**
+     * @brief Нагрузка кадра DictAck от приёмника.
+     */
+    void OnAck(const std::uint8_t *payload, std::size_t len) noexcept;
+
+    /**
+     * @brief Новое соединение: потоки и словари забываются.
+     */
+    void Reset();
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+    /**
+     * @brief Оценка энтропии данных по выборке до kSample байт, бит/байт (0..8).
+     */
+    static double Entropy(const std::uint8_t *data, std::size_t len) noexcept;
+
+private:
+    /**
+     * @brief Состояние потока.
+     */
+    struct Flow
+    {
+        std::vector<std::uint8_t> acked;      ///< Подтверждённый словарь.
+        std::vector<std::uint8_t> pending;    ///< Предложенный, ждёт DictAck.
+        std::uint16_t     acked_gen   = 0;    ///< 0 — словаря нет.
+        std::uint16_t     pending_gen = 0;
+        std::uint16_t     gen         = 0;    ///< Последнее выданное поколение (переживает смену потока в номере).
+        unsigned          since       = 0;    ///< Пакетов с последнего предложения.
+        unsigned          window      = 0;    ///< Пакетов в окне оценки.
+        std::uint64_t     window_in   = 0;
+        std::uint64_t     window_out  = 0;
+        Clock::time_point off_until{};
+    };
+
+    Options                   opts_;
+    FlowTable                 table_;
+    std::vector<Flow>         flows_;
+    std::vector<std::uint8_t> window_;   ///< Словарь + пакет.
+    std::vector<std::uint8_t> block_;    ///< Блок LZ4.
+    Lz4::Table                hash_;
+    Stats                     stats_;
+
+    /// @brief Очистить состояние потока (поколение сохраняется).
+    static void Clear(Flow &f) noexcept;
+
+    /// @brief Учесть пакет в окне выигрыша; выключить поток без выигрыша.
+    void Account(Flow &f, std::size_t in, std::size_t out, Clock::time_point now) noexcept;
+};
+
+/**
+ * @brief Распаковка кадров Compressed приёмника и подтверждение словарей.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class Decompressor
+{
+public:
+    /**
+     * @brief Параметры приёмника.
+     */
+    struct Options
+    {
+        /// @brief Наибольший распакованный пакет.
+        std::size_t mtu = 1500;
+        /// @brief Наибольшее число потоков со словарями (новые сверх — без словаря).
+        std::size_t flows = 4096;
+    };
+
+    /**
+     * @brief Счётчики приёмника.
+     */
+    struct Stats
+    {
+        std::uint64_t frames     = 0;   ///< Кадров распаковано.
+        std::uint64_t bytes_in   = 0;   ///< Байт кадров.
+        std::uint64_t bytes_out  = 0;   ///< Байт пакетов.
+        std::uint64_t dict_sets  = 0;   ///< Словарей принято.
+        std::uint64_t no_dict    = 0;   ///< Кадров с неизвестным словарём (отброшены).
+        std::uint64_t malformed  = 0;   ///< Испорченных кадров.
+    };
+
+    /**
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    explicit Decompressor(const Options &opts);
+
+    Decompressor(const Decompressor &) = delete;
+    Decompressor &operator=(const Decompressor &) = delete;
+
+    /**
+     * @brief Распаковать нагрузку кадра Compressed.
+     * @param pkt     Пакет во внутреннем буфере (действителен до следующего вызова).
+     * @param pkt_len Его длина.
+     * @return false — кадр отброшен.
+     */
+    bool Decompress(const std::uint8_t *payload, std::size_t len,
+                    const std::uint8_t **pkt, std::size_t *pkt_len) noexcept;
+
+    /**
+     * @brief Кадр DictAck с накопленными подтверждениями.
+     * @return Длина кадра в out; 0 — подтверждать нечего.
+     */
+    std::size_t Poll(std::uint8_t *out, std::size_t size) noexcept;
+
+    /** @brief Есть ли неотправленные подтверждения. */
+    bool Pending() const noexcept { return !acks_.empty(); }
+
+    /**
+     * @brief Новое соединение: словари забываются.
+     */
+    void Reset();
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+private:
+    /**
+     * @brief Словари потока отправителя.
+     */
+    struct Slot
+    {
+        std::uint16_t             cur_gen  = 0;
+        std::uint16_t             prev_gen = 0;
+        std::vector<std::uint8_t> cur;
+        std::vector<std::uint8_t> prev;
+    };
+
+    Options                                      opts_;
+    std::unordered_map<std::uint16_t, Slot>      slots_;
+    std::vector<std::pair<std::uint16_t, std::uint16_t>> acks_;   ///< (поток, поколение).
+    std::vector<std::uint8_t>                    window_;        ///< Словарь + пакет.
+    std::vector<std::uint8_t>                    dict_;          ///< Сборка нового словаря.
+    Stats                                        stats_;
+};
@@ -1,3 +1,8 @@
+#include "Config.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
 #include <string>
 
 #include <boost/json.hpp>
@@ -47,5 +52,22 @@ bool RequireBool(const boost::json::object& o, const char* key)
     throw std::runtime_error(std::string("missing or invalid boolean field '") + key + "'");
 };
 
+std::string OptionalString(const boost::json::object& o, const char* key, const std::string& def)
+{
+    if (!o.contains(key)) return def;
+    return RequireString(o, key);
+};
+
+int OptionalInt(const boost::json::object& o, const char* key, int def)
+{
+    if (!o.contains(key)) return def;
+    return RequireInt(o, key);
+};
+
+bool OptionalBool(const boost::json::object& o, const char* key, bool def)
+{
+    if (!o.contains(key)) return def;
+    return RequireBool(o, key);
+};
 
-}
\ No newline at end of file
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <string>
 #include <boost/json/object.hpp>
 
@@ -8,4 +10,10 @@ std::string RequireString(const boost::json::object& o, const char* key);
 int RequireInt(const boost::json::object& o, const char* key);
 bool RequireBool(const boost::json::object& o, const char* key);
 
-}
\ No newline at end of file
+// Необязательные поля: при отсутствии ключа возвращается def,
+// при наличии ключа с некорректным значением — исключение, как у Require*.
+std::string OptionalString(const boost::json::object& o, const char* key, const std::string& def);
+int OptionalInt(const boost::json::object& o, const char* key, int def);
+bool OptionalBool(const boost::json::object& o, const char* key, bool def);
+
+}
@@ -0,0 +1,112 @@
+// CoreFrame.cpp — сборка и разбор служебных кадров ядра.
+
+#include "CoreFrame.hpp"
+
+#include <cstring>
+
+namespace
+{
+    constexpr std::uint8_t kMarker  = 0xF0;
+    constexpr std::uint8_t kVersion = 0;
+}
+
+namespace CoreFrame
+{
+    bool IsCoreFrame(const std::uint8_t *data,
+                     std::size_t len) noexcept
+    {
+        return len >= kHeaderSize && (data[0] & 0xF0) == kMarker;
+    }
+
+    std::size_t Build(Type type,
+                      const std::uint8_t *payload,
+                      std::size_t payload_len,
+                      std::uint8_t *out,
+                      std::size_t out_size) noexcept
+    {
+        if (payload_len > 0xFFFF || kHeaderSize + payload_len > out_size)
+        {
+            return 0;
+        }
+        out[0] = kMarker | kVersion;
+        out[1] = static_cast<std::uint8_t>(type);
+        out[2] = static_cast<std::uint8_t>(payload_len >> 8);
+        out[3] = static_cast<std::uint8_t>(payload_len);
+        if (payload_len != 0)
+        {
+            std::memcpy(out + kHeaderSize, payload, payload_len);
+        }
+        return kHeaderSize + payload_len;
+    }
+
+    std::size_t BuildHeader(Type type,
+                            std::size_t payload_len,
+                            std::uint8_t *out) noexcept
+    {
+        if (payload_len > 0xFFFF)
+        {
+            return 0;
+        }
+        out[0] = kMarker | kVersion;
+        out[1] = static_cast<std::uint8_t>(type);
+        out[2] = static_cast<std::uint8_t>(payload_len >> 8);
+        out[3] = static_cast<std::uint8_t>(payload_len);
+        return kHeaderSize;
+    }
+
+    std::size_t BuildSeqHeader(std::uint32_t seq,
+                               std::size_t packet_len,
+                               std::uint8_t *out) noexcept
+    {
+        const std::size_t payload_len = 4 + packet_len;
+        if (BuildHeader(Type::Seq, payload_len, out) == 0)
+        {
+            return 0;
+        }
+        out[4] = static_cast<std::uint8_t>(seq >> 24);
+        out[5] = static_cast<std::uint8_t>(seq >> 16);
+        out[6] = static_cast<std::uint8_t>(seq >> 8);
+        out[7] = static_cast<std::uint8_t>(seq);
+        return kHeaderSize + payload_len;
+    }
+
+    bool ParseSeq(const std::uint8_t *payload,
+                  std::size_t payload_len,
+                  std::uint32_t *seq,
+                  const std::uint8_t **packet,
+                  std::size_t *packet_len) noexcept
+    {
+        if (payload_len < 4)
+        {
+            return false;
+        }
+        *seq = (static_cast<std::uint32_t>(payload[0]) << 24) |
+               (static_cast<std::uint32_t>(payload[1]) << 16) |
+               (static_cast<std::uint32_t>(payload[2]) << 8)  |
+                static_cast<std::uint32_t>(payload[3]);
+        *packet     = payload + 4;
+        *packet_len = payload_len - 4;
+        return true;
+    }
+
+    bool Parse(const std::uint8_t *data,
+               std::size_t len,
+               Type *type,
+               const std::uint8_t **payload,
+               std::size_t *payload_len) noexcept
+    {
+        if (!IsCoreFrame(data, len) || (data[0] & 0x0F) != kVersion)
+        {
+            return false;
+        }
+        const std::size_t plen = (static_cast<std::size_t>(data[2]) << 8) | data[3];
+        if (kHeaderSize + plen != len)
+        {
+            return false;
+        }
+        *type        = static_cast<Type>(data[1]);
+        *payload     = data + kHeaderSize;
+        *payload_len = plen;
+        return true;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+// CoreFrame.hpp — служебные кадры ядра, передаваемые внутри туннеля вместе с IP-пакетами.
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Служебные кадры «ядро клиента <-> ядро сервера».
+ *
+ * Кадр идёт по тому же пути, что и IP-пакет (receive_from_net/send_to_net),
+ * плагин переносит его как непрозрачные данные. Отличить кадр от пакета можно
+ * по первому полубайту: у IPv4/IPv6 это 4/6, у служебного кадра — 0xF.
+ *
+ * Формат: [0xF0 | версия][тип][длина полезной нагрузки, BE16][нагрузка].
+ */
+namespace CoreFrame
+{
+    /// @brief Тип служебного кадра.
+    enum class Type : std::uint8_t
+    {
+        Ticket = 1,   ///< Тикет возобновления сессии (сервер -> клиент).
+        Probe  = 2,   ///< Keepalive-проба (клиент -> сервер): seq BE32 + метка времени BE64.
+        Ack    = 3,   ///< Ответ на пробу: нагрузка пробы без изменений (сервер -> клиент).
+        Seq    = 4,   ///< Пронумерованный IP-пакет: seq BE32 + пакет (для восстановления порядка).
+        Fec       = 5,   ///< Символ блока FEC: исходный пакет или избыточный символ (см. Fec.hpp).
+        FecReport = 6,   ///< Потери, измеренные приёмником FEC: доля в ppm BE32.
+        Bundle    = 7,   ///< Несколько мелких пакетов в одном кадре: [длина BE16][пакет]... (см. Aggregator.hpp).
+        Compressed = 8,  ///< Сжатый IP-пакет: поток, словари и блок LZ4 (см. Compressor.hpp).
+        DictAck    = 9,  ///< Подтверждение словарей приёмником сжатия: [поток BE16][поколение BE16]...
+        Header     = 10, ///< IP-пакет со сжатым заголовком: контекст, опоры и разности полей (см. HeaderCompressor.hpp).
+        HeaderAck  = 11, ///< Подтверждение опор приёмником сжатия заголовков: [контекст BE16][поколение]...
+    };
+
+    /// @brief Размер заголовка кадра.
+    constexpr std::size_t kHeaderSize = 4;
+
+    /// @brief Накладные расходы кадра Seq: заголовок + seq.
+    constexpr std::size_t kSeqHeaderSize = kHeaderSize + 4;
+
+    /// @brief Накладные расходы кадра Fec: заголовок + блок BE32, индекс, k, m.
+    constexpr std::size_t kFecHeaderSize = kHeaderSize + 7;
+
+    /// @brief Накладные расходы кадра Compressed: заголовок + поток, словарь, новый словарь (BE16).
+    constexpr std::size_t kCompressedHeaderSize = kHeaderSize + 6;
+
+    /**
+     * @brief Является ли буфер служебным кадром ядра (а не IP-пакетом).
+     */
+    bool IsCoreFrame(const std::uint8_t *data, std::size_t len) noexcept;
+
+    /**
+     * @brief Собрать кадр в out.
+     * @return Длина кадра; 0 — не помещается в out или нагрузка > 65535.
+     */
+    std::size_t Build(Type type,
+                      const std::uint8_t *payload, std::size_t payload_len,
+                      std::uint8_t *out, std::size_t out_size) noexcept;
+
+    /**
+     * @brief Записать в out только заголовок кадра (нагрузку кладёт вызывающий).
+     * @return kHeaderSize; 0 — нагрузка > 65535.
+     */
+    std::size_t BuildHeader(Type type, std::size_t payload_len, std::uint8_t *out) noexcept;
+
+    /**
+     * @brief Собрать заголовок кадра Seq перед пакетом, уже лежащим в out + kSeqHeaderSize
+     *        (пакет не копируется).
+     * @return Длина кадра; 0 — пакет слишком велик.
+     */
+    std::size_t BuildSeqHeader(std::uint32_t seq, std::size_t packet_len, std::uint8_t *out) noexcept;
+
+    /**
+     * @brief Разобрать нагрузку кадра Seq.
+     * @return false — нагрузка короче номера.
+     */
+    bool ParseSeq(const std::uint8_t *payload, std::size_t payload_len,
+                  std::uint32_t *seq, const std::uint8_t **packet, std::size_t *packet_len) noexcept;
+
+    /**
+     * @brief Разобрать кадр.
+     * @return false — не кадр, неизвестная версия или длина не сходится.
+     */
+    bool Parse(const std::uint8_t *data, std::size_t len,
+               Type *type, const std::uint8_t **payload, std::size_t *payload_len) noexcept;
+}
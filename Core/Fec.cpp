@@ -0,0 +1,670 @@
+// Fec.cpp — реализация кодера и декодера FEC.
+
+#include "Fec.hpp"
+#include "Gf256.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    /// @brief Нагрузка кадра Fec до данных: блок BE32, индекс, k, m.
+    constexpr std::size_t kFecFields = CoreFrame::kFecHeaderSize - CoreFrame::kHeaderSize;
+
+    /// @brief Признак избыточного символа в индексе.
+    constexpr std::uint8_t kRepairFlag = 0x80;
+
+    /// @brief Блоков, целиком пропавших между двумя принятыми, учитывается не больше.
+    constexpr std::uint32_t kMaxGapBlocks = 64;
+
+    constexpr unsigned kMaxSources = FecEncoder::kMaxSources;
+    constexpr unsigned kMaxRepairs = FecEncoder::kMaxRepairs;
+
+    /// @brief Матрица Коши c(j, i) = 1 / ((0x80 + j) ^ i).
+    struct Cauchy
+    {
+        std::uint8_t c[kMaxRepairs][kMaxSources];
+
+        Cauchy() noexcept
+        {
+            for (unsigned j = 0; j < kMaxRepairs; ++j)
+            {
+                for (unsigned i = 0; i < kMaxSources; ++i)
+                {
+                    c[j][i] = Gf256::Inv(static_cast<std::uint8_t>((0x80u + j) ^ i));
+                }
+            }
+        }
+    };
+
+    inline std::uint8_t Coef(unsigned j, unsigned i) noexcept
+    {
+        static const Cauchy table;
+        return table.c[j][i];
+    }
+
+    inline void StoreBe32(std::uint8_t *p, std::uint32_t v) noexcept
+    {
+        p[0] = static_cast<std::uint8_t>(v >> 24);
+        p[1] = static_cast<std::uint8_t>(v >> 16);
+        p[2] = static_cast<std::uint8_t>(v >> 8);
+        p[3] = static_cast<std::uint8_t>(v);
+    }
+
+    inline std::uint32_t LoadBe32(const std::uint8_t *p) noexcept
+    {
+        return (static_cast<std::uint32_t>(p[0]) << 24) |
+               (static_cast<std::uint32_t>(p[1]) << 16) |
+               (static_cast<std::uint32_t>(p[2]) << 8)  |
+                static_cast<std::uint32_t>(p[3]);
+    }
+
+    /// @brief Заголовок кадра Fec перед данными длиной data_len.
+    inline void BuildFecHeader(std::uint8_t *out,
+                               std::size_t data_len,
+                               std::uint32_t block,
+                               std::uint8_t index,
+                               unsigned k,
+                               unsigned m) noexcept
+    {
+        CoreFrame::BuildHeader(CoreFrame::Type::Fec, kFecFields + data_len, out);
+        StoreBe32(out + CoreFrame::kHeaderSize, block);
+        out[CoreFrame::kHeaderSize + 4] = index;
+        out[CoreFrame::kHeaderSize + 5] = static_cast<std::uint8_t>(k);
+        out[CoreFrame::kHeaderSize + 6] = static_cast<std::uint8_t>(m);
+    }
+
+    /**
+     * @brief Обратить матрицу n x n над GF(2^8) (Гаусс–Жордан).
+     * @return false — матрица вырождена.
+     */
+    bool Invert(std::uint8_t *a,
+                std::uint8_t *inv,
+                unsigned n) noexcept
+    {
+        for (unsigned r = 0; r < n; ++r)
+        {
+            for (unsigned c = 0; c < n; ++c)
+            {
+                inv[r * n + c] = r == c ? 1 : 0;
+            }
+        }
+        for (unsigned col = 0; col < n; ++col)
+        {
+            unsigned pivot = col;
+            while (pivot < n && a[pivot * n + col] == 0)
+            {
+                ++pivot;
+            }
+            if (pivot == n)
+            {
+                return false;
+            }
+            if (pivot != col)
+            {
+                for (unsigned c = 0; c < n; ++c)
+                {
+                    std::swap(a[pivot * n + c], a[col * n + c]);
+                    std::swap(inv[pivot * n + c], inv[col * n + c]);
+                }
+            }
+            const std::uint8_t scale = Gf256::Inv(a[col * n + col]);
+            for (unsigned c = 0; c < n; ++c)
+            {
+                a[col * n + c]   = Gf256::Mul(a[col * n + c], scale);
+                inv[col * n + c] = Gf256::Mul(inv[col * n + c], scale);
+            }
+            for (unsigned r = 0; r < n; ++r)
+            {
+                const std::uint8_t f = a[r * n + col];
+                if (r == col || f == 0)
+                {
+                    continue;
+                }
+                for (unsigned c = 0; c < n; ++c)
+                {
+                    a[r * n + c]   ^= Gf256::Mul(f, a[col * n + c]);
+                    inv[r * n + c] ^= Gf256::Mul(f, inv[col * n + c]);
+                }
+            }
+        }
+        return true;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// FecEncoder
+// ---------------------------------------------------------------------------
+
+FecEncoder::FecEncoder(const Options &opts)
+    : opts_(opts)
+    , sym_size_(opts.mtu + 2)
+{
+    if (opts_.k == 0 || opts_.k > kMaxSources || opts_.max_m > kMaxRepairs || opts_.min_m > opts_.max_m ||
+        !(opts_.target > 0 && opts_.target < 1) || opts_.flush.count() <= 0 || opts_.mtu == 0 ||
+        kFecFields + sym_size_ > 0xFFFF)
+    {
+        throw std::invalid_argument("FecEncoder: invalid options");
+    }
+    sources_.resize(opts_.k * sym_size_);
+    source_len_.resize(opts_.k);
+    repairs_.resize(opts_.max_m * (CoreFrame::kFecHeaderSize + sym_size_));
+    repair_len_.resize(opts_.max_m);
+    stats_.m = opts_.min_m;
+}
+
+std::size_t FecEncoder::Protect(std::uint8_t *buf,
+                                std::size_t len,
+                                std::size_t size,
+                                Clock::time_point now)
+{
+    if (len == 0 || len > opts_.mtu || len + CoreFrame::kFecHeaderSize > size)
+    {
+        return 0;
+    }
+    if (count_ == 0)
+    {
+        opened_  = now;
+        block_m_ = stats_.m;
+        sym_len_ = 0;
+    }
+    const unsigned index = count_;
+
+    std::memmove(buf + CoreFrame::kFecHeaderSize, buf, len);
+    BuildFecHeader(buf, len, block_, static_cast<std::uint8_t>(index), opts_.k, block_m_);
+
+    if (block_m_ != 0)
+    {
+        // Символ для избыточных: [длина BE16][пакет]; дополнение нулями — при закрытии блока.
+        std::uint8_t *sym = sources_.data() + index * sym_size_;
+        sym[0] = static_cast<std::uint8_t>(len >> 8);
+        sym[1] = static_cast<std::uint8_t>(len);
+        std::memcpy(sym + 2, buf + CoreFrame::kFecHeaderSize, len);
+        source_len_[index] = len + 2;
+        sym_len_ = std::max(sym_len_, len + 2);
+    }
+
+    ++count_;
+    ++stats_.sources;
+    stats_.source_bytes += len;
+    if (count_ == opts_.k)
+    {
+        CloseBlock();
+    }
+    return CoreFrame::kFecHeaderSize + len;
+}
+
+void FecEncoder::CloseBlock()
+{
+    if (block_m_ != 0 && count_ != 0)
+    {
+        if (repair_next_ < repair_count_)
+        {
+            stats_.stale += repair_count_ - repair_next_;
+        }
+        for (unsigned i = 0; i < count_; ++i)
+        {
+            std::uint8_t *sym = sources_.data() + i * sym_size_;
+            std::memset(sym + source_len_[i], 0, sym_len_ - source_len_[i]);
+        }
+        const std::size_t frame_size = CoreFrame::kFecHeaderSize + sym_size_;
+        for (unsigned j = 0; j < block_m_; ++j)
+        {
+            std::uint8_t *frame  = repairs_.data() + j * frame_size;
+            std::uint8_t *parity = frame + CoreFrame::kFecHeaderSize;
+            std::memset(parity, 0, sym_len_);
+            for (unsigned i = 0; i < count_; ++i)
+            {
+                Gf256::MulAdd(parity, sources_.data() + i * sym_size_, Coef(j, i), sym_len_);
+            }
+            BuildFecHeader(frame, sym_len_, block_, static_cast<std::uint8_t>(kRepairFlag | j), count_, block_m_);
+            repair_len_[j] = CoreFrame::kFecHeaderSize + sym_len_;
+        }
+        repair_next_  = 0;
+        repair_count_ = block_m_;
+    }
+    ++stats_.blocks;
+    ++block_;
+    count_   = 0;
+    sym_len_ = 0;
+}
+
+std::size_t FecEncoder::Poll(std::uint8_t *out,
+                             std::size_t size,
+                             Clock::time_point now)
+{
+    if (repair_next_ >= repair_count_ && count_ != 0 && now - opened_ >= opts_.flush)
+    {
+        CloseBlock();
+    }
+    if (repair_next_ >= repair_count_)
+    {
+        return 0;
+    }
+    const unsigned j = repair_next_++;
+    const std::size_t len = repair_len_[j];
+    if (len > size)
+    {
+        ++stats_.stale;
+        return 0;
+    }
+    std::memcpy(out, repairs_.data() + j * (CoreFrame::kFecHeaderSize + sym_size_), len);
+    ++stats_.repairs;
+    stats_.repair_bytes += len;
+    return len;
+}
+
+void FecEncoder::OnReport(const std::uint8_t *payload,
+                          std::size_t len) noexcept
+{
+    if (len < 4)
+    {
+        return;
+    }
+    const std::uint32_t ppm = std::min<std::uint32_t>(LoadBe32(payload), 1000000);
+    const double loss = static_cast<double>(ppm) / 1e6;
+    // Рост потерь — сразу, спад — плавно: лишняя избыточность дешевле невосстановленного блока.
+    loss_ = loss > loss_ ? loss : (3 * loss_ + loss) / 4;
+    stats_.peer_loss_ppm = ppm;
+
+    const unsigned m = ChooseRedundancy(opts_.k, loss_, opts_.target, opts_.min_m, opts_.max_m);
+    if (m != stats_.m)
+    {
+        LOGD("fec") << "Redundancy " << opts_.k << "+" << stats_.m << " -> " << opts_.k << "+" << m
+                    << " (peer loss " << ppm << " ppm)";
+        stats_.m = m;
+    }
+}
+
+void FecEncoder::Reset() noexcept
+{
+    block_        = 0;
+    count_        = 0;
+    sym_len_      = 0;
+    repair_next_  = 0;
+    repair_count_ = 0;
+}
+
+unsigned FecEncoder::ChooseRedundancy(unsigned k,
+                                      double loss,
+                                      double target,
+                                      unsigned min_m,
+                                      unsigned max_m) noexcept
+{
+    if (!(loss > 0))
+    {
+        return min_m;
+    }
+    if (loss >= 1)
+    {
+        return max_m;
+    }
+    for (unsigned m = min_m; m <= max_m; ++m)
+    {
+        // P(X <= m), X ~ Bin(k + m, loss).
+        const unsigned n = k + m;
+        double pmf = std::pow(1 - loss, n);
+        double cdf = pmf;
+        for (unsigned x = 1; x <= m; ++x)
+        {
+            pmf *= static_cast<double>(n - x + 1) / x * loss / (1 - loss);
+            cdf += pmf;
+        }
+        if (1 - cdf <= target)
+        {
+            return m;
+        }
+    }
+    return max_m;
+}
+
+// ---------------------------------------------------------------------------
+// FecDecoder
+// ---------------------------------------------------------------------------
+
+FecDecoder::FecDecoder(const Options &opts,
+                       DeliverFn deliver)
+    : opts_(opts)
+    , deliver_(std::move(deliver))
+    , sym_size_(opts.mtu + 2)
+{
+    if (opts_.max_k == 0 || opts_.max_k > kMaxSources || opts_.max_m > kMaxRepairs || opts_.blocks == 0 ||
+        opts_.hold.count() <= 0 || opts_.report_interval.count() <= 0 || opts_.mtu == 0 || !deliver_)
+    {
+        throw std::invalid_argument("FecDecoder: invalid options");
+    }
+    const std::size_t per_block = opts_.max_k + opts_.max_m;
+    blocks_.resize(opts_.blocks);
+    storage_.resize(opts_.blocks * per_block * sym_size_);
+    sym_used_.resize(opts_.blocks * per_block);
+    scratch_.resize(std::max(1u, opts_.max_m) * sym_size_);
+}
+
+std::uint8_t *FecDecoder::Symbol(std::size_t slot,
+                                 unsigned index) noexcept
+{
+    return storage_.data() + (slot * (opts_.max_k + opts_.max_m) + index) * sym_size_;
+}
+
+std::size_t &FecDecoder::Used(std::size_t slot,
+                              unsigned index) noexcept
+{
+    return sym_used_[slot * (opts_.max_k + opts_.max_m) + index];
+}
+
+bool FecDecoder::Push(const std::uint8_t *payload,
+                      std::size_t len,
+                      Clock::time_point now)
+{
+    if (len <= kFecFields)
+    {
+        ++stats_.malformed;
+        return false;
+    }
+    const std::uint32_t id    = LoadBe32(payload);
+    const std::uint8_t  index = payload[4];
+    const unsigned      k     = payload[5];
+    const unsigned      m     = payload[6];
+    const std::uint8_t *data  = payload + kFecFields;
+    const std::size_t   dlen  = len - kFecFields;
+    const unsigned      i     = index & 0x7Fu;
+    const bool          fits  = k != 0 && k <= opts_.max_k && m <= opts_.max_m;
+
+    if ((index & kRepairFlag) == 0)
+    {
+        // k и m за пределами формата не выдаёт ни один кодер; k больше max_k — чужая настройка, пакет отдаётся.
+        if (k == 0 || i >= k || k > kMaxSources || m > kMaxRepairs)
+        {
+            ++stats_.malformed;
+            return false;
+        }
+        ++stats_.sources;
+        const std::size_t slot = fits ? Acquire(id, m, now) : blocks_.size();
+        if (slot == blocks_.size())
+        {
+            // Вне окна или не по нашим пределам — без защиты, но пакет не теряем.
+            ++stats_.late;
+            deliver_(data, dlen);
+            return true;
+        }
+        Block &b = blocks_[slot];
+        if ((b.have >> i) & 1u)
+        {
+            ++stats_.duplicates;
+            return true;
+        }
+        deliver_(data, dlen);
+        b.have |= std::uint64_t{1} << i;
+        b.top   = std::max(b.top, i + 1);
+        ++b.received;
+        if (b.m != 0 && !b.done)
+        {
+            if (dlen + 2 <= sym_size_)
+            {
+                std::uint8_t *sym = Symbol(slot, i);
+                sym[0] = static_cast<std::uint8_t>(dlen >> 8);
+                sym[1] = static_cast<std::uint8_t>(dlen);
+                std::memcpy(sym + 2, data, dlen);
+                Used(slot, i) = dlen + 2;
+            }
+            else
+            {
+                // Не сохранить — блок не восстановить (TryRecover увидит длину больше символа).
+                Used(slot, i) = sym_size_ + 1;
+            }
+        }
+        TryRecover(slot);
+        return true;
+    }
+
+    if (!fits || i >= m || dlen < 2 || dlen > sym_size_)
+    {
+        ++stats_.malformed;
+        return false;
+    }
+    ++stats_.repairs;
+    const std::size_t slot = Acquire(id, m, now);
+    if (slot == blocks_.size())
+    {
+        ++stats_.late;
+        return true;
+    }
+    Block &b = blocks_[slot];
+    if ((b.rep >> i) & 1u)
+    {
+        ++stats_.duplicates;
+        return true;
+    }
+    if ((b.sym_len != 0 && b.sym_len != dlen) || (b.k != 0 && b.k != k) || b.top > k)
+    {
+        ++stats_.malformed;
+        return false;
+    }
+    b.k       = k;
+    b.sym_len = dlen;
+    b.rep    |= std::uint32_t{1} << i;
+    ++b.received;
+    std::memcpy(Symbol(slot, opts_.max_k + i), data, dlen);
+    TryRecover(slot);
+    return true;
+}
+
+std::size_t FecDecoder::Acquire(std::uint32_t id,
+                                unsigned m,
+                                Clock::time_point now)
+{
+    const auto window = static_cast<std::int32_t>(blocks_.size());
+    if (!seen_)
+    {
+        seen_    = true;
+        highest_ = id;
+    }
+    else if (static_cast<std::int32_t>(id - highest_) > 0)
+    {
+        // Блоки между highest_ и id не пришли ни одним символом.
+        const std::uint32_t gap = std::min(id - highest_ - 1, kMaxGapBlocks);
+        period_expected_ += static_cast<std::uint64_t>(gap) * last_n_;
+        highest_ = id;
+    }
+    else if (static_cast<std::int32_t>(highest_ - id) >= window)
+    {
+        return blocks_.size();
+    }
+
+    const std::size_t slot = id % blocks_.size();
+    Block &b = blocks_[slot];
+    if (b.active)
+    {
+        if (b.id == id)
+        {
+            return slot;
+        }
+        if (static_cast<std::int32_t>(id - b.id) < 0)
+        {
+            return blocks_.size();
+        }
+        Finalize(b);
+    }
+    b        = Block{};
+    b.active = true;
+    b.id     = id;
+    b.m      = m;
+    b.first  = now;
+    return slot;
+}
+
+void FecDecoder::TryRecover(std::size_t slot)
+{
+    Block &b = blocks_[slot];
+    if (b.done || b.k == 0 || b.sym_len == 0)
+    {
+        return;
+    }
+
+    std::array<unsigned, kMaxRepairs> missing{};
+    unsigned e = 0;
+    for (unsigned i = 0; i < b.k; ++i)
+    {
+        if (((b.have >> i) & 1u) == 0)
+        {
+            if (e == kMaxRepairs)
+            {
+                return;
+            }
+            missing[e++] = i;
+        }
+    }
+    if (e == 0)
+    {
+        b.done = true;
+        return;
+    }
+    if (static_cast<unsigned>(std::popcount(b.rep)) < e)
+    {
+        return;
+    }
+
+    std::array<unsigned, kMaxRepairs> rows{};
+    for (unsigned j = 0, r = 0; r < e; ++j)
+    {
+        if ((b.rep >> j) & 1u)
+        {
+            rows[r++] = j;
+        }
+    }
+
+    std::array<std::uint8_t, kMaxRepairs * kMaxRepairs> a{};
+    std::array<std::uint8_t, kMaxRepairs * kMaxRepairs> inv{};
+    for (unsigned r = 0; r < e; ++r)
+    {
+        for (unsigned c = 0; c < e; ++c)
+        {
+            a[r * e + c] = Coef(rows[r], missing[c]);
+        }
+    }
+    if (!Invert(a.data(), inv.data(), e))
+    {
+        b.done = true;
+        return;
+    }
+
+    // Из избыточных символов вычитаются вклады принятых исходных: остаётся A * пропуски.
+    for (unsigned r = 0; r < e; ++r)
+    {
+        std::uint8_t *row = scratch_.data() + r * sym_size_;
+        std::memcpy(row, Symbol(slot, opts_.max_k + rows[r]), b.sym_len);
+    }
+    for (unsigned i = 0; i < b.k; ++i)
+    {
+        if (((b.have >> i) & 1u) == 0)
+        {
+            continue;
+        }
+        const std::size_t used = Used(slot, i);
+        if (used > b.sym_len)
+        {
+            ++stats_.malformed;
+            b.done = true;
+            return;
+        }
+        std::uint8_t *sym = Symbol(slot, i);
+        std::memset(sym + used, 0, b.sym_len - used);
+        for (unsigned r = 0; r < e; ++r)
+        {
+            Gf256::MulAdd(scratch_.data() + r * sym_size_, sym, Coef(rows[r], i), b.sym_len);
+        }
+    }
+
+    for (unsigned c = 0; c < e; ++c)
+    {
+        std::uint8_t *out = Symbol(slot, missing[c]);
+        std::memset(out, 0, b.sym_len);
+        for (unsigned r = 0; r < e; ++r)
+        {
+            Gf256::MulAdd(out, scratch_.data() + r * sym_size_, inv[c * e + r], b.sym_len);
+        }
+        const std::size_t plen = (static_cast<std::size_t>(out[0]) << 8) | out[1];
+        if (plen == 0 || plen + 2 > b.sym_len)
+        {
+            ++stats_.malformed;
+            continue;
+        }
+        b.have |= std::uint64_t{1} << missing[c];
+        Used(slot, missing[c]) = plen + 2;
+        ++stats_.recovered;
+        deliver_(out + 2, plen);
+    }
+    b.done = true;
+}
+
+void FecDecoder::Finalize(Block &b) noexcept
+{
+    const unsigned k = b.k != 0 ? b.k : b.top;
+    const unsigned n = k + b.m;
+    const std::uint64_t mask = k >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << k) - 1;
+    const auto got = static_cast<unsigned>(std::popcount(b.have & mask));
+    if (got < k)
+    {
+        stats_.unrecovered += k - got;
+    }
+    period_expected_ += n;
+    period_received_ += std::min(b.received, n);
+    last_n_ = n;
+    ++stats_.blocks;
+    b.active = false;
+}
+
+std::size_t FecDecoder::Poll(std::uint8_t *out,
+                             std::size_t size,
+                             Clock::time_point now)
+{
+    if (last_report_ == Clock::time_point{})
+    {
+        last_report_ = now;
+    }
+    for (Block &b : blocks_)
+    {
+        if (b.active && now - b.first >= opts_.hold)
+        {
+            Finalize(b);
+        }
+    }
+    if (now - last_report_ < opts_.report_interval || period_expected_ == 0)
+    {
+        return 0;
+    }
+
+    const std::uint64_t lost = period_expected_ - std::min(period_received_, period_expected_);
+    const auto ppm = static_cast<std::uint32_t>(lost * 1000000 / period_expected_);
+    std::uint8_t payload[4];
+    StoreBe32(payload, ppm);
+    const std::size_t n = CoreFrame::Build(CoreFrame::Type::FecReport, payload, sizeof(payload), out, size);
+    if (n == 0)
+    {
+        return 0;
+    }
+    stats_.loss_ppm  = ppm;
+    period_expected_ = 0;
+    period_received_ = 0;
+    last_report_     = now;
+    return n;
+}
+
+void FecDecoder::Reset() noexcept
+{
+    for (Block &b : blocks_)
+    {
+        b.active = false;
+    }
+    seen_            = false;
+    highest_         = 0;
+    last_n_          = 0;
+    period_expected_ = 0;
+    period_received_ = 0;
+}
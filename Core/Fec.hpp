@@ -0,0 +1,276 @@
+#pragma once
+// Fec.hpp — систематический код Рида–Соломона над блоками пакетов с адаптивной избыточностью.
+
+#include "CoreFrame.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Формат кадра CoreFrame::Type::Fec (нагрузка):
+ *   [блок BE32][индекс][k][m][данные]
+ * - индекс < 0x80 — исходный пакет номер индекс, данные — сам пакет без изменений;
+ * - индекс >= 0x80 — избыточный символ номер (индекс & 0x7F), данные — символ.
+ * Символ исходного пакета — [длина BE16][пакет], дополненный нулями до самого
+ * длинного в блоке. Избыточный символ j = сумма c(j, i) * символ i, где
+ * c(j, i) = 1 / ((0x80 + j) ^ i) — матрица Коши: любые k из k + m символов
+ * восстанавливают блок. В исходных пакетах k и m — плановые, в избыточных
+ * k — фактическое число пакетов в блоке (блок мог закрыться по таймеру).
+ */
+
+/**
+ * @brief Кодер FEC отправителя.
+ *
+ * Исходные пакеты уходят сразу (код систематический: без потерь — без задержки),
+ * избыточные символы — после закрытия блока: набралось k пакетов или блок
+ * открыт дольше flush (при редком трафике k фактически уменьшается).
+ * Число избыточных символов m пересчитывается по потерям, о которых сообщает
+ * приёмник (CoreFrame::Type::FecReport): наименьшее m, при котором вероятность
+ * потерять в блоке больше m символов не выше target. Без потерь m = min_m,
+ * и накладные расходы — только заголовок кадра.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class FecEncoder
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Предел исходных пакетов в блоке.
+    static constexpr unsigned kMaxSources = 64;
+    /// @brief Предел избыточных символов в блоке.
+    static constexpr unsigned kMaxRepairs = 32;
+
+    /**
+     * @brief Параметры кодера.
+     */
+    struct Options
+    {
+        /// @brief Исходных пакетов в блоке (1..kMaxSources).
+        unsigned k = 10;
+        /// @brief Нижняя граница избыточности.
+        unsigned min_m = 0;
+        /// @brief Верхняя граница избыточности (min_m..kMaxRepairs).
+        unsigned max_m = 4;
+        /// @brief Допустимая вероятность невосстановимого блока.
+        double target = 1e-3;
+        /// @brief Сколько блок может ждать k-й пакет.
+        std::chrono::milliseconds flush{10};
+        /// @brief Максимальный размер защищаемого пакета.
+        std::size_t mtu = 1500;
+    };
+
+    /**
+     * @brief Счётчики кодера.
+     */
+    struct Stats
+    {
+        std::uint64_t sources      = 0;   ///< Исходных пакетов отправлено в блоках.
+        std::uint64_t repairs      = 0;   ///< Избыточных символов отправлено.
+        std::uint64_t blocks       = 0;   ///< Закрытых блоков.
+        std::uint64_t source_bytes = 0;
+        std::uint64_t repair_bytes = 0;
+        std::uint64_t stale        = 0;   ///< Избыточных символов, вытесненных следующим блоком до отправки.
+        std::uint32_t peer_loss_ppm = 0;  ///< Последние потери по сообщению приёмника.
+        unsigned      m            = 0;   ///< Текущая избыточность.
+    };
+
+    /**
+     * @brief Создать кодер.
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    explicit FecEncoder(const Options &opts);
+
+    FecEncoder(const FecEncoder &) = delete;
+    FecEncoder &operator=(const FecEncoder &) = delete;
+
+    /**
+     * @brief Обернуть пакет, лежащий в buf, в кадр Fec (на месте, сдвигом на kFecHeaderSize).
+     * @param size Ёмкость buf.
+     * @return Длина кадра; 0 — пакет не защищается (велик для mtu или для buf) и остаётся как есть.
+     */
+    std::size_t Protect(std::uint8_t *buf, std::size_t len, std::size_t size, Clock::time_point now);
+
+    /**
+     * @brief Следующий избыточный символ (закрывает блок по таймеру flush).
+     * @return Длина кадра в out; 0 — слать нечего.
+     */
+    std::size_t Poll(std::uint8_t *out, std::size_t size, Clock::time_point now);
+
+    /**
+     * @brief Нагрузка кадра FecReport от приёмника.
+     */
+    void OnReport(const std::uint8_t *payload, std::size_t len) noexcept;
+
+    /**
+     * @brief Новое соединение: блоки с нуля, неотправленное отбрасывается, оценка потерь сохраняется.
+     */
+    void Reset() noexcept;
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+    /**
+     * @brief Наименьшее m в [min_m, max_m], при котором P(потеряно > m из k + m) <= target.
+     * @param loss Доля потерь символов (0..1).
+     */
+    static unsigned ChooseRedundancy(unsigned k, double loss, double target, unsigned min_m, unsigned max_m) noexcept;
+
+private:
+    Options     opts_;
+    std::size_t sym_size_;                      ///< mtu + 2 (длина пакета в символе).
+
+    std::vector<std::uint8_t> sources_;         ///< k символов текущего блока.
+    std::vector<std::size_t>  source_len_;      ///< Длина символа (без дополнения).
+    std::vector<std::uint8_t> repairs_;         ///< max_m готовых кадров закрытого блока.
+    std::vector<std::size_t>  repair_len_;
+
+    std::uint32_t     block_   = 0;
+    unsigned          count_   = 0;             ///< Пакетов в текущем блоке.
+    unsigned          block_m_ = 0;             ///< Избыточность текущего блока (фиксируется при открытии).
+    std::size_t       sym_len_ = 0;             ///< Самый длинный символ текущего блока.
+    Clock::time_point opened_;
+    unsigned          repair_next_  = 0;
+    unsigned          repair_count_ = 0;
+
+    double loss_ = 0;                           ///< Сглаженная оценка потерь.
+    Stats  stats_;
+
+    /// @brief Закрыть блок: посчитать избыточные символы и начать следующий.
+    void CloseBlock();
+};
+
+/**
+ * @brief Декодер FEC получателя.
+ *
+ * Исходный пакет отдаётся сразу; когда избыточных символов блока хватает на
+ * все пропуски, недостающие пакеты восстанавливаются (решение системы над
+ * GF(2^8) по принятым символам) и отдаются тут же — без ожидания повтора.
+ * Одновременно держится blocks блоков; блок старше hold или вытесненный новым
+ * закрывается и учитывается в потерях. Раз в report_interval Poll собирает
+ * кадр FecReport с долей потерянных символов для кодера отправителя.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class FecDecoder
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Параметры декодера.
+     */
+    struct Options
+    {
+        /// @brief Наибольшее k, которое примет декодер.
+        unsigned max_k = 10;
+        /// @brief Наибольшее m, которое примет декодер.
+        unsigned max_m = 4;
+        /// @brief Блоков в работе одновременно.
+        unsigned blocks = 4;
+        /// @brief Сколько ждать символы блока.
+        std::chrono::milliseconds hold{200};
+        /// @brief Период отчёта о потерях.
+        std::chrono::milliseconds report_interval{500};
+        /// @brief Максимальный размер пакета.
+        std::size_t mtu = 1500;
+    };
+
+    /**
+     * @brief Счётчики декодера.
+     */
+    struct Stats
+    {
+        std::uint64_t sources     = 0;   ///< Принято исходных пакетов.
+        std::uint64_t repairs     = 0;   ///< Принято избыточных символов.
+        std::uint64_t recovered   = 0;   ///< Восстановлено пакетов.
+        std::uint64_t unrecovered = 0;   ///< Потеряно без возможности восстановления.
+        std::uint64_t duplicates  = 0;
+        std::uint64_t late        = 0;   ///< Пакетов блока, уже вышедшего из окна (отданы без защиты).
+        std::uint64_t malformed   = 0;
+        std::uint64_t blocks      = 0;   ///< Закрытых блоков.
+        std::uint32_t loss_ppm    = 0;   ///< Потери символов за последний отчётный период.
+    };
+
+    /** @brief Выдача пакета (исходного или восстановленного). */
+    using DeliverFn = std::function<void(const std::uint8_t *data, std::size_t len)>;
+
+    /**
+     * @brief Создать декодер (память под все блоки выделяется здесь).
+     * @throw std::invalid_argument Некорректные Options или пустой deliver.
+     */
+    FecDecoder(const Options &opts, DeliverFn deliver);
+
+    FecDecoder(const FecDecoder &) = delete;
+    FecDecoder &operator=(const FecDecoder &) = delete;
+
+    /**
+     * @brief Принять нагрузку кадра Fec.
+     * @return false — нагрузка некорректна (отброшена).
+     */
+    bool Push(const std::uint8_t *payload, std::size_t len, Clock::time_point now);
+
+    /**
+     * @brief Закрыть просроченные блоки; если пора — собрать кадр FecReport.
+     * @return Длина кадра в out; 0 — отчёта нет.
+     */
+    std::size_t Poll(std::uint8_t *out, std::size_t size, Clock::time_point now);
+
+    /**
+     * @brief Новое соединение: блоки отбрасываются, счётчики сохраняются.
+     */
+    void Reset() noexcept;
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+private:
+    struct Block
+    {
+        bool              active = false;
+        bool              done   = false;    ///< Восстановлен или восстанавливать нечего.
+        std::uint32_t     id     = 0;
+        unsigned          k      = 0;        ///< Из избыточного символа; 0 — ещё неизвестно.
+        unsigned          top    = 0;        ///< Наибольший принятый индекс исходного + 1.
+        unsigned          m      = 0;
+        std::uint64_t     have   = 0;        ///< Принятые (и восстановленные) исходные.
+        std::uint32_t     rep    = 0;        ///< Принятые избыточные.
+        unsigned          received = 0;      ///< Символов принято по сети.
+        std::size_t       sym_len  = 0;      ///< Длина избыточного символа; 0 — ещё неизвестна.
+        Clock::time_point first;
+    };
+
+    Options     opts_;
+    DeliverFn   deliver_;
+    std::size_t sym_size_;
+
+    std::vector<Block>        blocks_;
+    std::vector<std::uint8_t> storage_;      ///< blocks * (max_k + max_m) символов.
+    std::vector<std::size_t>  sym_used_;     ///< Длина каждого символа без дополнения.
+    std::vector<std::uint8_t> scratch_;      ///< max_m строк для решения системы.
+
+    bool          seen_    = false;
+    std::uint32_t highest_ = 0;              ///< Новейший блок.
+    unsigned      last_n_  = 0;              ///< k + m последнего закрытого блока (для целиком пропавших).
+
+    std::uint64_t     period_expected_ = 0;
+    std::uint64_t     period_received_ = 0;
+    Clock::time_point last_report_;
+
+    Stats stats_;
+
+    std::uint8_t *Symbol(std::size_t slot, unsigned index) noexcept;
+    std::size_t  &Used(std::size_t slot, unsigned index) noexcept;
+
+    /// @brief Слот блока id; blocks_.size() — блок уже вышел из окна.
+    std::size_t Acquire(std::uint32_t id, unsigned m, Clock::time_point now);
+
+    /// @brief Восстановить пропуски, если избыточных символов хватает.
+    void TryRecover(std::size_t slot);
+
+    /// @brief Закрыть блок и учесть его в потерях.
+    void Finalize(Block &b) noexcept;
+};
@@ -0,0 +1,445 @@
+// FlowAccounting.cpp — реализация учёта потоков и выгрузки IPFIX/CSV.
+
+#include "FlowAccounting.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+    /// @brief Наибольшее число мест, просматриваемых при слиянии в запись сессии.
+    constexpr std::size_t kFoldProbe = 16;
+
+    /// @brief Шаблон записи данных IPFIX.
+    constexpr std::uint16_t kTemplateId = 256;
+
+    /// @brief Private Enterprise Number для документации и примеров (RFC 5612).
+    constexpr std::uint32_t kEnterprise = 32473;
+
+    /// @brief Поле шаблона: номер информационного элемента, длина, предприятие (0 — IANA).
+    struct Field
+    {
+        std::uint16_t id;
+        std::uint16_t len;
+        std::uint32_t enterprise;
+    };
+
+    constexpr Field kFields[] = {
+        {27,  16, 0},            // sourceIPv6Address
+        {28,  16, 0},            // destinationIPv6Address
+        {7,   2,  0},            // sourceTransportPort
+        {11,  2,  0},            // destinationTransportPort
+        {4,   1,  0},            // protocolIdentifier
+        {61,  1,  0},            // flowDirection (0 — ingress, 1 — egress)
+        {1,   8,  0},            // octetDeltaCount
+        {2,   8,  0},            // packetDeltaCount
+        {152, 8,  0},            // flowStartMilliseconds
+        {153, 8,  0},            // flowEndMilliseconds
+        {136, 1,  0},            // flowEndReason
+        {305, 4,  0},            // samplingPacketInterval
+        {1,   8,  kEnterprise},  // номер сессии
+    };
+
+    constexpr std::size_t kHeaderSize = 16;
+    /// @brief Сообщение IPFIX не длиннее 65535 байт: заголовок, шаблон, набор данных.
+    constexpr std::size_t kMaxMessage = 65535;
+
+    constexpr std::size_t TemplateSetSize() noexcept
+    {
+        std::size_t n = 4 + 4;   // заголовок набора, заголовок шаблона
+        for (const Field &f : kFields)
+        {
+            n += f.enterprise != 0 ? 8 : 4;
+        }
+        return n;
+    }
+
+    constexpr std::size_t RecordSize() noexcept
+    {
+        std::size_t n = 0;
+        for (const Field &f : kFields)
+        {
+            n += f.len;
+        }
+        return n;
+    }
+
+    static_assert(RecordSize() == FlowExporter::kIpfixRecordSize);
+
+    constexpr std::size_t kRecordsPerMessage =
+        (kMaxMessage - kHeaderSize - TemplateSetSize() - 4) / FlowExporter::kIpfixRecordSize;
+
+    void PutBe(std::string &out, std::uint64_t v, unsigned bytes)
+    {
+        for (unsigned i = bytes; i-- > 0;)
+        {
+            out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+        }
+    }
+
+    void SetBe16(std::string &out, std::size_t pos, std::size_t v) noexcept
+    {
+        out[pos]     = static_cast<char>((v >> 8) & 0xFF);
+        out[pos + 1] = static_cast<char>(v & 0xFF);
+    }
+}
+
+// ---- FlowAccounting ----
+
+FlowAccounting::FlowAccounting(const Options &opts)
+    : table_(FlowTable::Options{opts.capacity, opts.idle, std::chrono::milliseconds(100), opts.seed},
+             [this](FlowTable::FlowId id, const FlowTable::Key &, FlowTable::Reason why) { Retire(id, why); })
+    , sample_(opts.sample)
+    , retired_limit_(opts.retired)
+    , rng_(opts.seed != 0 ? opts.seed : (static_cast<std::uint64_t>(std::random_device{}()) << 32) | std::random_device{}())
+{
+    if (opts.sample == 0 || opts.sample > (1u << 24) || opts.retired == 0)
+    {
+        throw std::invalid_argument("FlowAccounting: invalid options");
+    }
+    session_.resize(opts.capacity);
+    packets_.resize(opts.capacity);
+    bytes_.resize(opts.capacity);
+    first_.resize(opts.capacity);
+    last_.resize(opts.capacity);
+    dir_.resize(opts.capacity);
+    retired_.reserve(opts.retired);
+    folded_.resize(std::bit_ceil(2 * opts.retired));
+    lumped_[0].dir = Direction::Upstream;
+    lumped_[1].dir = Direction::Downstream;
+    lumped_[0].end = lumped_[1].end = End::Evicted;
+    skip_ = NextSkip();
+}
+
+std::uint32_t FlowAccounting::NextSkip() noexcept
+{
+    if (sample_ == 1)
+    {
+        return 1;
+    }
+    // xorshift64*: равномерный пропуск в [1, 2N-1].
+    rng_ ^= rng_ >> 12;
+    rng_ ^= rng_ << 25;
+    rng_ ^= rng_ >> 27;
+    const std::uint64_t r = (rng_ * 0x2545F4914F6CDD1DULL) >> 32;
+    return static_cast<std::uint32_t>(1 + r % (2 * static_cast<std::uint64_t>(sample_) - 1));
+}
+
+bool FlowAccounting::Account(const std::uint8_t *pkt,
+                             std::size_t len,
+                             std::uint64_t session,
+                             Direction dir,
+                             Clock::time_point now) noexcept
+{
+    ++stats_.seen;
+    if (--skip_ != 0)
+    {
+        return false;
+    }
+    skip_ = NextSkip();
+
+    FlowTable::Key key;
+    if (!FlowTable::ExtractKey(pkt, len, &key))
+    {
+        ++stats_.unparsed;
+        return false;
+    }
+    bool created = false;
+    const FlowTable::FlowId id = table_.Touch(key, now, &created);
+    if (created)
+    {
+        session_[id] = session;
+        dir_[id]     = dir;
+        packets_[id] = 0;
+        bytes_[id]   = 0;
+    }
+    if (packets_[id] == 0)
+    {
+        first_[id] = now;
+    }
+    ++packets_[id];
+    bytes_[id] += len;
+    last_[id]   = now;
+    ++stats_.sampled;
+    return true;
+}
+
+FlowAccounting::Record FlowAccounting::Take(FlowTable::FlowId id,
+                                            End end) const noexcept
+{
+    Record r;
+    r.key     = table_.KeyOf(id);
+    r.session = session_[id];
+    r.packets = packets_[id] * sample_;
+    r.bytes   = bytes_[id] * sample_;
+    r.first   = first_[id];
+    r.last    = last_[id];
+    r.dir     = dir_[id];
+    r.end     = end;
+    return r;
+}
+
+void FlowAccounting::Retire(FlowTable::FlowId id,
+                            FlowTable::Reason why) noexcept
+{
+    if (packets_[id] == 0)
+    {
+        return;
+    }
+    const End end = why == FlowTable::Reason::Expired ? End::Idle : End::Evicted;
+    if (retired_.size() < retired_limit_)
+    {
+        retired_.push_back(Take(id, end));
+    }
+    else
+    {
+        // Запись сессии: линейное пробирование, не дальше kFoldProbe мест.
+        const std::size_t mask = folded_.size() - 1;
+        std::size_t pos = static_cast<std::size_t>((session_[id] * 2 + static_cast<unsigned>(dir_[id])) * 0x9E3779B97F4A7C15ULL >> 40) & mask;
+        Record *to = nullptr;
+        for (std::size_t i = 0; i < kFoldProbe; ++i, pos = (pos + 1) & mask)
+        {
+            Record &f = folded_[pos];
+            if (f.packets == 0 || (f.session == session_[id] && f.dir == dir_[id]))
+            {
+                to = &f;
+                break;
+            }
+        }
+        if (to != nullptr)
+        {
+            if (to->packets == 0)
+            {
+                *to         = Record{};
+                to->session = session_[id];
+                to->dir     = dir_[id];
+                to->end     = End::Evicted;
+            }
+            ++stats_.folded;
+        }
+        else
+        {
+            to = &lumped_[static_cast<unsigned>(dir_[id])];
+            ++stats_.lumped;
+        }
+        Fold(*to, id);
+    }
+    packets_[id] = 0;
+    bytes_[id]   = 0;
+}
+
+void FlowAccounting::Fold(Record &to,
+                          FlowTable::FlowId id) noexcept
+{
+    if (to.packets == 0)
+    {
+        to.first = first_[id];
+        to.last  = last_[id];
+    }
+    to.packets += packets_[id] * sample_;
+    to.bytes   += bytes_[id] * sample_;
+    to.first    = std::min(to.first, first_[id]);
+    to.last     = std::max(to.last, last_[id]);
+}
+
+std::size_t FlowAccounting::Memory() const noexcept
+{
+    return table_.Memory() +
+           session_.capacity() * (3 * sizeof(std::uint64_t) + 2 * sizeof(Clock::time_point) + sizeof(Direction)) +
+           (retired_.capacity() + folded_.capacity()) * sizeof(Record);
+}
+
+// ---- FlowExporter ----
+
+FlowExporter::FlowExporter(const Options &opts)
+    : opts_(opts)
+{
+    out_.open(opts.path, std::ios::binary | std::ios::app);
+    if (!out_)
+    {
+        throw std::runtime_error("FlowExporter: cannot open '" + opts.path + "'");
+    }
+    if (opts.format == Format::Csv && out_.tellp() == 0)
+    {
+        out_ << "export_ms,session,direction,proto,src,sport,dst,dport,packets,bytes,first_ms,last_ms,end,sample\n";
+        out_.flush();
+    }
+}
+
+std::int64_t FlowExporter::WallMs(Clock::time_point t) const noexcept
+{
+    return wall_ms_ + std::chrono::duration_cast<std::chrono::milliseconds>(t - mono_).count();
+}
+
+void FlowExporter::Begin(Clock::time_point now,
+                         unsigned sample)
+{
+    buf_.clear();
+    records_     = 0;
+    msg_records_ = 0;
+    sample_      = sample;
+    mono_        = now;
+    wall_ms_     = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void FlowExporter::OpenMessage()
+{
+    msg_start_   = buf_.size();
+    msg_records_ = 0;
+    PutBe(buf_, 10, 2);                                          // версия IPFIX
+    PutBe(buf_, 0, 2);                                           // длина — в CloseMessage
+    PutBe(buf_, static_cast<std::uint64_t>(wall_ms_ / 1000), 4); // Export Time
+    PutBe(buf_, sequence_, 4);
+    PutBe(buf_, opts_.domain, 4);
+
+    PutBe(buf_, 2, 2);                                           // набор шаблонов
+    PutBe(buf_, TemplateSetSize(), 2);
+    PutBe(buf_, kTemplateId, 2);
+    PutBe(buf_, std::size(kFields), 2);
+    for (const Field &f : kFields)
+    {
+        PutBe(buf_, f.enterprise != 0 ? (f.id | 0x8000u) : f.id, 2);
+        PutBe(buf_, f.len, 2);
+        if (f.enterprise != 0)
+        {
+            PutBe(buf_, f.enterprise, 4);
+        }
+    }
+    PutBe(buf_, kTemplateId, 2);                                 // набор данных
+    PutBe(buf_, 0, 2);
+}
+
+void FlowExporter::CloseMessage()
+{
+    const std::size_t set_pos = msg_start_ + kHeaderSize + TemplateSetSize();
+    SetBe16(buf_, msg_start_ + 2, buf_.size() - msg_start_);
+    SetBe16(buf_, set_pos + 2, buf_.size() - set_pos);
+    sequence_ += static_cast<std::uint32_t>(msg_records_);
+    msg_records_ = 0;
+}
+
+void FlowExporter::Add(const FlowAccounting::Record &r)
+{
+    ++records_;
+    const std::int64_t first = WallMs(r.first);
+    const std::int64_t last  = WallMs(r.last);
+    if (opts_.format == Format::Csv)
+    {
+        char line[320];
+        const int n = std::snprintf(line, sizeof(line), "%lld,%llu,%s,%u,%s,%u,%s,%u,%llu,%llu,%lld,%lld,%u,%u\n",
+                                    static_cast<long long>(wall_ms_),
+                                    static_cast<unsigned long long>(r.session),
+                                    r.dir == FlowAccounting::Direction::Upstream ? "up" : "down",
+                                    static_cast<unsigned>(r.key.proto),
+                                    FormatAddr(r.key.src).c_str(), static_cast<unsigned>(r.key.sport),
+                                    FormatAddr(r.key.dst).c_str(), static_cast<unsigned>(r.key.dport),
+                                    static_cast<unsigned long long>(r.packets),
+                                    static_cast<unsigned long long>(r.bytes),
+                                    static_cast<long long>(first), static_cast<long long>(last),
+                                    static_cast<unsigned>(r.end), sample_);
+        if (n > 0)
+        {
+            buf_.append(line, std::min(static_cast<std::size_t>(n), sizeof(line) - 1));
+        }
+        return;
+    }
+
+    if (msg_records_ == kRecordsPerMessage)
+    {
+        CloseMessage();
+    }
+    if (msg_records_ == 0)
+    {
+        OpenMessage();
+    }
+    buf_.append(reinterpret_cast<const char *>(r.key.src), 16);
+    buf_.append(reinterpret_cast<const char *>(r.key.dst), 16);
+    PutBe(buf_, r.key.sport, 2);
+    PutBe(buf_, r.key.dport, 2);
+    PutBe(buf_, r.key.proto, 1);
+    PutBe(buf_, static_cast<std::uint64_t>(r.dir), 1);
+    PutBe(buf_, r.bytes, 8);
+    PutBe(buf_, r.packets, 8);
+    PutBe(buf_, static_cast<std::uint64_t>(first), 8);
+    PutBe(buf_, static_cast<std::uint64_t>(last), 8);
+    PutBe(buf_, static_cast<std::uint64_t>(r.end), 1);
+    PutBe(buf_, sample_, 4);
+    PutBe(buf_, r.session, 8);
+    ++msg_records_;
+}
+
+std::size_t FlowExporter::Commit()
+{
+    if (opts_.format == Format::Ipfix && msg_records_ != 0)
+    {
+        CloseMessage();
+    }
+    if (!buf_.empty())
+    {
+        out_.write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+        out_.flush();
+        if (!out_)
+        {
+            out_.clear();
+            throw std::runtime_error("FlowExporter: write to '" + opts_.path + "' failed");
+        }
+    }
+    buf_.clear();
+    const std::size_t n = records_;
+    records_ = 0;
+    return n;
+}
+
+std::string FlowExporter::FormatAddr(const std::uint8_t addr[16])
+{
+    static constexpr std::uint8_t kMapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+    char text[48];
+    if (std::memcmp(addr, kMapped, sizeof(kMapped)) == 0)
+    {
+        std::snprintf(text, sizeof(text), "%u.%u.%u.%u", addr[12], addr[13], addr[14], addr[15]);
+        return text;
+    }
+    unsigned words[8];
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        words[i] = (static_cast<unsigned>(addr[2 * i]) << 8) | addr[2 * i + 1];
+    }
+    // RFC 5952: самая длинная (первая из равных) серия нулей от двух слов — "::".
+    int best = -1, best_len = 1;
+    for (int i = 0; i < 8;)
+    {
+        int j = i;
+        while (j < 8 && words[j] == 0)
+        {
+            ++j;
+        }
+        if (j - i > best_len)
+        {
+            best     = i;
+            best_len = j - i;
+        }
+        i = j == i ? i + 1 : j;
+    }
+    std::string out;
+    for (int i = 0; i < 8; ++i)
+    {
+        if (i == best)
+        {
+            out += "::";
+            i += best_len - 1;
+            continue;
+        }
+        if (!out.empty() && out.back() != ':')
+        {
+            out += ':';
+        }
+        std::snprintf(text, sizeof(text), "%x", words[i]);
+        out += text;
+    }
+    return out;
+}
@@ -0,0 +1,290 @@
+#pragma once
+// FlowAccounting.hpp — учёт трафика по потокам (точный или 1-из-N) и выгрузка записей в IPFIX/CSV.
+
+#include "FlowTable.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Счётчики пакетов и байт по потокам сессий для биллинга и планирования ёмкости.
+ *
+ * - Потоки — в FlowTable (фиксированная память, вытеснение, истечение простоя);
+ *   счётчики — массивы по номеру потока, на пакет нет аллокаций.
+ * - Выборка 1-из-N как в sFlow: между учтёнными пакетами — случайный пропуск
+ *   в [1, 2N-1] (в среднем N), пропущенный пакет стоит одного декремента.
+ *   Выгружаемые счётчики — оценки: учтённое, умноженное на N.
+ * - Drain отдаёт приросты с прошлой выгрузки (промежуточные записи, как active
+ *   timeout в IPFIX) и итоговые записи удалённых потоков. Итоговые копятся
+ *   в ограниченном буфере; при его переполнении (шторм вытеснений) счёт
+ *   сливается в запись сессии без ключа потока, а если и таких мест нет —
+ *   в общую запись направления. Суммы не теряются никогда, разбивка по
+ *   сессиям — пока хватает мест.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца (или свой
+ * экземпляр на шард).
+ */
+class FlowAccounting
+{
+public:
+    using Clock = FlowTable::Clock;
+
+    /// @brief Направление относительно туннеля.
+    enum class Direction : std::uint8_t
+    {
+        Upstream   = 0,   ///< Клиент -> сеть (вход в туннельный сервер).
+        Downstream = 1,   ///< Сеть -> клиент.
+    };
+
+    /// @brief Почему выгружена запись (коды flowEndReason IPFIX).
+    enum class End : std::uint8_t
+    {
+        Idle    = 1,   ///< Поток простоял дольше idle.
+        Active  = 2,   ///< Промежуточная выгрузка живого потока.
+        Flush   = 4,   ///< Выгрузка при остановке.
+        Evicted = 5,   ///< Вытеснен: таблица полна (или запись слита в общую).
+    };
+
+    /**
+     * @brief Параметры учёта.
+     */
+    struct Options
+    {
+        /// @brief Наибольшее число потоков.
+        std::size_t capacity = 65536;
+        /// @brief Учитывать 1 пакет из sample (1 — каждый).
+        unsigned sample = 1;
+        /// @brief Простой, после которого поток закрывается итоговой записью.
+        std::chrono::milliseconds idle{120000};
+        /// @brief Итоговых записей между выгрузками (столько же мест для слитых записей сессий).
+        std::size_t retired = 4096;
+        /// @brief Ключ хэша и выборки (0 — случайный).
+        std::uint64_t seed = 0;
+    };
+
+    /**
+     * @brief Запись выгрузки.
+     */
+    struct Record
+    {
+        FlowTable::Key    key;            ///< Нулевой — слитые итоговые записи.
+        std::uint64_t     session = 0;    ///< 0 с нулевым ключом — слитые записи всех сессий.
+        std::uint64_t     packets = 0;    ///< Оценка за период (учтённые * sample).
+        std::uint64_t     bytes   = 0;
+        Clock::time_point first;          ///< Первый учтённый пакет периода.
+        Clock::time_point last;           ///< Последний учтённый пакет.
+        Direction         dir = Direction::Upstream;
+        End               end = End::Active;
+    };
+
+    /**
+     * @brief Счётчики учёта.
+     */
+    struct Stats
+    {
+        std::uint64_t seen     = 0;   ///< Пакетов предъявлено.
+        std::uint64_t sampled  = 0;   ///< Пакетов учтено.
+        std::uint64_t unparsed = 0;   ///< Учтённых, но не разобранных (не IP).
+        std::uint64_t records  = 0;   ///< Записей выгружено.
+        std::uint64_t folded   = 0;   ///< Итоговых записей слито в записи сессий (буфер полон).
+        std::uint64_t lumped   = 0;   ///< Итоговых записей слито в общую запись (нет мест и для сессий).
+    };
+
+    /**
+     * @brief Создать учёт (вся память выделяется здесь).
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    explicit FlowAccounting(const Options &opts);
+
+    FlowAccounting(const FlowAccounting &) = delete;
+    FlowAccounting &operator=(const FlowAccounting &) = delete;
+
+    /**
+     * @brief Предъявить пакет сессии.
+     * @return true — пакет учтён (попал в выборку и разобран).
+     */
+    bool Account(const std::uint8_t *pkt, std::size_t len, std::uint64_t session,
+                 Direction dir, Clock::time_point now) noexcept;
+
+    /**
+     * @brief Выгрузить итоговые записи и приросты живых потоков: fn(const Record &).
+     * @param flush true — живые потоки выгружаются с End::Flush (остановка).
+     * @return Число записей.
+     */
+    template <typename Fn>
+    std::size_t Drain(Clock::time_point now, Fn &&fn, bool flush = false);
+
+    /** @brief Знаменатель выборки. */
+    unsigned Sample() const noexcept { return sample_; }
+
+    /** @brief Число живых потоков. */
+    std::size_t Flows() const noexcept { return table_.Size(); }
+
+    /** @brief Память учёта, байт. */
+    std::size_t Memory() const noexcept;
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+private:
+    FlowTable table_;
+    unsigned  sample_;
+
+    // Счётчики потоков по номеру FlowTable (за текущий период).
+    std::vector<std::uint64_t>     session_;
+    std::vector<std::uint64_t>     packets_;
+    std::vector<std::uint64_t>     bytes_;
+    std::vector<Clock::time_point> first_;
+    std::vector<Clock::time_point> last_;
+    std::vector<Direction>         dir_;
+
+    std::vector<Record> retired_;         ///< Итоговые записи (размер не превышает Options::retired).
+    std::size_t         retired_limit_;
+    std::vector<Record> folded_;          ///< Слитые записи сессий: открытая адресация по (сессия, направление); packets == 0 — пусто.
+    Record              lumped_[2];       ///< Общие слитые записи по направлениям.
+
+    std::uint64_t rng_;
+    std::uint32_t skip_ = 1;              ///< Пакетов до следующего учтённого.
+    Stats         stats_;
+
+    std::uint32_t NextSkip() noexcept;
+
+    /// @brief Запись периода потока id.
+    Record Take(FlowTable::FlowId id, End end) const noexcept;
+
+    /// @brief Поток удалён таблицей: его незавершённый период — в итоговые.
+    void Retire(FlowTable::FlowId id, FlowTable::Reason why) noexcept;
+
+    /// @brief Слить период потока id в запись to.
+    void Fold(Record &to, FlowTable::FlowId id) noexcept;
+};
+
+template <typename Fn>
+std::size_t FlowAccounting::Drain(Clock::time_point now, Fn &&fn, bool flush)
+{
+    table_.Expire(now);
+    std::size_t n = 0;
+    for (const Record &r : retired_)
+    {
+        fn(r);
+        ++n;
+    }
+    retired_.clear();
+    for (Record &f : folded_)
+    {
+        if (f.packets != 0)
+        {
+            fn(f);
+            ++n;
+            f.packets = 0;
+            f.bytes   = 0;
+        }
+    }
+    for (Record &f : lumped_)
+    {
+        if (f.packets != 0)
+        {
+            fn(f);
+            ++n;
+            f.packets = 0;
+            f.bytes   = 0;
+        }
+    }
+    table_.ForEach([&](FlowTable::FlowId id, const FlowTable::Key &)
+    {
+        if (packets_[id] != 0)
+        {
+            fn(Take(id, flush ? End::Flush : End::Active));
+            ++n;
+            packets_[id] = 0;
+            bytes_[id]   = 0;
+        }
+    });
+    stats_.records += n;
+    return n;
+}
+
+/**
+ * @brief Запись выгрузок учёта в файл: сообщения IPFIX (RFC 7011) или строки CSV.
+ *
+ * Выгрузка — Begin, затем Add на каждую запись, затем Commit: записи копятся
+ * в буфере и дописываются в конец файла одним вызовом. IPFIX: каждое сообщение
+ * несёт шаблон 256 (файл читается с любого сообщения, в том числе после
+ * внешней ротации), адреса — IPv6 (IPv4 — как ::ffff:a.b.c.d), сессия —
+ * поле предприятия 32473 (RFC 5612) номер 1. CSV: заголовок — в новом файле.
+ *
+ * Класс не потокобезопасен.
+ */
+class FlowExporter
+{
+public:
+    using Clock = FlowAccounting::Clock;
+
+    /// @brief Формат файла.
+    enum class Format
+    {
+        Csv,
+        Ipfix,
+    };
+
+    /**
+     * @brief Параметры выгрузки.
+     */
+    struct Options
+    {
+        /// @brief Файл (дописывается).
+        std::string path;
+        Format      format = Format::Csv;
+        /// @brief Observation Domain ID в заголовке IPFIX.
+        std::uint32_t domain = 0;
+    };
+
+    /**
+     * @brief Открыть файл.
+     * @throw std::runtime_error Файл не открывается.
+     */
+    explicit FlowExporter(const Options &opts);
+
+    /**
+     * @brief Начать выгрузку в момент now (от него считаются настенные времена записей).
+     * @param sample Знаменатель выборки учёта (поле записи).
+     */
+    void Begin(Clock::time_point now, unsigned sample);
+
+    /** @brief Добавить запись в буфер. */
+    void Add(const FlowAccounting::Record &r);
+
+    /**
+     * @brief Дописать буфер в файл.
+     * @return Число записанных записей.
+     * @throw std::runtime_error Ошибка записи.
+     */
+    std::size_t Commit();
+
+    /// @brief Размер записи данных IPFIX, байт.
+    static constexpr std::size_t kIpfixRecordSize = 83;
+
+    /// @brief Адрес ключа текстом (IPv4 для ::ffff:0:0/96, иначе IPv6 по RFC 5952).
+    static std::string FormatAddr(const std::uint8_t addr[16]);
+
+private:
+    Options       opts_;
+    std::ofstream out_;
+    std::string   buf_;               ///< Готовые байты выгрузки.
+    std::size_t   msg_start_ = 0;     ///< Начало текущего сообщения IPFIX в buf_.
+    std::size_t   msg_records_ = 0;
+    std::size_t   records_ = 0;       ///< Записей в текущей выгрузке.
+    std::uint32_t sequence_ = 0;      ///< Sequence Number IPFIX: записей отправлено ранее.
+    std::int64_t  wall_ms_ = 0;       ///< Настенное время Begin, мс.
+    Clock::time_point mono_;          ///< Монотонное время Begin.
+    unsigned      sample_ = 1;
+
+    std::int64_t WallMs(Clock::time_point t) const noexcept;
+
+    void OpenMessage();
+    void CloseMessage();
+};
@@ -0,0 +1,486 @@
+// FlowTable.cpp — реализация таблицы потоков.
+
+#include "FlowTable.hpp"
+
+#include "PacketMeta.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define FLOWTABLE_SSE2 1
+#define FLOWTABLE_PREFETCH(p) _mm_prefetch(reinterpret_cast<const char *>(p), _MM_HINT_T0)
+#elif defined(__GNUC__)
+#define FLOWTABLE_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define FLOWTABLE_PREFETCH(p) ((void)(p))
+#endif
+
+namespace
+{
+    const FlowTable::Options &Validate(const FlowTable::Options &opts)
+    {
+        if (opts.capacity == 0 || opts.capacity > (std::size_t{1} << 30) ||
+            opts.tick.count() <= 0 || opts.idle < opts.tick || opts.idle / opts.tick > UINT32_MAX / 2)
+        {
+            throw std::invalid_argument("FlowTable: invalid options");
+        }
+        return opts;
+    }
+
+    /// @brief Битовая маска позиций группы, где управляющий байт равен b.
+    std::uint32_t MatchByte(const std::uint8_t *group, std::uint8_t b) noexcept
+    {
+#ifdef FLOWTABLE_SSE2
+        const __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(b)))));
+#else
+        // SWAR: нулевой байт в x ^ b ищется без ложных срабатываний (точная формула).
+        std::uint32_t mask = 0;
+        for (unsigned half = 0; half < 2; ++half)
+        {
+            std::uint64_t w;
+            std::memcpy(&w, group + half * 8, 8);
+            const std::uint64_t x  = w ^ (0x0101010101010101ull * b);
+            const std::uint64_t lo = 0x7F7F7F7F7F7F7F7Full;
+            const std::uint64_t z  = ~(((x & lo) + lo) | x | lo);
+            for (unsigned i = 0; i < 8; ++i)
+            {
+                mask |= static_cast<std::uint32_t>((z >> (i * 8 + 7)) & 1) << (half * 8 + i);
+            }
+        }
+        return mask;
+#endif
+    }
+
+    /// @brief Позиции группы с kEmpty или kDeleted (старший бит установлен).
+    std::uint32_t MatchFree(const std::uint8_t *group) noexcept
+    {
+#ifdef FLOWTABLE_SSE2
+        const __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+        std::uint32_t mask = 0;
+        for (unsigned i = 0; i < 16; ++i)
+        {
+            mask |= static_cast<std::uint32_t>(group[i] >> 7) << i;
+        }
+        return mask;
+#endif
+    }
+
+    std::uint64_t Mix(std::uint64_t h) noexcept
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    bool HasPorts(std::uint8_t proto) noexcept
+    {
+        return proto == 6 || proto == 17 || proto == 132 || proto == 136;
+    }
+}
+
+FlowTable::Key FlowTable::Key::Reversed() const noexcept
+{
+    Key r = *this;
+    std::memcpy(r.src, dst, sizeof dst);
+    std::memcpy(r.dst, src, sizeof src);
+    r.sport = dport;
+    r.dport = sport;
+    return r;
+}
+
+FlowTable::FlowTable(const Options &opts,
+                     RemoveFn on_remove)
+    : entries_(Validate(opts).capacity)
+    , wheel_(opts.capacity)
+    , on_remove_(std::move(on_remove))
+    , seed_(opts.seed != 0 ? opts.seed : std::random_device{}() | (std::uint64_t{std::random_device{}()} << 32))
+    , tick_(opts.tick)
+    , idle_ticks_(static_cast<std::uint32_t>(opts.idle / opts.tick))
+{
+    // Групп — степень двойки, загрузка не выше 7/8.
+    const std::size_t groups = std::bit_ceil((opts.capacity * 8 / 7 + kGroup) / kGroup);
+    group_mask_ = groups - 1;
+    groups_.resize(groups);
+    Rehash();
+    stats_.rehashes = 0;
+    free_.resize(opts.capacity);
+    for (std::size_t i = 0; i < free_.size(); ++i)
+    {
+        free_[i] = static_cast<FlowId>(free_.size() - 1 - i);
+    }
+}
+
+bool FlowTable::ExtractKey(const std::uint8_t *pkt,
+                           std::size_t len,
+                           Key *key) noexcept
+{
+    *key = Key{};
+    std::size_t l4 = 0;   // смещение L4; 0 — портов нет
+    std::uint8_t proto;
+    if (len >= 20 && (pkt[0] >> 4) == 4)
+    {
+        const std::size_t ihl = static_cast<std::size_t>(pkt[0] & 0x0F) * 4;
+        if (ihl < 20 || len < ihl)
+        {
+            return false;
+        }
+        key->src[10] = key->src[11] = 0xFF;
+        key->dst[10] = key->dst[11] = 0xFF;
+        std::memcpy(key->src + 12, pkt + 12, 4);
+        std::memcpy(key->dst + 12, pkt + 16, 4);
+        proto = pkt[9];
+        if (((pkt[6] & 0x1F) | pkt[7]) == 0)
+        {
+            l4 = ihl;
+        }
+    }
+    else if (len >= 40 && (pkt[0] >> 4) == 6)
+    {
+        std::memcpy(key->src, pkt + 8, 16);
+        std::memcpy(key->dst, pkt + 24, 16);
+        proto = pkt[6];
+        std::size_t off = 40;
+        // Заголовки расширений до L4: hop-by-hop, routing, destination, fragment, AH.
+        for (int hops = 0; hops < 8 && off != 0; ++hops)
+        {
+            if (proto != 0 && proto != 43 && proto != 60 && proto != 51 && proto != 44)
+            {
+                break;
+            }
+            if (len < off + 8)
+            {
+                off = 0;
+                break;
+            }
+            const std::uint8_t next = pkt[off];
+            if (proto == 44)
+            {
+                const bool first = ((pkt[off + 2] << 8 | pkt[off + 3]) & 0xFFF8) == 0;
+                off = first ? off + 8 : 0;
+            }
+            else
+            {
+                off += proto == 51 ? (static_cast<std::size_t>(pkt[off + 1]) + 2) * 4
+                                   : (static_cast<std::size_t>(pkt[off + 1]) + 1) * 8;
+            }
+            proto = next;
+        }
+        l4 = off;
+    }
+    else
+    {
+        return false;
+    }
+    key->proto = proto;
+    if (l4 != 0 && HasPorts(proto) && len >= l4 + 4)
+    {
+        key->sport = static_cast<std::uint16_t>(pkt[l4] << 8 | pkt[l4 + 1]);
+        key->dport = static_cast<std::uint16_t>(pkt[l4 + 2] << 8 | pkt[l4 + 3]);
+    }
+    return true;
+}
+
+bool FlowTable::ExtractKey(const PacketMeta &meta,
+                           std::size_t i,
+                           Key *key) noexcept
+{
+    *key = Key{};
+    if (!meta.Ip(i))
+    {
+        return false;
+    }
+    std::memcpy(key->src, meta.Src(i), 16);
+    std::memcpy(key->dst, meta.Dst(i), 16);
+    key->proto = meta.Proto(i);
+    if ((meta.Flags(i) & PacketMeta::kPorts) != 0)
+    {
+        key->sport = meta.SrcPort(i);
+        key->dport = meta.DstPort(i);
+    }
+    return true;
+}
+
+FlowTable::FlowId FlowTable::Find(const Key &key) noexcept
+{
+    return Lookup(key, Hash(key));
+}
+
+FlowTable::FlowId FlowTable::Lookup(const Key &key,
+                                    std::uint64_t h) noexcept
+{
+    ++stats_.lookups;
+    const auto tag = static_cast<std::uint8_t>(h & 0x7F);
+    std::size_t g = (h >> 7) & group_mask_;
+    for (std::size_t probe = 1; probe <= group_mask_ + 1; ++probe)
+    {
+        const Group &group = groups_[g];
+        for (std::uint32_t m = MatchByte(group.ctrl, tag); m != 0; m &= m - 1)
+        {
+            const FlowId id = group.slot[std::countr_zero(m)];
+            if (entries_[id].key == key)
+            {
+                ++stats_.hits;
+                stats_.max_probe = std::max<std::uint64_t>(stats_.max_probe, probe);
+                return id;
+            }
+        }
+        if (MatchByte(group.ctrl, kEmpty) != 0)
+        {
+            break;
+        }
+        g = (g + probe) & group_mask_;   // треугольные числа обходят все группы
+    }
+    return kNone;
+}
+
+FlowTable::FlowId FlowTable::Touch(const Key &key,
+                                   Clock::time_point now,
+                                   bool *created)
+{
+    return TouchHashed(key, Hash(key), TickOf(now), created);
+}
+
+void FlowTable::TouchBatch(const Key *keys,
+                           std::size_t n,
+                           Clock::time_point now,
+                           FlowId *ids,
+                           bool *created)
+{
+    constexpr std::size_t kBatch = 16;
+    const std::uint64_t t = TickOf(now);
+    std::uint64_t h[kBatch];
+    for (std::size_t base = 0; base < n; base += kBatch)
+    {
+        const std::size_t m = std::min(kBatch, n - base);
+        for (std::size_t i = 0; i < m; ++i)
+        {
+            h[i] = Hash(keys[base + i]);
+            FLOWTABLE_PREFETCH(&groups_[(h[i] >> 7) & group_mask_]);
+        }
+        // Записи-кандидаты первой группы: большинство поисков на ней и заканчивается.
+        for (std::size_t i = 0; i < m; ++i)
+        {
+            const Group &g = groups_[(h[i] >> 7) & group_mask_];
+            if (const std::uint32_t match = MatchByte(g.ctrl, static_cast<std::uint8_t>(h[i] & 0x7F)))
+            {
+                FLOWTABLE_PREFETCH(&entries_[g.slot[std::countr_zero(match)]]);
+            }
+        }
+        for (std::size_t i = 0; i < m; ++i)
+        {
+            ids[base + i] = TouchHashed(keys[base + i], h[i], t, created ? created + base + i : nullptr);
+        }
+    }
+}
+
+FlowTable::FlowId FlowTable::TouchHashed(const Key &key,
+                                         std::uint64_t h,
+                                         std::uint64_t t,
+                                         bool *created)
+{
+    if (!started_)
+    {
+        started_ = true;
+        wheel_.Reset(t);
+    }
+    FlowId id = Lookup(key, h);
+    if (id != kNone)
+    {
+        entries_[id].seen = static_cast<std::uint32_t>(t);
+        if (created)
+        {
+            *created = false;
+        }
+        return id;
+    }
+
+    if (free_.empty())
+    {
+        const FlowId victim = Victim(static_cast<std::uint32_t>(t));
+        ++stats_.evicted;
+        if (on_remove_)
+        {
+            on_remove_(victim, entries_[victim].key, Reason::Evicted);
+        }
+        Remove(victim);
+    }
+    if (deleted_ * 8 > groups_.size() * kGroup)
+    {
+        Rehash();
+    }
+    id = free_.back();
+    free_.pop_back();
+    Entry &e = entries_[id];
+    e.key  = key;
+    e.seen = static_cast<std::uint32_t>(t);
+    Place(id, h);
+    wheel_.Schedule(id, t + idle_ticks_);
+    ++size_;
+    ++stats_.inserted;
+    if (created)
+    {
+        *created = true;
+    }
+    return id;
+}
+
+void FlowTable::Erase(FlowId id) noexcept
+{
+    if (!Live(id))
+    {
+        return;
+    }
+    ++stats_.erased;
+    Remove(id);
+}
+
+std::size_t FlowTable::Expire(Clock::time_point now)
+{
+    if (!started_)
+    {
+        return 0;
+    }
+    const std::uint64_t t = TickOf(now);
+    std::size_t removed = 0;
+    wheel_.Advance(t, [&](TimerWheel::Id id)
+    {
+        Entry &e = entries_[id];
+        const std::uint32_t idle = static_cast<std::uint32_t>(t) - e.seen;
+        if (idle < idle_ticks_)
+        {
+            // Пакеты были после постановки: новый срок от последнего.
+            wheel_.Schedule(id, t + (idle_ticks_ - idle));
+            return;
+        }
+        ++stats_.expired;
+        ++removed;
+        if (on_remove_)
+        {
+            on_remove_(id, e.key, Reason::Expired);
+        }
+        Remove(id);
+    });
+    return removed;
+}
+
+std::size_t FlowTable::Memory() const noexcept
+{
+    return groups_.size() * sizeof(Group) +
+           entries_.size() * (sizeof(Entry) + sizeof(FlowId)) +
+           wheel_.Memory();
+}
+
+std::uint64_t FlowTable::Hash(const Key &key) const noexcept
+{
+    std::uint64_t w[5];
+    static_assert(sizeof(Key) == sizeof(w), "FlowTable::Key must be 40 bytes");
+    std::memcpy(w, &key, sizeof w);
+    std::uint64_t h = seed_;
+    for (const std::uint64_t x : w)
+    {
+        h = Mix(h ^ x) + 0x9E3779B97F4A7C15ull;
+    }
+    return h;
+}
+
+std::uint64_t FlowTable::TickOf(Clock::time_point now) const noexcept
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) / tick_);
+}
+
+std::size_t FlowTable::FindFree(std::uint64_t hash) const noexcept
+{
+    std::size_t g = (hash >> 7) & group_mask_;
+    for (std::size_t probe = 1;; ++probe)
+    {
+        if (const std::uint32_t m = MatchFree(groups_[g].ctrl))
+        {
+            return g * kGroup + static_cast<std::size_t>(std::countr_zero(m));
+        }
+        g = (g + probe) & group_mask_;
+    }
+}
+
+void FlowTable::Place(FlowId id,
+                      std::uint64_t hash) noexcept
+{
+    const std::size_t pos = FindFree(hash);
+    Group &g = groups_[pos / kGroup];
+    if (g.ctrl[pos % kGroup] == kDeleted)
+    {
+        --deleted_;
+    }
+    g.ctrl[pos % kGroup] = static_cast<std::uint8_t>(hash & 0x7F);
+    g.slot[pos % kGroup] = id;
+    entries_[id].pos = static_cast<std::uint32_t>(pos);
+}
+
+void FlowTable::Remove(FlowId id) noexcept
+{
+    Entry &e = entries_[id];
+    // Группа с пустой ячейкой не была полной с последней перестройки: цепочки поиска через неё
+    // не идут, и ячейку можно освободить совсем. Иначе — метка «удалено».
+    Group &g = groups_[e.pos / kGroup];
+    if (MatchByte(g.ctrl, kEmpty) != 0)
+    {
+        g.ctrl[e.pos % kGroup] = kEmpty;
+    }
+    else
+    {
+        g.ctrl[e.pos % kGroup] = kDeleted;
+        ++deleted_;
+    }
+    g.slot[e.pos % kGroup] = kNone;
+    e.pos = kNone;
+    wheel_.Cancel(id);
+    free_.push_back(id);
+    --size_;
+}
+
+void FlowTable::Rehash() noexcept
+{
+    ++stats_.rehashes;
+    for (Group &g : groups_)
+    {
+        std::fill(std::begin(g.ctrl), std::end(g.ctrl), kEmpty);
+        std::fill(std::begin(g.slot), std::end(g.slot), kNone);
+    }
+    deleted_ = 0;
+    for (FlowId id = 0; id < entries_.size(); ++id)
+    {
+        if (entries_[id].pos != kNone)
+        {
+            Place(id, Hash(entries_[id].key));
+        }
+    }
+}
+
+FlowTable::FlowId FlowTable::Victim(std::uint32_t now) noexcept
+{
+    // Таблица полна: все записи живые, выборка — подряд идущие записи (последовательное чтение).
+    FlowId best = hand_;
+    std::uint32_t best_age = 0;
+    for (std::size_t i = 0; i < kEvictSample; ++i)
+    {
+        const FlowId id = static_cast<FlowId>((hand_ + i) % entries_.size());
+        const std::uint32_t age = now - entries_[id].seen;
+        if (i == 0 || age > best_age)
+        {
+            best     = id;
+            best_age = age;
+        }
+    }
+    hand_ = static_cast<FlowId>((hand_ + kEvictSample) % entries_.size());
+    return best;
+}
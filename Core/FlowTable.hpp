@@ -0,0 +1,253 @@
+#pragma once
+// FlowTable.hpp — общая таблица потоков по 5-tuple: открытая адресация с групповым поиском меток,
+// фиксированный бюджет памяти, вытеснение по давности (LRU по выборке) и истечение простоя по колесу таймеров.
+
+#include "TimerWheel.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class PacketMeta;
+
+/**
+ * @brief Отображение «5-tuple -> номер потока» для состояния потоков в стадиях ядра.
+ *
+ * - Поток получает номер 0..capacity-1, стабильный до удаления: владельцы держат
+ *   своё состояние в массивах по этому номеру (структура массивов, без аллокаций
+ *   на пакет) и обнуляют его, когда Touch сообщает о новом потоке.
+ * - Поиск — как в Swiss table: группы по 16 управляющих байт с 7-битной меткой
+ *   хэша, сравниваемые одной SIMD-инструкцией (SSE2; без неё — SWAR на 64-битных
+ *   словах); ключ сравнивается только у совпавших меток. Загрузка групп ≤ 7/8.
+ * - Память выделяется в конструкторе по capacity; при заполнении вытесняется
+ *   поток, дольше всех не видевший пакетов, из kEvictSample подряд идущих
+ *   записей под «стрелкой» (LRU по выборке, как в Redis). Точный список LRU
+ *   стоил бы трёх промахов кэша на каждый пакет ради порядка, который нужен
+ *   только при вытеснении.
+ * - Простой: у каждого потока таймер в TimerWheel на last_seen + idle; пакет
+ *   таймер не переставляет — при срабатывании поток, видевший пакеты, просто
+ *   ставится на новый срок. Так касание потока — метка, слот и запись (три
+ *   строки кэша), а Expire — O(1) на тик плюс число сработавших таймеров.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца (или своя
+ * таблица на поток/шард).
+ */
+class FlowTable
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Номер потока.
+    using FlowId = std::uint32_t;
+
+    /// @brief Нет потока.
+    static constexpr FlowId kNone = UINT32_MAX;
+
+    /**
+     * @brief Ключ потока: адреса (IPv4 — как ::ffff:a.b.c.d), порты и протокол L4.
+     *
+     * Направленный: ответный поток — другой ключ (см. Reversed).
+     */
+    struct Key
+    {
+        std::uint8_t  src[16] = {};
+        std::uint8_t  dst[16] = {};
+        std::uint16_t sport   = 0;   ///< 0 — портов нет (не TCP/UDP/SCTP или не первый фрагмент).
+        std::uint16_t dport   = 0;
+        std::uint8_t  proto   = 0;
+        std::uint8_t  pad[3]  = {};
+
+        bool operator==(const Key &) const = default;
+
+        /** @brief Ключ ответного направления. */
+        Key Reversed() const noexcept;
+    };
+
+    /// @brief Почему поток удалён.
+    enum class Reason
+    {
+        Expired,   ///< Простой дольше idle.
+        Evicted,   ///< Вытеснен новым потоком (таблица полна).
+    };
+
+    /** @brief Уведомление об удалении потока (номер ещё занят; из него таблицу не менять). */
+    using RemoveFn = std::function<void(FlowId id, const Key &key, Reason why)>;
+
+    /**
+     * @brief Параметры таблицы.
+     */
+    struct Options
+    {
+        /// @brief Наибольшее число потоков (память — см. Memory()).
+        std::size_t capacity = 65536;
+        /// @brief Простой, после которого поток удаляется.
+        std::chrono::milliseconds idle{60000};
+        /// @brief Шаг колеса таймеров (точность истечения).
+        std::chrono::milliseconds tick{100};
+        /// @brief Ключ хэша (0 — случайный).
+        std::uint64_t seed = 0;
+    };
+
+    /**
+     * @brief Счётчики таблицы.
+     */
+    struct Stats
+    {
+        std::uint64_t lookups   = 0;
+        std::uint64_t hits      = 0;
+        std::uint64_t inserted  = 0;
+        std::uint64_t expired   = 0;
+        std::uint64_t evicted   = 0;
+        std::uint64_t erased    = 0;
+        std::uint64_t rehashes  = 0;   ///< Перестроений на месте (чистка удалённых меток).
+        std::uint64_t max_probe = 0;   ///< Наибольшее число просмотренных групп.
+    };
+
+    /**
+     * @brief Создать таблицу (вся память выделяется здесь).
+     * @param on_remove Уведомление об истечении и вытеснении (может быть пустым).
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    explicit FlowTable(const Options &opts, RemoveFn on_remove = {});
+
+    FlowTable(const FlowTable &) = delete;
+    FlowTable &operator=(const FlowTable &) = delete;
+
+    /**
+     * @brief Извлечь ключ из IP-пакета (заголовки расширений IPv6 пропускаются).
+     * @return false — не IPv4/IPv6 или пакет обрезан.
+     */
+    static bool ExtractKey(const std::uint8_t *pkt, std::size_t len, Key *key) noexcept;
+
+    /**
+     * @brief Ключ разобранного пакета i пачки (тот же, что из байт пакета).
+     * @return false — пакет не IPv4/IPv6.
+     */
+    static bool ExtractKey(const PacketMeta &meta, std::size_t i, Key *key) noexcept;
+
+    /**
+     * @brief Найти поток.
+     * @return Номер или kNone.
+     */
+    FlowId Find(const Key &key) noexcept;
+
+    /**
+     * @brief Найти или создать поток и отметить пакет в момент now.
+     * @param created Если не nullptr — true, когда поток новый (или номер переиспользован).
+     * @return Номер потока (всегда действителен: при заполнении вытесняется давний поток).
+     */
+    FlowId Touch(const Key &key, Clock::time_point now, bool *created = nullptr);
+
+    /**
+     * @brief Touch для пачки ключей (результат тот же, что у Touch по порядку).
+     *
+     * Хэши считаются сразу для всей пачки, группы и записи подгружаются
+     * заранее (prefetch): промахи кэша разных потоков перекрываются, а не
+     * идут друг за другом. Для пачек из TUN/сокета на миллионах потоков.
+     * @param created Если не nullptr — массив из n флагов «поток новый».
+     */
+    void TouchBatch(const Key *keys, std::size_t n, Clock::time_point now, FlowId *ids, bool *created = nullptr);
+
+    /**
+     * @brief Удалить поток по решению владельца (без RemoveFn).
+     */
+    void Erase(FlowId id) noexcept;
+
+    /**
+     * @brief Удалить потоки, простаивающие дольше idle (RemoveFn для каждого).
+     * @return Число удалённых.
+     */
+    std::size_t Expire(Clock::time_point now);
+
+    /** @brief Ключ живого потока. */
+    const Key &KeyOf(FlowId id) const noexcept { return entries_[id].key; }
+
+    /** @brief Жив ли поток с номером id. */
+    bool Live(FlowId id) const noexcept { return id < entries_.size() && entries_[id].pos != kNone; }
+
+    /**
+     * @brief Обойти живые потоки (в порядке номеров): fn(id, key).
+     */
+    template <typename Fn>
+    void ForEach(Fn &&fn) const
+    {
+        for (FlowId id = 0; id < entries_.size(); ++id)
+        {
+            if (entries_[id].pos != kNone)
+            {
+                fn(id, entries_[id].key);
+            }
+        }
+    }
+
+    /** @brief Число живых потоков. */
+    std::size_t Size() const noexcept { return size_; }
+
+    /** @brief Наибольшее число потоков. */
+    std::size_t Capacity() const noexcept { return entries_.size(); }
+
+    /** @brief Память таблицы и её колеса, байт. */
+    std::size_t Memory() const noexcept;
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+private:
+    static constexpr std::uint8_t kEmpty   = 0x80;
+    static constexpr std::uint8_t kDeleted = 0xFE;
+    static constexpr std::size_t  kGroup   = 16;
+    /// @brief Записей в выборке при вытеснении.
+    static constexpr std::size_t  kEvictSample = 8;
+
+    /// @brief Запись потока (48 байт).
+    struct Entry
+    {
+        Key           key;
+        std::uint32_t pos  = kNone;   ///< Ячейка (группа * kGroup + позиция); kNone — запись свободна.
+        std::uint32_t seen = 0;       ///< Тик последнего пакета (младшие 32 бита).
+    };
+
+    /// @brief Группа ячеек: метки и номера рядом (80 байт) — один-два соседних промаха вместо двух случайных.
+    struct Group
+    {
+        std::uint8_t  ctrl[kGroup];    ///< Метка (0..0x7F), kEmpty или kDeleted.
+        std::uint32_t slot[kGroup];    ///< Номер потока в ячейке.
+    };
+
+    std::vector<Group>         groups_;
+    std::vector<Entry>         entries_;
+    std::vector<FlowId>        free_;    ///< Стек свободных номеров.
+    TimerWheel                 wheel_;
+    RemoveFn                   on_remove_;
+
+    std::size_t   group_mask_;
+    std::size_t   size_    = 0;
+    std::size_t   deleted_ = 0;
+    FlowId        hand_    = 0;       ///< Начало следующей выборки для вытеснения.
+    std::uint64_t seed_;
+    std::chrono::milliseconds tick_;
+    std::uint32_t idle_ticks_;
+    bool          started_ = false;
+    Stats         stats_;
+
+    std::uint64_t Hash(const Key &key) const noexcept;
+    std::uint64_t TickOf(Clock::time_point now) const noexcept;
+
+    FlowId Lookup(const Key &key, std::uint64_t hash) noexcept;
+    FlowId TouchHashed(const Key &key, std::uint64_t hash, std::uint64_t tick, bool *created);
+
+    /// @brief Ячейка для новой метки (первая пустая или удалённая по пути пробирования).
+    std::size_t FindFree(std::uint64_t hash) const noexcept;
+    void        Place(FlowId id, std::uint64_t hash) noexcept;
+
+    /// @brief Снять поток со всех структур и вернуть запись в свободные.
+    void Remove(FlowId id) noexcept;
+
+    /// @brief Перестроить группы на месте (удалённые метки исчезают).
+    void Rehash() noexcept;
+
+    /// @brief Самый давний поток из выборки под стрелкой (таблица полна).
+    FlowId Victim(std::uint32_t now) noexcept;
+};
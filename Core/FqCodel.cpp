@@ -0,0 +1,552 @@
+// FqCodel.cpp — реализация FQ-CoDel: DRR по потокам, CoDel в каждом, token bucket на выдаче.
+
+#include "FqCodel.hpp"
+
+#include "PacketMeta.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+    inline std::uint64_t Mix(std::uint64_t h,
+                             std::uint64_t v) noexcept
+    {
+        h ^= v;
+        h *= 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 29);
+    }
+
+    inline std::uint32_t Load32(const std::uint8_t *p) noexcept
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    /// @brief Хэш адресов [p, p + n) словами по 4 байта.
+    inline std::uint64_t MixWords(std::uint64_t h,
+                                  const std::uint8_t *p,
+                                  std::size_t n) noexcept
+    {
+        for (std::size_t i = 0; i + 4 <= n; i += 4)
+        {
+            h = Mix(h, Load32(p + i));
+        }
+        return h;
+    }
+
+    inline bool HasPorts(std::uint8_t proto) noexcept
+    {
+        return proto == 6 || proto == 17 || proto == 132;   // TCP, UDP, SCTP
+    }
+}
+
+FqCodel::FqCodel(const Options &opts)
+    : opts_(opts)
+{
+    if (opts.flows == 0 || opts.limit == 0 || opts.slot_size == 0 || opts.quantum == 0 ||
+        opts.target.count() <= 0 || opts.interval.count() <= 0 ||
+        opts.limit >= kNil || opts.flows >= kNil)
+    {
+        throw std::invalid_argument("FqCodel: invalid options");
+    }
+    storage_.resize(opts.limit * opts.slot_size);
+    slots_.resize(opts.limit);
+    flows_.resize(opts.flows);
+    for (std::size_t i = 0; i < slots_.size(); ++i)
+    {
+        slots_[i].next = (i + 1 < slots_.size()) ? static_cast<std::uint32_t>(i + 1) : kNil;
+    }
+    free_ = 0;
+    seed_ = opts.seed != 0 ? opts.seed : std::random_device{}() | (std::uint64_t{std::random_device{}()} << 32);
+    SetRate(opts.rate_kbps);
+    flow_burst_bytes_ = std::max(std::chrono::duration<double>(opts.burst).count() * static_cast<double>(opts.flow_rate_kbps) * 125.0,
+                                 static_cast<double>(opts.slot_size));
+}
+
+bool FqCodel::Enqueue(const std::uint8_t *data,
+                      std::size_t len,
+                      Clock::time_point now) noexcept
+{
+    return Insert(data, len, now, FlowHash(data, len, seed_));
+}
+
+bool FqCodel::Enqueue(const std::uint8_t *data,
+                      std::size_t len,
+                      Clock::time_point now,
+                      const PacketMeta &meta,
+                      std::size_t i) noexcept
+{
+    return Insert(data, len, now, meta.Ip(i) ? FlowHash(meta, i, seed_) : FlowHash(data, len, seed_));
+}
+
+bool FqCodel::Insert(const std::uint8_t *data,
+                     std::size_t len,
+                     Clock::time_point now,
+                     std::uint64_t hash) noexcept
+{
+    if (len == 0 || len > opts_.slot_size)
+    {
+        ++stats_.oversize_drops;
+        return false;
+    }
+    if (free_ == kNil)
+    {
+        DropFattest();
+    }
+
+    const std::uint32_t slot = free_;
+    free_ = slots_[slot].next;
+    Slot &s = slots_[slot];
+    s.next = kNil;
+    s.len  = static_cast<std::uint32_t>(len);
+    s.at   = now;
+    std::memcpy(storage_.data() + slot * opts_.slot_size, data, len);
+
+    const auto idx = static_cast<std::uint32_t>(hash % flows_.size());
+    Flow &f = flows_[idx];
+    if (f.tail == kNil)
+    {
+        f.head = slot;
+    }
+    else
+    {
+        slots_[f.tail].next = slot;
+    }
+    f.tail = slot;
+    f.bytes += len;
+    ++packets_;
+    bytes_ += len;
+    ++stats_.enqueued;
+
+    if (!f.active)
+    {
+        // RFC 8290: новый поток получает полный квант и очередь вне старых.
+        f.active  = true;
+        f.deficit = static_cast<std::int64_t>(opts_.quantum);
+        PushTail(new_, idx);
+        ++stats_.new_flows;
+    }
+    return true;
+}
+
+std::size_t FqCodel::Dequeue(std::uint8_t *out,
+                             std::size_t size,
+                             Clock::time_point now) noexcept
+{
+    if (packets_ == 0)
+    {
+        return 0;
+    }
+    if (rate_kbps_ != 0)
+    {
+        const auto elapsed = std::chrono::duration<double>(now - refill_at_).count();
+        if (elapsed > 0)
+        {
+            tokens_ = std::min(burst_bytes_, tokens_ + elapsed * static_cast<double>(rate_kbps_) * 125.0);
+            refill_at_ = now;
+        }
+        if (tokens_ < 0)
+        {
+            ++stats_.throttled;
+            return 0;
+        }
+    }
+    if (opts_.flow_rate_kbps != 0)
+    {
+        Unthrottle(now);
+    }
+
+    for (;;)
+    {
+        List *list = new_.head != kNil ? &new_ : &old_;
+        if (list->head == kNil)
+        {
+            return 0;
+        }
+        const std::uint32_t idx = list->head;
+        Flow &f = flows_[idx];
+        if (f.deficit <= 0)
+        {
+            f.deficit += static_cast<std::int64_t>(opts_.quantum);
+            PopHead(*list);
+            PushTail(old_, idx);
+            continue;
+        }
+        if (opts_.flow_rate_kbps != 0 && !FlowConforms(f, now))
+        {
+            PopHead(*list);
+            PushTail(throttled_, idx);
+            ++stats_.flow_throttled;
+            continue;
+        }
+
+        const std::uint32_t slot = CodelDequeue(f, now);
+        if (slot == kNil)
+        {
+            PopHead(*list);
+            // Опустевший новый поток проходит через старые, чтобы частые
+            // «новые» всплески не обгоняли остальных бесконечно.
+            if (list == &new_ && old_.head != kNil)
+            {
+                PushTail(old_, idx);
+            }
+            else
+            {
+                f.active = false;
+            }
+            continue;
+        }
+
+        const std::uint32_t len = slots_[slot].len;
+        f.deficit -= len;
+        if (len > size)
+        {
+            ++stats_.oversize_drops;
+            Free(slot);
+            continue;
+        }
+        std::memcpy(out, storage_.data() + slot * opts_.slot_size, len);
+        const auto sojourn = std::chrono::duration_cast<std::chrono::microseconds>(now - slots_[slot].at).count();
+        stats_.max_sojourn_us = std::max<std::uint64_t>(stats_.max_sojourn_us, static_cast<std::uint64_t>(std::max<std::int64_t>(sojourn, 0)));
+        Free(slot);
+        ++stats_.dequeued;
+        if (rate_kbps_ != 0)
+        {
+            tokens_ -= len;
+        }
+        if (opts_.flow_rate_kbps != 0)
+        {
+            f.tokens -= len;
+        }
+        return len;
+    }
+}
+
+void FqCodel::SetRate(std::uint64_t kbps) noexcept
+{
+    rate_kbps_ = kbps;
+    if (kbps == 0)
+    {
+        return;
+    }
+    const double burst = std::chrono::duration<double>(opts_.burst).count() * static_cast<double>(kbps) * 125.0;
+    burst_bytes_ = std::max(burst, 2.0 * static_cast<double>(opts_.slot_size));
+    tokens_      = std::min(tokens_, burst_bytes_);
+}
+
+void FqCodel::Clear() noexcept
+{
+    for (Flow &f : flows_)
+    {
+        while (f.head != kNil)
+        {
+            Free(Take(f));
+        }
+        f = Flow{};
+    }
+    new_       = List{};
+    old_       = List{};
+    throttled_ = List{};
+}
+
+std::uint64_t FqCodel::FlowHash(const std::uint8_t *pkt,
+                                std::size_t len,
+                                std::uint64_t seed) noexcept
+{
+    std::uint64_t h = seed;
+    if (len >= 20 && (pkt[0] >> 4) == 4)
+    {
+        const std::size_t   ihl   = static_cast<std::size_t>(pkt[0] & 0x0F) * 4;
+        const std::uint8_t  proto = pkt[9];
+        const bool          first = ((pkt[6] & 0x1F) | pkt[7]) == 0;   // не продолжение фрагмента
+        h = Mix(h, proto);
+        h = MixWords(h, pkt + 12, 8);
+        if (first && HasPorts(proto) && ihl >= 20 && len >= ihl + 4)
+        {
+            h = Mix(h, Load32(pkt + ihl));
+        }
+        return Mix(h, 0);
+    }
+    if (len >= 40 && (pkt[0] >> 4) == 6)
+    {
+        const std::uint8_t proto = pkt[6];
+        h = Mix(h, proto);
+        h = MixWords(h, pkt + 8, 32);
+        if (HasPorts(proto) && len >= 44)
+        {
+            h = Mix(h, Load32(pkt + 40));
+        }
+        return Mix(h, 0);
+    }
+    return Mix(MixWords(h, pkt, std::min<std::size_t>(len, 16)), len);
+}
+
+std::uint64_t FqCodel::FlowHash(const PacketMeta &meta,
+                                std::size_t i,
+                                std::uint64_t seed) noexcept
+{
+    // Те же слова, что у разбора по байтам: адреса IPv4 — последние 4 байта ::ffff:a.b.c.d.
+    const bool v4 = meta.Version(i) == 4;
+    std::uint64_t h = Mix(seed, meta.NextHeader(i));
+    h = MixWords(h, meta.Src(i) + (v4 ? 12 : 0), v4 ? 4 : 16);
+    h = MixWords(h, meta.Dst(i) + (v4 ? 12 : 0), v4 ? 4 : 16);
+    // По байтам порты IPv6 берутся только сразу за фиксированным заголовком.
+    if ((meta.Flags(i) & PacketMeta::kPorts) != 0 && HasPorts(meta.Proto(i)) && (v4 || meta.L4Offset(i) == 40))
+    {
+        const std::uint8_t ports[4] = {static_cast<std::uint8_t>(meta.SrcPort(i) >> 8), static_cast<std::uint8_t>(meta.SrcPort(i)),
+                                       static_cast<std::uint8_t>(meta.DstPort(i) >> 8), static_cast<std::uint8_t>(meta.DstPort(i))};
+        h = Mix(h, Load32(ports));
+    }
+    return Mix(h, 0);
+}
+
+void FqCodel::PushTail(List &list,
+                       std::uint32_t flow) noexcept
+{
+    flows_[flow].next_active = kNil;
+    if (list.tail == kNil)
+    {
+        list.head = flow;
+    }
+    else
+    {
+        flows_[list.tail].next_active = flow;
+    }
+    list.tail = flow;
+}
+
+std::uint32_t FqCodel::PopHead(List &list) noexcept
+{
+    const std::uint32_t flow = list.head;
+    list.head = flows_[flow].next_active;
+    if (list.head == kNil)
+    {
+        list.tail = kNil;
+    }
+    flows_[flow].next_active = kNil;
+    return flow;
+}
+
+std::uint32_t FqCodel::Take(Flow &f) noexcept
+{
+    const std::uint32_t slot = f.head;
+    if (slot == kNil)
+    {
+        return kNil;
+    }
+    f.head = slots_[slot].next;
+    if (f.head == kNil)
+    {
+        f.tail = kNil;
+    }
+    f.bytes -= slots_[slot].len;
+    --packets_;
+    bytes_ -= slots_[slot].len;
+    return slot;
+}
+
+void FqCodel::Free(std::uint32_t slot) noexcept
+{
+    slots_[slot].next = free_;
+    free_ = slot;
+}
+
+bool FqCodel::ShouldDrop(Flow &f,
+                         std::uint32_t slot,
+                         Clock::time_point now) noexcept
+{
+    if (slot == kNil)
+    {
+        f.first_above = {};
+        return false;
+    }
+    // Очередь не длиннее одного пакета не сократить отбрасыванием.
+    if (now - slots_[slot].at < opts_.target || f.bytes <= opts_.slot_size)
+    {
+        f.first_above = {};
+        return false;
+    }
+    if (f.first_above == Clock::time_point{})
+    {
+        f.first_above = now + opts_.interval;
+        return false;
+    }
+    return now >= f.first_above;
+}
+
+std::uint32_t FqCodel::CodelDequeue(Flow &f,
+                                    Clock::time_point now) noexcept
+{
+    std::uint32_t slot = Take(f);
+    if (slot == kNil)
+    {
+        f.dropping = false;
+        f.first_above = {};
+        return kNil;
+    }
+
+    bool drop = ShouldDrop(f, slot, now);
+    if (f.dropping)
+    {
+        if (!drop)
+        {
+            f.dropping = false;
+        }
+        else
+        {
+            while (f.dropping && now >= f.drop_next)
+            {
+                ++f.count;
+                if (opts_.ecn && MarkCe(slot))
+                {
+                    ++stats_.ecn_marks;
+                    f.drop_next = ControlLaw(f.drop_next, f.count);
+                    return slot;
+                }
+                ++stats_.codel_drops;
+                Free(slot);
+                slot = Take(f);
+                if (!ShouldDrop(f, slot, now))
+                {
+                    f.dropping = false;
+                }
+                else
+                {
+                    f.drop_next = ControlLaw(f.drop_next, f.count);
+                }
+            }
+        }
+    }
+    else if (drop)
+    {
+        if (opts_.ecn && MarkCe(slot))
+        {
+            ++stats_.ecn_marks;
+        }
+        else
+        {
+            ++stats_.codel_drops;
+            Free(slot);
+            slot = Take(f);
+        }
+        f.dropping = true;
+        // Недавно уже отбрасывали — продолжить с той же частоты, а не с начала.
+        const std::uint32_t delta = f.count - f.lastcount;
+        if (delta > 1 && now - f.drop_next < 16 * opts_.interval)
+        {
+            f.count = delta;
+        }
+        else
+        {
+            f.count = 1;
+        }
+        f.lastcount = f.count;
+        f.drop_next = ControlLaw(now, f.count);
+    }
+    return slot;
+}
+
+bool FqCodel::MarkCe(std::uint32_t slot) noexcept
+{
+    std::uint8_t *p = storage_.data() + slot * opts_.slot_size;
+    const std::size_t len = slots_[slot].len;
+    if (len >= 20 && (p[0] >> 4) == 4)
+    {
+        const unsigned ecn = p[1] & 0x03u;
+        if (ecn == 0)
+        {
+            return false;
+        }
+        if (ecn == 3)
+        {
+            return true;
+        }
+        // RFC 1624: HC' = ~(~HC + ~m + m') для слова [версия|TOS].
+        const unsigned old_word = (unsigned{p[0]} << 8) | p[1];
+        p[1] = static_cast<std::uint8_t>(p[1] | 0x03u);
+        const unsigned new_word = (unsigned{p[0]} << 8) | p[1];
+        std::uint32_t sum = (~((unsigned{p[10]} << 8) | p[11]) & 0xFFFFu) + (~old_word & 0xFFFFu) + new_word;
+        sum = (sum & 0xFFFFu) + (sum >> 16);
+        sum = (sum & 0xFFFFu) + (sum >> 16);
+        const auto check = static_cast<std::uint16_t>(~sum);
+        p[10] = static_cast<std::uint8_t>(check >> 8);
+        p[11] = static_cast<std::uint8_t>(check);
+        return true;
+    }
+    if (len >= 40 && (p[0] >> 4) == 6)
+    {
+        // Traffic Class — биты 4..11 заголовка, ECN — его младшие два.
+        const unsigned ecn = (p[1] >> 4) & 0x03u;
+        if (ecn == 0)
+        {
+            return false;
+        }
+        p[1] = static_cast<std::uint8_t>(p[1] | 0x30u);
+        return true;
+    }
+    return false;
+}
+
+bool FqCodel::FlowConforms(Flow &f,
+                           Clock::time_point now) noexcept
+{
+    const auto elapsed = std::chrono::duration<double>(now - f.refill_at).count();
+    if (elapsed > 0)
+    {
+        f.tokens    = std::min(flow_burst_bytes_, f.tokens + elapsed * static_cast<double>(opts_.flow_rate_kbps) * 125.0);
+        f.refill_at = now;
+    }
+    return f.tokens >= 0;
+}
+
+void FqCodel::Unthrottle(Clock::time_point now) noexcept
+{
+    // Один проход по списку: пополнившиеся — в конец старых, прочие — обратно.
+    const std::uint32_t last = throttled_.tail;
+    while (throttled_.head != kNil)
+    {
+        const std::uint32_t idx = PopHead(throttled_);
+        PushTail(FlowConforms(flows_[idx], now) ? old_ : throttled_, idx);
+        if (idx == last)
+        {
+            break;
+        }
+    }
+}
+
+void FqCodel::DropFattest() noexcept
+{
+    std::size_t fattest = 0;
+    for (std::size_t i = 1; i < flows_.size(); ++i)
+    {
+        if (flows_[i].bytes > flows_[fattest].bytes)
+        {
+            fattest = i;
+        }
+    }
+    // Поиск — проход по всем потокам, поэтому отбрасывается пачка (как drop_batch_size
+    // в Linux): до половины очереди потока, не больше kDropBatch пакетов.
+    // Поток остаётся в своём списке: опустевший уберёт Dequeue.
+    constexpr unsigned kDropBatch = 64;
+    Flow &f = flows_[fattest];
+    const std::size_t keep = f.bytes / 2;
+    unsigned dropped = 0;
+    do
+    {
+        Free(Take(f));
+        ++stats_.overlimit_drops;
+    }
+    while (++dropped < kDropBatch && f.bytes > keep);
+}
+
+FqCodel::Clock::time_point FqCodel::ControlLaw(Clock::time_point t,
+                                               std::uint32_t count) const noexcept
+{
+    const auto step = std::chrono::duration<double, std::micro>(opts_.interval).count() / std::sqrt(static_cast<double>(count));
+    return t + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(step));
+}
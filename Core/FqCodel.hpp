@@ -0,0 +1,227 @@
+#pragma once
+// FqCodel.hpp — планировщик FQ-CoDel (RFC 8290) с необязательным ограничением скорости выдачи.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class PacketMeta;
+
+/**
+ * @brief Очереди потоков с DRR и CoDel на каждой.
+ *
+ * - Пакет попадает в очередь своего потока по хэшу 5-tuple (адреса, протокол,
+ *   порты TCP/UDP) с солью экземпляра.
+ * - Выдача — deficit round-robin по quantum байт; поток, только что ставший
+ *   активным, обслуживается раньше старых (короткие интерактивные потоки
+ *   не ждут за объёмной выгрузкой).
+ * - В каждой очереди CoDel (RFC 8289): если время пребывания пакета дольше
+ *   target в течение interval, пакеты из головы отбрасываются (или, при ecn,
+ *   помечаются CE) с частотой, растущей как sqrt(числа отбрасываний).
+ * - При переполнении limit отбрасывается голова самого «толстого» потока
+ *   (пачкой, чтобы не искать его на каждый пакет).
+ * - rate_kbps > 0 — выдача не быстрее заданной скорости (token bucket глубиной
+ *   burst): очередь образуется здесь, где ею управляет CoDel, а не в буфере
+ *   модема. Скорость можно менять на ходу (SetRate).
+ * - flow_rate_kbps > 0 — то же для каждого потока: поток, исчерпавший скорость,
+ *   выходит из круга DRR до пополнения, остальные потоки его не ждут.
+ *
+ * Время передаётся в каждый вызов, поэтому планировщик целиком проверяется
+ * в памяти с виртуальными часами. Память под все пакеты выделяется
+ * в конструкторе. Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class FqCodel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Параметры планировщика.
+     */
+    struct Options
+    {
+        /// @brief Число очередей потоков.
+        std::size_t flows = 1024;
+        /// @brief Пакетов во всех очередях.
+        std::size_t limit = 1024;
+        /// @brief Максимальный размер пакета.
+        std::size_t slot_size = 1500;
+        /// @brief Байт за раунд DRR.
+        std::size_t quantum = 1514;
+        /// @brief Допустимое время пребывания в очереди.
+        std::chrono::microseconds target{5000};
+        /// @brief Окно, за которое задержка должна хоть раз опуститься ниже target.
+        std::chrono::microseconds interval{100000};
+        /// @brief Помечать ECN-пакеты CE вместо отбрасывания.
+        bool ecn = true;
+        /// @brief Скорость выдачи, кбит/с (0 — без ограничения).
+        std::uint64_t rate_kbps = 0;
+        /// @brief Глубина token bucket во времени (не меньше двух пакетов).
+        std::chrono::microseconds burst{5000};
+        /// @brief Скорость каждого потока, кбит/с (0 — без ограничения).
+        std::uint64_t flow_rate_kbps = 0;
+        /// @brief Соль хэша потоков (0 — случайная).
+        std::uint64_t seed = 0;
+    };
+
+    /**
+     * @brief Счётчики планировщика.
+     */
+    struct Stats
+    {
+        std::uint64_t enqueued        = 0;
+        std::uint64_t dequeued        = 0;
+        std::uint64_t codel_drops     = 0;   ///< Отброшено CoDel.
+        std::uint64_t ecn_marks       = 0;   ///< Помечено CE вместо отбрасывания.
+        std::uint64_t overlimit_drops = 0;   ///< Отброшено при переполнении limit.
+        std::uint64_t oversize_drops  = 0;   ///< Пакет больше слота или буфера выдачи.
+        std::uint64_t new_flows       = 0;   ///< Сколько раз поток становился активным.
+        std::uint64_t throttled       = 0;   ///< Выдач, отложенных ограничением скорости.
+        std::uint64_t flow_throttled  = 0;   ///< Сколько раз поток выходил из круга по flow_rate_kbps.
+        std::uint64_t max_sojourn_us  = 0;   ///< Наибольшее время пребывания выданного пакета.
+    };
+
+    /**
+     * @brief Создать планировщик.
+     * @throw std::invalid_argument Нулевые flows/limit/slot_size/quantum или target/interval.
+     */
+    explicit FqCodel(const Options &opts);
+
+    FqCodel(const FqCodel &) = delete;
+    FqCodel &operator=(const FqCodel &) = delete;
+
+    /**
+     * @brief Поставить копию пакета в очередь его потока.
+     * @return false — пакет отброшен (больше слота).
+     */
+    bool Enqueue(const std::uint8_t *data, std::size_t len, Clock::time_point now) noexcept;
+
+    /**
+     * @brief Enqueue с хэшем потока по метаданным пакета i пачки (data, len — сам пакет).
+     */
+    bool Enqueue(const std::uint8_t *data, std::size_t len, Clock::time_point now,
+                 const PacketMeta &meta, std::size_t i) noexcept;
+
+    /**
+     * @brief Выдать следующий пакет.
+     * @return Длина пакета в out; 0 — очередь пуста или скорость исчерпана.
+     */
+    std::size_t Dequeue(std::uint8_t *out, std::size_t size, Clock::time_point now) noexcept;
+
+    /**
+     * @brief Изменить скорость выдачи (0 — без ограничения).
+     */
+    void SetRate(std::uint64_t kbps) noexcept;
+
+    /** @brief Текущая скорость выдачи, кбит/с (0 — без ограничения). */
+    std::uint64_t Rate() const noexcept { return rate_kbps_; }
+
+    /** @brief Пакетов в очередях. */
+    std::size_t Packets() const noexcept { return packets_; }
+
+    /** @brief Байт в очередях. */
+    std::size_t Bytes() const noexcept { return bytes_; }
+
+    /**
+     * @brief Отбросить все пакеты (счётчики сохраняются).
+     */
+    void Clear() noexcept;
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+    /**
+     * @brief Хэш 5-tuple IP-пакета (для не-IP — хэш первых байт).
+     */
+    static std::uint64_t FlowHash(const std::uint8_t *pkt, std::size_t len, std::uint64_t seed) noexcept;
+
+    /**
+     * @brief FlowHash разобранного IP-пакета i пачки (равен хэшу по байтам; meta.Ip(i) обязателен).
+     */
+    static std::uint64_t FlowHash(const PacketMeta &meta, std::size_t i, std::uint64_t seed) noexcept;
+
+private:
+    static constexpr std::uint32_t kNil = 0xFFFFFFFFu;
+
+    struct Slot
+    {
+        std::uint32_t     next = kNil;
+        std::uint32_t     len  = 0;
+        Clock::time_point at;
+    };
+
+    struct Flow
+    {
+        std::uint32_t     head = kNil;
+        std::uint32_t     tail = kNil;
+        std::size_t       bytes = 0;
+        std::int64_t      deficit = 0;
+        std::uint32_t     next_active = kNil;   ///< Следующий в списке new_/old_.
+        bool              active = false;
+        double            tokens = 0;           ///< Байт по flow_rate_kbps.
+        Clock::time_point refill_at;
+        // CoDel
+        bool              dropping = false;
+        std::uint32_t     count = 0;
+        std::uint32_t     lastcount = 0;
+        Clock::time_point first_above;          ///< Пусто — задержка ниже target.
+        Clock::time_point drop_next;
+    };
+
+    struct List
+    {
+        std::uint32_t head = kNil;
+        std::uint32_t tail = kNil;
+    };
+
+    Options                   opts_;
+    std::vector<std::uint8_t> storage_;   ///< limit * slot_size.
+    std::vector<Slot>         slots_;
+    std::uint32_t             free_ = kNil;
+    std::vector<Flow>         flows_;
+    List                      new_;
+    List                      old_;
+    List                      throttled_;   ///< Потоки, ждущие пополнения flow_rate_kbps.
+    std::size_t               packets_ = 0;
+    std::size_t               bytes_   = 0;
+    std::uint64_t             seed_;
+
+    std::uint64_t     rate_kbps_ = 0;
+    double            tokens_ = 0;        ///< Байт; может уйти в минус на один пакет.
+    double            burst_bytes_ = 0;
+    double            flow_burst_bytes_ = 0;
+    Clock::time_point refill_at_;
+
+    Stats stats_;
+
+    /// @brief Поставить пакет в очередь потока с хэшем hash.
+    bool Insert(const std::uint8_t *data, std::size_t len, Clock::time_point now, std::uint64_t hash) noexcept;
+
+    void          PushTail(List &list, std::uint32_t flow) noexcept;
+    std::uint32_t PopHead(List &list) noexcept;
+
+    /// @brief Снять пакет с головы потока (без CoDel); kNil — поток пуст.
+    std::uint32_t Take(Flow &f) noexcept;
+    void          Free(std::uint32_t slot) noexcept;
+
+    /// @brief Решение CoDel для только что снятого пакета.
+    bool ShouldDrop(Flow &f, std::uint32_t slot, Clock::time_point now) noexcept;
+
+    /// @brief Выдача из потока по CoDel; kNil — поток опустел.
+    std::uint32_t CodelDequeue(Flow &f, Clock::time_point now) noexcept;
+
+    /// @brief Пометить пакет CE; false — пакет не ECN-capable.
+    bool MarkCe(std::uint32_t slot) noexcept;
+
+    /// @brief Пополнить токены потока; false — поток исчерпал flow_rate_kbps.
+    bool FlowConforms(Flow &f, Clock::time_point now) noexcept;
+
+    /// @brief Вернуть в круг DRR пополнившиеся потоки из throttled_.
+    void Unthrottle(Clock::time_point now) noexcept;
+
+    /// @brief Отбросить пачку из головы самого «толстого» потока.
+    void DropFattest() noexcept;
+
+    Clock::time_point ControlLaw(Clock::time_point t, std::uint32_t count) const noexcept;
+};
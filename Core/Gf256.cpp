@@ -0,0 +1,221 @@
+// Gf256.cpp — таблицы GF(2^8) и реализации MulAdd (scalar / SSSE3 / AVX2).
+
+#include "Gf256.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GF256_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(GF256_X86) && (defined(__GNUC__) || defined(__clang__))
+#define GF256_TARGET(x) __attribute__((target(x)))
+#else
+#define GF256_TARGET(x)
+#endif
+
+namespace
+{
+    struct Tables
+    {
+        std::uint8_t exp[512];
+        std::uint8_t log[256];
+        /// @brief c * x для младшего и старшего полубайта x (строки для pshufb).
+        alignas(16) std::uint8_t lo[256][16];
+        alignas(16) std::uint8_t hi[256][16];
+    };
+
+    constexpr Tables MakeTables() noexcept
+    {
+        Tables t{};
+        unsigned x = 1;
+        for (unsigned i = 0; i < 255; ++i)
+        {
+            t.exp[i] = static_cast<std::uint8_t>(x);
+            t.log[x] = static_cast<std::uint8_t>(i);
+            x <<= 1;
+            if (x & 0x100)
+            {
+                x ^= 0x11D;
+            }
+        }
+        for (unsigned i = 255; i < 512; ++i)
+        {
+            t.exp[i] = t.exp[i - 255];
+        }
+        for (unsigned c = 0; c < 256; ++c)
+        {
+            for (unsigned n = 0; n < 16; ++n)
+            {
+                const unsigned h = n << 4;
+                t.lo[c][n] = (c == 0 || n == 0) ? 0 : t.exp[t.log[c] + t.log[n]];
+                t.hi[c][n] = (c == 0 || n == 0) ? 0 : t.exp[t.log[c] + t.log[h]];
+            }
+        }
+        return t;
+    }
+
+    constexpr Tables kT = MakeTables();
+
+    void MulAddScalar(std::uint8_t *dst,
+                      const std::uint8_t *src,
+                      std::uint8_t c,
+                      std::size_t len) noexcept
+    {
+        const std::uint8_t *lo = kT.lo[c];
+        const std::uint8_t *hi = kT.hi[c];
+        for (std::size_t i = 0; i < len; ++i)
+        {
+            dst[i] ^= static_cast<std::uint8_t>(lo[src[i] & 0x0F] ^ hi[src[i] >> 4]);
+        }
+    }
+
+#if defined(GF256_X86)
+    GF256_TARGET("ssse3")
+    void MulAddSsse3(std::uint8_t *dst,
+                     const std::uint8_t *src,
+                     std::uint8_t c,
+                     std::size_t len) noexcept
+    {
+        const __m128i lo   = _mm_load_si128(reinterpret_cast<const __m128i *>(kT.lo[c]));
+        const __m128i hi   = _mm_load_si128(reinterpret_cast<const __m128i *>(kT.hi[c]));
+        const __m128i mask = _mm_set1_epi8(0x0F);
+        std::size_t i = 0;
+        for (; i + 16 <= len; i += 16)
+        {
+            const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            const __m128i l = _mm_and_si128(s, mask);
+            const __m128i h = _mm_and_si128(_mm_srli_epi64(s, 4), mask);
+            const __m128i p = _mm_xor_si128(_mm_shuffle_epi8(lo, l), _mm_shuffle_epi8(hi, h));
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(d, p));
+        }
+        MulAddScalar(dst + i, src + i, c, len - i);
+    }
+
+    GF256_TARGET("avx2")
+    void MulAddAvx2(std::uint8_t *dst,
+                    const std::uint8_t *src,
+                    std::uint8_t c,
+                    std::size_t len) noexcept
+    {
+        const __m256i lo   = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(kT.lo[c])));
+        const __m256i hi   = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(kT.hi[c])));
+        const __m256i mask = _mm256_set1_epi8(0x0F);
+        std::size_t i = 0;
+        for (; i + 32 <= len; i += 32)
+        {
+            const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            const __m256i l = _mm256_and_si256(s, mask);
+            const __m256i h = _mm256_and_si256(_mm256_srli_epi64(s, 4), mask);
+            const __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(lo, l), _mm256_shuffle_epi8(hi, h));
+            const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_xor_si256(d, p));
+        }
+        MulAddSsse3(dst + i, src + i, c, len - i);
+    }
+
+    bool HasSsse3() noexcept
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int r[4];
+        __cpuid(r, 1);
+        return (r[2] & (1 << 9)) != 0;
+#else
+        return __builtin_cpu_supports("ssse3");
+#endif
+    }
+
+    bool HasAvx2() noexcept
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int r[4];
+        __cpuid(r, 0);
+        if (r[0] < 7)
+        {
+            return false;
+        }
+        __cpuid(r, 1);
+        // OSXSAVE + AVX, и ОС сохраняет YMM-регистры.
+        if ((r[2] & (1 << 27)) == 0 || (r[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+        __cpuidex(r, 7, 0);
+        return (r[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    using MulAddFn = void (*)(std::uint8_t *, const std::uint8_t *, std::uint8_t, std::size_t) noexcept;
+
+    struct Impl
+    {
+        MulAddFn    fn;
+        const char *name;
+    };
+
+    Impl Select() noexcept
+    {
+#if defined(GF256_X86)
+        if (HasAvx2())
+        {
+            return {&MulAddAvx2, "avx2"};
+        }
+        if (HasSsse3())
+        {
+            return {&MulAddSsse3, "ssse3"};
+        }
+#endif
+        return {&MulAddScalar, "scalar"};
+    }
+
+    const Impl &Selected() noexcept
+    {
+        static const Impl impl = Select();
+        return impl;
+    }
+}
+
+namespace Gf256
+{
+    std::uint8_t Mul(std::uint8_t a,
+                     std::uint8_t b) noexcept
+    {
+        if (a == 0 || b == 0)
+        {
+            return 0;
+        }
+        return kT.exp[kT.log[a] + kT.log[b]];
+    }
+
+    std::uint8_t Inv(std::uint8_t a) noexcept
+    {
+        if (a == 0)
+        {
+            return 0;
+        }
+        return kT.exp[255 - kT.log[a]];
+    }
+
+    void MulAdd(std::uint8_t *dst,
+                const std::uint8_t *src,
+                std::uint8_t c,
+                std::size_t len) noexcept
+    {
+        if (c == 0 || len == 0)
+        {
+            return;
+        }
+        Selected().fn(dst, src, c, len);
+    }
+
+    const char *Backend() noexcept
+    {
+        return Selected().name;
+    }
+}
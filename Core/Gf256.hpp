@@ -0,0 +1,30 @@
+#pragma once
+// Gf256.hpp — арифметика поля GF(2^8) для кодов Рида–Соломона (полином 0x11D).
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Поле GF(2^8): сложение — XOR, умножение — по таблицам.
+ *
+ * Горячая операция — MulAdd (dst ^= c * src над буфером). Умножение на
+ * константу раскладывается на два полубайта: c*x = T_lo[x & 15] ^ T_hi[x >> 4],
+ * что на x86 делается двумя pshufb на 16 (SSSE3) или 32 (AVX2) байта за раз.
+ * Реализация выбирается один раз по CPUID; на прочих платформах — таблицы.
+ */
+namespace Gf256
+{
+    /** @brief Произведение a * b. */
+    std::uint8_t Mul(std::uint8_t a, std::uint8_t b) noexcept;
+
+    /** @brief Обратный элемент (a != 0; для 0 возвращает 0). */
+    std::uint8_t Inv(std::uint8_t a) noexcept;
+
+    /**
+     * @brief dst[i] ^= c * src[i] для i < len.
+     */
+    void MulAdd(std::uint8_t *dst, const std::uint8_t *src, std::uint8_t c, std::size_t len) noexcept;
+
+    /** @brief Имя выбранной реализации MulAdd: "avx2", "ssse3" или "scalar". */
+    const char *Backend() noexcept;
+}
@@ -0,0 +1,334 @@
+// Gro.cpp — реализация программного GRO.
+
+#include "Gro.hpp"
+
+#include "Checksum.hpp"
+#include "Headers.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    constexpr std::uint8_t kTcpPsh = 0x08;
+    constexpr std::uint8_t kTcpAck = 0x10;
+}
+
+/**
+ * @brief Разобранные заголовки пакета.
+ */
+struct Gro::Parsed
+{
+    const std::uint8_t *pkt = nullptr;
+    std::size_t   len = 0;
+    bool          ipv6 = false;
+    bool          candidate = false;   ///< Подходит для склейки (кроме суммы).
+    std::uint16_t ip_len = 0;
+    std::uint16_t hdr_len = 0;
+    std::size_t   payload_len = 0;
+    std::uint32_t seq = 0;
+    std::uint8_t  flags = 0;
+    std::uint8_t  key[36] = {};
+
+    /// @return false — не TCP (или заголовки не разбираются).
+    bool Parse(const std::uint8_t *data, std::size_t size) noexcept
+    {
+        pkt = data;
+        len = size;
+        if (size < 20 || size > 0xFFFF)
+        {
+            return false;
+        }
+        bool plain = true;   // Без опций IP, фрагментации и хвоста за пакетом.
+        if ((data[0] >> 4) == 4)
+        {
+            ip_len = static_cast<std::uint16_t>((data[0] & 0x0F) * 4);
+            if (ip_len < 20 || data[9] != Headers::kProtoTcp || (Headers::Load16(data + 6) & 0x1FFF) != 0)
+            {
+                return false;
+            }
+            plain = ip_len == 20 && Headers::Load16(data + 2) == size && (data[6] & 0x20) == 0;
+            std::memcpy(key, data + 12, 8);
+        }
+        else if ((data[0] >> 4) == 6 && size >= 40)
+        {
+            // Цепочки расширений не разбираются: такие пакеты идут мимо склейки.
+            ip_len = 40;
+            ipv6   = true;
+            if (data[6] != Headers::kProtoTcp)
+            {
+                return false;
+            }
+            plain = Headers::Load16(data + 4) + 40u == size;
+            std::memcpy(key, data + 8, 32);
+        }
+        else
+        {
+            return false;
+        }
+        if (size < ip_len + 20u)
+        {
+            return false;
+        }
+        const std::uint8_t *tcp = data + ip_len;
+        std::memcpy(key + (ipv6 ? 32 : 8), tcp, 4);
+        const std::size_t tcp_hlen = static_cast<std::size_t>(tcp[12] >> 4) * 4;
+        if (tcp_hlen < 20 || ip_len + tcp_hlen > size)
+        {
+            return false;
+        }
+        hdr_len     = static_cast<std::uint16_t>(ip_len + tcp_hlen);
+        payload_len = size - hdr_len;
+        seq         = Headers::Load32(tcp + 4);
+        flags       = tcp[13];
+        candidate   = plain && payload_len != 0 && (flags & kTcpAck) != 0 &&
+                      (flags & ~(kTcpAck | kTcpPsh)) == 0;
+        return true;
+    }
+
+};
+
+Gro::Gro(const Options &opts,
+         Emit emit)
+    : opts_(opts)
+    , emit_(std::move(emit))
+{
+    if (!emit_ || opts.flows == 0 || opts.max_segments < 2 || opts.max_size < 60 || opts.max_size > 0xFFFF ||
+        opts.hold.count() < 0)
+    {
+        throw std::invalid_argument("Gro: invalid options");
+    }
+    flows_.resize(opts.flows);
+    buf_.resize(static_cast<std::size_t>(opts.flows) * opts.max_size);
+}
+
+bool Gro::Push(const std::uint8_t *pkt,
+               std::size_t len,
+               Clock::time_point now)
+{
+    ++stats_.packets;
+    Parsed p;
+    if (!p.Parse(pkt, len))
+    {
+        ++stats_.passthrough;
+        return false;
+    }
+
+    Flow *f = nullptr;
+    if (held_ != 0)
+    {
+        for (Flow &x : flows_)
+        {
+            if (x.used && x.ipv6 == p.ipv6 && std::memcmp(x.key, p.key, sizeof(p.key)) == 0)
+            {
+                f = &x;
+                break;
+            }
+        }
+    }
+    if (!p.candidate || len > opts_.max_size)
+    {
+        // SYN/FIN/RST, чистый ACK и прочее — после удержанного своего потока.
+        if (f != nullptr)
+        {
+            Release(*f);
+        }
+        ++stats_.passthrough;
+        return false;
+    }
+
+    const std::uint8_t *tcp = pkt + p.ip_len;
+    const std::uint32_t payload_sum = Checksum::Sum(pkt + p.hdr_len, p.payload_len);
+    const std::uint32_t pseudo = Checksum::Pseudo(pkt, Headers::kProtoTcp, len - p.ip_len);
+    if (Checksum::Sum(tcp, p.hdr_len - p.ip_len, Checksum::Add(pseudo, payload_sum)) != 0xFFFF)
+    {
+        if (f != nullptr)
+        {
+            Release(*f);
+        }
+        ++stats_.bad_csum;
+        return false;
+    }
+
+    if (f != nullptr)
+    {
+        if (Mergeable(*f, p))
+        {
+            Append(*f, p);
+            // Сумма данных нового сегмента — со сдвигом на байт, если данных до него нечётное число.
+            f->payload_sum += ((f->len - p.payload_len - f->hdr_len) & 1) != 0 ? Checksum::Swap(payload_sum) : payload_sum;
+            ++stats_.coalesced;
+            if (f->closed || f->segments >= opts_.max_segments || f->len + f->gso_size > opts_.max_size)
+            {
+                Release(*f);
+            }
+            return true;
+        }
+        Release(*f);
+    }
+    if ((p.flags & kTcpPsh) != 0)
+    {
+        // Продолжения не будет: держать незачем.
+        ++stats_.passthrough;
+        return false;
+    }
+    if (held_ == flows_.size())
+    {
+        Flow *oldest = &flows_.front();
+        for (Flow &x : flows_)
+        {
+            if (x.deadline < oldest->deadline)
+            {
+                oldest = &x;
+            }
+        }
+        Release(*oldest);
+    }
+    for (Flow &x : flows_)
+    {
+        if (!x.used)
+        {
+            Hold(x, p, now);
+            x.payload_sum = payload_sum;
+            break;
+        }
+    }
+    return true;
+}
+
+void Gro::Hold(Flow &f,
+               const Parsed &p,
+               Clock::time_point now) noexcept
+{
+    std::memcpy(BufOf(f), p.pkt, p.len);
+    std::memcpy(f.key, p.key, sizeof(f.key));
+    f.used     = true;
+    f.ipv6     = p.ipv6;
+    f.closed   = false;
+    f.len      = p.len;
+    f.ip_len   = p.ip_len;
+    f.hdr_len  = p.hdr_len;
+    f.gso_size = static_cast<std::uint16_t>(p.payload_len);
+    f.segments = 1;
+    f.next_seq = p.seq + static_cast<std::uint32_t>(p.payload_len);
+    f.deadline = now + opts_.hold;
+    ++held_;
+}
+
+bool Gro::Mergeable(const Flow &f,
+                    const Parsed &p) noexcept
+{
+    if (f.closed || p.seq != f.next_seq || p.payload_len > f.gso_size || p.hdr_len != f.hdr_len ||
+        f.len + p.payload_len > opts_.max_size)
+    {
+        return false;
+    }
+    const std::uint8_t *a = BufOf(f);
+    const std::uint8_t *b = p.pkt;
+    // IP: всё, кроме длины, ID и суммы (v4) или длины нагрузки (v6); адреса совпали по ключу.
+    if (p.ipv6 ? std::memcmp(a, b, 4) != 0 || std::memcmp(a + 6, b + 6, 2) != 0
+               : std::memcmp(a, b, 2) != 0 || std::memcmp(a + 6, b + 6, 4) != 0)
+    {
+        return false;
+    }
+    // TCP: ack, длина заголовка, флаги (кроме PSH), окно, urgent и опции; seq и сумма — свои у каждого.
+    a += f.ip_len;
+    b += p.ip_len;
+    return std::memcmp(a + 8, b + 8, 5) == 0 && ((a[13] ^ b[13]) & ~kTcpPsh) == 0 &&
+           std::memcmp(a + 14, b + 14, 2) == 0 &&
+           std::memcmp(a + 18, b + 18, static_cast<std::size_t>(f.hdr_len - f.ip_len) - 18) == 0;
+}
+
+void Gro::Append(Flow &f,
+                 const Parsed &p) noexcept
+{
+    std::uint8_t *buf = BufOf(f);
+    std::memcpy(buf + f.len, p.pkt + p.hdr_len, p.payload_len);
+    f.len      += p.payload_len;
+    f.next_seq += static_cast<std::uint32_t>(p.payload_len);
+    ++f.segments;
+    if ((p.flags & kTcpPsh) != 0)
+    {
+        buf[f.ip_len + 13] |= kTcpPsh;
+        f.closed = true;
+    }
+    if (p.payload_len < f.gso_size)
+    {
+        f.closed = true;
+    }
+}
+
+void Gro::Release(Flow &f)
+{
+    std::uint8_t *buf = BufOf(f);
+    Packet out;
+    out.data       = buf;
+    out.len        = f.len;
+    out.segments   = f.segments;
+    out.gso_size   = f.gso_size;
+    out.hdr_len    = f.hdr_len;
+    out.csum_start = f.ip_len;
+    out.ipv6       = f.ipv6;
+
+    if (f.segments > 1)
+    {
+        if (f.ipv6)
+        {
+            Headers::Store16(buf + 4, static_cast<std::uint16_t>(f.len - 40));
+        }
+        else
+        {
+            Headers::Store16(buf + 2, static_cast<std::uint16_t>(f.len));
+            buf[10] = 0;
+            buf[11] = 0;
+            Headers::Store16(buf + 10, Checksum::Finish(Checksum::Sum(buf, 20)));
+        }
+        std::uint8_t *tcp = buf + f.ip_len;
+        const std::uint32_t pseudo = Checksum::Pseudo(buf, Headers::kProtoTcp, f.len - f.ip_len);
+        tcp[16] = 0;
+        tcp[17] = 0;
+        if (opts_.partial_csum)
+        {
+            // CHECKSUM_PARTIAL: в поле — несвёрнутая в дополнение сумма псевдозаголовка.
+            Headers::Store16(tcp + 16, static_cast<std::uint16_t>(pseudo));
+        }
+        else
+        {
+            const std::uint32_t s = Checksum::Sum(tcp, f.hdr_len - f.ip_len, Checksum::Add(pseudo, Checksum::Fold(f.payload_sum)));
+            Headers::Store16(tcp + 16, Checksum::Finish(s));
+        }
+        ++stats_.supers;
+    }
+
+    f.used = false;
+    --held_;
+    emit_(out);
+}
+
+void Gro::Poll(Clock::time_point now)
+{
+    if (held_ == 0)
+    {
+        return;
+    }
+    for (Flow &f : flows_)
+    {
+        if (f.used && now >= f.deadline)
+        {
+            Release(f);
+            ++stats_.expired;
+        }
+    }
+}
+
+void Gro::Flush()
+{
+    for (Flow &f : flows_)
+    {
+        if (f.used)
+        {
+            Release(f);
+        }
+    }
+}
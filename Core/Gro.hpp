@@ -0,0 +1,162 @@
+#pragma once
+// Gro.hpp — программный GRO: склейка последовательных TCP-сегментов одного потока перед записью в TUN.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Склейка входящих TCP-сегментов (generic receive offload в пространстве пользователя).
+ *
+ * Сегменты одного потока, идущие подряд по seq, с одинаковыми заголовками
+ * (кроме длины, IP ID и контрольных сумм), только с ACK/PSH и непустыми
+ * данными собираются в один пакет: стек хоста обрабатывает его один раз
+ * вместо десятков. Правила — как у GRO ядра Linux: сегменты одного размера,
+ * последний может быть короче, после короткого или с PSH поток выталкивается.
+ * Контрольная сумма TCP каждого сегмента проверяется до склейки — испорченный
+ * сегмент не получит верную сумму склеенного пакета и уходит как есть.
+ *
+ * Склеенный пакет выдаётся колбэком Emit вместе с описанием для GSO:
+ * - partial_csum = true (TUN Linux с virtio_net_hdr): пакет до max_size
+ *   (65535), в поле суммы TCP — сумма псевдозаголовка, досчитывает и режет
+ *   на сегменты по gso_size ядро;
+ * - partial_csum = false (Wintun и прочие без GSO): max_size — MTU, сумма
+ *   считается полностью, пакет — обычный IP-пакет.
+ *
+ * Пакет удерживается до границы пачки: Push следующего несовместимого
+ * сегмента, заполнения, вытеснения другим потоком или срока hold (Poll).
+ * Не TCP и пакеты без данных не удерживаются; порядок внутри потока
+ * сохраняется (удержанное выталкивается раньше).
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class Gro
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Пакет на выходе.
+     */
+    struct Packet
+    {
+        const std::uint8_t *data = nullptr;
+        std::size_t         len  = 0;
+        unsigned            segments = 1;   ///< Склеено сегментов (1 — пакет как пришёл).
+        std::uint16_t       gso_size = 0;   ///< Данных TCP в сегменте (при segments > 1).
+        std::uint16_t       hdr_len  = 0;   ///< Заголовки IP + TCP.
+        std::uint16_t       csum_start = 0; ///< Смещение заголовка TCP.
+        bool                ipv6 = false;
+    };
+
+    /// @brief Выдача пакета: вызывается изнутри Push/Poll/Flush.
+    using Emit = std::function<void(const Packet &)>;
+
+    /**
+     * @brief Параметры склейки.
+     */
+    struct Options
+    {
+        /// @brief Наибольший склеенный пакет вместе с IP-заголовком (<= 65535).
+        std::size_t max_size = 65535;
+        /// @brief Потоков, удерживаемых одновременно (память — flows * max_size).
+        unsigned flows = 8;
+        /// @brief Наибольшее число сегментов в пакете.
+        unsigned max_segments = 64;
+        /// @brief Сколько первый сегмент может ждать продолжения (0 — до ближайшего Poll).
+        std::chrono::microseconds hold{100};
+        /// @brief Оставить сумму TCP частичной (её досчитает ядро по virtio_net_hdr).
+        bool partial_csum = false;
+    };
+
+    /**
+     * @brief Счётчики склейки.
+     */
+    struct Stats
+    {
+        std::uint64_t packets     = 0;   ///< Пакетов предъявлено.
+        std::uint64_t coalesced   = 0;   ///< Сегментов, дописанных к предыдущему.
+        std::uint64_t supers      = 0;   ///< Склеенных пакетов выдано.
+        std::uint64_t passthrough = 0;   ///< Пакетов, не подходящих для склейки.
+        std::uint64_t bad_csum    = 0;   ///< Сегментов с неверной суммой TCP (не склеены).
+        std::uint64_t expired     = 0;   ///< Потоков, вытолкнутых по hold.
+    };
+
+    /**
+     * @brief Создать склейку (вся память выделяется здесь).
+     * @throw std::invalid_argument Некорректные Options или пустой emit.
+     */
+    Gro(const Options &opts, Emit emit);
+
+    Gro(const Gro &) = delete;
+    Gro &operator=(const Gro &) = delete;
+
+    /**
+     * @brief Предъявить пакет.
+     * @return true — пакет взят (его выдаст Emit); false — записать как есть
+     *         (удержанное его потока уже выдано).
+     */
+    bool Push(const std::uint8_t *pkt, std::size_t len, Clock::time_point now);
+
+    /**
+     * @brief Выдать потоки, чей срок hold истёк.
+     */
+    void Poll(Clock::time_point now);
+
+    /**
+     * @brief Выдать всё удержанное.
+     */
+    void Flush();
+
+    /** @brief Есть ли удержанные пакеты. */
+    bool Pending() const noexcept { return held_ != 0; }
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+private:
+    /// @brief Разобранные заголовки пакета.
+    struct Parsed;
+
+    /**
+     * @brief Удерживаемый поток: склеиваемый пакет в своём буфере.
+     */
+    struct Flow
+    {
+        bool              used = false;
+        bool              ipv6 = false;
+        bool              closed = false;      ///< Последний сегмент короче gso_size или с PSH.
+        std::uint8_t      key[36] = {};        ///< Адреса и порты.
+        std::size_t       len = 0;             ///< Байт пакета в буфере.
+        std::uint16_t     ip_len  = 0;         ///< Заголовок IP.
+        std::uint16_t     hdr_len = 0;         ///< Заголовки IP + TCP.
+        std::uint16_t     gso_size = 0;        ///< Данных в первом сегменте.
+        unsigned          segments = 0;
+        std::uint32_t     next_seq = 0;
+        std::uint64_t     payload_sum = 0;     ///< Сумма данных (в порядке байт сети, не свёрнута).
+        Clock::time_point deadline;
+    };
+
+    Options             opts_;
+    Emit                emit_;
+    std::vector<Flow>   flows_;
+    std::vector<std::uint8_t> buf_;            ///< flows * max_size.
+    unsigned            held_ = 0;
+    Stats               stats_;
+
+    std::uint8_t *BufOf(const Flow &f) noexcept { return buf_.data() + static_cast<std::size_t>(&f - flows_.data()) * opts_.max_size; }
+
+    /// @brief Начать удержание потока пакетом p.
+    void Hold(Flow &f, const Parsed &p, Clock::time_point now) noexcept;
+
+    /// @brief Дописать данные сегмента к потоку.
+    void Append(Flow &f, const Parsed &p) noexcept;
+
+    /// @brief Можно ли дописать сегмент к потоку.
+    bool Mergeable(const Flow &f, const Parsed &p) noexcept;
+
+    /// @brief Закрыть пакет потока (длины, суммы) и выдать его.
+    void Release(Flow &f);
+};
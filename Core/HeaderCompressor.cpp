@@ -0,0 +1,685 @@
+// HeaderCompressor.cpp — сжатие заголовков по потокам и восстановление пакетов из кадров Header.
+
+#include "HeaderCompressor.hpp"
+#include "Headers.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    using Ref = HeaderCompressor::Ref;
+
+    /// @brief Подтверждений в очереди приёмника не больше (повтор придёт со следующей опорой).
+    constexpr std::size_t kMaxAcks = 256;
+
+    /// @brief Контекст и поколения в начале нагрузки.
+    constexpr std::size_t kFields = HeaderCompressor::kContextOverhead - CoreFrame::kHeaderSize;
+
+    /// @brief Наибольшая длина опций TCP.
+    constexpr std::size_t kMaxOptions = 40;
+
+    /// @brief Биты ctl: поле присутствует (иначе — как в опоре, urgent — 0, опций нет).
+    constexpr std::uint8_t kIpId    = 0x01;
+    constexpr std::uint8_t kSeq     = 0x02;
+    constexpr std::uint8_t kAck     = 0x04;
+    constexpr std::uint8_t kWindow  = 0x08;
+    constexpr std::uint8_t kUrgent  = 0x10;
+    constexpr std::uint8_t kOptions = 0x20;
+    constexpr std::uint8_t kTos     = 0x40;
+    constexpr std::uint8_t kTcpOnly = kSeq | kAck | kWindow | kUrgent | kOptions;
+
+    /// @brief Наибольший сжатый заголовок: ctl, разности, TOS, окно, urgent, флаги, сумма, опции.
+    constexpr std::size_t kMaxEncoded = 1 + 3 + 1 + 5 + 5 + 2 + 2 + 1 + 2 + 1 + kMaxOptions;
+
+    /// @brief Поколение a новее b: поколения идут по кругу 1..255, новее — меньше чем на полкруга вперёд.
+    constexpr bool Newer(std::uint8_t a, std::uint8_t b) noexcept
+    {
+        const unsigned d = (a + 255u - b) % 255u;
+        return d != 0 && d < 128;
+    }
+
+    /**
+     * @brief Разобранный сжимаемый пакет.
+     */
+    struct Parsed
+    {
+        std::size_t   ip_hl  = 0;       ///< 20 или 40.
+        std::size_t   hlen   = 0;       ///< ip_hl + фиксированный заголовок L4.
+        std::size_t   opt    = 0;       ///< Опции TCP.
+        bool          v6     = false;
+        bool          tcp    = false;
+        std::uint8_t  flags  = 0;
+        std::uint16_t urgent = 0;
+        std::uint16_t check  = 0;
+        Ref           ref;
+    };
+
+    /// @brief Разобрать пакет; false — заголовок не сжимается.
+    bool Parse(const std::uint8_t *pkt, std::size_t len, Parsed *p) noexcept
+    {
+        std::uint8_t proto = 0;
+        if (const Headers::ConstIp4 ip{pkt, len})
+        {
+            // Опции IP и фрагменты редки: для них контекст не заводится.
+            if (ip.HeaderSize() != Headers::ConstIp4::kMinSize || ip.IsFragment() || ip.TotalLength() != len)
+            {
+                return false;
+            }
+            p->ip_hl   = Headers::ConstIp4::kMinSize;
+            p->ref.id  = ip.Id();
+            p->ref.tos = ip.Tos();
+            proto      = ip.Protocol();
+        }
+        else if (const Headers::ConstIp6 ip6{pkt, len})
+        {
+            if (Headers::ConstIp6::kSize + ip6.PayloadLength() != len)
+            {
+                return false;
+            }
+            p->ip_hl   = Headers::ConstIp6::kSize;
+            p->v6      = true;
+            p->ref.tos = ip6.TrafficClass();
+            proto      = ip6.NextHeader();
+        }
+        else
+        {
+            return false;
+        }
+
+        const std::uint8_t *l4 = pkt + p->ip_hl;
+        const std::size_t l4_len = len - p->ip_hl;
+        if (proto == Headers::kProtoTcp)
+        {
+            const Headers::ConstTcp tcp{l4, l4_len};
+            if (!tcp)
+            {
+                return false;
+            }
+            p->tcp        = true;
+            p->hlen       = p->ip_hl + Headers::ConstTcp::kMinSize;
+            p->opt        = tcp.HeaderSize() - Headers::ConstTcp::kMinSize;
+            p->flags      = tcp.Flags();
+            p->urgent     = tcp.Urgent();
+            p->check      = tcp.Check();
+            p->ref.seq    = tcp.Seq();
+            p->ref.ack    = tcp.AckSeq();
+            p->ref.window = tcp.Window();
+            return true;
+        }
+        if (proto == Headers::kProtoUdp)
+        {
+            const Headers::ConstUdp udp{l4, l4_len};
+            if (!udp || udp.Length() != l4_len)
+            {
+                return false;
+            }
+            p->hlen  = p->ip_hl + Headers::ConstUdp::kSize;
+            p->check = udp.Check();
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief Неизменные поля заголовка: копия с обнулёнными изменяемыми полями.
+    void Normalize(const std::uint8_t *pkt, const Parsed &p, std::uint8_t *out) noexcept
+    {
+        std::memcpy(out, pkt, p.hlen);
+        if (p.v6)
+        {
+            out[0] &= 0xF0;               // traffic class
+            out[1] &= 0x0F;
+            std::memset(out + 4, 0, 2);   // payload length
+        }
+        else
+        {
+            out[1] = 0;                   // TOS
+            std::memset(out + 2, 0, 4);   // total length, id
+            std::memset(out + 10, 0, 2);  // checksum
+        }
+        std::uint8_t *l4 = out + p.ip_hl;
+        if (p.tcp)
+        {
+            std::memset(l4 + 4, 0, 8);    // seq, ack
+            l4[12] &= 0x0F;               // data offset (младшие биты — флаг AE, неизменен)
+            std::memset(l4 + 13, 0, 7);   // flags, window, checksum, urgent
+        }
+        else
+        {
+            std::memset(l4 + 4, 0, 4);    // length, checksum
+        }
+    }
+
+    /// @brief Число без знака — LEB128 (7 бит на байт, старший бит — «дальше ещё»).
+    inline std::uint8_t *PutVar(std::uint8_t *p, std::uint32_t v) noexcept
+    {
+        while (v >= 0x80)
+        {
+            *p++ = static_cast<std::uint8_t>(v | 0x80);
+            v >>= 7;
+        }
+        *p++ = static_cast<std::uint8_t>(v);
+        return p;
+    }
+
+    /// @brief Прочитать LEB128 (не длиннее 5 байт); false — кадр кончился или число испорчено.
+    inline bool GetVar(const std::uint8_t *&p, const std::uint8_t *end, std::uint32_t *v) noexcept
+    {
+        std::uint32_t r = 0;
+        for (unsigned shift = 0; shift < 35; shift += 7)
+        {
+            if (p == end)
+            {
+                return false;
+            }
+            const std::uint8_t b = *p++;
+            r |= static_cast<std::uint32_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0)
+            {
+                *v = r;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Длина LEB128 числа v.
+    constexpr std::size_t VarSize(std::uint32_t v) noexcept
+    {
+        std::size_t n = 1;
+        for (; v >= 0x80; v >>= 7)
+        {
+            ++n;
+        }
+        return n;
+    }
+
+    inline std::uint16_t LoadBe16(const std::uint8_t *p) noexcept
+    {
+        return static_cast<std::uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    inline void StoreBe16(std::uint8_t *p, std::uint16_t v) noexcept
+    {
+        p[0] = static_cast<std::uint8_t>(v >> 8);
+        p[1] = static_cast<std::uint8_t>(v);
+    }
+}
+
+// ---- HeaderCompressor ----
+
+HeaderCompressor::HeaderCompressor(const Options &opts)
+    : opts_(opts)
+    , table_(FlowTable::Options{opts.flows, opts.idle, std::chrono::milliseconds(100), 0},
+             [this](FlowTable::FlowId id, const FlowTable::Key &, FlowTable::Reason) { Clear(flows_[id]); })
+{
+    if (opts.flows == 0 || opts.flows > 0x10000 || opts.refresh == 0 ||
+        opts.ir_max < Headers::ConstIp4::kMinSize + Headers::ConstUdp::kSize)
+    {
+        throw std::invalid_argument("HeaderCompressor: invalid options");
+    }
+    flows_.resize(opts.flows);
+}
+
+void HeaderCompressor::Clear(Flow &f) noexcept
+{
+    f.hlen        = 0;
+    f.acked_gen   = 0;
+    f.pending_gen = 0;
+    f.since       = 0;
+}
+
+std::uint8_t HeaderCompressor::NextGen(Flow &f) noexcept
+{
+    f.gen = static_cast<std::uint8_t>(f.gen % 255 + 1);
+    return f.gen;
+}
+
+std::size_t HeaderCompressor::Compress(std::uint8_t *buf,
+                                       std::size_t len,
+                                       std::size_t size,
+                                       Clock::time_point now) noexcept
+{
+    ++stats_.packets;
+    stats_.bytes_in  += len;
+    stats_.bytes_out += len;
+    Parsed p;
+    FlowTable::Key key;
+    if (len > size || len > 0xFFFF || !Parse(buf, len, &p) || !FlowTable::ExtractKey(buf, len, &key))
+    {
+        ++stats_.skipped;
+        return len;
+    }
+
+    FlowTable::FlowId id = FlowTable::kNone;
+    try
+    {
+        table_.Expire(now);
+        bool created = false;
+        id = table_.Touch(key, now, &created);
+        if (created)
+        {
+            Clear(flows_[id]);
+        }
+    }
+    catch (...)
+    {
+        return len;
+    }
+    Flow &f = flows_[id];
+
+    // Сменились неизменные поля (TTL, метка потока) — опоры недействительны, нужен новый контекст.
+    std::uint8_t hdr[kMaxHeader];
+    Normalize(buf, p, hdr);
+    if (f.hlen != p.hlen || std::memcmp(f.hdr.data(), hdr, p.hlen) != 0)
+    {
+        Clear(f);
+        std::memcpy(f.hdr.data(), hdr, p.hlen);
+        f.hlen = static_cast<std::uint8_t>(p.hlen);
+    }
+    ++f.since;
+
+    if (f.acked_gen == 0)
+    {
+        // Полный контекст: пакет целиком за контекстом и поколением; без подтверждения — раз в refresh пакетов.
+        if ((f.pending_gen != 0 && f.since < opts_.refresh) || len > opts_.ir_max || len + kContextOverhead > size)
+        {
+            return len;
+        }
+        const std::uint8_t gen = NextGen(f);
+        f.pending     = p.ref;
+        f.pending_gen = gen;
+        f.since       = 0;
+        std::memmove(buf + kContextOverhead, buf, len);
+        CoreFrame::BuildHeader(CoreFrame::Type::Header, kFields + len, buf);
+        StoreBe16(buf + CoreFrame::kHeaderSize, static_cast<std::uint16_t>(id));
+        buf[CoreFrame::kHeaderSize + 2] = 0;
+        buf[CoreFrame::kHeaderSize + 3] = gen;
+        ++stats_.contexts;
+        ++stats_.refs;
+        stats_.bytes_out += kContextOverhead;
+        return len + kContextOverhead;
+    }
+
+    std::uint8_t enc[kMaxEncoded];
+    std::uint8_t *e = enc + 1;
+    std::uint8_t ctl  = 0;
+    bool         wide = false;
+    if (!p.v6 && p.ref.id != f.acked.id)
+    {
+        const auto d = static_cast<std::uint16_t>(p.ref.id - f.acked.id);
+        ctl |= kIpId;
+        wide |= VarSize(d) > 2;
+        e = PutVar(e, d);
+    }
+    if (p.ref.tos != f.acked.tos)
+    {
+        ctl |= kTos;
+        *e++ = p.ref.tos;
+    }
+    if (p.tcp)
+    {
+        if (p.ref.seq != f.acked.seq)
+        {
+            const std::uint32_t d = p.ref.seq - f.acked.seq;
+            ctl |= kSeq;
+            wide |= VarSize(d) > 3;
+            e = PutVar(e, d);
+        }
+        if (p.ref.ack != f.acked.ack)
+        {
+            const std::uint32_t d = p.ref.ack - f.acked.ack;
+            ctl |= kAck;
+            wide |= VarSize(d) > 3;
+            e = PutVar(e, d);
+        }
+        if (p.ref.window != f.acked.window)
+        {
+            ctl |= kWindow;
+            StoreBe16(e, p.ref.window);
+            e += 2;
+        }
+        if (p.urgent != 0)
+        {
+            ctl |= kUrgent;
+            StoreBe16(e, p.urgent);
+            e += 2;
+        }
+        *e++ = p.flags;
+    }
+    StoreBe16(e, p.check);
+    e += 2;
+    if (p.opt != 0)
+    {
+        ctl |= kOptions;
+        *e++ = static_cast<std::uint8_t>(p.opt);
+        std::memcpy(e, buf + p.hlen, p.opt);
+        e += p.opt;
+    }
+    enc[0] = ctl;
+
+    // Кадр строго короче пакета.
+    const std::size_t head  = static_cast<std::size_t>(e - enc);
+    const std::size_t data  = len - p.hlen - p.opt;
+    const std::size_t frame = kContextOverhead + head + data;
+    if (frame >= len)
+    {
+        return len;
+    }
+
+    // Разности растут с каждым пакетом: опора сдвигается, когда они расширились или давно не сдвигалась
+    // (не чаще: каждая опора — кадр HeaderAck в обратную сторону).
+    std::uint8_t gen = 0;
+    if (f.since >= opts_.refresh || (f.pending_gen == 0 && wide))
+    {
+        gen = NextGen(f);
+        f.pending     = p.ref;
+        f.pending_gen = gen;
+        f.since       = 0;
+        ++stats_.refs;
+    }
+
+    std::memmove(buf + kContextOverhead + head, buf + p.hlen + p.opt, data);
+    CoreFrame::BuildHeader(CoreFrame::Type::Header, frame - CoreFrame::kHeaderSize, buf);
+    StoreBe16(buf + CoreFrame::kHeaderSize, static_cast<std::uint16_t>(id));
+    buf[CoreFrame::kHeaderSize + 2] = f.acked_gen;
+    buf[CoreFrame::kHeaderSize + 3] = gen;
+    std::memcpy(buf + kContextOverhead, enc, head);
+
+    ++stats_.compressed;
+    stats_.bytes_out -= len - frame;
+    return frame;
+}
+
+void HeaderCompressor::OnAck(const std::uint8_t *payload,
+                             std::size_t len) noexcept
+{
+    for (std::size_t i = 0; i + 3 <= len; i += 3)
+    {
+        const std::uint16_t slot = LoadBe16(payload + i);
+        const std::uint8_t  gen  = payload[i + 2];
+        if (slot >= flows_.size())
+        {
+            continue;
+        }
+        // Номер мог перейти к другому потоку: его поколения другие, подтверждение не совпадёт.
+        Flow &f = flows_[slot];
+        if (gen == 0 || f.pending_gen != gen)
+        {
+            continue;
+        }
+        f.acked       = f.pending;
+        f.acked_gen   = gen;
+        f.pending_gen = 0;
+        ++stats_.acks;
+    }
+}
+
+void HeaderCompressor::Reset()
+{
+    std::vector<FlowTable::FlowId> live;
+    live.reserve(table_.Size());
+    table_.ForEach([&live](FlowTable::FlowId id, const FlowTable::Key &) { live.push_back(id); });
+    for (const FlowTable::FlowId id : live)
+    {
+        table_.Erase(id);
+        Clear(flows_[id]);
+    }
+}
+
+// ---- HeaderDecompressor ----
+
+HeaderDecompressor::HeaderDecompressor(const Options &opts)
+    : opts_(opts)
+{
+    if (opts.mtu < HeaderCompressor::kMaxHeader || opts.mtu > 0xFFFF || opts.flows == 0)
+    {
+        throw std::invalid_argument("HeaderDecompressor: invalid options");
+    }
+    out_.resize(opts.mtu);
+    acks_.reserve(kMaxAcks);
+}
+
+void HeaderDecompressor::Store(std::uint16_t ctx,
+                               std::uint8_t used,
+                               std::uint8_t gen,
+                               const std::uint8_t *hdr,
+                               std::size_t hlen,
+                               const HeaderCompressor::Ref &ref) noexcept
+{
+    try
+    {
+        auto it = slots_.find(ctx);
+        if (it == slots_.end())
+        {
+            if (slots_.size() >= opts_.flows)
+            {
+                return;
+            }
+            it = slots_.emplace(ctx, Slot{}).first;
+        }
+        Slot &slot = it->second;
+        // Опоздавший кадр (вне очереди или после смены поколений) не подменяет более новую опору.
+        if (slot.cur.gen != 0 && !Newer(gen, slot.cur.gen))
+        {
+            ++stats_.stale;
+            return;
+        }
+        // Отправитель до подтверждения сжимает прежней опорой (used): она остаётся в prev.
+        if (used == 0 || used != slot.prev.gen)
+        {
+            slot.prev = slot.cur;
+        }
+        std::memcpy(slot.cur.hdr.data(), hdr, hlen);
+        slot.cur.hlen = static_cast<std::uint8_t>(hlen);
+        slot.cur.gen  = gen;
+        slot.cur.ref  = ref;
+        if (acks_.size() < kMaxAcks)
+        {
+            acks_.emplace_back(ctx, gen);
+        }
+    }
+    catch (...)
+    {
+    }
+}
+
+bool HeaderDecompressor::Decompress(const std::uint8_t *payload,
+                                    std::size_t len,
+                                    const std::uint8_t **pkt,
+                                    std::size_t *pkt_len) noexcept
+{
+    if (len <= kFields)
+    {
+        ++stats_.malformed;
+        return false;
+    }
+    const std::uint16_t ctx  = LoadBe16(payload);
+    const std::uint8_t  used = payload[2];
+    const std::uint8_t  gen  = payload[3];
+    const std::uint8_t *p    = payload + kFields;
+    const std::uint8_t *end  = payload + len;
+
+    if (used == 0)
+    {
+        // Полный контекст: за полями — пакет без изменений.
+        Parsed parsed;
+        const std::size_t n = len - kFields;
+        if (gen == 0 || !Parse(p, n, &parsed))
+        {
+            ++stats_.malformed;
+            return false;
+        }
+        std::uint8_t hdr[HeaderCompressor::kMaxHeader];
+        Normalize(p, parsed, hdr);
+        Store(ctx, 0, gen, hdr, parsed.hlen, parsed.ref);
+        ++stats_.contexts;
+        ++stats_.frames;
+        stats_.bytes_in  += len + CoreFrame::kHeaderSize;
+        stats_.bytes_out += n;
+        *pkt     = p;
+        *pkt_len = n;
+        return true;
+    }
+
+    const Context *base = nullptr;
+    if (auto it = slots_.find(ctx); it != slots_.end())
+    {
+        if (it->second.cur.gen == used)
+            base = &it->second.cur;
+        else if (it->second.prev.gen == used)
+            base = &it->second.prev;
+    }
+    if (!base)
+    {
+        // Опора сменилась раньше, чем дошёл этот (опоздавший) кадр, или контекст потерян.
+        ++stats_.no_context;
+        return false;
+    }
+
+    const std::uint8_t *t    = base->hdr.data();
+    const bool          v6   = (t[0] >> 4) == 6;
+    const std::size_t   ip_hl = v6 ? Headers::ConstIp6::kSize : Headers::ConstIp4::kMinSize;
+    const bool          tcp  = (v6 ? t[6] : t[9]) == Headers::kProtoTcp;
+    HeaderCompressor::Ref ref = base->ref;
+    std::uint8_t  flags  = 0;
+    std::uint16_t urgent = 0;
+    std::size_t   opt    = 0;
+    const std::uint8_t *opts = nullptr;
+
+    const std::uint8_t ctl = *p++;
+    bool ok = (ctl & ~(kIpId | kTos | kTcpOnly)) == 0 && (tcp || (ctl & kTcpOnly) == 0) && (!v6 || (ctl & kIpId) == 0);
+    std::uint32_t d = 0;
+    if (ok && (ctl & kIpId))
+    {
+        ok = GetVar(p, end, &d) && d <= 0xFFFF;
+        ref.id = static_cast<std::uint16_t>(ref.id + d);
+    }
+    if (ok && (ctl & kTos))
+    {
+        ok = p != end;
+        ref.tos = ok ? *p++ : 0;
+    }
+    if (ok && (ctl & kSeq))
+    {
+        ok = GetVar(p, end, &d);
+        ref.seq += d;
+    }
+    if (ok && (ctl & kAck))
+    {
+        ok = GetVar(p, end, &d);
+        ref.ack += d;
+    }
+    if (ok && (ctl & kWindow))
+    {
+        ok = end - p >= 2;
+        ref.window = ok ? LoadBe16(p) : 0;
+        p += ok ? 2 : 0;
+    }
+    if (ok && (ctl & kUrgent))
+    {
+        ok = end - p >= 2;
+        urgent = ok ? LoadBe16(p) : 0;
+        p += ok ? 2 : 0;
+    }
+    if (ok && tcp)
+    {
+        ok = p != end;
+        flags = ok ? *p++ : 0;
+    }
+    ok = ok && end - p >= 2;
+    const std::uint16_t check = ok ? LoadBe16(p) : 0;
+    p += ok ? 2 : 0;
+    if (ok && (ctl & kOptions))
+    {
+        ok = p != end && *p != 0 && *p % 4 == 0 && *p <= kMaxOptions && static_cast<std::size_t>(end - p) > *p;
+        opt  = ok ? *p : 0;
+        opts = p + 1;
+        p += ok ? 1 + opt : 0;
+    }
+    const std::size_t data  = static_cast<std::size_t>(end - p);
+    const std::size_t total = base->hlen + opt + data;
+    if (!ok || total > out_.size())
+    {
+        ++stats_.malformed;
+        return false;
+    }
+
+    std::uint8_t *o = out_.data();
+    std::memcpy(o, t, base->hlen);
+    if (opt != 0)
+    {
+        std::memcpy(o + base->hlen, opts, opt);
+    }
+    std::memcpy(o + base->hlen + opt, p, data);
+    std::uint8_t *l4 = o + ip_hl;
+    if (tcp)
+    {
+        l4[12] = static_cast<std::uint8_t>(l4[12] | ((Headers::Tcp::kMinSize + opt) / 4) << 4);
+        const Headers::Tcp seg{l4, total - ip_hl};
+        seg.SetSeq(ref.seq);
+        seg.SetAckSeq(ref.ack);
+        seg.SetFlags(flags);
+        seg.SetWindow(ref.window);
+        seg.SetCheck(check);
+        Headers::Store16(l4 + 18, urgent);
+    }
+    else
+    {
+        StoreBe16(l4 + 4, static_cast<std::uint16_t>(total - ip_hl));
+        StoreBe16(l4 + 6, check);
+    }
+    if (v6)
+    {
+        o[0] = static_cast<std::uint8_t>(o[0] | ref.tos >> 4);
+        o[1] = static_cast<std::uint8_t>(o[1] | ref.tos << 4);
+        StoreBe16(o + 4, static_cast<std::uint16_t>(total - ip_hl));
+    }
+    else
+    {
+        o[1] = ref.tos;
+        StoreBe16(o + 2, static_cast<std::uint16_t>(total));
+        const Headers::Ip4 ip{o, total};
+        ip.SetId(ref.id);
+        ip.FillCheck();
+    }
+
+    if (gen != 0)
+    {
+        // base может указывать в slot.cur, который Store перезапишет: шаблон — копией.
+        const std::array<std::uint8_t, HeaderCompressor::kMaxHeader> hdr = base->hdr;
+        Store(ctx, used, gen, hdr.data(), base->hlen, ref);
+    }
+
+    ++stats_.frames;
+    stats_.bytes_in  += len + CoreFrame::kHeaderSize;
+    stats_.bytes_out += total;
+    *pkt     = o;
+    *pkt_len = total;
+    return true;
+}
+
+std::size_t HeaderDecompressor::Poll(std::uint8_t *out,
+                                     std::size_t size) noexcept
+{
+    if (acks_.empty() || size < CoreFrame::kHeaderSize + 3)
+    {
+        return 0;
+    }
+    const std::size_t fit = std::min(acks_.size(), (std::min(size, CoreFrame::kHeaderSize + 0xFFFF) - CoreFrame::kHeaderSize) / 3);
+    std::uint8_t *p = out + CoreFrame::kHeaderSize;
+    for (std::size_t i = 0; i < fit; ++i, p += 3)
+    {
+        StoreBe16(p, acks_[i].first);
+        p[2] = acks_[i].second;
+    }
+    acks_.erase(acks_.begin(), acks_.begin() + static_cast<std::ptrdiff_t>(fit));
+    return CoreFrame::BuildHeader(CoreFrame::Type::HeaderAck, fit * 3, out) + fit * 3;
+}
+
+void HeaderDecompressor::Reset()
+{
+    slots_.clear();
+    acks_.clear();
+}
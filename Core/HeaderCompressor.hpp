@@ -0,0 +1,268 @@
+#pragma once
+// HeaderCompressor.hpp — сжатие заголовков IP/TCP/UDP по потокам (в духе ROHC): контекст потока и разности полей.
+
+#include "CoreFrame.hpp"
+#include "FlowTable.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Формат кадра CoreFrame::Type::Header (нагрузка):
+ *   [контекст BE16][опора][новая опора][...]
+ * Контекст — номер потока отправителя. Опора — поколение контекста, от
+ * которого отсчитаны разности (0 — контекст передаётся целиком: дальше весь
+ * IP-пакет без изменений). Новая опора — не 0: приёмник запоминает поля этого
+ * пакета под этим поколением и подтверждает его кадром HeaderAck
+ * ([контекст BE16][поколение]...). Поколения потока идут по кругу 1..255;
+ * приёмник принимает только опоры новее текущей (меньше чем на полкруга
+ * вперёд): опоздавший кадр не подменяет контекст и не подтверждается.
+ *
+ * Сжатый заголовок (опора не 0):
+ *   [ctl][IP-ID][TOS][seq][ack][окно BE16][urgent BE16][флаги TCP][сумма L4 BE16][опции TCP][нагрузка L4]
+ * Поля в скобках — только при своём бите ctl (флаги и сумма — всегда, у UDP
+ * только сумма); IP-ID, seq и ack — разности с опорой (LEB128), TOS (у IPv6 —
+ * класс трафика) — байт целиком, если отличается от опоры: биты ECN меняются
+ * от пакета к пакету и в контекст не входят. Длины, сумма заголовка IPv4 и
+ * неизменные поля (адреса, порты, TTL, метка потока) восстанавливаются из
+ * контекста.
+ *
+ * Как и словари Compressor, отправитель отсчитывает разности только от
+ * подтверждённой опоры: потеря любого кадра не портит контекст — опора просто
+ * не сменится, кадры вне очереди (многопутевость) разбираются независимо.
+ * Приёмник держит две опоры потока: новую и ту, которой отправитель
+ * пользуется до подтверждения. Сумма TCP/UDP переносится как есть: целостность
+ * «из конца в конец» сохраняется.
+ */
+
+/**
+ * @brief Сжатие заголовков IP-пакетов отправителя.
+ *
+ * На голосе (RTP по UDP, 20–160 байт нагрузки) и чистых ACK заголовки IP и
+ * TCP/UDP — треть и больше пакета. Неизменные поля потока (FlowTable по
+ * 5-tuple) уходят к приёмнику один раз, дальше — 6–12 байт вместо 28–60.
+ *
+ * Сжимаются IPv4 без опций и не фрагменты, IPv6 без расширений, с TCP или
+ * UDP; остальное уходит как есть. Кадр уходит, только если он короче пакета.
+ * Полный контекст (+8 байт к пакету) отправляется лишь на пакетах не длиннее
+ * ir_max: запас под MTU туннеля не расходуется на крупных пакетах.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class HeaderCompressor
+{
+public:
+    using Clock = FlowTable::Clock;
+
+    /// @brief Наибольший сжимаемый заголовок без опций TCP: IPv6 + TCP.
+    static constexpr std::size_t kMaxHeader = 60;
+
+    /// @brief Прибавка кадра с полным контекстом к пакету: заголовок кадра, контекст, поколения.
+    static constexpr std::size_t kContextOverhead = CoreFrame::kHeaderSize + 4;
+
+    /**
+     * @brief Параметры сжатия.
+     */
+    struct Options
+    {
+        /// @brief Наибольшее число потоков с контекстом (не больше 65536).
+        std::size_t flows = 1024;
+        /// @brief Новая опора предлагается раз в столько пакетов потока (раньше — если разности seq/ack
+        ///        вышли за 3 байта); каждая стоит приёмнику кадра HeaderAck в обратную сторону.
+        unsigned refresh = 64;
+        /// @brief Полный контекст — только на пакетах не длиннее.
+        std::size_t ir_max = 512;
+        /// @brief Простой, после которого поток (и его контекст) забывается.
+        std::chrono::milliseconds idle{60000};
+    };
+
+    /**
+     * @brief Счётчики сжатия.
+     */
+    struct Stats
+    {
+        std::uint64_t packets    = 0;   ///< Пакетов предъявлено.
+        std::uint64_t compressed = 0;   ///< Отправлено со сжатым заголовком.
+        std::uint64_t contexts   = 0;   ///< Отправлено с полным контекстом.
+        std::uint64_t skipped    = 0;   ///< Не сжимаемы (не TCP/UDP, фрагменты, опции IP, расширения IPv6).
+        std::uint64_t bytes_in   = 0;   ///< Байт пакетов.
+        std::uint64_t bytes_out  = 0;   ///< Байт на выходе.
+        std::uint64_t refs       = 0;   ///< Опор предложено (с контекстами).
+        std::uint64_t acks       = 0;   ///< Из них подтверждено.
+    };
+
+    /**
+     * @brief Создать компрессор (вся память выделяется здесь).
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    explicit HeaderCompressor(const Options &opts);
+
+    HeaderCompressor(const HeaderCompressor &) = delete;
+    HeaderCompressor &operator=(const HeaderCompressor &) = delete;
+
+    /**
+     * @brief Сжать заголовок IP-пакета на месте.
+     * @param buf  Пакет; при сжатии — кадр Header.
+     * @param len  Длина пакета.
+     * @param size Ёмкость buf.
+     * @return Длина кадра или len (пакет оставлен как есть).
+     */
+    std::size_t Compress(std::uint8_t *buf, std::size_t len, std::size_t size, Clock::time_point now) noexcept;
+
+    /**
+     * @brief Нагрузка кадра HeaderAck от приёмника.
+     */
+    void OnAck(const std::uint8_t *payload, std::size_t len) noexcept;
+
+    /**
+     * @brief Новое соединение: потоки и контексты забываются.
+     */
+    void Reset();
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+    /**
+     * @brief Изменяемые поля заголовка — разности отсчитываются от них.
+     */
+    struct Ref
+    {
+        std::uint16_t id     = 0;   ///< IP-ID (IPv4).
+        std::uint16_t window = 0;
+        std::uint32_t seq    = 0;
+        std::uint32_t ack    = 0;
+        std::uint8_t  tos    = 0;   ///< TOS (IPv4) или класс трафика (IPv6): DSCP и ECN.
+    };
+
+private:
+    /**
+     * @brief Состояние потока.
+     */
+    struct Flow
+    {
+        std::array<std::uint8_t, kMaxHeader> hdr{};   ///< Неизменные поля (изменяемые обнулены).
+        std::uint8_t  hlen        = 0;                ///< 0 — контекста нет.
+        std::uint8_t  acked_gen   = 0;                ///< 0 — опоры нет.
+        std::uint8_t  pending_gen = 0;
+        std::uint8_t  gen         = 0;                ///< Последнее выданное поколение (1..255).
+        unsigned      since       = 0;                ///< Пакетов с последнего предложения.
+        Ref           acked;
+        Ref           pending;
+    };
+
+    Options           opts_;
+    FlowTable         table_;
+    std::vector<Flow> flows_;
+    Stats             stats_;
+
+    /// @brief Забыть опоры потока (поколение сохраняется).
+    static void Clear(Flow &f) noexcept;
+
+    /// @brief Следующее поколение потока.
+    static std::uint8_t NextGen(Flow &f) noexcept;
+};
+
+/**
+ * @brief Восстановление заголовков кадров Header приёмника и подтверждение опор.
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class HeaderDecompressor
+{
+public:
+    /**
+     * @brief Параметры приёмника.
+     */
+    struct Options
+    {
+        /// @brief Наибольший восстановленный пакет.
+        std::size_t mtu = 1500;
+        /// @brief Наибольшее число потоков с контекстом (сверх — не подтверждаются: отправитель шлёт их как есть).
+        std::size_t flows = 4096;
+    };
+
+    /**
+     * @brief Счётчики приёмника.
+     */
+    struct Stats
+    {
+        std::uint64_t frames     = 0;   ///< Пакетов восстановлено (с контекстами).
+        std::uint64_t contexts   = 0;   ///< Полных контекстов принято.
+        std::uint64_t bytes_in   = 0;   ///< Байт кадров.
+        std::uint64_t bytes_out  = 0;   ///< Байт пакетов.
+        std::uint64_t no_context = 0;   ///< Кадров с неизвестной опорой (отброшены).
+        std::uint64_t stale      = 0;   ///< Опор не новее текущей (опоздали; не приняты).
+        std::uint64_t malformed  = 0;   ///< Испорченных кадров.
+    };
+
+    /**
+     * @throw std::invalid_argument Некорректные Options.
+     */
+    explicit HeaderDecompressor(const Options &opts);
+
+    HeaderDecompressor(const HeaderDecompressor &) = delete;
+    HeaderDecompressor &operator=(const HeaderDecompressor &) = delete;
+
+    /**
+     * @brief Восстановить пакет из нагрузки кадра Header.
+     * @param pkt     Пакет: в нагрузке (полный контекст) или во внутреннем буфере;
+     *                действителен, пока жива нагрузка и до следующего вызова.
+     * @param pkt_len Его длина.
+     * @return false — кадр отброшен.
+     */
+    bool Decompress(const std::uint8_t *payload, std::size_t len,
+                    const std::uint8_t **pkt, std::size_t *pkt_len) noexcept;
+
+    /**
+     * @brief Кадр HeaderAck с накопленными подтверждениями.
+     * @return Длина кадра в out; 0 — подтверждать нечего.
+     */
+    std::size_t Poll(std::uint8_t *out, std::size_t size) noexcept;
+
+    /** @brief Есть ли неотправленные подтверждения. */
+    bool Pending() const noexcept { return !acks_.empty(); }
+
+    /**
+     * @brief Новое соединение: контексты забываются.
+     */
+    void Reset();
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+private:
+    /**
+     * @brief Опора: неизменные поля и изменяемые поля одного пакета.
+     */
+    struct Context
+    {
+        std::array<std::uint8_t, HeaderCompressor::kMaxHeader> hdr{};
+        std::uint8_t          hlen = 0;
+        std::uint8_t          gen  = 0;   ///< 0 — пусто.
+        HeaderCompressor::Ref ref;
+    };
+
+    /**
+     * @brief Опоры потока отправителя.
+     */
+    struct Slot
+    {
+        Context cur;
+        Context prev;
+    };
+
+    Options                                              opts_;
+    std::unordered_map<std::uint16_t, Slot>              slots_;
+    std::vector<std::pair<std::uint16_t, std::uint8_t>>  acks_;   ///< (контекст, поколение).
+    std::vector<std::uint8_t>                            out_;    ///< Восстановленный пакет.
+    Stats                                                stats_;
+
+    /// @brief Запомнить опору gen потока ctx (used — опора, которой сжат пакет) и подтвердить её.
+    void Store(std::uint16_t ctx, std::uint8_t used, std::uint8_t gen,
+               const std::uint8_t *hdr, std::size_t hlen, const HeaderCompressor::Ref &ref) noexcept;
+};
@@ -0,0 +1,372 @@
+#pragma once
+// Headers.hpp — виды заголовков IPv4/IPv6/TCP/UDP поверх буфера пакета: чтение и правка полей с проверкой границ.
+
+#include "Checksum.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Вид — указатель на заголовок внутри чужого буфера. Конструктор проверяет,
+ * что заголовок (и длина из него) помещается в len; неразобранный вид пуст
+ * (operator bool == false), и обращаться к его полям нельзя. После разбора
+ * поля читаются без проверок. Вид над const-буфером только читает, над
+ * изменяемым — ещё и пишет (Set*). Всё constexpr: разбор и правка заголовков
+ * проверяются на этапе компиляции.
+ */
+namespace Headers
+{
+    constexpr std::uint8_t kProtoTcp = 6;
+    constexpr std::uint8_t kProtoUdp = 17;
+
+    constexpr std::uint16_t Load16(const std::uint8_t *p) noexcept
+    {
+        return static_cast<std::uint16_t>(p[0] << 8 | p[1]);
+    }
+
+    constexpr std::uint32_t Load32(const std::uint8_t *p) noexcept
+    {
+        return static_cast<std::uint32_t>(p[0]) << 24 | static_cast<std::uint32_t>(p[1]) << 16 |
+               static_cast<std::uint32_t>(p[2]) << 8 | p[3];
+    }
+
+    constexpr void Store16(std::uint8_t *p, std::uint16_t v) noexcept
+    {
+        p[0] = static_cast<std::uint8_t>(v >> 8);
+        p[1] = static_cast<std::uint8_t>(v);
+    }
+
+    constexpr void Store32(std::uint8_t *p, std::uint32_t v) noexcept
+    {
+        p[0] = static_cast<std::uint8_t>(v >> 24);
+        p[1] = static_cast<std::uint8_t>(v >> 16);
+        p[2] = static_cast<std::uint8_t>(v >> 8);
+        p[3] = static_cast<std::uint8_t>(v);
+    }
+
+    /**
+     * @brief Заголовок IPv4: версия 4, 20 <= IHL * 4 <= total length <= len.
+     */
+    template <typename Byte>
+    class Ip4View
+    {
+        static_assert(std::is_same_v<std::remove_const_t<Byte>, std::uint8_t>);
+        static constexpr bool kMutable = !std::is_const_v<Byte>;
+
+    public:
+        static constexpr std::size_t kMinSize = 20;
+
+        constexpr Ip4View() noexcept = default;
+
+        constexpr Ip4View(Byte *pkt, std::size_t len) noexcept
+        {
+            if (pkt != nullptr && len >= kMinSize && (pkt[0] >> 4) == 4)
+            {
+                const std::size_t hl = static_cast<std::size_t>(pkt[0] & 0x0F) * 4;
+                const std::size_t tl = Load16(pkt + 2);
+                if (hl >= kMinSize && hl <= tl && tl <= len)
+                {
+                    p_ = pkt;
+                }
+            }
+        }
+
+        constexpr explicit operator bool() const noexcept { return p_ != nullptr; }
+        constexpr Byte *Data() const noexcept { return p_; }
+
+        constexpr std::size_t   HeaderSize() const noexcept { return static_cast<std::size_t>(p_[0] & 0x0F) * 4; }
+        constexpr std::size_t   TotalLength() const noexcept { return Load16(p_ + 2); }
+        constexpr std::uint8_t  Tos() const noexcept { return p_[1]; }
+        constexpr std::uint16_t Id() const noexcept { return Load16(p_ + 4); }
+        constexpr bool          DontFragment() const noexcept { return (p_[6] & 0x40) != 0; }
+        /** @brief Фрагмент: MF или ненулевое смещение. */
+        constexpr bool          IsFragment() const noexcept { return (Load16(p_ + 6) & 0x3FFF) != 0; }
+        constexpr std::uint8_t  Ttl() const noexcept { return p_[8]; }
+        constexpr std::uint8_t  Protocol() const noexcept { return p_[9]; }
+        constexpr std::uint16_t Check() const noexcept { return Load16(p_ + 10); }
+        constexpr std::uint32_t Src() const noexcept { return Load32(p_ + 12); }
+        constexpr std::uint32_t Dst() const noexcept { return Load32(p_ + 16); }
+
+        /** @brief Заголовок L4 и его длина с данными (по total length). */
+        constexpr Byte       *L4() const noexcept { return p_ + HeaderSize(); }
+        constexpr std::size_t L4Size() const noexcept { return TotalLength() - HeaderSize(); }
+
+        /** @brief Сходится ли сумма заголовка. */
+        constexpr bool CheckValid() const noexcept { return Checksum::Reference(p_, HeaderSize()) == 0xFFFF; }
+
+        /** @brief Сумма псевдозаголовка для L4 длиной l4_len. */
+        constexpr std::uint32_t Pseudo(std::size_t l4_len) const noexcept { return Checksum::Pseudo(p_, Protocol(), l4_len); }
+
+        constexpr void SetTotalLength(std::uint16_t v) const noexcept requires kMutable { Store16(p_ + 2, v); }
+        constexpr void SetId(std::uint16_t v) const noexcept requires kMutable { Store16(p_ + 4, v); }
+        constexpr void SetTtl(std::uint8_t v) const noexcept requires kMutable { p_[8] = v; }
+        constexpr void SetSrc(std::uint32_t v) const noexcept requires kMutable { Store32(p_ + 12, v); }
+        constexpr void SetDst(std::uint32_t v) const noexcept requires kMutable { Store32(p_ + 16, v); }
+
+        /** @brief Пересчитать сумму заголовка целиком. */
+        constexpr void FillCheck() const noexcept requires kMutable
+        {
+            p_[10] = 0;
+            p_[11] = 0;
+            Store16(p_ + 10, Checksum::Finish(Checksum::Reference(p_, HeaderSize())));
+        }
+
+    private:
+        Byte *p_ = nullptr;
+    };
+
+    /**
+     * @brief Фиксированный заголовок IPv6: версия 6, 40 + payload length <= len.
+     *        Цепочка расширений не разбирается: L4 — сразу за заголовком, если NextHeader — TCP/UDP.
+     */
+    template <typename Byte>
+    class Ip6View
+    {
+        static_assert(std::is_same_v<std::remove_const_t<Byte>, std::uint8_t>);
+        static constexpr bool kMutable = !std::is_const_v<Byte>;
+
+    public:
+        static constexpr std::size_t kSize = 40;
+
+        constexpr Ip6View() noexcept = default;
+
+        constexpr Ip6View(Byte *pkt, std::size_t len) noexcept
+        {
+            if (pkt != nullptr && len >= kSize && (pkt[0] >> 4) == 6 && kSize + Load16(pkt + 4) <= len)
+            {
+                p_ = pkt;
+            }
+        }
+
+        constexpr explicit operator bool() const noexcept { return p_ != nullptr; }
+        constexpr Byte *Data() const noexcept { return p_; }
+
+        constexpr std::uint8_t  TrafficClass() const noexcept { return static_cast<std::uint8_t>(Load16(p_) >> 4); }
+        constexpr std::uint32_t FlowLabel() const noexcept { return Load32(p_) & 0xFFFFF; }
+        constexpr std::size_t   PayloadLength() const noexcept { return Load16(p_ + 4); }
+        constexpr std::uint8_t  NextHeader() const noexcept { return p_[6]; }
+        constexpr std::uint8_t  HopLimit() const noexcept { return p_[7]; }
+        /** @brief Адреса: 16 байт. */
+        constexpr Byte *Src() const noexcept { return p_ + 8; }
+        constexpr Byte *Dst() const noexcept { return p_ + 24; }
+
+        constexpr Byte       *L4() const noexcept { return p_ + kSize; }
+        constexpr std::size_t L4Size() const noexcept { return PayloadLength(); }
+
+        constexpr std::uint32_t Pseudo(std::size_t l4_len) const noexcept { return Checksum::Pseudo(p_, NextHeader(), l4_len); }
+
+        constexpr void SetPayloadLength(std::uint16_t v) const noexcept requires kMutable { Store16(p_ + 4, v); }
+        constexpr void SetHopLimit(std::uint8_t v) const noexcept requires kMutable { p_[7] = v; }
+
+    private:
+        Byte *p_ = nullptr;
+    };
+
+    /**
+     * @brief Заголовок TCP: 20 <= data offset * 4 <= len; len — сегмент с данными.
+     */
+    template <typename Byte>
+    class TcpView
+    {
+        static_assert(std::is_same_v<std::remove_const_t<Byte>, std::uint8_t>);
+        static constexpr bool kMutable = !std::is_const_v<Byte>;
+
+    public:
+        static constexpr std::size_t kMinSize = 20;
+
+        static constexpr std::uint8_t kFin = 0x01;
+        static constexpr std::uint8_t kSyn = 0x02;
+        static constexpr std::uint8_t kRst = 0x04;
+        static constexpr std::uint8_t kPsh = 0x08;
+        static constexpr std::uint8_t kAck = 0x10;
+        static constexpr std::uint8_t kUrg = 0x20;
+        static constexpr std::uint8_t kEce = 0x40;
+        static constexpr std::uint8_t kCwr = 0x80;
+
+        static constexpr std::uint8_t kOptEnd = 0;
+        static constexpr std::uint8_t kOptNop = 1;
+        static constexpr std::uint8_t kOptMss = 2;
+
+        constexpr TcpView() noexcept = default;
+
+        constexpr TcpView(Byte *seg, std::size_t len) noexcept
+        {
+            if (seg != nullptr && len >= kMinSize && (seg[12] >> 4) >= 5 &&
+                static_cast<std::size_t>(seg[12] >> 4) * 4 <= len)
+            {
+                p_   = seg;
+                len_ = len;
+            }
+        }
+
+        constexpr explicit operator bool() const noexcept { return p_ != nullptr; }
+        constexpr Byte *Data() const noexcept { return p_; }
+        constexpr std::size_t Size() const noexcept { return len_; }
+
+        constexpr std::uint16_t SrcPort() const noexcept { return Load16(p_); }
+        constexpr std::uint16_t DstPort() const noexcept { return Load16(p_ + 2); }
+        constexpr std::uint32_t Seq() const noexcept { return Load32(p_ + 4); }
+        constexpr std::uint32_t AckSeq() const noexcept { return Load32(p_ + 8); }
+        constexpr std::size_t   HeaderSize() const noexcept { return static_cast<std::size_t>(p_[12] >> 4) * 4; }
+        constexpr std::uint8_t  Flags() const noexcept { return p_[13]; }
+        constexpr std::uint16_t Window() const noexcept { return Load16(p_ + 14); }
+        constexpr std::uint16_t Check() const noexcept { return Load16(p_ + 16); }
+        constexpr std::uint16_t Urgent() const noexcept { return Load16(p_ + 18); }
+
+        constexpr Byte       *Payload() const noexcept { return p_ + HeaderSize(); }
+        constexpr std::size_t PayloadSize() const noexcept { return len_ - HeaderSize(); }
+
+        /**
+         * @brief Опция kind: указатель на её первый байт (kind), *size — её длина.
+         * @return nullptr — опции нет или список опций испорчен.
+         */
+        constexpr Byte *Option(std::uint8_t kind, std::size_t *size = nullptr) const noexcept
+        {
+            const std::size_t end = HeaderSize();
+            for (std::size_t i = kMinSize; i < end;)
+            {
+                if (p_[i] == kOptEnd)
+                {
+                    return nullptr;
+                }
+                if (p_[i] == kOptNop)
+                {
+                    ++i;
+                    continue;
+                }
+                if (i + 1 >= end || p_[i + 1] < 2 || i + p_[i + 1] > end)
+                {
+                    return nullptr;
+                }
+                if (p_[i] == kind)
+                {
+                    if (size != nullptr)
+                    {
+                        *size = p_[i + 1];
+                    }
+                    return p_ + i;
+                }
+                i += p_[i + 1];
+            }
+            return nullptr;
+        }
+
+        /** @brief Значение опции MSS (0 — нет). */
+        constexpr std::uint16_t Mss() const noexcept
+        {
+            std::size_t size = 0;
+            const Byte *opt = Option(kOptMss, &size);
+            return opt != nullptr && size == 4 ? Load16(opt + 2) : 0;
+        }
+
+        constexpr void SetSeq(std::uint32_t v) const noexcept requires kMutable { Store32(p_ + 4, v); }
+        constexpr void SetAckSeq(std::uint32_t v) const noexcept requires kMutable { Store32(p_ + 8, v); }
+        constexpr void SetFlags(std::uint8_t v) const noexcept requires kMutable { p_[13] = v; }
+        constexpr void SetWindow(std::uint16_t v) const noexcept requires kMutable { Store16(p_ + 14, v); }
+        constexpr void SetCheck(std::uint16_t v) const noexcept requires kMutable { Store16(p_ + 16, v); }
+
+        /**
+         * @brief Ограничить MSS значением limit; сумма правится инкрементально.
+         * @return true — опция была больше limit и уменьшена.
+         */
+        constexpr bool ClampMss(std::uint16_t limit) const noexcept requires kMutable
+        {
+            std::size_t size = 0;
+            Byte *opt = Option(kOptMss, &size);
+            if (opt == nullptr || size != 4 || Load16(opt + 2) <= limit)
+            {
+                return false;
+            }
+            // Опция может лежать с нечётного смещения: правится слово, в которое попали её байты.
+            const std::size_t off = static_cast<std::size_t>(opt + 2 - p_);
+            if (off % 2 == 0)
+            {
+                SetCheck(Checksum::Update16(Check(), Load16(opt + 2), limit));
+                Store16(opt + 2, limit);
+            }
+            else
+            {
+                std::uint8_t before[4] = {p_[off - 1], p_[off], p_[off + 1], p_[off + 2]};
+                Store16(opt + 2, limit);
+                const std::uint8_t after[4] = {p_[off - 1], p_[off], p_[off + 1], p_[off + 2]};
+                SetCheck(Checksum::UpdateBytes(Check(), before, after, 4));
+            }
+            return true;
+        }
+
+        /** @brief Пересчитать сумму целиком (pseudo — сумма псевдозаголовка для Size()). */
+        void FillCheck(std::uint32_t pseudo) const noexcept requires kMutable
+        {
+            p_[16] = 0;
+            p_[17] = 0;
+            SetCheck(Checksum::Finish(Checksum::Sum(p_, len_, pseudo)));
+        }
+
+        /** @brief Сходится ли сумма сегмента. */
+        bool CheckValid(std::uint32_t pseudo) const noexcept { return Checksum::Sum(p_, len_, pseudo) == 0xFFFF; }
+
+    private:
+        Byte       *p_ = nullptr;
+        std::size_t len_ = 0;
+    };
+
+    /**
+     * @brief Заголовок UDP: 8 <= length <= len.
+     */
+    template <typename Byte>
+    class UdpView
+    {
+        static_assert(std::is_same_v<std::remove_const_t<Byte>, std::uint8_t>);
+        static constexpr bool kMutable = !std::is_const_v<Byte>;
+
+    public:
+        static constexpr std::size_t kSize = 8;
+
+        constexpr UdpView() noexcept = default;
+
+        constexpr UdpView(Byte *dgram, std::size_t len) noexcept
+        {
+            if (dgram != nullptr && len >= kSize && Load16(dgram + 4) >= kSize && Load16(dgram + 4) <= len)
+            {
+                p_ = dgram;
+            }
+        }
+
+        constexpr explicit operator bool() const noexcept { return p_ != nullptr; }
+        constexpr Byte *Data() const noexcept { return p_; }
+
+        constexpr std::uint16_t SrcPort() const noexcept { return Load16(p_); }
+        constexpr std::uint16_t DstPort() const noexcept { return Load16(p_ + 2); }
+        constexpr std::size_t   Length() const noexcept { return Load16(p_ + 4); }
+        constexpr std::uint16_t Check() const noexcept { return Load16(p_ + 6); }
+
+        constexpr Byte       *Payload() const noexcept { return p_ + kSize; }
+        constexpr std::size_t PayloadSize() const noexcept { return Length() - kSize; }
+
+        constexpr void SetLength(std::uint16_t v) const noexcept requires kMutable { Store16(p_ + 4, v); }
+        constexpr void SetCheck(std::uint16_t v) const noexcept requires kMutable { Store16(p_ + 6, v); }
+
+        /** @brief Пересчитать сумму целиком (нулевая передаётся как 0xFFFF: 0 — «суммы нет»). */
+        void FillCheck(std::uint32_t pseudo) const noexcept requires kMutable
+        {
+            p_[6] = 0;
+            p_[7] = 0;
+            const std::uint16_t c = Checksum::Finish(Checksum::Sum(p_, Length(), pseudo));
+            SetCheck(c == 0 ? 0xFFFF : c);
+        }
+
+    private:
+        Byte *p_ = nullptr;
+    };
+
+    using Ip4 = Ip4View<std::uint8_t>;
+    using Ip6 = Ip6View<std::uint8_t>;
+    using Tcp = TcpView<std::uint8_t>;
+    using Udp = UdpView<std::uint8_t>;
+
+    using ConstIp4 = Ip4View<const std::uint8_t>;
+    using ConstIp6 = Ip6View<const std::uint8_t>;
+    using ConstTcp = TcpView<const std::uint8_t>;
+    using ConstUdp = UdpView<const std::uint8_t>;
+}
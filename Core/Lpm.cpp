@@ -0,0 +1,496 @@
+// Lpm.cpp — построение Poptrie из списка префиксов, поиск и RCU-замена таблицы.
+
+#include "Lpm.hpp"
+
+#include "PacketMeta.hpp"
+#include "Rcu.hpp"
+#include "Core/Logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define LPM_PREFETCH(p) _mm_prefetch(reinterpret_cast<const char *>(p), _MM_HINT_T0)
+#elif defined(__GNUC__)
+#define LPM_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define LPM_PREFETCH(p) ((void)(p))
+#endif
+
+namespace
+{
+    /// @brief Элемент прямой таблицы — лист, а не номер узла.
+    constexpr std::uint32_t kLeaf = 0x80000000u;
+
+    /// @brief Шаг узла: 2^6 потомков — по биту в 64-битных масках.
+    constexpr unsigned kStride = 6;
+
+    /// @brief Пакетов, спускающихся в LookupBatch одновременно.
+    constexpr std::size_t kGroup = 16;
+
+    inline std::uint64_t LoadBe64(const std::uint8_t *p) noexcept
+    {
+        return (std::uint64_t{p[0]} << 56) | (std::uint64_t{p[1]} << 48) | (std::uint64_t{p[2]} << 40) |
+               (std::uint64_t{p[3]} << 32) | (std::uint64_t{p[4]} << 24) | (std::uint64_t{p[5]} << 16) |
+               (std::uint64_t{p[6]} << 8)  |  std::uint64_t{p[7]};
+    }
+
+    /// @brief width (<= 63) бит 128-битного ключа, начиная с бита depth (за концом ключа — нули).
+    inline std::size_t Bits(std::uint64_t hi,
+                            std::uint64_t lo,
+                            unsigned depth,
+                            unsigned width) noexcept
+    {
+        std::uint64_t top;
+        if (depth == 0)
+        {
+            top = hi;
+        }
+        else if (depth < 64)
+        {
+            top = hi << depth | lo >> (64 - depth);
+        }
+        else if (depth < 128)
+        {
+            top = lo << (depth - 64);
+        }
+        else
+        {
+            top = 0;
+        }
+        return static_cast<std::size_t>(top >> (64 - width));
+    }
+
+    /// @brief Обнулить биты за первыми len.
+    inline void Mask(std::uint64_t &hi,
+                     std::uint64_t &lo,
+                     unsigned len) noexcept
+    {
+        hi &= len == 0 ? 0 : (len >= 64 ? ~std::uint64_t{0} : ~std::uint64_t{0} << (64 - len));
+        lo &= len <= 64 ? 0 : (len >= 128 ? ~std::uint64_t{0} : ~std::uint64_t{0} << (128 - len));
+    }
+
+    /// @brief ::ffff:0:0 — начало пространства IPv4-mapped.
+    constexpr std::uint64_t kMappedLo = std::uint64_t{0xFFFF} << 32;
+}
+
+struct Lpm::Item
+{
+    std::uint64_t hi   = 0;
+    std::uint64_t lo   = 0;
+    unsigned      len  = 0;   ///< Длина в ключе дерева.
+    unsigned      rank = 0;   ///< Длина в 128-битном пространстве: у покрывающих IPv4 префиксов IPv6 — своя.
+    std::uint32_t leaf = 0;
+};
+
+namespace
+{
+    /**
+     * @brief Разложить префиксы [lo, hi) области по 2^width кускам следующего уровня.
+     *
+     * val — лист куска (самый длинный префикс не длиннее depth + width, иначе def);
+     * [from, to) — префиксы длиннее depth + width в куске (пусто — кусок лист).
+     * Префиксы отсортированы по (ключ, длина): короткие лежат в начале своего
+     * куска, длинные одного куска идут подряд.
+     */
+    template <typename ItemT>
+    void Split(const ItemT *items,
+               std::size_t lo,
+               std::size_t hi,
+               unsigned depth,
+               unsigned width,
+               std::uint32_t def,
+               std::uint32_t *val,
+               unsigned *rank,
+               std::size_t *from,
+               std::size_t *to)
+    {
+        const std::size_t n = std::size_t{1} << width;
+        std::fill_n(val, n, def);
+        std::fill_n(rank, n, 0u);
+        std::fill_n(from, n, std::size_t{0});
+        std::fill_n(to, n, std::size_t{0});
+        for (std::size_t i = lo; i < hi; ++i)
+        {
+            const ItemT &it = items[i];
+            const std::size_t c = Bits(it.hi, it.lo, depth, width);
+            if (it.len <= depth + width)
+            {
+                // Префикс длиннее def: перекрывает его; равные — последний по порядку.
+                const std::size_t span = std::size_t{1} << (depth + width - it.len);
+                for (std::size_t j = c; j < c + span; ++j)
+                {
+                    if (it.rank >= rank[j])
+                    {
+                        val[j]  = it.leaf;
+                        rank[j] = it.rank;
+                    }
+                }
+            }
+            else
+            {
+                if (from[c] == to[c])
+                {
+                    from[c] = i;
+                }
+                to[c] = i + 1;
+            }
+        }
+    }
+
+    void CheckIndex(std::size_t size)
+    {
+        if (size >= kLeaf)
+        {
+            throw std::invalid_argument("Lpm: table too large");
+        }
+    }
+}
+
+Lpm::Lpm(const std::vector<Route> &routes)
+    : size_(routes.size())
+{
+    v4_.direct_bits = kDirect4;
+    v6_.direct_bits = kDirect6;
+    std::vector<Item> items4, items6;
+    for (std::size_t i = 0; i < routes.size(); ++i)
+    {
+        const Route &r = routes[i];
+        if (r.prefix.len > 128 || r.target > kMaxTarget)
+        {
+            throw std::invalid_argument("Lpm: invalid route " + std::to_string(i));
+        }
+        std::uint64_t hi = LoadBe64(r.prefix.addr.data());
+        std::uint64_t lo = LoadBe64(r.prefix.addr.data() + 8);
+        Mask(hi, lo, r.prefix.len);
+        const std::uint32_t leaf = r.target + 1;
+        if (r.prefix.len >= 96 && hi == 0 && (lo >> 32) == 0xFFFF)
+        {
+            // IPv4: ключ — адрес в старших 32 битах.
+            items4.push_back({lo << 32, 0, r.prefix.len - 96, r.prefix.len, leaf});
+            continue;
+        }
+        if (r.prefix.len < 96)
+        {
+            std::uint64_t mhi = 0;
+            std::uint64_t mlo = kMappedLo;
+            Mask(mhi, mlo, r.prefix.len);
+            if (mhi == hi && mlo == lo)
+            {
+                // Покрывает всё IPv4: /0 в дереве IPv4 со своей длиной как приоритетом.
+                items4.push_back({0, 0, 0, r.prefix.len, leaf});
+            }
+        }
+        items6.push_back({hi, lo, r.prefix.len, r.prefix.len, leaf});
+    }
+    Build(v4_, items4);
+    Build(v6_, items6);
+}
+
+void Lpm::Build(Trie &t,
+                std::vector<Item> &items)
+{
+    // Устойчиво: у одинаковых префиксов последний по порядку перекрывает прежние.
+    std::stable_sort(items.begin(), items.end(), [](const Item &a, const Item &b)
+    {
+        return std::tie(a.hi, a.lo, a.len) < std::tie(b.hi, b.lo, b.len);
+    });
+    const std::size_t n = std::size_t{1} << t.direct_bits;
+    std::vector<std::uint32_t> val(n);
+    std::vector<unsigned>      rank(n);
+    std::vector<std::size_t>   from(n), to(n);
+    Split(items.data(), 0, items.size(), 0, t.direct_bits, 0, val.data(), rank.data(), from.data(), to.data());
+    t.direct.assign(n, 0);
+    for (std::size_t s = 0; s < n; ++s)
+    {
+        if (from[s] == to[s])
+        {
+            t.direct[s] = kLeaf | val[s];
+            continue;
+        }
+        const std::size_t node = t.nodes.size();
+        CheckIndex(node);
+        t.nodes.emplace_back();
+        Fill(t, items, node, from[s], to[s], t.direct_bits, val[s]);
+        t.direct[s] = static_cast<std::uint32_t>(node);
+    }
+    t.nodes.shrink_to_fit();
+    t.leaves.shrink_to_fit();
+}
+
+void Lpm::Fill(Trie &t,
+               const std::vector<Item> &items,
+               std::size_t node,
+               std::size_t lo,
+               std::size_t hi,
+               unsigned depth,
+               std::uint32_t def)
+{
+    constexpr std::size_t kChildren = std::size_t{1} << kStride;
+    std::array<std::uint32_t, kChildren> val;
+    std::array<unsigned, kChildren>      rank;
+    std::array<std::size_t, kChildren>   from, to;
+    Split(items.data(), lo, hi, depth, kStride, def, val.data(), rank.data(), from.data(), to.data());
+
+    Node n;
+    for (std::size_t c = 0; c < kChildren; ++c)
+    {
+        if (from[c] != to[c])
+        {
+            n.vector |= std::uint64_t{1} << c;
+        }
+    }
+    CheckIndex(t.leaves.size() + kChildren);
+    n.base0 = static_cast<std::uint32_t>(t.leaves.size());
+    for (std::size_t c = 0; c < kChildren; ++c)
+    {
+        if ((n.vector >> c & 1) != 0)
+        {
+            continue;
+        }
+        // Новая серия — первый лист узла или лист, отличный от предыдущего (узлы между ними не в счёт).
+        if (t.leaves.size() == n.base0 || t.leaves.back() != val[c])
+        {
+            n.leafvec |= std::uint64_t{1} << c;
+            t.leaves.push_back(val[c]);
+        }
+    }
+    const std::size_t children = static_cast<std::size_t>(std::popcount(n.vector));
+    CheckIndex(t.nodes.size() + children);
+    n.base1 = static_cast<std::uint32_t>(t.nodes.size());
+    t.nodes.resize(t.nodes.size() + children);
+    t.nodes[node] = n;
+
+    std::size_t k = n.base1;
+    for (std::size_t c = 0; c < kChildren; ++c)
+    {
+        if (from[c] != to[c])
+        {
+            Fill(t, items, k++, from[c], to[c], depth + kStride, val[c]);
+        }
+    }
+}
+
+bool Lpm::Trie::Step(std::uint32_t &e,
+                     unsigned &depth,
+                     std::uint64_t hi,
+                     std::uint64_t lo) const noexcept
+{
+    const Node &n = nodes[e];
+    const std::uint64_t bit  = std::uint64_t{1} << Bits(hi, lo, depth, kStride);
+    const std::uint64_t upto = bit | (bit - 1);
+    if ((n.vector & bit) == 0)
+    {
+        e = n.base0 + static_cast<std::uint32_t>(std::popcount(n.leafvec & upto)) - 1;
+        return false;
+    }
+    e = n.base1 + static_cast<std::uint32_t>(std::popcount(n.vector & upto)) - 1;
+    depth += kStride;
+    return true;
+}
+
+std::uint32_t Lpm::Trie::Find(std::uint64_t hi,
+                              std::uint64_t lo) const noexcept
+{
+    std::uint32_t e = direct[Slot(hi)];
+    if ((e & kLeaf) != 0)
+    {
+        return e & ~kLeaf;
+    }
+    unsigned depth = direct_bits;
+    while (Step(e, depth, hi, lo))
+    {
+    }
+    return leaves[e];
+}
+
+unsigned Lpm::Lookup(const std::uint8_t *addr,
+                     unsigned fallback) const noexcept
+{
+    const std::uint64_t hi = LoadBe64(addr);
+    const std::uint64_t lo = LoadBe64(addr + 8);
+    const std::uint32_t leaf = hi == 0 && (lo >> 32) == 0xFFFF ? v4_.Find(lo << 32, 0) : v6_.Find(hi, lo);
+    return leaf == 0 ? fallback : leaf - 1;
+}
+
+unsigned Lpm::Lookup4(std::uint32_t addr,
+                      unsigned fallback) const noexcept
+{
+    const std::uint32_t leaf = v4_.Find(std::uint64_t{addr} << 32, 0);
+    return leaf == 0 ? fallback : leaf - 1;
+}
+
+unsigned Lpm::Lookup(const PacketMeta &meta,
+                     std::size_t i,
+                     unsigned fallback) const noexcept
+{
+    return meta.Ip(i) ? Lookup(meta.Dst(i), fallback) : fallback;
+}
+
+void Lpm::LookupBatch(const PacketMeta &meta,
+                      unsigned fallback,
+                      unsigned *out) const noexcept
+{
+    // Спуск группы пакетов в ногу: на каждом уровне сначала подгружаются
+    // узлы всех пакетов группы, потом читаются. Промахи кэша по большой
+    // таблице идут параллельно, а не друг за другом, как у Lookup в цикле.
+    struct Lane
+    {
+        const Trie   *trie;
+        std::uint64_t hi;
+        std::uint64_t lo;
+        std::uint32_t e;
+        unsigned      depth;
+        bool          node;
+    };
+    std::array<Lane, kGroup> lanes;
+    const std::size_t size = meta.Size();
+    for (std::size_t base = 0; base < size; base += kGroup)
+    {
+        const std::size_t n = std::min(kGroup, size - base);
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            Lane &l = lanes[j];
+            if (!meta.Ip(base + j))
+            {
+                l.trie = nullptr;
+                continue;
+            }
+            const std::uint8_t *addr = meta.Dst(base + j);
+            l.hi = LoadBe64(addr);
+            l.lo = LoadBe64(addr + 8);
+            l.trie = &v6_;
+            if (l.hi == 0 && (l.lo >> 32) == 0xFFFF)
+            {
+                l.trie = &v4_;
+                l.hi   = l.lo << 32;
+                l.lo   = 0;
+            }
+            LPM_PREFETCH(&l.trie->direct[l.trie->Slot(l.hi)]);
+        }
+        bool pending = false;
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            Lane &l = lanes[j];
+            if (l.trie == nullptr)
+            {
+                continue;
+            }
+            l.e     = l.trie->direct[l.trie->Slot(l.hi)];
+            l.depth = l.trie->direct_bits;
+            l.node  = (l.e & kLeaf) == 0;
+            if (l.node)
+            {
+                LPM_PREFETCH(&l.trie->nodes[l.e]);
+                pending = true;
+            }
+        }
+        while (pending)
+        {
+            pending = false;
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                Lane &l = lanes[j];
+                if (l.trie == nullptr || !l.node)
+                {
+                    continue;
+                }
+                l.node = l.trie->Step(l.e, l.depth, l.hi, l.lo);
+                pending = pending || l.node;
+                if (l.node)
+                {
+                    LPM_PREFETCH(&l.trie->nodes[l.e]);
+                }
+                else
+                {
+                    LPM_PREFETCH(&l.trie->leaves[l.e]);
+                }
+            }
+        }
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            const Lane &l = lanes[j];
+            std::uint32_t leaf = 0;
+            if (l.trie != nullptr)
+            {
+                // kLeaf — лист из прямой таблицы, иначе номер листа после спуска.
+                leaf = (l.e & kLeaf) != 0 ? l.e & ~kLeaf : l.trie->leaves[l.e];
+            }
+            out[base + j] = leaf == 0 ? fallback : leaf - 1;
+        }
+    }
+}
+
+std::size_t Lpm::MemoryBytes() const noexcept
+{
+    std::size_t bytes = 0;
+    for (const Trie *t : {&v4_, &v6_})
+    {
+        bytes += t->direct.size() * sizeof(std::uint32_t) + t->nodes.size() * sizeof(Node) +
+                 t->leaves.size() * sizeof(std::uint32_t);
+    }
+    return bytes;
+}
+
+LpmTable::LpmTable(const std::vector<Lpm::Route> &routes)
+    : current_(new Lpm(routes))
+{
+}
+
+LpmTable::~LpmTable()
+{
+    delete current_.load(std::memory_order_relaxed);
+}
+
+void LpmTable::Update(const std::vector<Lpm::Route> &routes)
+{
+    // Построение — вне мьютекса: параллельные Update ждут только публикации.
+    auto fresh = std::make_unique<const Lpm>(routes);
+    LOGD("lpm") << "LpmTable: " << fresh->Size() << " prefixes, " << (fresh->MemoryBytes() >> 10) << " KiB";
+    std::lock_guard<std::mutex> lk(write_mtx_);
+    const Lpm *old = current_.exchange(fresh.release(), std::memory_order_acq_rel);
+    Rcu::Synchronize();
+    delete old;
+}
+
+unsigned LpmTable::Lookup(const std::uint8_t *addr,
+                          unsigned fallback) const noexcept
+{
+    Rcu::ReadGuard guard;
+    return current_.load(std::memory_order_acquire)->Lookup(addr, fallback);
+}
+
+unsigned LpmTable::Lookup4(std::uint32_t addr,
+                           unsigned fallback) const noexcept
+{
+    Rcu::ReadGuard guard;
+    return current_.load(std::memory_order_acquire)->Lookup4(addr, fallback);
+}
+
+unsigned LpmTable::Lookup(const PacketMeta &meta,
+                          std::size_t i,
+                          unsigned fallback) const noexcept
+{
+    Rcu::ReadGuard guard;
+    return current_.load(std::memory_order_acquire)->Lookup(meta, i, fallback);
+}
+
+void LpmTable::LookupBatch(const PacketMeta &meta,
+                           unsigned fallback,
+                           unsigned *out) const noexcept
+{
+    Rcu::ReadGuard guard;
+    current_.load(std::memory_order_acquire)->LookupBatch(meta, fallback, out);
+}
+
+std::size_t LpmTable::Size() const noexcept
+{
+    Rcu::ReadGuard guard;
+    return current_.load(std::memory_order_acquire)->Size();
+}
@@ -0,0 +1,172 @@
+#pragma once
+// Lpm.hpp — поиск самого длинного совпадающего префикса (Poptrie) для политик по адресу назначения.
+
+#include "Classifier.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class PacketMeta;
+
+/**
+ * @brief Скомпилированная таблица префиксов IPv4/IPv6 -> target.
+ *
+ * Раздельный туннель, списки исключений и шейпинг по назначению спрашивают
+ * «какое правило покрывает этот адрес» на каждом пакете; Classifier с его
+ * 64 правилами для тысяч и миллионов префиксов не годится.
+ *
+ * Структура — Poptrie (Asai, Ohara, 2015): прямая таблица по старшим
+ * kDirect4 / kDirect6 битам, ниже — узлы с шагом 6 бит. У узла две 64-битные
+ * маски: vector (какие из 64 потомков — узлы) и leafvec (где начинается новая
+ * серия одинаковых листьев); номер потомка — popcount маски до индекса, так что
+ * узел занимает 24 байта, а соседние одинаковые листья хранятся один раз.
+ * Поиск IPv4 /24 — прямая таблица и один узел; IPv6 /48 — прямая таблица и
+ * шесть узлов. Память растёт с числом префиксов, а не фиксирована, как у
+ * DIR-24-8 (64 МБ на версию — и вдвое больше на время замены).
+ *
+ * Адреса — как в Classifier: IPv4 — ::ffff:a.b.c.d, префикс IPv4 — длина 96 + n.
+ * Префикс короче 96 бит, покрывающий ::ffff:0:0/96 (например, ::/0), действует
+ * и на IPv4 — как в Classifier. Биты адреса за длиной префикса игнорируются;
+ * у одинаковых префиксов побеждает последний.
+ *
+ * После создания только читается; замена на лету — LpmTable.
+ */
+class Lpm
+{
+public:
+    /// @brief Наибольший target (старший бит занят в прямой таблице).
+    static constexpr unsigned kMaxTarget = 0x7FFFFFFE;
+
+    /// @brief Бит прямой таблицы IPv4 и IPv6.
+    static constexpr unsigned kDirect4 = 18;
+    static constexpr unsigned kDirect6 = 16;
+
+    /**
+     * @brief Префикс и результат совпадения.
+     */
+    struct Route
+    {
+        Classifier::Prefix prefix;
+        unsigned           target = 0;
+    };
+
+    /**
+     * @brief Скомпилировать таблицу.
+     * @throw std::invalid_argument Длина префикса больше 128, target больше kMaxTarget
+     *        или таблица не помещается в 32-битные индексы.
+     */
+    explicit Lpm(const std::vector<Route> &routes = {});
+
+    /**
+     * @brief target самого длинного префикса, покрывающего адрес; fallback — ни одного.
+     * @param addr 16 байт, сетевой порядок (IPv4 — ::ffff:a.b.c.d).
+     */
+    unsigned Lookup(const std::uint8_t *addr, unsigned fallback) const noexcept;
+
+    /** @brief Lookup по IPv4-адресу (host order). */
+    unsigned Lookup4(std::uint32_t addr, unsigned fallback) const noexcept;
+
+    /** @brief Lookup по адресу назначения пакета i пачки; не IP — fallback. */
+    unsigned Lookup(const PacketMeta &meta, std::size_t i, unsigned fallback) const noexcept;
+
+    /** @brief Lookup по адресам назначения всей пачки: out[i] на каждый пакет. */
+    void LookupBatch(const PacketMeta &meta, unsigned fallback, unsigned *out) const noexcept;
+
+    /** @brief Число префиксов. */
+    std::size_t Size() const noexcept { return size_; }
+
+    /** @brief Память таблиц, байт. */
+    std::size_t MemoryBytes() const noexcept;
+
+private:
+    struct Node
+    {
+        std::uint64_t vector  = 0;   ///< Потомок — узел.
+        std::uint64_t leafvec = 0;   ///< Начало серии листьев.
+        std::uint32_t base0   = 0;   ///< Первый лист в leaves.
+        std::uint32_t base1   = 0;   ///< Первый потомок в nodes.
+    };
+
+    struct Trie
+    {
+        unsigned                   direct_bits = 0;
+        /// @brief Номер узла или kLeaf | лист.
+        std::vector<std::uint32_t> direct;
+        std::vector<Node>          nodes;
+        /// @brief target + 1; 0 — нет совпадения.
+        std::vector<std::uint32_t> leaves;
+
+        /// @brief Элемент прямой таблицы ключа.
+        std::size_t Slot(std::uint64_t hi) const noexcept
+        {
+            return static_cast<std::size_t>(hi >> (64 - direct_bits));
+        }
+
+        /**
+         * @brief Шаг спуска из узла e на глубине depth.
+         * @return true — e теперь потомок-узел (depth += 6); false — e номер листа в leaves.
+         */
+        bool Step(std::uint32_t &e, unsigned &depth, std::uint64_t hi, std::uint64_t lo) const noexcept;
+
+        /// @brief Лист ключа.
+        std::uint32_t Find(std::uint64_t hi, std::uint64_t lo) const noexcept;
+    };
+
+    /// @brief Префикс в ключе дерева (128 бит, старшие — первые) с приоритетом.
+    struct Item;
+
+    /// @brief Построить дерево по префиксам (сортирует items).
+    static void Build(Trie &t, std::vector<Item> &items);
+
+    /// @brief Заполнить узел node по префиксам items[lo, hi) длиннее depth; def — лист без них.
+    static void Fill(Trie &t, const std::vector<Item> &items, std::size_t node,
+                     std::size_t lo, std::size_t hi, unsigned depth, std::uint32_t def);
+
+    Trie        v4_;
+    Trie        v6_;
+    std::size_t size_ = 0;
+};
+
+/**
+ * @brief Lpm с заменой на лету: поиск lock-free, обновление — новой версией.
+ *
+ * Update строит новую таблицу вне data path, публикует её атомарной заменой
+ * указателя и после Rcu::Synchronize() освобождает прежнюю — как SessionTable.
+ * Поиск идёт под Rcu::ReadGuard и видит либо старую, либо новую таблицу
+ * целиком. LookupBatch берёт одну секцию чтения на пачку.
+ */
+class LpmTable
+{
+public:
+    /**
+     * @throw std::invalid_argument Как у Lpm.
+     */
+    explicit LpmTable(const std::vector<Lpm::Route> &routes = {});
+
+    ~LpmTable();
+
+    LpmTable(const LpmTable &) = delete;
+    LpmTable &operator=(const LpmTable &) = delete;
+
+    /**
+     * @brief Заменить таблицу.
+     * @note Блокирует до выхода читателей прежней версии; вызывать вне Rcu::ReadGuard.
+     * @throw std::invalid_argument Как у Lpm (прежняя таблица остаётся).
+     */
+    void Update(const std::vector<Lpm::Route> &routes);
+
+    unsigned Lookup(const std::uint8_t *addr, unsigned fallback) const noexcept;
+    unsigned Lookup4(std::uint32_t addr, unsigned fallback) const noexcept;
+    unsigned Lookup(const PacketMeta &meta, std::size_t i, unsigned fallback) const noexcept;
+    void LookupBatch(const PacketMeta &meta, unsigned fallback, unsigned *out) const noexcept;
+
+    /** @brief Число префиксов текущей версии. */
+    std::size_t Size() const noexcept;
+
+private:
+    std::atomic<const Lpm *> current_;
+    std::mutex               write_mtx_;
+};
@@ -0,0 +1,262 @@
+// Lz4.cpp — жадный компрессор и проверяющий декомпрессор блока LZ4.
+
+#include "Lz4.hpp"
+
+#include <bit>
+#include <cstring>
+
+namespace
+{
+    /// @brief Ограничения формата блока LZ4.
+    constexpr std::size_t kMinMatch     = 4;
+    constexpr std::size_t kLastLiterals = 5;    ///< Последние байты блока — всегда литералы.
+    constexpr std::size_t kMfLimit      = 12;   ///< Совпадение начинается не ближе к концу.
+
+    /// @brief Шаг поиска растёт на единицу каждые 2^kSkipTrigger байт без совпадения.
+    constexpr unsigned kSkipTrigger = 6;
+
+    /// @brief Словарь в таблицу — каждая kPrimeStep-я позиция (совпадение доберёт назад).
+    constexpr std::size_t kPrimeStep = 3;
+
+    inline std::uint32_t Load32(const std::uint8_t *p) noexcept
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline std::uint64_t Load64(const std::uint8_t *p) noexcept
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline unsigned Hash(const std::uint8_t *p) noexcept
+    {
+        return (Load32(p) * 2654435761u) >> (32 - Lz4::Table::kBits);
+    }
+
+    /// @brief Длина общего начала a и b, не дальше limit байт от a.
+    inline std::size_t Common(const std::uint8_t *a, const std::uint8_t *b, const std::uint8_t *limit) noexcept
+    {
+        const std::uint8_t *const start = a;
+        if constexpr (std::endian::native == std::endian::little)
+        {
+            while (a + 8 <= limit)
+            {
+                const std::uint64_t x = Load64(a) ^ Load64(b);
+                if (x != 0)
+                {
+                    return static_cast<std::size_t>(a - start) + static_cast<std::size_t>(std::countr_zero(x) >> 3);
+                }
+                a += 8;
+                b += 8;
+            }
+        }
+        while (a < limit && *a == *b)
+        {
+            ++a;
+            ++b;
+        }
+        return static_cast<std::size_t>(a - start);
+    }
+
+    /// @brief Длина сверх 15 в токене: байты по 255 и остаток.
+    inline std::uint8_t *PutLength(std::uint8_t *op, std::size_t n) noexcept
+    {
+        for (; n >= 255; n -= 255)
+        {
+            *op++ = 255;
+        }
+        *op++ = static_cast<std::uint8_t>(n);
+        return op;
+    }
+
+    /// @brief Прочитать продолжение длины; false — блок кончился.
+    inline bool GetLength(const std::uint8_t *&ip, const std::uint8_t *end, std::size_t &n) noexcept
+    {
+        for (;;)
+        {
+            if (ip == end)
+            {
+                return false;
+            }
+            const std::uint8_t b = *ip++;
+            n += b;
+            if (b != 255)
+            {
+                return true;
+            }
+        }
+    }
+}
+
+namespace Lz4
+{
+    std::size_t Compress(const std::uint8_t *window,
+                         std::size_t prefix,
+                         std::size_t len,
+                         std::uint8_t *out,
+                         std::size_t cap,
+                         Table &table) noexcept
+    {
+        if (prefix + len > kMaxWindow || cap == 0)
+        {
+            return 0;
+        }
+        std::uint16_t *const slot = table.slot;
+        for (std::size_t p = 0; p + kMinMatch <= prefix; p += kPrimeStep)
+        {
+            slot[Hash(window + p)] = static_cast<std::uint16_t>(p + 1);
+        }
+
+        const std::uint8_t *const base     = window;
+        const std::uint8_t *const end      = window + prefix + len;
+        const std::uint8_t *const mflimit  = len >= kMfLimit ? end - kMfLimit : window + prefix;
+        const std::uint8_t *const matchend = end - kLastLiterals;
+        const std::uint8_t       *ip       = window + prefix;
+        const std::uint8_t       *anchor   = ip;
+        std::uint8_t             *op       = out;
+        std::uint8_t *const       oend     = out + cap;
+
+        // Короче kMfLimit — только литералы (правило формата).
+        while (len > kMfLimit && ip <= mflimit)
+        {
+            const unsigned h = Hash(ip);
+            const std::size_t cand = slot[h];
+            slot[h] = static_cast<std::uint16_t>(ip - base + 1);
+            const std::uint8_t *ref = base + (cand != 0 ? cand - 1 : 0);
+            if (cand == 0 || ref >= ip || Load32(ref) != Load32(ip))
+            {
+                ip += 1 + (static_cast<std::size_t>(ip - anchor) >> kSkipTrigger);
+                continue;
+            }
+
+            // Совпадение могло начаться раньше: добрать назад до anchor.
+            while (ip > anchor && ref > base && ip[-1] == ref[-1])
+            {
+                --ip;
+                --ref;
+            }
+            const std::size_t lit   = static_cast<std::size_t>(ip - anchor);
+            const std::size_t mlen  = kMinMatch + Common(ip + kMinMatch, ref + kMinMatch, matchend);
+            const std::size_t need  = 1 + lit / 255 + 1 + lit + 2 + (mlen - kMinMatch) / 255 + 1;
+            if (need > static_cast<std::size_t>(oend - op))
+            {
+                return 0;
+            }
+
+            std::uint8_t *token = op++;
+            *token = static_cast<std::uint8_t>((lit >= 15 ? 15 : lit) << 4);
+            if (lit >= 15)
+            {
+                op = PutLength(op, lit - 15);
+            }
+            std::memcpy(op, anchor, lit);
+            op += lit;
+            const std::size_t off = static_cast<std::size_t>(ip - ref);
+            *op++ = static_cast<std::uint8_t>(off);
+            *op++ = static_cast<std::uint8_t>(off >> 8);
+            const std::size_t ml = mlen - kMinMatch;
+            *token |= static_cast<std::uint8_t>(ml >= 15 ? 15 : ml);
+            if (ml >= 15)
+            {
+                op = PutLength(op, ml - 15);
+            }
+
+            ip    += mlen;
+            anchor = ip;
+            // Позиция перед концом совпадения — в таблицу: повторы часто идут подряд.
+            if (ip - 2 >= base + prefix && ip <= mflimit)
+            {
+                slot[Hash(ip - 2)] = static_cast<std::uint16_t>(ip - 2 - base + 1);
+            }
+        }
+
+        const std::size_t lit  = static_cast<std::size_t>(end - anchor);
+        const std::size_t need = 1 + lit / 255 + 1 + lit;
+        if (need > static_cast<std::size_t>(oend - op))
+        {
+            return 0;
+        }
+        *op++ = static_cast<std::uint8_t>((lit >= 15 ? 15 : lit) << 4);
+        if (lit >= 15)
+        {
+            op = PutLength(op, lit - 15);
+        }
+        std::memcpy(op, anchor, lit);
+        op += lit;
+        return static_cast<std::size_t>(op - out);
+    }
+
+    std::size_t Decompress(const std::uint8_t *in,
+                           std::size_t len,
+                           std::uint8_t *window,
+                           std::size_t prefix,
+                           std::size_t cap) noexcept
+    {
+        const std::uint8_t *ip   = in;
+        const std::uint8_t *iend = in + len;
+        std::uint8_t       *op   = window + prefix;
+        std::uint8_t *const oend = op + cap;
+
+        while (ip < iend)
+        {
+            const std::uint8_t token = *ip++;
+            std::size_t lit = token >> 4;
+            if (lit == 15 && !GetLength(ip, iend, lit))
+            {
+                return 0;
+            }
+            if (lit > static_cast<std::size_t>(iend - ip) || lit > static_cast<std::size_t>(oend - op))
+            {
+                return 0;
+            }
+            std::memcpy(op, ip, lit);
+            ip += lit;
+            op += lit;
+            if (ip == iend)
+            {
+                // Последняя последовательность — только литералы.
+                return static_cast<std::size_t>(op - (window + prefix));
+            }
+
+            if (iend - ip < 2)
+            {
+                return 0;
+            }
+            const std::size_t off = static_cast<std::size_t>(ip[0]) | (static_cast<std::size_t>(ip[1]) << 8);
+            ip += 2;
+            if (off == 0 || off > static_cast<std::size_t>(op - window))
+            {
+                return 0;
+            }
+            std::size_t mlen = token & 15;
+            if (mlen == 15 && !GetLength(ip, iend, mlen))
+            {
+                return 0;
+            }
+            mlen += kMinMatch;
+            if (mlen > static_cast<std::size_t>(oend - op))
+            {
+                return 0;
+            }
+            const std::uint8_t *ref = op - off;
+            if (off >= mlen)
+            {
+                std::memcpy(op, ref, mlen);
+                op += mlen;
+            }
+            else
+            {
+                // Перекрытие: повтор короткого образца, побайтно.
+                for (std::size_t i = 0; i < mlen; ++i)
+                {
+                    *op++ = ref[i];
+                }
+            }
+        }
+        return 0;
+    }
+}
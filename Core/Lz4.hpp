@@ -0,0 +1,60 @@
+#pragma once
+// Lz4.hpp — сжатие и распаковка блока в формате LZ4 со словарём перед данными.
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Блок LZ4 (формат блока, без кадра LZ4F) для пакетов туннеля.
+ *
+ * Данные и словарь лежат в одном окне: window[0, prefix) — словарь,
+ * window[prefix, prefix + len) — сжимаемое. Совпадения могут ссылаться в
+ * словарь, поэтому у пакетов одного потока (заголовки HTTP, JSON с теми же
+ * ключами) сжимается и то, что внутри одного пакета не повторяется.
+ *
+ * Сжатие — жадное, как LZ4 fast: хэш четырёх байт, без цепочек; шаг поиска
+ * растёт на несжимаемом участке. Таблица хэшей не очищается между блоками:
+ * устаревший кандидат отсеивается сравнением байт, а очистка 8 КиБ на пакет
+ * стоила бы больше самого поиска. Выход — стандартный блок LZ4 (его разберёт
+ * и LZ4_decompress_safe_usingDict).
+ *
+ * Распаковка проверяет все границы: испорченный блок даёт 0, а не выход за буфер.
+ */
+namespace Lz4
+{
+    /// @brief Наибольшее окно (словарь + данные): смещение совпадения — 16 бит.
+    constexpr std::size_t kMaxWindow = 0xFFFF;
+
+    /// @brief Таблица хэшей компрессора.
+    struct Table
+    {
+        static constexpr unsigned kBits = 12;
+        /// @brief Позиция в окне + 1; 0 — пусто.
+        std::uint16_t slot[1u << kBits] = {};
+    };
+
+    /**
+     * @brief Наибольший блок для len байт несжимаемых данных.
+     */
+    constexpr std::size_t Bound(std::size_t len) noexcept
+    {
+        return len + len / 255 + 16;
+    }
+
+    /**
+     * @brief Сжать window[prefix, prefix + len) со словарём window[0, prefix).
+     * @param out Блок LZ4.
+     * @param cap Ёмкость out.
+     * @return Длина блока; 0 — не помещается в cap или prefix + len > kMaxWindow.
+     */
+    std::size_t Compress(const std::uint8_t *window, std::size_t prefix, std::size_t len,
+                         std::uint8_t *out, std::size_t cap, Table &table) noexcept;
+
+    /**
+     * @brief Распаковать блок в window + prefix; словарь — window[0, prefix).
+     * @param cap Наибольшая длина распакованного.
+     * @return Длина распакованного; 0 — блок испорчен или длиннее cap.
+     */
+    std::size_t Decompress(const std::uint8_t *in, std::size_t len,
+                           std::uint8_t *window, std::size_t prefix, std::size_t cap) noexcept;
+}
@@ -0,0 +1,915 @@
+// PacketCapture.cpp — фильтр захвата, очередь к фоновому потоку и кольцо pcapng в отображённом файле.
+
+#include "PacketCapture.hpp"
+#include "FlowTable.hpp"
+#include "Core/Logger.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    // Типы блоков pcapng.
+    constexpr std::uint32_t kShb    = 0x0A0D0D0A;
+    constexpr std::uint32_t kIdb    = 0x00000001;
+    constexpr std::uint32_t kEpb    = 0x00000006;
+    constexpr std::uint32_t kCustom = 0x00000BAD;   ///< Custom Block, «не копировать».
+
+    /// @brief Private Enterprise Number для документации и примеров (RFC 5612).
+    constexpr std::uint32_t kEnterprise = 32473;
+
+    /// @brief Наименьший блок (заполнитель: тип, длина, PEN, длина).
+    constexpr std::size_t kMinBlock = 16;
+
+    /// @brief EPB без данных: заголовок 28, epb_flags 8, opt_endofopt 4, длина 4.
+    constexpr std::size_t kEpbOverhead = 44;
+
+    /// @brief LINKTYPE_RAW: пакет начинается с заголовка IPv4/IPv6.
+    constexpr std::uint16_t kLinkRaw = 101;
+
+    /// @brief Наибольшая вложенность скобок и not в фильтре.
+    constexpr int kMaxDepth = 64;
+
+    /// @brief Наибольшее число узлов фильтра (глубина рекурсии Match).
+    constexpr std::size_t kMaxNodes = 512;
+
+    /// @brief Пауза фонового потока на пустой очереди.
+    constexpr auto kIdle = std::chrono::milliseconds(1);
+
+    constexpr std::size_t Pad4(std::size_t n) noexcept { return (n + 3) & ~std::size_t{3}; }
+
+    template <typename T>
+    void Put(std::uint8_t *p, T v) noexcept
+    {
+        std::memcpy(p, &v, sizeof(v));
+    }
+
+    template <typename T>
+    void Append(std::vector<std::uint8_t> &out, T v)
+    {
+        const std::size_t at = out.size();
+        out.resize(at + sizeof(v));
+        std::memcpy(out.data() + at, &v, sizeof(v));
+    }
+
+    /// @brief Опция pcapng: код, длина, значение с выравниванием до 4.
+    void AppendOption(std::vector<std::uint8_t> &out, std::uint16_t code, const void *value, std::size_t len)
+    {
+        Append(out, code);
+        Append(out, static_cast<std::uint16_t>(len));
+        const std::size_t at = out.size();
+        out.resize(at + Pad4(len));
+        std::memcpy(out.data() + at, value, len);
+    }
+
+    /// @brief Закрыть блок, начатый в out[at]: длина в заголовке и в конце.
+    void CloseBlock(std::vector<std::uint8_t> &out, std::size_t at)
+    {
+        const auto total = static_cast<std::uint32_t>(out.size() - at + 4);
+        Append(out, total);
+        Put(out.data() + at + 4, total);
+    }
+
+    /// @brief Адрес addr в префиксе p (оба — в пространстве IPv6).
+    bool InPrefix(const std::uint8_t addr[16], const Classifier::Prefix &p) noexcept
+    {
+        const unsigned bytes = p.len / 8;
+        if (std::memcmp(addr, p.addr.data(), bytes) != 0)
+        {
+            return false;
+        }
+        const unsigned bits = p.len % 8;
+        if (bits == 0)
+        {
+            return true;
+        }
+        const auto mask = static_cast<std::uint8_t>(0xFF00u >> bits);
+        return ((addr[bytes] ^ p.addr[bytes]) & mask) == 0;
+    }
+}
+
+// ===== CaptureFilter =====
+
+/// @brief Поля пакета, которые читает фильтр.
+struct CaptureFilter::Fields
+{
+    FlowTable::Key key;
+    std::size_t    len     = 0;
+    unsigned       version = 0;       ///< 4, 6; 0 — заголовок не разобран.
+    bool           ports   = false;   ///< Есть порты (TCP/UDP/SCTP, первый фрагмент).
+    bool           inbound = false;
+};
+
+/// @brief Рекурсивный спуск по лексемам выражения; узлы — в nodes.
+struct CaptureFilter::Parser
+{
+    struct Token
+    {
+        std::string text;
+        std::size_t pos;
+    };
+
+    std::vector<Token> tokens;
+    std::size_t        next = 0;
+    std::size_t        end_pos;
+    std::vector<Node> &nodes;
+
+    Parser(const std::string &expr, std::vector<Node> &out)
+        : end_pos(expr.size())
+        , nodes(out)
+    {
+        std::size_t i = 0;
+        while (i < expr.size())
+        {
+            const char c = expr[i];
+            if (std::isspace(static_cast<unsigned char>(c)))
+            {
+                ++i;
+            }
+            else if (c == '(' || c == ')' || c == '!')
+            {
+                tokens.push_back({std::string(1, c), i});
+                ++i;
+            }
+            else if (expr.compare(i, 2, "&&") == 0 || expr.compare(i, 2, "||") == 0)
+            {
+                tokens.push_back({expr.substr(i, 2), i});
+                i += 2;
+            }
+            else
+            {
+                const std::size_t b = i;
+                while (i < expr.size() && !std::isspace(static_cast<unsigned char>(expr[i])) && expr[i] != '(' &&
+                       expr[i] != ')' && expr[i] != '!' && expr.compare(i, 2, "&&") != 0 &&
+                       expr.compare(i, 2, "||") != 0)
+                {
+                    ++i;
+                }
+                tokens.push_back({expr.substr(b, i - b), b});
+            }
+        }
+    }
+
+    [[noreturn]] void Fail(const std::string &what) const
+    {
+        const std::size_t pos = next < tokens.size() ? tokens[next].pos : end_pos;
+        throw std::invalid_argument("CaptureFilter: " + what + " at position " + std::to_string(pos));
+    }
+
+    bool Peek(const char *t) const { return next < tokens.size() && tokens[next].text == t; }
+
+    bool Accept(const char *t)
+    {
+        if (Peek(t))
+        {
+            ++next;
+            return true;
+        }
+        return false;
+    }
+
+    const std::string &Take(const char *what)
+    {
+        if (next >= tokens.size())
+        {
+            Fail(std::string("expected ") + what);
+        }
+        return tokens[next++].text;
+    }
+
+    static Node Leaf(Op op)
+    {
+        Node n;
+        n.op = op;
+        return n;
+    }
+
+    std::uint32_t Add(const Node &n)
+    {
+        if (nodes.size() >= kMaxNodes)
+        {
+            Fail("expression too long");
+        }
+        nodes.push_back(n);
+        return static_cast<std::uint32_t>(nodes.size() - 1);
+    }
+
+    std::uint32_t Binary(Op op, std::uint32_t a, std::uint32_t b)
+    {
+        Node n = Leaf(op);
+        n.a = a;
+        n.b = b;
+        return Add(n);
+    }
+
+    /// @brief Может ли лексема начинать примитив (для and без связки).
+    bool StartsFactor() const
+    {
+        return next < tokens.size() && !Peek(")") && !Peek("or") && !Peek("||") && !Peek("and") && !Peek("&&");
+    }
+
+    std::uint32_t Expr(int depth)
+    {
+        std::uint32_t left = Term(depth);
+        while (Accept("or") || Accept("||"))
+        {
+            left = Binary(Op::Or, left, Term(depth));
+        }
+        return left;
+    }
+
+    std::uint32_t Term(int depth)
+    {
+        std::uint32_t left = Factor(depth);
+        for (;;)
+        {
+            if (Accept("and") || Accept("&&") || StartsFactor())
+            {
+                left = Binary(Op::And, left, Factor(depth));
+            }
+            else
+            {
+                return left;
+            }
+        }
+    }
+
+    std::uint32_t Factor(int depth)
+    {
+        if (depth > kMaxDepth)
+        {
+            Fail("expression nested too deeply");
+        }
+        if (Accept("not") || Accept("!"))
+        {
+            Node n = Leaf(Op::Not);
+            n.a = Factor(depth + 1);
+            return Add(n);
+        }
+        if (Accept("("))
+        {
+            const std::uint32_t inner = Expr(depth + 1);
+            if (!Accept(")"))
+            {
+                Fail("expected ')'");
+            }
+            return inner;
+        }
+        return Primitive();
+    }
+
+    std::uint32_t Number(const char *what)
+    {
+        const std::string &t = Take(what);
+        unsigned v = 0;
+        const auto [ptr, ec] = std::from_chars(t.data(), t.data() + t.size(), v);
+        if (ec != std::errc{} || ptr != t.data() + t.size() || t.empty())
+        {
+            --next;
+            Fail(std::string("expected ") + what);
+        }
+        return v;
+    }
+
+    std::uint32_t Primitive()
+    {
+        const std::size_t at = next;
+        const std::string &word = Take("primitive");
+        if (word == "ip")
+        {
+            return Add(Leaf(Op::Ip4));
+        }
+        if (word == "ip6")
+        {
+            return Add(Leaf(Op::Ip6));
+        }
+        if (word == "in" || word == "inbound")
+        {
+            return Add(Leaf(Op::Inbound));
+        }
+        if (word == "out" || word == "outbound")
+        {
+            return Add(Leaf(Op::Outbound));
+        }
+        if (word == "less" || word == "greater")
+        {
+            Node n = Leaf(word == "less" ? Op::Less : Op::Greater);
+            n.a = Number("length");
+            return Add(n);
+        }
+        if (word == "proto")
+        {
+            const std::string &p = Take("protocol");
+            const int num = Classifier::ParseProto(p == "icmp6" ? std::string("icmpv6") : p);
+            if (num < 0)
+            {
+                --next;
+                Fail("invalid protocol '" + p + "'");
+            }
+            Node n = Leaf(Op::Proto);
+            n.a = static_cast<std::uint32_t>(num);
+            return Add(n);
+        }
+        if (word == "tcp" || word == "udp" || word == "icmp" || word == "icmp6" || word == "sctp")
+        {
+            Node n = Leaf(Op::Proto);
+            n.a = static_cast<std::uint32_t>(Classifier::ParseProto(word == "icmp6" ? "icmpv6" : word));
+            return Add(n);
+        }
+
+        // [src|dst] host|net|port|portrange
+        int side = 0;   // 0 — любая сторона, 1 — src, 2 — dst
+        std::string kind = word;
+        if (word == "src" || word == "dst")
+        {
+            side = word == "src" ? 1 : 2;
+            if (Peek("host") || Peek("net") || Peek("port") || Peek("portrange"))
+            {
+                kind = Take("qualifier");
+            }
+            else
+            {
+                kind = "host";   // "src 10.0.0.1" — как в tcpdump
+            }
+        }
+        if (kind == "host" || kind == "net")
+        {
+            const std::string &addr = Take("address");
+            Node n = Leaf(side == 1 ? Op::Src : side == 2 ? Op::Dst : Op::Host);
+            if ((kind == "host" && addr.find('/') != std::string::npos) || !Classifier::ParsePrefix(addr, &n.prefix))
+            {
+                --next;
+                Fail("invalid " + kind + " '" + addr + "'");
+            }
+            return Add(n);
+        }
+        if (kind == "port" || kind == "portrange")
+        {
+            const std::string &ports = Take("port");
+            Node n = Leaf(side == 1 ? Op::Sport : side == 2 ? Op::Dport : Op::Port);
+            if ((kind == "port" && ports.find('-') != std::string::npos) ||
+                !Classifier::ParsePorts(ports, &n.lo, &n.hi))
+            {
+                --next;
+                Fail("invalid " + kind + " '" + ports + "'");
+            }
+            return Add(n);
+        }
+        next = at;
+        Fail("unknown primitive '" + word + "'");
+    }
+};
+
+CaptureFilter::CaptureFilter(const std::string &expr)
+{
+    Parser p(expr, nodes_);
+    if (p.tokens.empty())
+    {
+        return;
+    }
+    const std::uint32_t root = p.Expr(0);
+    if (p.next != p.tokens.size())
+    {
+        p.Fail("unexpected '" + p.tokens[p.next].text + "'");
+    }
+    // Корень — последний узел (Eval начинает с него).
+    if (root != nodes_.size() - 1)
+    {
+        nodes_.push_back(nodes_[root]);
+    }
+    nodes_.shrink_to_fit();
+}
+
+bool CaptureFilter::Match(const std::uint8_t *pkt,
+                          std::size_t len,
+                          bool inbound) const noexcept
+{
+    if (nodes_.empty())
+    {
+        return true;
+    }
+    Fields f;
+    f.len     = len;
+    f.inbound = inbound;
+    if (FlowTable::ExtractKey(pkt, len, &f.key))
+    {
+        f.version = pkt[0] >> 4;
+        f.ports   = f.key.proto == 6 || f.key.proto == 17 || f.key.proto == 132;
+    }
+    return Eval(static_cast<std::uint32_t>(nodes_.size() - 1), f);
+}
+
+bool CaptureFilter::Eval(std::uint32_t i,
+                         const Fields &f) const noexcept
+{
+    const Node &n = nodes_[i];
+    switch (n.op)
+    {
+    case Op::And:      return Eval(n.a, f) && Eval(n.b, f);
+    case Op::Or:       return Eval(n.a, f) || Eval(n.b, f);
+    case Op::Not:      return !Eval(n.a, f);
+    case Op::Ip4:      return f.version == 4;
+    case Op::Ip6:      return f.version == 6;
+    case Op::Proto:    return f.version != 0 && f.key.proto == n.a;
+    case Op::Src:      return f.version != 0 && InPrefix(f.key.src, n.prefix);
+    case Op::Dst:      return f.version != 0 && InPrefix(f.key.dst, n.prefix);
+    case Op::Host:     return f.version != 0 && (InPrefix(f.key.src, n.prefix) || InPrefix(f.key.dst, n.prefix));
+    case Op::Sport:    return f.ports && f.key.sport >= n.lo && f.key.sport <= n.hi;
+    case Op::Dport:    return f.ports && f.key.dport >= n.lo && f.key.dport <= n.hi;
+    case Op::Port:     return f.ports && ((f.key.sport >= n.lo && f.key.sport <= n.hi) ||
+                                          (f.key.dport >= n.lo && f.key.dport <= n.hi));
+    case Op::Less:     return f.len <= n.a;
+    case Op::Greater:  return f.len >= n.a;
+    case Op::Inbound:  return f.inbound;
+    case Op::Outbound: return !f.inbound;
+    }
+    return false;
+}
+
+// ===== Отображение файла =====
+
+/// @brief Файл фиксированного размера, отображённый в память на запись.
+struct PacketCapture::Mapping
+{
+    std::uint8_t *base = nullptr;
+    std::size_t   size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE map  = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    /// @throw std::runtime_error Файл не создаётся или не отображается.
+    Mapping(const std::string &path, std::size_t bytes)
+        : size(bytes)
+    {
+#ifdef _WIN32
+        const int wlen = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+        std::wstring wpath(wlen > 0 ? static_cast<std::size_t>(wlen - 1) : 0, L'\0');
+        if (wlen > 1)
+        {
+            MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath.data(), wlen);
+        }
+        file = CreateFileW(wpath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("PacketCapture: cannot create '" + path + "' (error " +
+                                     std::to_string(GetLastError()) + ")");
+        }
+        const auto big = static_cast<std::uint64_t>(bytes);
+        map = CreateFileMappingW(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(big >> 32),
+                                 static_cast<DWORD>(big), nullptr);
+        if (map != nullptr)
+        {
+            base = static_cast<std::uint8_t *>(MapViewOfFile(map, FILE_MAP_WRITE, 0, 0, bytes));
+        }
+        if (base == nullptr)
+        {
+            const DWORD err = GetLastError();
+            Release(0);
+            throw std::runtime_error("PacketCapture: cannot map '" + path + "' (error " + std::to_string(err) + ")");
+        }
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            throw std::runtime_error("PacketCapture: cannot create '" + path + "': " + std::strerror(errno));
+        }
+        void *p = MAP_FAILED;
+        if (::ftruncate(fd, static_cast<off_t>(bytes)) == 0)
+        {
+            p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (p == MAP_FAILED)
+        {
+            const int err = errno;
+            Release(0);
+            throw std::runtime_error("PacketCapture: cannot map '" + path + "': " + std::strerror(err));
+        }
+        base = static_cast<std::uint8_t *>(p);
+#endif
+    }
+
+    ~Mapping() { Release(size); }
+
+    Mapping(const Mapping &) = delete;
+    Mapping &operator=(const Mapping &) = delete;
+
+    /**
+     * @brief Снять отображение и обрезать файл до used байт.
+     * @return false — обрезка не удалась (файл остаётся полного размера).
+     */
+    bool Release(std::size_t used) noexcept
+    {
+        bool ok = true;
+#ifdef _WIN32
+        if (base != nullptr)
+        {
+            UnmapViewOfFile(base);
+        }
+        if (map != nullptr)
+        {
+            CloseHandle(map);
+        }
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            LARGE_INTEGER at{};
+            at.QuadPart = static_cast<LONGLONG>(used);
+            ok = SetFilePointerEx(file, at, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+            CloseHandle(file);
+        }
+        map  = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base != nullptr)
+        {
+            ::munmap(base, size);
+        }
+        if (fd >= 0)
+        {
+            ok = ::ftruncate(fd, static_cast<off_t>(used)) == 0;
+            ::close(fd);
+        }
+        fd = -1;
+#endif
+        base = nullptr;
+        return ok;
+    }
+};
+
+// ===== PacketCapture =====
+
+PacketCapture::PacketCapture() = default;
+
+PacketCapture::~PacketCapture()
+{
+    Stop();
+}
+
+void PacketCapture::Start(const Options &opts)
+{
+    std::lock_guard<std::mutex> ctl(ctl_mtx_);
+    if (thread_.joinable())
+    {
+        throw std::logic_error("PacketCapture: capture already running");
+    }
+    if (opts.path.empty() || opts.ring_bytes < (std::size_t{1} << 20) || opts.max_packet < 68 ||
+        opts.max_packet > 65535 || opts.queue < 16)
+    {
+        throw std::invalid_argument("PacketCapture: invalid options");
+    }
+    CaptureFilter filter(opts.filter);
+
+    const std::size_t slot = opts.snaplen != 0 ? std::min<std::size_t>(opts.snaplen, opts.max_packet)
+                                               : opts.max_packet;
+    const std::size_t cells = std::bit_ceil(opts.queue);
+    if (cells != mask_ + 1 || slot != slot_size_ || !cells_)
+    {
+        cells_     = std::make_unique<Cell[]>(cells);
+        data_      = std::make_unique<std::uint8_t[]>(cells * slot);
+        mask_      = cells - 1;
+        slot_size_ = slot;
+    }
+    for (std::size_t i = 0; i <= mask_; ++i)
+    {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    tail_.store(0, std::memory_order_relaxed);
+    head_ = 0;
+
+    // SHB + IDB.
+    std::vector<std::uint8_t> hdr;
+    Append(hdr, kShb);
+    Append(hdr, std::uint32_t{0});
+    Append(hdr, std::uint32_t{0x1A2B3C4D});
+    Append(hdr, std::uint16_t{1});
+    Append(hdr, std::uint16_t{0});
+    Append(hdr, ~std::uint64_t{0});                     // длина секции неизвестна
+    static constexpr char kApp[] = "FlowForge";
+    AppendOption(hdr, 4, kApp, sizeof(kApp) - 1);       // shb_userappl
+    Append(hdr, std::uint32_t{0});                      // opt_endofopt
+    CloseBlock(hdr, 0);
+
+    const std::size_t idb = hdr.size();
+    Append(hdr, kIdb);
+    Append(hdr, std::uint32_t{0});
+    Append(hdr, kLinkRaw);
+    Append(hdr, std::uint16_t{0});
+    Append(hdr, opts.snaplen);
+    AppendOption(hdr, 2, opts.ifname.data(), std::min<std::size_t>(opts.ifname.size(), 255));   // if_name
+    const std::uint8_t tsresol = 9;                     // наносекунды
+    AppendOption(hdr, 9, &tsresol, 1);                  // if_tsresol
+    Append(hdr, std::uint32_t{0});
+    CloseBlock(hdr, idb);
+
+    const std::size_t ring = opts.ring_bytes & ~std::size_t{3};
+    auto map = std::make_unique<Mapping>(opts.path, hdr.size() + ring);
+    std::memcpy(map->base, hdr.data(), hdr.size());
+
+    map_        = std::move(map);
+    ring_begin_ = hdr.size();
+    ring_end_   = ring_begin_ + ring;
+    write_      = ring_begin_;
+    oldest_     = ring_begin_;
+    wrapped_    = false;
+    Fill(ring_begin_, ring);
+
+    filter_ = std::move(filter);
+    packets_.store(0, std::memory_order_relaxed);
+    bytes_.store(0, std::memory_order_relaxed);
+    wraps_.store(0, std::memory_order_relaxed);
+    filtered_.store(0, std::memory_order_relaxed);
+    dropped_.store(0, std::memory_order_relaxed);
+    stop_ = false;
+
+    thread_ = std::thread(&PacketCapture::ThreadMain, this);
+    active_.store(true);
+    LOGI("capture") << "Started: " << opts.path << " ring=" << (ring >> 10) << "KiB snaplen=" << opts.snaplen
+                    << " queue=" << cells << (filter_.Empty() ? "" : " filter='" + opts.filter + "'");
+}
+
+bool PacketCapture::Stop()
+{
+    std::lock_guard<std::mutex> ctl(ctl_mtx_);
+    if (!thread_.joinable())
+    {
+        return false;
+    }
+    // Новые Tap отсекаются флагом; дождаться тех, кто уже внутри.
+    active_.store(false);
+    while (inflight_.load() != 0)
+    {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+    const std::size_t used = Linearize();
+    if (!map_->Release(used))
+    {
+        LOGW("capture") << "Could not trim capture file to " << used << " bytes";
+    }
+    map_.reset();
+    LOGI("capture") << "Stopped: packets=" << packets_.load() << " bytes=" << bytes_.load()
+                    << " filtered=" << filtered_.load() << " dropped=" << dropped_.load()
+                    << " wraps=" << wraps_.load() << " file=" << used << "B";
+    return true;
+}
+
+PacketCapture::Stats PacketCapture::GetStats() const noexcept
+{
+    Stats s;
+    s.packets  = packets_.load(std::memory_order_relaxed);
+    s.bytes    = bytes_.load(std::memory_order_relaxed);
+    s.filtered = filtered_.load(std::memory_order_relaxed);
+    s.dropped  = dropped_.load(std::memory_order_relaxed);
+    s.wraps    = wraps_.load(std::memory_order_relaxed);
+    s.active   = active_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void PacketCapture::TapSlow(const std::uint8_t *pkt,
+                            std::size_t len,
+                            Direction dir) noexcept
+{
+    // Счётчик «внутри» до повторной проверки флага: Stop ждёт его обнуления
+    // прежде, чем трогать очередь (seq_cst с обеих сторон).
+    inflight_.fetch_add(1);
+    if (active_.load())
+    {
+        if (!filter_.Empty() && !filter_.Match(pkt, len, dir == Direction::Inbound))
+        {
+            filtered_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            std::size_t pos = tail_.load(std::memory_order_relaxed);
+            Cell *cell = nullptr;
+            for (;;)
+            {
+                Cell *c = &cells_[pos & mask_];
+                const std::size_t seq = c->seq.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+                if (diff == 0)
+                {
+                    if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell = c;
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    break;   // очередь полна
+                }
+                else
+                {
+                    pos = tail_.load(std::memory_order_relaxed);
+                }
+            }
+            if (cell != nullptr)
+            {
+                const std::size_t cap = std::min(len, slot_size_);
+                std::memcpy(data_.get() + (pos & mask_) * slot_size_, pkt, cap);
+                cell->ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::system_clock::now().time_since_epoch()).count();
+                cell->caplen = static_cast<std::uint32_t>(cap);
+                cell->len    = static_cast<std::uint32_t>(len);
+                cell->dir    = dir;
+                cell->seq.store(pos + 1, std::memory_order_release);
+                // Фоновый поток спит по kIdle; на всплеске будим его каждые полкольца.
+                if ((pos & (mask_ >> 1)) == 0)
+                {
+                    cv_.notify_one();
+                }
+            }
+            else
+            {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    inflight_.fetch_sub(1, std::memory_order_release);
+}
+
+void PacketCapture::ThreadMain()
+{
+    LOGD("capture") << "ThreadMain: started";
+#ifdef _WIN32
+    // Запись файла уступает путям данных, если ядер мало.
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (!stop_)
+    {
+        lk.unlock();
+        const std::size_t n = Drain();
+        lk.lock();
+        if (n == 0)
+        {
+            cv_.wait_for(lk, kIdle, [this] { return stop_; });
+        }
+    }
+    lk.unlock();
+    Drain();
+    LOGD("capture") << "ThreadMain: exiting";
+}
+
+std::size_t PacketCapture::Drain() noexcept
+{
+    std::size_t n = 0;
+    std::uint64_t bytes = 0;
+    for (;;)
+    {
+        Cell &cell = cells_[head_ & mask_];
+        if (cell.seq.load(std::memory_order_acquire) != head_ + 1)
+        {
+            break;
+        }
+        const std::size_t caplen = cell.caplen;
+        const std::size_t size   = kEpbOverhead + Pad4(caplen);
+        const std::size_t off    = Reserve(size);
+        std::uint8_t *p = map_->base + off;
+        Put(p, kEpb);
+        Put(p + 4, static_cast<std::uint32_t>(size));
+        Put(p + 8, std::uint32_t{0});                                          // interface id
+        const auto ts = static_cast<std::uint64_t>(cell.ts);
+        Put(p + 12, static_cast<std::uint32_t>(ts >> 32));
+        Put(p + 16, static_cast<std::uint32_t>(ts));
+        Put(p + 20, static_cast<std::uint32_t>(caplen));
+        Put(p + 24, cell.len);
+        std::memcpy(p + 28, data_.get() + (head_ & mask_) * slot_size_, caplen);
+        std::memset(p + 28 + caplen, 0, Pad4(caplen) - caplen);
+        std::uint8_t *o = p + 28 + Pad4(caplen);
+        Put(o, std::uint16_t{2});                                               // epb_flags
+        Put(o + 2, std::uint16_t{4});
+        Put(o + 4, static_cast<std::uint32_t>(cell.dir));                       // биты 0-1: направление
+        Put(o + 8, std::uint32_t{0});                                           // opt_endofopt
+        Put(p + size - 4, static_cast<std::uint32_t>(size));
+
+        cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        ++n;
+        bytes += caplen;
+    }
+    if (n != 0)
+    {
+        // Закрыть промежуток до старых данных (или до конца кольца) заполнителем.
+        const std::size_t limit = wrapped_ ? oldest_ : ring_end_;
+        if (limit > write_)
+        {
+            Fill(write_, limit - write_);
+        }
+        packets_.fetch_add(n, std::memory_order_relaxed);
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    return n;
+}
+
+std::size_t PacketCapture::Reserve(std::size_t size) noexcept
+{
+    // Инвариант: промежуток от write_ до следующего целого блока (или конца
+    // кольца) — 0 или не меньше kMinBlock, чтобы его всегда можно было закрыть.
+    for (;;)
+    {
+        const bool old_ahead = wrapped_ && oldest_ < ring_end_;
+        const std::size_t room = (old_ahead ? oldest_ : ring_end_) - write_;
+        if (room == size || room >= size + kMinBlock)
+        {
+            break;
+        }
+        if (old_ahead)
+        {
+            oldest_ += BlockAt(oldest_);   // уступить самый старый блок
+            continue;
+        }
+        // Конец кольца: хвост — в заполнитель, запись — с начала.
+        if (room != 0)
+        {
+            Fill(write_, room);
+        }
+        write_   = ring_begin_;
+        oldest_  = ring_begin_;
+        wrapped_ = true;
+        wraps_.fetch_add(1, std::memory_order_relaxed);
+    }
+    const std::size_t off = write_;
+    write_ += size;
+    return off;
+}
+
+void PacketCapture::Fill(std::size_t off,
+                         std::size_t size) noexcept
+{
+    std::uint8_t *p = map_->base + off;
+    Put(p, kCustom);
+    Put(p + 4, static_cast<std::uint32_t>(size));
+    Put(p + 8, kEnterprise);
+    Put(p + size - 4, static_cast<std::uint32_t>(size));
+}
+
+std::size_t PacketCapture::BlockAt(std::size_t off) const noexcept
+{
+    std::uint32_t len = 0;
+    std::memcpy(&len, map_->base + off + 4, sizeof(len));
+    return len;
+}
+
+std::size_t PacketCapture::Linearize() noexcept
+{
+    std::uint8_t *base = map_->base;
+    if (wrapped_ && oldest_ < ring_end_)
+    {
+        // [oldest_, ring_end_) — прошлый оборот, [ring_begin_, write_) — текущий.
+        std::rotate(base + ring_begin_, base + oldest_, base + ring_end_);
+    }
+    // Выбросить заполнители, сдвигая блоки данных к началу.
+    std::size_t dst = ring_begin_;
+    for (std::size_t src = ring_begin_; src < ring_end_;)
+    {
+        const std::size_t len = BlockAt(src);
+        if (len < kMinBlock || src + len > ring_end_)
+        {
+            break;   // недописанный хвост (не бывает: кольцо всегда замкнуто)
+        }
+        std::uint32_t type = 0;
+        std::memcpy(&type, base + src, sizeof(type));
+        if (type != kCustom)
+        {
+            if (dst != src)
+            {
+                std::memmove(base + dst, base + src, len);
+            }
+            dst += len;
+        }
+        src += len;
+    }
+    return dst;
+}
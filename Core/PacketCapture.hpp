@@ -0,0 +1,252 @@
+#pragma once
+// PacketCapture.hpp — запись внутренних пакетов туннеля в кольцевой файл pcapng (фильтр, snaplen, фоновый поток).
+
+#include "Classifier.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Фильтр захвата: подмножество синтаксиса tcpdump/BPF.
+ *
+ * Примитивы: ip, ip6, tcp, udp, icmp, icmp6, sctp, proto P, host A, net A/len,
+ * port N, portrange lo-hi, less N, greater N, in, out; к host/net/port/portrange
+ * применимы src и dst. Связки: and (&&), or (||), not (!), скобки; and
+ * связывает сильнее or, соседние примитивы без связки — and.
+ *
+ * Выражение компилируется в дерево в одном векторе; Match идёт по нему без
+ * аллокаций, с коротким замыканием. После создания только читается.
+ */
+class CaptureFilter
+{
+public:
+    /**
+     * @brief Скомпилировать выражение (пустое — пропускает всё).
+     * @throw std::invalid_argument Синтаксическая ошибка (в сообщении — позиция).
+     */
+    explicit CaptureFilter(const std::string &expr = {});
+
+    /**
+     * @brief Подходит ли пакет.
+     * @param inbound true — из туннеля к хосту, false — от хоста в туннель.
+     */
+    bool Match(const std::uint8_t *pkt, std::size_t len, bool inbound) const noexcept;
+
+    /** @brief Фильтр пропускает всё. */
+    bool Empty() const noexcept { return nodes_.empty(); }
+
+private:
+    enum class Op : std::uint8_t
+    {
+        And,
+        Or,
+        Not,
+        Ip4,
+        Ip6,
+        Proto,
+        Src,         ///< Адрес источника в префиксе.
+        Dst,
+        Host,        ///< Источник или назначение.
+        Sport,       ///< Порт источника в диапазоне.
+        Dport,
+        Port,
+        Less,        ///< Длина пакета <= value.
+        Greater,     ///< Длина пакета >= value.
+        Inbound,
+        Outbound,
+    };
+
+    struct Node
+    {
+        Op                 op = Op::And;
+        std::uint32_t      a = 0;        ///< And/Or/Not — левый (единственный) потомок; Proto/Less/Greater — значение.
+        std::uint32_t      b = 0;        ///< And/Or — правый потомок.
+        std::uint16_t      lo = 0;       ///< Порты.
+        std::uint16_t      hi = 0;
+        Classifier::Prefix prefix;
+    };
+
+    std::vector<Node> nodes_;            ///< Корень — последний.
+
+    struct Parser;
+    struct Fields;
+
+    bool Eval(std::uint32_t n, const Fields &f) const noexcept;
+};
+
+/**
+ * @brief Захват пакетов туннеля в заранее выделенный файл pcapng, отображённый в память.
+ *
+ * - Путь данных (Tap) только копирует пакет (до snaplen) в lock-free очередь
+ *   MPSC на заранее выделенных слотах и ставит время; без захвата — одна
+ *   relaxed-загрузка. Блоки pcapng собирает и пишет в файл фоновый поток,
+ *   он же принимает на себя страничные промахи отображения. Переполнение
+ *   очереди — отброс записи (учитывается в Stats::dropped), путь данных не ждёт.
+ * - Файл: SHB, IDB (LINKTYPE_RAW, наносекунды), затем кольцо блоков EPB с
+ *   направлением в epb_flags. Между пачками записи кольцо — корректный
+ *   pcapng: промежуток между головой записи и самым старым целым блоком
+ *   закрыт блоком-заполнителем (Custom Block, PEN 32473), который читатели
+ *   пропускают. Копию файла можно открыть в Wireshark и во время захвата
+ *   (копия, снятая посреди пачки, может оборваться); после оборота кольца
+ *   порядок записей в файле — не хронологический.
+ * - Stop дописывает очередь, поворачивает кольцо в хронологический порядок и
+ *   обрезает файл по данным.
+ *
+ * Start/Stop/GetStats потокобезопасны; Tap — из любого числа потоков.
+ */
+class PacketCapture
+{
+public:
+    /// @brief Направление пакета относительно хоста.
+    enum class Direction : std::uint8_t
+    {
+        Inbound  = 1,   ///< Из туннеля к хосту (epb_flags: 01).
+        Outbound = 2,   ///< От хоста в туннель (epb_flags: 10).
+    };
+
+    /**
+     * @brief Параметры захвата.
+     */
+    struct Options
+    {
+        /// @brief Файл (UTF-8; перезаписывается).
+        std::string path;
+        /// @brief Размер кольца блоков в файле, байт.
+        std::size_t ring_bytes = std::size_t{64} << 20;
+        /// @brief Байт пакета в записи; 0 — пакет целиком.
+        std::uint32_t snaplen = 0;
+        /// @brief Наибольший пакет туннеля (MTU): размер слота очереди при snaplen 0.
+        std::size_t max_packet = 9200;
+        /// @brief Слотов в очереди к фоновому потоку.
+        std::size_t queue = 4096;
+        /// @brief Выражение фильтра (см. CaptureFilter).
+        std::string filter;
+        /// @brief Имя интерфейса в IDB.
+        std::string ifname = "tunnel";
+    };
+
+    /**
+     * @brief Счётчики текущего (или последнего) захвата.
+     */
+    struct Stats
+    {
+        std::uint64_t packets  = 0;   ///< Записано блоков.
+        std::uint64_t bytes    = 0;   ///< Записано байт пакетов (после snaplen).
+        std::uint64_t filtered = 0;   ///< Отвергнуто фильтром.
+        std::uint64_t dropped  = 0;   ///< Отброшено: очередь полна.
+        std::uint64_t wraps    = 0;   ///< Оборотов кольца.
+        bool          active   = false;
+    };
+
+    PacketCapture();
+
+    /**
+     * @brief Деструктор: Stop().
+     */
+    ~PacketCapture();
+
+    PacketCapture(const PacketCapture &) = delete;
+    PacketCapture &operator=(const PacketCapture &) = delete;
+
+    /**
+     * @brief Начать захват (память очереди и файл выделяются здесь).
+     * @throw std::invalid_argument Некорректные Options или фильтр.
+     * @throw std::logic_error      Захват уже идёт.
+     * @throw std::runtime_error    Файл не создаётся или не отображается.
+     */
+    void Start(const Options &opts);
+
+    /**
+     * @brief Остановить захват и закрыть файл (идемпотентно).
+     * @return false — захват не шёл.
+     */
+    bool Stop();
+
+    /**
+     * @brief Предъявить пакет (путь данных).
+     */
+    void Tap(const std::uint8_t *pkt, std::size_t len, Direction dir) noexcept
+    {
+        if (active_.load(std::memory_order_relaxed))
+        {
+            TapSlow(pkt, len, dir);
+        }
+    }
+
+    /** @brief Идёт ли захват. */
+    bool Active() const noexcept { return active_.load(std::memory_order_relaxed); }
+
+    /** @brief Счётчики. */
+    Stats GetStats() const noexcept;
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> seq{0};
+        std::int64_t             ts = 0;       ///< Наносекунды от эпохи Unix.
+        std::uint32_t            caplen = 0;
+        std::uint32_t            len = 0;      ///< Исходная длина пакета.
+        Direction                dir = Direction::Inbound;
+    };
+
+    struct Mapping;
+
+    std::mutex ctl_mtx_;                         ///< Start/Stop.
+
+    // Очередь к фоновому потоку (схема Вьюкова, как MpscRing).
+    std::size_t                      mask_ = 0;
+    std::size_t                      slot_size_ = 0;
+    std::unique_ptr<Cell[]>          cells_;
+    std::unique_ptr<std::uint8_t[]>  data_;
+    CaptureFilter                    filter_;
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::size_t              head_ = 0;
+
+    alignas(64) std::atomic<bool>          active_{false};
+    std::atomic<std::uint32_t>             inflight_{0};   ///< Потоков внутри TapSlow.
+    std::atomic<std::uint64_t>             filtered_{0};
+    std::atomic<std::uint64_t>             dropped_{0};
+
+    // Кольцо в файле: только фоновый поток (и Stop после его завершения).
+    std::unique_ptr<Mapping> map_;
+    std::size_t              ring_begin_ = 0;  ///< Смещение первого блока кольца.
+    std::size_t              ring_end_ = 0;
+    std::size_t              write_ = 0;       ///< Голова записи.
+    std::size_t              oldest_ = 0;      ///< Самый старый целый блок прошлого оборота.
+    bool                     wrapped_ = false;
+    std::atomic<std::uint64_t> packets_{0};
+    std::atomic<std::uint64_t> bytes_{0};
+    std::atomic<std::uint64_t> wraps_{0};
+
+    std::thread             thread_;
+    std::mutex              mtx_;
+    std::condition_variable cv_;
+    bool                    stop_ = false;
+
+    void TapSlow(const std::uint8_t *pkt, std::size_t len, Direction dir) noexcept;
+
+    void ThreadMain();
+
+    /// @brief Переписать все готовые ячейки очереди в кольцо; число записанных.
+    std::size_t Drain() noexcept;
+
+    /// @brief Место под блок size в кольце (с заполнителями и оборотом); смещение.
+    std::size_t Reserve(std::size_t size) noexcept;
+
+    /// @brief Блок-заполнитель на [off, off + size).
+    void Fill(std::size_t off, std::size_t size) noexcept;
+
+    /// @brief Длина блока по смещению (из его заголовка).
+    std::size_t BlockAt(std::size_t off) const noexcept;
+
+    /// @brief Повернуть кольцо в хронологический порядок; размер файла с данными.
+    std::size_t Linearize() noexcept;
+};
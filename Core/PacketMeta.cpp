@@ -0,0 +1,348 @@
+// PacketMeta.cpp — разбор пачки: скалярный и AVX2 (четыре простых IPv4 за раз).
+
+#include "PacketMeta.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PACKETMETA_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#define PACKETMETA_PREFETCH(p) _mm_prefetch(reinterpret_cast<const char *>(p), _MM_HINT_T0)
+#elif defined(__GNUC__)
+#define PACKETMETA_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PACKETMETA_PREFETCH(p) ((void)(p))
+#endif
+
+#if defined(PACKETMETA_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#define PACKETMETA_TARGET(x) __attribute__((target(x)))
+#else
+#define PACKETMETA_TARGET(x)
+#endif
+
+namespace
+{
+    /// @brief На сколько пакетов вперёд подгружаются заголовки.
+    constexpr std::size_t kPrefetch = 8;
+
+    inline std::uint16_t Load16(const std::uint8_t *p) noexcept
+    {
+        return static_cast<std::uint16_t>(p[0] << 8 | p[1]);
+    }
+
+    inline bool HasPorts(std::uint8_t proto) noexcept
+    {
+        return proto == 6 || proto == 17 || proto == 132 || proto == 136;   // TCP, UDP, SCTP, UDP-Lite
+    }
+
+    /**
+     * @brief Указатели на строку i всех столбцов (для векторного разбора).
+     */
+    struct Columns
+    {
+        std::uint8_t  *flags;
+        std::uint8_t  *next;
+        std::uint8_t  *proto;
+        std::uint8_t  *dscp;
+        std::uint8_t  *ecn;
+        std::uint32_t *len;
+        std::uint32_t *ip_len;
+        std::uint16_t *l4;
+        std::uint16_t *sport;
+        std::uint16_t *dport;
+        std::uint8_t  *src;
+        std::uint8_t  *dst;
+    };
+
+#if defined(PACKETMETA_AVX2)
+    /// @brief Четыре 32-битных слова v по индексам idx — в 128-битный регистр.
+    PACKETMETA_TARGET("avx2")
+    inline __m128i Pick32(__m256i v,
+                          __m256i idx) noexcept
+    {
+        return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, idx));
+    }
+
+    /**
+     * @brief Разобрать четыре пакета, если все — IPv4 без опций и не фрагменты, длиной от 24 байт.
+     * @return false — хоть один не такой; столбцы не тронуты.
+     */
+    PACKETMETA_TARGET("avx2")
+    bool ParseQuadAvx2(const std::uint8_t *const *pkts,
+                       const std::size_t *lens,
+                       const Columns &c) noexcept
+    {
+        const __m256i len = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lens));
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(len, _mm256_set1_epi64x(23)))) != 0xF)
+        {
+            return false;
+        }
+        // Указатели — индексы сборки от нулевой базы: полоса k читает 8 байт заголовка пакета k.
+        const __m256i ptr = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pkts));
+        const auto   *base = static_cast<const long long *>(nullptr);
+        const __m256i w0 = _mm256_i64gather_epi64(base, ptr, 1);   // байты 0..7
+        const __m256i ff = _mm256_set1_epi64x(0xFF);
+        const __m256i frag = _mm256_and_si256(_mm256_srli_epi64(w0, 48), _mm256_set1_epi64x(0xFF3F));
+        const __m256i simple = _mm256_and_si256(_mm256_cmpeq_epi64(_mm256_and_si256(w0, ff), _mm256_set1_epi64x(0x45)),
+                                                _mm256_cmpeq_epi64(frag, _mm256_setzero_si256()));
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(simple)) != 0xF)
+        {
+            return false;
+        }
+        const __m256i w1 = _mm256_i64gather_epi64(base, _mm256_add_epi64(ptr, _mm256_set1_epi64x(8)), 1);    // 8..15
+        const __m256i w2 = _mm256_i64gather_epi64(base, _mm256_add_epi64(ptr, _mm256_set1_epi64x(16)), 1);   // 16..23
+
+        const __m256i proto = _mm256_and_si256(_mm256_srli_epi64(w1, 8), ff);
+        const __m256i ports = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi64(proto, _mm256_set1_epi64x(6)),
+                                                              _mm256_cmpeq_epi64(proto, _mm256_set1_epi64x(17))),
+                                              _mm256_or_si256(_mm256_cmpeq_epi64(proto, _mm256_set1_epi64x(132)),
+                                                              _mm256_cmpeq_epi64(proto, _mm256_set1_epi64x(136))));
+        const __m256i tos   = _mm256_and_si256(_mm256_srli_epi64(w0, 8), ff);
+        const __m256i flags = _mm256_or_si256(_mm256_set1_epi64x(PacketMeta::kIpv4),
+                                              _mm256_and_si256(ports, _mm256_set1_epi64x(PacketMeta::kPorts)));
+
+        // Младшие (lo) и старшие (hi) 32 бита четырёх полос — в один 128-битный регистр.
+        const __m256i lo = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        const __m256i hi = _mm256_setr_epi32(1, 3, 5, 7, 1, 3, 5, 7);
+
+        // Байтовые столбцы: запись полосы flags|proto|dscp|ecn, транспонирование 4x4 байта.
+        const __m256i rec = _mm256_or_si256(_mm256_or_si256(flags, _mm256_slli_epi64(proto, 8)),
+                                            _mm256_or_si256(_mm256_slli_epi64(_mm256_srli_epi64(tos, 2), 16),
+                                                            _mm256_slli_epi64(_mm256_and_si256(tos, _mm256_set1_epi64x(3)), 24)));
+        const __m128i bytes = _mm_shuffle_epi8(Pick32(rec, lo), _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15));
+        const auto col0 = static_cast<std::uint32_t>(_mm_cvtsi128_si32(bytes));
+        const auto col1 = static_cast<std::uint32_t>(_mm_extract_epi32(bytes, 1));
+        const auto col2 = static_cast<std::uint32_t>(_mm_extract_epi32(bytes, 2));
+        const auto col3 = static_cast<std::uint32_t>(_mm_extract_epi32(bytes, 3));
+        std::memcpy(c.flags, &col0, 4);
+        std::memcpy(c.next, &col1, 4);
+        std::memcpy(c.proto, &col1, 4);
+        std::memcpy(c.dscp, &col2, 4);
+        std::memcpy(c.ecn, &col3, 4);
+
+        // Total length (байты 2..3, BE) и длины пакетов.
+        const __m128i ip_len = _mm_shuffle_epi8(Pick32(w0, lo), _mm_setr_epi8(2 + 1, 2, -1, -1, 6 + 1, 6, -1, -1,
+                                                                                10 + 1, 10, -1, -1, 14 + 1, 14, -1, -1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(c.ip_len), ip_len);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(c.len), Pick32(len, lo));
+        const std::uint64_t l4 = 0x0014001400140014ull;
+        std::memcpy(c.l4, &l4, 8);
+
+        // Порты (байты 20..23, BE): sport четырёх пакетов, затем dport.
+        const __m128i pw = Pick32(_mm256_and_si256(w2, ports), hi);
+        const __m128i pt = _mm_shuffle_epi8(pw, _mm_setr_epi8(1, 0, 5, 4, 9, 8, 13, 12, 3, 2, 7, 6, 11, 10, 15, 14));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(c.sport), pt);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(c.dport), _mm_unpackhi_epi64(pt, pt));
+
+        // Адреса: ::ffff: и 4 байта адреса полосы k в последнем слове.
+        const __m128i src = Pick32(w1, hi);   // байты 12..15
+        const __m128i dst = Pick32(w2, lo);   // байты 16..19
+        const __m128i mapped = _mm_setr_epi32(0, 0, static_cast<int>(0xFFFF0000u), 0);
+        // Старший бит в управляющем байте обнуляет байт; 0x80 + 4k его сохраняет.
+        const __m128i pick = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128,
+                                           -128, -128, -128, -128, 0, 1, 2, 3);
+        for (int k = 0; k < 4; ++k)
+        {
+            const __m128i ctl = _mm_add_epi8(pick, _mm_set1_epi8(static_cast<char>(4 * k)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(c.src + 16 * k), _mm_or_si128(mapped, _mm_shuffle_epi8(src, ctl)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(c.dst + 16 * k), _mm_or_si128(mapped, _mm_shuffle_epi8(dst, ctl)));
+        }
+        return true;
+    }
+
+    bool HasAvx2() noexcept
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int r[4];
+        __cpuid(r, 0);
+        if (r[0] < 7)
+        {
+            return false;
+        }
+        __cpuid(r, 1);
+        // OSXSAVE + AVX, и ОС сохраняет YMM-регистры.
+        if ((r[2] & (1 << 27)) == 0 || (r[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+        __cpuidex(r, 7, 0);
+        return (r[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    bool UseAvx2() noexcept
+    {
+#if defined(PACKETMETA_AVX2)
+        static const bool avx2 = HasAvx2();
+        return avx2;
+#else
+        return false;
+#endif
+    }
+}
+
+PacketMeta::PacketMeta(std::size_t capacity)
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("PacketMeta: capacity must be positive");
+    }
+    flags_.resize(capacity);
+    next_.resize(capacity);
+    proto_.resize(capacity);
+    dscp_.resize(capacity);
+    ecn_.resize(capacity);
+    len_.resize(capacity);
+    ip_len_.resize(capacity);
+    l4_.resize(capacity);
+    sport_.resize(capacity);
+    dport_.resize(capacity);
+    src_.resize(capacity * 16);
+    dst_.resize(capacity * 16);
+}
+
+std::size_t PacketMeta::Parse(const std::uint8_t *const *pkts,
+                              const std::size_t *lens,
+                              std::size_t n) noexcept
+{
+    size_ = std::min(n, Capacity());
+    const bool avx2 = UseAvx2();
+    std::size_t ahead = 0;
+    for (std::size_t i = 0; i < size_;)
+    {
+        for (const std::size_t until = std::min(size_, i + kPrefetch + 4); ahead < until; ++ahead)
+        {
+            PACKETMETA_PREFETCH(pkts[ahead]);
+        }
+#if defined(PACKETMETA_AVX2)
+        if (avx2 && i + 4 <= size_)
+        {
+            const Columns c{&flags_[i], &next_[i], &proto_[i], &dscp_[i], &ecn_[i], &len_[i], &ip_len_[i],
+                            &l4_[i], &sport_[i], &dport_[i], &src_[i * 16], &dst_[i * 16]};
+            if (!ParseQuadAvx2(pkts + i, lens + i, c))
+            {
+                // Смешанная четвёрка разбирается скалярно целиком: сборка по ней уже оплачена.
+                for (std::size_t k = 0; k < 4; ++k)
+                {
+                    ParseOne(i + k, pkts[i + k], lens[i + k]);
+                }
+            }
+            i += 4;
+            continue;
+        }
+#else
+        (void)avx2;
+#endif
+        ParseOne(i, pkts[i], lens[i]);
+        ++i;
+    }
+    return size_;
+}
+
+void PacketMeta::ParseOne(std::size_t i,
+                          const std::uint8_t *pkt,
+                          std::size_t len) noexcept
+{
+    std::uint8_t  flags = 0;
+    std::uint8_t  next  = 0;
+    std::uint8_t  proto = 0;
+    std::uint8_t  dscp  = 0;
+    std::uint8_t  ecn   = 0;
+    std::uint32_t ip_len = 0;
+    std::size_t   l4 = 0;   // 0 — портов нет
+    std::uint8_t *src = &src_[i * 16];
+    std::uint8_t *dst = &dst_[i * 16];
+    std::memset(src, 0, 16);
+    std::memset(dst, 0, 16);
+
+    if (len >= 20 && (pkt[0] >> 4) == 4 && (pkt[0] & 0x0F) >= 5 && len >= static_cast<std::size_t>(pkt[0] & 0x0F) * 4)
+    {
+        flags  = kIpv4;
+        next   = pkt[9];
+        proto  = pkt[9];
+        dscp   = static_cast<std::uint8_t>(pkt[1] >> 2);
+        ecn    = static_cast<std::uint8_t>(pkt[1] & 3);
+        ip_len = Load16(pkt + 2);
+        src[10] = src[11] = 0xFF;
+        dst[10] = dst[11] = 0xFF;
+        std::memcpy(src + 12, pkt + 12, 4);
+        std::memcpy(dst + 12, pkt + 16, 4);
+        if ((Load16(pkt + 6) & 0x3FFF) != 0)
+        {
+            flags |= kFragment;
+        }
+        if (((pkt[6] & 0x1F) | pkt[7]) == 0)
+        {
+            l4 = static_cast<std::size_t>(pkt[0] & 0x0F) * 4;
+        }
+    }
+    else if (len >= 40 && (pkt[0] >> 4) == 6)
+    {
+        flags  = kIpv6;
+        next   = pkt[6];
+        proto  = pkt[6];
+        dscp   = static_cast<std::uint8_t>(((pkt[0] & 0x0F) << 2) | (pkt[1] >> 6));
+        ecn    = static_cast<std::uint8_t>((pkt[1] >> 4) & 3);
+        ip_len = 40u + Load16(pkt + 4);
+        std::memcpy(src, pkt + 8, 16);
+        std::memcpy(dst, pkt + 24, 16);
+        std::size_t off = 40;
+        // Заголовки расширений до L4: hop-by-hop, routing, destination, fragment, AH.
+        for (int hops = 0; hops < 8 && off != 0; ++hops)
+        {
+            if (proto != 0 && proto != 43 && proto != 60 && proto != 51 && proto != 44)
+            {
+                break;
+            }
+            if (len < off + 8)
+            {
+                off = 0;
+                break;
+            }
+            const std::uint8_t nh = pkt[off];
+            if (proto == 44)
+            {
+                flags |= kFragment;
+                const bool first = (Load16(pkt + off + 2) & 0xFFF8) == 0;
+                off = first ? off + 8 : 0;
+            }
+            else
+            {
+                off += proto == 51 ? (static_cast<std::size_t>(pkt[off + 1]) + 2) * 4
+                                   : (static_cast<std::size_t>(pkt[off + 1]) + 1) * 8;
+            }
+            proto = nh;
+        }
+        l4 = off;
+    }
+
+    flags_[i]  = flags;
+    next_[i]   = next;
+    proto_[i]  = proto;
+    dscp_[i]   = dscp;
+    ecn_[i]    = ecn;
+    len_[i]    = static_cast<std::uint32_t>(len);
+    ip_len_[i] = ip_len;
+    l4_[i]     = static_cast<std::uint16_t>(l4);
+    sport_[i]  = 0;
+    dport_[i]  = 0;
+    if (l4 != 0 && HasPorts(proto) && len >= l4 + 4)
+    {
+        flags_[i] = static_cast<std::uint8_t>(flags | kPorts);
+        sport_[i] = Load16(pkt + l4);
+        dport_[i] = Load16(pkt + l4 + 2);
+    }
+}
+
+const char *PacketMeta::Backend() noexcept
+{
+    return UseAvx2() ? "avx2" : "scalar";
+}
@@ -0,0 +1,133 @@
+#pragma once
+// PacketMeta.hpp — разбор заголовков пачки IP-пакетов в метаданные (структура массивов) для стадий классификации.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Метаданные пачки пакетов: заголовки разбираются один раз, стадии читают поля.
+ *
+ * Разделение туннеля, приоритеты, шейпер, хэш потока и учёт потоков иначе
+ * разбирали бы заголовки каждая сама; здесь пачка (кольцо Wintun, recvmmsg)
+ * проходит Parse, и дальше стадии берут поля по номеру пакета в пачке
+ * (перегрузки с PacketMeta у Classifier, FlowTable, FqCodel, PriorityQueue,
+ * Shaper) — стоимость классификации на пакет не растёт с числом стадий.
+ *
+ * Поля лежат структурой массивов (каждое поле — свой массив на Capacity()
+ * пакетов): стадия, которой нужен один-два столбца, не тянет в кэш остальные.
+ * Семантика полей — как у разбора в Classifier и FlowTable::ExtractKey:
+ * адреса IPv4 — как ::ffff:a.b.c.d, заголовки расширений IPv6 пропускаются
+ * (до 8), порты — у TCP/UDP/SCTP/UDP-Lite в первом фрагменте (стадии, не
+ * считающие UDP-Lite портовым, проверяют Proto сами).
+ *
+ * Parse подгружает заголовки пакетов на kPrefetch вперёд (prefetch), а на x86
+ * с AVX2 простые IPv4-пакеты (IHL = 5) разбираются по четыре: первые 24 байта
+ * четырёх пакетов снимаются тремя сборками (gather) и поля выделяются в
+ * векторных регистрах; остальные пакеты — скалярно. Выбор — один раз по CPUID.
+ *
+ * Класс не потокобезопасен; память выделяется в конструкторе.
+ */
+class PacketMeta
+{
+public:
+    /// @brief Пачка по умолчанию (как вычерпывание кольца за раз).
+    static constexpr std::size_t kDefaultCapacity = 64;
+
+    /// @brief Флаги пакета.
+    enum Flag : std::uint8_t
+    {
+        kIpv4     = 0x01,
+        kIpv6     = 0x02,
+        kPorts    = 0x04,   ///< SrcPort/DstPort действительны (TCP, UDP, SCTP, UDP-Lite).
+        kFragment = 0x08,   ///< Фрагмент (любой, в том числе первый).
+    };
+
+    /**
+     * @brief Выделить массивы на capacity пакетов.
+     * @throw std::invalid_argument capacity == 0.
+     */
+    explicit PacketMeta(std::size_t capacity = kDefaultCapacity);
+
+    /**
+     * @brief Разобрать пачку (прежние метаданные заменяются).
+     * @param pkts Указатели на пакеты (начало заголовка IP).
+     * @param lens Длины пакетов.
+     * @param n    Число пакетов; больше Capacity() — разбираются первые Capacity().
+     * @return Число разобранных записей (Size()).
+     */
+    std::size_t Parse(const std::uint8_t *const *pkts, const std::size_t *lens, std::size_t n) noexcept;
+
+    /** @brief Записей после последнего Parse. */
+    std::size_t Size() const noexcept { return size_; }
+
+    /** @brief Наибольшая пачка. */
+    std::size_t Capacity() const noexcept { return flags_.size(); }
+
+    /** @brief Флаги (0 — не IPv4/IPv6 или заголовок обрезан: остальные поля нулевые). */
+    std::uint8_t Flags(std::size_t i) const noexcept { return flags_[i]; }
+
+    /** @brief Разобран ли заголовок IP. */
+    bool Ip(std::size_t i) const noexcept { return (flags_[i] & (kIpv4 | kIpv6)) != 0; }
+
+    /** @brief Версия IP: 4, 6 или 0. */
+    unsigned Version(std::size_t i) const noexcept
+    {
+        return (flags_[i] & kIpv4) != 0 ? 4 : (flags_[i] & kIpv6) != 0 ? 6 : 0;
+    }
+
+    /** @brief Поле протокола заголовка IP (у IPv6 — первый Next Header, возможно расширение). */
+    std::uint8_t NextHeader(std::size_t i) const noexcept { return next_[i]; }
+
+    /** @brief Протокол L4 (у IPv6 — после заголовков расширений). */
+    std::uint8_t Proto(std::size_t i) const noexcept { return proto_[i]; }
+
+    /** @brief DSCP 0..63. */
+    std::uint8_t Dscp(std::size_t i) const noexcept { return dscp_[i]; }
+
+    /** @brief ECN 0..3. */
+    std::uint8_t Ecn(std::size_t i) const noexcept { return ecn_[i]; }
+
+    /** @brief Длина пакета (как передана в Parse). */
+    std::uint32_t Length(std::size_t i) const noexcept { return len_[i]; }
+
+    /** @brief Длина по заголовку IP (IPv4 total length, IPv6 40 + payload length). */
+    std::uint32_t IpLength(std::size_t i) const noexcept { return ip_len_[i]; }
+
+    /** @brief Смещение заголовка L4; 0 — не первый фрагмент или цепочка расширений не разобрана. */
+    std::uint16_t L4Offset(std::size_t i) const noexcept { return l4_[i]; }
+
+    std::uint16_t SrcPort(std::size_t i) const noexcept { return sport_[i]; }
+    std::uint16_t DstPort(std::size_t i) const noexcept { return dport_[i]; }
+
+    /** @brief Адреса, 16 байт (IPv4 — ::ffff:a.b.c.d). */
+    const std::uint8_t *Src(std::size_t i) const noexcept { return src_.data() + i * 16; }
+    const std::uint8_t *Dst(std::size_t i) const noexcept { return dst_.data() + i * 16; }
+
+    /** @brief Столбцы целиком (для стадий, сканирующих пачку). */
+    const std::uint8_t  *FlagsColumn() const noexcept { return flags_.data(); }
+    const std::uint8_t  *ProtoColumn() const noexcept { return proto_.data(); }
+    const std::uint8_t  *DscpColumn() const noexcept { return dscp_.data(); }
+    const std::uint16_t *DstPortColumn() const noexcept { return dport_.data(); }
+
+    /** @brief Разбор простых IPv4: "avx2" или "scalar". */
+    static const char *Backend() noexcept;
+
+private:
+    /// @brief Разобрать пакет i скалярно.
+    void ParseOne(std::size_t i, const std::uint8_t *pkt, std::size_t len) noexcept;
+
+    std::size_t                size_ = 0;
+    std::vector<std::uint8_t>  flags_;
+    std::vector<std::uint8_t>  next_;
+    std::vector<std::uint8_t>  proto_;
+    std::vector<std::uint8_t>  dscp_;
+    std::vector<std::uint8_t>  ecn_;
+    std::vector<std::uint32_t> len_;
+    std::vector<std::uint32_t> ip_len_;
+    std::vector<std::uint16_t> l4_;
+    std::vector<std::uint16_t> sport_;
+    std::vector<std::uint16_t> dport_;
+    std::vector<std::uint8_t>  src_;   ///< По 16 байт на пакет.
+    std::vector<std::uint8_t>  dst_;
+};
@@ -0,0 +1,71 @@
+// PacketQueue.cpp — реализация ограниченной очереди пакетов.
+
+#include "PacketQueue.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+PacketQueue::PacketQueue(std::size_t capacity,
+                         std::size_t slot_size)
+    : capacity_(capacity)
+    , slot_size_(slot_size)
+{
+    if (capacity_ == 0 || slot_size_ == 0)
+    {
+        throw std::invalid_argument("PacketQueue: capacity and slot_size must be non-zero");
+    }
+    storage_.resize(capacity_ * slot_size_);
+    lengths_.resize(capacity_, 0);
+}
+
+bool PacketQueue::Push(const std::uint8_t *data,
+                       std::size_t len) noexcept
+{
+    if (len == 0 || len > slot_size_)
+    {
+        ++dropped_;
+        return false;
+    }
+
+    if (count_ == capacity_)
+    {
+        // Вытесняем самый старый пакет.
+        head_ = (head_ + 1) % capacity_;
+        --count_;
+        ++dropped_;
+    }
+
+    const std::size_t tail = (head_ + count_) % capacity_;
+    std::memcpy(storage_.data() + tail * slot_size_, data, len);
+    lengths_[tail] = static_cast<std::uint32_t>(len);
+    ++count_;
+    return true;
+}
+
+std::size_t PacketQueue::Pop(std::uint8_t *buf,
+                             std::size_t size) noexcept
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+
+    const std::size_t len = lengths_[head_];
+    const std::uint8_t *src = storage_.data() + head_ * slot_size_;
+    head_ = (head_ + 1) % capacity_;
+    --count_;
+
+    if (len > size)
+    {
+        ++dropped_;
+        return 0;
+    }
+    std::memcpy(buf, src, len);
+    return len;
+}
+
+void PacketQueue::Clear() noexcept
+{
+    head_  = 0;
+    count_ = 0;
+}
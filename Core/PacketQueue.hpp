@@ -0,0 +1,80 @@
+#pragma once
+// PacketQueue.hpp — ограниченная FIFO-очередь пакетов на заранее выделенных слотах.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Кольцевая очередь пакетов фиксированной ёмкости.
+ *
+ * Память под все слоты выделяется в конструкторе, Push/Pop не аллоцируют.
+ * При переполнении вытесняется самый старый пакет (свежие данные ценнее:
+ * TCP всё равно перепошлёт хвост, а устаревшие пакеты только добавят задержку).
+ *
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class PacketQueue
+{
+public:
+    /**
+     * @brief Создать очередь.
+     * @param capacity  Максимальное число пакетов.
+     * @param slot_size Максимальный размер одного пакета (обычно MTU).
+     * @throw std::invalid_argument Нулевая ёмкость или размер слота.
+     */
+    PacketQueue(std::size_t capacity, std::size_t slot_size);
+
+    PacketQueue(const PacketQueue &) = delete;
+    PacketQueue &operator=(const PacketQueue &) = delete;
+    PacketQueue(PacketQueue &&) noexcept = default;
+    PacketQueue &operator=(PacketQueue &&) noexcept = default;
+
+    /**
+     * @brief Положить копию пакета в хвост очереди.
+     * @param data Данные пакета.
+     * @param len  Длина пакета.
+     * @return false, если пакет больше слота (отброшен).
+     */
+    bool Push(const std::uint8_t *data, std::size_t len) noexcept;
+
+    /**
+     * @brief Забрать пакет из головы очереди.
+     * @param buf  Буфер назначения.
+     * @param size Размер буфера.
+     * @return Длина пакета; 0 — очередь пуста или пакет не влез в buf (отброшен).
+     */
+    std::size_t Pop(std::uint8_t *buf, std::size_t size) noexcept;
+
+    /**
+     * @brief Отбросить все пакеты (счётчик потерь не меняется).
+     */
+    void Clear() noexcept;
+
+    /** @brief Число пакетов в очереди. */
+    std::size_t Size() const noexcept { return count_; }
+
+    /** @brief Очередь пуста. */
+    bool Empty() const noexcept { return count_ == 0; }
+
+    /** @brief Ёмкость в пакетах. */
+    std::size_t Capacity() const noexcept { return capacity_; }
+
+    /** @brief Размер слота в байтах. */
+    std::size_t SlotSize() const noexcept { return slot_size_; }
+
+    /** @brief Сколько пакетов отброшено за всё время (переполнение/размер). */
+    std::uint64_t Dropped() const noexcept { return dropped_; }
+
+private:
+    /** @brief Данные всех слотов подряд: capacity_ * slot_size_. */
+    std::vector<std::uint8_t>  storage_;
+    /** @brief Длина пакета в каждом слоте. */
+    std::vector<std::uint32_t> lengths_;
+    std::size_t   capacity_  = 0;
+    std::size_t   slot_size_ = 0;
+    /** @brief Индекс головы (самый старый пакет). */
+    std::size_t   head_      = 0;
+    std::size_t   count_     = 0;
+    std::uint64_t dropped_   = 0;
+};
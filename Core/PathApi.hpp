@@ -0,0 +1,34 @@
+#pragma once
+// PathApi.hpp — необязательное расширение клиентского ABI плагина: несколько каналов (путей).
+// Плагин, экспортирующий Client_ServeMultipath, открывает по транспорту на каждый канал
+// из "uplinks" конфига Client_Connect, а ядро само решает, каким путём слать пакет.
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <BaseTsd.h>
+#ifndef ssize_t
+#define ssize_t SSIZE_T
+#endif
+#endif
+
+/**
+ * @brief Колбэки ядра для многопутевого клиентского цикла.
+ *
+ * Номер пути — индекс в массиве "uplinks" (0..paths-1). Каждый элемент массива:
+ * {"index", "local" — адрес для bind сокета, "if_index" — индекс интерфейса}.
+ */
+struct ClientPathApi
+{
+    /// @brief Пакет из TUN для отправки серверу: в *path — путь, выбранный планировщиком. 0 — пакетов нет.
+    std::function<ssize_t(unsigned *path, std::uint8_t *buf, std::size_t len)> receive_from_net;
+
+    /// @brief Пакет от сервера, пришедший по пути path, в TUN.
+    std::function<ssize_t(unsigned path, const std::uint8_t *buf, std::size_t len)> send_to_net;
+
+    /// @brief Транспорт пути поднялся/упал (ядро перестаёт/начинает выбирать этот путь).
+    std::function<void(unsigned path, bool up)> path_state;
+};
@@ -7,18 +7,52 @@
 #include <csignal>
 #include <boost/json/object.hpp>
 
+#ifdef _WIN32
 #include <BaseTsd.h>
 #define ssize_t SSIZE_T
-
 #define PLUGIN_API extern "C" __declspec(dllexport)
+#else
+#define PLUGIN_API extern "C" __attribute__((visibility("default")))
+#endif
+
+#include "SessionApi.hpp"
+#include "PathApi.hpp"
+#include "PriorityApi.hpp"
 
+// Буферы receive_from_net/send_to_net — IP-пакеты либо служебные кадры ядра
+// (первый полубайт 0xF, см. CoreFrame.hpp); плагин переносит их без изменений.
 PLUGIN_API bool Client_Connect(boost::json::object& config) noexcept;
 PLUGIN_API void Client_Disconnect() noexcept;
 PLUGIN_API int  Client_Serve(const std::function<ssize_t(std::uint8_t *, std::size_t)> &receive_from_net,
                   const std::function<ssize_t(const std::uint8_t *, std::size_t)> &send_to_net,
                   const volatile sig_atomic_t *working_flag) noexcept;
 
+// Необязательное расширение клиентского ABI (см. PathApi.hpp): один транспорт на канал.
+// Если символа нет или канал один, ядро работает через Client_Serve.
+PLUGIN_API int  Client_ServeMultipath(const ClientPathApi &api,
+                  unsigned paths,
+                  const volatile sig_atomic_t *working_flag) noexcept;
+
+// Необязательное расширение клиентского ABI (см. PriorityApi.hpp): полоса приоритета у каждого пакета.
+// Если символа нет, ядро работает через Client_Serve (порядок выдачи полос сохраняется).
+PLUGIN_API int  Client_ServePriority(const ClientPriorityApi &api,
+                  unsigned bands,
+                  const volatile sig_atomic_t *working_flag) noexcept;
+
 PLUGIN_API bool Server_Bind(boost::json::object& config) noexcept;
 PLUGIN_API int  Server_Serve(const std::function<ssize_t(std::uint8_t *, std::size_t)> &receive_from_net,
                   const std::function<ssize_t(const std::uint8_t *, std::size_t)> &send_to_net,
                   const volatile sig_atomic_t *working_flag) noexcept;
+
+// Необязательное расширение серверного ABI (см. SessionApi.hpp).
+// Если символа нет, ядро работает через Server_Serve.
+PLUGIN_API int  Server_ServeSessions(const ServerSessionApi &api,
+                  const volatile sig_atomic_t *working_flag) noexcept;
+
+// Необязательное расширение для многопоточного сервера: Server_Bind вызывается
+// один раз (в config есть "shards"), затем Server_ServeShard — из shards потоков.
+// Каждый вызов открывает свой сокет с SO_REUSEPORT и обслуживает только свои сессии.
+PLUGIN_API int  Server_ServeShard(unsigned shard,
+                  unsigned shards,
+                  const ServerSessionApi &api,
+                  const volatile sig_atomic_t *working_flag) noexcept;
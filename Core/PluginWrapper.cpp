@@ -9,6 +9,7 @@
 #include <cstddef>
 #include <boost/json/object.hpp>
 
+#ifdef _WIN32
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -19,14 +20,47 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace
+{
+    void* OpenLibrary(const std::string &path)
+    {
+#ifdef _WIN32
+        return reinterpret_cast<void*>(LoadLibraryA(path.c_str()));
+#else
+        return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+    }
+
+    void CloseLibrary(void *h)
+    {
+#ifdef _WIN32
+        FreeLibrary(reinterpret_cast<HMODULE>(h));
+#else
+        dlclose(h);
+#endif
+    }
+}
 
 namespace PluginWrapper
 {
+    void* SymOptional(void       *h,
+                      const char *name)
+    {
+#ifdef _WIN32
+        return reinterpret_cast<void*>(GetProcAddress(reinterpret_cast<HMODULE>(h), name));
+#else
+        return dlsym(h, name);
+#endif
+    }
+
     void* Sym(void       *h,
                      const char *name)
     {
-        void* ptr = nullptr;
-        ptr = reinterpret_cast<void*>(GetProcAddress(reinterpret_cast<HMODULE>(h), name));
+        void* ptr = SymOptional(h, name);
         if (!ptr)
         {
             std::cerr << "Error in get symbol from plugin\n";
@@ -37,7 +71,7 @@ namespace PluginWrapper
     Plugin Load(const std::string &path)
     {
         Plugin plugin;
-        plugin.handle = LoadLibraryA(path.c_str());
+        plugin.handle = OpenLibrary(path);
 
         if (!plugin.handle)
         {
@@ -57,6 +91,14 @@ namespace PluginWrapper
                 reinterpret_cast<Client_Serve_t>(
                         Sym(plugin.handle, "Client_Serve"));
 
+        plugin.Client_ServeMultipath =
+                reinterpret_cast<Client_ServeMultipath_t>(
+                        SymOptional(plugin.handle, "Client_ServeMultipath"));
+
+        plugin.Client_ServePriority =
+                reinterpret_cast<Client_ServePriority_t>(
+                        SymOptional(plugin.handle, "Client_ServePriority"));
+
         plugin.Server_Bind =
                 reinterpret_cast<Server_Bind_t>(
                         Sym(plugin.handle, "Server_Bind"));
@@ -65,6 +107,14 @@ namespace PluginWrapper
                 reinterpret_cast<Server_Serve_t>(
                         Sym(plugin.handle, "Server_Serve"));
 
+        plugin.Server_ServeSessions =
+                reinterpret_cast<Server_ServeSessions_t>(
+                        SymOptional(plugin.handle, "Server_ServeSessions"));
+
+        plugin.Server_ServeShard =
+                reinterpret_cast<Server_ServeShard_t>(
+                        SymOptional(plugin.handle, "Server_ServeShard"));
+
         const bool fine =
                 plugin.Client_Connect &&
                 plugin.Client_Disconnect &&
@@ -75,7 +125,7 @@ namespace PluginWrapper
         if (!fine)
         {
             std::cerr << "Plugin missing required symbols\n";
-            FreeLibrary(reinterpret_cast<HMODULE>(plugin.handle));
+            CloseLibrary(plugin.handle);
             plugin.handle = nullptr;
         }
 
@@ -86,7 +136,7 @@ namespace PluginWrapper
     {
         if (plugin.handle)
         {
-            FreeLibrary(reinterpret_cast<HMODULE>(plugin.handle));
+            CloseLibrary(plugin.handle);
         }
     }
 
@@ -113,6 +163,32 @@ namespace PluginWrapper
             working_flag);
     }
 
+    bool HasClientMultipath(const Plugin &plugin) noexcept
+    {
+        return plugin.Client_ServeMultipath != nullptr;
+    }
+
+    int Client_ServeMultipath(const Plugin &plugin,
+                              const ClientPathApi &api,
+                              unsigned paths,
+                              const volatile sig_atomic_t *working_flag) noexcept
+    {
+        return plugin.Client_ServeMultipath(api, paths, working_flag);
+    }
+
+    bool HasClientPriority(const Plugin &plugin) noexcept
+    {
+        return plugin.Client_ServePriority != nullptr;
+    }
+
+    int Client_ServePriority(const Plugin &plugin,
+                             const ClientPriorityApi &api,
+                             unsigned bands,
+                             const volatile sig_atomic_t *working_flag) noexcept
+    {
+        return plugin.Client_ServePriority(api, bands, working_flag);
+    }
+
     bool Server_Bind(const Plugin &plugin,
                      boost::json::object& config) noexcept
     {
@@ -130,4 +206,30 @@ namespace PluginWrapper
             send_to_net,
             working_flag);
     }
+
+    bool HasServerSessions(const Plugin &plugin) noexcept
+    {
+        return plugin.Server_ServeSessions != nullptr;
+    }
+
+    int Server_ServeSessions(const Plugin &plugin,
+                             const ServerSessionApi &api,
+                             const volatile sig_atomic_t *working_flag) noexcept
+    {
+        return plugin.Server_ServeSessions(api, working_flag);
+    }
+
+    bool HasServerShards(const Plugin &plugin) noexcept
+    {
+        return plugin.Server_ServeShard != nullptr;
+    }
+
+    int Server_ServeShard(const Plugin &plugin,
+                          unsigned shard,
+                          unsigned shards,
+                          const ServerSessionApi &api,
+                          const volatile sig_atomic_t *working_flag) noexcept
+    {
+        return plugin.Server_ServeShard(shard, shards, api, working_flag);
+    }
 }
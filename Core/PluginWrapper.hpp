@@ -7,8 +7,14 @@
 #include <cstddef>
 #include <boost/json/object.hpp>
 
+#ifdef _WIN32
 #include <BaseTsd.h>
 #define ssize_t SSIZE_T
+#endif
+
+#include "SessionApi.hpp"
+#include "PathApi.hpp"
+#include "PriorityApi.hpp"
 
 namespace PluginWrapper
 {
@@ -40,6 +46,30 @@ namespace PluginWrapper
                                 std::size_t len)> &send_to_net,
     const volatile sig_atomic_t *working_flag) noexcept;
 
+    /**
+     * @brief Тип необязательной функции плагина для многопутевого клиентского цикла.
+     * @param api Колбэки ядра (receive_from_net/send_to_net/path_state).
+     * @param paths Число путей (элементов "uplinks" в конфиге Client_Connect).
+     * @param working_flag Указатель на флаг продолжения работы.
+     * @return Код завершения работы.
+     */
+    using Client_ServeMultipath_t =
+            int (*)(const ClientPathApi &api,
+                    unsigned paths,
+                    const volatile sig_atomic_t *working_flag) noexcept;
+
+    /**
+     * @brief Тип необязательной функции плагина для клиента с полосами приоритета.
+     * @param api Колбэки ядра (receive_from_net с полосой, send_to_net).
+     * @param bands Число полос (0 — высший приоритет).
+     * @param working_flag Указатель на флаг продолжения работы.
+     * @return Код завершения работы.
+     */
+    using Client_ServePriority_t =
+            int (*)(const ClientPriorityApi &api,
+                    unsigned bands,
+                    const volatile sig_atomic_t *working_flag) noexcept;
+
     /**
      * @brief Тип функции плагина для привязки сервера к порту.
      * @param config Объект JSON.
@@ -62,6 +92,30 @@ namespace PluginWrapper
                                 std::size_t len)> &send_to_net,
     const volatile sig_atomic_t *working_flag) noexcept;
 
+    /**
+     * @brief Тип необязательной функции плагина для сессионного цикла сервера.
+     * @param api Колбэки ядра (open/close/receive_from_net/send_to_net).
+     * @param working_flag Указатель на флаг продолжения работы.
+     * @return Код завершения работы.
+     */
+    using Server_ServeSessions_t =
+            int (*)(const ServerSessionApi &api,
+                    const volatile sig_atomic_t *working_flag) noexcept;
+
+    /**
+     * @brief Тип необязательной функции плагина для одного шарда многопоточного сервера.
+     * @param shard Номер шарда (0..shards-1).
+     * @param shards Общее число шардов.
+     * @param api Колбэки ядра, привязанные к шарду.
+     * @param working_flag Указатель на флаг продолжения работы.
+     * @return Код завершения работы.
+     */
+    using Server_ServeShard_t =
+            int (*)(unsigned shard,
+                    unsigned shards,
+                    const ServerSessionApi &api,
+                    const volatile sig_atomic_t *working_flag) noexcept;
+
     /**
      * @brief Структура для хранения загруженного плагина и указателей на его функции.
      */
@@ -71,8 +125,12 @@ namespace PluginWrapper
         Client_Connect_t    Client_Connect    = nullptr; ///< Указатель на функцию Client_Connect.
         Client_Disconnect_t Client_Disconnect = nullptr; ///< Указатель на функцию Client_Disconnect.
         Client_Serve_t      Client_Serve      = nullptr; ///< Указатель на функцию Client_Serve.
+        Client_ServeMultipath_t Client_ServeMultipath = nullptr; ///< Необязательная Client_ServeMultipath (может отсутствовать).
+        Client_ServePriority_t Client_ServePriority = nullptr; ///< Необязательная Client_ServePriority (может отсутствовать).
         Server_Bind_t       Server_Bind       = nullptr; ///< Указатель на функцию Server_Bind.
         Server_Serve_t      Server_Serve      = nullptr; ///< Указатель на функцию Server_Serve.
+        Server_ServeSessions_t Server_ServeSessions = nullptr; ///< Необязательная Server_ServeSessions (может отсутствовать).
+        Server_ServeShard_t Server_ServeShard = nullptr; ///< Необязательная Server_ServeShard (может отсутствовать).
 
         Plugin() = default;
     };
@@ -85,6 +143,14 @@ namespace PluginWrapper
      */
     void* Sym(void *h, const char *name);
 
+    /**
+     * @brief Получает необязательный символ: отсутствие не считается ошибкой.
+     * @param h Дескриптор открытой библиотеки.
+     * @param name Имя экспортируемого символа.
+     * @return Указатель на символ или nullptr.
+     */
+    void* SymOptional(void *h, const char *name);
+
     /**
      * @brief Загружает плагин и инициализирует его функции.
      * @param path Путь к файлу плагина (.so).
@@ -128,6 +194,46 @@ namespace PluginWrapper
                                 std::size_t len)> &send_to_net,
     const volatile sig_atomic_t *working_flag) noexcept;
 
+    /**
+     * @brief Поддерживает ли плагин многопутевой клиентский цикл.
+     * @param plugin Загруженный плагин.
+     * @return true, если экспортирована Client_ServeMultipath.
+     */
+    bool HasClientMultipath(const Plugin &plugin) noexcept;
+
+    /**
+     * @brief Вызывает функцию Client_ServeMultipath плагина.
+     * @param plugin Загруженный плагин (HasClientMultipath() == true).
+     * @param api Колбэки ядра.
+     * @param paths Число путей.
+     * @param working_flag Указатель на флаг продолжения работы.
+     * @return Код завершения работы.
+     */
+    int Client_ServeMultipath(const Plugin &plugin,
+                              const ClientPathApi &api,
+                              unsigned paths,
+                              const volatile sig_atomic_t *working_flag) noexcept;
+
+    /**
+     * @brief Поддерживает ли плагин полосы приоритета.
+     * @param plugin Загруженный плагин.
+     * @return true, если экспортирована Client_ServePriority.
+     */
+    bool HasClientPriority(const Plugin &plugin) noexcept;
+
+    /**
+     * @brief Вызывает функцию Client_ServePriority плагина.
+     * @param plugin Загруженный плагин (HasClientPriority() == true).
+     * @param api Колбэки ядра.
+     * @param bands Число полос.
+     * @param working_flag Указатель на флаг продолжения работы.
+     * @return Код завершения работы.
+     */
+    int Client_ServePriority(const Plugin &plugin,
+                             const ClientPriorityApi &api,
+                             unsigned bands,
+                             const volatile sig_atomic_t *working_flag) noexcept;
+
     /**
      * @brief Вызывает функцию Server_Bind плагина.
      * @param plugin Загруженный плагин.
@@ -150,4 +256,44 @@ namespace PluginWrapper
     const std::function<ssize_t(const std::uint8_t *buf,
                                 std::size_t len)> &send_to_net,
     const volatile sig_atomic_t *working_flag) noexcept;
+
+    /**
+     * @brief Поддерживает ли плагин сессионный серверный цикл.
+     * @param plugin Загруженный плагин.
+     * @return true, если экспортирована Server_ServeSessions.
+     */
+    bool HasServerSessions(const Plugin &plugin) noexcept;
+
+    /**
+     * @brief Вызывает функцию Server_ServeSessions плагина.
+     * @param plugin Загруженный плагин (HasServerSessions() == true).
+     * @param api Колбэки ядра.
+     * @param working_flag Указатель на флаг продолжения работы.
+     * @return Код завершения работы.
+     */
+    int Server_ServeSessions(const Plugin &plugin,
+                             const ServerSessionApi &api,
+                             const volatile sig_atomic_t *working_flag) noexcept;
+
+    /**
+     * @brief Поддерживает ли плагин шардированный серверный цикл.
+     * @param plugin Загруженный плагин.
+     * @return true, если экспортирована Server_ServeShard.
+     */
+    bool HasServerShards(const Plugin &plugin) noexcept;
+
+    /**
+     * @brief Вызывает функцию Server_ServeShard плагина.
+     * @param plugin Загруженный плагин (HasServerShards() == true).
+     * @param shard Номер шарда.
+     * @param shards Общее число шардов.
+     * @param api Колбэки ядра, привязанные к шарду.
+     * @param working_flag Указатель на флаг продолжения работы.
+     * @return Код завершения работы.
+     */
+    int Server_ServeShard(const Plugin &plugin,
+                          unsigned shard,
+                          unsigned shards,
+                          const ServerSessionApi &api,
+                          const volatile sig_atomic_t *working_flag) noexcept;
 }
@@ -0,0 +1,32 @@
+#pragma once
+// PriorityApi.hpp — необязательное расширение клиентского ABI плагина: полосы приоритета.
+// Плагин, экспортирующий Client_ServePriority, получает вместе с каждым пакетом его полосу
+// и может отобразить её на свой транспорт (отдельные потоки/стримы, DSCP внешнего сокета).
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <BaseTsd.h>
+#ifndef ssize_t
+#define ssize_t SSIZE_T
+#endif
+#endif
+
+/**
+ * @brief Колбэки ядра для клиентского цикла с полосами приоритета.
+ *
+ * Полоса 0 — высший приоритет (реальное время), bands-1 — фоновый трафик.
+ * Ядро уже выдаёт пакеты в порядке приоритета; плагину остаётся не смешивать
+ * полосы в одной очереди транспорта (иначе голова полосы 0 ждёт за объёмной).
+ */
+struct ClientPriorityApi
+{
+    /// @brief Пакет из TUN для отправки серверу: в *band — его полоса. 0 — пакетов нет.
+    std::function<ssize_t(unsigned *band, std::uint8_t *buf, std::size_t len)> receive_from_net;
+
+    /// @brief Пакет от сервера в TUN.
+    std::function<ssize_t(const std::uint8_t *buf, std::size_t len)> send_to_net;
+};
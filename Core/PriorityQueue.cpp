@@ -0,0 +1,279 @@
+// PriorityQueue.cpp — реализация полос строгого приоритета.
+
+#include "PriorityQueue.hpp"
+
+#include "PacketMeta.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    /// @brief Полоса DSCP в базовой раскладке из четырёх полос.
+    unsigned DscpBand4(unsigned dscp) noexcept
+    {
+        switch (dscp)
+        {
+        case 46:   // EF
+        case 44:   // VOICE-ADMIT
+        case 40:   // CS5
+        case 48:   // CS6
+        case 56:   // CS7
+            return 0;
+        case 32: case 34: case 36: case 38:   // CS4, AF4x
+        case 24: case 26: case 28: case 30:   // CS3, AF3x
+        case 16: case 18: case 20: case 22:   // CS2, AF2x
+            return 1;
+        case 8:  case 10: case 12: case 14:   // CS1, AF1x
+        case 1:                               // LE
+            return 3;
+        default:
+            return 2;
+        }
+    }
+}
+
+PriorityQueue::PriorityQueue(const Options &opts)
+    : opts_(opts)
+    , classifier_(opts.rules)
+{
+    if (opts.bands == 0 || opts.bands > kMaxBands || opts.limit == 0 || opts.slot_size == 0 ||
+        opts.slot_size > UINT32_MAX || opts.max_wait.count() <= 0 || opts.burst.count() <= 0)
+    {
+        throw std::invalid_argument("PriorityQueue: invalid options");
+    }
+    for (const Classifier::Rule &r : opts.rules)
+    {
+        if (r.target >= opts.bands)
+        {
+            throw std::invalid_argument("PriorityQueue: rule refers to band " + std::to_string(r.target) +
+                                        " of " + std::to_string(opts.bands));
+        }
+    }
+    storage_.resize(opts.bands * opts.limit * opts.slot_size);
+    lanes_.resize(opts.bands);
+    for (Lane &l : lanes_)
+    {
+        l.lengths.resize(opts.limit);
+        l.at.resize(opts.limit);
+    }
+    SetRate(opts.rate_kbps);
+}
+
+unsigned PriorityQueue::Band(const std::uint8_t *pkt,
+                             std::size_t len) const noexcept
+{
+    const int rule = classifier_.MatchIndex(pkt, len);
+    if (rule >= 0)
+    {
+        return opts_.rules[static_cast<std::size_t>(rule)].target;
+    }
+    return DscpBand(PacketDscp(pkt, len), opts_.bands);
+}
+
+unsigned PriorityQueue::Band(const std::uint8_t *pkt,
+                             std::size_t len,
+                             const PacketMeta &meta,
+                             std::size_t i) const noexcept
+{
+    if (!meta.Ip(i))
+    {
+        return Band(pkt, len);
+    }
+    const int rule = classifier_.MatchIndex(meta, i);
+    if (rule >= 0)
+    {
+        return opts_.rules[static_cast<std::size_t>(rule)].target;
+    }
+    return DscpBand(meta.Dscp(i), opts_.bands);
+}
+
+unsigned PriorityQueue::DscpBand(unsigned dscp,
+                                 unsigned bands) noexcept
+{
+    if (bands <= 1)
+    {
+        return 0;
+    }
+    // Четыре базовые полосы растягиваются или сжимаются на bands с округлением.
+    return (DscpBand4(dscp) * (bands - 1) + 1) / 3;
+}
+
+unsigned PriorityQueue::PacketDscp(const std::uint8_t *pkt,
+                                   std::size_t len) noexcept
+{
+    if (len < 2)
+    {
+        return 0;
+    }
+    switch (pkt[0] >> 4)
+    {
+    case 4:
+        return pkt[1] >> 2;
+    case 6:
+        return (((pkt[0] & 0x0Fu) << 4) | (pkt[1] >> 4)) >> 2;
+    default:
+        return 0;
+    }
+}
+
+bool PriorityQueue::Enqueue(const std::uint8_t *data,
+                            std::size_t len,
+                            Clock::time_point now) noexcept
+{
+    if (len == 0 || len > opts_.slot_size)
+    {
+        return false;
+    }
+    return Insert(data, len, now, Band(data, len));
+}
+
+bool PriorityQueue::Enqueue(const std::uint8_t *data,
+                            std::size_t len,
+                            Clock::time_point now,
+                            const PacketMeta &meta,
+                            std::size_t i) noexcept
+{
+    if (len == 0 || len > opts_.slot_size)
+    {
+        return false;
+    }
+    return Insert(data, len, now, Band(data, len, meta, i));
+}
+
+bool PriorityQueue::Insert(const std::uint8_t *data,
+                           std::size_t len,
+                           Clock::time_point now,
+                           unsigned band) noexcept
+{
+    Lane &l = lanes_[band];
+    if (l.count == opts_.limit)
+    {
+        // Полоса полна: вытесняется самый старый пакет.
+        l.head = (l.head + 1) % opts_.limit;
+        --l.count;
+        --packets_;
+        ++l.stats.dropped;
+    }
+    if (l.count == 0)
+    {
+        l.served_at = now;
+    }
+    const std::size_t tail = (l.head + l.count) % opts_.limit;
+    std::memcpy(Slot(band, tail), data, len);
+    l.lengths[tail] = static_cast<std::uint32_t>(len);
+    l.at[tail]      = now;
+    ++l.count;
+    ++packets_;
+    ++l.stats.enqueued;
+    ++stats_.enqueued;
+    return true;
+}
+
+std::size_t PriorityQueue::Dequeue(std::uint8_t *out,
+                                   std::size_t size,
+                                   Clock::time_point now,
+                                   unsigned *band) noexcept
+{
+    if (packets_ == 0)
+    {
+        return 0;
+    }
+    if (rate_kbps_ != 0)
+    {
+        const auto elapsed = std::chrono::duration<double>(now - refill_at_).count();
+        if (elapsed > 0)
+        {
+            tokens_ = std::min(burst_bytes_, tokens_ + elapsed * static_cast<double>(rate_kbps_) * 125.0);
+            refill_at_ = now;
+        }
+        if (tokens_ < 0)
+        {
+            ++stats_.throttled;
+            return 0;
+        }
+    }
+    while (packets_ != 0)
+    {
+        unsigned pick = opts_.bands;
+        for (unsigned b = 0; b < opts_.bands; ++b)
+        {
+            if (lanes_[b].count != 0)
+            {
+                pick = b;
+                break;
+            }
+        }
+        // Защита от голодания: из низших полос без выдачи дольше max_wait — дольше всех ждущая.
+        bool aged = false;
+        Clock::time_point oldest = now - opts_.max_wait;
+        for (unsigned b = pick + 1; b < opts_.bands; ++b)
+        {
+            const Lane &l = lanes_[b];
+            if (l.count != 0 && l.served_at <= oldest)
+            {
+                oldest = l.served_at;
+                pick   = b;
+                aged   = true;
+            }
+        }
+
+        Lane &l = lanes_[pick];
+        const std::size_t slot = l.head;
+        const std::size_t len  = l.lengths[slot];
+        l.head = (l.head + 1) % opts_.limit;
+        l.served_at = now;
+        --l.count;
+        --packets_;
+        if (len > size)
+        {
+            ++l.stats.dropped;
+            continue;
+        }
+        std::memcpy(out, Slot(pick, slot), len);
+        const auto wait = std::chrono::duration_cast<std::chrono::microseconds>(now - l.at[slot]).count();
+        l.stats.max_wait_us = std::max<std::uint64_t>(l.stats.max_wait_us, static_cast<std::uint64_t>(std::max<std::int64_t>(wait, 0)));
+        ++l.stats.dequeued;
+        if (aged)
+        {
+            ++l.stats.aged;
+        }
+        ++stats_.dequeued;
+        if (rate_kbps_ != 0)
+        {
+            tokens_ -= static_cast<double>(len);
+        }
+        if (band != nullptr)
+        {
+            *band = pick;
+        }
+        return len;
+    }
+    return 0;
+}
+
+void PriorityQueue::SetRate(std::uint64_t kbps) noexcept
+{
+    rate_kbps_ = kbps;
+    if (kbps == 0)
+    {
+        return;
+    }
+    const double burst = std::chrono::duration<double>(opts_.burst).count() * static_cast<double>(kbps) * 125.0;
+    burst_bytes_ = std::max(burst, 2.0 * static_cast<double>(opts_.slot_size));
+    tokens_      = std::min(tokens_, burst_bytes_);
+}
+
+bool PriorityQueue::GetBandStats(unsigned band,
+                                 BandStats *out) const noexcept
+{
+    if (band >= lanes_.size())
+    {
+        return false;
+    }
+    *out = lanes_[band].stats;
+    out->backlog = lanes_[band].count;
+    return true;
+}
@@ -0,0 +1,185 @@
+#pragma once
+// PriorityQueue.hpp — полосы строгого приоритета по DSCP и правилам, с защитой от голодания.
+
+#include "Classifier.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Несколько FIFO-полос, выдаваемых в строгом приоритете.
+ *
+ * - Полоса пакета — по первому совпавшему правилу (Classifier, target — полоса),
+ *   иначе по DSCP: EF/VA/CS5+ — реальное время, AF2x–AF4x/CS2–CS4 — интерактивный,
+ *   CS0 и прочее — обычный, CS1/LE/AF1x — фоновый (при bands != 4 пропорционально).
+ * - Выдаётся голова высшей непустой полосы; но если непустую низшую полосу
+ *   не обслуживали дольше max_wait, выдаётся её пакет (защита от голодания:
+ *   поток с высокой меткой не может остановить остальной трафик). Считается
+ *   время без обслуживания, а не возраст головы: собственная очередь объёмной
+ *   полосы не должна отбирать выдачу у реального времени.
+ * - Переполненная полоса теряет самый старый пакет: для реального времени
+ *   свежий пакет ценнее.
+ * - rate_kbps > 0 — выдача не быстрее заданной скорости: очередь образуется
+ *   здесь, где порядок выдачи наш, а не в буфере сокета или модема.
+ *
+ * Класс не потокобезопасен (кроме Band): синхронизация — на стороне владельца.
+ */
+class PriorityQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Предел числа полос.
+    static constexpr unsigned kMaxBands = 8;
+    /// @brief Число полос по умолчанию.
+    static constexpr unsigned kDefaultBands = 4;
+
+    /**
+     * @brief Параметры очереди.
+     */
+    struct Options
+    {
+        /// @brief Число полос (1..kMaxBands).
+        unsigned bands = kDefaultBands;
+        /// @brief Пакетов в каждой полосе.
+        std::size_t limit = 256;
+        /// @brief Максимальный размер пакета.
+        std::size_t slot_size = 1500;
+        /// @brief Непустая полоса без обслуживания дольше — получает пакет вне очереди.
+        std::chrono::microseconds max_wait{50000};
+        /// @brief Скорость выдачи, кбит/с (0 — без ограничения).
+        std::uint64_t rate_kbps = 0;
+        /// @brief Глубина token bucket во времени (не меньше двух пакетов).
+        std::chrono::microseconds burst{2000};
+        /// @brief Правила поверх DSCP; target — полоса.
+        std::vector<Classifier::Rule> rules;
+    };
+
+    /**
+     * @brief Счётчики полосы.
+     */
+    struct BandStats
+    {
+        std::uint64_t enqueued    = 0;
+        std::uint64_t dequeued    = 0;
+        std::uint64_t dropped     = 0;   ///< Вытеснено переполнением.
+        std::uint64_t aged        = 0;   ///< Выдано вне очереди защитой от голодания.
+        std::uint64_t max_wait_us = 0;   ///< Наибольшее время в очереди выданного пакета.
+        std::size_t   backlog     = 0;
+    };
+
+    /**
+     * @brief Общие счётчики.
+     */
+    struct Stats
+    {
+        std::uint64_t enqueued  = 0;
+        std::uint64_t dequeued  = 0;
+        std::uint64_t throttled = 0;   ///< Выдач, отложенных ограничением скорости.
+    };
+
+    /**
+     * @brief Создать очередь (память под все полосы выделяется здесь).
+     * @throw std::invalid_argument Некорректные Options или правило с несуществующей полосой.
+     */
+    explicit PriorityQueue(const Options &opts);
+
+    PriorityQueue(const PriorityQueue &) = delete;
+    PriorityQueue &operator=(const PriorityQueue &) = delete;
+
+    /**
+     * @brief Полоса пакета (только чтение — можно из любого потока).
+     */
+    unsigned Band(const std::uint8_t *pkt, std::size_t len) const noexcept;
+
+    /**
+     * @brief Полоса разобранного пакета i пачки (не-IP — по байтам pkt, len).
+     */
+    unsigned Band(const std::uint8_t *pkt, std::size_t len, const PacketMeta &meta, std::size_t i) const noexcept;
+
+    /**
+     * @brief Полоса по DSCP для bands полос.
+     */
+    static unsigned DscpBand(unsigned dscp, unsigned bands) noexcept;
+
+    /**
+     * @brief DSCP IP-пакета (0 для не-IP).
+     */
+    static unsigned PacketDscp(const std::uint8_t *pkt, std::size_t len) noexcept;
+
+    /**
+     * @brief Поставить копию пакета в его полосу.
+     * @return false — пакет отброшен (больше слота).
+     */
+    bool Enqueue(const std::uint8_t *data, std::size_t len, Clock::time_point now) noexcept;
+
+    /**
+     * @brief Enqueue с полосой по метаданным пакета i пачки.
+     */
+    bool Enqueue(const std::uint8_t *data, std::size_t len, Clock::time_point now,
+                 const PacketMeta &meta, std::size_t i) noexcept;
+
+    /**
+     * @brief Выдать следующий пакет.
+     * @param band Если не nullptr — полоса выданного пакета.
+     * @return Длина пакета в out; 0 — очередь пуста или скорость исчерпана.
+     */
+    std::size_t Dequeue(std::uint8_t *out, std::size_t size, Clock::time_point now, unsigned *band = nullptr) noexcept;
+
+    /**
+     * @brief Изменить скорость выдачи (0 — без ограничения).
+     */
+    void SetRate(std::uint64_t kbps) noexcept;
+
+    /** @brief Текущая скорость выдачи, кбит/с. */
+    std::uint64_t Rate() const noexcept { return rate_kbps_; }
+
+    /** @brief Число полос. */
+    unsigned Bands() const noexcept { return opts_.bands; }
+
+    /** @brief Пакетов во всех полосах. */
+    std::size_t Packets() const noexcept { return packets_; }
+
+    /** @brief Общие счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+    /**
+     * @brief Счётчики полосы.
+     * @return false — нет такой полосы.
+     */
+    bool GetBandStats(unsigned band, BandStats *out) const noexcept;
+
+private:
+    struct Lane
+    {
+        std::size_t                    head  = 0;
+        std::size_t                    count = 0;
+        std::vector<std::uint32_t>     lengths;
+        std::vector<Clock::time_point> at;
+        Clock::time_point              served_at;   ///< Последняя выдача или начало ожидания.
+        BandStats                      stats;
+    };
+
+    Options                   opts_;
+    Classifier                classifier_;
+    std::vector<std::uint8_t> storage_;   ///< bands * limit * slot_size.
+    std::vector<Lane>         lanes_;
+    std::size_t               packets_ = 0;
+
+    std::uint64_t     rate_kbps_ = 0;
+    double            tokens_ = 0;
+    double            burst_bytes_ = 0;
+    Clock::time_point refill_at_;
+
+    Stats stats_;
+
+    /// @brief Поставить копию пакета в полосу band.
+    bool Insert(const std::uint8_t *data, std::size_t len, Clock::time_point now, unsigned band) noexcept;
+
+    std::uint8_t *Slot(unsigned band, std::size_t index) noexcept
+    {
+        return storage_.data() + (band * opts_.limit + index) * opts_.slot_size;
+    }
+};
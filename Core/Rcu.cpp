@@ -0,0 +1,139 @@
+// Rcu.cpp — реализация epoch-based RCU.
+
+#include "Rcu.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+namespace
+{
+    /// @brief Максимум потоков-читателей с собственным слотом; остальные — через общий счётчик.
+    constexpr std::size_t kMaxReaders = 512;
+
+    /// @brief Слот читателя: эпоха входа в секцию или 0, если поток вне секции.
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<std::uint64_t> epoch{0};
+    };
+
+    std::atomic<std::uint64_t>              g_epoch{1};
+    std::array<ReaderSlot, kMaxReaders>     g_slots;
+    std::array<std::atomic<bool>, kMaxReaders> g_slot_used{};
+    /// @brief Читатели без собственного слота (исчерпан пул).
+    alignas(64) std::atomic<std::uint64_t>  g_overflow_active{0};
+
+    /// @brief Владение слотом на время жизни потока.
+    struct ThreadSlot
+    {
+        std::size_t index   = kMaxReaders;
+        unsigned    nesting = 0;
+        bool        overflow = false;
+
+        ThreadSlot()
+        {
+            for (std::size_t i = 0; i < kMaxReaders; ++i)
+            {
+                bool expected = false;
+                if (!g_slot_used[i].load(std::memory_order_relaxed) &&
+                    g_slot_used[i].compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+                {
+                    index = i;
+                    break;
+                }
+            }
+        }
+
+        ~ThreadSlot()
+        {
+            if (index < kMaxReaders)
+            {
+                g_slots[index].epoch.store(0, std::memory_order_release);
+                g_slot_used[index].store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    ThreadSlot &Self()
+    {
+        thread_local ThreadSlot slot;
+        return slot;
+    }
+}
+
+namespace Rcu
+{
+    ReadGuard::ReadGuard() noexcept
+    {
+        ThreadSlot &self = Self();
+        if (self.nesting++ != 0)
+        {
+            return;
+        }
+        if (self.index < kMaxReaders)
+        {
+            // seq_cst: запись слота должна быть видна до чтения защищаемого указателя.
+            g_slots[self.index].epoch.store(g_epoch.load(std::memory_order_seq_cst),
+                                            std::memory_order_seq_cst);
+        }
+        else
+        {
+            self.overflow = true;
+            g_overflow_active.fetch_add(1, std::memory_order_seq_cst);
+        }
+    }
+
+    ReadGuard::~ReadGuard()
+    {
+        ThreadSlot &self = Self();
+        if (--self.nesting != 0)
+        {
+            return;
+        }
+        if (self.overflow)
+        {
+            self.overflow = false;
+            g_overflow_active.fetch_sub(1, std::memory_order_release);
+        }
+        else
+        {
+            g_slots[self.index].epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    void Synchronize() noexcept
+    {
+        // Читатели с эпохой >= target вошли после публикации и видят новую версию.
+        const std::uint64_t target = g_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+        for (std::size_t i = 0; i < kMaxReaders; ++i)
+        {
+            if (!g_slot_used[i].load(std::memory_order_acquire))
+            {
+                continue;
+            }
+            for (unsigned spins = 0;; ++spins)
+            {
+                const std::uint64_t e = g_slots[i].epoch.load(std::memory_order_seq_cst);
+                if (e == 0 || e >= target)
+                {
+                    break;
+                }
+                if (spins > 64)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        for (unsigned spins = 0; g_overflow_active.load(std::memory_order_seq_cst) != 0; ++spins)
+        {
+            if (spins > 64)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
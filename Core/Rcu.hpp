@@ -0,0 +1,36 @@
+#pragma once
+// Rcu.hpp — минимальный RCU (epoch-based) для структур с lock-free чтением на data path.
+
+/**
+ * @brief Домен RCU процесса.
+ *
+ * Читатель оборачивает доступ к разделяемому указателю в ReadGuard
+ * (две записи в собственную кэш-линию потока, без RMW-атомиков на общих данных).
+ * Писатель публикует новую версию атомарной заменой указателя, вызывает
+ * Synchronize() — дождаться выхода читателей, начавших до публикации, —
+ * и только после этого освобождает старую версию.
+ *
+ * Критические секции читателей должны быть короткими (поиск в таблице),
+ * блокирующие вызовы внутри ReadGuard запрещены.
+ */
+namespace Rcu
+{
+    /**
+     * @brief RAII-секция чтения. Допускает вложенность в одном потоке.
+     */
+    class ReadGuard
+    {
+    public:
+        ReadGuard() noexcept;
+        ~ReadGuard();
+
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard &operator=(const ReadGuard &) = delete;
+    };
+
+    /**
+     * @brief Дождаться завершения всех секций чтения, начатых до вызова.
+     * @note Вызывать только вне ReadGuard (иначе взаимоблокировка).
+     */
+    void Synchronize() noexcept;
+}
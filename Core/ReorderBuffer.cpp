@@ -0,0 +1,172 @@
+// ReorderBuffer.cpp — реализация окна переупорядочивания.
+
+#include "ReorderBuffer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    /// @brief Корзина гистограммы опережения: 1, 2–3, 4–7, 8–15, 16+.
+    inline std::size_t DepthBucket(std::uint32_t depth) noexcept
+    {
+        const auto width = static_cast<std::size_t>(std::bit_width(depth));
+        return std::min<std::size_t>(width - 1, 4);
+    }
+}
+
+ReorderBuffer::ReorderBuffer(const Options &opts,
+                             DeliverFn deliver)
+    : deliver_(std::move(deliver))
+    , slot_size_(opts.slot_size)
+    , hold_(opts.hold)
+{
+    if (slot_size_ == 0 || opts.hold.count() <= 0 || !deliver_)
+    {
+        throw std::invalid_argument("ReorderBuffer: invalid options");
+    }
+    const std::size_t window = std::bit_ceil(std::max<std::size_t>(opts.window, 2));
+    mask_ = window - 1;
+    slots_.resize(window);
+    storage_.resize(window * slot_size_);
+}
+
+void ReorderBuffer::Push(std::uint32_t seq,
+                         const std::uint8_t *data,
+                         std::size_t len,
+                         Clock::time_point now)
+{
+    auto ahead = static_cast<std::int32_t>(seq - next_);
+    if (ahead < 0)
+    {
+        ++stats_.late;
+        deliver_(data, len);
+        return;
+    }
+    if (ahead == 0)
+    {
+        ++stats_.in_order;
+        deliver_(data, len);
+        ++next_;
+        Drain();
+        return;
+    }
+    if (len > slot_size_)
+    {
+        // Удержать не во что — лучше не по порядку, чем потерять.
+        ++stats_.late;
+        deliver_(data, len);
+        return;
+    }
+
+    const auto window = static_cast<std::uint32_t>(slots_.size());
+    if (static_cast<std::uint32_t>(ahead) >= window)
+    {
+        ++stats_.overflow;
+        AdvanceTo(seq - window + 1);
+        ahead = static_cast<std::int32_t>(seq - next_);
+        if (ahead == 0)
+        {
+            ++stats_.in_order;
+            deliver_(data, len);
+            ++next_;
+            Drain();
+            return;
+        }
+    }
+
+    Slot &slot = slots_[seq & mask_];
+    if (slot.used)
+    {
+        ++stats_.duplicates;
+        return;
+    }
+    slot.used = true;
+    slot.seq  = seq;
+    slot.len  = static_cast<std::uint32_t>(len);
+    slot.at   = now;
+    std::memcpy(storage_.data() + (seq & mask_) * slot_size_, data, len);
+    ++held_;
+
+    const auto depth = static_cast<std::uint32_t>(ahead);
+    stats_.max_depth = std::max<std::uint64_t>(stats_.max_depth, depth);
+    ++stats_.depth[DepthBucket(depth)];
+}
+
+void ReorderBuffer::Expire(Clock::time_point now)
+{
+    while (held_ != 0)
+    {
+        // Первый удержанный после дыры — самый старый кандидат на выпуск.
+        std::uint32_t s = next_;
+        while (!slots_[s & mask_].used)
+        {
+            ++s;
+        }
+        if (now - slots_[s & mask_].at < hold_)
+        {
+            return;
+        }
+        AdvanceTo(s);
+    }
+}
+
+void ReorderBuffer::Reset() noexcept
+{
+    for (Slot &slot : slots_)
+    {
+        slot.used = false;
+    }
+    held_ = 0;
+    next_ = 0;
+}
+
+void ReorderBuffer::Drain()
+{
+    while (held_ != 0)
+    {
+        Slot &slot = slots_[next_ & mask_];
+        if (!slot.used || slot.seq != next_)
+        {
+            return;
+        }
+        slot.used = false;
+        --held_;
+        ++stats_.reordered;
+        deliver_(storage_.data() + (next_ & mask_) * slot_size_, slot.len);
+        ++next_;
+    }
+}
+
+void ReorderBuffer::AdvanceTo(std::uint32_t target)
+{
+    if (static_cast<std::int32_t>(target - next_) <= 0)
+    {
+        return;
+    }
+    // Удержанное лежит только в пределах окна от next_: дальше — одни дыры.
+    const std::uint32_t distance = target - next_;
+    const std::uint32_t steps    = std::min(distance, static_cast<std::uint32_t>(slots_.size()));
+    for (std::uint32_t i = 0; i < steps; ++i)
+    {
+        Slot &slot = slots_[next_ & mask_];
+        if (slot.used && slot.seq == next_)
+        {
+            slot.used = false;
+            --held_;
+            ++stats_.reordered;
+            deliver_(storage_.data() + (next_ & mask_) * slot_size_, slot.len);
+        }
+        else
+        {
+            ++stats_.skipped;
+        }
+        ++next_;
+    }
+    stats_.skipped += distance - steps;
+    next_ = target;
+    Drain();
+}
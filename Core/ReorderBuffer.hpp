@@ -0,0 +1,116 @@
+#pragma once
+// ReorderBuffer.hpp — восстановление порядка пакетов по seq с ограниченным временем удержания.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Окно переупорядочивания пакетов одного отправителя.
+ *
+ * Пакеты пронумерованы отправителем (CoreFrame::Type::Seq) с нуля; перескок
+ * нумерации вперёд обрабатывается как переполнение окна. Пакет со следующим
+ * ожидаемым seq отдаётся сразу, а за ним — всё, что уже ждало в окне подряд
+ * (дыра закрылась — выпуск без ожидания). Пакет «из будущего» удерживается
+ * не дольше hold: по истечении дыра считается потерей и пропускается.
+ * Опоздавший пакет (seq уже пройден) отдаётся сразу — TCP справится с ним
+ * лучше, чем с потерей. Пакет, не помещающийся в окно, сдвигает окно вперёд.
+ *
+ * Память под все слоты выделяется в конструкторе. Класс не потокобезопасен:
+ * синхронизация — на стороне владельца.
+ */
+class ReorderBuffer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Параметры окна.
+     */
+    struct Options
+    {
+        /// @brief Ёмкость окна в пакетах (округляется вверх до степени двойки, минимум 2).
+        std::size_t window = 64;
+        /// @brief Максимальный размер пакета.
+        std::size_t slot_size = 1500;
+        /// @brief Сколько удерживать пакет в ожидании дыры перед ним.
+        std::chrono::milliseconds hold{30};
+    };
+
+    /**
+     * @brief Счётчики окна.
+     */
+    struct Stats
+    {
+        std::uint64_t in_order   = 0;   ///< Отдано сразу (ожидаемый seq).
+        std::uint64_t reordered  = 0;   ///< Отдано после удержания, по порядку.
+        std::uint64_t late       = 0;   ///< Опоздавших (seq уже пройден), отдано сразу.
+        std::uint64_t duplicates = 0;   ///< Повторов уже удерживаемого seq (отброшено).
+        std::uint64_t skipped    = 0;   ///< seq, так и не пришедших (дыра пропущена).
+        std::uint64_t overflow   = 0;   ///< Сдвигов окна пакетом «из далёкого будущего».
+        std::uint64_t max_depth  = 0;   ///< Наибольшее опережение удержанного пакета.
+        /// @brief Гистограмма опережения: 1, 2–3, 4–7, 8–15, 16+.
+        std::uint64_t depth[5]   = {};
+    };
+
+    /** @brief Выдача пакета по порядку. */
+    using DeliverFn = std::function<void(const std::uint8_t *data, std::size_t len)>;
+
+    /**
+     * @brief Создать окно.
+     * @throw std::invalid_argument Нулевой slot_size или hold.
+     */
+    ReorderBuffer(const Options &opts, DeliverFn deliver);
+
+    ReorderBuffer(const ReorderBuffer &) = delete;
+    ReorderBuffer &operator=(const ReorderBuffer &) = delete;
+
+    /**
+     * @brief Принять пакет с номером seq; всё, что можно отдать по порядку, отдаётся сразу.
+     */
+    void Push(std::uint32_t seq, const std::uint8_t *data, std::size_t len, Clock::time_point now);
+
+    /**
+     * @brief Отдать пакеты, чьё удержание истекло (дыры перед ними пропускаются).
+     */
+    void Expire(Clock::time_point now);
+
+    /**
+     * @brief Новый поток нумерации: удерживаемые пакеты отбрасываются, счётчики сохраняются.
+     */
+    void Reset() noexcept;
+
+    /** @brief Сколько пакетов удерживается. */
+    std::size_t Held() const noexcept { return held_; }
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+private:
+    struct Slot
+    {
+        bool              used = false;
+        std::uint32_t     seq  = 0;
+        std::uint32_t     len  = 0;
+        Clock::time_point at;
+    };
+
+    DeliverFn                 deliver_;
+    std::size_t               slot_size_;
+    Clock::duration           hold_;
+    std::size_t               mask_;
+    std::vector<Slot>         slots_;
+    std::vector<std::uint8_t> storage_;   ///< slots_.size() * slot_size_.
+
+    std::uint32_t next_ = 0;              ///< Ожидаемый seq.
+    std::size_t   held_ = 0;
+    Stats         stats_;
+
+    /// @brief Отдать удержанные пакеты, идущие подряд с next_.
+    void Drain();
+
+    /// @brief Сдвинуть next_ до target, отдавая удержанное и пропуская дыры.
+    void AdvanceTo(std::uint32_t target);
+};
@@ -0,0 +1,171 @@
+// Segmenter.cpp — реализация нарезки суперпакетов.
+
+#include "Segmenter.hpp"
+
+#include "Checksum.hpp"
+#include "Headers.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr std::uint8_t kTcpFin = 0x01;
+    constexpr std::uint8_t kTcpPsh = 0x08;
+    constexpr std::uint8_t kTcpCwr = 0x80;
+
+    /// @brief Смещение поля суммы в заголовке UDP: нулевая сумма там означает «нет суммы».
+    constexpr std::uint16_t kUdpCsumOffset = 6;
+}
+
+bool Segmenter::Load(const std::uint8_t *pkt,
+                     std::size_t len,
+                     const Offload &off) noexcept
+{
+    pkt_   = nullptr;
+    count_ = 0;
+    index_ = 0;
+    off_   = off;
+    if (len < 20 || len > 0xFFFF || (off.partial && off.csum_start + off.csum_offset + 2u > len))
+    {
+        ++stats_.malformed;
+        return false;
+    }
+
+    count_ = 1;
+    if (off.gso_size != 0)
+    {
+        // Нарезается только TCP (TUN_F_TSO4/TSO6); заголовок TCP — там, где его указало ядро.
+        std::size_t tcp = 0;
+        if ((pkt[0] >> 4) == 4)
+        {
+            tcp   = static_cast<std::size_t>(pkt[0] & 0x0F) * 4;
+            ipv6_ = false;
+            if (tcp < 20 || pkt[9] != Headers::kProtoTcp || (off.partial && off.csum_start != tcp))
+            {
+                ++stats_.malformed;
+                return false;
+            }
+        }
+        else if ((pkt[0] >> 4) == 6 && len >= 40)
+        {
+            tcp   = off.partial ? off.csum_start : 40;
+            ipv6_ = true;
+            if (tcp < 40 || (!off.partial && pkt[6] != Headers::kProtoTcp))
+            {
+                ++stats_.malformed;
+                return false;
+            }
+        }
+        else
+        {
+            ++stats_.malformed;
+            return false;
+        }
+        if (tcp + 20 > len || tcp + static_cast<std::size_t>(pkt[tcp + 12] >> 4) * 4 > len ||
+            (pkt[tcp + 12] >> 4) < 5)
+        {
+            ++stats_.malformed;
+            return false;
+        }
+        tcp_off_ = static_cast<std::uint16_t>(tcp);
+        hdr_len_ = static_cast<std::uint16_t>(tcp + static_cast<std::size_t>(pkt[tcp + 12] >> 4) * 4);
+        const std::size_t payload = len - hdr_len_;
+        if (payload > off.gso_size)
+        {
+            count_ = static_cast<unsigned>((payload + off.gso_size - 1) / off.gso_size);
+            ++stats_.supers;
+        }
+    }
+    pkt_ = pkt;
+    len_ = len;
+    return true;
+}
+
+std::size_t Segmenter::Whole(std::uint8_t *out,
+                             std::size_t size) noexcept
+{
+    const std::uint8_t *pkt = pkt_;
+    pkt_ = nullptr;
+    if (len_ > size)
+    {
+        ++stats_.oversize;
+        return 0;
+    }
+    std::memcpy(out, pkt, len_);
+    if (off_.partial)
+    {
+        // В поле уже лежит сумма псевдозаголовка: досуммировать L4 от csum_start.
+        std::uint8_t *l4 = out + off_.csum_start;
+        std::uint16_t c = Checksum::Finish(Checksum::Sum(l4, len_ - off_.csum_start));
+        if (c == 0 && off_.csum_offset == kUdpCsumOffset)
+        {
+            c = 0xFFFF;
+        }
+        Headers::Store16(l4 + off_.csum_offset, c);
+        ++stats_.csum;
+    }
+    return len_;
+}
+
+std::size_t Segmenter::Next(std::uint8_t *out,
+                            std::size_t size) noexcept
+{
+    if (pkt_ == nullptr)
+    {
+        return 0;
+    }
+    if (count_ == 1)
+    {
+        return Whole(out, size);
+    }
+
+    const std::size_t start = static_cast<std::size_t>(index_) * off_.gso_size;
+    const std::size_t chunk = std::min<std::size_t>(off_.gso_size, len_ - hdr_len_ - start);
+    const std::size_t seg   = hdr_len_ + chunk;
+    if (seg > size)
+    {
+        ++stats_.oversize;
+        pkt_ = nullptr;
+        return 0;
+    }
+    std::memcpy(out, pkt_, hdr_len_);
+    std::memcpy(out + hdr_len_, pkt_ + hdr_len_ + start, chunk);
+
+    const bool last = index_ + 1 == count_;
+    if (ipv6_)
+    {
+        Headers::Store16(out + 4, static_cast<std::uint16_t>(seg - 40));
+    }
+    else
+    {
+        Headers::Store16(out + 2, static_cast<std::uint16_t>(seg));
+        Headers::Store16(out + 4, static_cast<std::uint16_t>(Headers::Load16(pkt_ + 4) + index_));
+        out[10] = 0;
+        out[11] = 0;
+        Headers::Store16(out + 10, Checksum::Finish(Checksum::Sum(out, tcp_off_)));
+    }
+
+    std::uint8_t *tcp = out + tcp_off_;
+    Headers::Store32(tcp + 4, Headers::Load32(tcp + 4) + static_cast<std::uint32_t>(start));
+    if (!last)
+    {
+        tcp[13] = static_cast<std::uint8_t>(tcp[13] & ~(kTcpFin | kTcpPsh));
+    }
+    if (index_ != 0)
+    {
+        tcp[13] = static_cast<std::uint8_t>(tcp[13] & ~kTcpCwr);
+    }
+    tcp[16] = 0;
+    tcp[17] = 0;
+    const std::size_t tcp_len = seg - tcp_off_;
+    const std::uint32_t pseudo = Checksum::Pseudo(out, Headers::kProtoTcp, tcp_len);
+    Headers::Store16(tcp + 16, Checksum::Finish(Checksum::Sum(tcp, tcp_len, pseudo)));
+
+    ++stats_.segments;
+    if (++index_ == count_)
+    {
+        pkt_ = nullptr;
+    }
+    return seg;
+}
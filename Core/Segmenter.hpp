@@ -0,0 +1,93 @@
+#pragma once
+// Segmenter.hpp — программный GSO/TSO: нарезка TCP-суперпакетов из TUN на сегменты по MTU.
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Нарезка суперпакета (generic segmentation offload в пространстве пользователя).
+ *
+ * TUN Linux с включёнными offload (TUNSETOFFLOAD) отдаёт TCP-пакеты до 64 КиБ
+ * одним чтением вместе с описанием virtio_net_hdr: размер сегмента и
+ * положение частичной суммы. Дальше туннеля такой пакет не пройдёт, поэтому
+ * он режется здесь — лениво, по сегменту на вызов Next: между вызовами
+ * плагин успевает отправить готовое, и пачки отправки не рвутся.
+ *
+ * Сегменты — как у tcp_gso_segment ядра: заголовки первого пакета, seq
+ * сдвигается на данные, IPv4 ID растёт на единицу, FIN и PSH — только у
+ * последнего, CWR — только у первого; длины и суммы IP/TCP пересчитываются
+ * полностью. Пакет без нарезки (gso_size 0, данные не длиннее сегмента)
+ * выдаётся одним куском, частичная сумма (UDP, TCP) при этом досчитывается.
+ *
+ * Данные не копируются: буфер Load должен жить, пока Pending().
+ * Класс не потокобезопасен: синхронизация — на стороне владельца.
+ */
+class Segmenter
+{
+public:
+    /**
+     * @brief Описание пакета от устройства (поля virtio_net_hdr).
+     */
+    struct Offload
+    {
+        std::uint16_t gso_size    = 0;      ///< Данных TCP в сегменте; 0 — пакет не режется.
+        std::uint16_t csum_start  = 0;      ///< Начало суммируемой части (заголовок L4).
+        std::uint16_t csum_offset = 0;      ///< Поле суммы от csum_start.
+        bool          partial     = false;  ///< Сумма частичная (VIRTIO_NET_HDR_F_NEEDS_CSUM).
+    };
+
+    /**
+     * @brief Счётчики нарезки.
+     */
+    struct Stats
+    {
+        std::uint64_t supers    = 0;   ///< Суперпакетов нарезано.
+        std::uint64_t segments  = 0;   ///< Сегментов выдано из суперпакетов.
+        std::uint64_t csum      = 0;   ///< Частичных сумм досчитано у пакетов без нарезки.
+        std::uint64_t malformed = 0;   ///< Пакетов с неразбираемыми заголовками или описанием.
+        std::uint64_t oversize  = 0;   ///< Пакетов (остатков), не поместившихся в буфер Next.
+    };
+
+    Segmenter() = default;
+
+    Segmenter(const Segmenter &) = delete;
+    Segmenter &operator=(const Segmenter &) = delete;
+
+    /**
+     * @brief Начать выдачу пакета (невыданный остаток прежнего отбрасывается).
+     * @return false — заголовки или описание не сходятся (пакет отброшен).
+     */
+    bool Load(const std::uint8_t *pkt, std::size_t len, const Offload &off) noexcept;
+
+    /**
+     * @brief Следующий сегмент в out.
+     * @return Длина; 0 — выдавать нечего (или сегмент длиннее size — остаток отброшен).
+     */
+    std::size_t Next(std::uint8_t *out, std::size_t size) noexcept;
+
+    /** @brief Остались ли сегменты. */
+    bool Pending() const noexcept { return pkt_ != nullptr; }
+
+    /** @brief Сколько сегментов даст загруженный пакет. */
+    unsigned Count() const noexcept { return count_; }
+
+    /** @brief Отбросить невыданное. */
+    void Reset() noexcept { pkt_ = nullptr; }
+
+    /** @brief Счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+private:
+    const std::uint8_t *pkt_ = nullptr;
+    std::size_t   len_ = 0;
+    Offload       off_;
+    bool          ipv6_ = false;
+    std::uint16_t tcp_off_ = 0;        ///< Заголовок TCP (при нарезке).
+    std::uint16_t hdr_len_ = 0;        ///< Заголовки IP + TCP.
+    unsigned      count_ = 0;          ///< Сегментов всего (1 — без нарезки).
+    unsigned      index_ = 0;          ///< Следующий сегмент.
+    Stats         stats_;
+
+    /// @brief Выдать пакет без нарезки.
+    std::size_t Whole(std::uint8_t *out, std::size_t size) noexcept;
+};
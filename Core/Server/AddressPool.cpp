@@ -0,0 +1,687 @@
+// AddressPool.cpp — реализация пула адресов на иерархическом битмапе.
+
+#include "AddressPool.hpp"
+#include "Core/Logger.hpp"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    constexpr std::uint32_t kMaxPoolSize = 1u << 24;
+    constexpr std::uint32_t kSnapshotMagic   = 0x50414646; // "FFAP"
+    constexpr std::uint32_t kSnapshotVersion = 1;
+
+    enum class State : std::uint8_t
+    {
+        Free        = 0,
+        Active      = 1,
+        Quarantined = 2,
+        Reserved    = 3,
+    };
+
+    std::uint64_t HashIdentity(const std::uint8_t *p, std::size_t n) noexcept
+    {
+        // FNV-1a 64 + финальное перемешивание; 0 зарезервирован под «без identity».
+        std::uint64_t h = 0xCBF29CE484222325ull;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            h ^= p[i];
+            h *= 0x100000001B3ull;
+        }
+        h ^= h >> 33;
+        return h == 0 ? 1 : h;
+    }
+
+    /**
+     * @brief Иерархический битмап: levels[0] — по биту на адрес (1 = занят),
+     *        levels[k] — по биту на слово уровня k-1 (1 = слово заполнено).
+     */
+    class HierBitmap
+    {
+    public:
+        explicit HierBitmap(std::uint32_t n)
+        {
+            std::size_t bits = n;
+            do
+            {
+                const std::size_t words = (bits + 63) / 64;
+                std::vector<std::uint64_t> level(words, 0);
+                // Хвост последнего слова — «занят», чтобы FindFirstZero его не вернул.
+                if (bits % 64 != 0)
+                {
+                    level.back() = ~0ull << (bits % 64);
+                }
+                levels_.push_back(std::move(level));
+                bits = words;
+            } while (bits > 1);
+
+            // Согласовать верхние уровни с хвостами нижних.
+            for (std::size_t l = 0; l + 1 < levels_.size(); ++l)
+            {
+                for (std::size_t w = 0; w < levels_[l].size(); ++w)
+                {
+                    if (levels_[l][w] == ~0ull)
+                    {
+                        levels_[l + 1][w / 64] |= 1ull << (w % 64);
+                    }
+                }
+            }
+        }
+
+        bool Test(std::uint32_t i) const noexcept
+        {
+            return (levels_[0][i / 64] >> (i % 64)) & 1u;
+        }
+
+        void Set(std::uint32_t i) noexcept
+        {
+            std::size_t idx = i;
+            for (auto &level : levels_)
+            {
+                std::uint64_t &w = level[idx / 64];
+                w |= 1ull << (idx % 64);
+                if (w != ~0ull)
+                {
+                    return;
+                }
+                idx /= 64;
+            }
+        }
+
+        void Clear(std::uint32_t i) noexcept
+        {
+            std::size_t idx = i;
+            for (auto &level : levels_)
+            {
+                std::uint64_t &w = level[idx / 64];
+                const bool was_full = (w == ~0ull);
+                w &= ~(1ull << (idx % 64));
+                if (!was_full)
+                {
+                    return;
+                }
+                idx /= 64;
+            }
+        }
+
+        std::optional<std::uint32_t> FindFirstZero() const noexcept
+        {
+            const auto &top = levels_.back();
+            std::size_t idx = 0;
+            std::size_t w = 0;
+            while (w < top.size() && top[w] == ~0ull)
+            {
+                ++w;
+            }
+            if (w == top.size())
+            {
+                return std::nullopt;
+            }
+            idx = w * 64 + static_cast<std::size_t>(std::countr_one(top[w]));
+            for (std::size_t l = levels_.size() - 1; l-- > 0;)
+            {
+                idx = idx * 64 + static_cast<std::size_t>(std::countr_one(levels_[l][idx]));
+            }
+            return static_cast<std::uint32_t>(idx);
+        }
+
+    private:
+        std::vector<std::vector<std::uint64_t>> levels_;
+    };
+
+    void PutLe(std::string &out, std::uint64_t v, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+        {
+            out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+        }
+    }
+
+    std::uint64_t GetLe(const std::string &in, std::size_t &pos, int bytes)
+    {
+        if (pos + static_cast<std::size_t>(bytes) > in.size())
+        {
+            throw std::runtime_error("AddressPool snapshot truncated");
+        }
+        std::uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            v |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(in[pos++])) << (8 * i);
+        }
+        return v;
+    }
+}
+
+/**
+ * @brief Полоса пула: непрерывный диапазон индексов со своим мьютексом.
+ */
+struct AddressPool::Stripe
+{
+    struct QuarantineEntry
+    {
+        std::uint32_t                         index;
+        std::uint32_t                         gen;
+        std::chrono::steady_clock::time_point expire;
+    };
+
+    std::mutex                 mtx;
+    std::uint32_t              first;
+    std::uint32_t              count;
+    HierBitmap                 used;
+    std::vector<State>         state;
+    std::vector<std::uint64_t> owner;   ///< Последний владелец (хэш identity), 0 — нет.
+    std::vector<std::uint32_t> gen;     ///< Поколение: отсекает устаревшие записи карантина.
+    std::deque<QuarantineEntry> quarantine;
+    std::unordered_map<std::uint64_t, std::uint32_t> sticky; ///< identity -> локальный индекс.
+    std::size_t                active = 0;
+
+    Stripe(std::uint32_t first_index, std::uint32_t n)
+        : first(first_index)
+        , count(n)
+        , used(n)
+        , state(n, State::Free)
+        , owner(n, 0)
+        , gen(n, 0)
+    {
+    }
+
+    void Expire(std::chrono::steady_clock::time_point now)
+    {
+        while (!quarantine.empty() && quarantine.front().expire <= now)
+        {
+            const QuarantineEntry q = quarantine.front();
+            quarantine.pop_front();
+            if (gen[q.index] == q.gen && state[q.index] == State::Quarantined)
+            {
+                state[q.index] = State::Free;
+                used.Clear(q.index);
+            }
+        }
+    }
+
+    void Take(std::uint32_t local, std::uint64_t id, bool remember)
+    {
+        const std::uint64_t prev = owner[local];
+        if (prev != 0 && prev != id)
+        {
+            auto it = sticky.find(prev);
+            if (it != sticky.end() && it->second == local)
+            {
+                sticky.erase(it);
+            }
+        }
+        if (state[local] == State::Free)
+        {
+            used.Set(local);
+        }
+        state[local] = State::Active;
+        owner[local] = id;
+        ++gen[local];
+        ++active;
+        if (id != 0 && remember)
+        {
+            sticky[id] = local;
+        }
+    }
+
+    void Hold(std::uint32_t local, std::chrono::steady_clock::time_point expire)
+    {
+        state[local] = State::Quarantined;
+        ++gen[local];
+        quarantine.push_back({local, gen[local], expire});
+    }
+};
+
+AddressPool::AddressPool(const Options &opts)
+    : quarantine_(opts.quarantine)
+{
+    ParseCidr(opts.cidr, family_, base_, prefix_len_);
+
+    const unsigned host_bits = (family_ == 4 ? 32u : 128u) - prefix_len_;
+    std::uint64_t size = host_bits >= 24 ? kMaxPoolSize : (1ull << host_bits);
+    if (opts.max_size != 0)
+    {
+        size = std::min<std::uint64_t>(size, opts.max_size);
+    }
+    if (size < 4)
+    {
+        throw std::invalid_argument("AddressPool: prefix too small: " + opts.cidr);
+    }
+    if (quarantine_.count() < 0)
+    {
+        throw std::invalid_argument("AddressPool: negative quarantine");
+    }
+    size_ = static_cast<std::uint32_t>(size);
+
+    unsigned n_stripes = opts.stripes != 0 ? opts.stripes
+                                           : std::clamp<unsigned>(size_ / 256, 1u, 16u);
+    n_stripes = std::min<unsigned>(n_stripes, size_ / 4);
+    const std::uint32_t per = size_ / n_stripes;
+    for (unsigned i = 0; i < n_stripes; ++i)
+    {
+        const std::uint32_t first = i * per;
+        const std::uint32_t count = (i + 1 == n_stripes) ? size_ - first : per;
+        stripes_.push_back(std::make_unique<Stripe>(first, count));
+    }
+
+    // Адрес сети; для IPv4, когда пул покрывает весь префикс, — ещё и broadcast
+    // (в том числе при max_size не меньше размера префикса).
+    Reserve(AddrOf(0));
+    if (family_ == 4 && size_ == (std::uint64_t{1} << host_bits))
+    {
+        Reserve(AddrOf(size_ - 1));
+    }
+
+    LOGI("addresspool") << "Pool " << ToString(family_, base_) << "/" << prefix_len_
+                        << ": size=" << size_ << " stripes=" << stripes_.size()
+                        << " quarantine=" << quarantine_.count() << "ms";
+}
+
+AddressPool::~AddressPool() = default;
+
+void AddressPool::ParseCidr(const std::string &cidr,
+                            int &family,
+                            Addr &base,
+                            unsigned &prefix_len)
+{
+    const auto slash = cidr.find('/');
+    if (slash == std::string::npos)
+    {
+        throw std::invalid_argument("AddressPool: CIDR must be addr/prefix: " + cidr);
+    }
+    const std::string ip = cidr.substr(0, slash);
+    int plen = -1;
+    try
+    {
+        plen = std::stoi(cidr.substr(slash + 1));
+    }
+    catch (...)
+    {
+        throw std::invalid_argument("AddressPool: invalid prefix length: " + cidr);
+    }
+
+    base.fill(0);
+    if (::inet_pton(AF_INET, ip.c_str(), base.data()) == 1)
+    {
+        family = 4;
+    }
+    else if (::inet_pton(AF_INET6, ip.c_str(), base.data()) == 1)
+    {
+        family = 6;
+    }
+    else
+    {
+        throw std::invalid_argument("AddressPool: invalid address: " + cidr);
+    }
+
+    const int max_len = family == 4 ? 32 : 128;
+    if (plen < 0 || plen > max_len)
+    {
+        throw std::invalid_argument("AddressPool: invalid prefix length: " + cidr);
+    }
+    prefix_len = static_cast<unsigned>(plen);
+
+    // Обнуляем хостовую часть.
+    for (int bit = plen; bit < max_len; ++bit)
+    {
+        base[static_cast<std::size_t>(bit / 8)] &= static_cast<std::uint8_t>(~(0x80u >> (bit % 8)));
+    }
+}
+
+std::string AddressPool::ToString(int family,
+                                  const Addr &addr)
+{
+    char buf[INET6_ADDRSTRLEN]{};
+    ::inet_ntop(family == 4 ? AF_INET : AF_INET6, addr.data(), buf, sizeof(buf));
+    return buf;
+}
+
+std::optional<std::uint32_t> AddressPool::IndexOf(const Addr &addr) const noexcept
+{
+    // Хостовая часть base_ нулевая, size_ <= 2^24: индекс — младшие 32 бита адреса,
+    // а все биты между префиксом и ними должны быть нулевыми.
+    const unsigned total = family_ == 4 ? 32u : 128u;
+    for (unsigned bit = 0; bit < total - 32; ++bit)
+    {
+        const std::uint8_t mask = static_cast<std::uint8_t>(0x80u >> (bit % 8));
+        const std::uint8_t want = bit < prefix_len_ ? static_cast<std::uint8_t>(base_[bit / 8] & mask) : 0;
+        if ((addr[bit / 8] & mask) != want)
+        {
+            return std::nullopt;
+        }
+    }
+
+    const std::size_t off = (total - 32) / 8;
+    std::uint32_t low = 0;
+    std::uint32_t low_base = 0;
+    for (std::size_t i = off; i < off + 4; ++i)
+    {
+        low      = (low << 8) | addr[i];
+        low_base = (low_base << 8) | base_[i];
+    }
+    const unsigned host_bits = std::min(total - prefix_len_, 32u);
+    const std::uint32_t host_mask = host_bits == 32 ? ~0u : ((1u << host_bits) - 1);
+    if ((low & ~host_mask) != low_base)
+    {
+        return std::nullopt;
+    }
+    const std::uint32_t index = low & host_mask;
+    if (index >= size_)
+    {
+        return std::nullopt;
+    }
+    return index;
+}
+
+AddressPool::Addr AddressPool::AddrOf(std::uint32_t index) const noexcept
+{
+    Addr out = base_;
+    const std::size_t off = family_ == 4 ? 0 : 12;
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        out[off + i] = static_cast<std::uint8_t>(out[off + i] | ((index >> (24 - 8 * i)) & 0xff));
+    }
+    return out;
+}
+
+AddressPool::Stripe &AddressPool::StripeOf(std::uint32_t index) const noexcept
+{
+    const std::uint32_t per = stripes_.front()->count;
+    const std::size_t s = std::min<std::size_t>(index / per, stripes_.size() - 1);
+    return *stripes_[s];
+}
+
+bool AddressPool::Reserve(const Addr &addr)
+{
+    const auto index = IndexOf(addr);
+    if (!index)
+    {
+        return false;
+    }
+    Stripe &s = StripeOf(*index);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    const std::uint32_t local = *index - s.first;
+    if (s.state[local] == State::Active)
+    {
+        --s.active;
+    }
+    if (s.state[local] == State::Free)
+    {
+        s.used.Set(local);
+    }
+    s.state[local] = State::Reserved;
+    ++s.gen[local];
+    LOGD("addresspool") << "Reserved " << ToString(family_, addr);
+    return true;
+}
+
+std::optional<AddressPool::Addr> AddressPool::Lease(const std::uint8_t *identity,
+                                                    std::size_t identity_len)
+{
+    static std::atomic<std::size_t> round_robin{0};
+
+    const std::uint64_t id = (identity && identity_len) ? HashIdentity(identity, identity_len) : 0;
+    const std::size_t home = id != 0 ? static_cast<std::size_t>(id % stripes_.size())
+                                     : round_robin.fetch_add(1, std::memory_order_relaxed) % stripes_.size();
+    const auto now = std::chrono::steady_clock::now();
+
+    for (std::size_t k = 0; k < stripes_.size(); ++k)
+    {
+        Stripe &s = *stripes_[(home + k) % stripes_.size()];
+        std::lock_guard<std::mutex> lk(s.mtx);
+        s.Expire(now);
+
+        if (k == 0 && id != 0)
+        {
+            auto it = s.sticky.find(id);
+            if (it != s.sticky.end())
+            {
+                const std::uint32_t local = it->second;
+                const State st = s.state[local];
+                if (st == State::Free || (st == State::Quarantined && s.owner[local] == id))
+                {
+                    s.Take(local, id, true);
+                    LOGD("addresspool") << "Lease (sticky) " << ToString(family_, AddrOf(s.first + local));
+                    return AddrOf(s.first + local);
+                }
+            }
+        }
+
+        if (const auto local = s.used.FindFirstZero())
+        {
+            // Sticky запоминаем только в «домашней» полосе: там его и будем искать.
+            s.Take(*local, id, k == 0);
+            LOGD("addresspool") << "Lease " << ToString(family_, AddrOf(s.first + *local));
+            return AddrOf(s.first + *local);
+        }
+    }
+
+    LOGW("addresspool") << "Pool exhausted (" << ToString(family_, base_) << "/" << prefix_len_ << ")";
+    return std::nullopt;
+}
+
+bool AddressPool::Claim(const Addr &addr,
+                        const std::uint8_t *identity,
+                        std::size_t identity_len)
+{
+    const auto index = IndexOf(addr);
+    if (!index)
+    {
+        return false;
+    }
+    const std::uint64_t id = (identity && identity_len) ? HashIdentity(identity, identity_len) : 0;
+
+    Stripe &s = StripeOf(*index);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    s.Expire(std::chrono::steady_clock::now());
+
+    const std::uint32_t local = *index - s.first;
+    const State st = s.state[local];
+    if (st != State::Free && !(st == State::Quarantined && id != 0 && s.owner[local] == id))
+    {
+        return false;
+    }
+    const bool home = id != 0 && &s == stripes_[id % stripes_.size()].get();
+    s.Take(local, id, home);
+    LOGD("addresspool") << "Claim " << ToString(family_, addr);
+    return true;
+}
+
+void AddressPool::Release(const Addr &addr)
+{
+    const auto index = IndexOf(addr);
+    if (!index)
+    {
+        LOGW("addresspool") << "Release: address outside pool " << ToString(family_, addr);
+        return;
+    }
+    Stripe &s = StripeOf(*index);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    const std::uint32_t local = *index - s.first;
+    if (s.state[local] != State::Active)
+    {
+        LOGT("addresspool") << "Release: not leased " << ToString(family_, addr);
+        return;
+    }
+    --s.active;
+    s.Hold(local, std::chrono::steady_clock::now() + quarantine_);
+    LOGD("addresspool") << "Release " << ToString(family_, addr) << " (quarantine)";
+}
+
+std::size_t AddressPool::Active() const
+{
+    std::size_t total = 0;
+    for (const auto &s : stripes_)
+    {
+        std::lock_guard<std::mutex> lk(s->mtx);
+        total += s->active;
+    }
+    return total;
+}
+
+void AddressPool::Save(const std::string &path) const
+{
+    std::string out;
+    PutLe(out, kSnapshotMagic, 4);
+    PutLe(out, kSnapshotVersion, 4);
+    PutLe(out, static_cast<std::uint64_t>(family_), 1);
+    PutLe(out, prefix_len_, 1);
+    out.append(reinterpret_cast<const char *>(base_.data()), base_.size());
+    PutLe(out, size_, 4);
+    const std::size_t count_pos = out.size();
+    PutLe(out, 0, 4);
+
+    // Запись: owner(8) index(4) state(1) remaining_ms(4) — 17 байт.
+    std::uint32_t records = 0;
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto &sp : stripes_)
+    {
+        const Stripe &s = *sp;
+        std::lock_guard<std::mutex> lk(sp->mtx);
+
+        std::unordered_map<std::uint32_t, std::chrono::steady_clock::time_point> expires;
+        for (const auto &q : s.quarantine)
+        {
+            if (s.gen[q.index] == q.gen)
+            {
+                expires[q.index] = q.expire;
+            }
+        }
+
+        for (std::uint32_t local = 0; local < s.count; ++local)
+        {
+            const State st = s.state[local];
+            const std::uint64_t id = s.owner[local];
+            std::uint32_t remaining = 0;
+            if (st == State::Quarantined)
+            {
+                const auto it = expires.find(local);
+                if (it != expires.end() && it->second > now)
+                {
+                    remaining = static_cast<std::uint32_t>(
+                        std::chrono::duration_cast<std::chrono::milliseconds>(it->second - now).count());
+                }
+            }
+            else if (st == State::Free)
+            {
+                const auto it = id != 0 ? s.sticky.find(id) : s.sticky.end();
+                if (it == s.sticky.end() || it->second != local)
+                {
+                    continue;
+                }
+            }
+            else if (st != State::Active)
+            {
+                continue;
+            }
+            PutLe(out, id, 8);
+            PutLe(out, s.first + local, 4);
+            PutLe(out, static_cast<std::uint64_t>(st), 1);
+            PutLe(out, remaining, 4);
+            ++records;
+        }
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        out[count_pos + static_cast<std::size_t>(i)] = static_cast<char>((records >> (8 * i)) & 0xff);
+    }
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(out.data(), static_cast<std::streamsize>(out.size()));
+        if (!f)
+        {
+            LOGE("addresspool") << "Save: write failed: " << tmp;
+            throw std::runtime_error("AddressPool: snapshot write failed");
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+    {
+        LOGE("addresspool") << "Save: rename failed: " << ec.message();
+        throw std::runtime_error("AddressPool: snapshot rename failed");
+    }
+    LOGI("addresspool") << "Snapshot saved: " << path << " records=" << records
+                        << " bytes=" << out.size();
+}
+
+bool AddressPool::Load(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open())
+    {
+        LOGD("addresspool") << "Load: no snapshot at " << path;
+        return false;
+    }
+    const std::string in((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    std::size_t pos = 0;
+    if (GetLe(in, pos, 4) != kSnapshotMagic || GetLe(in, pos, 4) != kSnapshotVersion)
+    {
+        throw std::runtime_error("AddressPool: bad snapshot header");
+    }
+    const int family = static_cast<int>(GetLe(in, pos, 1));
+    const unsigned prefix_len = static_cast<unsigned>(GetLe(in, pos, 1));
+    if (pos + 16 > in.size())
+    {
+        throw std::runtime_error("AddressPool snapshot truncated");
+    }
+    Addr base{};
+    std::memcpy(base.data(), in.data() + pos, base.size());
+    pos += base.size();
+    const std::uint32_t size = static_cast<std::uint32_t>(GetLe(in, pos, 4));
+    if (family != family_ || prefix_len != prefix_len_ || base != base_ || size != size_)
+    {
+        LOGW("addresspool") << "Load: snapshot is for another pool, ignored: " << path;
+        return false;
+    }
+
+    const std::uint32_t records = static_cast<std::uint32_t>(GetLe(in, pos, 4));
+    const auto now = std::chrono::steady_clock::now();
+    for (std::uint32_t r = 0; r < records; ++r)
+    {
+        const std::uint64_t id    = GetLe(in, pos, 8);
+        const std::uint32_t index = static_cast<std::uint32_t>(GetLe(in, pos, 4));
+        const auto          st    = static_cast<State>(GetLe(in, pos, 1));
+        const std::uint32_t remaining = static_cast<std::uint32_t>(GetLe(in, pos, 4));
+        if (index >= size_)
+        {
+            throw std::runtime_error("AddressPool: snapshot index out of range");
+        }
+
+        Stripe &s = StripeOf(index);
+        std::lock_guard<std::mutex> lk(s.mtx);
+        const std::uint32_t local = index - s.first;
+        if (s.state[local] == State::Reserved)
+        {
+            continue;
+        }
+        s.owner[local] = id;
+        const bool home = id != 0 && &s == stripes_[id % stripes_.size()].get();
+        if (home)
+        {
+            s.sticky[id] = local;
+        }
+        if (st == State::Active || st == State::Quarantined)
+        {
+            const auto hold = st == State::Active ? quarantine_ : std::chrono::milliseconds(remaining);
+            if (s.state[local] == State::Free)
+            {
+                s.used.Set(local);
+            }
+            s.Hold(local, now + hold);
+        }
+    }
+    LOGI("addresspool") << "Snapshot loaded: " << path << " records=" << records;
+    return true;
+}
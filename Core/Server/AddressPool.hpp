@@ -0,0 +1,137 @@
+#pragma once
+// AddressPool.hpp — пул внутренних адресов клиентов (IPv4 или IPv6) для серверного режима.
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Аллокатор адресов из одного префикса (v4 или v6).
+ *
+ * - Занятость — иерархический битмап (64-битные слова + уровни «слово заполнено»),
+ *   поиск свободного адреса — find-first-zero сверху вниз: O(log64 N), т.е. O(1) на практике.
+ * - Освобождённый адрес уходит в карантин и возвращается в оборот только по истечении
+ *   quarantine (чтобы запоздавшие пакеты старого клиента не попали новому).
+ * - Sticky: клиент с тем же identity получает прежний адрес, если тот свободен или
+ *   в карантине от него же.
+ * - Пул разбит на полосы (stripes) с собственными мьютексами: всплеск подключений
+ *   не сериализуется на одной блокировке. Полоса выбирается по хэшу identity.
+ * - Состояние сохраняется компактным бинарным снимком (Save/Load).
+ *
+ * Потокобезопасен.
+ */
+class AddressPool
+{
+public:
+    /// @brief Адрес в сетевом порядке байт (для v4 значимы первые 4 байта).
+    using Addr = std::array<std::uint8_t, 16>;
+
+    /**
+     * @brief Параметры пула.
+     */
+    struct Options
+    {
+        /// @brief Префикс пула: "10.200.0.0/22" или "fd00:dead:beef::/64".
+        std::string cidr;
+        /// @brief Сколько адресов брать из префикса (0 — весь, но не более 2^24).
+        std::uint32_t max_size = 0;
+        /// @brief Карантин освобождённого адреса.
+        std::chrono::milliseconds quarantine{60000};
+        /// @brief Число полос (0 — автоматически).
+        unsigned stripes = 0;
+    };
+
+    /**
+     * @brief Создать пул.
+     * @throw std::invalid_argument Некорректный CIDR/параметры.
+     */
+    explicit AddressPool(const Options &opts);
+
+    ~AddressPool();
+
+    AddressPool(const AddressPool &) = delete;
+    AddressPool &operator=(const AddressPool &) = delete;
+
+    /** @brief 4 или 6. */
+    int Family() const noexcept { return family_; }
+
+    /** @brief Размер пула в адресах. */
+    std::uint32_t Size() const noexcept { return size_; }
+
+    /**
+     * @brief Исключить адрес из выдачи (сеть, broadcast, адрес самого сервера).
+     * @return false, если адрес вне пула.
+     */
+    bool Reserve(const Addr &addr);
+
+    /**
+     * @brief Выдать адрес.
+     * @param identity     Идентификатор клиента (может быть пустым — без sticky).
+     * @param identity_len Длина идентификатора.
+     * @return Адрес или std::nullopt, если пул исчерпан.
+     */
+    std::optional<Addr> Lease(const std::uint8_t *identity, std::size_t identity_len);
+
+    /**
+     * @brief Выдать конкретный адрес (возобновление сессии по тикету).
+     * @return false — адрес вне пула, занят или в карантине у другого владельца.
+     */
+    bool Claim(const Addr &addr, const std::uint8_t *identity, std::size_t identity_len);
+
+    /**
+     * @brief Вернуть адрес (уходит в карантин).
+     */
+    void Release(const Addr &addr);
+
+    /** @brief Число выданных адресов. */
+    std::size_t Active() const;
+
+    /**
+     * @brief Сохранить состояние (выданные, карантин, sticky) в файл.
+     * @throw std::runtime_error Ошибка записи.
+     */
+    void Save(const std::string &path) const;
+
+    /**
+     * @brief Загрузить состояние из файла. Выданные адреса восстанавливаются как карантин
+     *        того же владельца: старые клиенты успевают вернуться за своим адресом.
+     * @return false, если файла нет или он от другого пула.
+     * @throw std::runtime_error Повреждённый файл.
+     */
+    bool Load(const std::string &path);
+
+    /**
+     * @brief Разобрать "адрес/префикс".
+     * @throw std::invalid_argument Некорректная строка.
+     */
+    static void ParseCidr(const std::string &cidr, int &family, Addr &base, unsigned &prefix_len);
+
+    /**
+     * @brief Адрес строкой.
+     */
+    static std::string ToString(int family, const Addr &addr);
+
+private:
+    struct Stripe;
+
+    int           family_     = 4;
+    Addr          base_{};
+    unsigned      prefix_len_ = 0;
+    std::uint32_t size_       = 0;
+    std::chrono::milliseconds quarantine_;
+
+    std::vector<std::unique_ptr<Stripe>> stripes_;
+
+    /// @brief Индекс адреса в пуле или std::nullopt, если адрес вне пула.
+    std::optional<std::uint32_t> IndexOf(const Addr &addr) const noexcept;
+    Addr AddrOf(std::uint32_t index) const noexcept;
+    Stripe &StripeOf(std::uint32_t index) const noexcept;
+};
@@ -0,0 +1,407 @@
+// LinuxTun.cpp — реализация очереди /dev/net/tun.
+
+#include "LinuxTun.hpp"
+#include "Core/Logger.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    /// @brief Аналог struct in6_ifreq из <linux/ipv6.h> (заголовок конфликтует с <netinet/in.h>).
+    struct In6Ifreq
+    {
+        in6_addr      addr;
+        std::uint32_t prefix_len;
+        int           ifindex;
+    };
+
+    /// @brief struct virtio_net_hdr из <linux/virtio_net.h> (заголовок не собирается как C++).
+    struct VnetHdr
+    {
+        std::uint8_t  flags;
+        std::uint8_t  gso_type;
+        std::uint16_t hdr_len;
+        std::uint16_t gso_size;
+        std::uint16_t csum_start;
+        std::uint16_t csum_offset;
+    };
+    static_assert(sizeof(VnetHdr) == 10);
+
+    constexpr std::uint8_t kVnetNeedsCsum = 1;   // VIRTIO_NET_HDR_F_NEEDS_CSUM
+    constexpr std::uint8_t kVnetGsoTcp4   = 1;   // VIRTIO_NET_HDR_GSO_TCPV4
+    constexpr std::uint8_t kVnetGsoTcp6   = 4;   // VIRTIO_NET_HDR_GSO_TCPV6
+    constexpr std::uint8_t kVnetGsoEcn    = 0x80; // VIRTIO_NET_HDR_GSO_ECN
+
+    [[noreturn]] void ThrowErrno(const std::string &what)
+    {
+        const int err = errno;
+        LOGE("tun") << what << ": " << std::strerror(err);
+        throw std::runtime_error(what + ": " + std::strerror(err));
+    }
+
+    /// @brief RAII-сокет для ioctl настройки интерфейса.
+    class CtlSocket
+    {
+    public:
+        explicit CtlSocket(int family)
+            : fd_(::socket(family, SOCK_DGRAM | SOCK_CLOEXEC, 0))
+        {
+            if (fd_ < 0)
+            {
+                ThrowErrno("socket(ctl)");
+            }
+        }
+        ~CtlSocket() { ::close(fd_); }
+        CtlSocket(const CtlSocket &) = delete;
+        CtlSocket &operator=(const CtlSocket &) = delete;
+        int Fd() const noexcept { return fd_; }
+
+    private:
+        int fd_;
+    };
+
+    ifreq MakeIfreq(const std::string &ifname)
+    {
+        if (ifname.empty() || ifname.size() >= IFNAMSIZ)
+        {
+            LOGE("tun") << "Invalid interface name '" << ifname << "'";
+            throw std::invalid_argument("invalid interface name");
+        }
+        ifreq ifr{};
+        std::memcpy(ifr.ifr_name, ifname.c_str(), ifname.size());
+        return ifr;
+    }
+}
+
+LinuxTun::LinuxTun(const std::string &name,
+                   bool multi_queue,
+                   bool vnet_hdr)
+    : vnet_(vnet_hdr)
+{
+    ifreq ifr = MakeIfreq(name);
+    ifr.ifr_flags = static_cast<short>(IFF_TUN | IFF_NO_PI | (multi_queue ? IFF_MULTI_QUEUE : 0) |
+                                       (vnet_hdr ? IFF_VNET_HDR : 0));
+
+    fd_ = ::open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0)
+    {
+        ThrowErrno("open(/dev/net/tun)");
+    }
+    if (::ioctl(fd_, TUNSETIFF, &ifr) < 0)
+    {
+        const int err = errno;
+        ::close(fd_);
+        fd_ = -1;
+        errno = err;
+        ThrowErrno("ioctl(TUNSETIFF)");
+    }
+    name_.assign(ifr.ifr_name, ::strnlen(ifr.ifr_name, IFNAMSIZ));
+    LOGI("tun") << "Queue opened: " << name_ << (multi_queue ? " (multi-queue)" : "") << (vnet_hdr ? " (vnet_hdr)" : "");
+}
+
+LinuxTun::~LinuxTun()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        LOGT("tun") << "Queue closed: " << name_;
+    }
+}
+
+LinuxTun::LinuxTun(LinuxTun &&other) noexcept
+    : fd_(std::exchange(other.fd_, -1))
+    , vnet_(other.vnet_)
+    , name_(std::move(other.name_))
+{
+}
+
+LinuxTun &LinuxTun::operator=(LinuxTun &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+        }
+        fd_   = std::exchange(other.fd_, -1);
+        vnet_ = other.vnet_;
+        name_ = std::move(other.name_);
+    }
+    return *this;
+}
+
+ssize_t LinuxTun::Read(std::uint8_t *buf,
+                       std::size_t size) noexcept
+{
+    VnetHdr hdr;
+    iovec iov[2] = {{&hdr, sizeof(hdr)}, {buf, size}};
+    for (;;)
+    {
+        const ssize_t n = vnet_ ? ::readv(fd_, iov, 2) : ::read(fd_, buf, size);
+        if (n >= 0)
+        {
+            if (vnet_)
+            {
+                // Без TUNSETOFFLOAD ядро отдаёт обычные пакеты с досчитанной суммой: заголовок только снимается.
+                return n >= static_cast<ssize_t>(sizeof(hdr)) ? n - static_cast<ssize_t>(sizeof(hdr)) : -1;
+            }
+            return n;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        LOGW("tun") << "read failed: " << std::strerror(errno);
+        return -1;
+    }
+}
+
+ssize_t LinuxTun::ReadGso(std::uint8_t *buf,
+                          std::size_t size,
+                          Gso *gso) noexcept
+{
+    if (!vnet_)
+    {
+        *gso = Gso{};
+        return Read(buf, size);
+    }
+    VnetHdr hdr;
+    iovec iov[2] = {{&hdr, sizeof(hdr)}, {buf, size}};
+    for (;;)
+    {
+        const ssize_t n = ::readv(fd_, iov, 2);
+        if (n >= static_cast<ssize_t>(sizeof(hdr)))
+        {
+            const std::uint8_t type = static_cast<std::uint8_t>(hdr.gso_type & ~kVnetGsoEcn);
+            *gso = Gso{};
+            // Без нарезки ядро отдаёт только TCP (включены лишь TSO4/TSO6); прочее — не суперпакет.
+            if (type == kVnetGsoTcp4 || type == kVnetGsoTcp6)
+            {
+                gso->size    = hdr.gso_size;
+                gso->hdr_len = hdr.hdr_len;
+                gso->ipv6    = type == kVnetGsoTcp6;
+            }
+            if ((hdr.flags & kVnetNeedsCsum) != 0)
+            {
+                gso->partial     = true;
+                gso->csum_start  = hdr.csum_start;
+                gso->csum_offset = hdr.csum_offset;
+            }
+            return n - static_cast<ssize_t>(sizeof(hdr));
+        }
+        if (n >= 0)
+        {
+            return -1;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        LOGW("tun") << "read failed: " << std::strerror(errno);
+        return -1;
+    }
+}
+
+ssize_t LinuxTun::Write(const std::uint8_t *buf,
+                        std::size_t len) noexcept
+{
+    if (vnet_)
+    {
+        const VnetHdr hdr{};
+        return WriteVnet(&hdr, buf, len);
+    }
+    for (;;)
+    {
+        const ssize_t n = ::write(fd_, buf, len);
+        if (n >= 0)
+        {
+            return n;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+        {
+            LOGT("tun") << "write: queue full (drop)";
+            return 0;
+        }
+        LOGW("tun") << "write failed: " << std::strerror(errno);
+        return -1;
+    }
+}
+
+ssize_t LinuxTun::WriteGso(const std::uint8_t *buf,
+                           std::size_t len,
+                           const Gso &gso) noexcept
+{
+    if (!vnet_)
+    {
+        return -1;
+    }
+    // Поля — в родном порядке байт (legacy virtio без TUNSETVNETLE/BE).
+    VnetHdr hdr{};
+    hdr.flags       = kVnetNeedsCsum;
+    hdr.gso_type    = gso.ipv6 ? kVnetGsoTcp6 : kVnetGsoTcp4;
+    hdr.hdr_len     = gso.hdr_len;
+    hdr.gso_size    = gso.size;
+    hdr.csum_start  = gso.csum_start;
+    hdr.csum_offset = gso.csum_offset;
+    return WriteVnet(&hdr, buf, len);
+}
+
+ssize_t LinuxTun::WriteVnet(const void *hdr,
+                            const std::uint8_t *buf,
+                            std::size_t len) noexcept
+{
+    iovec iov[2] = {{const_cast<void *>(hdr), sizeof(VnetHdr)},
+                    {const_cast<std::uint8_t *>(buf), len}};
+    for (;;)
+    {
+        const ssize_t n = ::writev(fd_, iov, 2);
+        if (n >= 0)
+        {
+            return n >= static_cast<ssize_t>(sizeof(VnetHdr)) ? n - static_cast<ssize_t>(sizeof(VnetHdr)) : 0;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+        {
+            LOGT("tun") << "write: queue full (drop)";
+            return 0;
+        }
+        LOGW("tun") << "write failed: " << std::strerror(errno);
+        return -1;
+    }
+}
+
+void LinuxTun::EnableTso()
+{
+    if (!vnet_)
+    {
+        throw std::logic_error("EnableTso: queue opened without vnet_hdr");
+    }
+    if (::ioctl(fd_, TUNSETOFFLOAD, static_cast<unsigned long>(TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6)) < 0)
+    {
+        ThrowErrno("ioctl(TUNSETOFFLOAD)");
+    }
+    LOGI("tun") << "Offload enabled: " << name_ << " csum tso4 tso6";
+}
+
+void LinuxTun::AddAddress4(const std::string &ifname,
+                           const std::string &ip,
+                           unsigned prefix_len)
+{
+    if (prefix_len > 32)
+    {
+        throw std::invalid_argument("AddAddress4: invalid prefix length");
+    }
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    if (::inet_pton(AF_INET, ip.c_str(), &sa.sin_addr) != 1)
+    {
+        LOGE("tun") << "AddAddress4: invalid IPv4 '" << ip << "'";
+        throw std::invalid_argument("AddAddress4: invalid IPv4");
+    }
+
+    CtlSocket sock(AF_INET);
+    ifreq ifr = MakeIfreq(ifname);
+    std::memcpy(&ifr.ifr_addr, &sa, sizeof(sa));
+    if (::ioctl(sock.Fd(), SIOCSIFADDR, &ifr) < 0)
+    {
+        ThrowErrno("ioctl(SIOCSIFADDR)");
+    }
+
+    sockaddr_in mask{};
+    mask.sin_family = AF_INET;
+    mask.sin_addr.s_addr = htonl(prefix_len == 0 ? 0u : ~0u << (32 - prefix_len));
+    ifr = MakeIfreq(ifname);
+    std::memcpy(&ifr.ifr_netmask, &mask, sizeof(mask));
+    if (::ioctl(sock.Fd(), SIOCSIFNETMASK, &ifr) < 0)
+    {
+        ThrowErrno("ioctl(SIOCSIFNETMASK)");
+    }
+    LOGI("tun") << "Address set: v4 " << ip << "/" << prefix_len << " on " << ifname;
+}
+
+void LinuxTun::AddAddress6(const std::string &ifname,
+                           const std::string &ip,
+                           unsigned prefix_len)
+{
+    if (prefix_len > 128)
+    {
+        throw std::invalid_argument("AddAddress6: invalid prefix length");
+    }
+    In6Ifreq req{};
+    if (::inet_pton(AF_INET6, ip.c_str(), &req.addr) != 1)
+    {
+        LOGE("tun") << "AddAddress6: invalid IPv6 '" << ip << "'";
+        throw std::invalid_argument("AddAddress6: invalid IPv6");
+    }
+    req.prefix_len = prefix_len;
+
+    CtlSocket sock(AF_INET6);
+    ifreq ifr = MakeIfreq(ifname);
+    if (::ioctl(sock.Fd(), SIOCGIFINDEX, &ifr) < 0)
+    {
+        ThrowErrno("ioctl(SIOCGIFINDEX)");
+    }
+    req.ifindex = ifr.ifr_ifindex;
+    if (::ioctl(sock.Fd(), SIOCSIFADDR, &req) < 0 && errno != EEXIST)
+    {
+        ThrowErrno("ioctl(SIOCSIFADDR v6)");
+    }
+    LOGI("tun") << "Address set: v6 " << ip << "/" << prefix_len << " on " << ifname;
+}
+
+void LinuxTun::SetMtu(const std::string &ifname,
+                      unsigned mtu)
+{
+    CtlSocket sock(AF_INET);
+    ifreq ifr = MakeIfreq(ifname);
+    ifr.ifr_mtu = static_cast<int>(mtu);
+    if (::ioctl(sock.Fd(), SIOCSIFMTU, &ifr) < 0)
+    {
+        ThrowErrno("ioctl(SIOCSIFMTU)");
+    }
+    LOGD("tun") << "MTU set: " << ifname << " mtu=" << mtu;
+}
+
+void LinuxTun::Up(const std::string &ifname)
+{
+    CtlSocket sock(AF_INET);
+    ifreq ifr = MakeIfreq(ifname);
+    if (::ioctl(sock.Fd(), SIOCGIFFLAGS, &ifr) < 0)
+    {
+        ThrowErrno("ioctl(SIOCGIFFLAGS)");
+    }
+    ifr.ifr_flags = static_cast<short>(ifr.ifr_flags | IFF_UP | IFF_RUNNING);
+    if (::ioctl(sock.Fd(), SIOCSIFFLAGS, &ifr) < 0)
+    {
+        ThrowErrno("ioctl(SIOCSIFFLAGS)");
+    }
+    LOGI("tun") << "Interface up: " << ifname;
+}
@@ -0,0 +1,106 @@
+#pragma once
+// LinuxTun.hpp — RAII-обёртка над /dev/net/tun (Linux) для серверного ядра.
+
+#include "TunDevice.hpp"
+
+#include <string>
+
+/**
+ * @brief Очередь TUN-устройства Linux (IFF_TUN | IFF_NO_PI, неблокирующий дескриптор).
+ *
+ * С vnet_hdr=true очередь открывается с IFF_VNET_HDR: каждый пакет идёт с
+ * заголовком virtio_net_hdr (Read и Write его снимают и добавляют сами), а
+ * WriteGso передаёт ядру склеенный TCP-пакет с частичной суммой — ядро
+ * сегментирует его (GSO) или отдаёт стеку целиком (GRO хоста). EnableTso
+ * разрешает ядру отдавать такие пакеты и в обратную сторону (ReadGso).
+ *
+ * Первый экземпляр создаёт (или подхватывает) интерфейс, дополнительные
+ * экземпляры с multi_queue=true открывают ещё одну очередь того же интерфейса.
+ * Настройка интерфейса (адреса, MTU, up) — статическими методами по имени.
+ * Ошибки сигнализируются стандартными исключениями.
+ */
+class LinuxTun final : public TunDevice
+{
+public:
+    /**
+     * @brief Открыть очередь интерфейса.
+     * @param name        Желаемое имя интерфейса (может быть изменено ядром).
+     * @param multi_queue Открыть в режиме IFF_MULTI_QUEUE.
+     * @param vnet_hdr    Открыть с IFF_VNET_HDR (для WriteGso); у всех очередей интерфейса — одинаково.
+     * @throw std::runtime_error Ошибка open/ioctl.
+     */
+    explicit LinuxTun(const std::string &name, bool multi_queue = false, bool vnet_hdr = false);
+
+    /**
+     * @brief Закрывает дескриптор очереди.
+     */
+    ~LinuxTun() override;
+
+    LinuxTun(const LinuxTun &) = delete;
+    LinuxTun &operator=(const LinuxTun &) = delete;
+
+    /**
+     * @brief Перемещающий конструктор: переносит владение дескриптором.
+     */
+    LinuxTun(LinuxTun &&other) noexcept;
+
+    /**
+     * @brief Перемещающее присваивание: закрывает свой дескриптор и принимает other.
+     */
+    LinuxTun &operator=(LinuxTun &&other) noexcept;
+
+    ssize_t Read(std::uint8_t *buf, std::size_t size) noexcept override;
+    ssize_t Write(const std::uint8_t *buf, std::size_t len) noexcept override;
+    ssize_t ReadGso(std::uint8_t *buf, std::size_t size, Gso *gso) noexcept override;
+    bool SupportsGso() const noexcept override { return vnet_; }
+    ssize_t WriteGso(const std::uint8_t *buf, std::size_t len, const Gso &gso) noexcept override;
+
+    /** @brief Фактическое имя интерфейса. */
+    const std::string &Name() const noexcept { return name_; }
+
+    /** @brief Дескриптор очереди (для poll/epoll). */
+    int Fd() const noexcept { return fd_; }
+
+    /**
+     * @brief Разрешить интерфейсу отдавать TCP-суперпакеты и частичные суммы
+     *        (TUNSETOFFLOAD: CSUM, TSO4, TSO6; действует на все очереди).
+     *        Читать после этого — только ReadGso.
+     * @throw std::logic_error   Очередь открыта без vnet_hdr.
+     * @throw std::runtime_error Ошибка ioctl.
+     */
+    void EnableTso();
+
+    /**
+     * @brief Назначить IPv4-адрес с префиксом.
+     * @throw std::invalid_argument Невалидный адрес/префикс.
+     * @throw std::runtime_error    Ошибка ioctl.
+     */
+    static void AddAddress4(const std::string &ifname, const std::string &ip, unsigned prefix_len);
+
+    /**
+     * @brief Назначить IPv6-адрес с префиксом.
+     * @throw std::invalid_argument Невалидный адрес/префикс.
+     * @throw std::runtime_error    Ошибка ioctl.
+     */
+    static void AddAddress6(const std::string &ifname, const std::string &ip, unsigned prefix_len);
+
+    /**
+     * @brief Установить MTU интерфейса.
+     * @throw std::runtime_error Ошибка ioctl.
+     */
+    static void SetMtu(const std::string &ifname, unsigned mtu);
+
+    /**
+     * @brief Поднять интерфейс (IFF_UP | IFF_RUNNING).
+     * @throw std::runtime_error Ошибка ioctl.
+     */
+    static void Up(const std::string &ifname);
+
+private:
+    int         fd_ = -1;
+    bool        vnet_ = false;
+    std::string name_;
+
+    /// @brief writev заголовка virtio_net_hdr и пакета.
+    ssize_t WriteVnet(const void *hdr, const std::uint8_t *buf, std::size_t len) noexcept;
+};
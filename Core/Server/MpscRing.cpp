@@ -0,0 +1,95 @@
+// MpscRing.cpp — реализация MPSC-кольца пакетов.
+
+#include "MpscRing.hpp"
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+MpscRing::MpscRing(std::size_t capacity,
+                   std::size_t slot_size)
+    : mask_(std::bit_ceil(capacity == 0 ? std::size_t{1} : capacity) - 1)
+    , slot_size_(slot_size)
+{
+    if (capacity == 0 || slot_size == 0)
+    {
+        throw std::invalid_argument("MpscRing: capacity and slot_size must be non-zero");
+    }
+    cells_ = std::make_unique<Cell[]>(mask_ + 1);
+    data_  = std::make_unique<std::uint8_t[]>((mask_ + 1) * slot_size_);
+    for (std::size_t i = 0; i <= mask_; ++i)
+    {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool MpscRing::Push(SessionId session,
+                    const std::uint8_t *data,
+                    std::size_t len) noexcept
+{
+    if (len == 0 || len > slot_size_)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    std::size_t pos = tail_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;)
+    {
+        cell = &cells_[pos & mask_];
+        const std::size_t seq = cell->seq.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0)
+        {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // Ячейка ещё не прочитана с прошлого круга — кольцо полно.
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::memcpy(data_.get() + (pos & mask_) * slot_size_, data, len);
+    cell->session = session;
+    cell->len     = static_cast<std::uint32_t>(len);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+ssize_t MpscRing::Pop(SessionId *session,
+                      std::uint8_t *buf,
+                      std::size_t size) noexcept
+{
+    Cell &cell = cells_[head_ & mask_];
+    if (cell.seq.load(std::memory_order_acquire) != head_ + 1)
+    {
+        return 0;
+    }
+
+    const std::size_t len = cell.len;
+    const bool fits = len <= size;
+    if (fits)
+    {
+        std::memcpy(buf, data_.get() + (head_ & mask_) * slot_size_, len);
+        *session = cell.session;
+    }
+    cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+    ++head_;
+
+    if (!fits)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+    return static_cast<ssize_t>(len);
+}
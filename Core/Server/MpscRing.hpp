@@ -0,0 +1,75 @@
+#pragma once
+// MpscRing.hpp — lock-free кольцо пакетов «много писателей — один читатель» для передачи между шардами.
+
+#include "Core/SessionApi.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Ограниченное MPSC-кольцо пакетов на заранее выделенных слотах.
+ *
+ * Схема Вьюкова: у каждой ячейки свой счётчик последовательности, писатели
+ * резервируют позицию одним CAS по tail, читатель двигает head без атомиков RMW.
+ * Память слотов — собственный пул буферов шарда-читателя; Push/Pop не аллоцируют.
+ *
+ * При переполнении новый пакет отбрасывается (писатель не ждёт читателя):
+ * шард-отправитель не должен блокироваться из-за медленного соседа.
+ */
+class MpscRing
+{
+public:
+    /**
+     * @brief Создать кольцо.
+     * @param capacity  Число слотов (округляется вверх до степени двойки).
+     * @param slot_size Максимальный размер пакета (обычно MTU).
+     * @throw std::invalid_argument Нулевая ёмкость или размер слота.
+     */
+    MpscRing(std::size_t capacity, std::size_t slot_size);
+
+    MpscRing(const MpscRing &) = delete;
+    MpscRing &operator=(const MpscRing &) = delete;
+
+    /**
+     * @brief Положить копию пакета (любой поток).
+     * @return false — кольцо заполнено или пакет больше слота (отброшен).
+     */
+    bool Push(SessionId session, const std::uint8_t *data, std::size_t len) noexcept;
+
+    /**
+     * @brief Забрать пакет (только поток-владелец).
+     * @return Длина; 0 — кольцо пусто; -1 — пакет не влез в buf (отброшен).
+     */
+    ssize_t Pop(SessionId *session, std::uint8_t *buf, std::size_t size) noexcept;
+
+    /** @brief Ёмкость в пакетах. */
+    std::size_t Capacity() const noexcept { return mask_ + 1; }
+
+    /** @brief Размер слота в байтах. */
+    std::size_t SlotSize() const noexcept { return slot_size_; }
+
+    /** @brief Сколько пакетов отброшено (переполнение/размер). */
+    std::uint64_t Dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> seq{0};
+        SessionId                session = 0;
+        std::uint32_t            len     = 0;
+    };
+
+    std::size_t                      mask_;
+    std::size_t                      slot_size_;
+    std::unique_ptr<Cell[]>          cells_;
+    std::unique_ptr<std::uint8_t[]>  data_;
+
+    /// @brief Позиция записи (общая для писателей).
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    /// @brief Позиция чтения (только читатель).
+    alignas(64) std::size_t              head_ = 0;
+
+    alignas(64) std::atomic<std::uint64_t> dropped_{0};
+};
@@ -0,0 +1,596 @@
+#include "Core/PluginWrapper.hpp"
+#include "Core/Logger.hpp"
+#include "Core/Config.hpp"
+#include "Core/Gf256.hpp"
+#include "Core/FlowAccounting.hpp"
+#include "Core/TimerService.hpp"
+#include "Core/Segmenter.hpp"
+#include "LinuxTun.hpp"
+#include "SessionRouter.hpp"
+#include "Server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <boost/json.hpp>
+#include <boost/log/trivial.hpp>
+
+static std::atomic<bool> g_started { false };
+static volatile sig_atomic_t g_working = 1;
+static std::thread g_thread;
+
+/// @brief Создать пул по префиксу и исключить из него адрес самого сервера.
+static std::unique_ptr<AddressPool> MakePool(const std::string &cidr,
+                                             std::uint32_t      max_size,
+                                             int                quarantine_ms,
+                                             const std::string &local,
+                                             int                family)
+{
+    if (cidr.empty())
+        return nullptr;
+
+    AddressPool::Options opts;
+    opts.cidr       = cidr;
+    opts.max_size   = max_size;
+    opts.quarantine = std::chrono::milliseconds(quarantine_ms);
+    auto pool = std::make_unique<AddressPool>(opts);
+    if (pool->Family() != family)
+        throw std::runtime_error("pool '" + cidr + "' has wrong address family");
+
+    int                local_family = 0;
+    AddressPool::Addr  local_addr{};
+    unsigned           local_len = 0;
+    AddressPool::ParseCidr(local + (family == 4 ? "/32" : "/128"), local_family, local_addr, local_len);
+    pool->Reserve(local_addr);
+    return pool;
+}
+
+/// @brief Привязать текущий поток к одному CPU (ошибка не фатальна).
+static void PinToCpu(unsigned cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+        LOGW("shard") << "Failed to pin to CPU " << cpu << ": " << std::strerror(err);
+}
+
+/// @brief Запустить Server_ServeShard в отдельном потоке на каждый шард и дождаться всех.
+static int RunShards(const PluginWrapper::Plugin &plugin,
+                     SessionRouter               &router,
+                     bool                         pin)
+{
+    const unsigned n    = router.Shards();
+    const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<int>         rcs(n, 0);
+    std::vector<std::thread> threads;
+    threads.reserve(n);
+    try
+    {
+        for (unsigned i = 0; i < n; ++i)
+        {
+            threads.emplace_back([&plugin, &router, &rcs, i, n, cpus, pin]()
+            {
+                if (pin)
+                    PinToCpu(i % cpus);
+
+                LOGI("shard") << "Shard " << i << "/" << n << " started";
+                rcs[i] = PluginWrapper::Server_ServeShard(plugin, i, n, router.Api(i), &g_working);
+                LOGI("shard") << "Shard " << i << " exited rc=" << rcs[i];
+
+                // Без одного шарда часть клиентов обслуживать некому — останавливаем всех.
+                if (rcs[i] != 0)
+                    g_working = 0;
+            });
+        }
+    }
+    catch (...)
+    {
+        g_working = 0;
+        for (auto &t : threads)
+            t.join();
+        throw;
+    }
+
+    for (auto &t : threads)
+        t.join();
+
+    for (int rc : rcs)
+        if (rc != 0)
+            return rc;
+    return 0;
+}
+
+static int ServerMain(std::string& config)
+{
+    Logger::Options logger_options;
+    logger_options.app_name = "FlowForgeServer";
+    logger_options.directory = "logs";
+    logger_options.base_filename = "flowforge-server";
+    logger_options.file_min_severity = boost::log::trivial::info;
+    logger_options.console_min_severity = boost::log::trivial::debug;
+
+    Logger::Guard logger(logger_options);            // одна инициализация на процесс
+    LOGI("server") << "Starting FlowForge server";
+
+    LOGD("server") << "Parsing JSON config";
+
+    boost::json::value jv = boost::json::parse(config);
+    if (!jv.is_object())
+        throw std::runtime_error("config root must be an object");
+
+    boost::json::object &o = jv.as_object();
+
+    // Обязательные поля:
+    const std::string tun_name    = Config::RequireString(o, "tun");
+    const std::string plugin_path = Config::RequireString(o, "plugin");
+    const std::string local4      = Config::RequireString(o, "local4");
+    const std::string local6      = Config::RequireString(o, "local6");
+    const int         mtu         = Config::RequireInt(o,    "mtu");
+
+    // Необязательные:
+    const int prefix4      = Config::OptionalInt(o, "prefix4", 22);
+    const int prefix6      = Config::OptionalInt(o, "prefix6", 64);
+    const int max_sessions = Config::OptionalInt(o, "max_sessions", 0);
+    const std::string pool4      = Config::OptionalString(o, "pool4", "");
+    const std::string pool6      = Config::OptionalString(o, "pool6", "");
+    const int pool6_size         = Config::OptionalInt(o, "pool6_size", 65536);
+    const int quarantine_ms      = Config::OptionalInt(o, "quarantine_ms", 60000);
+    const std::string pool_state = Config::OptionalString(o, "pool_state", "");
+    int shards                   = Config::OptionalInt(o, "shards", 1);
+    const bool pin_shards        = Config::OptionalBool(o, "pin_shards", false);
+    const bool direct_c2c        = Config::OptionalBool(o, "direct_c2c", false);
+    const int inbox_slots        = Config::OptionalInt(o, "inbox_slots", 1024);
+    const int reorder_window     = Config::OptionalInt(o, "reorder_window", 64);
+    const int reorder_hold_ms    = Config::OptionalInt(o, "reorder_hold_ms", 30);
+    const bool fec               = Config::OptionalBool(o, "fec", true);
+    const int fec_k              = Config::OptionalInt(o, "fec_k", 10);
+    const int fec_max_m          = Config::OptionalInt(o, "fec_max_m", 4);
+    const int fec_min_m          = Config::OptionalInt(o, "fec_min_m", 0);
+    const int fec_flush_ms       = Config::OptionalInt(o, "fec_flush_ms", 10);
+    const bool bundle            = Config::OptionalBool(o, "bundle", true);
+    const int bundle_max_item    = Config::OptionalInt(o, "bundle_max_item", 256);
+    const int bundle_delay_us    = Config::OptionalInt(o, "bundle_delay_us", 500);
+    const bool compress          = Config::OptionalBool(o, "compress", true);
+    const bool compress_headers  = Config::OptionalBool(o, "compress_headers", true);
+    const bool gro               = Config::OptionalBool(o, "gro", false);
+    const int gro_hold_us        = Config::OptionalInt(o, "gro_hold_us", 100);
+    const bool tso               = Config::OptionalBool(o, "tso", false);
+    const bool tickets_enabled   = Config::OptionalBool(o, "tickets", false);
+    const int ticket_lifetime_s  = Config::OptionalInt(o, "ticket_lifetime_s", 43200);
+    const std::string ticket_key_file = Config::OptionalString(o, "ticket_key_file", "");
+    const std::string accounting_file   = Config::OptionalString(o, "accounting_file", "");
+    const std::string accounting_format = Config::OptionalString(o, "accounting_format", "csv");
+    const int accounting_interval_s     = Config::OptionalInt(o, "accounting_interval_s", 60);
+    const int accounting_sample         = Config::OptionalInt(o, "accounting_sample", 1);
+    const int accounting_flows          = Config::OptionalInt(o, "accounting_flows", 65536);
+    const int accounting_idle_s         = Config::OptionalInt(o, "accounting_idle_s", 120);
+
+    LOGD("server") << "Args: tun=" << tun_name << " plugin=" << plugin_path
+                   << " local4=" << local4 << "/" << prefix4
+                   << " local6=" << local6 << "/" << prefix6
+                   << " mtu=" << mtu << " max_sessions=" << max_sessions
+                   << " pool4=" << pool4 << " pool6=" << pool6
+                   << " shards=" << shards << " tickets=" << tickets_enabled;
+
+    if (mtu < 576 || mtu > 9200)
+        throw std::runtime_error("'mtu' must be in [576..9200]");
+    if (prefix4 < 1 || prefix4 > 32)
+        throw std::runtime_error("'prefix4' must be in [1..32]");
+    if (prefix6 < 1 || prefix6 > 128)
+        throw std::runtime_error("'prefix6' must be in [1..128]");
+    if (max_sessions < 0)
+        throw std::runtime_error("'max_sessions' must be >= 0");
+    if (pool6_size < 1)
+        throw std::runtime_error("'pool6_size' must be >= 1");
+    if (quarantine_ms < 0)
+        throw std::runtime_error("'quarantine_ms' must be >= 0");
+    if (shards < 0 || shards > 256)
+        throw std::runtime_error("'shards' must be in [0..256]");
+    if (inbox_slots < 16)
+        throw std::runtime_error("'inbox_slots' must be >= 16");
+    if (reorder_window < 2 || reorder_window > 4096)
+        throw std::runtime_error("'reorder_window' must be in [2..4096]");
+    if (reorder_hold_ms < 1 || reorder_hold_ms > 1000)
+        throw std::runtime_error("'reorder_hold_ms' must be in [1..1000]");
+    if (bundle_max_item < 40 || bundle_max_item > mtu / 2 - 8)
+        throw std::runtime_error("'bundle_max_item' must be in [40..mtu/2-8]");
+    if (bundle_delay_us < 0 || bundle_delay_us > 10000)
+        throw std::runtime_error("'bundle_delay_us' must be in [0..10000]");
+    if (gro_hold_us < 0 || gro_hold_us > 10000)
+        throw std::runtime_error("'gro_hold_us' must be in [0..10000]");
+    if (fec_k < 1 || fec_k > static_cast<int>(FecEncoder::kMaxSources))
+        throw std::runtime_error("'fec_k' must be in [1..64]");
+    if (fec_max_m < 1 || fec_max_m > static_cast<int>(FecEncoder::kMaxRepairs))
+        throw std::runtime_error("'fec_max_m' must be in [1..32]");
+    if (fec_min_m < 0 || fec_min_m > fec_max_m)
+        throw std::runtime_error("'fec_min_m' must be in [0..fec_max_m]");
+    if (fec_flush_ms < 1 || fec_flush_ms > 1000)
+        throw std::runtime_error("'fec_flush_ms' must be in [1..1000]");
+    if (ticket_lifetime_s < 60)
+        throw std::runtime_error("'ticket_lifetime_s' must be >= 60");
+    if (accounting_format != "csv" && accounting_format != "ipfix")
+        throw std::runtime_error("'accounting_format' must be \"csv\" or \"ipfix\"");
+    if (accounting_interval_s < 1 || accounting_interval_s > 86400)
+        throw std::runtime_error("'accounting_interval_s' must be in [1..86400]");
+    if (accounting_sample < 1 || accounting_sample > 65536)
+        throw std::runtime_error("'accounting_sample' must be in [1..65536]");
+    if (accounting_flows < 16 || accounting_flows > (1 << 24))
+        throw std::runtime_error("'accounting_flows' must be in [16..16777216]");
+    if (accounting_idle_s < 1)
+        throw std::runtime_error("'accounting_idle_s' must be >= 1");
+
+    LOGD("pluginwrapper") << "Loading plugin: " << plugin_path;
+    auto plugin = PluginWrapper::Load(plugin_path);
+    if (!plugin.handle)
+    {
+        LOGE("pluginwrapper") << "Failed to load plugin: " << plugin_path;
+        return 1;
+    }
+    LOGI("pluginwrapper") << "Plugin loaded: " << plugin_path;
+
+    if (shards == 0)
+        shards = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    if (shards > 1 && !PluginWrapper::HasServerShards(plugin))
+    {
+        LOGW("shard") << "Plugin does not export Server_ServeShard, running single shard";
+        shards = 1;
+    }
+    o["shards"] = static_cast<std::int64_t>(shards);   // плагину: сколько сокетов SO_REUSEPORT ожидать
+
+    // Одна очередь TUN на шард; первая создаёт и настраивает интерфейс.
+    std::vector<LinuxTun> queues;
+    queues.reserve(static_cast<std::size_t>(shards));
+    // GRO/TSO: очереди с virtio_net_hdr принимают и отдают пакеты до 64 КиБ.
+    const bool vnet_hdr = gro || tso;
+    queues.emplace_back(tun_name, shards > 1, vnet_hdr);
+    LinuxTun &tun = queues.front();
+    LinuxTun::SetMtu(tun.Name(), static_cast<unsigned>(mtu));
+    LinuxTun::AddAddress4(tun.Name(), local4, static_cast<unsigned>(prefix4));
+    LinuxTun::AddAddress6(tun.Name(), local6, static_cast<unsigned>(prefix6));
+    LinuxTun::Up(tun.Name());
+    for (int i = 1; i < shards; ++i)
+        queues.emplace_back(tun.Name(), true, vnet_hdr);
+    if (tso)
+        tun.EnableTso();
+    LOGI("tun") << "Up: " << tun.Name() << " queues=" << queues.size();
+
+    if (!PluginWrapper::Server_Bind(plugin, o))
+    {
+        LOGE("pluginwrapper") << "Server_Bind failed";
+        PluginWrapper::Unload(plugin);
+        return 1;
+    }
+    LOGI("pluginwrapper") << "Bound";
+
+    int rc = 0;
+    if (PluginWrapper::HasServerSessions(plugin) || PluginWrapper::HasServerShards(plugin))
+    {
+        auto p4 = MakePool(pool4, 0, quarantine_ms, local4, 4);
+        auto p6 = MakePool(pool6, static_cast<std::uint32_t>(pool6_size), quarantine_ms, local6, 6);
+        if (!pool_state.empty())
+        {
+            // Один файл на семейство: ".4" / ".6".
+            if (p4 && p4->Load(pool_state + ".4"))
+                LOGI("addresspool") << "Restored v4 state, active=" << p4->Active();
+            if (p6 && p6->Load(pool_state + ".6"))
+                LOGI("addresspool") << "Restored v6 state, active=" << p6->Active();
+        }
+
+        std::vector<TunDevice *> queue_ptrs;
+        for (auto &q : queues)
+            queue_ptrs.push_back(&q);
+
+        SessionRouter::Options router_opts;
+        router_opts.max_sessions = static_cast<std::size_t>(max_sessions);
+        router_opts.mtu          = static_cast<std::size_t>(mtu);
+        router_opts.inbox_slots  = static_cast<std::size_t>(inbox_slots);
+        router_opts.direct_c2c   = direct_c2c;
+        router_opts.reorder_window = static_cast<std::size_t>(reorder_window);
+        router_opts.reorder_hold   = std::chrono::milliseconds(reorder_hold_ms);
+        router_opts.fec            = fec;
+        router_opts.fec_tx.k       = static_cast<unsigned>(fec_k);
+        router_opts.fec_tx.max_m   = static_cast<unsigned>(fec_max_m);
+        router_opts.fec_tx.min_m   = static_cast<unsigned>(fec_min_m);
+        router_opts.fec_tx.flush   = std::chrono::milliseconds(fec_flush_ms);
+        router_opts.bundle         = bundle;
+        router_opts.bundle_tx.max_item  = static_cast<std::size_t>(bundle_max_item);
+        router_opts.bundle_tx.max_delay = std::chrono::microseconds(bundle_delay_us);
+        router_opts.compress       = compress;
+        router_opts.compress_headers = compress_headers;
+        router_opts.gro            = gro;
+        router_opts.gro_opts.hold  = std::chrono::microseconds(gro_hold_us);
+        router_opts.tso            = tso;
+        router_opts.accounting     = !accounting_file.empty();
+        router_opts.flows.capacity = static_cast<std::size_t>(accounting_flows);
+        router_opts.flows.sample   = static_cast<unsigned>(accounting_sample);
+        router_opts.flows.idle     = std::chrono::seconds(accounting_idle_s);
+        std::unique_ptr<SessionTickets> tickets;
+        if (tickets_enabled)
+        {
+            SessionTickets::Options ticket_opts;
+            ticket_opts.lifetime = std::chrono::seconds(ticket_lifetime_s);
+            ticket_opts.rotate   = std::chrono::seconds(std::max(ticket_lifetime_s / 2, 60));
+            ticket_opts.key_file = ticket_key_file;
+            tickets = std::make_unique<SessionTickets>(ticket_opts);
+        }
+
+        SessionRouter router(queue_ptrs, router_opts, p4.get(), p6.get(), tickets.get());
+
+        // Учёт: выгрузка раз в accounting_interval_s из потока таймеров; записи
+        // собираются под мьютексами шардов, в файл пишутся уже без них.
+        std::unique_ptr<FlowExporter> exporter;
+        std::unique_ptr<TimerService> timers;
+        TimerService::Handle export_timer = TimerService::kNoTimer;
+        const auto export_flows = [&](bool flush)
+        {
+            const auto now = FlowAccounting::Clock::now();
+            exporter->Begin(now, router.FlowSample());
+            router.DrainFlows(now, [&](const FlowAccounting::Record &r) { exporter->Add(r); }, flush);
+            const std::size_t n = exporter->Commit();
+            LOGD("accounting") << "Exported " << n << " records";
+        };
+        if (router.Accounting())
+        {
+            FlowExporter::Options export_opts;
+            export_opts.path   = accounting_file;
+            export_opts.format = accounting_format == "ipfix" ? FlowExporter::Format::Ipfix : FlowExporter::Format::Csv;
+            exporter = std::make_unique<FlowExporter>(export_opts);
+            TimerService::Options timer_opts;
+            timer_opts.tick     = std::chrono::milliseconds(100);
+            timer_opts.capacity = 16;
+            timers = std::make_unique<TimerService>(timer_opts);
+            export_timer = timers->Every(std::chrono::seconds(accounting_interval_s), [&]
+            {
+                try
+                {
+                    export_flows(false);
+                }
+                catch (const std::exception &e)
+                {
+                    LOGW("accounting") << "Export failed: " << e.what();
+                }
+            });
+            LOGI("accounting") << "Exporting " << accounting_format << " to " << accounting_file
+                               << " every " << accounting_interval_s << "s";
+        }
+
+        if (router.Shards() > 1)
+        {
+            LOGI("pluginwrapper") << "Sharded serve loop started, shards=" << router.Shards();
+            rc = RunShards(plugin, router, pin_shards);
+        }
+        else if (PluginWrapper::HasServerSessions(plugin))
+        {
+            LOGI("pluginwrapper") << "Session serve loop started";
+            rc = PluginWrapper::Server_ServeSessions(plugin, router.Api(), &g_working);
+        }
+        else
+        {
+            LOGI("pluginwrapper") << "Single shard serve loop started";
+            rc = PluginWrapper::Server_ServeShard(plugin, 0, 1, router.Api(), &g_working);
+        }
+        LOGI("pluginwrapper") << "Session serve loop exited rc=" << rc;
+
+        if (exporter)
+        {
+            timers->CancelWait(export_timer);
+            try
+            {
+                export_flows(true);
+            }
+            catch (const std::exception &e)
+            {
+                LOGW("accounting") << "Final export failed: " << e.what();
+            }
+            std::size_t flows = 0;
+            const FlowAccounting::Stats as = router.GetFlowStats(&flows);
+            LOGI("accounting") << "Flows: seen=" << as.seen << " sampled=" << as.sampled
+                               << " unparsed=" << as.unparsed << " records=" << as.records
+                               << " folded=" << as.folded << " lumped=" << as.lumped << " live=" << flows;
+        }
+
+        for (unsigned i = 0; i < router.Shards(); ++i)
+        {
+            const auto &st = router.GetStats(i);
+            LOGI("sessions") << "Stats[" << i << "]: tun_rx=" << st.tun_rx.load() << " tun_tx=" << st.tun_tx.load()
+                             << " no_route=" << st.no_route.load() << " spoofed=" << st.spoofed.load()
+                             << " malformed=" << st.malformed.load() << " rejected=" << st.rejected.load()
+                             << " handoff=" << st.handoff.load() << " handoff_drops=" << st.handoff_drops.load()
+                             << " c2c=" << st.c2c.load() << " probes=" << st.probes.load()
+                             << " sequenced=" << st.sequenced.load()
+                             << " fec_protected=" << st.fec_protected.load()
+                             << " unbundled=" << st.unbundled.load() << " bundled=" << st.bundled.load()
+                             << " supers=" << st.supers.load() << " segments=" << st.segments.load()
+                             << " inflated=" << st.inflated.load() << " compressed=" << st.compressed.load();
+        }
+        const ReorderBuffer::Stats rs = router.GetReorderStats();
+        if (rs.in_order + rs.reordered + rs.late != 0)
+        {
+            LOGI("sessions") << "Reorder: in_order=" << rs.in_order << " reordered=" << rs.reordered
+                             << " late=" << rs.late << " skipped=" << rs.skipped << " dup=" << rs.duplicates
+                             << " overflow=" << rs.overflow << " max_depth=" << rs.max_depth
+                             << " depth[1,2-3,4-7,8-15,16+]=" << rs.depth[0] << "," << rs.depth[1] << ","
+                             << rs.depth[2] << "," << rs.depth[3] << "," << rs.depth[4];
+        }
+        const Gro::Stats gs = router.GetGroStats();
+        if (gs.packets != 0)
+        {
+            LOGI("sessions") << "GRO: packets=" << gs.packets << " coalesced=" << gs.coalesced
+                             << " supers=" << gs.supers << " passthrough=" << gs.passthrough
+                             << " bad_csum=" << gs.bad_csum << " expired=" << gs.expired;
+        }
+        const SessionRouter::FecStats fs = router.GetFecStats();
+        if (fs.rx.sources + fs.tx.sources != 0)
+        {
+            LOGI("sessions") << "FEC rx: sources=" << fs.rx.sources << " repairs=" << fs.rx.repairs
+                             << " recovered=" << fs.rx.recovered << " unrecovered=" << fs.rx.unrecovered
+                             << " late=" << fs.rx.late << " malformed=" << fs.rx.malformed;
+            LOGI("sessions") << "FEC tx: sources=" << fs.tx.sources << " repairs=" << fs.tx.repairs
+                             << " blocks=" << fs.tx.blocks << " stale=" << fs.tx.stale
+                             << " overhead=" << (fs.tx.source_bytes ? fs.tx.repair_bytes * 100 / fs.tx.source_bytes : 0)
+                             << "% (" << Gf256::Backend() << ")";
+        }
+        const SessionRouter::CompressStats cs = router.GetCompressStats();
+        if (cs.rx.frames + cs.tx.packets != 0)
+        {
+            LOGI("sessions") << "Compression rx: frames=" << cs.rx.frames << " bytes=" << cs.rx.bytes_in << "->"
+                             << cs.rx.bytes_out << " dict_sets=" << cs.rx.dict_sets << " no_dict=" << cs.rx.no_dict
+                             << " malformed=" << cs.rx.malformed;
+            LOGI("sessions") << "Compression tx: packets=" << cs.tx.packets << " compressed=" << cs.tx.compressed
+                             << " bytes=" << cs.tx.bytes_in << "->" << cs.tx.bytes_out
+                             << " skipped_small=" << cs.tx.skipped_small << " skipped_entropy=" << cs.tx.skipped_entropy
+                             << " skipped_off=" << cs.tx.skipped_off << " flows_off=" << cs.tx.flows_off
+                             << " dict_acks=" << cs.tx.dict_acks << "/" << cs.tx.dict_sets;
+        }
+        if (cs.header_rx.frames + cs.header_tx.packets != 0)
+        {
+            LOGI("sessions") << "Headers rx: frames=" << cs.header_rx.frames << " contexts=" << cs.header_rx.contexts
+                             << " bytes=" << cs.header_rx.bytes_in << "->" << cs.header_rx.bytes_out
+                             << " no_context=" << cs.header_rx.no_context << " stale=" << cs.header_rx.stale
+                             << " malformed=" << cs.header_rx.malformed;
+            LOGI("sessions") << "Headers tx: packets=" << cs.header_tx.packets << " compressed=" << cs.header_tx.compressed
+                             << " contexts=" << cs.header_tx.contexts << " skipped=" << cs.header_tx.skipped
+                             << " bytes=" << cs.header_tx.bytes_in << "->" << cs.header_tx.bytes_out
+                             << " refs=" << cs.header_tx.acks << "/" << cs.header_tx.refs;
+        }
+
+        if (!pool_state.empty())
+        {
+            try
+            {
+                if (p4)
+                    p4->Save(pool_state + ".4");
+                if (p6)
+                    p6->Save(pool_state + ".6");
+            }
+            catch (const std::exception &e)
+            {
+                LOGE("addresspool") << "Failed to save state: " << e.what();
+            }
+        }
+    }
+    else
+    {
+        // Плагин сам разбирает клиентов — ядро лишь качает пакеты TUN <-> плагин.
+        auto send_to_net = [&tun](const std::uint8_t *data,
+                                  std::size_t len) -> ssize_t
+        {
+            LOGT("tun") << "TO_NET len=" << len;
+            return tun.Write(data, len);
+        };
+
+        // TSO: суперпакет читается целиком и отдаётся плагину по сегменту за вызов.
+        Segmenter seg;
+        std::vector<std::uint8_t> super(tso ? 0xFFFF : 0);
+        auto receive_from_net = [&tun, &seg, &super, tso](std::uint8_t *buffer,
+                                                          std::size_t size) -> ssize_t
+        {
+            if (!tso)
+                return tun.Read(buffer, size);
+            for (;;)
+            {
+                if (const std::size_t n = seg.Next(buffer, size))
+                    return static_cast<ssize_t>(n);
+                TunDevice::Gso gso;
+                const ssize_t n = tun.ReadGso(super.data(), super.size(), &gso);
+                if (n <= 0)
+                    return n;
+                Segmenter::Offload off;
+                off.gso_size    = gso.size;
+                off.csum_start  = gso.csum_start;
+                off.csum_offset = gso.csum_offset;
+                off.partial     = gso.partial;
+                seg.Load(super.data(), static_cast<std::size_t>(n), off);
+            }
+        };
+
+        LOGI("pluginwrapper") << "Serve loop started";
+        rc = PluginWrapper::Server_Serve(plugin,
+                                         receive_from_net,
+                                         send_to_net,
+                                         &g_working);
+        LOGI("pluginwrapper") << "Serve loop exited rc=" << rc;
+        if (tso)
+        {
+            const Segmenter::Stats &ss = seg.GetStats();
+            LOGI("tun") << "TSO: supers=" << ss.supers << " segments=" << ss.segments << " csum=" << ss.csum
+                        << " malformed=" << ss.malformed << " oversize=" << ss.oversize;
+        }
+    }
+
+    LOGD("pluginwrapper") << "Unloading plugin";
+    PluginWrapper::Unload(plugin);
+    LOGI("server") << "Shutdown complete";
+    return rc;
+}
+
+// Запуск сервера в отдельном потоке.
+// cfg - json-данные конфига
+EXPORT int32_t Start(char *cfg)
+{
+    if (g_started.load())
+    {
+        return -1; // уже запущено
+    }
+
+    // Снимем копию аргументов, чтобы не зависеть от времени жизни входных указателей.
+    std::string config = cfg;
+    g_working = 1;
+
+    g_thread = std::thread([config]() mutable
+       {
+           try
+           {
+               ServerMain(config);
+           }
+           catch (const std::exception &e)
+           {
+               LOGF("server") << "Fatal: " << e.what();
+           }
+           g_started.store(false);
+       });
+
+    // Не детачим: хотим корректно join-ить в Stop() (без блокировки вызывающего).
+    g_started.store(true);
+    return 0;
+}
+
+// Мягкая остановка: сигналим рабочему коду и НЕ блокируем вызывающего.
+EXPORT int32_t Stop(void)
+{
+    if (!g_started.load())
+    {
+        return -2; // не запущено
+    }
+    g_working = 0;
+
+    // Фоновое ожидание завершения рабочего потока.
+    std::thread([]()
+    {
+        if (g_thread.joinable())
+        {
+            g_thread.join();
+        }
+        g_started.store(false);
+    }).detach();
+
+    return 0;
+}
+
+// Статус работы: 1 — запущен, 0 — остановлен
+EXPORT int32_t IsRunning(void)
+{
+    return g_started.load() ? 1 : 0;
+}
@@ -0,0 +1,1816 @@
+// SessionRouter.cpp — реализация маршрутизации TUN <-> сессии.
+
+#include "SessionRouter.hpp"
+#include "Core/CoreFrame.hpp"
+#include "Core/Logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+    /// @brief Сколько пакетов без адресата пропустить за один вызов ReceiveFromTun.
+    constexpr int kReadBurst = 32;
+
+    inline std::uint32_t LoadBe32(const std::uint8_t *p) noexcept
+    {
+        return (static_cast<std::uint32_t>(p[0]) << 24) |
+               (static_cast<std::uint32_t>(p[1]) << 16) |
+               (static_cast<std::uint32_t>(p[2]) << 8)  |
+                static_cast<std::uint32_t>(p[3]);
+    }
+
+    inline AddressPool::Addr Addr4Of(std::uint32_t addr) noexcept
+    {
+        AddressPool::Addr out{};
+        out[0] = static_cast<std::uint8_t>(addr >> 24);
+        out[1] = static_cast<std::uint8_t>(addr >> 16);
+        out[2] = static_cast<std::uint8_t>(addr >> 8);
+        out[3] = static_cast<std::uint8_t>(addr);
+        return out;
+    }
+
+    /// @brief Версия IP по первому полубайту (0 — не IP или слишком короткий пакет).
+    inline int IpVersionOf(const std::uint8_t *pkt, std::size_t len) noexcept
+    {
+        if (len >= 20 && (pkt[0] >> 4) == 4) return 4;
+        if (len >= 40 && (pkt[0] >> 4) == 6) return 6;
+        return 0;
+    }
+
+    /// @brief Период выпуска просроченных пакетов из окон, мкс.
+    constexpr std::int64_t kExpirePeriodUs = 1000;
+
+    /// @brief Период обхода кодеров FEC (закрытие блоков по таймеру, отчёты), мкс.
+    constexpr std::int64_t kFecPollPeriodUs = 2000;
+
+    /// @brief Запас слота кольца сверх MTU: кадр Seq внутри кадра Fec и длина символа.
+    constexpr std::size_t kFrameSlack = CoreFrame::kSeqHeaderSize + CoreFrame::kFecHeaderSize + 2;
+
+    void Accumulate(ReorderBuffer::Stats &to, const ReorderBuffer::Stats &from) noexcept
+    {
+        to.in_order   += from.in_order;
+        to.reordered  += from.reordered;
+        to.late       += from.late;
+        to.duplicates += from.duplicates;
+        to.skipped    += from.skipped;
+        to.overflow   += from.overflow;
+        to.max_depth   = std::max(to.max_depth, from.max_depth);
+        for (std::size_t i = 0; i < std::size(to.depth); ++i)
+        {
+            to.depth[i] += from.depth[i];
+        }
+    }
+
+    void Accumulate(FecEncoder::Stats &to, const FecEncoder::Stats &from) noexcept
+    {
+        to.sources       += from.sources;
+        to.repairs       += from.repairs;
+        to.blocks        += from.blocks;
+        to.source_bytes  += from.source_bytes;
+        to.repair_bytes  += from.repair_bytes;
+        to.stale         += from.stale;
+        to.peer_loss_ppm  = std::max(to.peer_loss_ppm, from.peer_loss_ppm);
+        to.m              = std::max(to.m, from.m);
+    }
+
+    void Accumulate(FecDecoder::Stats &to, const FecDecoder::Stats &from) noexcept
+    {
+        to.sources     += from.sources;
+        to.repairs     += from.repairs;
+        to.recovered   += from.recovered;
+        to.unrecovered += from.unrecovered;
+        to.duplicates  += from.duplicates;
+        to.late        += from.late;
+        to.malformed   += from.malformed;
+        to.blocks      += from.blocks;
+        to.loss_ppm     = std::max(to.loss_ppm, from.loss_ppm);
+    }
+
+    void Accumulate(Compressor::Stats &to, const Compressor::Stats &from) noexcept
+    {
+        to.packets         += from.packets;
+        to.compressed      += from.compressed;
+        to.skipped_small   += from.skipped_small;
+        to.skipped_entropy += from.skipped_entropy;
+        to.skipped_off     += from.skipped_off;
+        to.incompressible  += from.incompressible;
+        to.bytes_in        += from.bytes_in;
+        to.bytes_out       += from.bytes_out;
+        to.dict_sets       += from.dict_sets;
+        to.dict_acks       += from.dict_acks;
+        to.flows_off       += from.flows_off;
+    }
+
+    void Accumulate(Decompressor::Stats &to, const Decompressor::Stats &from) noexcept
+    {
+        to.frames    += from.frames;
+        to.bytes_in  += from.bytes_in;
+        to.bytes_out += from.bytes_out;
+        to.dict_sets += from.dict_sets;
+        to.no_dict   += from.no_dict;
+        to.malformed += from.malformed;
+    }
+
+    void Accumulate(HeaderCompressor::Stats &to, const HeaderCompressor::Stats &from) noexcept
+    {
+        to.packets    += from.packets;
+        to.compressed += from.compressed;
+        to.contexts   += from.contexts;
+        to.skipped    += from.skipped;
+        to.bytes_in   += from.bytes_in;
+        to.bytes_out  += from.bytes_out;
+        to.refs       += from.refs;
+        to.acks       += from.acks;
+    }
+
+    void Accumulate(HeaderDecompressor::Stats &to, const HeaderDecompressor::Stats &from) noexcept
+    {
+        to.frames     += from.frames;
+        to.contexts   += from.contexts;
+        to.bytes_in   += from.bytes_in;
+        to.bytes_out  += from.bytes_out;
+        to.no_context += from.no_context;
+        to.stale      += from.stale;
+        to.malformed  += from.malformed;
+    }
+}
+
+SessionRouter::SessionRouter(const std::vector<TunDevice *> &queues,
+                             const Options                  &opts,
+                             AddressPool                    *pool4,
+                             AddressPool                    *pool6,
+                             SessionTickets                 *tickets)
+    : max_sessions_(opts.max_sessions)
+    , direct_c2c_(opts.direct_c2c)
+    , pool4_(pool4)
+    , pool6_(pool6)
+    , tickets_(tickets)
+    , table_(opts.max_sessions != 0 ? opts.max_sessions : 1024)
+{
+    if (queues.empty())
+    {
+        throw std::invalid_argument("SessionRouter: no TUN queues");
+    }
+    if (opts.reorder_hold.count() <= 0)
+    {
+        throw std::invalid_argument("SessionRouter: reorder_hold must be positive");
+    }
+    reorder_opts_.window    = opts.reorder_window;
+    reorder_opts_.slot_size = opts.mtu;
+    reorder_opts_.hold      = opts.reorder_hold;
+    fec_downlink_           = opts.fec;
+    fec_tx_opts_            = opts.fec_tx;
+    fec_tx_opts_.mtu        = opts.mtu + CoreFrame::kSeqHeaderSize;
+    fec_rx_opts_.max_k      = fec_tx_opts_.k;
+    fec_rx_opts_.max_m      = fec_tx_opts_.max_m;
+    fec_rx_opts_.mtu        = fec_tx_opts_.mtu;
+    compress_downlink_      = opts.compress;
+    compress_tx_opts_       = opts.compress_tx;
+    compress_rx_opts_.mtu   = opts.mtu;
+    compress_headers_       = opts.compress_headers;
+    header_rx_opts_.mtu     = opts.mtu;
+    shards_.reserve(queues.size());
+    for (TunDevice *q : queues)
+    {
+        shards_.push_back(std::make_unique<Shard>(q, opts.inbox_slots, opts.mtu + kFrameSlack));
+        if (opts.accounting)
+        {
+            shards_.back()->acct = std::make_unique<FlowAccounting>(opts.flows);
+        }
+        if (opts.bundle)
+        {
+            // Собираются и пронумерованные пакеты: кадр Seq длиннее пакета на kSeqHeaderSize.
+            Aggregator::Options bundle_opts = opts.bundle_tx;
+            bundle_opts.mtu        = opts.mtu;
+            bundle_opts.max_packet = opts.mtu + CoreFrame::kSeqHeaderSize;
+            shards_.back()->agg = std::make_unique<Aggregator>(bundle_opts);
+        }
+        if (opts.tso)
+        {
+            shards_.back()->seg = std::make_unique<Segmenter>();
+            shards_.back()->super.resize(0xFFFF);
+        }
+        if (opts.gro)
+        {
+            // Очередь с virtio_net_hdr режет склеенное сама; без него пакет не длиннее MTU.
+            Shard *sh = shards_.back().get();
+            Gro::Options gro_opts = opts.gro_opts;
+            gro_opts.max_size     = q->SupportsGso() ? 0xFFFF : opts.mtu;
+            gro_opts.partial_csum = q->SupportsGso();
+            sh->gro = std::make_unique<Gro>(gro_opts, [sh](const Gro::Packet &pkt) { EmitGro(*sh, pkt); });
+        }
+    }
+    if (opts.gro)
+    {
+        LOGI("sessions") << "GRO: " << (queues.front()->SupportsGso() ? "virtio GSO up to 64 KiB" : "within MTU")
+                         << ", hold " << opts.gro_opts.hold.count() << " us";
+    }
+    if (opts.accounting)
+    {
+        LOGI("sessions") << "Flow accounting: " << opts.flows.capacity << " flows/shard, sample 1/"
+                         << opts.flows.sample << ", " << (shards_.front()->acct->Memory() >> 10) << " KiB/shard";
+    }
+}
+
+bool SessionRouter::Open(SessionId session,
+                         const std::uint8_t *identity,
+                         std::size_t identity_len,
+                         unsigned shard)
+{
+    SessionTickets::Contents fresh;
+    if (identity && identity_len)
+    {
+        fresh.identity.assign(reinterpret_cast<const char *>(identity), identity_len);
+    }
+    return OpenLocked(session, fresh, false, shard);
+}
+
+bool SessionRouter::Resume(SessionId session,
+                           const std::uint8_t *ticket,
+                           std::size_t ticket_len,
+                           unsigned shard,
+                           std::string *params)
+{
+    if (!tickets_)
+    {
+        return false;
+    }
+    auto contents = tickets_->Open(ticket, ticket_len);
+    if (!contents)
+    {
+        if (shard < shards_.size())
+        {
+            shards_[shard]->stats.rejected.fetch_add(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+    if (!OpenLocked(session, *contents, true, shard))
+    {
+        return false;
+    }
+    if (params)
+    {
+        *params = contents->params;
+    }
+    LOGI("sessions") << "Resumed: id=" << session;
+    return true;
+}
+
+bool SessionRouter::OpenLocked(SessionId session,
+                               const SessionTickets::Contents &c,
+                               bool resume,
+                               unsigned shard)
+{
+    if (shard >= shards_.size())
+    {
+        return false;
+    }
+    Stats &stats = shards_[shard]->stats;
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (session == 0 || sessions_.contains(session))
+    {
+        LOGW("sessions") << "Open: invalid or duplicate session id=" << session;
+        stats.rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (max_sessions_ != 0 && sessions_.size() >= max_sessions_)
+    {
+        LOGW("sessions") << "Open: session limit reached (" << max_sessions_ << ")";
+        stats.rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    SessionInfo info;
+    info.shard    = shard;
+    info.identity = c.identity;
+    info.params   = c.params;
+    const auto *identity = reinterpret_cast<const std::uint8_t *>(info.identity.data());
+    const std::size_t identity_len = info.identity.size();
+
+    // Откат уже выданного при неудаче второго семейства.
+    auto fail = [&](const char *what) -> bool
+    {
+        if (info.has4)
+        {
+            table_.Unbind4(session, info.addr4);
+            if (pool4_)
+            {
+                pool4_->Release(Addr4Of(info.addr4));
+            }
+        }
+        LOGW("sessions") << (resume ? "Resume" : "Open") << ": no " << what << " address for id=" << session;
+        stats.rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    };
+
+    // Возобновление: адрес из тикета (из пула — только если он свободен или ждёт этого же клиента).
+    if (resume && c.has4)
+    {
+        if (pool4_ && !pool4_->Claim(Addr4Of(c.addr4), identity, identity_len))
+        {
+            return fail("IPv4");
+        }
+        if (!table_.Bind4(session, c.addr4, shard))
+        {
+            if (pool4_)
+            {
+                pool4_->Release(Addr4Of(c.addr4));
+            }
+            return fail("IPv4");
+        }
+        info.has4  = true;
+        info.addr4 = c.addr4;
+    }
+    else if (pool4_)
+    {
+        const auto lease = pool4_->Lease(identity, identity_len);
+        if (!lease || !table_.Bind4(session, LoadBe32(lease->data()), shard))
+        {
+            if (lease)
+            {
+                pool4_->Release(*lease);
+            }
+            return fail("IPv4");
+        }
+        info.has4  = true;
+        info.addr4 = LoadBe32(lease->data());
+    }
+
+    if (resume && c.has6)
+    {
+        if (pool6_ && !pool6_->Claim(c.addr6, identity, identity_len))
+        {
+            return fail("IPv6");
+        }
+        if (!table_.Bind6(session, c.addr6, shard))
+        {
+            if (pool6_)
+            {
+                pool6_->Release(c.addr6);
+            }
+            return fail("IPv6");
+        }
+        info.has6  = true;
+        info.addr6 = c.addr6;
+    }
+    else if (pool6_)
+    {
+        const auto lease = pool6_->Lease(identity, identity_len);
+        SessionTable::Addr6 a6{};
+        if (lease)
+        {
+            a6 = *lease;
+        }
+        if (!lease || !table_.Bind6(session, a6, shard))
+        {
+            if (lease)
+            {
+                pool6_->Release(*lease);
+            }
+            return fail("IPv6");
+        }
+        info.has6  = true;
+        info.addr6 = a6;
+    }
+
+    sessions_.emplace(session, std::move(info));
+    LOGI("sessions") << "Open: id=" << session << " shard=" << shard << " total=" << sessions_.size();
+    return true;
+}
+
+bool SessionRouter::IssueTicket(SessionId session,
+                                const std::uint8_t *params,
+                                std::size_t params_len)
+{
+    if (!tickets_)
+    {
+        return false;
+    }
+
+    SessionTickets::Contents c;
+    unsigned shard = 0;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = sessions_.find(session);
+        if (it == sessions_.end())
+        {
+            return false;
+        }
+        SessionInfo &info = it->second;
+        if (params)
+        {
+            info.params.assign(reinterpret_cast<const char *>(params), params_len);
+        }
+        c.identity = info.identity;
+        c.has4     = info.has4;
+        c.addr4    = info.addr4;
+        c.has6     = info.has6;
+        c.addr6    = info.addr6;
+        c.params   = info.params;
+        shard      = info.shard;
+    }
+
+    const std::string ticket = tickets_->Issue(c);
+    Shard &owner = *shards_[shard];
+    std::vector<std::uint8_t> frame(CoreFrame::kHeaderSize + ticket.size());
+    const std::size_t n = CoreFrame::Build(CoreFrame::Type::Ticket,
+                                           reinterpret_cast<const std::uint8_t *>(ticket.data()), ticket.size(),
+                                           frame.data(), frame.size());
+    if (n == 0 || n > owner.inbox.SlotSize())
+    {
+        LOGW("sessions") << "Ticket for id=" << session << " does not fit MTU (" << n << " bytes)";
+        return false;
+    }
+    // Тикет уходит клиенту тем же путём, что и пакеты для него.
+    if (!owner.inbox.Push(session, frame.data(), n))
+    {
+        owner.stats.handoff_drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    LOGD("sessions") << "Ticket issued for id=" << session << " (" << ticket.size() << " bytes)";
+    return true;
+}
+
+void SessionRouter::Close(SessionId session)
+{
+    {
+        // Сначала сессия уходит из sessions_: ленивое создание окна, FEC, сборки и сжатия проверяет
+        // sessions_ под замком своей полосы и после этого их уже не заведёт, а заведённое раньше снимается ниже.
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = sessions_.find(session);
+        if (it == sessions_.end())
+        {
+            LOGT("sessions") << "Close: unknown id=" << session;
+            return;
+        }
+        if (it->second.has4)
+        {
+            table_.Unbind4(session, it->second.addr4);
+            if (pool4_)
+            {
+                pool4_->Release(Addr4Of(it->second.addr4));
+            }
+        }
+        if (it->second.has6)
+        {
+            table_.Unbind6(session, it->second.addr6);
+            if (pool6_)
+            {
+                pool6_->Release(it->second.addr6);
+            }
+        }
+        sessions_.erase(it);
+        LOGI("sessions") << "Close: id=" << session << " total=" << sessions_.size();
+    }
+    {
+        // Окно сессии — отдельно от mtx_: выпуск из окна сам берёт mtx_ (Learn).
+        SeqStripe &stripe = StripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        auto it = stripe.map.find(session);
+        if (it != stripe.map.end())
+        {
+            if (it->second.rx)
+            {
+                Accumulate(stripe.closed, it->second.rx->GetStats());
+                sequenced_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            stripe.map.erase(it);
+        }
+    }
+    {
+        FecStripe &stripe = FecStripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        auto it = stripe.map.find(session);
+        if (it != stripe.map.end())
+        {
+            if (it->second.rx)
+            {
+                Accumulate(stripe.closed.rx, it->second.rx->GetStats());
+                protected_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            if (it->second.tx)
+            {
+                Accumulate(stripe.closed.tx, it->second.tx->GetStats());
+            }
+            stripe.map.erase(it);
+        }
+    }
+    {
+        BundleStripe &stripe = BundleStripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        if (stripe.set.erase(session) != 0)
+        {
+            bundling_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    {
+        CompressStripe &stripe = CompressStripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        auto it = stripe.map.find(session);
+        if (it != stripe.map.end())
+        {
+            Accumulate(stripe.closed.rx, it->second.rx->GetStats());
+            Accumulate(stripe.closed.header_rx, it->second.header_rx->GetStats());
+            if (it->second.tx)
+            {
+                Accumulate(stripe.closed.tx, it->second.tx->GetStats());
+            }
+            if (it->second.header_tx)
+            {
+                Accumulate(stripe.closed.header_tx, it->second.header_tx->GetStats());
+            }
+            compressing_.fetch_sub(1, std::memory_order_relaxed);
+            stripe.map.erase(it);
+        }
+    }
+}
+
+bool SessionRouter::Addresses(SessionId session,
+                              std::string *addr4,
+                              std::string *addr6) const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = sessions_.find(session);
+    if (it == sessions_.end())
+    {
+        return false;
+    }
+    if (addr4)
+    {
+        *addr4 = it->second.has4 ? AddressPool::ToString(4, Addr4Of(it->second.addr4)) : std::string();
+    }
+    if (addr6)
+    {
+        *addr6 = it->second.has6 ? AddressPool::ToString(6, it->second.addr6) : std::string();
+    }
+    return true;
+}
+
+std::size_t SessionRouter::Sessions() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return sessions_.size();
+}
+
+ReorderBuffer::Stats SessionRouter::GetReorderStats() const
+{
+    ReorderBuffer::Stats total;
+    for (SeqStripe &stripe : seq_)
+    {
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        Accumulate(total, stripe.closed);
+        for (const auto &[id, sq] : stripe.map)
+        {
+            if (sq.rx)
+            {
+                Accumulate(total, sq.rx->GetStats());
+            }
+        }
+    }
+    return total;
+}
+
+FlowAccounting::Stats SessionRouter::GetFlowStats(std::size_t *flows) const
+{
+    FlowAccounting::Stats total;
+    std::size_t live = 0;
+    for (const auto &sh : shards_)
+    {
+        if (!sh->acct)
+        {
+            continue;
+        }
+        std::lock_guard<std::mutex> lk(sh->acct_mtx);
+        const FlowAccounting::Stats &st = sh->acct->GetStats();
+        total.seen     += st.seen;
+        total.sampled  += st.sampled;
+        total.unparsed += st.unparsed;
+        total.records  += st.records;
+        total.folded   += st.folded;
+        total.lumped   += st.lumped;
+        live           += sh->acct->Flows();
+    }
+    if (flows)
+    {
+        *flows = live;
+    }
+    return total;
+}
+
+void SessionRouter::AccountFlow(Shard &self,
+                                SessionId session,
+                                const std::uint8_t *buf,
+                                std::size_t len,
+                                FlowAccounting::Direction dir) noexcept
+{
+    if (!self.acct)
+    {
+        return;
+    }
+    const auto now = FlowAccounting::Clock::now();
+    std::lock_guard<std::mutex> lk(self.acct_mtx);
+    self.acct->Account(buf, len, session, dir, now);
+}
+
+SessionRouter::FecStats SessionRouter::GetFecStats() const
+{
+    FecStats total;
+    for (FecStripe &stripe : fec_)
+    {
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        Accumulate(total.tx, stripe.closed.tx);
+        Accumulate(total.rx, stripe.closed.rx);
+        for (const auto &[id, p] : stripe.map)
+        {
+            if (p.tx)
+            {
+                Accumulate(total.tx, p.tx->GetStats());
+            }
+            if (p.rx)
+            {
+                Accumulate(total.rx, p.rx->GetStats());
+            }
+        }
+    }
+    return total;
+}
+
+SessionRouter::CompressStats SessionRouter::GetCompressStats() const
+{
+    CompressStats total;
+    for (CompressStripe &stripe : compress_)
+    {
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        Accumulate(total.tx, stripe.closed.tx);
+        Accumulate(total.rx, stripe.closed.rx);
+        Accumulate(total.header_tx, stripe.closed.header_tx);
+        Accumulate(total.header_rx, stripe.closed.header_rx);
+        for (const auto &[id, c] : stripe.map)
+        {
+            Accumulate(total.rx, c.rx->GetStats());
+            Accumulate(total.header_rx, c.header_rx->GetStats());
+            if (c.tx)
+            {
+                Accumulate(total.tx, c.tx->GetStats());
+            }
+            if (c.header_tx)
+            {
+                Accumulate(total.header_tx, c.header_tx->GetStats());
+            }
+        }
+    }
+    return total;
+}
+
+Gro::Stats SessionRouter::GetGroStats() const
+{
+    Gro::Stats total;
+    for (const auto &sh : shards_)
+    {
+        if (!sh->gro)
+        {
+            continue;
+        }
+        std::lock_guard<std::mutex> lk(sh->gro_mtx);
+        const Gro::Stats &st = sh->gro->GetStats();
+        total.packets     += st.packets;
+        total.coalesced   += st.coalesced;
+        total.supers      += st.supers;
+        total.passthrough += st.passthrough;
+        total.bad_csum    += st.bad_csum;
+        total.expired     += st.expired;
+    }
+    return total;
+}
+
+bool SessionRouter::Learn(SessionId session,
+                          const std::uint8_t *pkt,
+                          std::size_t len)
+{
+    const int ver = IpVersionOf(pkt, len);
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = sessions_.find(session);
+    if (it == sessions_.end())
+    {
+        return false;
+    }
+    SessionInfo &info = it->second;
+
+    if (ver == 4)
+    {
+        if (info.has4 || pool4_)
+        {
+            return false;
+        }
+        const std::uint32_t src = LoadBe32(pkt + 12);
+        if (!table_.Bind4(session, src, info.shard))
+        {
+            return false;
+        }
+        info.has4  = true;
+        info.addr4 = src;
+        LOGI("sessions") << "Learned v4 " << ((src >> 24) & 0xff) << "." << ((src >> 16) & 0xff) << "."
+                         << ((src >> 8) & 0xff) << "." << (src & 0xff) << " for id=" << session;
+        return true;
+    }
+    if (ver == 6)
+    {
+        if (info.has6 || pool6_)
+        {
+            return false;
+        }
+        SessionTable::Addr6 src;
+        std::memcpy(src.data(), pkt + 8, src.size());
+        if (!table_.Bind6(session, src, info.shard))
+        {
+            return false;
+        }
+        info.has6  = true;
+        info.addr6 = src;
+        LOGI("sessions") << "Learned v6 address for id=" << session;
+        return true;
+    }
+    return false;
+}
+
+ssize_t SessionRouter::ReceiveFromTun(unsigned shard,
+                                      SessionId *session,
+                                      std::uint8_t *buf,
+                                      std::size_t size) noexcept
+{
+    Shard &self = *shards_[shard];
+
+    if (reorder_pending_.load(std::memory_order_relaxed))
+    {
+        ExpireReorder(self);
+    }
+    if (protected_.load(std::memory_order_relaxed) != 0)
+    {
+        PollFec();
+    }
+    if (self.gro)
+    {
+        PollGro(self);
+    }
+    // Собранный кадр, чей срок истёк, — раньше новых пакетов.
+    if (const ssize_t n = PollBundle(self, session, buf, size))
+    {
+        return n;
+    }
+    // Остаток суперпакета — тоже: плагин забирает его по сегменту за вызов.
+    if (self.seg && self.seg->Pending())
+    {
+        while (const std::size_t n = self.seg->Next(buf, size))
+        {
+            if (const ssize_t out = Downlink(self, self.seg_dst, session, buf, static_cast<ssize_t>(n), size))
+            {
+                return out;
+            }
+        }
+    }
+
+    // Пакеты, переданные другими шардами, — первыми: они уже прошли поиск.
+    for (int i = 0; i < kReadBurst; ++i)
+    {
+        const ssize_t n = self.inbox.Pop(session, buf, size);
+        if (n > 0)
+        {
+            if (const ssize_t out = Downlink(self, *session, session, buf, n, size))
+            {
+                return out;
+            }
+            continue;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+    }
+
+    for (int i = 0; i < kReadBurst; ++i)
+    {
+        // С TSO пакет читается в буфер шарда: суперпакет больше буфера плагина.
+        TunDevice::Gso gso;
+        const std::uint8_t *pkt = self.seg ? self.super.data() : buf;
+        const ssize_t n = self.seg ? self.tun->ReadGso(self.super.data(), self.super.size(), &gso)
+                                   : self.tun->Read(buf, size);
+        if (n <= 0)
+        {
+            return n;
+        }
+        const std::size_t len = static_cast<std::size_t>(n);
+
+        SessionId dst   = 0;
+        unsigned  owner = 0;
+        switch (IpVersionOf(pkt, len))
+        {
+            case 4: dst = table_.Lookup4(LoadBe32(pkt + 16), &owner); break;
+            case 6: dst = table_.Lookup6(pkt + 24, &owner);           break;
+            default:
+                self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+                continue;
+        }
+        if (dst == 0)
+        {
+            self.stats.no_route.fetch_add(1, std::memory_order_relaxed);
+            LOGT("sessions") << "FROM_TUN no session for dst (len=" << len << ")";
+            continue;
+        }
+
+        if (self.seg)
+        {
+            Segmenter::Offload off;
+            off.gso_size    = gso.size;
+            off.csum_start  = gso.csum_start;
+            off.csum_offset = gso.csum_offset;
+            off.partial     = gso.partial;
+            if (!self.seg->Load(pkt, len, off))
+            {
+                self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (self.seg->Count() > 1)
+            {
+                self.stats.supers.fetch_add(1, std::memory_order_relaxed);
+                self.stats.segments.fetch_add(self.seg->Count(), std::memory_order_relaxed);
+            }
+        }
+
+        if (owner != shard)
+        {
+            // Очередь TUN выбрана ядром по хэшу потока, а сессия живёт на другом шарде.
+            // Суперпакет передаётся нарезанным: слот кольца — по MTU.
+            std::size_t part = self.seg ? self.seg->Next(buf, size) : len;
+            for (; part != 0; part = self.seg ? self.seg->Next(buf, size) : 0)
+            {
+                if (shards_[owner]->inbox.Push(dst, buf, part))
+                    self.stats.handoff.fetch_add(1, std::memory_order_relaxed);
+                else
+                    self.stats.handoff_drops.fetch_add(1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
+        if (self.seg)
+        {
+            self.seg_dst = dst;
+            while (const std::size_t part = self.seg->Next(buf, size))
+            {
+                if (const ssize_t out = Downlink(self, dst, session, buf, static_cast<ssize_t>(part), size))
+                {
+                    return out;
+                }
+            }
+            continue;
+        }
+        if (const ssize_t out = Downlink(self, dst, session, buf, n, size))
+        {
+            return out;
+        }
+    }
+    return 0;
+}
+
+ssize_t SessionRouter::Downlink(Shard &self,
+                                SessionId dst,
+                                SessionId *session,
+                                std::uint8_t *buf,
+                                ssize_t n,
+                                std::size_t size) noexcept
+{
+    *session = dst;
+    // Кадры ядра из кольца (Ack, Ticket, DictAck) — не трафик из TUN: ни в счётчик, ни в учёт потоков,
+    // иначе они съедают пропуски выборки 1 из N и завышают unparsed.
+    if (!CoreFrame::IsCoreFrame(buf, static_cast<std::size_t>(n)))
+    {
+        self.stats.tun_rx.fetch_add(1, std::memory_order_relaxed);
+        AccountFlow(self, dst, buf, static_cast<std::size_t>(n), FlowAccounting::Direction::Downstream);
+    }
+    const ssize_t packed = Deflate(self, dst, buf, n, size);
+    const ssize_t framed = StampSequenced(self, dst, buf, packed, size);
+    if (!HoldBundle(self, dst, buf, framed))
+    {
+        return ProtectFec(self, dst, buf, framed, size);
+    }
+    return PollBundle(self, session, buf, size);
+}
+
+ssize_t SessionRouter::SendToTun(unsigned shard,
+                                 SessionId session,
+                                 const std::uint8_t *buf,
+                                 std::size_t len) noexcept
+{
+    Shard &self = *shards_[shard];
+
+    if (CoreFrame::IsCoreFrame(buf, len))
+    {
+        return HandleCoreFrame(self, session, buf, len);
+    }
+    return ForwardPacket(self, session, buf, len);
+}
+
+ssize_t SessionRouter::ForwardPacket(Shard &self,
+                                     SessionId session,
+                                     const std::uint8_t *buf,
+                                     std::size_t len) noexcept
+{
+    const int ver = IpVersionOf(buf, len);
+    SessionId owner = 0;
+    switch (ver)
+    {
+        case 4: owner = table_.Lookup4(LoadBe32(buf + 12)); break;
+        case 6: owner = table_.Lookup6(buf + 8);            break;
+        default:
+            self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+    }
+
+    if (owner != session)
+    {
+        bool learned = false;
+        if (owner == 0)
+        {
+            try
+            {
+                learned = Learn(session, buf, len);
+            }
+            catch (...)
+            {
+                learned = false;
+            }
+        }
+        if (!learned)
+        {
+            self.stats.spoofed.fetch_add(1, std::memory_order_relaxed);
+            LOGT("sessions") << "TO_TUN src not owned by id=" << session << " (drop)";
+            return 0;
+        }
+    }
+
+    if (direct_c2c_)
+    {
+        unsigned  peer_shard = 0;
+        const SessionId peer = ver == 4 ? table_.Lookup4(LoadBe32(buf + 16), &peer_shard)
+                                        : table_.Lookup6(buf + 24, &peer_shard);
+        if (peer != 0)
+        {
+            if (!shards_[peer_shard]->inbox.Push(peer, buf, len))
+            {
+                self.stats.handoff_drops.fetch_add(1, std::memory_order_relaxed);
+                return 0;
+            }
+            self.stats.c2c.fetch_add(1, std::memory_order_relaxed);
+            AccountFlow(self, session, buf, len, FlowAccounting::Direction::Upstream);
+            return static_cast<ssize_t>(len);
+        }
+    }
+
+    const ssize_t n = WriteTun(self, buf, len);
+    if (n > 0)
+    {
+        self.stats.tun_tx.fetch_add(1, std::memory_order_relaxed);
+        AccountFlow(self, session, buf, len, FlowAccounting::Direction::Upstream);
+    }
+    return n;
+}
+
+ssize_t SessionRouter::WriteTun(Shard &self,
+                                const std::uint8_t *buf,
+                                std::size_t len) noexcept
+{
+    if (!self.gro)
+    {
+        return self.tun->Write(buf, len);
+    }
+    // Запись — под тем же мьютексом: удержанное потока выдаётся в Push раньше этого пакета.
+    std::lock_guard<std::mutex> lk(self.gro_mtx);
+    try
+    {
+        if (self.gro->Push(buf, len, Gro::Clock::now()))
+        {
+            return static_cast<ssize_t>(len);
+        }
+    }
+    catch (...)
+    {
+    }
+    return self.tun->Write(buf, len);
+}
+
+void SessionRouter::EmitGro(Shard &self,
+                            const Gro::Packet &pkt) noexcept
+{
+    ssize_t n = 0;
+    if (pkt.segments > 1 && self.tun->SupportsGso())
+    {
+        TunDevice::Gso gso;
+        gso.size       = pkt.gso_size;
+        gso.hdr_len    = pkt.hdr_len;
+        gso.csum_start = pkt.csum_start;
+        gso.ipv6       = pkt.ipv6;
+        n = self.tun->WriteGso(pkt.data, pkt.len, gso);
+    }
+    else
+    {
+        n = self.tun->Write(pkt.data, pkt.len);
+    }
+    if (n <= 0)
+    {
+        LOGT("sessions") << "GRO write failed (len=" << pkt.len << ", segments=" << pkt.segments << ")";
+    }
+}
+
+void SessionRouter::PollGro(Shard &self) noexcept
+{
+    // Занятый мьютекс — запись идёт прямо сейчас: срок проверит следующий вызов.
+    std::unique_lock<std::mutex> lk(self.gro_mtx, std::try_to_lock);
+    if (!lk.owns_lock() || !self.gro->Pending())
+    {
+        return;
+    }
+    try
+    {
+        self.gro->Poll(Gro::Clock::now());
+    }
+    catch (...)
+    {
+    }
+}
+
+template <typename Fn>
+bool SessionRouter::Inflate(Shard &self,
+                            SessionId session,
+                            CoreFrame::Type type,
+                            const std::uint8_t *payload,
+                            std::size_t len,
+                            Fn &&fn) noexcept
+{
+    try
+    {
+        CompressStripe &stripe = CompressStripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        Compression *c = nullptr;
+        auto it = stripe.map.find(session);
+        if (it != stripe.map.end())
+        {
+            c = &it->second;
+        }
+        else
+        {
+            Shard *owner = nullptr;
+            {
+                // Поздний кадр уже закрытой сессии не должен заводить сжатие заново.
+                std::lock_guard<std::mutex> slk(mtx_);
+                auto sit = sessions_.find(session);
+                if (sit == sessions_.end())
+                {
+                    self.stats.spoofed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                owner = shards_[sit->second.shard].get();
+            }
+            c = &stripe.map[session];
+            c->owner = owner;
+            c->rx        = std::make_unique<Decompressor>(compress_rx_opts_);
+            c->header_rx = std::make_unique<HeaderDecompressor>(header_rx_opts_);
+            if (compress_downlink_)
+            {
+                c->tx = std::make_unique<Compressor>(compress_tx_opts_);
+                if (compress_headers_)
+                {
+                    c->header_tx = std::make_unique<HeaderCompressor>(HeaderCompressor::Options{});
+                }
+            }
+            compressing_.fetch_add(1, std::memory_order_relaxed);
+            LOGD("sessions") << "Compression for id=" << session << (c->tx ? "" : " (receive only)");
+        }
+
+        const std::uint8_t *pkt = nullptr;
+        std::size_t pkt_len = 0;
+        const bool ok = type == CoreFrame::Type::Header ? c->header_rx->Decompress(payload, len, &pkt, &pkt_len)
+                                                         : c->rx->Decompress(payload, len, &pkt, &pkt_len);
+        if (!ok)
+        {
+            self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        self.stats.inflated.fetch_add(1, std::memory_order_relaxed);
+        // Подтверждения словарей и опор — клиенту через кольцо шарда сессии.
+        std::uint8_t ack[CoreFrame::kHeaderSize + 64];
+        std::size_t n = 0;
+        while ((n = c->rx->Poll(ack, sizeof(ack))) != 0 || (n = c->header_rx->Poll(ack, sizeof(ack))) != 0)
+        {
+            if (!c->owner->inbox.Push(session, ack, n))
+            {
+                c->owner->stats.handoff_drops.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        fn(pkt, pkt_len);
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("sessions") << "Decompression failed for id=" << session << ": " << e.what();
+        return false;
+    }
+}
+
+ssize_t SessionRouter::Deflate(Shard &self,
+                               SessionId session,
+                               std::uint8_t *buf,
+                               ssize_t n,
+                               std::size_t size) noexcept
+{
+    if (!compress_downlink_ || n <= 0 || compressing_.load(std::memory_order_relaxed) == 0)
+    {
+        return n;
+    }
+    const auto len = static_cast<std::size_t>(n);
+    if (CoreFrame::IsCoreFrame(buf, len))
+    {
+        return n;
+    }
+    CompressStripe &stripe = CompressStripeOf(session);
+    std::lock_guard<std::mutex> lk(stripe.mtx);
+    auto it = stripe.map.find(session);
+    if (it == stripe.map.end() || !it->second.tx)
+    {
+        return n;
+    }
+    // Нагрузка не сжалась (мелкий пакет, шифрованные данные) — сжимается хотя бы заголовок.
+    const auto now = Compressor::Clock::now();
+    std::size_t out = it->second.tx->Compress(buf, len, size, now);
+    if (out == len && it->second.header_tx)
+    {
+        out = it->second.header_tx->Compress(buf, len, size, now);
+    }
+    if (out == len)
+    {
+        return n;
+    }
+    self.stats.compressed.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<ssize_t>(out);
+}
+
+ssize_t SessionRouter::HandleCoreFrame(Shard &self,
+                                       SessionId session,
+                                       const std::uint8_t *buf,
+                                       std::size_t len) noexcept
+{
+    CoreFrame::Type type;
+    const std::uint8_t *payload = nullptr;
+    std::size_t payload_len = 0;
+    if (!CoreFrame::Parse(buf, len, &type, &payload, &payload_len))
+    {
+        self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    switch (type)
+    {
+        case CoreFrame::Type::Probe:
+        {
+            // Ответ — та же нагрузка; клиент сам считает RTT по своей метке.
+            // Проба могла прийти в чужой шард: ответ — через кольцо шарда сессии, как и остальные кадры ядра.
+            Shard *owner = nullptr;
+            {
+                std::lock_guard<std::mutex> lk(mtx_);
+                auto it = sessions_.find(session);
+                if (it == sessions_.end())
+                {
+                    self.stats.spoofed.fetch_add(1, std::memory_order_relaxed);
+                    return 0;
+                }
+                owner = shards_[it->second.shard].get();
+            }
+            std::uint8_t ack[CoreFrame::kHeaderSize + 64];
+            const std::size_t n = CoreFrame::Build(CoreFrame::Type::Ack, payload, payload_len, ack, sizeof(ack));
+            if (n == 0 || !owner->inbox.Push(session, ack, n))
+            {
+                owner->stats.handoff_drops.fetch_add(1, std::memory_order_relaxed);
+                return 0;
+            }
+            self.stats.probes.fetch_add(1, std::memory_order_relaxed);
+            return static_cast<ssize_t>(len);
+        }
+        case CoreFrame::Type::Seq:
+            return HandleSequenced(self, session, payload, payload_len) ? static_cast<ssize_t>(len) : 0;
+        case CoreFrame::Type::Fec:
+            return HandleFec(self, session, payload, payload_len) ? static_cast<ssize_t>(len) : 0;
+        case CoreFrame::Type::Bundle:
+            return HandleBundle(self, session, buf, len, false) ? static_cast<ssize_t>(len) : 0;
+        case CoreFrame::Type::Compressed:
+        case CoreFrame::Type::Header:
+            return Inflate(self, session, type, payload, payload_len, [&](const std::uint8_t *pkt, std::size_t pkt_len)
+                {
+                    ForwardPacket(self, session, pkt, pkt_len);
+                }) ? static_cast<ssize_t>(len) : 0;
+        case CoreFrame::Type::DictAck:
+        {
+            CompressStripe &stripe = CompressStripeOf(session);
+            std::lock_guard<std::mutex> lk(stripe.mtx);
+            auto it = stripe.map.find(session);
+            if (it != stripe.map.end() && it->second.tx)
+            {
+                it->second.tx->OnAck(payload, payload_len);
+            }
+            return static_cast<ssize_t>(len);
+        }
+        case CoreFrame::Type::HeaderAck:
+        {
+            CompressStripe &stripe = CompressStripeOf(session);
+            std::lock_guard<std::mutex> lk(stripe.mtx);
+            auto it = stripe.map.find(session);
+            if (it != stripe.map.end() && it->second.header_tx)
+            {
+                it->second.header_tx->OnAck(payload, payload_len);
+            }
+            return static_cast<ssize_t>(len);
+        }
+        case CoreFrame::Type::FecReport:
+            try
+            {
+                FecStripe &stripe = FecStripeOf(session);
+                std::lock_guard<std::mutex> lk(stripe.mtx);
+                auto it = stripe.map.find(session);
+                if (it != stripe.map.end() && it->second.tx)
+                {
+                    it->second.tx->OnReport(payload, payload_len);
+                }
+                return static_cast<ssize_t>(len);
+            }
+            catch (const std::exception &e)
+            {
+                LOGE("sessions") << "FEC report failed for id=" << session << ": " << e.what();
+                return 0;
+            }
+        default:
+            LOGT("sessions") << "Unknown core frame type=" << static_cast<int>(type) << " from id=" << session;
+            self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+    }
+}
+
+bool SessionRouter::HandleSequenced(Shard &self,
+                                    SessionId session,
+                                    const std::uint8_t *payload,
+                                    std::size_t len) noexcept
+{
+    std::uint32_t seq = 0;
+    const std::uint8_t *pkt = nullptr;
+    std::size_t pkt_len = 0;
+    if (!CoreFrame::ParseSeq(payload, len, &seq, &pkt, &pkt_len))
+    {
+        self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (!CoreFrame::IsCoreFrame(pkt, pkt_len))
+    {
+        return PushSequenced(self, session, seq, pkt, pkt_len);
+    }
+
+    // Сжатый пакет распаковывается до окна: окно копирует его из буфера распаковщика.
+    CoreFrame::Type type;
+    const std::uint8_t *inner = nullptr;
+    std::size_t inner_len = 0;
+    if (!CoreFrame::Parse(pkt, pkt_len, &type, &inner, &inner_len) ||
+        (type != CoreFrame::Type::Compressed && type != CoreFrame::Type::Header))
+    {
+        self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    bool pushed = false;
+    const bool inflated = Inflate(self, session, type, inner, inner_len, [&](const std::uint8_t *data, std::size_t data_len)
+    {
+        pushed = PushSequenced(self, session, seq, data, data_len);
+    });
+    return inflated && pushed;
+}
+
+bool SessionRouter::PushSequenced(Shard &self,
+                                  SessionId session,
+                                  std::uint32_t seq,
+                                  const std::uint8_t *pkt,
+                                  std::size_t pkt_len) noexcept
+{
+    try
+    {
+        SeqStripe &stripe = StripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        Sequenced *sq = nullptr;
+        auto it = stripe.map.find(session);
+        if (it != stripe.map.end() && it->second.rx)
+        {
+            sq = &it->second;
+        }
+        else
+        {
+            {
+                // Поздний кадр уже закрытой сессии не должен заводить окно заново.
+                std::lock_guard<std::mutex> slk(mtx_);
+                if (!sessions_.contains(session))
+                {
+                    self.stats.spoofed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            sq = &stripe.map[session];
+            // Узел unordered_map не переезжает при рехэше — указатель в колбэке стабилен.
+            sq->rx = std::make_unique<ReorderBuffer>(reorder_opts_,
+                [this, session, sq](const std::uint8_t *data, std::size_t data_len)
+                {
+                    ForwardPacket(*sq->via, session, data, data_len);
+                });
+            sequenced_.fetch_add(1, std::memory_order_relaxed);
+            LOGD("sessions") << "Sequenced delivery for id=" << session;
+        }
+        sq->via = &self;
+        sq->rx->Push(seq, pkt, pkt_len, ReorderBuffer::Clock::now());
+        if (sq->rx->Held() != 0)
+        {
+            reorder_pending_.store(true, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("sessions") << "Sequenced delivery failed for id=" << session << ": " << e.what();
+        return false;
+    }
+}
+
+ssize_t SessionRouter::StampSequenced(Shard &self,
+                                      SessionId session,
+                                      std::uint8_t *buf,
+                                      ssize_t n,
+                                      std::size_t size) noexcept
+{
+    if (sequenced_.load(std::memory_order_relaxed) == 0)
+    {
+        return n;
+    }
+    const auto len = static_cast<std::size_t>(n);
+    // Нумеруются IP-пакеты и сжатые из них кадры; служебные кадры идут мимо окна клиента.
+    const bool packet = !CoreFrame::IsCoreFrame(buf, len) || buf[1] == static_cast<std::uint8_t>(CoreFrame::Type::Compressed) ||
+                        buf[1] == static_cast<std::uint8_t>(CoreFrame::Type::Header);
+    if (!packet || len + CoreFrame::kSeqHeaderSize > size)
+    {
+        return n;
+    }
+
+    std::uint32_t seq = 0;
+    {
+        SeqStripe &stripe = StripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        auto it = stripe.map.find(session);
+        if (it == stripe.map.end())
+        {
+            return n;
+        }
+        seq = it->second.tx_seq++;
+    }
+    std::memmove(buf + CoreFrame::kSeqHeaderSize, buf, len);
+    const std::size_t framed = CoreFrame::BuildSeqHeader(seq, len, buf);
+    if (framed == 0)
+    {
+        std::memmove(buf, buf + CoreFrame::kSeqHeaderSize, len);
+        return n;
+    }
+    self.stats.sequenced.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<ssize_t>(framed);
+}
+
+void SessionRouter::ExpireReorder(Shard &self) noexcept
+{
+    const auto now = ReorderBuffer::Clock::now();
+    const std::int64_t now_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+    if (now_us < next_expire_us_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    next_expire_us_.store(now_us + kExpirePeriodUs, std::memory_order_relaxed);
+
+    // Флаг сбрасывается до обхода: Push, случившийся во время обхода, взведёт его снова.
+    reorder_pending_.store(false, std::memory_order_relaxed);
+    bool pending = false;
+    for (SeqStripe &stripe : seq_)
+    {
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        for (auto &[id, sq] : stripe.map)
+        {
+            if (sq.rx && sq.rx->Held() != 0)
+            {
+                sq.via = &self;
+                sq.rx->Expire(now);
+                pending = pending || sq.rx->Held() != 0;
+            }
+        }
+    }
+    if (pending)
+    {
+        reorder_pending_.store(true, std::memory_order_relaxed);
+    }
+}
+
+bool SessionRouter::HandleFec(Shard &self,
+                              SessionId session,
+                              const std::uint8_t *payload,
+                              std::size_t len) noexcept
+{
+    try
+    {
+        FecStripe &stripe = FecStripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        Protected *p = nullptr;
+        auto it = stripe.map.find(session);
+        if (it != stripe.map.end() && it->second.rx)
+        {
+            p = &it->second;
+        }
+        else
+        {
+            Shard *owner = nullptr;
+            {
+                std::lock_guard<std::mutex> slk(mtx_);
+                auto sit = sessions_.find(session);
+                if (sit == sessions_.end())
+                {
+                    self.stats.spoofed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                owner = shards_[sit->second.shard].get();
+            }
+            p = &stripe.map[session];
+            p->owner = owner;
+            p->frame.resize(CoreFrame::kFecHeaderSize + fec_tx_opts_.mtu + 2);
+            // Узел unordered_map не переезжает при рехэше — указатель в колбэке стабилен.
+            p->rx = std::make_unique<FecDecoder>(fec_rx_opts_,
+                [this, session, p](const std::uint8_t *data, std::size_t data_len)
+                {
+                    DeliverInner(*p->via, session, data, data_len);
+                });
+            if (fec_downlink_)
+            {
+                p->tx = std::make_unique<FecEncoder>(fec_tx_opts_);
+            }
+            protected_.fetch_add(1, std::memory_order_relaxed);
+            LOGD("sessions") << "FEC for id=" << session << (p->tx ? "" : " (receive only)");
+        }
+        p->via = &self;
+        return p->rx->Push(payload, len, FecDecoder::Clock::now());
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("sessions") << "FEC failed for id=" << session << ": " << e.what();
+        return false;
+    }
+}
+
+void SessionRouter::DeliverInner(Shard &self,
+                                 SessionId session,
+                                 const std::uint8_t *buf,
+                                 std::size_t len) noexcept
+{
+    if (!CoreFrame::IsCoreFrame(buf, len))
+    {
+        ForwardPacket(self, session, buf, len);
+        return;
+    }
+    CoreFrame::Type type;
+    const std::uint8_t *payload = nullptr;
+    std::size_t payload_len = 0;
+    if (!CoreFrame::Parse(buf, len, &type, &payload, &payload_len))
+    {
+        self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (type == CoreFrame::Type::Seq)
+    {
+        HandleSequenced(self, session, payload, payload_len);
+        return;
+    }
+    if (type == CoreFrame::Type::Bundle)
+    {
+        HandleBundle(self, session, buf, len, true);
+        return;
+    }
+    if (type == CoreFrame::Type::Compressed || type == CoreFrame::Type::Header)
+    {
+        Inflate(self, session, type, payload, payload_len, [&](const std::uint8_t *pkt, std::size_t pkt_len)
+        {
+            ForwardPacket(self, session, pkt, pkt_len);
+        });
+        return;
+    }
+    self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SessionRouter::HandleBundle(Shard &self,
+                                 SessionId session,
+                                 const std::uint8_t *buf,
+                                 std::size_t len,
+                                 bool inner) noexcept
+{
+    const bool ok = Aggregator::Unbundle(buf, len, [&](const std::uint8_t *pkt, std::size_t pkt_len)
+    {
+        if (inner)
+            DeliverInner(self, session, pkt, pkt_len);
+        else if (CoreFrame::IsCoreFrame(pkt, pkt_len))
+            HandleCoreFrame(self, session, pkt, pkt_len);
+        else
+            ForwardPacket(self, session, pkt, pkt_len);
+    });
+    if (!ok)
+    {
+        self.stats.malformed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    self.stats.unbundled.fetch_add(1, std::memory_order_relaxed);
+    if (!self.agg)
+    {
+        return true;
+    }
+
+    // Клиент умеет разбирать Bundle — ответ ему тоже собирается.
+    try
+    {
+        BundleStripe &stripe = BundleStripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        if (stripe.set.contains(session))
+        {
+            return true;
+        }
+        {
+            // Поздний кадр уже закрытой сессии не должен включать сборку заново.
+            std::lock_guard<std::mutex> slk(mtx_);
+            if (!sessions_.contains(session))
+            {
+                return true;
+            }
+        }
+        stripe.set.insert(session);
+        bundling_.fetch_add(1, std::memory_order_relaxed);
+        LOGD("sessions") << "Bundled downlink for id=" << session;
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("sessions") << "Bundled downlink failed for id=" << session << ": " << e.what();
+    }
+    return true;
+}
+
+bool SessionRouter::HoldBundle(Shard &self,
+                               SessionId session,
+                               const std::uint8_t *buf,
+                               ssize_t n) noexcept
+{
+    if (!self.agg || n <= 0 || bundling_.load(std::memory_order_relaxed) == 0)
+    {
+        return false;
+    }
+    const auto len = static_cast<std::size_t>(n);
+    // Пробы, тикеты и служебное FEC — мимо сборки: Bundle идёт в блок FEC, а там место только IP, Seq и сжатым.
+    if (CoreFrame::IsCoreFrame(buf, len) && buf[1] != static_cast<std::uint8_t>(CoreFrame::Type::Seq) &&
+        buf[1] != static_cast<std::uint8_t>(CoreFrame::Type::Compressed) &&
+        buf[1] != static_cast<std::uint8_t>(CoreFrame::Type::Header))
+    {
+        return false;
+    }
+    {
+        BundleStripe &stripe = BundleStripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        if (!stripe.set.contains(session))
+        {
+            return false;
+        }
+    }
+    return self.agg->Offer(buf, len, Aggregator::Clock::now(), session);
+}
+
+ssize_t SessionRouter::PollBundle(Shard &self,
+                                  SessionId *session,
+                                  std::uint8_t *buf,
+                                  std::size_t size) noexcept
+{
+    if (!self.agg || !self.agg->Pending())
+    {
+        return 0;
+    }
+    std::uint64_t tag = 0;
+    const std::size_t n = self.agg->Poll(buf, size, Aggregator::Clock::now(), &tag);
+    if (n == 0)
+    {
+        return 0;
+    }
+    *session = tag;
+    if (CoreFrame::IsCoreFrame(buf, n) && buf[1] == static_cast<std::uint8_t>(CoreFrame::Type::Bundle))
+    {
+        self.stats.bundled.fetch_add(1, std::memory_order_relaxed);
+    }
+    return ProtectFec(self, tag, buf, static_cast<ssize_t>(n), size);
+}
+
+ssize_t SessionRouter::ProtectFec(Shard &self,
+                                  SessionId session,
+                                  std::uint8_t *buf,
+                                  ssize_t n,
+                                  std::size_t size) noexcept
+{
+    if (protected_.load(std::memory_order_relaxed) == 0 || n <= 0)
+    {
+        return n;
+    }
+    const auto len = static_cast<std::size_t>(n);
+    if (CoreFrame::IsCoreFrame(buf, len))
+    {
+        // Из служебных кадров защищаются только пронумерованные и сжатые пакеты и собранные из них кадры.
+        CoreFrame::Type type;
+        const std::uint8_t *payload = nullptr;
+        std::size_t payload_len = 0;
+        if (!CoreFrame::Parse(buf, len, &type, &payload, &payload_len) ||
+            (type != CoreFrame::Type::Seq && type != CoreFrame::Type::Bundle && type != CoreFrame::Type::Compressed &&
+             type != CoreFrame::Type::Header))
+        {
+            return n;
+        }
+    }
+
+    try
+    {
+        FecStripe &stripe = FecStripeOf(session);
+        std::lock_guard<std::mutex> lk(stripe.mtx);
+        auto it = stripe.map.find(session);
+        if (it == stripe.map.end() || !it->second.tx)
+        {
+            return n;
+        }
+        const auto now = FecEncoder::Clock::now();
+        const std::size_t framed = it->second.tx->Protect(buf, len, size, now);
+        // Блок закрылся — избыточные символы идут следом через кольцо шарда.
+        FlushFec(session, it->second, now);
+        if (framed == 0)
+        {
+            return n;
+        }
+        self.stats.fec_protected.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<ssize_t>(framed);
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("sessions") << "FEC protect failed for id=" << session << ": " << e.what();
+        return n;
+    }
+}
+
+void SessionRouter::FlushFec(SessionId session,
+                             Protected &p,
+                             FecEncoder::Clock::time_point now) noexcept
+{
+    auto push = [&](std::size_t n)
+    {
+        if (!p.owner->inbox.Push(session, p.frame.data(), n))
+        {
+            p.owner->stats.handoff_drops.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    if (p.tx)
+    {
+        while (const std::size_t n = p.tx->Poll(p.frame.data(), p.frame.size(), now))
+        {
+            push(n);
+        }
+    }
+    if (p.rx)
+    {
+        if (const std::size_t n = p.rx->Poll(p.frame.data(), p.frame.size(), now))
+        {
+            push(n);
+        }
+    }
+}
+
+void SessionRouter::PollFec() noexcept
+{
+    const auto now = FecEncoder::Clock::now();
+    const std::int64_t now_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+    if (now_us < next_fec_poll_us_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    next_fec_poll_us_.store(now_us + kFecPollPeriodUs, std::memory_order_relaxed);
+
+    try
+    {
+        for (FecStripe &stripe : fec_)
+        {
+            std::lock_guard<std::mutex> lk(stripe.mtx);
+            for (auto &[id, p] : stripe.map)
+            {
+                FlushFec(id, p, now);
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("sessions") << "FEC poll failed: " << e.what();
+    }
+}
+
+ServerSessionApi SessionRouter::Api(unsigned shard)
+{
+    if (shard >= shards_.size())
+    {
+        throw std::out_of_range("SessionRouter::Api: bad shard");
+    }
+
+    ServerSessionApi api;
+    api.open = [this, shard](SessionId session, const std::uint8_t *identity, std::size_t identity_len) -> bool
+    {
+        try
+        {
+            if (!Open(session, identity, identity_len, shard))
+            {
+                return false;
+            }
+            if (tickets_)
+            {
+                IssueTicket(session, nullptr, 0);
+            }
+            return true;
+        }
+        catch (const std::exception &e)
+        {
+            LOGE("sessions") << "Open threw: " << e.what();
+            return false;
+        }
+    };
+    api.close = [this](SessionId session)
+    {
+        try
+        {
+            Close(session);
+        }
+        catch (const std::exception &e)
+        {
+            LOGE("sessions") << "Close threw: " << e.what();
+        }
+    };
+    api.receive_from_net = [this, shard](SessionId *session, std::uint8_t *buf, std::size_t size) -> ssize_t
+    {
+        return ReceiveFromTun(shard, session, buf, size);
+    };
+    api.send_to_net = [this, shard](SessionId session, const std::uint8_t *buf, std::size_t len) -> ssize_t
+    {
+        return SendToTun(shard, session, buf, len);
+    };
+    api.addresses = [this](SessionId session, std::string *addr4, std::string *addr6) -> bool
+    {
+        try
+        {
+            return Addresses(session, addr4, addr6);
+        }
+        catch (const std::exception &e)
+        {
+            LOGE("sessions") << "Addresses threw: " << e.what();
+            return false;
+        }
+    };
+    api.issue_ticket = [this](SessionId session, const std::uint8_t *params, std::size_t params_len) -> bool
+    {
+        try
+        {
+            return IssueTicket(session, params, params_len);
+        }
+        catch (const std::exception &e)
+        {
+            LOGE("sessions") << "IssueTicket threw: " << e.what();
+            return false;
+        }
+    };
+    api.resume = [this, shard](SessionId session, const std::uint8_t *ticket, std::size_t ticket_len,
+                               std::string *params) -> bool
+    {
+        try
+        {
+            if (!Resume(session, ticket, ticket_len, shard, params))
+            {
+                return false;
+            }
+            // Каждое возобновление получает свежий тикет: старый скоро истечёт.
+            IssueTicket(session, nullptr, 0);
+            return true;
+        }
+        catch (const std::exception &e)
+        {
+            LOGE("sessions") << "Resume threw: " << e.what();
+            return false;
+        }
+    };
+    return api;
+}
@@ -0,0 +1,603 @@
+#pragma once
+// SessionRouter.hpp — маршрутизация пакетов TUN <-> сессии клиентов плагина.
+
+#include "TunDevice.hpp"
+#include "SessionTable.hpp"
+#include "AddressPool.hpp"
+#include "MpscRing.hpp"
+#include "SessionTickets.hpp"
+#include "Core/SessionApi.hpp"
+#include "Core/ReorderBuffer.hpp"
+#include "Core/Fec.hpp"
+#include "Core/Aggregator.hpp"
+#include "Core/Compressor.hpp"
+#include "Core/HeaderCompressor.hpp"
+#include "Core/Gro.hpp"
+#include "Core/Segmenter.hpp"
+#include "Core/FlowAccounting.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief Реализация ServerSessionApi поверх TunDevice и SessionTable.
+ *
+ * - TUN -> клиент: адресат выбирается по dst внутреннего пакета.
+ * - клиент -> TUN: src пакета должен принадлежать сессии (анти-спуфинг).
+ * - Адреса сессии выдаются из AddressPool при Open (sticky по identity);
+ *   для семейства без пула первый src клиента привязывается автоматически.
+ *
+ * Шарды: каждый шард — своя очередь TUN (IFF_MULTI_QUEUE), свой поток плагина
+ * и свой входящий MpscRing. Сессия принадлежит шарду, на котором открыта.
+ * Ядро Linux раскладывает пакеты по очередям TUN по хэшу потока, поэтому пакет
+ * для чужой сессии передаётся шарду-владельцу через его кольцо; туда же,
+ * при direct_c2c, идут пакеты «клиент -> клиент» в обход TUN.
+ *
+ * Тикеты: при заданном SessionTickets каждая открытая сессия получает тикет
+ * возобновления служебным кадром (CoreFrame::Type::Ticket) в своём потоке
+ * пакетов; Resume восстанавливает сессию по тикету с прежними адресами.
+ *
+ * Порядок: сессия, приславшая пронумерованный пакет (CoreFrame::Type::Seq,
+ * многопутевой клиент), получает окно ReorderBuffer — пакеты уходят в TUN
+ * по порядку, дыра ждёт не дольше reorder_hold. Пакеты такой сессии из TUN
+ * тоже нумеруются, чтобы клиент восстановил порядок у себя. Транспорты одной
+ * сессии могут попасть на разные шарды, поэтому окна хранятся не в шарде,
+ * а в полосах по хэшу сессии.
+ *
+ * FEC: сессия, приславшая кадр CoreFrame::Type::Fec, получает декодер (потери
+ * клиент -> сервер восстанавливаются до TUN) и кодер в обратную сторону;
+ * избыточные символы и отчёты о потерях уходят клиенту через кольцо шарда
+ * сессии. Клиенты без FEC не платят ничего.
+ *
+ * Сборка: кадр CoreFrame::Type::Bundle клиента разбирается на пакеты, и
+ * сессия начинает получать мелкие пакеты из TUN тоже собранными (Aggregator
+ * шарда-владельца, метка — сессия; сборка — до FEC, Bundle защищается целиком).
+ *
+ * Сжатие: кадр CoreFrame::Type::Compressed клиента распаковывается до окна
+ * порядка и TUN (Decompressor сессии, подтверждения словарей — через кольцо
+ * шарда сессии), и такая сессия получает пакеты из TUN сжатыми тоже
+ * (Compressor сессии со своими потоками и словарями; сжатие — до нумерации).
+ * Так же кадр Header (сжатый заголовок) восстанавливается HeaderDecompressor
+ * сессии, и пакеты, чья нагрузка не сжалась, уходят к ней со сжатым заголовком.
+ *
+ * GRO: при Options::gro пакеты клиентов перед записью в TUN проходят склейку
+ * шарда (Gro под мьютексом шарда — окна и FEC пишут через чужой шард).
+ * Очередь с virtio_net_hdr получает склеенные пакеты до 64 КиБ (WriteGso,
+ * сумму досчитывает ядро), прочие — в пределах MTU с полной суммой.
+ * Удержанное выталкивается в начале ReceiveFromTun по сроку Gro::Options::hold.
+ *
+ * TSO: при Options::tso очередь TUN читается в буфер шарда по 64 КиБ, и
+ * TCP-суперпакет режется Segmenter лениво: ReceiveFromTun отдаёт плагину по
+ * сегменту, остаток — в следующих вызовах, раньше новых чтений.
+ *
+ * Учёт: при Options::accounting каждый шард считает пакеты и байты по потокам
+ * своих сессий (FlowAccounting под мьютексом шарда — окна и FEC могут выпускать
+ * пакеты через чужой шард); DrainFlows собирает записи для выгрузки.
+ *
+ * Open/Close вызываются редко и сериализуются мьютексом,
+ * ReceiveFromTun/SendToTun — горячий путь без блокировок записи.
+ */
+class SessionRouter
+{
+public:
+    /**
+     * @brief Счётчики маршрутизатора.
+     */
+    struct Stats
+    {
+        std::atomic<std::uint64_t> tun_rx{0};      ///< Пакетов прочитано из TUN и отдано сессиям.
+        std::atomic<std::uint64_t> tun_tx{0};      ///< Пакетов записано в TUN.
+        std::atomic<std::uint64_t> no_route{0};    ///< Пакетов из TUN без сессии-адресата.
+        std::atomic<std::uint64_t> spoofed{0};     ///< Пакетов от клиента с чужим src.
+        std::atomic<std::uint64_t> malformed{0};   ///< Не IP-пакетов.
+        std::atomic<std::uint64_t> rejected{0};    ///< Отклонённых Open (лимит, пул исчерпан).
+        std::atomic<std::uint64_t> handoff{0};     ///< Пакетов передано другому шарду.
+        std::atomic<std::uint64_t> handoff_drops{0}; ///< Пакетов потеряно: кольцо шарда-получателя полно.
+        std::atomic<std::uint64_t> c2c{0};         ///< Пакетов «клиент -> клиент» в обход TUN.
+        std::atomic<std::uint64_t> probes{0};      ///< Keepalive-проб клиентов, на которые дан ответ.
+        std::atomic<std::uint64_t> sequenced{0};   ///< Пакетов из TUN, отданных пронумерованными.
+        std::atomic<std::uint64_t> fec_protected{0}; ///< Пакетов из TUN, отданных в блоках FEC.
+        std::atomic<std::uint64_t> unbundled{0};   ///< Кадров Bundle от клиентов разобрано.
+        std::atomic<std::uint64_t> bundled{0};     ///< Кадров Bundle отдано клиентам.
+        std::atomic<std::uint64_t> inflated{0};    ///< Кадров Compressed и Header от клиентов восстановлено.
+        std::atomic<std::uint64_t> compressed{0};  ///< Пакетов из TUN, отданных сжатыми (нагрузка или заголовок).
+        std::atomic<std::uint64_t> supers{0};      ///< TCP-суперпакетов из TUN нарезано.
+        std::atomic<std::uint64_t> segments{0};    ///< Сегментов из них.
+    };
+
+    /**
+     * @brief Параметры маршрутизатора.
+     */
+    struct Options
+    {
+        /// @brief Максимум одновременных сессий (0 — без ограничения).
+        std::size_t max_sessions = 0;
+        /// @brief Максимальный размер пакета (размер слота колец).
+        std::size_t mtu = 1500;
+        /// @brief Ёмкость входящего кольца каждого шарда, пакетов.
+        std::size_t inbox_slots = 1024;
+        /// @brief Доставлять пакеты между клиентами напрямую, минуя TUN (и netfilter).
+        bool direct_c2c = false;
+        /// @brief Окно восстановления порядка на сессию, пакетов (память — reorder_window * mtu).
+        std::size_t reorder_window = 64;
+        /// @brief Сколько пакет ждёт дыру перед собой.
+        std::chrono::milliseconds reorder_hold{30};
+        /// @brief Защищать FEC ответ клиентам, которые сами шлют FEC (false — только разворачивать их пакеты).
+        bool fec = true;
+        /// @brief Кодер FEC к клиенту; k и max_m — также пределы декодера (mtu задаётся маршрутизатором).
+        FecEncoder::Options fec_tx;
+        /// @brief Учитывать трафик по потокам (клиент -> TUN/клиент и TUN -> клиент).
+        bool accounting = false;
+        /// @brief Учёт на каждый шард (capacity — потоков на шард).
+        FlowAccounting::Options flows;
+        /// @brief Собирать мелкие пакеты к клиентам, которые сами шлют Bundle (false — только разбирать их кадры).
+        bool bundle = true;
+        /// @brief Сборщик шарда (mtu и max_packet задаются маршрутизатором).
+        Aggregator::Options bundle_tx;
+        /// @brief Сжимать пакеты к клиентам, которые сами шлют Compressed или Header (false — только распаковывать их кадры).
+        bool compress = true;
+        /// @brief Сжатие к клиенту, на сессию (flows — потоков со словарём на сессию).
+        Compressor::Options compress_tx;
+        /// @brief Сжимать таким клиентам и заголовки пакетов, чья нагрузка не сжалась.
+        bool compress_headers = true;
+        /// @brief Склеивать TCP-сегменты клиентов перед записью в TUN.
+        bool gro = false;
+        /// @brief Склейка шарда (max_size и partial_csum задаются по очереди TUN).
+        Gro::Options gro_opts;
+        /// @brief Очереди TUN отдают TCP-суперпакеты (LinuxTun::EnableTso): резать их по MTU.
+        bool tso = false;
+    };
+
+    /**
+     * @brief Сводные счётчики FEC.
+     */
+    struct FecStats
+    {
+        FecEncoder::Stats tx;
+        FecDecoder::Stats rx;
+    };
+
+    /**
+     * @brief Сводные счётчики сжатия.
+     */
+    struct CompressStats
+    {
+        Compressor::Stats         tx;
+        Decompressor::Stats       rx;
+        HeaderCompressor::Stats   header_tx;
+        HeaderDecompressor::Stats header_rx;
+    };
+
+    /**
+     * @brief Создать шардированный маршрутизатор.
+     * @param queues Очереди TUN, по одной на шард (живут дольше маршрутизатора).
+     * @param opts   Параметры.
+     * @param pool4  Пул IPv4 (может быть nullptr).
+     * @param pool6  Пул IPv6 (может быть nullptr).
+     * @param tickets Выпуск тикетов возобновления (может быть nullptr — без тикетов).
+     * @throw std::invalid_argument Пустой список очередей.
+     */
+    SessionRouter(const std::vector<TunDevice *> &queues,
+                  const Options                  &opts,
+                  AddressPool                    *pool4   = nullptr,
+                  AddressPool                    *pool6   = nullptr,
+                  SessionTickets                 *tickets = nullptr);
+
+    SessionRouter(const SessionRouter &) = delete;
+    SessionRouter &operator=(const SessionRouter &) = delete;
+
+    /**
+     * @brief Зарегистрировать новую сессию на шарде shard.
+     * @return false — лимит сессий или повторный id.
+     */
+    bool Open(SessionId session, const std::uint8_t *identity, std::size_t identity_len, unsigned shard = 0);
+
+    /**
+     * @brief Открыть сессию по тикету: identity, адреса и параметры берутся из тикета.
+     * @param params Если не nullptr — параметры сессии плагина из тикета.
+     * @return false — тикеты выключены, тикет недействителен или его адрес уже занят.
+     */
+    bool Resume(SessionId session, const std::uint8_t *ticket, std::size_t ticket_len,
+                unsigned shard = 0, std::string *params = nullptr);
+
+    /**
+     * @brief Выпустить тикет и отправить его клиенту служебным кадром.
+     * @param params Новые параметры сессии плагина (nullptr — оставить прежние).
+     * @return false — тикеты выключены, сессия неизвестна или кадр не доставлен.
+     */
+    bool IssueTicket(SessionId session, const std::uint8_t *params, std::size_t params_len);
+
+    /**
+     * @brief Закрыть сессию, снять привязки её адресов и вернуть их в пул.
+     */
+    void Close(SessionId session);
+
+    /**
+     * @brief Адреса сессии строками (пустая строка — адреса нет).
+     * @return false, если сессия неизвестна.
+     */
+    bool Addresses(SessionId session, std::string *addr4, std::string *addr6) const;
+
+    /**
+     * @brief Получить пакет для сессии шарда: сначала из его кольца, затем из его очереди TUN.
+     * @return Длина; 0 — нет пакетов; -1 — ошибка/буфер мал.
+     */
+    ssize_t ReceiveFromTun(unsigned shard, SessionId *session, std::uint8_t *buf, std::size_t size) noexcept;
+
+    /**
+     * @brief Записать пакет клиента session в очередь TUN шарда (с проверкой src).
+     *        Служебные кадры ядра (keepalive-пробы) обрабатываются здесь же и в TUN не идут.
+     * @return Длина; 0 — отброшен; -1 — ошибка.
+     */
+    ssize_t SendToTun(unsigned shard, SessionId session, const std::uint8_t *buf, std::size_t len) noexcept;
+
+    /**
+     * @brief Колбэки для Server_ServeSessions/Server_ServeShard, привязанные к шарду.
+     */
+    ServerSessionApi Api(unsigned shard = 0);
+
+    /** @brief Число шардов. */
+    unsigned Shards() const noexcept { return static_cast<unsigned>(shards_.size()); }
+
+    /** @brief Число открытых сессий. */
+    std::size_t Sessions() const;
+
+    /** @brief Счётчики шарда. */
+    const Stats &GetStats(unsigned shard = 0) const noexcept { return shards_[shard]->stats; }
+
+    /** @brief Сводные счётчики восстановления порядка (открытые и закрытые сессии). */
+    ReorderBuffer::Stats GetReorderStats() const;
+
+    /** @brief Сводные счётчики FEC (открытые и закрытые сессии). */
+    FecStats GetFecStats() const;
+
+    /** @brief Сводные счётчики сжатия (открытые и закрытые сессии). */
+    CompressStats GetCompressStats() const;
+
+    /** @brief Сводные счётчики склейки перед TUN (нули при Options::gro == false). */
+    Gro::Stats GetGroStats() const;
+
+    /** @brief Включён ли учёт по потокам. */
+    bool Accounting() const noexcept { return shards_.front()->acct != nullptr; }
+
+    /** @brief Знаменатель выборки учёта. */
+    unsigned FlowSample() const noexcept { return Accounting() ? shards_.front()->acct->Sample() : 1; }
+
+    /**
+     * @brief Выгрузить записи учёта всех шардов: fn(const FlowAccounting::Record &).
+     *        fn вызывается под мьютексом шарда — только кодирование, без ввода-вывода.
+     * @param flush true — при остановке (живые потоки — End::Flush).
+     * @return Число записей.
+     */
+    template <typename Fn>
+    std::size_t DrainFlows(FlowAccounting::Clock::time_point now, Fn &&fn, bool flush = false);
+
+    /** @brief Сводные счётчики учёта; flows — живых потоков. */
+    FlowAccounting::Stats GetFlowStats(std::size_t *flows = nullptr) const;
+
+private:
+    /**
+     * @brief Состояние одной сессии.
+     */
+    struct SessionInfo
+    {
+        std::string          identity;
+        bool                 has4  = false;
+        std::uint32_t        addr4 = 0;
+        bool                 has6  = false;
+        SessionTable::Addr6  addr6{};
+        unsigned             shard = 0;
+        std::string          params;   ///< Параметры плагина для тикета.
+    };
+
+    /**
+     * @brief Данные одного шарда; выровнены, чтобы счётчики соседей не делили кэш-линию.
+     */
+    struct alignas(64) Shard
+    {
+        TunDevice *tun;
+        MpscRing   inbox;
+        Stats      stats;
+
+        std::mutex                      acct_mtx;
+        std::unique_ptr<FlowAccounting> acct;   ///< nullptr — учёт выключен.
+
+        std::unique_ptr<Aggregator>     agg;    ///< Сборка к клиентам; только поток ReceiveFromTun шарда.
+
+        std::mutex                      gro_mtx;
+        std::unique_ptr<Gro>            gro;    ///< Склейка перед TUN; nullptr — выключена.
+
+        // Нарезка суперпакетов; только поток ReceiveFromTun шарда.
+        std::unique_ptr<Segmenter>      seg;    ///< nullptr — TSO выключен.
+        std::vector<std::uint8_t>       super;  ///< Буфер чтения суперпакета.
+        SessionId                       seg_dst = 0;   ///< Адресат нарезаемого пакета.
+
+        Shard(TunDevice *t, std::size_t slots, std::size_t slot_size)
+            : tun(t)
+            , inbox(slots, slot_size)
+        {
+        }
+    };
+
+    /**
+     * @brief Нумерация пакетов сессии в обе стороны.
+     */
+    struct Sequenced
+    {
+        std::unique_ptr<ReorderBuffer> rx;        ///< Клиент -> TUN.
+        std::uint32_t                  tx_seq = 0; ///< TUN -> клиент.
+        Shard                         *via = nullptr; ///< Шард, чья очередь TUN принимает выпуск.
+    };
+
+    /**
+     * @brief Полоса окон: свой мьютекс на часть сессий.
+     */
+    struct alignas(64) SeqStripe
+    {
+        std::mutex                               mtx;
+        std::unordered_map<SessionId, Sequenced> map;
+        ReorderBuffer::Stats                     closed;   ///< Счётчики закрытых сессий.
+    };
+
+    static constexpr std::size_t kSeqStripes = 16;
+
+    /**
+     * @brief FEC сессии в обе стороны.
+     */
+    struct Protected
+    {
+        std::unique_ptr<FecDecoder> rx;              ///< Клиент -> TUN.
+        std::unique_ptr<FecEncoder> tx;              ///< TUN -> клиент (nullptr при Options::fec == false).
+        Shard                      *via   = nullptr; ///< Шард, чья очередь TUN принимает восстановленное.
+        Shard                      *owner = nullptr; ///< Шард сессии: его кольцо несёт избыточные символы.
+        std::vector<std::uint8_t>   frame;           ///< Буфер служебного кадра.
+    };
+
+    /**
+     * @brief Полоса состояний FEC.
+     */
+    struct alignas(64) FecStripe
+    {
+        std::mutex                               mtx;
+        std::unordered_map<SessionId, Protected> map;
+        FecStats                                 closed;   ///< Счётчики закрытых сессий.
+    };
+
+    static constexpr std::size_t kFecStripes = 16;
+
+    /**
+     * @brief Полоса сессий, которым пакеты из TUN отдаются собранными.
+     */
+    struct alignas(64) BundleStripe
+    {
+        std::mutex                    mtx;
+        std::unordered_set<SessionId> set;
+    };
+
+    static constexpr std::size_t kBundleStripes = 16;
+
+    /**
+     * @brief Сжатие сессии в обе стороны.
+     */
+    struct Compression
+    {
+        std::unique_ptr<Decompressor>       rx;              ///< Клиент -> TUN.
+        std::unique_ptr<Compressor>         tx;              ///< TUN -> клиент (nullptr при Options::compress == false).
+        std::unique_ptr<HeaderDecompressor> header_rx;       ///< Заголовки клиент -> TUN.
+        std::unique_ptr<HeaderCompressor>   header_tx;       ///< Заголовки TUN -> клиент (nullptr без tx или compress_headers).
+        Shard                              *owner = nullptr; ///< Шард сессии: его кольцо несёт подтверждения словарей и опор.
+    };
+
+    /**
+     * @brief Полоса состояний сжатия.
+     */
+    struct alignas(64) CompressStripe
+    {
+        std::mutex                                 mtx;
+        std::unordered_map<SessionId, Compression> map;
+        CompressStats                              closed;   ///< Счётчики закрытых сессий.
+    };
+
+    static constexpr std::size_t kCompressStripes = 16;
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::size_t   max_sessions_;
+    bool          direct_c2c_;
+    AddressPool  *pool4_;
+    AddressPool  *pool6_;
+    SessionTickets *tickets_ = nullptr;
+    SessionTable  table_;
+
+    mutable std::mutex                          mtx_;
+    std::unordered_map<SessionId, SessionInfo>  sessions_;
+
+    ReorderBuffer::Options                      reorder_opts_;
+    mutable std::array<SeqStripe, kSeqStripes>  seq_;
+    std::atomic<std::size_t>                    sequenced_{0};      ///< Сессий с нумерацией.
+    std::atomic<bool>                           reorder_pending_{false};
+    std::atomic<std::int64_t>                   next_expire_us_{0};
+
+    bool                                        fec_downlink_;
+    FecEncoder::Options                         fec_tx_opts_;
+    FecDecoder::Options                         fec_rx_opts_;
+    mutable std::array<FecStripe, kFecStripes>  fec_;
+    std::atomic<std::size_t>                    protected_{0};      ///< Сессий с FEC.
+    std::atomic<std::int64_t>                   next_fec_poll_us_{0};
+
+    mutable std::array<BundleStripe, kBundleStripes> bundle_;
+    std::atomic<std::size_t>                    bundling_{0};       ///< Сессий со сборкой к клиенту.
+
+    bool                                        compress_downlink_;
+    Compressor::Options                         compress_tx_opts_;
+    Decompressor::Options                       compress_rx_opts_;
+    bool                                        compress_headers_;
+    HeaderDecompressor::Options                 header_rx_opts_;
+    mutable std::array<CompressStripe, kCompressStripes> compress_;
+    std::atomic<std::size_t>                    compressing_{0};    ///< Сессий со сжатием.
+
+    SeqStripe &StripeOf(SessionId session) const noexcept { return seq_[session % kSeqStripes]; }
+    FecStripe &FecStripeOf(SessionId session) const noexcept { return fec_[session % kFecStripes]; }
+    BundleStripe &BundleStripeOf(SessionId session) const noexcept { return bundle_[session % kBundleStripes]; }
+    CompressStripe &CompressStripeOf(SessionId session) const noexcept { return compress_[session % kCompressStripes]; }
+
+    /**
+     * @brief Привязать src-адрес к сессии, если у неё ещё нет адреса этого семейства.
+     * @return true — адрес теперь принадлежит сессии.
+     */
+    bool Learn(SessionId session, const std::uint8_t *pkt, std::size_t len);
+
+    /**
+     * @brief IP-пакет клиента: проверка src, затем TUN (или напрямую другому клиенту).
+     */
+    ssize_t ForwardPacket(Shard &self, SessionId session, const std::uint8_t *buf, std::size_t len) noexcept;
+
+    /**
+     * @brief Пакет из TUN для сессии шарда: сжатие, нумерация, сборка, FEC.
+     * @return Длина для плагина; 0 — пакет задержан сборщиком.
+     */
+    ssize_t Downlink(Shard &self, SessionId dst, SessionId *session, std::uint8_t *buf, ssize_t n,
+                     std::size_t size) noexcept;
+
+    /**
+     * @brief Записать пакет клиента в очередь TUN шарда (через склейку, если она включена).
+     * @return Как TunDevice::Write; пакет, взятый склейкой, считается записанным.
+     */
+    ssize_t WriteTun(Shard &self, const std::uint8_t *buf, std::size_t len) noexcept;
+
+    /**
+     * @brief Пакет склейки в очередь TUN шарда (склеенный — через WriteGso, если очередь умеет).
+     */
+    static void EmitGro(Shard &self, const Gro::Packet &pkt) noexcept;
+
+    /**
+     * @brief Вытолкнуть удержанное склейкой шарда по сроку.
+     */
+    static void PollGro(Shard &self) noexcept;
+
+    /**
+     * @brief Пронумерованный пакет клиента: через окно сессии в ForwardPacket.
+     * @return false — кадр отброшен.
+     */
+    bool HandleSequenced(Shard &self, SessionId session, const std::uint8_t *payload, std::size_t len) noexcept;
+
+    /**
+     * @brief Пакет с номером seq — в окно сессии (окно заводится первым пакетом).
+     * @return false — пакет отброшен.
+     */
+    bool PushSequenced(Shard &self, SessionId session, std::uint32_t seq,
+                       const std::uint8_t *pkt, std::size_t pkt_len) noexcept;
+
+    /**
+     * @brief Пронумеровать пакет (или сжатый из него кадр) для сессии с нумерацией (на месте, сдвигом на kSeqHeaderSize).
+     * @return Новая длина (или прежняя, если сессия без нумерации или буфер мал).
+     */
+    ssize_t StampSequenced(Shard &self, SessionId session, std::uint8_t *buf, ssize_t n, std::size_t size) noexcept;
+
+    /**
+     * @brief Выпустить пакеты, чьё удержание истекло (не чаще раза в миллисекунду).
+     */
+    void ExpireReorder(Shard &self) noexcept;
+
+    /**
+     * @brief Кадр Fec клиента: через декодер сессии в DeliverInner.
+     * @return false — кадр отброшен.
+     */
+    bool HandleFec(Shard &self, SessionId session, const std::uint8_t *payload, std::size_t len) noexcept;
+
+    /**
+     * @brief Пакет, вынутый из блока FEC: IP-пакет, кадр Seq, Compressed, Header или Bundle из них
+     *        (прочие кадры не вкладываются).
+     */
+    void DeliverInner(Shard &self, SessionId session, const std::uint8_t *buf, std::size_t len) noexcept;
+
+    /**
+     * @brief Кадр Bundle клиента: пакеты по одному в ForwardPacket/HandleCoreFrame
+     *        (inner — кадр вынут из блока FEC: вложены только IP-пакеты и кадры Seq).
+     * @return false — кадр отброшен.
+     */
+    bool HandleBundle(Shard &self, SessionId session, const std::uint8_t *buf, std::size_t len, bool inner) noexcept;
+
+    /**
+     * @brief Нагрузка кадра Compressed или Header (type) клиента: восстановленный пакет — в fn(pkt, len)
+     *        (под мьютексом полосы сжатия: пакет лежит в буфере распаковщика сессии).
+     * @return false — кадр отброшен.
+     */
+    template <typename Fn>
+    bool Inflate(Shard &self, SessionId session, CoreFrame::Type type,
+                 const std::uint8_t *payload, std::size_t len, Fn &&fn) noexcept;
+
+    /**
+     * @brief Сжать пакет (нагрузку, иначе заголовок) для сессии, которая сама шлёт Compressed или Header (на месте).
+     * @return Новая длина (или прежняя: сессия без сжатия, пакет не сжимается).
+     */
+    ssize_t Deflate(Shard &self, SessionId session, std::uint8_t *buf, ssize_t n, std::size_t size) noexcept;
+
+    /**
+     * @brief Задержать кадр к клиенту в сборщике шарда (сессия шлёт Bundle, кадр — IP, Seq, Compressed или Header).
+     * @return true — кадр взят, его выдаст PollBundle.
+     */
+    bool HoldBundle(Shard &self, SessionId session, const std::uint8_t *buf, ssize_t n) noexcept;
+
+    /**
+     * @brief Готовый кадр сборщика шарда (через ProtectFec).
+     * @return Длина; 0 — выдавать нечего.
+     */
+    ssize_t PollBundle(Shard &self, SessionId *session, std::uint8_t *buf, std::size_t size) noexcept;
+
+    /**
+     * @brief Защитить пакет для сессии с FEC (на месте); избыточные символы — в кольцо шарда.
+     * @return Новая длина (или прежняя, если сессия без FEC или пакет не защищается).
+     */
+    ssize_t ProtectFec(Shard &self, SessionId session, std::uint8_t *buf, ssize_t n, std::size_t size) noexcept;
+
+    /**
+     * @brief Закрыть блоки по таймеру и разослать отчёты о потерях (не чаще kFecPollPeriodUs).
+     */
+    void PollFec() noexcept;
+
+    /**
+     * @brief Переложить готовые кадры кодера и декодера сессии в кольцо её шарда.
+     */
+    void FlushFec(SessionId session, Protected &p, FecEncoder::Clock::time_point now) noexcept;
+
+    /**
+     * @brief Учесть пакет сессии в учёте шарда self (если учёт включён).
+     */
+    void AccountFlow(Shard &self, SessionId session, const std::uint8_t *buf, std::size_t len,
+                     FlowAccounting::Direction dir) noexcept;
+
+    /**
+     * @brief Обработать служебный кадр от клиента (ответ уходит через кольцо шарда).
+     */
+    ssize_t HandleCoreFrame(Shard &self, SessionId session, const std::uint8_t *buf, std::size_t len) noexcept;
+
+    /**
+     * @brief Общая часть Open/Resume: проверки, выдача адресов, регистрация.
+     * @param resume true — адреса берутся из c (тикет), иначе выдаются из пулов.
+     */
+    bool OpenLocked(SessionId session, const SessionTickets::Contents &c, bool resume, unsigned shard);
+};
+
+template <typename Fn>
+std::size_t SessionRouter::DrainFlows(FlowAccounting::Clock::time_point now, Fn &&fn, bool flush)
+{
+    std::size_t n = 0;
+    for (auto &sh : shards_)
+    {
+        if (sh->acct)
+        {
+            std::lock_guard<std::mutex> lk(sh->acct_mtx);
+            n += sh->acct->Drain(now, fn, flush);
+        }
+    }
+    return n;
+}
@@ -0,0 +1,294 @@
+// SessionTable.cpp — реализация таблицы сессий (open addressing + RCU).
+
+#include "SessionTable.hpp"
+#include "Core/Rcu.hpp"
+#include "Core/Logger.hpp"
+
+#include <bit>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // Состояние слота в младших битах state; старшие биты — фрагмент хэша для быстрого отсева.
+    constexpr std::uint64_t kEmpty = 0;
+    constexpr std::uint64_t kFull  = 1;
+    constexpr std::uint64_t kTomb  = 2;
+    constexpr std::uint64_t kStateMask = 3;
+
+    /// @brief Максимальная доля занятых (включая удалённые) слотов, в процентах.
+    constexpr std::size_t kMaxLoadPct = 70;
+
+    constexpr std::size_t kMinCapacity = 16;
+
+    inline std::uint64_t Mix(std::uint64_t x) noexcept
+    {
+        // splitmix64 finalizer
+        x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27; x *= 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        return x;
+    }
+
+    template <std::size_t W>
+    inline std::uint64_t HashKey(const std::array<std::uint64_t, W> &key) noexcept
+    {
+        std::uint64_t h = 0x9E3779B97F4A7C15ull;
+        for (std::size_t i = 0; i < W; ++i)
+        {
+            h = Mix(h ^ key[i]);
+        }
+        return h;
+    }
+
+    inline std::array<std::uint64_t, 2> Key6(const std::uint8_t *addr) noexcept
+    {
+        std::array<std::uint64_t, 2> k{};
+        std::memcpy(k.data(), addr, 16);
+        return k;
+    }
+
+    inline std::size_t CapacityFor(std::size_t n) noexcept
+    {
+        const std::size_t need = n * 100 / kMaxLoadPct + 1;
+        return std::bit_ceil(need < kMinCapacity ? kMinCapacity : need);
+    }
+}
+
+template <std::size_t W>
+struct SessionTable::Slots
+{
+    struct Slot
+    {
+        /// @brief (hash & ~3) | state. Публикуется последним (release).
+        std::atomic<std::uint64_t> state{kEmpty};
+        std::atomic<std::uint64_t> session{0};
+        std::atomic<std::uint32_t> shard{0};
+        std::array<std::atomic<std::uint64_t>, W> key{};
+    };
+
+    std::size_t       mask;
+    std::size_t       used  = 0;   ///< Full + Tomb (только писатель).
+    std::size_t       live  = 0;   ///< Full (только писатель).
+    std::vector<Slot> slots;
+
+    explicit Slots(std::size_t capacity)
+        : mask(capacity - 1)
+        , slots(capacity)
+    {
+    }
+};
+
+SessionTable::SessionTable(std::size_t expected)
+    : v4_(new Slots<1>(CapacityFor(expected)))
+    , v6_(new Slots<2>(CapacityFor(expected)))
+{
+}
+
+SessionTable::~SessionTable()
+{
+    delete v4_.load(std::memory_order_relaxed);
+    delete v6_.load(std::memory_order_relaxed);
+}
+
+template <std::size_t W>
+SessionId SessionTable::Find(const Slots<W> *t,
+                             const std::array<std::uint64_t, W> &key,
+                             unsigned *shard) noexcept
+{
+    const std::uint64_t h   = HashKey(key);
+    const std::uint64_t tag = h & ~kStateMask;
+    for (std::size_t i = static_cast<std::size_t>(h) & t->mask;; i = (i + 1) & t->mask)
+    {
+        const auto &s = t->slots[i];
+        const std::uint64_t st = s.state.load(std::memory_order_acquire);
+        if ((st & kStateMask) == kEmpty)
+        {
+            return 0;
+        }
+        if (st != (tag | kFull))
+        {
+            continue;
+        }
+        bool same = true;
+        for (std::size_t w = 0; w < W; ++w)
+        {
+            same = same && s.key[w].load(std::memory_order_relaxed) == key[w];
+        }
+        if (same)
+        {
+            if (shard)
+            {
+                *shard = s.shard.load(std::memory_order_relaxed);
+            }
+            return s.session.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <std::size_t W>
+bool SessionTable::Insert(std::atomic<Slots<W> *> &root,
+                          const std::array<std::uint64_t, W> &key,
+                          SessionId session,
+                          unsigned shard)
+{
+    Slots<W> *t = root.load(std::memory_order_relaxed);
+
+    const SessionId owner = Find(t, key);
+    if (owner != 0)
+    {
+        return owner == session;
+    }
+
+    // Рост/чистка: новая версия массива только с живыми записями.
+    if ((t->used + 1) * 100 > (t->mask + 1) * kMaxLoadPct)
+    {
+        auto *fresh = new Slots<W>(CapacityFor((t->live + 1) * 2));
+        for (const auto &s : t->slots)
+        {
+            const std::uint64_t st = s.state.load(std::memory_order_relaxed);
+            if ((st & kStateMask) != kFull)
+            {
+                continue;
+            }
+            std::array<std::uint64_t, W> k{};
+            for (std::size_t w = 0; w < W; ++w)
+            {
+                k[w] = s.key[w].load(std::memory_order_relaxed);
+            }
+            for (std::size_t i = static_cast<std::size_t>(HashKey(k)) & fresh->mask;; i = (i + 1) & fresh->mask)
+            {
+                auto &d = fresh->slots[i];
+                if (d.state.load(std::memory_order_relaxed) != kEmpty)
+                {
+                    continue;
+                }
+                for (std::size_t w = 0; w < W; ++w)
+                {
+                    d.key[w].store(k[w], std::memory_order_relaxed);
+                }
+                d.session.store(s.session.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                d.shard.store(s.shard.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                d.state.store(st, std::memory_order_relaxed);
+                break;
+            }
+            ++fresh->used;
+            ++fresh->live;
+        }
+        LOGD("sessions") << "SessionTable: rebuild " << (t->mask + 1) << " -> " << (fresh->mask + 1)
+                         << " slots (live=" << fresh->live << ")";
+        root.store(fresh, std::memory_order_release);
+        Rcu::Synchronize();
+        delete t;
+        t = fresh;
+    }
+
+    // Удалённые слоты не переиспользуются: ключ однажды опубликованного слота неизменен,
+    // поэтому читателю достаточно одного acquire-чтения state.
+    const std::uint64_t h = HashKey(key);
+    for (std::size_t i = static_cast<std::size_t>(h) & t->mask;; i = (i + 1) & t->mask)
+    {
+        auto &s = t->slots[i];
+        if (s.state.load(std::memory_order_relaxed) != kEmpty)
+        {
+            continue;
+        }
+        for (std::size_t w = 0; w < W; ++w)
+        {
+            s.key[w].store(key[w], std::memory_order_relaxed);
+        }
+        s.session.store(session, std::memory_order_relaxed);
+        s.shard.store(shard, std::memory_order_relaxed);
+        s.state.store((h & ~kStateMask) | kFull, std::memory_order_release);
+        ++t->used;
+        ++t->live;
+        return true;
+    }
+}
+
+template <std::size_t W>
+void SessionTable::Erase(std::atomic<Slots<W> *> &root,
+                         const std::array<std::uint64_t, W> &key,
+                         SessionId session)
+{
+    Slots<W> *t = root.load(std::memory_order_relaxed);
+    const std::uint64_t h   = HashKey(key);
+    const std::uint64_t tag = h & ~kStateMask;
+    for (std::size_t i = static_cast<std::size_t>(h) & t->mask;; i = (i + 1) & t->mask)
+    {
+        auto &s = t->slots[i];
+        const std::uint64_t st = s.state.load(std::memory_order_relaxed);
+        if ((st & kStateMask) == kEmpty)
+        {
+            return;
+        }
+        if (st != (tag | kFull))
+        {
+            continue;
+        }
+        bool same = true;
+        for (std::size_t w = 0; w < W; ++w)
+        {
+            same = same && s.key[w].load(std::memory_order_relaxed) == key[w];
+        }
+        if (same)
+        {
+            if (s.session.load(std::memory_order_relaxed) == session)
+            {
+                s.state.store(tag | kTomb, std::memory_order_release);
+                --t->live;
+            }
+            return;
+        }
+    }
+}
+
+bool SessionTable::Bind4(SessionId session,
+                         std::uint32_t addr,
+                         unsigned shard)
+{
+    std::lock_guard<std::mutex> lk(write_mtx_);
+    return Insert<1>(v4_, {addr}, session, shard);
+}
+
+bool SessionTable::Bind6(SessionId session,
+                         const Addr6 &addr,
+                         unsigned shard)
+{
+    std::lock_guard<std::mutex> lk(write_mtx_);
+    return Insert<2>(v6_, Key6(addr.data()), session, shard);
+}
+
+void SessionTable::Unbind4(SessionId session,
+                           std::uint32_t addr)
+{
+    std::lock_guard<std::mutex> lk(write_mtx_);
+    Erase<1>(v4_, {addr}, session);
+}
+
+void SessionTable::Unbind6(SessionId session,
+                           const Addr6 &addr)
+{
+    std::lock_guard<std::mutex> lk(write_mtx_);
+    Erase<2>(v6_, Key6(addr.data()), session);
+}
+
+SessionId SessionTable::Lookup4(std::uint32_t addr,
+                                unsigned *shard) const noexcept
+{
+    Rcu::ReadGuard guard;
+    return Find<1>(v4_.load(std::memory_order_acquire), {addr}, shard);
+}
+
+SessionId SessionTable::Lookup6(const std::uint8_t *addr,
+                                unsigned *shard) const noexcept
+{
+    Rcu::ReadGuard guard;
+    return Find<2>(v6_.load(std::memory_order_acquire), Key6(addr), shard);
+}
+
+std::size_t SessionTable::Size() const noexcept
+{
+    std::lock_guard<std::mutex> lk(write_mtx_);
+    return v4_.load(std::memory_order_relaxed)->live + v6_.load(std::memory_order_relaxed)->live;
+}
@@ -0,0 +1,107 @@
+#pragma once
+// SessionTable.hpp — отображение внутреннего адреса клиента (IPv4/IPv6) в сессию плагина.
+
+#include "Core/SessionApi.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/**
+ * @brief Таблица «внутренний адрес -> SessionId» для data path сервера.
+ *
+ * Хранение — плоские массивы слотов с открытой адресацией (линейное пробирование,
+ * ёмкость — степень двойки, заполнение <= 70%), отдельно для IPv4 и IPv6.
+ * Стоимость Lookup не зависит от числа клиентов.
+ *
+ * Чтение (Lookup*) — lock-free под Rcu::ReadGuard, без записи в общую память.
+ * Запись (Bind/Unbind) — на подключении/отключении, сериализуется мьютексом;
+ * рост и чистка удалённых слотов — через построение новой версии массива,
+ * атомарную публикацию и Rcu::Synchronize() перед освобождением старой.
+ *
+ * Вместе с сессией хранится номер шарда-владельца, чтобы многопоточный хост
+ * мог передать пакет нужному шарду без второго поиска.
+ *
+ * Таблица не зависит от остального серверного ядра и пригодна для любого
+ * хоста, который крутит Server_Serve/Server_ServeSessions.
+ */
+class SessionTable
+{
+public:
+    /// @brief IPv6-адрес в сетевом порядке байт.
+    using Addr6 = std::array<std::uint8_t, 16>;
+
+    /**
+     * @brief Создать таблицу.
+     * @param expected Ожидаемое число адресов каждого семейства (для начальной ёмкости).
+     */
+    explicit SessionTable(std::size_t expected = 1024);
+
+    ~SessionTable();
+
+    SessionTable(const SessionTable &) = delete;
+    SessionTable &operator=(const SessionTable &) = delete;
+
+    /**
+     * @brief Привязать IPv4-адрес (host order) к сессии.
+     * @param shard Шард-владелец сессии.
+     * @return false, если адрес занят другой сессией.
+     */
+    bool Bind4(SessionId session, std::uint32_t addr, unsigned shard = 0);
+
+    /**
+     * @brief Привязать IPv6-адрес к сессии.
+     * @param shard Шард-владелец сессии.
+     * @return false, если адрес занят другой сессией.
+     */
+    bool Bind6(SessionId session, const Addr6 &addr, unsigned shard = 0);
+
+    /**
+     * @brief Снять привязку IPv4-адреса, если она принадлежит session.
+     */
+    void Unbind4(SessionId session, std::uint32_t addr);
+
+    /**
+     * @brief Снять привязку IPv6-адреса, если она принадлежит session.
+     */
+    void Unbind6(SessionId session, const Addr6 &addr);
+
+    /**
+     * @brief Найти сессию по IPv4-адресу (host order).
+     * @param shard Если не nullptr — сюда пишется шард-владелец найденной сессии.
+     * @return SessionId или 0.
+     */
+    SessionId Lookup4(std::uint32_t addr, unsigned *shard = nullptr) const noexcept;
+
+    /**
+     * @brief Найти сессию по IPv6-адресу (16 байт, сетевой порядок).
+     * @param shard Если не nullptr — сюда пишется шард-владелец найденной сессии.
+     * @return SessionId или 0.
+     */
+    SessionId Lookup6(const std::uint8_t *addr, unsigned *shard = nullptr) const noexcept;
+
+    /** @brief Число привязанных адресов (v4 + v6). */
+    std::size_t Size() const noexcept;
+
+private:
+    /// @brief Версия плоского массива слотов; ключ — W 64-битных слов.
+    template <std::size_t W> struct Slots;
+
+    std::atomic<Slots<1> *> v4_{nullptr};
+    std::atomic<Slots<2> *> v6_{nullptr};
+
+    /// @brief Сериализация писателей.
+    mutable std::mutex write_mtx_;
+
+    template <std::size_t W>
+    static SessionId Find(const Slots<W> *t, const std::array<std::uint64_t, W> &key, unsigned *shard = nullptr) noexcept;
+
+    template <std::size_t W>
+    bool Insert(std::atomic<Slots<W> *> &root, const std::array<std::uint64_t, W> &key, SessionId session, unsigned shard);
+
+    template <std::size_t W>
+    void Erase(std::atomic<Slots<W> *> &root, const std::array<std::uint64_t, W> &key, SessionId session);
+};
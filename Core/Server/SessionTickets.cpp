@@ -0,0 +1,364 @@
+// SessionTickets.cpp — тикеты возобновления на AES-256-GCM (OpenSSL EVP).
+
+#include "SessionTickets.hpp"
+#include "Core/Logger.hpp"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+    constexpr std::uint8_t  kTicketVersion = 1;
+    constexpr std::size_t   kHeaderSize    = 1 + 4;    // версия + key_id
+    constexpr std::size_t   kNonceSize     = 12;
+    constexpr std::size_t   kTagSize       = 16;
+    constexpr std::uint32_t kKeysMagic     = 0x4B544646; // "FFTK"
+    constexpr std::uint32_t kKeysVersion   = 1;
+
+    constexpr std::uint8_t kHas4 = 0x01;
+    constexpr std::uint8_t kHas6 = 0x02;
+
+    struct CipherCtxDeleter
+    {
+        void operator()(EVP_CIPHER_CTX *ctx) const noexcept { EVP_CIPHER_CTX_free(ctx); }
+    };
+    using CipherCtx = std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter>;
+
+    std::int64_t UnixNow() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void PutLe(std::string &out, std::uint64_t v, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+        {
+            out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+        }
+    }
+
+    /// @brief Чтение LE-поля; false — данные кончились.
+    bool GetLe(const std::string &in, std::size_t &pos, int bytes, std::uint64_t &v)
+    {
+        if (pos + static_cast<std::size_t>(bytes) > in.size())
+        {
+            return false;
+        }
+        v = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            v |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(in[pos++])) << (8 * i);
+        }
+        return true;
+    }
+
+    bool GetBytes(const std::string &in, std::size_t &pos, std::size_t n, std::string &out)
+    {
+        if (pos + n > in.size())
+        {
+            return false;
+        }
+        out.assign(in, pos, n);
+        pos += n;
+        return true;
+    }
+
+    void Random(std::uint8_t *out, std::size_t n)
+    {
+        if (RAND_bytes(out, static_cast<int>(n)) != 1)
+        {
+            throw std::runtime_error("SessionTickets: RAND_bytes failed");
+        }
+    }
+}
+
+SessionTickets::SessionTickets(const Options &opts)
+    : lifetime_(opts.lifetime)
+    , rotate_(opts.rotate)
+    , key_file_(opts.key_file)
+{
+    if (lifetime_.count() <= 0 || rotate_.count() <= 0)
+    {
+        throw std::invalid_argument("SessionTickets: lifetime and rotate must be positive");
+    }
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!key_file_.empty() && LoadKeys())
+    {
+        LOGI("tickets") << "Loaded " << keys_.size() << " ticket key(s) from " << key_file_;
+    }
+    RotateLocked(UnixNow());
+}
+
+SessionTickets::~SessionTickets()
+{
+    for (auto &k : keys_)
+    {
+        OPENSSL_cleanse(k.bytes.data(), k.bytes.size());
+    }
+}
+
+void SessionTickets::RotateLocked(std::int64_t now)
+{
+    // Ключ нужен, пока им можно выпускать (rotate) и пока живут его тикеты (lifetime).
+    const std::int64_t keep = rotate_.count() + lifetime_.count();
+    const auto old_size = keys_.size();
+    std::erase_if(keys_, [&](const Key &k) { return now - k.created > keep; });
+    bool changed = keys_.size() != old_size;
+
+    if (keys_.empty() || now - keys_.back().created >= rotate_.count())
+    {
+        Key k;
+        k.created = now;
+        do
+        {
+            Random(reinterpret_cast<std::uint8_t *>(&k.id), sizeof(k.id));
+        } while (std::any_of(keys_.begin(), keys_.end(), [&](const Key &o) { return o.id == k.id; }));
+        Random(k.bytes.data(), k.bytes.size());
+        keys_.push_back(k);
+        changed = true;
+        LOGI("tickets") << "New ticket key id=" << k.id << " (keys=" << keys_.size() << ")";
+    }
+
+    if (changed && !key_file_.empty())
+    {
+        try
+        {
+            SaveKeysLocked();
+        }
+        catch (const std::exception &e)
+        {
+            // Не фатально: тикеты просто не переживут перезапуск.
+            LOGE("tickets") << "Failed to save keys: " << e.what();
+        }
+    }
+}
+
+std::string SessionTickets::Issue(const Contents &contents)
+{
+    if (contents.identity.size() > 0xFFFF || contents.params.size() > 0xFFFF)
+    {
+        throw std::runtime_error("SessionTickets: identity/params too long");
+    }
+
+    const std::int64_t now = UnixNow();
+    Key key;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        RotateLocked(now);
+        key = keys_.back();
+    }
+
+    std::string plain;
+    PutLe(plain, static_cast<std::uint64_t>(now), 8);
+    PutLe(plain, static_cast<std::uint64_t>(now + lifetime_.count()), 8);
+    PutLe(plain, (contents.has4 ? kHas4 : 0u) | (contents.has6 ? kHas6 : 0u), 1);
+    PutLe(plain, contents.addr4, 4);
+    plain.append(reinterpret_cast<const char *>(contents.addr6.data()), contents.addr6.size());
+    PutLe(plain, contents.identity.size(), 2);
+    plain += contents.identity;
+    PutLe(plain, contents.params.size(), 2);
+    plain += contents.params;
+
+    std::string out;
+    PutLe(out, kTicketVersion, 1);
+    PutLe(out, key.id, 4);
+    std::uint8_t nonce[kNonceSize];
+    Random(nonce, sizeof(nonce));
+    out.append(reinterpret_cast<const char *>(nonce), sizeof(nonce));
+    const std::size_t body = out.size();
+    out.resize(body + plain.size() + kTagSize);
+
+    auto *dst = reinterpret_cast<std::uint8_t *>(out.data());
+    CipherCtx ctx(EVP_CIPHER_CTX_new());
+    int n = 0;
+    int fin = 0;
+    const bool ok =
+        ctx &&
+        EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, key.bytes.data(), nonce) == 1 &&
+        EVP_EncryptUpdate(ctx.get(), nullptr, &n, dst, static_cast<int>(kHeaderSize)) == 1 &&
+        EVP_EncryptUpdate(ctx.get(), dst + body, &n,
+                          reinterpret_cast<const std::uint8_t *>(plain.data()), static_cast<int>(plain.size())) == 1 &&
+        EVP_EncryptFinal_ex(ctx.get(), dst + body + n, &fin) == 1 &&
+        EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, static_cast<int>(kTagSize),
+                            dst + body + plain.size()) == 1;
+    OPENSSL_cleanse(plain.data(), plain.size());
+    OPENSSL_cleanse(key.bytes.data(), key.bytes.size());
+    if (!ok)
+    {
+        throw std::runtime_error("SessionTickets: encryption failed");
+    }
+    return out;
+}
+
+std::optional<SessionTickets::Contents> SessionTickets::Open(const std::uint8_t *ticket,
+                                                             std::size_t len)
+{
+    if (!ticket || len < kHeaderSize + kNonceSize + kTagSize || ticket[0] != kTicketVersion)
+    {
+        LOGD("tickets") << "Open: malformed ticket (len=" << len << ")";
+        return std::nullopt;
+    }
+    const std::uint32_t key_id = static_cast<std::uint32_t>(ticket[1]) |
+                                 (static_cast<std::uint32_t>(ticket[2]) << 8) |
+                                 (static_cast<std::uint32_t>(ticket[3]) << 16) |
+                                 (static_cast<std::uint32_t>(ticket[4]) << 24);
+
+    const std::int64_t now = UnixNow();
+    Key key;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        RotateLocked(now);
+        auto it = std::find_if(keys_.begin(), keys_.end(), [&](const Key &k) { return k.id == key_id; });
+        if (it == keys_.end())
+        {
+            LOGD("tickets") << "Open: unknown key id=" << key_id;
+            return std::nullopt;
+        }
+        key = *it;
+    }
+
+    const std::uint8_t *nonce = ticket + kHeaderSize;
+    const std::uint8_t *cipher = nonce + kNonceSize;
+    const std::size_t cipher_len = len - kHeaderSize - kNonceSize - kTagSize;
+    std::uint8_t tag[kTagSize];
+    std::copy_n(cipher + cipher_len, kTagSize, tag);
+
+    std::string plain(cipher_len, '\0');
+    CipherCtx ctx(EVP_CIPHER_CTX_new());
+    int n = 0;
+    int fin = 0;
+    const bool ok =
+        ctx &&
+        EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, key.bytes.data(), nonce) == 1 &&
+        EVP_DecryptUpdate(ctx.get(), nullptr, &n, ticket, static_cast<int>(kHeaderSize)) == 1 &&
+        EVP_DecryptUpdate(ctx.get(), reinterpret_cast<std::uint8_t *>(plain.data()), &n,
+                          cipher, static_cast<int>(cipher_len)) == 1 &&
+        EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, static_cast<int>(kTagSize), tag) == 1 &&
+        EVP_DecryptFinal_ex(ctx.get(), reinterpret_cast<std::uint8_t *>(plain.data()) + n, &fin) == 1;
+    OPENSSL_cleanse(key.bytes.data(), key.bytes.size());
+    if (!ok)
+    {
+        LOGW("tickets") << "Open: authentication failed (key id=" << key_id << ")";
+        return std::nullopt;
+    }
+
+    Contents c;
+    std::size_t pos = 0;
+    std::uint64_t issued = 0, expires = 0, flags = 0, addr4 = 0, id_len = 0, params_len = 0;
+    std::string addr6;
+    const bool parsed =
+        GetLe(plain, pos, 8, issued) &&
+        GetLe(plain, pos, 8, expires) &&
+        GetLe(plain, pos, 1, flags) &&
+        GetLe(plain, pos, 4, addr4) &&
+        GetBytes(plain, pos, c.addr6.size(), addr6) &&
+        GetLe(plain, pos, 2, id_len) &&
+        GetBytes(plain, pos, static_cast<std::size_t>(id_len), c.identity) &&
+        GetLe(plain, pos, 2, params_len) &&
+        GetBytes(plain, pos, static_cast<std::size_t>(params_len), c.params) &&
+        pos == plain.size();
+    OPENSSL_cleanse(plain.data(), plain.size());
+    if (!parsed)
+    {
+        LOGW("tickets") << "Open: malformed contents";
+        return std::nullopt;
+    }
+    if (static_cast<std::int64_t>(expires) < now || static_cast<std::int64_t>(issued) > now + 60)
+    {
+        LOGD("tickets") << "Open: ticket expired";
+        return std::nullopt;
+    }
+
+    c.has4  = (flags & kHas4) != 0;
+    c.addr4 = static_cast<std::uint32_t>(addr4);
+    c.has6  = (flags & kHas6) != 0;
+    std::copy(addr6.begin(), addr6.end(), c.addr6.begin());
+    return c;
+}
+
+void SessionTickets::SaveKeysLocked() const
+{
+    std::string out;
+    PutLe(out, kKeysMagic, 4);
+    PutLe(out, kKeysVersion, 4);
+    PutLe(out, keys_.size(), 4);
+    for (const auto &k : keys_)
+    {
+        PutLe(out, k.id, 4);
+        PutLe(out, static_cast<std::uint64_t>(k.created), 8);
+        out.append(reinterpret_cast<const char *>(k.bytes.data()), k.bytes.size());
+    }
+
+    const std::string tmp = key_file_ + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        std::error_code ec;
+        std::filesystem::permissions(tmp,
+                                     std::filesystem::perms::owner_read | std::filesystem::perms::owner_write,
+                                     std::filesystem::perm_options::replace, ec);
+        f.write(out.data(), static_cast<std::streamsize>(out.size()));
+        OPENSSL_cleanse(out.data(), out.size());
+        if (!f || ec)
+        {
+            throw std::runtime_error("SessionTickets: key file write failed");
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, key_file_, ec);
+    if (ec)
+    {
+        throw std::runtime_error("SessionTickets: key file rename failed: " + ec.message());
+    }
+}
+
+bool SessionTickets::LoadKeys()
+{
+    std::ifstream f(key_file_, std::ios::binary);
+    if (!f.is_open())
+    {
+        return false;
+    }
+    std::string in((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    std::size_t pos = 0;
+    std::uint64_t magic = 0, version = 0, count = 0;
+    if (!GetLe(in, pos, 4, magic) || !GetLe(in, pos, 4, version) || !GetLe(in, pos, 4, count) ||
+        magic != kKeysMagic || version != kKeysVersion)
+    {
+        OPENSSL_cleanse(in.data(), in.size());
+        throw std::runtime_error("SessionTickets: bad key file " + key_file_);
+    }
+
+    std::vector<Key> keys;
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        Key k;
+        std::uint64_t id = 0, created = 0;
+        std::string bytes;
+        if (!GetLe(in, pos, 4, id) || !GetLe(in, pos, 8, created) || !GetBytes(in, pos, k.bytes.size(), bytes))
+        {
+            OPENSSL_cleanse(in.data(), in.size());
+            throw std::runtime_error("SessionTickets: truncated key file " + key_file_);
+        }
+        k.id      = static_cast<std::uint32_t>(id);
+        k.created = static_cast<std::int64_t>(created);
+        std::copy(bytes.begin(), bytes.end(), k.bytes.begin());
+        OPENSSL_cleanse(bytes.data(), bytes.size());
+        keys.push_back(k);
+    }
+    OPENSSL_cleanse(in.data(), in.size());
+
+    std::sort(keys.begin(), keys.end(), [](const Key &a, const Key &b) { return a.created < b.created; });
+    keys_ = std::move(keys);
+    return true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+// SessionTickets.hpp — тикеты возобновления сессий (выпуск и проверка на сервере).
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Выпуск и проверка тикетов возобновления сессии.
+ *
+ * Тикет — непрозрачная для клиента строка: AES-256-GCM над состоянием сессии
+ * (identity, внутренние адреса, параметры плагина, время выпуска и истечения).
+ * Сервер ничего не хранит на каждую сессию: всё нужное для восстановления —
+ * внутри тикета, подделка или изменение ловятся тегом GCM.
+ *
+ * Ключи ротируются раз в rotate; старый ключ остаётся для проверки, пока
+ * выпущенные им тикеты не истекут. При заданном key_file ключи переживают
+ * перезапуск сервера.
+ *
+ * Формат: [версия 1][key_id 4][nonce 12][шифротекст][тег 16], заголовок — AAD.
+ */
+class SessionTickets
+{
+public:
+    /**
+     * @brief Параметры выпуска.
+     */
+    struct Options
+    {
+        /// @brief Время жизни тикета.
+        std::chrono::seconds lifetime{43200};
+        /// @brief Период смены ключа.
+        std::chrono::seconds rotate{21600};
+        /// @brief Файл для хранения ключей (пусто — только в памяти).
+        std::string key_file;
+    };
+
+    /**
+     * @brief Состояние сессии, запечатанное в тикете.
+     */
+    struct Contents
+    {
+        std::string                    identity;
+        bool                           has4  = false;
+        std::uint32_t                  addr4 = 0;     ///< Host order.
+        bool                           has6  = false;
+        std::array<std::uint8_t, 16>   addr6{};
+        std::string                    params;       ///< Параметры сессии плагина (непрозрачно).
+    };
+
+    /**
+     * @brief Создать выпускающего; загружает ключи из key_file, если он есть.
+     * @throw std::invalid_argument Некорректные параметры.
+     * @throw std::runtime_error    Повреждённый key_file или ошибка генератора случайных чисел.
+     */
+    explicit SessionTickets(const Options &opts);
+
+    ~SessionTickets();
+
+    SessionTickets(const SessionTickets &) = delete;
+    SessionTickets &operator=(const SessionTickets &) = delete;
+
+    /**
+     * @brief Выпустить тикет.
+     * @throw std::runtime_error Ошибка шифрования или слишком длинные поля.
+     */
+    std::string Issue(const Contents &contents);
+
+    /**
+     * @brief Проверить и расшифровать тикет.
+     * @return Состояние сессии или std::nullopt (чужой ключ, подделка, истёк).
+     */
+    std::optional<Contents> Open(const std::uint8_t *ticket, std::size_t len);
+
+    /** @brief Время жизни тикета. */
+    std::chrono::seconds Lifetime() const noexcept { return lifetime_; }
+
+private:
+    struct Key
+    {
+        std::uint32_t                id      = 0;
+        std::int64_t                 created = 0;   ///< Unix-время, с.
+        std::array<std::uint8_t, 32> bytes{};
+    };
+
+    std::chrono::seconds lifetime_;
+    std::chrono::seconds rotate_;
+    std::string          key_file_;
+
+    std::mutex       mtx_;
+    std::vector<Key> keys_;   ///< keys_.back() — текущий.
+
+    /// @brief Сменить ключ, если пора, и выбросить истёкшие (под mtx_).
+    void RotateLocked(std::int64_t now);
+    void SaveKeysLocked() const;
+    bool LoadKeys();
+};
@@ -0,0 +1,71 @@
+#pragma once
+// TunDevice.hpp — абстракция TUN-устройства для серверного ядра.
+// Позволяет подменить ядерный tun (LinuxTun) на in-memory реализацию в тестах.
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+/**
+ * @brief Интерфейс TUN-устройства: неблокирующие чтение/запись одного IP-пакета.
+ */
+class TunDevice
+{
+public:
+    virtual ~TunDevice() = default;
+
+    /**
+     * @brief Прочитать один пакет (без ожидания).
+     * @param buf  Буфер.
+     * @param size Размер буфера.
+     * @return Длина пакета; 0 — пакетов нет; -1 — ошибка.
+     */
+    virtual ssize_t Read(std::uint8_t *buf, std::size_t size) noexcept = 0;
+
+    /**
+     * @brief Записать один пакет.
+     * @param buf Данные пакета.
+     * @param len Длина.
+     * @return Записанная длина; 0 — устройство занято (пакет отброшен); -1 — ошибка.
+     */
+    virtual ssize_t Write(const std::uint8_t *buf, std::size_t len) noexcept = 0;
+
+    /**
+     * @brief Описание TCP-суперпакета для сегментации (поля virtio_net_hdr).
+     */
+    struct Gso
+    {
+        std::uint16_t size        = 0;   ///< Данных TCP в сегменте; 0 — пакет не режется.
+        std::uint16_t hdr_len     = 0;   ///< Заголовки IP + TCP.
+        std::uint16_t csum_start  = 0;   ///< Смещение заголовка L4 (сумма в нём — псевдозаголовка).
+        std::uint16_t csum_offset = 16;  ///< Поле суммы от csum_start.
+        bool          partial     = false; ///< Сумма частичная (при чтении; WriteGso — всегда).
+        bool          ipv6        = false;
+    };
+
+    /**
+     * @brief Прочитать один пакет с описанием offload (без ожидания).
+     *        Устройство с включённым TSO отдаёт TCP-суперпакеты до 64 КиБ с частичной суммой.
+     * @return Как Read; без offload gso заполняется нулями.
+     */
+    virtual ssize_t ReadGso(std::uint8_t *buf, std::size_t size, Gso *gso) noexcept
+    {
+        *gso = Gso{};
+        return Read(buf, size);
+    }
+
+    /** @brief Принимает ли устройство пакеты длиннее MTU через WriteGso. */
+    virtual bool SupportsGso() const noexcept { return false; }
+
+    /**
+     * @brief Записать склеенный TCP-пакет (до 64 КиБ); ядро режет его на сегменты по gso.size.
+     * @return Как Write; -1 — устройство не умеет GSO.
+     */
+    virtual ssize_t WriteGso(const std::uint8_t *buf, std::size_t len, const Gso &gso) noexcept
+    {
+        (void)buf;
+        (void)len;
+        (void)gso;
+        return -1;
+    }
+};
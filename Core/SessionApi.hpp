@@ -0,0 +1,53 @@
+#pragma once
+// SessionApi.hpp — необязательное расширение серверного ABI плагина: сессии клиентов.
+// Плагин, экспортирующий Server_ServeSessions, сообщает ядру о своих клиентах,
+// а ядро само маршрутизирует пакеты TUN <-> сессия по внутреннему адресу.
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <BaseTsd.h>
+#ifndef ssize_t
+#define ssize_t SSIZE_T
+#endif
+#endif
+
+/// @brief Идентификатор сессии; выбирает плагин (уникален, пока сессия открыта; 0 не используется).
+using SessionId = std::uint64_t;
+
+/**
+ * @brief Колбэки ядра для сессионного серверного цикла.
+ */
+struct ServerSessionApi
+{
+    /// @brief Новый клиент. identity — стабильный идентификатор клиента в плагине (ключ, логин).
+    ///        false — ядро отказало (плагин должен закрыть соединение).
+    std::function<bool(SessionId session, const std::uint8_t *identity, std::size_t identity_len)> open;
+
+    /// @brief Клиент отключился.
+    std::function<void(SessionId session)> close;
+
+    /// @brief Пакет из TUN для отправки клиенту: в *session — адресат. 0 — пакетов нет.
+    std::function<ssize_t(SessionId *session, std::uint8_t *buf, std::size_t len)> receive_from_net;
+
+    /// @brief Пакет от клиента session в TUN.
+    std::function<ssize_t(SessionId session, const std::uint8_t *buf, std::size_t len)> send_to_net;
+
+    /// @brief Внутренние адреса, выданные сессии ядром из пула (для передачи клиенту).
+    ///        Пустая строка — адрес этого семейства не выдаётся. false — сессия неизвестна.
+    std::function<bool(SessionId session, std::string *addr4, std::string *addr6)> addresses;
+
+    /// @brief Открыть сессию по тикету возобновления, предъявленному клиентом
+    ///        (в конфиге клиента он приходит как "resume_ticket", hex).
+    ///        Вызывается вместо open; params — параметры сессии плагина из тикета.
+    ///        false — тикет недействителен: нужен полный handshake и open.
+    std::function<bool(SessionId session, const std::uint8_t *ticket, std::size_t len, std::string *params)> resume;
+
+    /// @brief Перевыпустить тикет сессии с новыми параметрами плагина; ядро само
+    ///        доставит его клиенту служебным кадром. false — тикеты выключены.
+    std::function<bool(SessionId session, const std::uint8_t *params, std::size_t len)> issue_ticket;
+};
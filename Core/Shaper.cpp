@@ -0,0 +1,340 @@
+// Shaper.cpp — реализация иерархического шейпера.
+
+#include "Shaper.hpp"
+
+#include "PacketMeta.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    /// @brief Правила с target в номерах узлов (класс i — узел i + 1).
+    std::vector<Classifier::Rule> ToNodes(const Shaper::Options &opts)
+    {
+        std::vector<Classifier::Rule> rules = opts.rules;
+        for (Classifier::Rule &r : rules)
+        {
+            if (r.target >= opts.classes.size())
+            {
+                throw std::invalid_argument("Shaper: rule refers to unknown class");
+            }
+            ++r.target;
+        }
+        return rules;
+    }
+}
+
+Shaper::Shaper(const Options &opts)
+    : classifier_(ToNodes(opts))
+    , default_node_(opts.default_class + 1)
+    , burst_(opts.burst)
+    , slot_size_(opts.leaf.slot_size)
+    , rate_kbps_(opts.rate_kbps)
+{
+    if (opts.classes.empty() || opts.classes.size() > kMaxClasses ||
+        opts.burst.count() <= 0 || opts.leaf.slot_size == 0)
+    {
+        throw std::invalid_argument("Shaper: invalid options");
+    }
+    nodes_.resize(opts.classes.size() + 1);
+    nodes_[0].name      = "root";
+    nodes_[0].rate_kbps = opts.rate_kbps;
+    nodes_[0].ceil_kbps = opts.rate_kbps;
+    nodes_[0].leaf      = false;
+
+    for (std::size_t i = 0; i < opts.classes.size(); ++i)
+    {
+        const ClassOptions &c = opts.classes[i];
+        if (c.name.empty())
+        {
+            throw std::invalid_argument("Shaper: class " + std::to_string(i) + " has no name");
+        }
+        for (std::size_t j = 0; j < i; ++j)
+        {
+            if (opts.classes[j].name == c.name)
+            {
+                throw std::invalid_argument("Shaper: duplicate class '" + c.name + "'");
+            }
+        }
+        if (c.parent < -1 || c.parent >= static_cast<int>(i))
+        {
+            throw std::invalid_argument("Shaper: class '" + c.name + "' must follow its parent");
+        }
+        if (c.prio > 7 || (c.ceil_kbps != 0 && c.ceil_kbps < c.rate_kbps) || c.limit == 0)
+        {
+            throw std::invalid_argument("Shaper: invalid class '" + c.name + "'");
+        }
+        Node &n = nodes_[i + 1];
+        n.name         = c.name;
+        n.parent       = c.parent + 1;
+        n.rate_kbps    = c.rate_kbps;
+        n.inherit_ceil = c.ceil_kbps == 0;
+        n.ceil_kbps    = n.inherit_ceil ? nodes_[static_cast<std::size_t>(n.parent)].ceil_kbps : c.ceil_kbps;
+        n.prio         = c.prio;
+        nodes_[static_cast<std::size_t>(n.parent)].leaf = false;
+    }
+
+    for (std::size_t i = 1; i < nodes_.size(); ++i)
+    {
+        Node &n = nodes_[i];
+        if (!n.leaf)
+        {
+            continue;
+        }
+        const ClassOptions &c = opts.classes[i - 1];
+        FqCodel::Options q = opts.leaf;
+        q.limit          = c.limit;
+        q.flow_rate_kbps = c.flow_kbps;
+        q.rate_kbps      = 0;
+        q.burst          = std::max(opts.burst, q.burst);
+        n.queue = std::make_unique<FqCodel>(q);
+    }
+    if (default_node_ >= nodes_.size() || !nodes_[default_node_].leaf)
+    {
+        throw std::invalid_argument("Shaper: default class must be a leaf");
+    }
+    for (const Classifier::Rule &r : opts.rules)
+    {
+        if (!nodes_[r.target + 1].leaf)
+        {
+            throw std::invalid_argument("Shaper: rule refers to non-leaf class '" + nodes_[r.target + 1].name + "'");
+        }
+    }
+
+    for (Node &n : nodes_)
+    {
+        Configure(n);
+        n.tokens  = n.burst;
+        n.ctokens = n.cburst;
+    }
+}
+
+bool Shaper::Enqueue(const std::uint8_t *data,
+                     std::size_t len,
+                     Clock::time_point now) noexcept
+{
+    Node &n = nodes_[classifier_.Match(data, len, default_node_)];
+    if (!n.queue->Enqueue(data, len, now))
+    {
+        return false;
+    }
+    ++stats_.enqueued;
+    return true;
+}
+
+bool Shaper::Enqueue(const std::uint8_t *data,
+                     std::size_t len,
+                     Clock::time_point now,
+                     const PacketMeta &meta,
+                     std::size_t i) noexcept
+{
+    Node &n = nodes_[classifier_.Match(meta, i, default_node_)];
+    if (!n.queue->Enqueue(data, len, now, meta, i))
+    {
+        return false;
+    }
+    ++stats_.enqueued;
+    return true;
+}
+
+std::size_t Shaper::Dequeue(std::uint8_t *out,
+                            std::size_t size,
+                            Clock::time_point now) noexcept
+{
+    Refill(now);
+    const auto count = static_cast<unsigned>(nodes_.size());
+    std::uint64_t skip = 0;   // листы, очередь которых в этом вызове ничего не выдала
+    for (;;)
+    {
+        unsigned best = 0;
+        unsigned best_lender = 0;
+        Mode     best_mode = kBlocked;
+        unsigned best_prio = 0;
+        unsigned best_dist = 0;
+        for (unsigned i = 1; i < count; ++i)
+        {
+            const Node &n = nodes_[i];
+            if (!n.leaf || ((skip >> i) & 1) != 0 || n.queue->Packets() == 0)
+            {
+                continue;
+            }
+            unsigned lender = 0;
+            const Mode mode = LeafMode(i, &lender);
+            if (mode == kBlocked)
+            {
+                continue;
+            }
+            // Порядок: режим, prio, затем по кругу от последнего обслуженного с тем же ключом.
+            const unsigned dist = (i + count - rr_[mode][n.prio] - 1) % count;
+            if (best == 0 || mode < best_mode ||
+                (mode == best_mode && (n.prio < best_prio || (n.prio == best_prio && dist < best_dist))))
+            {
+                best        = i;
+                best_lender = lender;
+                best_mode   = mode;
+                best_prio   = n.prio;
+                best_dist   = dist;
+            }
+        }
+        if (best == 0)
+        {
+            const Node &root = nodes_[0];
+            if (root.rate_bps > 0 && root.tokens < 0 && Packets() != 0)
+            {
+                ++stats_.throttled;
+            }
+            return 0;
+        }
+
+        Node &n = nodes_[best];
+        const std::size_t len = n.queue->Dequeue(out, size, now);
+        if (len == 0)
+        {
+            skip |= std::uint64_t{1} << best;
+            continue;
+        }
+        Charge(best, best_lender, len);
+        rr_[best_mode][best_prio] = best;
+        ++n.stats.packets;
+        n.stats.bytes += len;
+        if (best_mode == kYellow)
+        {
+            ++n.stats.borrowed;
+        }
+        ++stats_.dequeued;
+        return len;
+    }
+}
+
+void Shaper::SetRate(std::uint64_t kbps) noexcept
+{
+    rate_kbps_ = kbps;
+    nodes_[0].rate_kbps = kbps;
+    nodes_[0].ceil_kbps = kbps;
+    for (std::size_t i = 0; i < nodes_.size(); ++i)
+    {
+        Node &n = nodes_[i];
+        if (n.inherit_ceil)
+        {
+            n.ceil_kbps = nodes_[static_cast<std::size_t>(n.parent)].ceil_kbps;
+        }
+        Configure(n);
+        n.tokens  = std::min(n.tokens, n.burst);
+        n.ctokens = std::min(n.ctokens, n.cburst);
+    }
+}
+
+std::size_t Shaper::Packets() const noexcept
+{
+    std::size_t total = 0;
+    for (const Node &n : nodes_)
+    {
+        if (n.queue)
+        {
+            total += n.queue->Packets();
+        }
+    }
+    return total;
+}
+
+bool Shaper::GetClassStats(std::size_t i,
+                           ClassStats *out) const
+{
+    if (i + 1 >= nodes_.size())
+    {
+        return false;
+    }
+    const Node &n = nodes_[i + 1];
+    *out = n.stats;
+    if (n.queue)
+    {
+        const FqCodel::Stats &q = n.queue->GetStats();
+        out->drops   = q.codel_drops + q.overlimit_drops + q.oversize_drops;
+        out->backlog = n.queue->Packets();
+    }
+    return true;
+}
+
+void Shaper::Configure(Node &n) noexcept
+{
+    const double depth = std::chrono::duration<double>(burst_).count();
+    const auto   slot  = static_cast<double>(slot_size_);
+    n.rate_bps = static_cast<double>(n.rate_kbps) * 125.0;
+    n.ceil_bps = static_cast<double>(n.ceil_kbps) * 125.0;
+    n.burst    = std::max(slot, n.rate_bps * depth);
+    n.cburst   = std::max(slot, n.ceil_bps * depth);
+}
+
+void Shaper::Refill(Clock::time_point now) noexcept
+{
+    if (!refilled_)
+    {
+        refilled_  = true;
+        refill_at_ = now;
+        return;
+    }
+    const double dt = std::chrono::duration<double>(now - refill_at_).count();
+    if (dt <= 0)
+    {
+        return;
+    }
+    refill_at_ = now;
+    for (Node &n : nodes_)
+    {
+        if (n.rate_bps > 0)
+        {
+            n.tokens = std::min(n.burst, n.tokens + dt * n.rate_bps);
+        }
+        if (n.ceil_bps > 0)
+        {
+            n.ctokens = std::min(n.cburst, n.ctokens + dt * n.ceil_bps);
+        }
+    }
+}
+
+Shaper::Mode Shaper::LeafMode(unsigned leaf,
+                              unsigned *lender) const noexcept
+{
+    for (int i = static_cast<int>(leaf); i >= 0; i = nodes_[static_cast<std::size_t>(i)].parent)
+    {
+        const Node &n = nodes_[static_cast<std::size_t>(i)];
+        if (n.ceil_bps > 0 && n.ctokens < 0)
+        {
+            return kBlocked;
+        }
+    }
+    for (int i = static_cast<int>(leaf); i >= 0; i = nodes_[static_cast<std::size_t>(i)].parent)
+    {
+        const Node &n = nodes_[static_cast<std::size_t>(i)];
+        // Корень без предела одалживает всегда.
+        if ((i == 0 && n.rate_bps == 0) || (n.rate_bps > 0 && n.tokens >= 0))
+        {
+            *lender = static_cast<unsigned>(i);
+            return i == static_cast<int>(leaf) ? kGreen : kYellow;
+        }
+    }
+    return kBlocked;
+}
+
+void Shaper::Charge(unsigned leaf,
+                    unsigned lender,
+                    std::size_t len) noexcept
+{
+    const auto bytes = static_cast<double>(len);
+    bool above = false;
+    for (int i = static_cast<int>(leaf); i >= 0; i = nodes_[static_cast<std::size_t>(i)].parent)
+    {
+        Node &n = nodes_[static_cast<std::size_t>(i)];
+        // Ниже заимодавца своя rate уже исчерпана — списывается только ceil.
+        above = above || static_cast<unsigned>(i) == lender;
+        if (above && n.rate_bps > 0)
+        {
+            n.tokens -= bytes;
+        }
+        if (n.ceil_bps > 0)
+        {
+            n.ctokens -= bytes;
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#pragma once
+// Shaper.hpp — иерархический шейпер (HTB): классы с гарантированной скоростью, потолком и заёмом.
+
+#include "Classifier.hpp"
+#include "FqCodel.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Дерево классов трафика с парой token bucket на каждом (как HTB в Linux).
+ *
+ * - Корень — общий предел (на клиента); под ним классы, у каждого rate
+ *   (гарантия), ceil (потолок с заёмом) и prio.
+ * - Пакет попадает в класс-лист по правилам Classifier (первое совпадение),
+ *   иначе — в класс по умолчанию. Очередь листа — FQ-CoDel: потоки внутри
+ *   класса делят его скорость честно, flow_kbps ограничивает каждый из них.
+ * - Выдача: сначала листы в пределах своей rate (по prio, внутри prio — по
+ *   кругу), затем листы, которым одалживает ближайший предок с запасом;
+ *   ни один класс на пути не превышает ceil. Заём списывается с токенов
+ *   заимодавца и всех классов над ним, ceil — со всех классов пути.
+ * - Ведра неглубокие (burst во времени, не меньше пакета), так что пакеты
+ *   уходят ровным темпом, а не пачками после простоя.
+ *
+ * Время передаётся в каждый вызов (монотонные часы высокого разрешения
+ * у владельца или виртуальные в тестах). Класс не потокобезопасен:
+ * синхронизация — на стороне владельца.
+ */
+class Shaper
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Предел числа классов (без корня).
+    static constexpr std::size_t kMaxClasses = 63;
+
+    /**
+     * @brief Параметры класса.
+     */
+    struct ClassOptions
+    {
+        std::string name;
+        /// @brief Индекс родителя в Options::classes (-1 — корень); родитель объявлен раньше.
+        int parent = -1;
+        /// @brief Гарантированная скорость, кбит/с (0 — только заём).
+        std::uint64_t rate_kbps = 0;
+        /// @brief Потолок с заёмом, кбит/с (0 — потолок родителя).
+        std::uint64_t ceil_kbps = 0;
+        /// @brief Приоритет выдачи и заёма (0 — высший .. 7).
+        unsigned prio = 4;
+        /// @brief Предел каждого потока класса, кбит/с (0 — без предела).
+        std::uint64_t flow_kbps = 0;
+        /// @brief Пакетов в очереди листа.
+        std::size_t limit = 256;
+    };
+
+    /**
+     * @brief Параметры шейпера.
+     */
+    struct Options
+    {
+        /// @brief Общий предел (корень), кбит/с (0 — без предела).
+        std::uint64_t rate_kbps = 0;
+        /// @brief Глубина ведер во времени (не меньше пакета).
+        std::chrono::microseconds burst{1000};
+        std::vector<ClassOptions> classes;
+        /// @brief Правила; target — индекс класса-листа в classes.
+        std::vector<Classifier::Rule> rules;
+        /// @brief Класс-лист для пакетов без совпавшего правила.
+        unsigned default_class = 0;
+        /// @brief Шаблон очереди листа (CoDel, потоки, slot_size); limit и flow_rate — из класса.
+        FqCodel::Options leaf;
+    };
+
+    /**
+     * @brief Счётчики класса.
+     */
+    struct ClassStats
+    {
+        std::uint64_t packets   = 0;   ///< Выдано.
+        std::uint64_t bytes     = 0;
+        std::uint64_t borrowed  = 0;   ///< Выдано сверх своей rate (заём).
+        std::uint64_t drops     = 0;   ///< Отброшено очередью листа (CoDel, переполнение).
+        std::size_t   backlog   = 0;   ///< Пакетов в очереди.
+    };
+
+    /**
+     * @brief Общие счётчики.
+     */
+    struct Stats
+    {
+        std::uint64_t enqueued  = 0;
+        std::uint64_t dequeued  = 0;
+        std::uint64_t throttled = 0;   ///< Выдач, отложенных общим пределом.
+    };
+
+    /**
+     * @brief Построить дерево и скомпилировать правила.
+     * @throw std::invalid_argument Некорректные Options (с описанием).
+     */
+    explicit Shaper(const Options &opts);
+
+    Shaper(const Shaper &) = delete;
+    Shaper &operator=(const Shaper &) = delete;
+
+    /**
+     * @brief Классифицировать пакет и поставить копию в очередь его класса.
+     * @return false — пакет отброшен (больше слота).
+     */
+    bool Enqueue(const std::uint8_t *data, std::size_t len, Clock::time_point now) noexcept;
+
+    /**
+     * @brief Enqueue по метаданным пакета i пачки: класс и поток очереди — без разбора заголовков.
+     */
+    bool Enqueue(const std::uint8_t *data, std::size_t len, Clock::time_point now,
+                 const PacketMeta &meta, std::size_t i) noexcept;
+
+    /**
+     * @brief Выдать следующий пакет.
+     * @return Длина пакета в out; 0 — выдавать нечего или рано.
+     */
+    std::size_t Dequeue(std::uint8_t *out, std::size_t size, Clock::time_point now) noexcept;
+
+    /**
+     * @brief Изменить общий предел (0 — без предела); классы с унаследованным потолком следуют за ним.
+     */
+    void SetRate(std::uint64_t kbps) noexcept;
+
+    /** @brief Общий предел, кбит/с. */
+    std::uint64_t Rate() const noexcept { return rate_kbps_; }
+
+    /** @brief Пакетов во всех очередях. */
+    std::size_t Packets() const noexcept;
+
+    /** @brief Общие счётчики. */
+    const Stats &GetStats() const noexcept { return stats_; }
+
+    /** @brief Число классов (без корня). */
+    std::size_t Classes() const noexcept { return nodes_.size() - 1; }
+
+    /** @brief Имя класса i. */
+    const std::string &ClassName(std::size_t i) const noexcept { return nodes_[i + 1].name; }
+
+    /**
+     * @brief Счётчики класса i.
+     * @return false — нет такого класса.
+     */
+    bool GetClassStats(std::size_t i, ClassStats *out) const;
+
+private:
+    /// @brief Узел дерева; 0 — корень, класс i — узел i + 1.
+    struct Node
+    {
+        std::string              name;
+        int                      parent = -1;
+        std::uint64_t            rate_kbps = 0;
+        std::uint64_t            ceil_kbps = 0;    ///< Действующий потолок (0 — без предела).
+        bool                     inherit_ceil = false;
+        unsigned                 prio = 0;
+        double                   rate_bps = 0;     ///< Байт/с; 0 — своей скорости нет.
+        double                   ceil_bps = 0;     ///< Байт/с; 0 — без предела.
+        double                   burst = 0;
+        double                   cburst = 0;
+        double                   tokens = 0;
+        double                   ctokens = 0;
+        bool                     leaf = true;
+        std::unique_ptr<FqCodel> queue;
+        ClassStats               stats;
+    };
+
+    enum Mode : unsigned
+    {
+        kGreen   = 0,   ///< В пределах своей rate.
+        kYellow  = 1,   ///< Заём у предка.
+        kBlocked = 2,
+    };
+
+    std::vector<Node>     nodes_;
+    Classifier            classifier_;
+    unsigned              default_node_;
+    std::chrono::microseconds burst_;
+    std::size_t           slot_size_;
+    std::uint64_t         rate_kbps_ = 0;
+    Clock::time_point     refill_at_;
+    bool                  refilled_ = false;
+    unsigned              rr_[2][8] = {};      ///< Последний обслуженный узел по (режим, prio).
+    Stats                 stats_;
+
+    /// @brief Пересчитать байтовые скорости и глубины ведер узла.
+    void Configure(Node &n) noexcept;
+
+    void Refill(Clock::time_point now) noexcept;
+
+    /// @brief Режим листа и заимодавец (для kGreen — сам лист).
+    Mode LeafMode(unsigned leaf, unsigned *lender) const noexcept;
+
+    void Charge(unsigned leaf, unsigned lender, std::size_t len) noexcept;
+};
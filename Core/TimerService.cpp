@@ -0,0 +1,333 @@
+// TimerService.cpp — реализация сервиса таймеров.
+
+#include "TimerService.hpp"
+#include "Core/Logger.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+TimerService::TimerService(const Options &opts)
+    : opts_(opts)
+    , epoch_(Clock::now())
+    , wheel_(opts.capacity == 0 ? 1 : opts.capacity)
+{
+    if (opts.tick.count() <= 0 || opts.capacity == 0 || opts.capacity > UINT32_MAX / 2)
+    {
+        throw std::invalid_argument("TimerService: invalid options");
+    }
+    slots_.resize(opts.capacity);
+    free_.reserve(opts.capacity);
+    for (std::size_t i = opts.capacity; i-- > 0;)
+    {
+        free_.push_back(static_cast<std::uint32_t>(i));
+    }
+    due_.reserve(opts.capacity);
+    if (!opts.virtual_clock)
+    {
+        thread_ = std::thread(&TimerService::ThreadMain, this);
+    }
+    LOGD("timer") << "ctor: tick=" << opts.tick.count() << "ms capacity=" << opts.capacity
+                  << (opts.virtual_clock ? " (virtual clock)" : "");
+}
+
+TimerService::~TimerService()
+{
+    try
+    {
+        Stop();
+    }
+    catch (...)
+    {
+        LOGW("timer") << "dtor: exception swallowed in Stop()";
+    }
+}
+
+TimerService::Clock::time_point TimerService::NowLocked() const noexcept
+{
+    return opts_.virtual_clock ? epoch_ + vtime_ : Clock::now();
+}
+
+std::uint64_t TimerService::TicksCeil(Clock::duration d) const noexcept
+{
+    if (d.count() <= 0)
+    {
+        return 0;
+    }
+    const Clock::duration tick = opts_.tick;
+    return static_cast<std::uint64_t>((d + tick - Clock::duration(1)) / tick);
+}
+
+TimerService::Slot *TimerService::Find(Handle h) noexcept
+{
+    const auto id  = static_cast<std::uint32_t>(h);
+    const auto gen = static_cast<std::uint32_t>(h >> 32);
+    if (id >= slots_.size() || slots_[id].state == State::Free || slots_[id].gen != gen)
+    {
+        return nullptr;
+    }
+    return &slots_[id];
+}
+
+TimerService::Handle TimerService::After(Clock::duration delay,
+                                         Callback fn)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return Add(TicksCeil(NowLocked() - epoch_ + delay), 0, std::move(fn));
+}
+
+TimerService::Handle TimerService::At(Clock::time_point at,
+                                      Callback fn)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return Add(TicksCeil(at - epoch_), 0, std::move(fn));
+}
+
+TimerService::Handle TimerService::Every(Clock::duration period,
+                                         Callback fn)
+{
+    const std::uint64_t ticks = TicksCeil(period);
+    if (ticks == 0)
+    {
+        throw std::invalid_argument("TimerService: period must be positive");
+    }
+    std::lock_guard<std::mutex> lk(mtx_);
+    return Add(TicksCeil(NowLocked() - epoch_ + period), ticks, std::move(fn));
+}
+
+TimerService::Handle TimerService::Add(std::uint64_t deadline,
+                                       std::uint64_t period,
+                                       Callback fn)
+{
+    if (stop_)
+    {
+        return kNoTimer;
+    }
+    if (free_.empty())
+    {
+        throw std::length_error("TimerService: out of timers (capacity " + std::to_string(opts_.capacity) + ")");
+    }
+    const std::uint32_t id = free_.back();
+    free_.pop_back();
+    Slot &s = slots_[id];
+    s.fn        = std::move(fn);
+    s.period    = period;
+    s.state     = State::Armed;
+    s.cancelled = false;
+    wheel_.Schedule(id, deadline);
+    s.deadline = wheel_.Deadline(id);
+    if (s.deadline < wake_tick_)
+    {
+        cv_.notify_one();
+    }
+    return (static_cast<Handle>(s.gen) << 32) | id;
+}
+
+void TimerService::Release(std::uint32_t id)
+{
+    Slot &s = slots_[id];
+    s.fn    = nullptr;
+    s.state = State::Free;
+    if (++s.gen == 0)
+    {
+        s.gen = 1;
+    }
+    free_.push_back(id);
+}
+
+bool TimerService::Restart(Handle h,
+                           Clock::duration delay)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    Slot *s = Find(h);
+    if (s == nullptr || s->state != State::Armed)
+    {
+        return false;
+    }
+    const auto id = static_cast<std::uint32_t>(h);
+    wheel_.Schedule(id, TicksCeil(NowLocked() - epoch_ + delay));
+    s->deadline = wheel_.Deadline(id);
+    if (s->deadline < wake_tick_)
+    {
+        cv_.notify_one();
+    }
+    return true;
+}
+
+bool TimerService::Cancel(Handle h)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    Slot *s = Find(h);
+    if (s == nullptr || s->cancelled)
+    {
+        return false;
+    }
+    const auto id = static_cast<std::uint32_t>(h);
+    wheel_.Cancel(id);
+    if (s->state == State::Armed)
+    {
+        Release(id);
+        return true;
+    }
+    // Выполняется: слот освободит RunUntil после колбэка.
+    s->cancelled = true;
+    return s->period != 0;
+}
+
+void TimerService::CancelWait(Handle h)
+{
+    Cancel(h);
+    std::unique_lock<std::mutex> lk(mtx_);
+    if (std::this_thread::get_id() == runner_)
+    {
+        return;
+    }
+    done_cv_.wait(lk, [this, h] { return Find(h) == nullptr; });
+}
+
+TimerService::Clock::time_point TimerService::Now() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return NowLocked();
+}
+
+std::size_t TimerService::Pending() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return wheel_.Pending();
+}
+
+std::size_t TimerService::Advance(Clock::duration dt)
+{
+    if (!opts_.virtual_clock)
+    {
+        throw std::logic_error("TimerService: Advance requires virtual_clock");
+    }
+    std::unique_lock<std::mutex> lk(mtx_);
+    const Clock::duration target = vtime_ + std::max(dt, Clock::duration::zero());
+    const std::size_t calls = RunUntil(lk, static_cast<std::uint64_t>(target / Clock::duration(opts_.tick)));
+    vtime_ = target;
+    return calls;
+}
+
+std::size_t TimerService::RunUntil(std::unique_lock<std::mutex> &lk,
+                                   std::uint64_t target)
+{
+    std::size_t calls = 0;
+    for (;;)
+    {
+        // Шагами по ближайшему сроку: сроки, поставленные из колбэков, идут в общем порядке.
+        const std::uint64_t step = wheel_.NextDeadline();
+        if (step > target)
+        {
+            break;
+        }
+        if (opts_.virtual_clock)
+        {
+            vtime_ = std::max(vtime_, Clock::duration(opts_.tick) * static_cast<std::int64_t>(step));
+        }
+        due_.clear();
+        wheel_.Advance(step, [this](TimerWheel::Id id) { due_.push_back(id); });
+
+        for (const std::uint32_t id : due_)
+        {
+            Slot &s = slots_[id];
+            // Колбэк раньше в пачке мог снять или переставить этот таймер.
+            if (s.state != State::Armed || wheel_.Scheduled(id))
+            {
+                continue;
+            }
+            s.state = State::Running;
+            if (s.period != 0)
+            {
+                std::uint64_t next = s.deadline + s.period;
+                if (!opts_.virtual_clock && next <= target)
+                {
+                    // Простой потока: пропущенные периоды не навёрстываются, фаза сохраняется.
+                    next = target + s.period - (target - s.deadline) % s.period;
+                }
+                wheel_.Schedule(id, next);
+                s.deadline = next;
+            }
+
+            runner_ = std::this_thread::get_id();
+            lk.unlock();
+            try
+            {
+                s.fn();
+            }
+            catch (const std::exception &e)
+            {
+                LOGW("timer") << "callback threw: " << e.what();
+            }
+            catch (...)
+            {
+                LOGW("timer") << "callback threw, swallowed";
+            }
+            lk.lock();
+            runner_ = {};
+            ++calls;
+
+            if (s.cancelled || s.period == 0)
+            {
+                Release(id);
+                done_cv_.notify_all();
+            }
+            else
+            {
+                s.state = State::Armed;
+            }
+        }
+    }
+    return calls;
+}
+
+void TimerService::ThreadMain()
+{
+    LOGD("timer") << "ThreadMain: started";
+    const Clock::duration tick = opts_.tick;
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (!stop_)
+    {
+        RunUntil(lk, static_cast<std::uint64_t>((Clock::now() - epoch_) / tick));
+        if (stop_)
+        {
+            break;
+        }
+        const std::uint64_t next = wheel_.NextDeadline();
+        wake_tick_ = next;
+        if (next == UINT64_MAX)
+        {
+            cv_.wait(lk);
+        }
+        else
+        {
+            cv_.wait_until(lk, epoch_ + tick * static_cast<std::int64_t>(next));
+        }
+        wake_tick_ = 0;
+    }
+    LOGD("timer") << "ThreadMain: exiting";
+}
+
+void TimerService::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (std::uint32_t id = 0; id < slots_.size(); ++id)
+    {
+        if (slots_[id].state == State::Armed)
+        {
+            wheel_.Cancel(id);
+            Release(id);
+        }
+    }
+}
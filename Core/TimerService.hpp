@@ -0,0 +1,186 @@
+#pragma once
+// TimerService.hpp — общий сервис таймеров ядра: колесо таймеров, один поток, виртуальные часы для тестов.
+
+#include "TimerWheel.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Таймеры ядра (keepalive, backoff, дебаунс, истечение записей) на одном колесе.
+ *
+ * Все таймеры живут в одном TimerWheel: постановка, перестановка и отмена —
+ * O(1), наступившие сроки срабатывают пачкой в одном потоке, по порядку
+ * сроков. Тысячи таймеров не стоят ни объектов ядра ОС, ни потоков.
+ *
+ * Колбэки вызываются без внутренней блокировки: из них можно ставить,
+ * переставлять и снимать любые таймеры. Долгий колбэк задерживает
+ * остальные — тяжёлую работу колбэк передаёт дальше сам.
+ *
+ * Режим виртуальных часов (Options::virtual_clock): поток не запускается,
+ * время двигает Advance() — детерминированные тесты без ожиданий.
+ *
+ * Методы потокобезопасны (кроме Advance — один вызывающий).
+ */
+class TimerService
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Колбэк таймера.
+    using Callback = std::function<void()>;
+
+    /// @brief Дескриптор таймера (поколение + номер); устаревший безопасно игнорируется.
+    using Handle = std::uint64_t;
+
+    /// @brief Нет таймера.
+    static constexpr Handle kNoTimer = 0;
+
+    /**
+     * @brief Параметры сервиса.
+     */
+    struct Options
+    {
+        /// @brief Шаг колеса (точность срабатывания; сроки округляются вверх).
+        std::chrono::milliseconds tick{1};
+        /// @brief Наибольшее число одновременно поставленных таймеров.
+        std::size_t capacity = 4096;
+        /// @brief Виртуальные часы: без потока, время двигает Advance().
+        bool virtual_clock = false;
+    };
+
+    /**
+     * @brief Создать сервис (память таймеров выделяется здесь) и запустить поток.
+     * @throw std::invalid_argument Некорректные Options.
+     * @throw std::system_error     Не удалось создать поток.
+     */
+    explicit TimerService(const Options &opts);
+
+    /** @brief Сервис с параметрами по умолчанию. */
+    TimerService() : TimerService(Options{}) {}
+
+    /**
+     * @brief Деструктор: Stop().
+     */
+    ~TimerService();
+
+    TimerService(const TimerService &) = delete;
+    TimerService &operator=(const TimerService &) = delete;
+
+    /**
+     * @brief Однократный таймер через delay.
+     * @return Дескриптор; kNoTimer — сервис остановлен.
+     * @throw std::length_error Все capacity таймеров заняты.
+     */
+    Handle After(Clock::duration delay, Callback fn);
+
+    /**
+     * @brief Однократный таймер на момент at (в прошлом — на ближайшем шаге).
+     * @throw std::length_error Все capacity таймеров заняты.
+     */
+    Handle At(Clock::time_point at, Callback fn);
+
+    /**
+     * @brief Периодический таймер: первый вызов через period, затем каждые period.
+     *        После простоя потока пропущенные периоды не навёрстываются
+     *        (на виртуальных часах — вызываются все, по порядку).
+     * @throw std::invalid_argument period <= 0.
+     * @throw std::length_error     Все capacity таймеров заняты.
+     */
+    Handle Every(Clock::duration period, Callback fn);
+
+    /**
+     * @brief Перенести срок ещё не сработавшего таймера на now + delay (дебаунс).
+     * @return false — таймер уже сработал, выполняется или снят.
+     */
+    bool Restart(Handle h, Clock::duration delay);
+
+    /**
+     * @brief Снять таймер, не дожидаясь колбэка, который, возможно, уже выполняется.
+     * @return true — таймер был жив (однократный ещё не начал выполняться).
+     */
+    bool Cancel(Handle h);
+
+    /**
+     * @brief Снять таймер и дождаться конца его колбэка, если тот выполняется
+     *        в другом потоке. После возврата колбэк не выполняется и не начнётся.
+     *        Из колбэка (в потоке сервиса) — то же, что Cancel.
+     */
+    void CancelWait(Handle h);
+
+    /** @brief Текущее время сервиса (виртуальное — в режиме virtual_clock). */
+    Clock::time_point Now() const;
+
+    /**
+     * @brief Виртуальные часы: сдвинуть время на dt и выполнить наступившие сроки
+     *        по порядку (Now() в колбэке — срок таймера).
+     * @return Число вызванных колбэков.
+     * @throw std::logic_error Сервис работает по реальным часам.
+     */
+    std::size_t Advance(Clock::duration dt);
+
+    /** @brief Число таймеров, ждущих срока. */
+    std::size_t Pending() const;
+
+    /**
+     * @brief Остановить поток и снять все таймеры (идемпотентно). Из колбэка не вызывается.
+     */
+    void Stop();
+
+private:
+    enum class State : std::uint8_t
+    {
+        Free,
+        Armed,
+        Running,
+    };
+
+    /// @brief Таймер: номер совпадает с номером узла в колесе.
+    struct Slot
+    {
+        Callback        fn;
+        std::uint64_t   deadline  = 0;       ///< Тик срока.
+        std::uint64_t   period    = 0;       ///< Тиков; 0 — однократный.
+        std::uint32_t   gen       = 1;       ///< Поколение (часть Handle).
+        State           state     = State::Free;
+        bool            cancelled = false;   ///< Снят во время выполнения.
+    };
+
+    Options                 opts_;
+    Clock::time_point       epoch_;          ///< Тик 0.
+    TimerWheel              wheel_;
+    std::vector<Slot>       slots_;
+    std::vector<std::uint32_t> free_;        ///< Стек свободных номеров.
+    std::vector<std::uint32_t> due_;         ///< Сработавшие на текущем шаге.
+
+    mutable std::mutex      mtx_;
+    std::condition_variable cv_;             ///< Пробуждение потока (новый ближайший срок, остановка).
+    std::condition_variable done_cv_;        ///< Конец колбэка (для CancelWait).
+    std::uint64_t           wake_tick_ = 0;  ///< До какого тика спит поток (0 — не спит).
+    Clock::duration         vtime_{};        ///< Виртуальное время от epoch_.
+    bool                    stop_      = false;
+    std::thread             thread_;
+    std::thread::id         runner_;         ///< Поток, выполняющий колбэки.
+
+    /// @brief Текущее время (mtx_ захвачен).
+    Clock::time_point NowLocked() const noexcept;
+    /// @brief Тиков от epoch_ до d, с округлением вверх.
+    std::uint64_t     TicksCeil(Clock::duration d) const noexcept;
+
+    /// @brief Slot по дескриптору (nullptr — устарел).
+    Slot *Find(Handle h) noexcept;
+
+    Handle Add(std::uint64_t deadline, std::uint64_t period, Callback fn);
+    void   Release(std::uint32_t id);
+
+    /// @brief Выполнить все сроки не позже target по порядку (lk захвачен; на время колбэков отпускается).
+    std::size_t RunUntil(std::unique_lock<std::mutex> &lk, std::uint64_t target);
+
+    void ThreadMain();
+};
@@ -0,0 +1,199 @@
+// TimerWheel.cpp — реализация иерархического колеса таймеров.
+
+#include "TimerWheel.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+TimerWheel::TimerWheel(std::size_t capacity,
+                       std::uint64_t start)
+    : capacity_(capacity)
+    , cur_(start)
+{
+    if (capacity == 0 || capacity > kNil - kLevels * kSlots)
+    {
+        throw std::invalid_argument("TimerWheel: invalid capacity");
+    }
+    nodes_.resize(capacity + kLevels * kSlots);
+    batch_.reserve(capacity);
+    Reset(start);
+}
+
+void TimerWheel::Schedule(Id id,
+                          std::uint64_t deadline) noexcept
+{
+    Node &n = nodes_[id];
+    if (n.next != kNil)
+    {
+        Unlink(id);
+    }
+    n.deadline = std::max(deadline, cur_);
+    Link(id);
+}
+
+void TimerWheel::Cancel(Id id) noexcept
+{
+    Node &n = nodes_[id];
+    if (n.next != kNil)
+    {
+        Unlink(id);
+    }
+    // Снятый в batch_, но ещё не сработавший: метка prev == id гасится.
+    n.prev = kNil;
+}
+
+std::uint64_t TimerWheel::NextDeadline() const noexcept
+{
+    if (pending_ == 0)
+    {
+        return UINT64_MAX;
+    }
+    // Уровень 0: в ячейке только таймеры одного тика.
+    std::uint64_t best = UINT64_MAX;
+    const unsigned slot = static_cast<unsigned>(cur_ & (kSlots - 1));
+    for (unsigned i = 0; i < kSlots; ++i)
+    {
+        const std::uint32_t head = Head(0, (slot + i) & (kSlots - 1));
+        if (nodes_[head].next != head)
+        {
+            best = nodes_[nodes_[head].next].deadline;
+            break;
+        }
+    }
+    // Старшие уровни: граница ближайшей непустой ячейки (может быть раньше ячейки уровня 0 за оборотом).
+    for (unsigned level = 1; level < kLevels; ++level)
+    {
+        const unsigned shift = level * kBits;
+        const std::uint64_t block = cur_ >> shift;
+        for (unsigned i = 1; i <= kSlots; ++i)
+        {
+            const std::uint32_t head = Head(level, static_cast<unsigned>((block + i) & (kSlots - 1)));
+            if (nodes_[head].next != head)
+            {
+                best = std::min(best, (block + i) << shift);
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+void TimerWheel::Reset(std::uint64_t start) noexcept
+{
+    for (std::size_t i = 0; i < capacity_; ++i)
+    {
+        nodes_[i].next = kNil;
+        nodes_[i].prev = kNil;
+    }
+    for (std::size_t i = capacity_; i < nodes_.size(); ++i)
+    {
+        nodes_[i].next = static_cast<std::uint32_t>(i);
+        nodes_[i].prev = static_cast<std::uint32_t>(i);
+    }
+    std::fill(std::begin(occupied_), std::end(occupied_), 0);
+    batch_.clear();
+    pending_ = 0;
+    cur_     = start;
+}
+
+void TimerWheel::Link(std::uint32_t id) noexcept
+{
+    Node &n = nodes_[id];
+    const std::uint64_t delta = n.deadline - cur_;
+    unsigned level = 0;
+    while (level + 1 < kLevels && delta >= (std::uint64_t{1} << ((level + 1) * kBits)))
+    {
+        ++level;
+    }
+    unsigned slot;
+    if (delta >> (kLevels * kBits) != 0)
+    {
+        // Дальше горизонта: последняя ячейка оборота старшего уровня, при каскаде — заново.
+        slot = static_cast<unsigned>(((cur_ >> ((kLevels - 1) * kBits)) + kSlots - 1) & (kSlots - 1));
+    }
+    else
+    {
+        slot = static_cast<unsigned>((n.deadline >> (level * kBits)) & (kSlots - 1));
+    }
+    if (level == 0)
+    {
+        occupied_[slot / 64] |= std::uint64_t{1} << (slot % 64);
+    }
+    const std::uint32_t head = Head(level, slot);
+    n.next = head;
+    n.prev = nodes_[head].prev;
+    nodes_[n.prev].next = id;
+    nodes_[head].prev   = id;
+    ++pending_;
+}
+
+void TimerWheel::Unlink(std::uint32_t id) noexcept
+{
+    Node &n = nodes_[id];
+    nodes_[n.prev].next = n.next;
+    nodes_[n.next].prev = n.prev;
+    n.next = kNil;
+    n.prev = kNil;
+    --pending_;
+}
+
+void TimerWheel::Cascade() noexcept
+{
+    // Сначала старший уровень: его таймеры могут лечь в ячейку младшего, которая раскладывается следом.
+    for (unsigned level = kLevels - 1; level >= 1; --level)
+    {
+        if ((cur_ & ((std::uint64_t{1} << (level * kBits)) - 1)) != 0)
+        {
+            continue;
+        }
+        const std::uint32_t head = Head(level, static_cast<unsigned>((cur_ >> (level * kBits)) & (kSlots - 1)));
+        std::uint32_t id = nodes_[head].next;
+        nodes_[head].next = head;
+        nodes_[head].prev = head;
+        while (id != head)
+        {
+            const std::uint32_t next = nodes_[id].next;
+            --pending_;
+            Link(id);
+            id = next;
+        }
+    }
+}
+
+unsigned TimerWheel::NextOccupied(unsigned from) const noexcept
+{
+    for (unsigned w = from / 64; w < kSlots / 64; ++w)
+    {
+        std::uint64_t bits = occupied_[w];
+        if (w == from / 64)
+        {
+            bits &= ~std::uint64_t{0} << (from % 64);
+        }
+        if (bits != 0)
+        {
+            return w * 64 + static_cast<unsigned>(std::countr_zero(bits));
+        }
+    }
+    return kSlots;
+}
+
+void TimerWheel::TakeSlot() noexcept
+{
+    const unsigned slot = static_cast<unsigned>(cur_ & (kSlots - 1));
+    occupied_[slot / 64] &= ~(std::uint64_t{1} << (slot % 64));
+    const std::uint32_t head = Head(0, slot);
+    std::uint32_t id = nodes_[head].next;
+    nodes_[head].next = head;
+    nodes_[head].prev = head;
+    while (id != head)
+    {
+        const std::uint32_t next = nodes_[id].next;
+        // Метка «снят на срабатывание»: next == kNil, prev == id.
+        nodes_[id].next = kNil;
+        nodes_[id].prev = id;
+        --pending_;
+        batch_.push_back(id);
+        id = next;
+    }
+}
@@ -0,0 +1,180 @@
+#pragma once
+// TimerWheel.hpp — иерархическое колесо таймеров: O(1) постановка и отмена, пакетное срабатывание.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Колесо таймеров в целых тиках (время в тики переводит владелец).
+ *
+ * Четыре уровня по 256 ячеек: уровень k покрывает 256^(k+1) тиков вперёд.
+ * Таймер ставится в ячейку уровня по расстоянию до срока; когда текущий
+ * тик доходит до границы уровня, ячейка старшего уровня раскладывается
+ * на младшие. Постановка и отмена — O(1), срабатывание — пропорционально
+ * числу сработавших таймеров плюс числу пройденных границ (пустые ячейки
+ * уровня 0 перескакиваются по битовой карте). Сроки дальше 2^32 тиков
+ * уходят в самую дальнюю ячейку и раскладываются заново при каскаде.
+ *
+ * Таймеры — узлы с номерами 0..capacity-1, которые раздаёт владелец
+ * (обычно это номер его записи): списки ячеек интрузивны, память
+ * выделяется в конструкторе. Класс не потокобезопасен: синхронизация —
+ * на стороне владельца.
+ */
+class TimerWheel
+{
+public:
+    /// @brief Номер таймера.
+    using Id = std::uint32_t;
+
+    /**
+     * @brief Создать колесо.
+     * @param capacity Число таймеров (номера 0..capacity-1).
+     * @param start    Тик, с которого начинается отсчёт.
+     * @throw std::invalid_argument capacity == 0 или слишком велика.
+     */
+    explicit TimerWheel(std::size_t capacity, std::uint64_t start = 0);
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    /**
+     * @brief Поставить (или переставить) таймер id на тик deadline.
+     *        Срок в прошлом — сработает на ближайшем Advance.
+     */
+    void Schedule(Id id, std::uint64_t deadline) noexcept;
+
+    /**
+     * @brief Снять таймер id (без срабатывания); снятый или не поставленный — ничего.
+     *        Из fire можно снять и таймер, срок которого наступил в том же тике.
+     */
+    void Cancel(Id id) noexcept;
+
+    /** @brief Стоит ли таймер id. */
+    bool Scheduled(Id id) const noexcept { return nodes_[id].next != kNil; }
+
+    /** @brief Срок таймера id (действителен, пока Scheduled). */
+    std::uint64_t Deadline(Id id) const noexcept { return nodes_[id].deadline; }
+
+    /**
+     * @brief Довести время до тика now включительно и вызвать fire(id) для каждого наступившего срока.
+     *
+     * Таймер снимается до вызова fire, так что из fire его можно поставить снова
+     * (и ставить/снимать любые другие). Срок не позже now, поставленный из fire,
+     * сработает в этом же вызове, если его тик ещё не пройден, иначе — в следующем.
+     * Advance из fire не вызывается.
+     * @return Число срабатываний.
+     */
+    template <typename Fire>
+    std::size_t Advance(std::uint64_t now, Fire &&fire);
+
+    /**
+     * @brief Тик ближайшего срока не раньше текущего (UINT64_MAX — таймеров нет).
+     *        Для старших уровней — граница ячейки, то есть оценка снизу.
+     */
+    std::uint64_t NextDeadline() const noexcept;
+
+    /** @brief Следующий необработанный тик. */
+    std::uint64_t Now() const noexcept { return cur_; }
+
+    /** @brief Число поставленных таймеров. */
+    std::size_t Pending() const noexcept { return pending_; }
+
+    /** @brief Число таймеров (номера 0..Capacity()-1). */
+    std::size_t Capacity() const noexcept { return capacity_; }
+
+    /** @brief Память колеса, байт. */
+    std::size_t Memory() const noexcept
+    {
+        return nodes_.capacity() * sizeof(Node) + batch_.capacity() * sizeof(std::uint32_t);
+    }
+
+    /**
+     * @brief Снять все таймеры и начать отсчёт с тика start.
+     */
+    void Reset(std::uint64_t start) noexcept;
+
+private:
+    static constexpr unsigned      kLevels = 4;
+    static constexpr unsigned      kBits   = 8;
+    static constexpr unsigned      kSlots  = 1u << kBits;
+    static constexpr std::uint32_t kNil    = UINT32_MAX;
+
+    /// @brief Узел кольцевого двусвязного списка; ячейки — узлы-заголовки после таймеров.
+    struct Node
+    {
+        std::uint32_t next     = kNil;   ///< kNil — таймер не стоит.
+        std::uint32_t prev     = kNil;
+        std::uint64_t deadline = 0;
+    };
+
+    std::vector<Node>          nodes_;       ///< capacity таймеров, затем kLevels * kSlots заголовков.
+    std::uint64_t              occupied_[kSlots / 64] = {};   ///< Непустые ячейки уровня 0 (бит может устареть после Cancel).
+    std::size_t                capacity_;
+    std::size_t                pending_ = 0;
+    std::uint64_t              cur_;         ///< Следующий необработанный тик.
+    std::vector<std::uint32_t> batch_;       ///< Снятые с ячейки на время срабатывания.
+
+    std::uint32_t Head(unsigned level, unsigned slot) const noexcept
+    {
+        return static_cast<std::uint32_t>(capacity_ + level * kSlots + slot);
+    }
+
+    void Link(std::uint32_t id) noexcept;
+    void Unlink(std::uint32_t id) noexcept;
+
+    /// @brief Разложить ячейки старших уровней, чья граница — тик cur_.
+    void Cascade() noexcept;
+
+    /// @brief Первая возможно непустая ячейка уровня 0 в [from, kSlots) или kSlots.
+    unsigned NextOccupied(unsigned from) const noexcept;
+
+    /// @brief Снять все таймеры ячейки уровня 0 текущего тика в batch_.
+    void TakeSlot() noexcept;
+};
+
+template <typename Fire>
+std::size_t TimerWheel::Advance(std::uint64_t now, Fire &&fire)
+{
+    std::size_t fired = 0;
+    while (cur_ <= now)
+    {
+        if (pending_ == 0)
+        {
+            cur_ = now + 1;
+            break;
+        }
+        // Пустые ячейки уровня 0 до конца оборота или до now перескакиваются.
+        const unsigned slot = static_cast<unsigned>(cur_ & (kSlots - 1));
+        const unsigned next = NextOccupied(slot);
+        const std::uint64_t limit = now - cur_ < kSlots - slot ? now : cur_ + (kSlots - 1 - slot);
+        if (next == kSlots || cur_ + (next - slot) > limit)
+        {
+            cur_ = limit + 1;
+            if ((cur_ & (kSlots - 1)) == 0)
+            {
+                Cascade();
+            }
+            continue;
+        }
+        cur_ += next - slot;
+        TakeSlot();
+        ++cur_;
+        if ((cur_ & (kSlots - 1)) == 0)
+        {
+            Cascade();
+        }
+        for (const std::uint32_t id : batch_)
+        {
+            // Из fire предыдущего таймера этот могли снять или переставить.
+            if (nodes_[id].next == kNil && nodes_[id].prev == id)
+            {
+                nodes_[id].prev = kNil;
+                ++fired;
+                fire(static_cast<Id>(id));
+            }
+        }
+        batch_.clear();
+    }
+    return fired;
+}
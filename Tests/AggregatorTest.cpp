@@ -0,0 +1,323 @@
+// AggregatorTest.cpp — Aggregator: 200 000 пакетов ACK-нагруженного трафика на виртуальных часах — точный
+// обратный разбор (содержимое и порядок по меткам), доля кадров и наибольшее удержание; разбор испорченных
+// кадров Bundle, параметры, Reset.
+
+#include "Core/Aggregator.hpp"
+#include "Core/CoreFrame.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Clock = Aggregator::Clock;
+    using Bytes = std::vector<std::uint8_t>;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    constexpr std::size_t kMtu = 1400;
+
+    /// @brief Пакет на входе сборщика.
+    struct Input
+    {
+        Bytes             data;
+        std::uint64_t     tag = 0;
+        Clock::time_point at;
+    };
+
+    /// @brief Итог прогона.
+    struct Result
+    {
+        bool        exact = true;    ///< Обратный разбор совпал с входом (содержимое и порядок по меткам).
+        bool        bounded = true;  ///< Кадры Bundle не длиннее mtu.
+        bool        stats = true;    ///< Счётчики сходятся с наблюдаемым выходом.
+        std::size_t frames = 0;
+        std::size_t bundles = 0;
+        Clock::duration max_hold{};
+    };
+
+    /**
+     * @brief Трафик: share_small мелких пакетов 40–60 байт (ACK), остальные 200–1400; 2% мелких — служебные
+     * кадры Seq. Интервалы 0–100 мкс; метки 0..tags-1.
+     */
+    std::vector<Input> MakeTraffic(std::mt19937_64 &rng, std::size_t n, unsigned share_small, unsigned tags)
+    {
+        std::vector<Input> in(n);
+        Clock::time_point  now{};
+        std::uint64_t      tag = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            now += std::chrono::microseconds(rng() % 101);
+            if (tags > 1 && rng() % 2 == 0)
+            {
+                tag = rng() % tags;
+            }
+            const bool small = rng() % 100 < share_small;
+            Bytes      p(small ? 40 + rng() % 21 : 200 + rng() % 1201);
+            for (auto &b : p)
+            {
+                b = static_cast<std::uint8_t>(rng());
+            }
+            if (small && rng() % 50 == 0)
+            {
+                CoreFrame::BuildHeader(CoreFrame::Type::Seq, p.size() - CoreFrame::kHeaderSize, p.data());
+            }
+            else
+            {
+                p[0] = rng() % 4 == 0 ? 0x60 : 0x45;
+            }
+            std::memcpy(&p[4], &i, sizeof(std::uint32_t));
+            in[i] = {std::move(p), tag, now};
+        }
+        return in;
+    }
+
+    /**
+     * @brief Прогнать вход через сборщик (Poll до пустого перед каждым Offer, в конце — Flush) и разобрать
+     * выход обратно: Bundle — по пакетам, остальное — пакет целиком.
+     */
+    Result Run(const Aggregator::Options &opts, const std::vector<Input> &in, unsigned tags)
+    {
+        struct Frame
+        {
+            Bytes             data;
+            std::uint64_t     tag = 0;
+            Clock::time_point at;
+        };
+        Aggregator         agg(opts);
+        std::vector<Frame> out;
+        Bytes              buf(std::max(opts.mtu, opts.max_packet));
+        auto drain = [&](Clock::time_point now, bool flush) {
+            for (;;)
+            {
+                std::uint64_t     tag = 0;
+                const std::size_t len = flush ? agg.Flush(buf.data(), buf.size(), &tag)
+                                              : agg.Poll(buf.data(), buf.size(), now, &tag);
+                if (len == 0)
+                {
+                    return;
+                }
+                out.push_back({Bytes(buf.begin(), buf.begin() + static_cast<std::ptrdiff_t>(len)), tag, now});
+            }
+        };
+        for (const Input &p : in)
+        {
+            drain(p.at, false);
+            if (!agg.Offer(p.data.data(), p.data.size(), p.at, p.tag))
+            {
+                out.push_back({p.data, p.tag, p.at});
+            }
+        }
+        drain(in.empty() ? Clock::time_point{} : in.back().at, true);
+
+        Result r;
+        r.frames = out.size();
+        // Очередь входа по метке: каждый разобранный пакет — голова очереди своей метки.
+        std::vector<std::deque<std::size_t>> queues(tags);
+        for (std::size_t i = 0; i < in.size(); ++i)
+        {
+            queues[in[i].tag].push_back(i);
+        }
+        auto take = [&](const Frame &f, const std::uint8_t *pkt, std::size_t len) {
+            auto &q = queues[f.tag];
+            if (q.empty() || in[q.front()].data.size() != len || std::memcmp(in[q.front()].data.data(), pkt, len) != 0)
+            {
+                r.exact = false;
+                return;
+            }
+            r.max_hold = std::max(r.max_hold, f.at - in[q.front()].at);
+            q.pop_front();
+        };
+        for (const Frame &f : out)
+        {
+            const bool bundle = Aggregator::Unbundle(f.data.data(), f.data.size(),
+                                                     [&](const std::uint8_t *pkt, std::size_t len) { take(f, pkt, len); });
+            if (bundle)
+            {
+                ++r.bundles;
+                r.bounded &= f.data.size() <= opts.mtu;
+            }
+            else
+            {
+                take(f, f.data.data(), f.data.size());
+            }
+        }
+        for (const auto &q : queues)
+        {
+            r.exact &= q.empty();
+        }
+
+        const Aggregator::Stats &s = agg.GetStats();
+        r.stats = s.packets == in.size() && s.frames == out.size() && s.bundles == r.bundles &&
+                  s.bundled + s.singles + s.passthrough == s.packets &&
+                  s.bundles + s.singles + s.passthrough == s.frames && !agg.Pending();
+        return r;
+    }
+
+    /// @brief 200 000 пакетов, 85% ACK, mtu 1400, срок 500 мкс: точный обратный разбор, кадров меньше 40%.
+    void TestAckTraffic(std::mt19937_64 &rng)
+    {
+        Aggregator::Options opts;
+        opts.mtu = kMtu;
+        const std::vector<Input> in = MakeTraffic(rng, 200000, 85, 1);
+        const Result r = Run(opts, in, 1);
+        Expect(r.exact, "ack: exact round trip");
+        Expect(r.bounded, "ack: bundles fit the mtu");
+        Expect(r.stats, "ack: stats match the output");
+        Expect(r.frames * 100 < in.size() * 40, "ack: fewer than 40% frames per packet");
+        // Poll зовётся перед каждым пакетом: удержание — не больше срока и одного интервала.
+        Expect(r.max_hold <= opts.max_delay + 100us, "ack: hold bounded by max_delay plus one poll gap");
+        Expect(r.max_hold > opts.max_delay / 2, "ack: packets actually held");
+    }
+
+    /// @brief Четыре метки вперемешку, мелкие и крупные: пакеты разных меток в один кадр не попадают.
+    void TestTags(std::mt19937_64 &rng)
+    {
+        Aggregator::Options opts;
+        opts.mtu      = kMtu;
+        opts.max_item = 128;
+        const std::vector<Input> in = MakeTraffic(rng, 50000, 60, 4);
+        const Result r = Run(opts, in, 4);
+        Expect(r.exact, "tags: exact round trip per tag");
+        Expect(r.bounded && r.stats, "tags: bundles fit, stats match");
+        Expect(r.bundles > 1000, "tags: bundles formed");
+    }
+
+    /// @brief Нулевой срок: пакет уходит с ближайшим Poll; mtu на пределе двух пакетов.
+    void TestLimits(std::mt19937_64 &rng)
+    {
+        Aggregator::Options opts;
+        opts.mtu       = kMtu;
+        opts.max_delay = 0us;
+        const std::vector<Input> in = MakeTraffic(rng, 20000, 85, 1);
+        const Result r = Run(opts, in, 1);
+        Expect(r.exact && r.bounded && r.stats, "limits: zero delay round trip");
+        Expect(r.max_hold <= 100us, "limits: zero delay holds one poll gap at most");
+
+        opts.max_delay = 500us;
+        opts.max_item  = 60;
+        opts.mtu       = CoreFrame::kHeaderSize + 2 * (Aggregator::kItemHeaderSize + opts.max_item);
+        const Result tight = Run(opts, MakeTraffic(rng, 20000, 85, 1), 1);
+        Expect(tight.exact && tight.bounded && tight.stats, "limits: two-item mtu round trip");
+    }
+
+    /// @brief Испорченные кадры Bundle отвергаются целиком, fn не зовётся.
+    void TestUnbundle()
+    {
+        auto frame = [](const Bytes &payload, CoreFrame::Type type) {
+            Bytes f(CoreFrame::kHeaderSize + payload.size());
+            CoreFrame::BuildHeader(type, payload.size(), f.data());
+            std::copy(payload.begin(), payload.end(), f.begin() + CoreFrame::kHeaderSize);
+            return f;
+        };
+        std::size_t calls = 0;
+        auto count = [&calls](const std::uint8_t *, std::size_t) { ++calls; };
+
+        const Bytes good = {0, 3, 0x45, 1, 2, 0, 1, 0x60, 0, 2, 0xF0, 4};
+        Expect(Aggregator::Unbundle(frame(good, CoreFrame::Type::Bundle).data(), good.size() + 4, count) && calls == 3,
+               "unbundle: valid frame of three items");
+
+        Bytes nested = good;
+        const Bytes inner = frame({0, 1, 0x45}, CoreFrame::Type::Bundle);
+        nested.push_back(0);
+        nested.push_back(static_cast<std::uint8_t>(inner.size()));
+        nested.insert(nested.end(), inner.begin(), inner.end());
+        const Bytes bad[] = {
+            {0, 4, 0x45, 1, 2},          // длина пакета за концом
+            {0, 0, 0, 1, 0x45},          // пакет нулевой длины
+            {0, 1, 0x45, 0},             // обрывок длины
+            nested,                      // вложенный Bundle
+        };
+        calls = 0;
+        for (const Bytes &p : bad)
+        {
+            const Bytes f = frame(p, CoreFrame::Type::Bundle);
+            Expect(!Aggregator::Unbundle(f.data(), f.size(), count), "unbundle: malformed frame rejected");
+        }
+        const Bytes seq = frame(good, CoreFrame::Type::Seq);
+        Expect(!Aggregator::Unbundle(seq.data(), seq.size(), count), "unbundle: other frame type rejected");
+        Expect(!Aggregator::Unbundle(good.data(), good.size(), count), "unbundle: not a core frame");
+        const Bytes whole = frame(good, CoreFrame::Type::Bundle);
+        Expect(!Aggregator::Unbundle(whole.data(), whole.size() - 1, count), "unbundle: truncated frame");
+        Expect(calls == 0, "unbundle: fn never called for a rejected frame");
+    }
+
+    void TestOptionsAndReset()
+    {
+        auto invalid = [](const Aggregator::Options &o) {
+            try
+            {
+                Aggregator a(o);
+            }
+            catch (const std::invalid_argument &)
+            {
+                return true;
+            }
+            return false;
+        };
+        Aggregator::Options o;
+        o.max_item = 0;
+        Expect(invalid(o), "options: zero max_item");
+        o = {};
+        o.max_packet = o.max_item - 1;
+        Expect(invalid(o), "options: max_packet below max_item");
+        o = {};
+        o.mtu = CoreFrame::kHeaderSize + 0x10000;
+        o.max_packet = o.mtu;
+        Expect(invalid(o), "options: mtu above the BE16 payload");
+        o = {};
+        o.mtu = CoreFrame::kHeaderSize + 2 * (Aggregator::kItemHeaderSize + o.max_item) - 1;
+        Expect(invalid(o), "options: mtu below two items");
+        o = {};
+        o.max_delay = -1us;
+        Expect(invalid(o), "options: negative delay");
+
+        Aggregator agg(Aggregator::Options{});
+        Bytes p(50, 0x45);
+        const Clock::time_point t{};
+        Expect(agg.Offer(p.data(), p.size(), t) && agg.Offer(p.data(), p.size(), t), "reset: small packets held");
+        Expect(agg.Pending() && agg.Deadline() == t + 500us, "reset: pending with deadline");
+        Bytes out(1500);
+        Expect(agg.Poll(out.data(), out.size(), t + 499us) == 0, "reset: nothing before the deadline");
+        agg.Reset();
+        Expect(!agg.Pending() && agg.Deadline() == Clock::time_point::max(), "reset: nothing pending");
+        Expect(agg.Flush(out.data(), out.size()) == 0, "reset: held packets dropped");
+        Expect(!agg.Offer(p.data(), 0, t), "reset: empty packet passes through");
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(68);
+    TestAckTraffic(rng);
+    TestTags(rng);
+    TestLimits(rng);
+    TestUnbundle();
+    TestOptionsAndReset();
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("Aggregator: OK\n");
+    return EXIT_SUCCESS;
+}
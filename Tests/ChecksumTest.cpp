@@ -0,0 +1,125 @@
+// ChecksumTest.cpp — реализации Checksum::Sum (scalar, SSE2, AVX2, NEON) против побайтового эталона.
+
+#include "Core/Checksum.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+    int failures = 0;
+
+    void Expect(bool ok, const char *impl, const char *what, std::size_t len, std::size_t offset)
+    {
+        if (!ok && ++failures <= 20)
+        {
+            std::fprintf(stderr, "FAIL: %s: %s (len=%zu offset=%zu)\n", impl, what, len, offset);
+        }
+    }
+
+    /// @brief Реализации, которые сверяются; не собранные здесь или без поддержки процессора пропускаются.
+    constexpr const char *kImplementations[] = {"scalar", "sse2", "avx2", "neon"};
+
+    /**
+     * @brief Случайные длины и выравнивания, нечётные хвосты и initial.
+     */
+    void TestRandom(const char *name, Checksum::SumFn sum, const std::vector<std::uint8_t> &buf, std::mt19937_64 &rng)
+    {
+        // Все длины до нескольких векторов подряд — каждая ветка хвоста; дальше — случайные.
+        for (std::size_t len = 0; len < 600; ++len)
+        {
+            for (std::size_t offset = 0; offset < 64; offset += 1 + len % 7)
+            {
+                const auto initial = static_cast<std::uint32_t>(rng() & 0xFFFF);
+                Expect(Checksum::Add(sum(buf.data() + offset, len), initial) ==
+                           Checksum::Reference(buf.data() + offset, len, initial),
+                       name, "short buffer", len, offset);
+            }
+        }
+        for (int i = 0; i < 20000; ++i)
+        {
+            const std::size_t len    = rng() % 9100;
+            const std::size_t offset = rng() % 64;
+            Expect(sum(buf.data() + offset, len) == Checksum::Reference(buf.data() + offset, len),
+                   name, "random buffer", len, offset);
+        }
+    }
+
+    /**
+     * @brief Буферы длиннее kLaneIterations итераций вектора: полосы расширяются, не переполняясь.
+     *
+     * Из одних 0xFF каждое слово — наибольшее: переполнение 32-битной полосы видно сразу.
+     */
+    void TestLarge(const char *name, Checksum::SumFn sum, const std::vector<std::uint8_t> &buf)
+    {
+        const std::vector<std::uint8_t> ones(buf.size(), 0xFF);
+        for (const std::vector<std::uint8_t> *v : {&buf, &ones})
+        {
+            for (const std::size_t offset : {std::size_t{0}, std::size_t{1}, std::size_t{3}})
+            {
+                const std::size_t len = v->size() - 4;
+                Expect(sum(v->data() + offset, len) == Checksum::Reference(v->data() + offset, len),
+                       name, v == &ones ? "large buffer of 0xFF" : "large buffer", len, offset);
+            }
+        }
+    }
+
+    /// @brief Sum (выбранная реализация и порог по длине) и суммы кусков через Add и Swap.
+    void TestDispatch(const std::vector<std::uint8_t> &buf, std::mt19937_64 &rng)
+    {
+        for (int i = 0; i < 20000; ++i)
+        {
+            const std::size_t len   = rng() % 3000;
+            const std::size_t split = rng() % (len + 1);
+            const auto initial = static_cast<std::uint32_t>(rng() & 0xFFFF);
+            Expect(Checksum::Sum(buf.data(), len, initial) == Checksum::Reference(buf.data(), len, initial),
+                   Checksum::Backend(), "Sum", len, 0);
+
+            std::uint32_t tail = Checksum::Sum(buf.data() + split, len - split);
+            if (split % 2 != 0)
+            {
+                tail = Checksum::Swap(tail);
+            }
+            Expect(Checksum::Add(Checksum::Sum(buf.data(), split), tail) == Checksum::Reference(buf.data(), len),
+                   Checksum::Backend(), "split sum", len, split);
+        }
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(71);
+    // Больше kLaneIterations * 32 байт: большие буферы проходят расширение полос несколько раз.
+    std::vector<std::uint8_t> buf((std::size_t{3} << 20) + 64);
+    for (std::uint8_t &b : buf)
+    {
+        b = static_cast<std::uint8_t>(rng());
+    }
+
+    for (const char *name : kImplementations)
+    {
+        const Checksum::SumFn sum = Checksum::Implementation(name);
+        if (!sum)
+        {
+            std::printf("%-6s skipped (not available here)\n", name);
+            continue;
+        }
+        const int before = failures;
+        TestRandom(name, sum, buf, rng);
+        TestLarge(name, sum, buf);
+        std::printf("%-6s %s\n", name, failures == before ? "OK" : "FAILED");
+    }
+    TestDispatch(buf, rng);
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("Checksum: OK (backend %s)\n", Checksum::Backend());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,416 @@
+// FecTest.cpp — FEC: арифметика GF(2^8) против побайтового эталона, избыточные символы кодера против
+// матрицы Коши, восстановление до m потерь, дубликаты и опоздавшие, некорректные заголовки и мусор на входе.
+
+#include "Core/CoreFrame.hpp"
+#include "Core/Fec.hpp"
+#include "Core/Gf256.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Clock = FecDecoder::Clock;
+    using Bytes = std::vector<std::uint8_t>;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    constexpr std::size_t kMtu = 1400;
+
+    /// @brief Произведение в GF(2^8) по определению: сложение со сдвигом и приведение по 0x11D.
+    std::uint8_t SlowMul(std::uint8_t a, std::uint8_t b)
+    {
+        unsigned r = 0;
+        unsigned x = a;
+        for (unsigned y = b; y != 0; y >>= 1)
+        {
+            if (y & 1u)
+            {
+                r ^= x;
+            }
+            x <<= 1;
+            if (x & 0x100u)
+            {
+                x ^= 0x11Du;
+            }
+        }
+        return static_cast<std::uint8_t>(r);
+    }
+
+    /// @brief Mul и Inv — по определению; MulAdd выбранной реализации — против Mul на всех длинах хвоста.
+    void TestField(std::mt19937_64 &rng)
+    {
+        bool mul_ok = true;
+        bool inv_ok = true;
+        for (unsigned a = 0; a < 256; ++a)
+        {
+            for (unsigned b = 0; b < 256; ++b)
+            {
+                mul_ok = mul_ok && Gf256::Mul(static_cast<std::uint8_t>(a), static_cast<std::uint8_t>(b)) ==
+                                       SlowMul(static_cast<std::uint8_t>(a), static_cast<std::uint8_t>(b));
+            }
+            inv_ok = inv_ok && (a == 0 || Gf256::Mul(static_cast<std::uint8_t>(a),
+                                                     Gf256::Inv(static_cast<std::uint8_t>(a))) == 1);
+        }
+        Expect(mul_ok, "field: Mul matches the definition");
+        Expect(inv_ok, "field: a * Inv(a) == 1");
+
+        bool muladd_ok = true;
+        for (std::size_t len = 0; len < 300; ++len)
+        {
+            Bytes src(len + 3), dst(len + 3), want;
+            for (std::uint8_t &b : src)
+            {
+                b = static_cast<std::uint8_t>(rng());
+            }
+            for (std::uint8_t &b : dst)
+            {
+                b = static_cast<std::uint8_t>(rng());
+            }
+            const auto c      = static_cast<std::uint8_t>(rng());
+            const std::size_t offset = len % 3;
+            want = dst;
+            for (std::size_t i = 0; i < len; ++i)
+            {
+                want[offset + i] ^= SlowMul(c, src[offset + i]);
+            }
+            Gf256::MulAdd(dst.data() + offset, src.data() + offset, c, len);
+            muladd_ok = muladd_ok && dst == want;
+        }
+        Expect(muladd_ok, "field: MulAdd matches the reference");
+    }
+
+    /// @brief Случайный пакет длиной 1..max.
+    Bytes RandomPacket(std::mt19937_64 &rng, std::size_t max)
+    {
+        Bytes p(1 + rng() % max);
+        for (std::uint8_t &b : p)
+        {
+            b = static_cast<std::uint8_t>(rng());
+        }
+        return p;
+    }
+
+    /**
+     * @brief Блок кодера: k исходных кадров и m избыточных.
+     */
+    struct Block
+    {
+        std::vector<Bytes> packets;   ///< Исходные пакеты.
+        std::vector<Bytes> frames;    ///< Кадры Fec: сначала исходные, затем избыточные.
+    };
+
+    Block Encode(FecEncoder &enc, unsigned k, std::mt19937_64 &rng, Clock::time_point now)
+    {
+        Block b;
+        // Избыточный символ длиннее самого длинного пакета на два байта длины.
+        std::uint8_t buf[CoreFrame::kFecHeaderSize + kMtu + 2];
+        for (unsigned i = 0; i < k; ++i)
+        {
+            b.packets.push_back(RandomPacket(rng, rng() % 4 == 0 ? kMtu : 200));
+            std::memcpy(buf, b.packets.back().data(), b.packets.back().size());
+            const std::size_t n = enc.Protect(buf, b.packets.back().size(), sizeof(buf), now);
+            b.frames.emplace_back(buf, buf + n);
+        }
+        while (const std::size_t n = enc.Poll(buf, sizeof(buf), now))
+        {
+            b.frames.emplace_back(buf, buf + n);
+        }
+        return b;
+    }
+
+    /// @brief Нагрузка кадра (без заголовка CoreFrame).
+    bool Push(FecDecoder &dec, const Bytes &frame, Clock::time_point now)
+    {
+        return dec.Push(frame.data() + CoreFrame::kHeaderSize, frame.size() - CoreFrame::kHeaderSize, now);
+    }
+
+    FecEncoder::Options EncoderOptions(unsigned k, unsigned m)
+    {
+        FecEncoder::Options o;
+        o.k     = k;
+        o.min_m = m;
+        o.max_m = m;
+        o.mtu   = kMtu;
+        return o;
+    }
+
+    FecDecoder::Options DecoderOptions(unsigned k, unsigned m)
+    {
+        FecDecoder::Options o;
+        o.max_k = k;
+        o.max_m = m;
+        o.mtu   = kMtu;
+        return o;
+    }
+
+    /**
+     * @brief Избыточный символ j = сумма Mul(1 / ((0x80 + j) ^ i), символ i) побайтово,
+     * символ i — [длина BE16][пакет], дополненный нулями до самого длинного.
+     */
+    void TestRepairSymbols(std::mt19937_64 &rng)
+    {
+        for (const auto &[k, m] : {std::pair{1u, 1u}, std::pair{5u, 3u}, std::pair{64u, 32u}})
+        {
+            FecEncoder enc(EncoderOptions(k, m));
+            const Block b = Encode(enc, k, rng, Clock::time_point{} + 1s);
+            if (b.frames.size() != k + m)
+            {
+                Expect(false, "repair: k sources and m repairs per block");
+                continue;
+            }
+
+            std::size_t sym_len = 0;
+            for (const Bytes &p : b.packets)
+            {
+                sym_len = std::max(sym_len, p.size() + 2);
+            }
+            bool ok = true;
+            for (unsigned j = 0; j < m && ok; ++j)
+            {
+                const Bytes &f = b.frames[k + j];
+                const std::uint8_t *hdr = f.data() + CoreFrame::kHeaderSize;
+                ok = f.size() == CoreFrame::kFecHeaderSize + sym_len && hdr[4] == (0x80 | j) && hdr[5] == k &&
+                     hdr[6] == m;
+                for (std::size_t x = 0; x < sym_len && ok; ++x)
+                {
+                    std::uint8_t want = 0;
+                    for (unsigned i = 0; i < k; ++i)
+                    {
+                        const Bytes &p = b.packets[i];
+                        const std::uint8_t s = x == 0 ? static_cast<std::uint8_t>(p.size() >> 8)
+                                             : x == 1 ? static_cast<std::uint8_t>(p.size())
+                                             : x - 2 < p.size() ? p[x - 2] : 0;
+                        want ^= SlowMul(Gf256::Inv(static_cast<std::uint8_t>((0x80u + j) ^ i)), s);
+                    }
+                    ok = f[CoreFrame::kFecHeaderSize + x] == want;
+                }
+            }
+            Expect(ok, "repair: encoder symbols match the Cauchy reference");
+        }
+    }
+
+    /**
+     * @brief До m потерь любых символов блока в любом порядке — блок восстанавливается целиком;
+     * m + 1 потерянных исходных — пакеты учитываются как невосстановленные.
+     */
+    void TestRecovery(std::mt19937_64 &rng)
+    {
+        for (const auto &[k, m] : {std::pair{1u, 1u}, std::pair{4u, 2u}, std::pair{10u, 4u}, std::pair{20u, 8u},
+                                  std::pair{64u, 32u}})
+        {
+            FecEncoder enc(EncoderOptions(k, m));
+            std::vector<Bytes> delivered;
+            FecDecoder dec(DecoderOptions(k, m), [&](const std::uint8_t *p, std::size_t n) { delivered.emplace_back(p, p + n); });
+
+            bool ok = true;
+            std::uint64_t lost_sources = 0;
+            Clock::time_point now = Clock::time_point{} + 1s;
+            for (int trial = 0; trial < 200; ++trial, now += 1ms)
+            {
+                Block b = Encode(enc, k, rng, now);
+                std::vector<unsigned> order(b.frames.size());
+                for (unsigned i = 0; i < order.size(); ++i)
+                {
+                    order[i] = i;
+                }
+                std::shuffle(order.begin(), order.end(), rng);
+                const auto lost = static_cast<unsigned>(rng() % (m + 1));
+                for (unsigned x = 0; x < lost; ++x)
+                {
+                    lost_sources += order[x] < k ? 1u : 0u;
+                }
+                delivered.clear();
+                for (unsigned x = lost; x < order.size(); ++x)
+                {
+                    ok = ok && Push(dec, b.frames[order[x]], now);
+                }
+                std::sort(delivered.begin(), delivered.end());
+                std::sort(b.packets.begin(), b.packets.end());
+                ok = ok && delivered == b.packets;
+            }
+            Expect(ok, "recovery: every block with up to m losses is delivered intact");
+            // Блок восстанавливается, как только хватает символов: пакет, пришедший после, — дубликат.
+            const FecDecoder::Stats &st = dec.GetStats();
+            Expect(st.recovered == lost_sources + st.duplicates, "recovery: recovered counter");
+            Expect(st.malformed == 0 && st.unrecovered == 0, "recovery: no false errors");
+
+            // m + 1 исходных потеряно: восстанавливать нечем, блок закрывается по hold.
+            if (k > m)
+            {
+                const std::uint64_t before = dec.GetStats().unrecovered;
+                const Block b = Encode(enc, k, rng, now);
+                for (std::size_t x = m + 1; x < b.frames.size(); ++x)
+                {
+                    Push(dec, b.frames[x], now);
+                }
+                std::uint8_t report[64];
+                dec.Poll(report, sizeof(report), now + 1s);
+                Expect(dec.GetStats().unrecovered - before == m + 1, "recovery: m + 1 losses counted as unrecovered");
+            }
+        }
+    }
+
+    /**
+     * @brief Дубликаты не выдаются повторно; символы блока, вышедшего из окна, — опоздавшие:
+     * исходный пакет отдаётся без защиты, избыточный символ отбрасывается.
+     */
+    void TestDuplicatesAndLate(std::mt19937_64 &rng)
+    {
+        FecEncoder enc(EncoderOptions(4, 2));
+        std::size_t delivered = 0;
+        FecDecoder::Options o = DecoderOptions(4, 2);
+        o.blocks = 4;
+        FecDecoder dec(o, [&](const std::uint8_t *, std::size_t) { ++delivered; });
+
+        const Clock::time_point now = Clock::time_point{} + 1s;
+        std::vector<Block> blocks;
+        for (int i = 0; i < 10; ++i)
+        {
+            blocks.push_back(Encode(enc, 4, rng, now));
+        }
+
+        Expect(Push(dec, blocks[0].frames[0], now) && delivered == 1, "duplicates: first copy delivered");
+        Expect(Push(dec, blocks[0].frames[0], now) && delivered == 1, "duplicates: second copy dropped");
+        Expect(Push(dec, blocks[0].frames[4], now) && Push(dec, blocks[0].frames[4], now), "duplicates: repair twice");
+        Expect(dec.GetStats().duplicates == 2, "duplicates: counted");
+
+        // Восстановленный пакет, пришедший следом, — тоже дубликат.
+        Push(dec, blocks[0].frames[1], now);
+        Push(dec, blocks[0].frames[2], now);
+        Expect(delivered == 4 && dec.GetStats().recovered == 1, "duplicates: missing source recovered");
+        Expect(Push(dec, blocks[0].frames[3], now) && delivered == 4 && dec.GetStats().duplicates == 3,
+               "duplicates: late copy of a recovered packet dropped");
+
+        // Окно — 4 блока: блок 9 выталкивает блок 0 и всё, что старше 5.
+        Push(dec, blocks[9].frames[0], now);
+        const std::size_t before = delivered;
+        Expect(Push(dec, blocks[1].frames[0], now) && delivered == before + 1, "late: source delivered unprotected");
+        Expect(Push(dec, blocks[1].frames[4], now) && delivered == before + 1, "late: repair dropped");
+        Expect(dec.GetStats().late == 2, "late: counted");
+    }
+
+    /**
+     * @brief Некорректные заголовки: malformed растёт, Push возвращает false, ничего не выдаётся.
+     */
+    void TestMalformed(std::mt19937_64 &rng)
+    {
+        FecEncoder enc(EncoderOptions(4, 2));
+        std::size_t delivered = 0;
+        FecDecoder dec(DecoderOptions(4, 2), [&](const std::uint8_t *, std::size_t) { ++delivered; });
+        const Clock::time_point now = Clock::time_point{} + 1s;
+        const Block b = Encode(enc, 4, rng, now);
+
+        std::uint64_t expected = 0;
+        const auto reject = [&](Bytes frame, const char *what)
+        {
+            const bool accepted = Push(dec, frame, now);
+            Expect(!accepted && dec.GetStats().malformed == ++expected && delivered == 0, what);
+        };
+        const auto with = [&](const Bytes &frame, std::size_t at, std::uint8_t v)
+        {
+            Bytes f = frame;
+            f[CoreFrame::kHeaderSize + at] = v;
+            return f;
+        };
+
+        reject(Bytes(b.frames[0].begin(), b.frames[0].begin() + CoreFrame::kFecHeaderSize), "malformed: no data");
+        reject(Bytes(b.frames[0].begin(), b.frames[0].begin() + CoreFrame::kHeaderSize + 3), "malformed: truncated header");
+        reject(with(b.frames[0], 5, 0), "malformed: source with k = 0");
+        reject(with(b.frames[2], 5, 2), "malformed: source index >= k");
+        reject(with(b.frames[0], 5, FecEncoder::kMaxSources + 1), "malformed: source k beyond the format");
+        reject(with(b.frames[0], 6, FecEncoder::kMaxRepairs + 1), "malformed: source m beyond the format");
+        reject(with(b.frames[4], 5, 0), "malformed: repair with k = 0");
+        reject(with(b.frames[4], 5, 5), "malformed: repair with k > max_k");
+        reject(with(b.frames[4], 6, 3), "malformed: repair with m > max_m");
+        reject(with(b.frames[4], 4, 0x82), "malformed: repair index >= m");
+
+        Bytes big(CoreFrame::kFecHeaderSize + kMtu + 3, 0);
+        std::memcpy(big.data(), b.frames[4].data(), CoreFrame::kFecHeaderSize);
+        reject(big, "malformed: repair longer than a symbol");
+        reject(Bytes(b.frames[4].begin(), b.frames[4].begin() + CoreFrame::kFecHeaderSize + 1), "malformed: repair of 1 byte");
+
+        // Длина второго избыточного символа блока не совпадает с первым.
+        Expect(Push(dec, b.frames[4], now), "malformed: first repair accepted");
+        Bytes shorter(b.frames[5].begin(), b.frames[5].end() - 1);
+        reject(shorter, "malformed: repair length mismatch");
+        // k второго символа — другое, чем у первого.
+        reject(with(b.frames[5], 5, 3), "malformed: repair k mismatch");
+    }
+
+    /**
+     * @brief Мусор: случайные искажения настоящих кадров. Декодер не выходит за буферы (проверяется
+     * под ASan) и не выдаёт пакетов длиннее MTU.
+     */
+    void TestFuzz(std::mt19937_64 &rng)
+    {
+        FecEncoder enc(EncoderOptions(8, 4));
+        bool ok = true;
+        FecDecoder dec(DecoderOptions(8, 4), [&](const std::uint8_t *, std::size_t n) { ok = ok && n <= kMtu; });
+
+        Clock::time_point now = Clock::time_point{} + 1s;
+        for (int round = 0; round < 3000; ++round, now += 1ms)
+        {
+            const Block b = Encode(enc, 8, rng, now);
+            for (const Bytes &frame : b.frames)
+            {
+                Bytes f(frame.begin() + CoreFrame::kHeaderSize, frame.end());
+                switch (rng() % 4)
+                {
+                    case 0:
+                        f.resize(rng() % (f.size() + 1));
+                        break;
+                    case 1:
+                        f[rng() % std::min<std::size_t>(f.size(), 7)] = static_cast<std::uint8_t>(rng());
+                        break;
+                    case 2:
+                        f[rng() % f.size()] ^= static_cast<std::uint8_t>(1u << (rng() % 8));
+                        break;
+                    default:
+                        break;
+                }
+                dec.Push(f.data(), f.size(), now);
+            }
+            std::uint8_t report[64];
+            dec.Poll(report, sizeof(report), now);
+        }
+        Expect(ok, "fuzz: no delivered packet longer than the MTU");
+        Expect(dec.GetStats().malformed > 0, "fuzz: corrupted frames rejected");
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(60);
+    TestField(rng);
+    TestRepairSymbols(rng);
+    TestRecovery(rng);
+    TestDuplicatesAndLate(rng);
+    TestMalformed(rng);
+    TestFuzz(rng);
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("Fec: OK (GF(2^8) backend %s)\n", Gf256::Backend());
+    return EXIT_SUCCESS;
+}
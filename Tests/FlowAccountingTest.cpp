@@ -0,0 +1,461 @@
+// FlowAccountingTest.cpp — учёт потоков на синтетическом трафике: точные суммы и 1-из-N, шторм
+// вытеснений (записи сессий и общая запись), истечение простоя, разбор выгрузок IPFIX и CSV.
+
+#include "Core/FlowAccounting.hpp"
+#include "Core/Headers.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Clock     = FlowAccounting::Clock;
+    using Direction = FlowAccounting::Direction;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    /// @brief Суммы по (сессия, направление).
+    using Totals = std::map<std::pair<std::uint64_t, Direction>, std::pair<std::uint64_t, std::uint64_t>>;
+
+    /**
+     * @brief UDP/IPv4 от 10.(session).x.y:sport к 192.0.2.1:53; длина — из len.
+     */
+    std::vector<std::uint8_t> MakePacket(std::uint64_t session, std::uint32_t flow, std::size_t len)
+    {
+        std::vector<std::uint8_t> p(len, 0);
+        p[0] = 0x45;
+        Headers::Store16(p.data() + 2, static_cast<std::uint16_t>(len));
+        p[8] = 64;
+        p[9] = Headers::kProtoUdp;
+        p[12] = 10;
+        p[13] = static_cast<std::uint8_t>(session);
+        p[14] = static_cast<std::uint8_t>(flow >> 8);
+        p[15] = static_cast<std::uint8_t>(flow);
+        p[16] = 192;
+        p[18] = 2;
+        p[19] = 1;
+        Headers::Store16(p.data() + 20, static_cast<std::uint16_t>(1024 + flow % 50000));
+        Headers::Store16(p.data() + 22, 53);
+        Headers::Store16(p.data() + 24, static_cast<std::uint16_t>(len - 20));
+        return p;
+    }
+
+    /**
+     * @brief Синтетический трафик: sessions сессий, у каждой flows потоков в обе стороны.
+     * @param totals Истинные суммы по сессиям и направлениям.
+     * @param drain  Сколько пакетов между выгрузками (0 — выгрузка только в конце).
+     * @return Суммы по выгруженным записям.
+     */
+    Totals Run(FlowAccounting &acct, std::size_t packets, std::uint64_t sessions, std::uint32_t flows,
+               std::size_t drain, Totals &totals, std::vector<FlowAccounting::Record> *records = nullptr)
+    {
+        std::mt19937_64 rng(66);
+        Totals got;
+        const auto collect = [&](const FlowAccounting::Record &r)
+        {
+            auto &t = got[{r.session, r.dir}];
+            t.first  += r.packets;
+            t.second += r.bytes;
+            if (records)
+            {
+                records->push_back(r);
+            }
+        };
+
+        Clock::time_point now = Clock::time_point{} + 1s;
+        for (std::size_t i = 0; i < packets; ++i)
+        {
+            const std::uint64_t session = 1 + rng() % sessions;
+            const auto          flow    = static_cast<std::uint32_t>(rng() % flows);
+            const Direction     dir     = flow % 2 == 0 ? Direction::Upstream : Direction::Downstream;
+            const std::size_t   len     = 28 + rng() % 1400;
+            const std::vector<std::uint8_t> p = MakePacket(session, flow, len);
+            acct.Account(p.data(), p.size(), session, dir, now);
+            auto &t = totals[{session, dir}];
+            ++t.first;
+            t.second += len;
+            now += 10us;
+            if (drain != 0 && (i + 1) % drain == 0)
+            {
+                acct.Drain(now, collect);
+            }
+        }
+        acct.Drain(now, collect, true);
+        return got;
+    }
+
+    void Sum(const Totals &t, std::uint64_t &packets, std::uint64_t &bytes)
+    {
+        packets = bytes = 0;
+        for (const auto &[k, v] : t)
+        {
+            packets += v.first;
+            bytes   += v.second;
+        }
+    }
+
+    /**
+     * @brief Точный учёт с штормом вытеснений: суммы — точные и по каждой сессии.
+     *
+     * 50 сессий по 4000 потоков на 2000 мест таблицы: почти каждый пакет вытесняет поток.
+     * Итоговых записей на выгрузку — 256, мест для записей сессий хватает на все 50 сессий.
+     */
+    void TestExactEvictionStorm()
+    {
+        FlowAccounting::Options o;
+        o.capacity = 2000;
+        o.retired  = 256;
+        o.seed     = 1;
+        FlowAccounting acct(o);
+
+        Totals truth;
+        std::vector<FlowAccounting::Record> records;
+        const Totals got = Run(acct, 1000000, 50, 4000, 100000, truth, &records);
+
+        Expect(got == truth, "exact: per-session totals");
+        Expect(acct.GetStats().seen == 1000000 && acct.GetStats().sampled == 1000000, "exact: every packet sampled");
+        Expect(acct.GetStats().folded > 0, "exact: eviction storm folds retired flows into session records");
+        Expect(acct.GetStats().lumped == 0, "exact: no lumped records while session slots last");
+        Expect(acct.GetStats().records == records.size(), "exact: records counter");
+
+        bool keyless_ok = true;
+        bool evicted    = false;
+        for (const FlowAccounting::Record &r : records)
+        {
+            const bool keyless = r.key == FlowTable::Key{};
+            if (keyless && (r.session == 0 || r.end != FlowAccounting::End::Evicted))
+            {
+                keyless_ok = false;
+            }
+            evicted = evicted || (!keyless && r.end == FlowAccounting::End::Evicted);
+        }
+        Expect(keyless_ok, "exact: folded records carry the session and End::Evicted");
+        Expect(evicted, "exact: evicted flows are reported with their key while the buffer lasts");
+    }
+
+    /**
+     * @brief Мест для записей сессий нет: остаток сливается в общую запись направления, суммы целы.
+     */
+    void TestLumped()
+    {
+        FlowAccounting::Options o;
+        o.capacity = 256;
+        o.retired  = 1;   // и два места для записей сессий
+        o.seed     = 2;
+        FlowAccounting acct(o);
+
+        Totals truth;
+        std::vector<FlowAccounting::Record> records;
+        const Totals got = Run(acct, 200000, 40, 2000, 0, truth, &records);
+
+        std::uint64_t want_packets = 0, want_bytes = 0, got_packets = 0, got_bytes = 0;
+        Sum(truth, want_packets, want_bytes);
+        Sum(got, got_packets, got_bytes);
+        Expect(got_packets == want_packets && got_bytes == want_bytes, "lumped: totals are never lost");
+        Expect(acct.GetStats().lumped > 0, "lumped: overflow reaches the per-direction lump");
+
+        std::size_t lumps[2] = {};
+        for (const FlowAccounting::Record &r : records)
+        {
+            if (r.session == 0)
+            {
+                Expect(r.key == FlowTable::Key{} && r.end == FlowAccounting::End::Evicted, "lumped: lump is keyless");
+                ++lumps[static_cast<unsigned>(r.dir)];
+            }
+        }
+        Expect(lumps[0] == 1 && lumps[1] == 1, "lumped: one lump per direction");
+    }
+
+    /**
+     * @brief Выборка 1-из-16: оценки сумм близки к истинным, учтён примерно каждый 16-й пакет.
+     */
+    void TestSampled()
+    {
+        FlowAccounting::Options o;
+        o.capacity = 4096;
+        o.sample   = 16;
+        o.seed     = 3;
+        FlowAccounting acct(o);
+        Expect(acct.Sample() == 16, "sampled: Sample()");
+
+        Totals truth;
+        const Totals got = Run(acct, 1000000, 50, 400, 250000, truth);
+
+        std::uint64_t want_packets = 0, want_bytes = 0, got_packets = 0, got_bytes = 0;
+        Sum(truth, want_packets, want_bytes);
+        Sum(got, got_packets, got_bytes);
+        const auto error = [](std::uint64_t a, std::uint64_t b)
+        {
+            return std::fabs(static_cast<double>(a) - static_cast<double>(b)) / static_cast<double>(b);
+        };
+        Expect(error(got_packets, want_packets) < 0.01, "sampled: packet estimate within 1%");
+        Expect(error(got_bytes, want_bytes) < 0.01, "sampled: byte estimate within 1%");
+        Expect(got_packets % 16 == 0 && got_bytes % 16 == 0, "sampled: estimates are scaled by N");
+
+        double worst = 0;
+        for (const auto &[k, v] : truth)
+        {
+            const auto it = got.find(k);
+            worst = std::max(worst, it == got.end() ? 1.0 : error(it->second.second, v.second));
+        }
+        Expect(worst < 0.15, "sampled: every session within 15%");
+
+        const double ratio = static_cast<double>(acct.GetStats().sampled) / static_cast<double>(acct.GetStats().seen);
+        Expect(std::fabs(ratio * 16 - 1) < 0.02, "sampled: one packet in 16 on average");
+    }
+
+    /**
+     * @brief Выгрузка отдаёт приросты; простой закрывает поток итоговой записью; не IP — в unparsed.
+     */
+    void TestDeltasAndIdle()
+    {
+        FlowAccounting::Options o;
+        o.capacity = 64;
+        o.idle     = 1000ms;
+        o.seed     = 4;
+        FlowAccounting acct(o);
+
+        std::vector<FlowAccounting::Record> got;
+        const auto collect = [&](const FlowAccounting::Record &r) { got.push_back(r); };
+        const std::vector<std::uint8_t> p = MakePacket(7, 1, 100);
+        const Clock::time_point t0 = Clock::time_point{} + 5s;
+
+        Expect(acct.Account(p.data(), p.size(), 7, Direction::Upstream, t0), "idle: first packet accounted");
+        acct.Account(p.data(), p.size(), 7, Direction::Upstream, t0 + 10ms);
+        Expect(acct.Drain(t0 + 20ms, collect) == 1 && got.size() == 1, "idle: one active record");
+        Expect(got[0].packets == 2 && got[0].bytes == 200 && got[0].end == FlowAccounting::End::Active &&
+                   got[0].first == t0 && got[0].last == t0 + 10ms && got[0].session == 7,
+               "idle: active record contents");
+
+        got.clear();
+        Expect(acct.Drain(t0 + 30ms, collect) == 0, "idle: nothing new, nothing drained");
+        acct.Account(p.data(), p.size(), 7, Direction::Upstream, t0 + 40ms);
+        Expect(acct.Drain(t0 + 50ms, collect) == 1 && got[0].packets == 1 && got[0].first == t0 + 40ms,
+               "idle: next drain carries only the delta");
+
+        got.clear();
+        acct.Account(p.data(), p.size(), 7, Direction::Upstream, t0 + 60ms);
+        acct.Drain(t0 + 5s, collect);
+        Expect(got.size() == 1 && got[0].end == FlowAccounting::End::Idle && got[0].packets == 1,
+               "idle: idle flow closes with End::Idle");
+        Expect(acct.Flows() == 0, "idle: idle flow removed");
+
+        const std::uint8_t junk[8] = {0xFF, 1, 2, 3, 4, 5, 6, 7};
+        Expect(!acct.Account(junk, sizeof(junk), 7, Direction::Upstream, t0 + 6s) && acct.GetStats().unparsed == 1,
+               "idle: non-IP counts as unparsed");
+    }
+
+    std::uint64_t Be(const std::uint8_t *p, unsigned bytes)
+    {
+        std::uint64_t v = 0;
+        for (unsigned i = 0; i < bytes; ++i)
+        {
+            v = v << 8 | p[i];
+        }
+        return v;
+    }
+
+    std::string ReadFile(const std::filesystem::path &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    /// @brief Записи для выгрузки: count потоков двух сессий, IPv4 и IPv6.
+    std::vector<FlowAccounting::Record> MakeRecords(std::size_t count, Clock::time_point now)
+    {
+        std::vector<FlowAccounting::Record> v(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            FlowAccounting::Record &r = v[i];
+            if (i % 2 == 0)
+            {
+                r.key.src[10] = r.key.src[11] = 0xFF;
+                r.key.dst[10] = r.key.dst[11] = 0xFF;
+                r.key.src[12] = 10;
+                r.key.src[15] = static_cast<std::uint8_t>(i);
+                r.key.dst[12] = 192;
+                r.key.dst[14] = 2;
+                r.key.dst[15] = 1;
+            }
+            else
+            {
+                r.key.src[0] = 0x20;
+                r.key.src[1] = 0x01;
+                r.key.src[2] = 0x0d;
+                r.key.src[3] = 0xb8;
+                r.key.src[15] = 1;
+                r.key.dst[0] = 0xfe;
+                r.key.dst[1] = 0x80;
+                r.key.dst[14] = static_cast<std::uint8_t>(i >> 8);
+                r.key.dst[15] = static_cast<std::uint8_t>(i);
+            }
+            r.key.proto = Headers::kProtoTcp;
+            r.key.sport = static_cast<std::uint16_t>(1000 + i);
+            r.key.dport = 443;
+            r.session   = 1 + i % 2;
+            r.packets   = 1 + i;
+            r.bytes     = 100 * (1 + i);
+            r.first     = now - 2s;
+            r.last      = now - 1s;
+            r.dir       = i % 3 == 0 ? Direction::Downstream : Direction::Upstream;
+            r.end       = i % 5 == 0 ? FlowAccounting::End::Idle : FlowAccounting::End::Active;
+        }
+        return v;
+    }
+
+    /**
+     * @brief IPFIX: 2000 записей — несколько сообщений, в каждом шаблон 256 и набор данных;
+     * длины, порядковые номера и содержимое записей разбираются обратно.
+     */
+    void TestIpfix(const std::filesystem::path &path)
+    {
+        const Clock::time_point now = Clock::time_point{} + 100s;
+        const std::vector<FlowAccounting::Record> in = MakeRecords(2000, now);
+        {
+            FlowExporter exporter({path.string(), FlowExporter::Format::Ipfix, 77});
+            exporter.Begin(now, 4);
+            for (const FlowAccounting::Record &r : in)
+            {
+                exporter.Add(r);
+            }
+            Expect(exporter.Commit() == in.size(), "ipfix: Commit returns the record count");
+            exporter.Begin(now, 4);
+            exporter.Add(in[0]);
+            Expect(exporter.Commit() == 1, "ipfix: second export");
+        }
+
+        const std::string file = ReadFile(path);
+        const auto *data = reinterpret_cast<const std::uint8_t *>(file.data());
+        std::size_t pos = 0, messages = 0, records = 0;
+        std::uint64_t sequence = 0;
+        bool layout_ok = true;
+        std::uint64_t packets = 0, bytes = 0;
+        while (pos + 16 <= file.size() && layout_ok)
+        {
+            const std::uint8_t *m = data + pos;
+            const std::size_t len = Be(m + 2, 2);
+            layout_ok = Be(m, 2) == 10 && len > 16 && pos + len <= file.size() && Be(m + 8, 4) == sequence &&
+                        Be(m + 12, 4) == 77;
+            if (!layout_ok)
+            {
+                break;
+            }
+            // Набор шаблонов: 13 полей, последнее — предприятия 32473.
+            const std::uint8_t *t = m + 16;
+            const std::size_t tlen = Be(t + 2, 2);
+            layout_ok = Be(t, 2) == 2 && Be(t + 4, 2) == 256 && Be(t + 6, 2) == 13 &&
+                        Be(t + tlen - 8, 2) == (0x8000 | 1) && Be(t + tlen - 4, 4) == 32473;
+            // Набор данных: записи по kIpfixRecordSize байт.
+            const std::uint8_t *d = t + tlen;
+            const std::size_t dlen = Be(d + 2, 2);
+            layout_ok = layout_ok && Be(d, 2) == 256 && 16 + tlen + dlen == len &&
+                        (dlen - 4) % FlowExporter::kIpfixRecordSize == 0;
+            const std::size_t n = (dlen - 4) / FlowExporter::kIpfixRecordSize;
+            for (std::size_t i = 0; i < n && layout_ok; ++i, ++records)
+            {
+                const std::uint8_t *r = d + 4 + i * FlowExporter::kIpfixRecordSize;
+                const FlowAccounting::Record &want = in[records % in.size()];
+                layout_ok = std::equal(r, r + 16, want.key.src) && std::equal(r + 16, r + 32, want.key.dst) &&
+                            Be(r + 32, 2) == want.key.sport && Be(r + 34, 2) == want.key.dport &&
+                            r[36] == want.key.proto && r[37] == static_cast<unsigned>(want.dir) &&
+                            Be(r + 38, 8) == want.bytes && Be(r + 46, 8) == want.packets &&
+                            Be(r + 62, 8) - Be(r + 54, 8) == 1000 && r[70] == static_cast<unsigned>(want.end) &&
+                            Be(r + 71, 4) == 4 && Be(r + 75, 8) == want.session;
+                packets += Be(r + 46, 8);
+                bytes   += Be(r + 38, 8);
+            }
+            sequence += n;
+            pos += len;
+            ++messages;
+        }
+        Expect(layout_ok && pos == file.size(), "ipfix: message, template and record layout");
+        Expect(messages == 4 && records == 2001, "ipfix: 2000 records split into 3 messages, then one more");
+        Expect(packets == 2001000 + 1 && bytes == 100 * (2001000 + 1), "ipfix: sums parsed back");
+    }
+
+    /**
+     * @brief CSV: заголовок — только в новом файле; строка на запись, адреса текстом.
+     */
+    void TestCsv(const std::filesystem::path &path)
+    {
+        const Clock::time_point now = Clock::time_point{} + 100s;
+        const std::vector<FlowAccounting::Record> in = MakeRecords(3, now);
+        for (int round = 0; round < 2; ++round)
+        {
+            FlowExporter exporter({path.string(), FlowExporter::Format::Csv, 0});
+            exporter.Begin(now, 1);
+            for (const FlowAccounting::Record &r : in)
+            {
+                exporter.Add(r);
+            }
+            exporter.Commit();
+        }
+
+        std::istringstream text(ReadFile(path));
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(text, line);)
+        {
+            lines.push_back(line);
+        }
+        Expect(lines.size() == 7, "csv: one header and a row per record");
+        Expect(!lines.empty() && lines[0].rfind("export_ms,session,direction,proto,src,sport,dst,dport,", 0) == 0,
+               "csv: header");
+        const auto tail = [&](std::size_t i)
+        {
+            // export_ms отличается от запуска к запуску: сравнивается всё после первой запятой.
+            return lines.size() > i ? lines[i].substr(lines[i].find(',') + 1) : std::string();
+        };
+        Expect(tail(1).rfind("1,down,6,10.0.0.0,1000,192.0.2.1,443,1,100,", 0) == 0, "csv: IPv4 row");
+        Expect(tail(2).rfind("2,up,6,2001:db8::1,1001,fe80::1,443,2,200,", 0) == 0, "csv: IPv6 row");
+        Expect(tail(4) == tail(1) && tail(6) == tail(3), "csv: appended export repeats rows without a header");
+        Expect(tail(1).size() > 2 && tail(1).substr(tail(1).size() - 4) == ",1,1", "csv: end reason and sample");
+    }
+}
+
+int main()
+{
+    TestExactEvictionStorm();
+    TestLumped();
+    TestSampled();
+    TestDeltasAndIdle();
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string tag = std::to_string(std::random_device{}());
+    const std::filesystem::path ipfix = dir / ("FlowAccountingTest-" + tag + ".ipfix");
+    const std::filesystem::path csv   = dir / ("FlowAccountingTest-" + tag + ".csv");
+    TestIpfix(ipfix);
+    TestCsv(csv);
+    std::filesystem::remove(ipfix);
+    std::filesystem::remove(csv);
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("FlowAccounting: OK\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,357 @@
+// FqCodelTest.cpp — FQ-CoDel в памяти на виртуальных часах: изоляция потоков, CoDel/ECN, DRR, пределы.
+
+#include "Core/FqCodel.hpp"
+#include "Core/Checksum.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Clock = FqCodel::Clock;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    /// @brief UDP/IPv4 от 10.0.0.src:sport к 8.0.0.8 с верной суммой заголовка; tos — DSCP и ECN.
+    void MakePacket(std::uint8_t *p, std::size_t len, std::uint8_t src, std::uint16_t sport, std::uint8_t tos)
+    {
+        std::memset(p, 0, len);
+        p[0]  = 0x45;
+        p[1]  = tos;
+        p[2]  = static_cast<std::uint8_t>(len >> 8);
+        p[3]  = static_cast<std::uint8_t>(len);
+        p[8]  = 64;
+        p[9]  = 17;
+        p[12] = 10;
+        p[15] = src;
+        p[16] = 8;
+        p[19] = 8;
+        p[20] = static_cast<std::uint8_t>(sport >> 8);
+        p[21] = static_cast<std::uint8_t>(sport);
+        const std::uint16_t check = Checksum::Finish(Checksum::Reference(p, 20));
+        p[10] = static_cast<std::uint8_t>(check >> 8);
+        p[11] = static_cast<std::uint8_t>(check);
+    }
+
+    bool HeaderValid(const std::uint8_t *p)
+    {
+        return Checksum::Reference(p, 20) == 0xFFFF;
+    }
+
+    std::uint16_t SourcePort(const std::uint8_t *p)
+    {
+        return static_cast<std::uint16_t>(p[20] << 8 | p[21]);
+    }
+
+    double Mbps(std::uint64_t bytes, Clock::duration d)
+    {
+        return static_cast<double>(bytes) * 8.0 / std::chrono::duration<double>(d).count() / 1e6;
+    }
+
+    /**
+     * @brief Голос рядом с перегружающей выгрузкой: голос не ждёт за ней, очередь выгрузки держит CoDel.
+     *
+     * Выдача 10 Мбит/с; четыре потока выгрузки предлагают 18.7 Мбит/с, голос — 200 байт раз в 20 мс.
+     */
+    void TestSparseFlowIsolation(bool ecn)
+    {
+        FqCodel::Options o;
+        o.rate_kbps = 10000;
+        o.seed      = 42;
+        o.ecn       = ecn;
+        FqCodel fq(o);
+
+        std::uint8_t pkt[1500];
+        std::uint8_t out[1500];
+        std::uint64_t voice = 0, bulk_bytes = 0, bad = 0, ce = 0;
+        double voice_max_ms = 0, voice_sum_ms = 0;
+
+        const auto start = Clock::time_point{} + 100s;
+        const auto end   = start + 10s;
+        std::uint64_t tick = 0;
+        for (auto now = start; now < end; now += 100us, ++tick)
+        {
+            if (tick % 6 == 0)
+            {
+                for (std::uint16_t f = 0; f < 4; ++f)
+                {
+                    MakePacket(pkt, 1400, 1, static_cast<std::uint16_t>(1000 + f), 0x02);   // ECT(0)
+                    fq.Enqueue(pkt, 1400, now);
+                }
+            }
+            if (tick % 200 == 0)
+            {
+                // Время постановки — в нагрузке: по нему при выдаче считается задержка.
+                MakePacket(pkt, 200, 2, 5060, 0);
+                std::memcpy(pkt + 28, &now, sizeof now);
+                fq.Enqueue(pkt, 200, now);
+            }
+            while (const std::size_t n = fq.Dequeue(out, sizeof out, now))
+            {
+                bad += HeaderValid(out) ? 0u : 1u;
+                if (SourcePort(out) == 5060)
+                {
+                    Clock::time_point at;
+                    std::memcpy(&at, out + 28, sizeof at);
+                    const double ms = std::chrono::duration<double, std::milli>(now - at).count();
+                    voice_max_ms = std::max(voice_max_ms, ms);
+                    voice_sum_ms += ms;
+                    ++voice;
+                }
+                else
+                {
+                    bulk_bytes += n;
+                    ce += (out[1] & 0x03) == 0x03 ? 1u : 0u;
+                }
+            }
+        }
+
+        const FqCodel::Stats &s = fq.GetStats();
+        Expect(bad == 0, "isolation: IPv4 header checksum valid after CE marking");
+        Expect(voice == 500, "isolation: every voice packet delivered");
+        Expect(voice != 0 && voice_sum_ms / static_cast<double>(voice) < 2.0, "isolation: voice average delay under 2 ms");
+        Expect(voice_max_ms < 5.0, "isolation: voice delay under 5 ms");
+        const double rate = Mbps(bulk_bytes, end - start);
+        Expect(rate > 9.3 && rate < 10.1, "isolation: bulk gets the rest of 10 Mbit/s");
+        if (ecn)
+        {
+            Expect(s.ecn_marks > 0 && ce == s.ecn_marks, "isolation: ECN-capable bulk is marked CE");
+            Expect(s.codel_drops == 0, "isolation: no CoDel drops with ECN");
+        }
+        else
+        {
+            Expect(s.codel_drops > 0 && s.ecn_marks == 0 && ce == 0, "isolation: without ECN CoDel drops");
+        }
+    }
+
+    /**
+     * @brief Поток чуть быстрее выдачи (11.2 Мбит/с на 10): CoDel держит очередь, а не limit.
+     *
+     * Без CoDel очередь выросла бы до limit (1024 пакета — больше секунды) и дальше теряла бы хвост.
+     * Неотзывчивый поток CoDel сводит к десяткам миллисекунд: частота отбрасываний растёт
+     * как sqrt(count), пока не сравняется с избытком.
+     */
+    void TestCodelBoundsQueue()
+    {
+        FqCodel::Options o;
+        o.rate_kbps = 10000;
+        o.seed      = 5;
+        o.ecn       = false;
+        FqCodel fq(o);
+
+        std::uint8_t pkt[1500];
+        std::uint8_t out[1500];
+        std::uint64_t late = 0;
+        double late_sum_ms = 0;
+
+        const auto start = Clock::time_point{} + 1s;
+        const auto end   = start + 20s;
+        for (auto now = start; now < end; now += 1ms)
+        {
+            MakePacket(pkt, 1400, 1, 1000, 0);
+            std::memcpy(pkt + 28, &now, sizeof now);
+            fq.Enqueue(pkt, 1400, now);
+            while (fq.Dequeue(out, sizeof out, now) != 0)
+            {
+                if (now - start >= 10s)
+                {
+                    Clock::time_point at;
+                    std::memcpy(&at, out + 28, sizeof at);
+                    late_sum_ms += std::chrono::duration<double, std::milli>(now - at).count();
+                    ++late;
+                }
+            }
+        }
+        const FqCodel::Stats &s = fq.GetStats();
+        Expect(s.codel_drops > 0 && s.overlimit_drops == 0, "codel: excess shed by CoDel, not by limit");
+        Expect(late != 0 && late_sum_ms / static_cast<double>(late) < 50.0, "codel: standing queue in tens of ms");
+    }
+
+    /// @brief DRR делит скорость поровну по байтам между потоками с разными размерами пакетов.
+    void TestDrrFairness()
+    {
+        FqCodel::Options o;
+        o.rate_kbps = 8000;
+        o.seed      = 7;
+        o.limit     = 4096;
+        o.target    = std::chrono::microseconds(1000000);   // CoDel не вмешивается: проверяется только DRR
+        FqCodel fq(o);
+
+        const std::size_t sizes[3]  = {1500, 500, 100};
+        std::uint64_t     got[3]    = {};
+        std::size_t       queued[3] = {};
+        std::uint8_t pkt[1500];
+        std::uint8_t out[1500];
+
+        const auto start = Clock::time_point{} + 1s;
+        const auto end   = start + 5s;
+        for (auto now = start; now < end; now += 1ms)
+        {
+            // У каждого потока всегда очередь в 200 пакетов.
+            for (std::size_t f = 0; f < 3; ++f)
+            {
+                for (; queued[f] < 200; ++queued[f])
+                {
+                    MakePacket(pkt, sizes[f], 1, static_cast<std::uint16_t>(2000 + f), 0);
+                    fq.Enqueue(pkt, sizes[f], now);
+                }
+            }
+            while (const std::size_t n = fq.Dequeue(out, sizeof out, now))
+            {
+                const std::size_t f = SourcePort(out) - 2000u;
+                got[f] += n;
+                --queued[f];
+            }
+        }
+        const std::uint64_t lo = std::min({got[0], got[1], got[2]});
+        const std::uint64_t hi = std::max({got[0], got[1], got[2]});
+        Expect(lo != 0 && static_cast<double>(hi) / static_cast<double>(lo) < 1.05, "drr: byte shares within 5%");
+    }
+
+    /// @brief flow_rate_kbps ограничивает один поток, не задерживая остальные.
+    void TestFlowRate()
+    {
+        FqCodel::Options o;
+        o.flow_rate_kbps = 1000;
+        o.seed           = 9;
+        FqCodel fq(o);
+
+        std::uint8_t  pkt[1500];
+        std::uint8_t  out[1500];
+        std::uint64_t heavy = 0, light = 0, light_sent = 0;
+
+        const auto start = Clock::time_point{} + 1s;
+        const auto end   = start + 5s;
+        std::uint64_t tick = 0;
+        for (auto now = start; now < end; now += 1ms, ++tick)
+        {
+            MakePacket(pkt, 1000, 1, 3000, 0);   // 8 Мбит/с
+            fq.Enqueue(pkt, 1000, now);
+            if (tick % 20 == 0)
+            {
+                MakePacket(pkt, 1000, 2, 3001, 0);   // 0.4 Мбит/с
+                fq.Enqueue(pkt, 1000, now);
+                ++light_sent;
+            }
+            while (const std::size_t n = fq.Dequeue(out, sizeof out, now))
+            {
+                (SourcePort(out) == 3000 ? heavy : light) += n;
+            }
+        }
+        const double rate = Mbps(heavy, end - start);
+        Expect(rate > 0.95 && rate < 1.05, "flow rate: heavy flow held to 1 Mbit/s");
+        Expect(light >= (light_sent - 1) * 1000, "flow rate: light flow unaffected");
+        Expect(fq.GetStats().flow_throttled > 0, "flow rate: throttling counted");
+    }
+
+    /// @brief Переполнение limit бьёт по самому «толстому» потоку; слишком большой пакет не принимается.
+    void TestLimits()
+    {
+        FqCodel::Options o;
+        o.limit     = 64;
+        o.slot_size = 1500;
+        o.seed      = 11;
+        FqCodel fq(o);
+
+        std::uint8_t pkt[2000];
+        std::uint8_t out[1500];
+        const auto now = Clock::time_point{} + 1s;
+
+        MakePacket(pkt, 100, 2, 4001, 0);
+        fq.Enqueue(pkt, 100, now);
+        for (int i = 0; i < 500; ++i)
+        {
+            MakePacket(pkt, 1500, 1, 4000, 0);
+            fq.Enqueue(pkt, 1500, now);
+        }
+        Expect(fq.Packets() <= o.limit, "limits: queue never exceeds limit");
+        Expect(fq.GetStats().overlimit_drops >= 500 + 1 - o.limit, "limits: overflow drops counted");
+
+        bool sparse = false;
+        while (const std::size_t n = fq.Dequeue(out, sizeof out, now))
+        {
+            sparse = sparse || (n == 100 && SourcePort(out) == 4001);
+        }
+        Expect(sparse, "limits: the small flow survives overflow of the fat one");
+
+        MakePacket(pkt, 1600, 1, 4000, 0);
+        Expect(!fq.Enqueue(pkt, 1600, now), "limits: packet larger than slot rejected");
+        Expect(fq.GetStats().oversize_drops == 1, "limits: oversize drop counted");
+
+        MakePacket(pkt, 1500, 1, 4000, 0);
+        fq.Enqueue(pkt, 1500, now);
+        fq.Clear();
+        Expect(fq.Packets() == 0 && fq.Bytes() == 0, "limits: Clear empties the queues");
+    }
+
+    /// @brief SetRate на ходу: выдача следует новой скорости.
+    void TestSetRate()
+    {
+        FqCodel::Options o;
+        o.rate_kbps = 20000;
+        o.seed      = 13;
+        FqCodel fq(o);
+
+        std::uint8_t pkt[1500];
+        std::uint8_t out[1500];
+        std::uint64_t before = 0, after = 0;
+
+        const auto start  = Clock::time_point{} + 1s;
+        const auto change = start + 2s;
+        const auto end    = change + 2s;
+        for (auto now = start; now < end; now += 100us)
+        {
+            if (now == change)
+            {
+                fq.SetRate(5000);
+            }
+            for (std::uint16_t f = 0; f < 2; ++f)
+            {
+                MakePacket(pkt, 500, 1, static_cast<std::uint16_t>(6000 + f), 0);   // 80 Мбит/с
+                fq.Enqueue(pkt, 500, now);
+            }
+            while (const std::size_t n = fq.Dequeue(out, sizeof out, now))
+            {
+                (now < change ? before : after) += n;
+            }
+        }
+        const double r1 = Mbps(before, change - start);
+        const double r2 = Mbps(after, end - change);
+        Expect(r1 > 19.0 && r1 < 20.5, "set rate: 20 Mbit/s before");
+        Expect(r2 > 4.75 && r2 < 5.25, "set rate: 5 Mbit/s after");
+        Expect(fq.Rate() == 5000, "set rate: Rate reports the new value");
+    }
+}
+
+int main()
+{
+    TestSparseFlowIsolation(true);
+    TestSparseFlowIsolation(false);
+    TestCodelBoundsQueue();
+    TestDrrFairness();
+    TestFlowRate();
+    TestLimits();
+    TestSetRate();
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::puts("FqCodel: OK");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,501 @@
+// GroTest.cpp — склейка Gro: поток сегментов шести чередующихся потоков IPv4/IPv6 (короткие, PSH, чистые ACK,
+// испорченные суммы) в обоих режимах суммы — верные суммы IP/TCP на выходе (частичная досчитывается, как это
+// делает ядро), непрерывный seq и побайтно те же данные каждого потока; правила склейки по отдельности.
+
+#include "Core/Checksum.hpp"
+#include "Core/Gro.hpp"
+#include "Core/Headers.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Clock = Gro::Clock;
+    using Bytes = std::vector<std::uint8_t>;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    constexpr std::uint8_t kFin = 0x01;
+    constexpr std::uint8_t kSyn = 0x02;
+    constexpr std::uint8_t kPsh = 0x08;
+    constexpr std::uint8_t kAck = 0x10;
+
+    /// @brief Заголовок TCP с опцией timestamps (NOP, NOP, TS), как у Linux.
+    constexpr std::size_t kTcpHeader = 32;
+
+    /**
+     * @brief Поток: адреса, порты, номера и поля заголовков, общие для его сегментов.
+     */
+    struct FlowSpec
+    {
+        bool          v6 = false;
+        std::uint8_t  src[16] = {};
+        std::uint8_t  dst[16] = {};
+        std::uint16_t sport = 0;
+        std::uint16_t dport = 443;
+        std::uint32_t seq = 0;
+        std::uint32_t ack = 0;
+        std::uint16_t id = 0;
+        std::uint16_t mss = 1448;
+        std::uint8_t  ttl = 64;
+        std::uint16_t window = 502;
+        std::uint32_t tsval = 1000;
+    };
+
+    /// @brief Сегмент с верными суммами IP и TCP.
+    Bytes Segment(const FlowSpec &f, std::uint32_t seq, const std::uint8_t *data, std::size_t n,
+                  std::uint8_t flags, std::uint16_t id)
+    {
+        const std::size_t ip  = f.v6 ? 40 : 20;
+        const std::size_t len = ip + kTcpHeader + n;
+        Bytes             p(len, 0);
+        if (f.v6)
+        {
+            p[0] = 0x60;
+            Headers::Store16(&p[4], static_cast<std::uint16_t>(len - 40));
+            p[6] = Headers::kProtoTcp;
+            p[7] = f.ttl;
+            std::memcpy(&p[8], f.src, 16);
+            std::memcpy(&p[24], f.dst, 16);
+        }
+        else
+        {
+            p[0] = 0x45;
+            Headers::Store16(&p[2], static_cast<std::uint16_t>(len));
+            Headers::Store16(&p[4], id);
+            p[6] = 0x40;
+            p[8] = f.ttl;
+            p[9] = Headers::kProtoTcp;
+            std::memcpy(&p[12], f.src, 4);
+            std::memcpy(&p[16], f.dst, 4);
+            Headers::Store16(&p[10], Checksum::Finish(Checksum::Reference(p.data(), 20)));
+        }
+        std::uint8_t *t = &p[ip];
+        Headers::Store16(t, f.sport);
+        Headers::Store16(t + 2, f.dport);
+        Headers::Store32(t + 4, seq);
+        Headers::Store32(t + 8, f.ack);
+        t[12] = static_cast<std::uint8_t>(kTcpHeader / 4 << 4);
+        t[13] = flags;
+        Headers::Store16(t + 14, f.window);
+        t[20] = 1;
+        t[21] = 1;
+        t[22] = 8;
+        t[23] = 10;
+        Headers::Store32(t + 24, f.tsval);
+        Headers::Store32(t + 28, 77);
+        if (n != 0)
+        {
+            std::memcpy(t + kTcpHeader, data, n);
+        }
+        const std::size_t tcp_len = kTcpHeader + n;
+        Headers::Store16(t + 16, Checksum::Finish(Checksum::Reference(t, tcp_len, Checksum::Pseudo(p.data(), Headers::kProtoTcp, tcp_len))));
+        return p;
+    }
+
+    std::size_t IpLen(const Bytes &p)
+    {
+        return (p[0] >> 4) == 6 ? 40 : static_cast<std::size_t>(p[0] & 0x0F) * 4;
+    }
+
+    /// @brief Длины и суммы IP и TCP сходятся с размером пакета.
+    bool Valid(const Bytes &p)
+    {
+        const std::size_t ip = IpLen(p);
+        if (ip == 40)
+        {
+            if (Headers::Load16(&p[4]) + 40u != p.size())
+            {
+                return false;
+            }
+        }
+        else if (Headers::Load16(&p[2]) != p.size() || Checksum::Reference(p.data(), ip) != 0xFFFF)
+        {
+            return false;
+        }
+        const std::size_t tcp_len = p.size() - ip;
+        return Checksum::Reference(&p[ip], tcp_len, Checksum::Pseudo(p.data(), Headers::kProtoTcp, tcp_len)) == 0xFFFF;
+    }
+
+    /// @brief Что делает ядро с CHECKSUM_PARTIAL: сумма от csum_start (в поле — псевдозаголовок) в поле.
+    void CompletePartial(Bytes &p, std::size_t csum_start)
+    {
+        const std::uint16_t c = Checksum::Finish(Checksum::Reference(&p[csum_start], p.size() - csum_start));
+        Headers::Store16(&p[csum_start + 16], c);
+    }
+
+    /**
+     * @brief Выход склейки: склеенные пакеты (Emit) и пакеты «как есть» (Push вернул false) по порядку.
+     */
+    struct Out
+    {
+        Bytes         data;
+        unsigned      segments = 1;
+        std::uint16_t gso_size = 0;
+        std::uint16_t hdr_len  = 0;
+        std::uint16_t csum_start = 0;
+        bool          ipv6 = false;
+        bool          emitted = false;
+    };
+
+    Gro::Emit Collect(std::vector<Out> &out)
+    {
+        return [&out](const Gro::Packet &p) {
+            Out o;
+            o.data.assign(p.data, p.data + p.len);
+            o.segments   = p.segments;
+            o.gso_size   = p.gso_size;
+            o.hdr_len    = p.hdr_len;
+            o.csum_start = p.csum_start;
+            o.ipv6       = p.ipv6;
+            o.emitted    = true;
+            out.push_back(std::move(o));
+        };
+    }
+
+    void Push(Gro &gro, std::vector<Out> &out, const Bytes &p, Clock::time_point now)
+    {
+        if (!gro.Push(p.data(), p.size(), now))
+        {
+            Out o;
+            o.data = p;
+            out.push_back(std::move(o));
+        }
+    }
+
+    std::uint16_t SrcPort(const Bytes &p) { return Headers::Load16(&p[IpLen(p)]); }
+    std::uint32_t Seq(const Bytes &p) { return Headers::Load32(&p[IpLen(p) + 4]); }
+    std::uint8_t  Flags(const Bytes &p) { return p[IpLen(p) + 13]; }
+
+    std::vector<FlowSpec> MakeFlows(std::mt19937_64 &rng)
+    {
+        std::vector<FlowSpec> flows(6);
+        for (std::size_t i = 0; i < flows.size(); ++i)
+        {
+            FlowSpec &f = flows[i];
+            f.v6 = i % 2 != 0;
+            for (std::size_t k = 0; k < 16; ++k)
+            {
+                f.src[k] = static_cast<std::uint8_t>(rng());
+                f.dst[k] = static_cast<std::uint8_t>(rng());
+            }
+            f.sport = static_cast<std::uint16_t>(40000 + i);
+            f.seq   = static_cast<std::uint32_t>(rng());
+            f.ack   = static_cast<std::uint32_t>(rng());
+            f.id    = static_cast<std::uint16_t>(rng());
+            f.mss   = f.v6 ? 1428 : 1448;
+        }
+        // Поток у самого переполнения seq.
+        flows[2].seq = 0xFFFFFFFFu - 20000;
+        return flows;
+    }
+
+    /**
+     * @brief 40 000 сегментов шести потоков вперемешку; на выходе каждого потока — те же данные по порядку.
+     */
+    void TestTraffic(bool partial, std::mt19937_64 &rng)
+    {
+        Gro::Options opts;
+        opts.partial_csum = partial;
+        opts.max_size     = partial ? 65535 : 1500;
+        opts.flows        = 4;
+        std::vector<Out> out;
+        Gro              gro(opts, Collect(out));
+
+        std::vector<FlowSpec> flows = MakeFlows(rng);
+        std::map<std::uint16_t, Bytes>         sent;
+        std::map<std::uint16_t, std::uint32_t> first_seq;
+        for (const FlowSpec &f : flows)
+        {
+            first_seq[f.sport] = f.seq;
+        }
+
+        constexpr int kSegments = 40000;
+        Clock::time_point now = Clock::now();
+        std::size_t corrupted = 0;
+        Bytes       payload;
+        for (int i = 0; i < kSegments; ++i)
+        {
+            FlowSpec &f = flows[rng() % 3 == 0 ? rng() % flows.size() : static_cast<std::size_t>(i / 50) % flows.size()];
+            const unsigned kind = static_cast<unsigned>(rng() % 100);
+            std::size_t    n    = f.mss;
+            std::uint8_t   flags = kAck;
+            if (kind < 10)
+            {
+                n = 1 + rng() % (f.mss - 1u);
+            }
+            else if (kind < 15)
+            {
+                flags |= kPsh;
+            }
+            else if (kind < 20)
+            {
+                n = 0;
+            }
+            payload.resize(n);
+            for (auto &b : payload)
+            {
+                b = static_cast<std::uint8_t>(rng());
+            }
+            Bytes seg = Segment(f, f.seq, payload.data(), n, flags, f.id++);
+            if (n != 0 && kind >= 20 && rng() % 50 == 0)
+            {
+                // Испорченная сумма TCP: сегмент должен выйти как есть.
+                seg[IpLen(seg) + 17] ^= 0x5A;
+                ++corrupted;
+            }
+            f.seq += static_cast<std::uint32_t>(n);
+            Bytes &s = sent[f.sport];
+            s.insert(s.end(), payload.begin(), payload.end());
+
+            now += 10us;
+            Push(gro, out, seg, now);
+            if (rng() % 16 == 0)
+            {
+                gro.Poll(now);
+            }
+        }
+        gro.Flush();
+        Expect(!gro.Pending(), "traffic: nothing held after Flush");
+
+        std::size_t invalid = 0;
+        bool        shape = true, seq_ok = true;
+        std::map<std::uint16_t, Bytes>         got;
+        std::map<std::uint16_t, std::uint32_t> next = first_seq;
+        for (Out &o : out)
+        {
+            if (o.segments > 1)
+            {
+                const std::size_t data = o.data.size() - o.hdr_len;
+                shape &= o.emitted && o.gso_size != 0 && data > (o.segments - 1u) * o.gso_size &&
+                         data <= o.segments * std::size_t{o.gso_size} && o.data.size() <= opts.max_size &&
+                         o.segments <= opts.max_segments && o.csum_start == IpLen(o.data) &&
+                         o.hdr_len == IpLen(o.data) + kTcpHeader && o.ipv6 == (IpLen(o.data) == 40);
+                if (partial)
+                {
+                    CompletePartial(o.data, o.csum_start);
+                }
+            }
+            invalid += Valid(o.data) ? 0u : 1u;
+            const std::uint16_t port = SrcPort(o.data);
+            seq_ok &= Seq(o.data) == next[port];
+            const std::size_t hdr = IpLen(o.data) + kTcpHeader;
+            next[port] += static_cast<std::uint32_t>(o.data.size() - hdr);
+            Bytes &g = got[port];
+            g.insert(g.end(), o.data.begin() + static_cast<std::ptrdiff_t>(hdr), o.data.end());
+        }
+        const Gro::Stats &st = gro.GetStats();
+        Expect(invalid == corrupted, "traffic: every packet but the corrupted ones has valid IP/TCP checksums");
+        Expect(st.bad_csum == corrupted, "traffic: corrupted segments counted and passed through");
+        Expect(shape, "traffic: merged packets describe their segments correctly");
+        Expect(seq_ok, "traffic: seq continuous per flow, order kept");
+        Expect(got == sent, "traffic: per-flow payload byte-identical to the input");
+        Expect(st.packets == kSegments && st.coalesced > 0 && st.supers > 0, "traffic: segments merged");
+        if (partial)
+        {
+            Expect(out.size() * 10 < kSegments * 6u, "traffic: vnet mode writes well under 60% of the packets");
+        }
+    }
+
+    FlowSpec OneFlow(bool v6)
+    {
+        FlowSpec f;
+        f.v6 = v6;
+        f.src[0] = 10;
+        f.src[3] = 1;
+        f.dst[0] = 10;
+        f.dst[3] = 2;
+        f.sport  = 5000;
+        f.seq    = 1000;
+        f.ack    = 7;
+        f.id     = 100;
+        f.mss    = 100;
+        return f;
+    }
+
+    /// @brief Подать сегменты и вернуть выход после Flush.
+    std::vector<Out> Run(const Gro::Options &opts, const std::vector<Bytes> &segs)
+    {
+        std::vector<Out> out;
+        Gro              gro(opts, Collect(out));
+        const auto       now = Clock::now();
+        for (const Bytes &s : segs)
+        {
+            Push(gro, out, s, now);
+        }
+        gro.Flush();
+        return out;
+    }
+
+    /// @brief Склейка по отдельным правилам: что склеивается, что нет, поля склеенного пакета.
+    void TestRules()
+    {
+        const std::uint8_t data[200] = {1, 2, 3};
+        for (const bool v6 : {false, true})
+        {
+            FlowSpec         f = OneFlow(v6);
+            Gro::Options     opts;
+            std::vector<Out> out;
+
+            // Три полных и короткий: один пакет, ID и seq первого, PSH последнего.
+            std::vector<Bytes> segs;
+            for (int i = 0; i < 3; ++i)
+            {
+                segs.push_back(Segment(f, f.seq + 100u * static_cast<unsigned>(i), data, 100, kAck, static_cast<std::uint16_t>(f.id + i)));
+            }
+            segs.push_back(Segment(f, f.seq + 300, data, 40, kAck | kPsh, static_cast<std::uint16_t>(f.id + 3)));
+            out = Run(opts, segs);
+            Expect(out.size() == 1 && out[0].segments == 4 && out[0].gso_size == 100, "rules: train merged");
+            if (out.size() == 1)
+            {
+                const Bytes &p = out[0].data;
+                Expect(Valid(p) && Seq(p) == f.seq && Flags(p) == (kAck | kPsh) &&
+                       p.size() == IpLen(p) + kTcpHeader + 340 && (v6 || Headers::Load16(&p[4]) == f.id),
+                       "rules: merged header (length, seq, ID of the first, PSH of the last)");
+            }
+
+            // Короткий закрывает пакет, следующий — новый пакет; сегмент длиннее первого не дописывается.
+            segs = {Segment(f, f.seq, data, 100, kAck, 1), Segment(f, f.seq + 100, data, 50, kAck, 2),
+                    Segment(f, f.seq + 150, data, 100, kAck, 3), Segment(f, f.seq + 250, data, 150, kAck, 4)};
+            out = Run(opts, segs);
+            Expect(out.size() == 3 && out[0].segments == 2 && out[1].segments == 1 && out[2].segments == 1,
+                   "rules: short segment closes, longer segment starts anew");
+
+            // Разрыв seq, другое окно, другой ACK, другой TTL/hop limit, другие опции — не склеиваются.
+            FlowSpec w = f, a = f, t = f, o = f;
+            w.window = 1;
+            a.ack    = 8;
+            t.ttl    = 63;
+            o.tsval  = 1001;
+            segs = {Segment(f, f.seq, data, 100, kAck, 1), Segment(f, f.seq + 101, data, 100, kAck, 2),
+                    Segment(w, f.seq + 201, data, 100, kAck, 3), Segment(a, f.seq + 301, data, 100, kAck, 4),
+                    Segment(t, f.seq + 401, data, 100, kAck, 5), Segment(o, f.seq + 501, data, 100, kAck, 6)};
+            out = Run(opts, segs);
+            bool single = out.size() == segs.size();
+            for (const Out &x : out)
+            {
+                single &= x.segments == 1;
+            }
+            Expect(single, "rules: seq gap and header differences prevent merging");
+
+            // SYN, FIN и чистый ACK идут мимо и выталкивают удержанное своего потока раньше себя.
+            segs = {Segment(f, f.seq, data, 100, kAck, 1), Segment(f, f.seq + 100, data, 100, kAck, 2),
+                    Segment(f, f.seq + 200, nullptr, 0, kAck, 3), Segment(f, f.seq + 200, data, 100, kAck | kFin, 4),
+                    Segment(f, f.seq, nullptr, 0, kSyn, 5)};
+            out = Run(opts, segs);
+            Expect(out.size() == 4 && out[0].segments == 2 && !out[1].emitted && !out[2].emitted &&
+                   Seq(out[1].data) == f.seq + 200 && Flags(out[2].data) == (kAck | kFin),
+                   "rules: control segments pass through after the held packet");
+
+            // max_segments и max_size.
+            Gro::Options small;
+            small.max_segments = 4;
+            segs.clear();
+            for (int i = 0; i < 10; ++i)
+            {
+                segs.push_back(Segment(f, f.seq + 100u * static_cast<unsigned>(i), data, 100, kAck, static_cast<std::uint16_t>(i)));
+            }
+            out = Run(small, segs);
+            Expect(out.size() == 3 && out[0].segments == 4 && out[1].segments == 4 && out[2].segments == 2,
+                   "rules: max_segments caps a packet");
+            small.max_segments = 64;
+            small.max_size     = (v6 ? 40 : 20) + kTcpHeader + 350;
+            out = Run(small, segs);
+            bool fits = out.size() == 4;
+            for (const Out &x : out)
+            {
+                fits &= x.data.size() <= small.max_size && Valid(x.data);
+            }
+            Expect(fits && out[0].segments == 3, "rules: max_size caps a packet");
+        }
+
+        // IPv4 с опциями или фрагмент — мимо склейки.
+        {
+            FlowSpec f = OneFlow(false);
+            Bytes    frag = Segment(f, f.seq, data, 100, kAck, 1);
+            frag[6] |= 0x20;
+            Headers::Store16(&frag[10], 0);
+            Headers::Store16(&frag[10], Checksum::Finish(Checksum::Reference(frag.data(), 20)));
+            std::vector<Out> out = Run(Gro::Options{}, {frag, frag});
+            Expect(out.size() == 2 && !out[0].emitted && !out[1].emitted, "rules: fragments pass through");
+        }
+    }
+
+    /// @brief Удержание: срок hold, вытеснение старейшего потока, некорректные параметры.
+    void TestHold()
+    {
+        const std::uint8_t data[100] = {};
+        Gro::Options       opts;
+        opts.flows = 2;
+        opts.hold  = 100us;
+        std::vector<Out>   out;
+        Gro                gro(opts, Collect(out));
+        const auto         t0 = Clock::now();
+
+        FlowSpec a = OneFlow(false), b = OneFlow(false), c = OneFlow(true);
+        b.sport = 5001;
+        gro.Push(Segment(a, a.seq, data, 100, kAck, 1).data(), 100 + 52, t0);
+        gro.Poll(t0 + 99us);
+        Expect(out.empty() && gro.Pending(), "hold: kept before the deadline");
+        gro.Poll(t0 + 100us);
+        Expect(out.size() == 1 && gro.GetStats().expired == 1, "hold: released at the deadline");
+
+        const Bytes sa = Segment(a, a.seq + 100, data, 100, kAck, 2);
+        const Bytes sb = Segment(b, b.seq, data, 100, kAck, 3);
+        const Bytes sc = Segment(c, c.seq, data, 100, kAck, 4);
+        gro.Push(sa.data(), sa.size(), t0 + 200us);
+        gro.Push(sb.data(), sb.size(), t0 + 210us);
+        gro.Push(sc.data(), sc.size(), t0 + 220us);
+        Expect(out.size() == 2 && SrcPort(out[1].data) == a.sport, "hold: oldest flow evicted when full");
+        gro.Flush();
+        Expect(out.size() == 4 && !gro.Pending(), "hold: Flush releases the rest");
+
+        bool threw = false;
+        try
+        {
+            Gro::Options bad;
+            bad.flows = 0;
+            Gro broken(bad, Collect(out));
+        }
+        catch (const std::invalid_argument &)
+        {
+            threw = true;
+        }
+        Expect(threw, "hold: invalid options rejected");
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(69);
+    TestTraffic(false, rng);
+    TestTraffic(true, rng);
+    TestRules();
+    TestHold();
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("Gro: OK\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,299 @@
+// HeaderCompressorTest.cpp — сжатие заголовков: смена ECN, кадры вне очереди, круг поколений.
+
+#include "Core/HeaderCompressor.hpp"
+#include "Core/Headers.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    /**
+     * @brief Поток пакетов: RTP по UDP/IPv4 или ACK с данными по TCP/IPv6.
+     */
+    struct Source
+    {
+        bool          v6   = false;
+        std::uint16_t port = 40000;
+        std::uint16_t id   = 100;
+        std::uint32_t seq  = 1000;
+        std::uint32_t ack  = 5000;
+
+        std::vector<std::uint8_t> Next(std::uint8_t tos, std::uint8_t ttl, std::mt19937_64 &rng)
+        {
+            std::vector<std::uint8_t> p;
+            std::uint8_t *l4 = nullptr;
+            if (v6)
+            {
+                const std::size_t l4_len = Headers::ConstTcp::kMinSize + 24;
+                p.assign(Headers::ConstIp6::kSize + l4_len, 0);
+                p[0] = static_cast<std::uint8_t>(0x60 | tos >> 4);
+                p[1] = static_cast<std::uint8_t>(tos << 4 | 0x01);
+                p[2] = 0x23;
+                p[3] = 0x45;
+                Headers::Store16(p.data() + 4, static_cast<std::uint16_t>(l4_len));
+                p[6] = Headers::kProtoTcp;
+                p[7] = ttl;
+                for (std::size_t i = 8; i < Headers::ConstIp6::kSize; ++i)
+                {
+                    p[i] = static_cast<std::uint8_t>(i * 7 + port);
+                }
+                l4 = p.data() + Headers::ConstIp6::kSize;
+                Headers::Store16(l4, port);
+                Headers::Store16(l4 + 2, 443);
+                Headers::Store32(l4 + 4, seq);
+                Headers::Store32(l4 + 8, ack);
+                seq += 24;
+                ack += static_cast<std::uint32_t>(rng() % 3) * 1448;
+                l4[12] = 0x50;
+                l4[13] = 0x18;
+                Headers::Store16(l4 + 14, 502);
+            }
+            else
+            {
+                const std::size_t l4_len = Headers::ConstUdp::kSize + 32;
+                p.assign(Headers::ConstIp4::kMinSize + l4_len, 0);
+                p[0] = 0x45;
+                p[1] = tos;
+                Headers::Store16(p.data() + 2, static_cast<std::uint16_t>(p.size()));
+                Headers::Store16(p.data() + 4, id++);
+                p[6] = 0x40;
+                p[8] = ttl;
+                p[9] = Headers::kProtoUdp;
+                p[12] = 10;
+                p[15] = 2;
+                p[16] = 172;
+                p[17] = 16;
+                p[19] = static_cast<std::uint8_t>(port);
+                Headers::Store16(p.data() + 10, Checksum::Finish(Checksum::Reference(p.data(), Headers::ConstIp4::kMinSize)));
+                l4 = p.data() + Headers::ConstIp4::kMinSize;
+                Headers::Store16(l4, port);
+                Headers::Store16(l4 + 2, 5060);
+                Headers::Store16(l4 + 4, static_cast<std::uint16_t>(l4_len));
+            }
+            // Сумма L4 переносится как есть: здесь — любые байты, как и нагрузка.
+            const std::size_t check = v6 ? 16 : 6;
+            const std::size_t data  = v6 ? Headers::ConstTcp::kMinSize : Headers::ConstUdp::kSize;
+            l4[check]     = static_cast<std::uint8_t>(rng());
+            l4[check + 1] = static_cast<std::uint8_t>(rng());
+            for (std::uint8_t *d = l4 + data; d != p.data() + p.size(); ++d)
+            {
+                *d = static_cast<std::uint8_t>(rng());
+            }
+            return p;
+        }
+    };
+
+    /**
+     * @brief Канал в обе стороны: задержка кадра — случайная в пределах окна (кадры вне очереди), потери.
+     */
+    struct Link
+    {
+        std::size_t reorder   = 0;     ///< Наибольшая задержка кадра в пакетах.
+        std::size_t ack_delay = 0;     ///< Наибольшая задержка HeaderAck в пакетах.
+        double      loss      = 0.0;
+
+        std::uint64_t ok = 0, bad = 0, dropped = 0, undecodable = 0;
+    };
+
+    /**
+     * @brief Прогнать packets пакетов потоков sources через компрессор, канал и приёмник.
+     * @param tos Байт TOS пакета (DSCP и ECN) по его номеру.
+     * @param ttl TTL пакета по его номеру (смена — новый контекст).
+     */
+    template <typename Tos, typename Ttl>
+    void Run(HeaderCompressor &hc, HeaderDecompressor &hd, std::vector<Source> &sources, Link &link,
+             std::size_t packets, Tos tos, Ttl ttl, std::uint64_t seed)
+    {
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<> coin(0.0, 1.0);
+        using Frame = std::pair<std::vector<std::uint8_t>, std::vector<std::uint8_t>>;   // кадр, исходный пакет
+        std::multimap<std::size_t, Frame>                     wire;
+        std::multimap<std::size_t, std::vector<std::uint8_t>> acks;
+        const auto now = HeaderCompressor::Clock::now();
+
+        for (std::size_t n = 0; n < packets + link.reorder + link.ack_delay + 1; ++n)
+        {
+            if (n < packets)
+            {
+                Source &s = sources[rng() % sources.size()];
+                std::vector<std::uint8_t> pkt = s.Next(tos(n), ttl(n), rng);
+                std::vector<std::uint8_t> buf(pkt);
+                buf.resize(pkt.size() + HeaderCompressor::kContextOverhead);
+                buf.resize(hc.Compress(buf.data(), pkt.size(), buf.size(), now));
+                if (coin(rng) < link.loss)
+                    ++link.dropped;
+                else
+                    wire.emplace(n + rng() % (link.reorder + 1), Frame{std::move(buf), std::move(pkt)});
+            }
+
+            for (auto it = wire.begin(); it != wire.end() && it->first <= n; it = wire.erase(it))
+            {
+                const auto &[frame, orig] = it->second;
+                if (!CoreFrame::IsCoreFrame(frame.data(), frame.size()))
+                {
+                    ++(frame == orig ? link.ok : link.bad);
+                    continue;
+                }
+                CoreFrame::Type     type{};
+                const std::uint8_t *payload = nullptr;
+                std::size_t         payload_len = 0;
+                const std::uint8_t *out = nullptr;
+                std::size_t         out_len = 0;
+                if (!CoreFrame::Parse(frame.data(), frame.size(), &type, &payload, &payload_len) ||
+                    type != CoreFrame::Type::Header)
+                {
+                    ++link.bad;
+                    continue;
+                }
+                if (!hd.Decompress(payload, payload_len, &out, &out_len))
+                {
+                    ++link.undecodable;
+                    continue;
+                }
+                ++(out_len == orig.size() && std::memcmp(out, orig.data(), out_len) == 0 ? link.ok : link.bad);
+
+                std::uint8_t ack[256];
+                while (const std::size_t len = hd.Poll(ack, sizeof ack))
+                {
+                    if (coin(rng) >= link.loss)
+                        acks.emplace(n + rng() % (link.ack_delay + 1), std::vector<std::uint8_t>(ack, ack + len));
+                }
+            }
+
+            for (auto it = acks.begin(); it != acks.end() && it->first <= n; it = acks.erase(it))
+            {
+                hc.OnAck(it->second.data() + CoreFrame::kHeaderSize, it->second.size() - CoreFrame::kHeaderSize);
+            }
+        }
+    }
+
+    /// @brief Биты ECN меняются от пакета к пакету (ECT(0), CE): контекст потока остаётся прежним.
+    void TestEcnKeepsContext(bool v6)
+    {
+        HeaderCompressor   hc(HeaderCompressor::Options{});
+        HeaderDecompressor hd(HeaderDecompressor::Options{});
+        std::vector<Source> sources(1);
+        sources[0].v6 = v6;
+        Link link;
+        std::mt19937_64 marks(1);
+        Run(hc, hd, sources, link, 2000,
+            [&marks](std::size_t) { return static_cast<std::uint8_t>(0xB8 | (marks() % 4 == 0 ? 0x03 : 0x02)); },
+            [](std::size_t) { return std::uint8_t{64}; }, 2);
+
+        Expect(link.bad == 0, "ECN: packets restored exactly");
+        Expect(link.ok == 2000, "ECN: every packet delivered");
+        Expect(hc.GetStats().contexts == 1, "ECN: a single context per flow");
+        Expect(hc.GetStats().compressed >= 1990, "ECN: packets compressed after the first ack");
+    }
+
+    /**
+     * @brief Кадры и подтверждения вне очереди при частой смене опор и контекстов.
+     *
+     * refresh = 1 и смена TTL каждые несколько пакетов прокручивают поколения потока по кругу
+     * много раз; опоздавший кадр с полным контекстом или с предложением опоры не должен
+     * подменить более новую опору — иначе следующие кадры восстанавливаются с чужими полями.
+     */
+    void TestReorderAcrossGenerationWrap()
+    {
+        HeaderCompressor::Options copts;
+        copts.flows   = 16;
+        copts.refresh = 1;
+        HeaderCompressor   hc(copts);
+        HeaderDecompressor hd(HeaderDecompressor::Options{});
+        std::vector<Source> sources(4);
+        for (std::size_t i = 0; i < sources.size(); ++i)
+        {
+            sources[i].v6   = i % 2 != 0;
+            sources[i].port = static_cast<std::uint16_t>(40000 + i);
+        }
+        Link link;
+        link.reorder   = 48;
+        link.ack_delay = 32;
+        link.loss      = 0.02;
+        std::mt19937_64 marks(3);
+        Run(hc, hd, sources, link, 60000,
+            [&marks](std::size_t) { return static_cast<std::uint8_t>(marks() % 4 << 6 | marks() % 4); },
+            [](std::size_t n) { return static_cast<std::uint8_t>(64 - n / 5 % 2); }, 4);
+
+        Expect(link.bad == 0, "reorder: no packet restored with wrong fields");
+        Expect(link.ok + link.undecodable + link.dropped == 60000, "reorder: every packet accounted for");
+        Expect(hc.GetStats().refs > 4 * 255, "reorder: generations wrapped");
+        Expect(hd.GetStats().stale > 0, "reorder: late references refused");
+        Expect(link.ok > 60000 / 2, "reorder: most packets delivered");
+    }
+
+    /// @brief Полный контекст, пришедший после более нового, не принимается и не подтверждается.
+    void TestLateContextRefused()
+    {
+        HeaderCompressor   hc(HeaderCompressor::Options{});
+        HeaderDecompressor hd(HeaderDecompressor::Options{});
+        Source src;
+        std::mt19937_64 rng(5);
+        const auto now = HeaderCompressor::Clock::now();
+
+        auto compress = [&](std::uint8_t ttl) {
+            std::vector<std::uint8_t> pkt = src.Next(0, ttl, rng);
+            std::vector<std::uint8_t> buf(pkt);
+            buf.resize(pkt.size() + HeaderCompressor::kContextOverhead);
+            buf.resize(hc.Compress(buf.data(), pkt.size(), buf.size(), now));
+            return std::make_pair(buf, pkt);
+        };
+        auto deliver = [&](const std::vector<std::uint8_t> &frame, const std::vector<std::uint8_t> &orig) {
+            const std::uint8_t *out = nullptr;
+            std::size_t         out_len = 0;
+            return hd.Decompress(frame.data() + CoreFrame::kHeaderSize, frame.size() - CoreFrame::kHeaderSize,
+                                 &out, &out_len) &&
+                   out_len == orig.size() && std::memcmp(out, orig.data(), out_len) == 0;
+        };
+        auto ack = [&] {
+            std::uint8_t buf[64];
+            const std::size_t len = hd.Poll(buf, sizeof buf);
+            hc.OnAck(buf + CoreFrame::kHeaderSize, len > CoreFrame::kHeaderSize ? len - CoreFrame::kHeaderSize : 0);
+        };
+
+        const auto old_ir = compress(64);
+        const auto new_ir = compress(63);
+        Expect(deliver(new_ir.first, new_ir.second), "late IR: new context delivered");
+        ack();
+        Expect(deliver(old_ir.first, old_ir.second), "late IR: old packet still delivered");
+        Expect(hd.GetStats().stale == 1, "late IR: old context refused");
+        Expect(!hd.Pending(), "late IR: old context not acknowledged");
+
+        const auto next = compress(63);
+        Expect(next.first.size() < next.second.size(), "late IR: packet compressed against the new context");
+        Expect(deliver(next.first, next.second), "late IR: compressed packet restored exactly");
+    }
+}
+
+int main()
+{
+    TestEcnKeepsContext(false);
+    TestEcnKeepsContext(true);
+    TestReorderAcrossGenerationWrap();
+    TestLateContextRefused();
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::puts("HeaderCompressor: OK");
+    return EXIT_SUCCESS;
+}
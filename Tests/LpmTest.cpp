@@ -0,0 +1,517 @@
+// LpmTest.cpp — Lpm против эталона на хеш-таблицах по длинам префикса: 30 случайных таблиц IPv4/IPv6
+// (вложенные префиксы, случайные биты хоста, дубликаты, префиксы IPv6, покрывающие IPv4), поиск поштучно,
+// по IPv4 и пачками PacketMeta; замена LpmTable на лету под читателями.
+
+#include "Core/Lpm.hpp"
+#include "Core/PacketMeta.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using Address = std::array<std::uint8_t, 16>;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    constexpr unsigned kFallback = 0xFFFFFFFFu;
+
+    struct Key
+    {
+        std::uint64_t hi = 0;
+        std::uint64_t lo = 0;
+
+        bool operator==(const Key &) const = default;
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key &k) const noexcept
+        {
+            std::uint64_t x = k.hi * 0x9E3779B97F4A7C15ull ^ k.lo * 0xC2B2AE3D27D4EB4Full;
+            x ^= x >> 29;
+            x *= 0xBF58476D1CE4E5B9ull;
+            return static_cast<std::size_t>(x ^ x >> 32);
+        }
+    };
+
+    Key ToKey(const Address &a)
+    {
+        Key k;
+        for (std::size_t i = 0; i < 8; ++i)
+        {
+            k.hi = k.hi << 8 | a[i];
+            k.lo = k.lo << 8 | a[8 + i];
+        }
+        return k;
+    }
+
+    Key Mask(Key k, unsigned len)
+    {
+        if (len <= 64)
+        {
+            k.hi = len == 0 ? 0 : k.hi & ~std::uint64_t{0} << (64 - len);
+            k.lo = 0;
+        }
+        else
+        {
+            k.lo &= ~std::uint64_t{0} << (128 - len);
+        }
+        return k;
+    }
+
+    /**
+     * @brief Эталон: по хеш-таблице на каждую длину, поиск от самой длинной присутствующей длины.
+     *
+     * Перед хеш-таблицей — битовая карта по 16 битам хеша: без неё ~100 промахов на запрос IPv6
+     * делают эталон в десятки раз медленнее проверяемого кода.
+     */
+    class Reference
+    {
+    public:
+        explicit Reference(const std::vector<Lpm::Route> &routes)
+        {
+            for (const Lpm::Route &r : routes)
+            {
+                // Повтор префикса перезаписывает: побеждает последний, как в Lpm.
+                const Key k = Mask(ToKey(r.prefix.addr), r.prefix.len);
+                by_len_[r.prefix.len][k] = r.target;
+                lens_.insert(r.prefix.len);
+                const std::size_t h = KeyHash{}(k) & 0xFFFF;
+                filter_[r.prefix.len][h >> 6] |= std::uint64_t{1} << (h & 63);
+            }
+        }
+
+        unsigned Lookup(const Address &a) const
+        {
+            const Key k = ToKey(a);
+            for (auto it = lens_.rbegin(); it != lens_.rend(); ++it)
+            {
+                const Key         mk = Mask(k, *it);
+                const std::size_t h  = KeyHash{}(mk) & 0xFFFF;
+                if ((filter_[*it][h >> 6] >> (h & 63) & 1) == 0)
+                {
+                    continue;
+                }
+                const auto &m = by_len_[*it];
+                const auto  f = m.find(mk);
+                if (f != m.end())
+                {
+                    return f->second;
+                }
+            }
+            return kFallback;
+        }
+
+    private:
+        std::array<std::unordered_map<Key, unsigned, KeyHash>, 129> by_len_;
+        std::vector<std::array<std::uint64_t, 1024>>                filter_ = std::vector<std::array<std::uint64_t, 1024>>(129);
+        std::set<unsigned>                                         lens_;
+    };
+
+    Address Mapped(std::uint32_t v4)
+    {
+        Address a{};
+        a[10] = 0xFF;
+        a[11] = 0xFF;
+        for (std::size_t k = 0; k < 4; ++k)
+        {
+            a[12 + k] = static_cast<std::uint8_t>(v4 >> (24 - 8 * k));
+        }
+        return a;
+    }
+
+    bool IsMapped(const Address &a)
+    {
+        for (std::size_t k = 0; k < 10; ++k)
+        {
+            if (a[k] != 0)
+            {
+                return false;
+            }
+        }
+        return a[10] == 0xFF && a[11] == 0xFF;
+    }
+
+    std::uint32_t V4(const Address &a)
+    {
+        return static_cast<std::uint32_t>(a[12]) << 24 | static_cast<std::uint32_t>(a[13]) << 16
+             | static_cast<std::uint32_t>(a[14]) << 8 | a[15];
+    }
+
+    /// @brief Случайно перевернуть биты адреса после первых keep.
+    Address Perturb(Address a, unsigned keep, std::mt19937_64 &rng)
+    {
+        const unsigned flips = static_cast<unsigned>(rng() % 4);
+        for (unsigned f = 0; f < flips && keep < 128; ++f)
+        {
+            const unsigned bit = keep + static_cast<unsigned>(rng() % (128 - keep));
+            a[bit / 8] ^= static_cast<std::uint8_t>(0x80u >> (bit % 8));
+        }
+        return a;
+    }
+
+    /**
+     * @brief Таблица: kind 0 — IPv4, 1 — IPv6 в 2000::/3, 2 — смесь с префиксами IPv6 короче /96,
+     * покрывающими ::ffff:0:0/96. Префиксы растут от небольшого набора баз — много вложенных.
+     */
+    std::vector<Lpm::Route> MakeRoutes(unsigned kind, std::size_t count, std::mt19937_64 &rng,
+                                       std::vector<Address> &bases)
+    {
+        bases.clear();
+        for (int i = 0; i < 64; ++i)
+        {
+            const bool v4 = kind == 0 || (kind == 2 && i % 2 == 0);
+            Address    a{};
+            if (v4)
+            {
+                a = Mapped(static_cast<std::uint32_t>(rng()));
+            }
+            else
+            {
+                const std::uint64_t hi = std::uint64_t{2} << 60 | rng() >> 4;
+                const std::uint64_t lo = rng();
+                for (std::size_t k = 0; k < 8; ++k)
+                {
+                    a[k]     = static_cast<std::uint8_t>(hi >> (56 - 8 * k));
+                    a[8 + k] = static_cast<std::uint8_t>(lo >> (56 - 8 * k));
+                }
+            }
+            bases.push_back(a);
+        }
+
+        std::vector<Lpm::Route> routes;
+        routes.reserve(count + 8);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Lpm::Route    r;
+            const Address base = bases[rng() % bases.size()];
+            const bool    v4   = IsMapped(base);
+            // В смеси IPv4 не короче /8: иначе покрывающие префиксы IPv6 ни на что не влияют.
+            const unsigned min4 = kind == 2 ? 104 : 96;
+            r.prefix.len  = v4 ? min4 + static_cast<unsigned>(rng() % (129 - min4)) : static_cast<unsigned>(rng() % 129);
+            // Биты хоста за длиной остаются случайными: Lpm их игнорирует.
+            r.prefix.addr = Perturb(base, v4 ? 96 : 3, rng);
+            r.target      = static_cast<unsigned>(rng() % (Lpm::kMaxTarget + 1));
+            routes.push_back(r);
+            if (rng() % 32 == 0)
+            {
+                // Тот же префикс позже с другим target.
+                r.target = static_cast<unsigned>(rng() % 1000);
+                routes.push_back(r);
+            }
+        }
+        if (kind == 2)
+        {
+            for (const unsigned len : {0u, 64u, 80u, 95u})
+            {
+                Lpm::Route r;
+                r.prefix.len  = len;
+                r.prefix.addr = Mapped(0);
+                r.target      = 1000000 + len;
+                routes.push_back(r);
+            }
+        }
+        return routes;
+    }
+
+    /// @brief Адрес запроса: рядом с префиксом таблицы, рядом с базой или совсем случайный.
+    Address MakeQuery(const std::vector<Lpm::Route> &routes, const std::vector<Address> &bases,
+                      std::mt19937_64 &rng)
+    {
+        const unsigned pick = static_cast<unsigned>(rng() % 8);
+        if (pick < 5)
+        {
+            const Lpm::Route &r = routes[rng() % routes.size()];
+            return Perturb(r.prefix.addr, IsMapped(r.prefix.addr) ? 96 : 0, rng);
+        }
+        if (pick < 7)
+        {
+            const Address &b = bases[rng() % bases.size()];
+            return Perturb(b, IsMapped(b) ? 96 : 0, rng);
+        }
+        if (rng() % 2 == 0)
+        {
+            return Mapped(static_cast<std::uint32_t>(rng()));
+        }
+        Address a{};
+        for (auto &x : a)
+        {
+            x = static_cast<std::uint8_t>(rng());
+        }
+        return a;
+    }
+
+    /// @brief Пакет с адресом назначения a: UDP поверх IPv4 (для ::ffff:) или IPv6.
+    std::size_t MakePacket(const Address &a, std::uint8_t *p)
+    {
+        std::memset(p, 0, 64);
+        if (IsMapped(a))
+        {
+            p[0] = 0x45;
+            p[3] = 28;
+            p[9] = 17;
+            std::memcpy(p + 16, a.data() + 12, 4);
+            return 28;
+        }
+        p[0] = 0x60;
+        p[5] = 8;
+        p[6] = 17;
+        std::memcpy(p + 24, a.data(), 16);
+        return 48;
+    }
+
+    void TestRandomTables(std::mt19937_64 &rng)
+    {
+        constexpr int         kTables  = 30;
+        constexpr std::size_t kQueries = 200000;
+        constexpr std::size_t kBatch   = PacketMeta::kDefaultCapacity;
+
+        std::size_t single = 0, mapped = 0, batched = 0, queries = 0;
+        PacketMeta  meta(kBatch);
+        std::vector<std::uint8_t>         buf(kBatch * 64);
+        std::vector<const std::uint8_t *> pkts(kBatch);
+        std::vector<std::size_t>          lens(kBatch);
+        std::vector<unsigned>             want(kBatch), out(kBatch);
+
+        for (int t = 0; t < kTables; ++t)
+        {
+            const unsigned       kind  = static_cast<unsigned>(t % 3);
+            const std::size_t    count = t % 5 == 4 ? 10000 : 1 + rng() % 5000;
+            std::vector<Address> bases;
+            const auto           routes = MakeRoutes(kind, count, rng, bases);
+            const Lpm            lpm(routes);
+            const Reference      ref(routes);
+
+            for (std::size_t q = 0; q < kQueries; ++q)
+            {
+                const Address  a = MakeQuery(routes, bases, rng);
+                const unsigned w = ref.Lookup(a);
+                single += lpm.Lookup(a.data(), kFallback) != w;
+                if (IsMapped(a))
+                {
+                    mapped += lpm.Lookup4(V4(a), kFallback) != w;
+                }
+                ++queries;
+            }
+
+            // Пачки: LookupBatch и Lookup по PacketMeta против эталона; не IP — fallback.
+            for (int b = 0; b < 256; ++b)
+            {
+                for (std::size_t j = 0; j < kBatch; ++j)
+                {
+                    pkts[j] = &buf[j * 64];
+                    if (rng() % 64 == 0)
+                    {
+                        std::memset(&buf[j * 64], 0, 64);
+                        lens[j] = 20;
+                        want[j] = kFallback;
+                        continue;
+                    }
+                    const Address a = MakeQuery(routes, bases, rng);
+                    lens[j] = MakePacket(a, &buf[j * 64]);
+                    want[j] = ref.Lookup(a);
+                }
+                meta.Parse(pkts.data(), lens.data(), kBatch);
+                lpm.LookupBatch(meta, kFallback, out.data());
+                for (std::size_t j = 0; j < kBatch; ++j)
+                {
+                    batched += out[j] != want[j];
+                    batched += lpm.Lookup(meta, j, kFallback) != want[j];
+                }
+            }
+        }
+        Expect(queries == kTables * kQueries, "random: all queries ran");
+        Expect(single == 0, "random: Lookup matches the per-length reference");
+        Expect(mapped == 0, "random: Lookup4 matches the reference for IPv4");
+        Expect(batched == 0, "random: LookupBatch and Lookup(meta) match the reference");
+        if (single + mapped + batched != 0)
+        {
+            std::fprintf(stderr, "mismatches: single %zu, v4 %zu, batch %zu\n", single, mapped, batched);
+        }
+    }
+
+    void TestEdges()
+    {
+        const Lpm empty;
+        Expect(empty.Lookup4(0x01020304u, 7) == 7 && empty.Size() == 0, "edges: empty table returns fallback");
+
+        Lpm::Route bad;
+        bad.prefix.len = 129;
+        bool threw = false;
+        try
+        {
+            const Lpm lpm({bad});
+        }
+        catch (const std::invalid_argument &)
+        {
+            threw = true;
+        }
+        Expect(threw, "edges: prefix longer than 128 rejected");
+
+        bad.prefix.len = 0;
+        bad.target     = Lpm::kMaxTarget + 1;
+        threw          = false;
+        try
+        {
+            const Lpm lpm({bad});
+        }
+        catch (const std::invalid_argument &)
+        {
+            threw = true;
+        }
+        Expect(threw, "edges: target above kMaxTarget rejected");
+
+        // ::/0 действует и на IPv4, /32 IPv4 — точный адрес, /128 — точный адрес IPv6.
+        Lpm::Route all, host4, host6;
+        all.target       = 1;
+        host4.prefix     = {Mapped(0x0A000001u), 128};
+        host4.target     = 2;
+        host6.prefix.len = 128;
+        host6.prefix.addr[0] = 0x20;
+        host6.prefix.addr[15] = 1;
+        host6.target     = 3;
+        const Lpm lpm({all, host4, host6});
+        Address   other6 = host6.prefix.addr;
+        other6[15] = 2;
+        Expect(lpm.Lookup4(0x0A000001u, 0) == 2 && lpm.Lookup4(0x0A000002u, 0) == 1,
+               "edges: /32 and ::/0 for IPv4");
+        Expect(lpm.Lookup(host6.prefix.addr.data(), 0) == 3 && lpm.Lookup(other6.data(), 0) == 1,
+               "edges: /128 and ::/0 for IPv6");
+    }
+
+    /**
+     * @brief LpmTable: писатель чередует две версии, читатели видят результат одной из них,
+     * а пачка целиком принадлежит одной версии (у версии A target чётные, у B — нечётные).
+     */
+    void TestTableUpdate(std::mt19937_64 &rng)
+    {
+        std::vector<Address> bases;
+        std::vector<Lpm::Route> a = MakeRoutes(2, 2000, rng, bases);
+        for (Lpm::Route &r : a)
+        {
+            r.target = (r.target % 1000000) * 2;
+        }
+        Lpm::Route all;
+        a.push_back(all);
+        std::vector<Lpm::Route> b = a;
+        for (Lpm::Route &r : b)
+        {
+            ++r.target;
+        }
+        const Reference ref_a(a), ref_b(b);
+
+        constexpr std::size_t kBatch = PacketMeta::kDefaultCapacity;
+        std::vector<Address>  queries;
+        std::vector<unsigned> want_a, want_b;
+        for (int i = 0; i < 4096; ++i)
+        {
+            queries.push_back(MakeQuery(a, bases, rng));
+            want_a.push_back(ref_a.Lookup(queries.back()));
+            want_b.push_back(ref_b.Lookup(queries.back()));
+        }
+
+        LpmTable          table(a);
+        std::atomic<bool> stop{false};
+        std::atomic<int>  torn{0}, wrong{0};
+        std::atomic<long> lookups{0};
+        auto reader = [&](unsigned seed) {
+            std::mt19937_64                   local(seed);
+            PacketMeta                        meta(kBatch);
+            std::vector<std::uint8_t>         buf(kBatch * 64);
+            std::vector<const std::uint8_t *> pkts(kBatch);
+            std::vector<std::size_t>          lens(kBatch);
+            std::vector<unsigned>             out(kBatch);
+            std::vector<std::size_t>          qs(kBatch);
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                for (std::size_t j = 0; j < kBatch; ++j)
+                {
+                    qs[j]   = local() % queries.size();
+                    pkts[j] = &buf[j * 64];
+                    lens[j] = MakePacket(queries[qs[j]], &buf[j * 64]);
+                }
+                meta.Parse(pkts.data(), lens.data(), kBatch);
+                table.LookupBatch(meta, kFallback, out.data());
+                const unsigned version = out[0] & 1;
+                for (std::size_t j = 0; j < kBatch; ++j)
+                {
+                    const std::vector<unsigned> &want = version == 0 ? want_a : want_b;
+                    torn  += (out[j] & 1) != version;
+                    wrong += out[j] != want[qs[j]];
+
+                    const unsigned one = table.Lookup(queries[qs[j]].data(), kFallback);
+                    wrong += one != want_a[qs[j]] && one != want_b[qs[j]];
+                }
+                lookups += 2 * kBatch;
+            }
+        };
+        std::vector<std::thread> readers;
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            readers.emplace_back(reader, 100 + i);
+        }
+        for (int round = 0; round < 10; ++round)
+        {
+            table.Update(round % 2 == 0 ? b : a);
+        }
+        stop = true;
+        for (std::thread &t : readers)
+        {
+            t.join();
+        }
+        Expect(torn == 0, "update: a batch never mixes two versions");
+        Expect(wrong == 0, "update: every result belongs to the old or the new table");
+        Expect(lookups > 0, "update: readers ran during replacement");
+        Expect(table.Size() == a.size(), "update: final version in place");
+
+        Lpm::Route bad;
+        bad.prefix.len = 200;
+        bool threw = false;
+        try
+        {
+            table.Update({bad});
+        }
+        catch (const std::invalid_argument &)
+        {
+            threw = true;
+        }
+        Expect(threw && table.Size() == a.size(), "update: rejected table keeps the previous one");
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(73);
+    TestRandomTables(rng);
+    TestEdges();
+    TestTableUpdate(rng);
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("Lpm: OK\n");
+    return EXIT_SUCCESS;
+}
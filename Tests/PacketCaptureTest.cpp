@@ -0,0 +1,468 @@
+// PacketCaptureTest.cpp — PacketCapture: несколько производителей оборачивают кольцо в 1 МиБ; файл pcapng
+// разбирается заново — длины блоков, заполнители посреди захвата, порядок записей каждого производителя и их
+// содержимое после Stop; snaplen, фильтр, ошибки Start.
+
+#include "Core/PacketCapture.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Bytes = std::vector<std::uint8_t>;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    constexpr std::uint32_t kShb    = 0x0A0D0D0A;
+    constexpr std::uint32_t kIdb    = 0x00000001;
+    constexpr std::uint32_t kEpb    = 0x00000006;
+    constexpr std::uint32_t kCustom = 0x00000BAD;
+
+    constexpr std::size_t kProducers = 4;
+    constexpr std::size_t kPerRound  = 3000;
+
+    std::uint32_t Load32(const std::uint8_t *p)
+    {
+        std::uint32_t v = 0;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    std::uint64_t Load64(const std::uint8_t *p)
+    {
+        std::uint64_t v = 0;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    /// @brief Длина пакета производителя по номеру (20..1419 байт, детерминированно).
+    std::size_t PacketLength(std::uint32_t producer, std::uint64_t seq)
+    {
+        return 20 + static_cast<std::size_t>((seq * 2654435761u + producer * 40503u) % 1400);
+    }
+
+    /// @brief Пакет: 0x45, номер производителя, номер пакета, дальше — байты от (производитель, номер).
+    Bytes MakePacket(std::uint32_t producer, std::uint64_t seq)
+    {
+        Bytes p(PacketLength(producer, seq));
+        p[0] = 0x45;
+        std::memcpy(&p[4], &producer, sizeof(producer));
+        std::memcpy(&p[8], &seq, sizeof(seq));
+        for (std::size_t k = 16; k < p.size(); ++k)
+        {
+            p[k] = static_cast<std::uint8_t>(k * 31 + seq * 7 + producer);
+        }
+        return p;
+    }
+
+    PacketCapture::Direction DirectionOf(std::uint64_t seq)
+    {
+        return seq % 3 == 0 ? PacketCapture::Direction::Inbound : PacketCapture::Direction::Outbound;
+    }
+
+    /// @brief Запись EPB из файла.
+    struct Record
+    {
+        std::uint32_t producer = 0;
+        std::uint64_t seq = 0;
+        std::uint32_t caplen = 0;
+        std::uint32_t len = 0;
+        std::uint32_t dir = 0;
+        bool          intact = false;   ///< Данные и длины совпадают с исходным пакетом.
+    };
+
+    /// @brief Результат разбора файла pcapng.
+    struct Capture
+    {
+        bool                ok = false;   ///< Все блоки корректны.
+        std::size_t         fillers = 0;
+        std::vector<Record> records;
+    };
+
+    Bytes ReadFile(const std::filesystem::path &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return Bytes(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    /**
+     * @brief Разобрать pcapng: SHB, IDB (LINKTYPE_RAW), затем EPB и заполнители (пропускаются).
+     * @param snaplen Ожидаемый snaplen (0 — пакеты целиком).
+     */
+    Capture Parse(const Bytes &f, std::uint32_t snaplen)
+    {
+        Capture c;
+        std::size_t off = 0;
+        std::size_t n = 0;
+        while (off < f.size())
+        {
+            if (f.size() - off < 12)
+            {
+                return c;
+            }
+            const std::uint32_t type = Load32(&f[off]);
+            const std::uint32_t len  = Load32(&f[off + 4]);
+            if (len < 12 || len % 4 != 0 || len > f.size() - off || Load32(&f[off + len - 4]) != len)
+            {
+                return c;
+            }
+            const std::uint8_t *b = &f[off];
+            if (n == 0)
+            {
+                if (type != kShb || Load32(b + 8) != 0x1A2B3C4D || Load64(b + 16) != ~std::uint64_t{0})
+                {
+                    return c;
+                }
+            }
+            else if (n == 1)
+            {
+                if (type != kIdb || (Load32(b + 8) & 0xFFFF) != 101 || Load32(b + 12) != snaplen)
+                {
+                    return c;
+                }
+            }
+            else if (type == kCustom)
+            {
+                if (len < 16 || Load32(b + 8) != 32473)
+                {
+                    return c;
+                }
+                ++c.fillers;
+            }
+            else if (type == kEpb)
+            {
+                Record r;
+                r.caplen = Load32(b + 20);
+                r.len    = Load32(b + 24);
+                const std::size_t pad = (r.caplen + 3u) & ~3u;
+                if (len != 44 + pad || Load32(b + 8) != 0 || r.caplen < 16 ||
+                    Load32(b + 28 + pad) != (4u << 16 | 2u) || Load32(b + 28 + pad + 8) != 0)
+                {
+                    return c;
+                }
+                r.dir = Load32(b + 28 + pad + 4);
+                std::memcpy(&r.producer, b + 28 + 4, sizeof(r.producer));
+                std::memcpy(&r.seq, b + 28 + 8, sizeof(r.seq));
+                if (r.producer < kProducers)
+                {
+                    const Bytes want = MakePacket(r.producer, r.seq);
+                    const std::size_t cap = snaplen == 0 ? want.size() : std::min<std::size_t>(want.size(), snaplen);
+                    r.intact = r.len == want.size() && r.caplen == cap && std::memcmp(b + 28, want.data(), cap) == 0 &&
+                               r.dir == static_cast<std::uint32_t>(DirectionOf(r.seq));
+                }
+                c.records.push_back(r);
+            }
+            else
+            {
+                return c;
+            }
+            off += len;
+            ++n;
+        }
+        c.ok = n >= 2;
+        return c;
+    }
+
+    /**
+     * @brief Каждый производитель шлёт count пакетов, начиная с номера first. Производители идут почти в ногу
+     * (отставание не больше 16 пакетов): на одном ядре иначе поток успевает заполнить кольцо один.
+     */
+    void Produce(PacketCapture &cap, std::uint64_t first, std::size_t count)
+    {
+        std::vector<std::atomic<std::uint64_t>> done(kProducers);
+        std::vector<std::thread>                threads;
+        for (std::uint32_t t = 0; t < kProducers; ++t)
+        {
+            threads.emplace_back([&cap, &done, t, first, count] {
+                for (std::uint64_t s = 0; s < count; ++s)
+                {
+                    for (std::size_t u = 0; u < kProducers; ++u)
+                    {
+                        while (done[u].load() + 16 < s)
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                    const Bytes p = MakePacket(t, first + s);
+                    cap.Tap(p.data(), p.size(), DirectionOf(first + s));
+                    done[t].store(s + 1);
+                }
+            });
+        }
+        for (auto &th : threads)
+        {
+            th.join();
+        }
+    }
+
+    /// @brief Дождаться, пока фоновый поток разберёт всё предъявленное (packets + dropped == taps).
+    bool WaitDrained(const PacketCapture &cap, std::uint64_t taps)
+    {
+        for (int k = 0; k < 5000; ++k)
+        {
+            const PacketCapture::Stats s = cap.GetStats();
+            // packets растёт после заполнителя пачки: к этому моменту кольцо в файле замкнуто.
+            if (s.packets + s.dropped == taps)
+            {
+                return true;
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+        return false;
+    }
+
+    /**
+     * @brief Номера каждого производителя в порядке файла; rotations — сколько раз номер убывает
+     * (в кольце посреди захвата допустим один спад на месте головы записи).
+     */
+    bool PerProducerOrder(const std::vector<Record> &records, std::size_t rotations)
+    {
+        std::vector<std::uint64_t> last(kProducers, 0);
+        std::vector<bool>          seen(kProducers, false);
+        std::vector<std::size_t>   falls(kProducers, 0);
+        for (const Record &r : records)
+        {
+            if (r.producer >= kProducers)
+            {
+                return false;
+            }
+            if (seen[r.producer] && r.seq <= last[r.producer])
+            {
+                ++falls[r.producer];
+            }
+            seen[r.producer] = true;
+            last[r.producer] = r.seq;
+        }
+        for (std::size_t t = 0; t < kProducers; ++t)
+        {
+            if (!seen[t] || falls[t] > rotations)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool AllIntact(const std::vector<Record> &records)
+    {
+        for (const Record &r : records)
+        {
+            if (!r.intact)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Четыре производителя, два раунда по 3000 пакетов (около 8 МиБ, несколько оборотов кольца 1 МиБ):
+     * снимок файла между раундами, затем файл после Stop.
+     */
+    void TestWrap(const std::filesystem::path &path)
+    {
+        PacketCapture cap;
+        PacketCapture::Options opts;
+        opts.path       = path.string();
+        opts.ring_bytes = std::size_t{1} << 20;
+        opts.max_packet = 1500;
+        opts.queue      = 16384;
+        cap.Start(opts);
+        Expect(cap.Active(), "wrap: active after Start");
+
+        Produce(cap, 0, kPerRound);
+        Expect(WaitDrained(cap, kProducers * kPerRound), "wrap: first round drained");
+
+        // Между пачками кольцо в файле — корректный pcapng: блоки кольца от головы записи с заполнителями.
+        const Bytes mid = ReadFile(path);
+        const Capture snap = Parse(mid, 0);
+        Expect(snap.ok, "wrap: mid-capture file parses");
+        Expect(snap.fillers >= 1, "wrap: mid-capture ring has filler blocks");
+        Expect(mid.size() > opts.ring_bytes && mid.size() < opts.ring_bytes + 512, "wrap: mid-capture file is ring-sized");
+        Expect(AllIntact(snap.records), "wrap: mid-capture records intact");
+        Expect(PerProducerOrder(snap.records, 1), "wrap: mid-capture per-producer order rotates at most once");
+
+        Produce(cap, kPerRound, kPerRound);
+        Expect(cap.Stop(), "wrap: Stop");
+        Expect(!cap.Stop(), "wrap: second Stop is a no-op");
+        const PacketCapture::Stats s = cap.GetStats();
+        Expect(!s.active && s.packets + s.dropped == 2 * kProducers * kPerRound, "wrap: every tap accounted for");
+        Expect(s.wraps >= 3, "wrap: ring wrapped several times");
+        // Очередь больше раунда, а первый раунд разобран: отбросов нет.
+        Expect(s.dropped == 0, "wrap: no drops");
+
+        const Bytes     file = ReadFile(path);
+        const Capture   fin  = Parse(file, 0);
+        std::uint64_t   bytes = 0;
+        for (const Record &r : fin.records)
+        {
+            bytes += 44 + ((r.caplen + 3u) & ~3u);
+        }
+        Expect(fin.ok, "wrap: final file parses");
+        Expect(fin.fillers == 0, "wrap: Stop drops filler blocks");
+        Expect(bytes > opts.ring_bytes * 3 / 4 && bytes <= opts.ring_bytes, "wrap: final file keeps about a ring of data");
+        Expect(fin.records.size() < s.packets, "wrap: oldest records overwritten");
+        Expect(AllIntact(fin.records), "wrap: final records intact");
+        Expect(PerProducerOrder(fin.records, 0), "wrap: per-producer order increasing after Stop");
+
+        // У каждого производителя в файле — непрерывный хвост до последнего пакета.
+        std::vector<std::uint64_t> next(kProducers, 0);
+        std::vector<bool>          seen(kProducers, false);
+        bool                       contiguous = true;
+        for (const Record &r : fin.records)
+        {
+            contiguous &= !seen[r.producer] || r.seq == next[r.producer];
+            seen[r.producer] = true;
+            next[r.producer] = r.seq + 1;
+        }
+        for (std::size_t t = 0; t < kProducers; ++t)
+        {
+            contiguous &= next[t] == 2 * kPerRound;
+        }
+        Expect(contiguous, "wrap: per-producer tail is contiguous up to the last packet");
+    }
+
+    /// @brief snaplen режет данные, но не len; фильтр считается в filtered; повторный Start после Stop.
+    void TestSnaplenAndFilter(const std::filesystem::path &path)
+    {
+        PacketCapture cap;
+        PacketCapture::Options opts;
+        opts.path    = path.string();
+        opts.snaplen = 64;
+        opts.filter  = "greater 700 or in";
+        for (int round = 0; round < 2; ++round)
+        {
+            cap.Start(opts);
+            std::size_t   pass = 0;
+            std::uint64_t bytes = 0;
+            for (std::uint64_t s = 0; s < 500; ++s)
+            {
+                const Bytes p = MakePacket(1, s);
+                cap.Tap(p.data(), p.size(), DirectionOf(s));
+                if (p.size() >= 700 || DirectionOf(s) == PacketCapture::Direction::Inbound)
+                {
+                    ++pass;
+                    bytes += std::min<std::size_t>(p.size(), 64);
+                }
+            }
+            cap.Stop();
+            const PacketCapture::Stats s = cap.GetStats();
+            const Capture c = Parse(ReadFile(path), 64);
+            bool lens = true;
+            for (const Record &r : c.records)
+            {
+                lens &= r.len == PacketLength(1, r.seq) && (r.len >= 700 || r.dir == 1);
+            }
+            Expect(c.ok && c.fillers == 0 && AllIntact(c.records), "snaplen: file parses, records cut to 64");
+            Expect(s.packets == pass && s.filtered == 500 - pass && s.dropped == 0 && c.records.size() == pass,
+                   "snaplen: filter counts");
+            Expect(lens, "snaplen: original lengths and filter applied");
+            Expect(s.bytes == bytes, "snaplen: bytes after snaplen");
+        }
+
+        // Без захвата Tap ничего не делает.
+        const PacketCapture::Stats before = cap.GetStats();
+        const Bytes p = MakePacket(0, 0);
+        cap.Tap(p.data(), p.size(), PacketCapture::Direction::Inbound);
+        const PacketCapture::Stats after = cap.GetStats();
+        Expect(after.packets == before.packets && after.filtered == before.filtered && after.dropped == before.dropped,
+               "snaplen: Tap after Stop is ignored");
+    }
+
+    void TestErrors(const std::filesystem::path &path)
+    {
+        PacketCapture cap;
+        auto throws_invalid = [&cap](const PacketCapture::Options &o) {
+            try
+            {
+                cap.Start(o);
+            }
+            catch (const std::invalid_argument &)
+            {
+                return true;
+            }
+            return false;
+        };
+        PacketCapture::Options opts;
+        opts.path = path.string();
+
+        PacketCapture::Options bad = opts;
+        bad.ring_bytes = (std::size_t{1} << 20) - 4;
+        Expect(throws_invalid(bad), "errors: ring below 1 MiB");
+        bad = opts;
+        bad.path.clear();
+        Expect(throws_invalid(bad), "errors: empty path");
+        bad = opts;
+        bad.queue = 8;
+        Expect(throws_invalid(bad), "errors: queue too small");
+        bad = opts;
+        bad.filter = "port (";
+        Expect(throws_invalid(bad), "errors: bad filter");
+        Expect(!cap.Active(), "errors: not started");
+
+        cap.Start(opts);
+        bool logic = false;
+        try
+        {
+            cap.Start(opts);
+        }
+        catch (const std::logic_error &)
+        {
+            logic = true;
+        }
+        Expect(logic, "errors: second Start throws");
+        Expect(cap.Stop(), "errors: Stop");
+        const Capture c = Parse(ReadFile(path), 0);
+        Expect(c.ok && c.records.empty() && c.fillers == 0, "errors: empty capture is SHB + IDB");
+    }
+}
+
+int main()
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() /
+        ("PacketCaptureTest-" + std::to_string(std::random_device{}()) + ".pcapng");
+    try
+    {
+        TestWrap(path);
+        TestSnaplenAndFilter(path);
+        TestErrors(path);
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "FAIL: exception: %s\n", e.what());
+        ++failures;
+    }
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("PacketCapture: OK\n");
+    return EXIT_SUCCESS;
+}
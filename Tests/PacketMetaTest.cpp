@@ -0,0 +1,387 @@
+// PacketMetaTest.cpp — PacketMeta: столбцы пачки (AVX2 по четвёркам, где есть) против скалярного разбора по одному
+// пакету на 200 000 случайных пакетах — IPv4 простые, с опциями и фрагменты, IPv6 с цепочками расширений, обрезанные
+// и не IP; стадии по метаданным (Classifier, FlowTable::ExtractKey, FqCodel::FlowHash) против разбора байт.
+
+#include "Core/Classifier.hpp"
+#include "Core/FlowTable.hpp"
+#include "Core/FqCodel.hpp"
+#include "Core/Headers.hpp"
+#include "Core/PacketMeta.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    using Bytes = std::vector<std::uint8_t>;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    constexpr std::uint8_t kL4[] = {6, 17, 132, 136, 1, 58, 47};
+
+    /// @brief Небольшой набор адресов и портов: правила классификатора совпадают часто.
+    std::uint8_t Pick(std::mt19937_64 &rng)
+    {
+        return static_cast<std::uint8_t>(rng() % 4 == 0 ? rng() : rng() % 4);
+    }
+
+    /// @brief IPv4: простой, с опциями, фрагмент (первый или нет), с битыми IHL.
+    Bytes Ipv4(std::mt19937_64 &rng, bool simple)
+    {
+        unsigned ihl = 5;
+        if (!simple)
+        {
+            ihl = rng() % 8 == 0 ? static_cast<unsigned>(rng() % 5) : 5 + static_cast<unsigned>(rng() % 11);
+        }
+        const std::size_t hdr = std::max(20u, ihl * 4);
+        Bytes p(hdr + 8 + rng() % 64);
+        for (auto &b : p)
+        {
+            b = Pick(rng);
+        }
+        p[0] = static_cast<std::uint8_t>(0x40 | ihl);
+        p[1] = static_cast<std::uint8_t>(rng());
+        p[2] = static_cast<std::uint8_t>(p.size() >> 8);
+        p[3] = static_cast<std::uint8_t>(p.size());
+        p[6] = 0x40;
+        p[7] = 0;
+        if (!simple && rng() % 3 == 0)
+        {
+            // MF и/или смещение.
+            const unsigned off = rng() % 2 == 0 ? 0 : 1 + static_cast<unsigned>(rng() % 0x1FFF);
+            p[6] = static_cast<std::uint8_t>(0x20 | off >> 8);
+            p[7] = static_cast<std::uint8_t>(off);
+        }
+        p[9] = kL4[rng() % std::size(kL4)];
+        return p;
+    }
+
+    /// @brief IPv6 с цепочкой до десяти заголовков расширений (hop-by-hop, routing, dest, fragment, AH).
+    Bytes Ipv6(std::mt19937_64 &rng)
+    {
+        constexpr std::uint8_t kExt[] = {0, 43, 60, 44, 51};
+        Bytes p(40);
+        for (std::size_t k = 0; k < 40; ++k)
+        {
+            p[k] = Pick(rng);
+        }
+        p[0] = static_cast<std::uint8_t>(0x60 | (rng() & 0x0F));
+        p[1] = static_cast<std::uint8_t>(rng());
+        std::size_t   nh_at = 6;
+        const unsigned chain = rng() % 2 == 0 ? 0 : static_cast<unsigned>(rng() % 11);
+        for (unsigned h = 0; h < chain; ++h)
+        {
+            const std::uint8_t ext = kExt[rng() % std::size(kExt)];
+            p[nh_at]               = ext;
+            const std::size_t at   = p.size();
+            std::size_t       size = 8;
+            if (ext == 51)
+            {
+                size = 4 * (2 + rng() % 4);
+            }
+            else if (ext != 44)
+            {
+                size = 8 * (1 + rng() % 3);
+            }
+            p.resize(at + size);
+            for (std::size_t k = at; k < p.size(); ++k)
+            {
+                p[k] = Pick(rng);
+            }
+            if (ext == 51)
+            {
+                p[at + 1] = static_cast<std::uint8_t>(size / 4 - 2);
+            }
+            else if (ext == 44)
+            {
+                // Первый фрагмент (смещение 0) или продолжение.
+                const unsigned off = rng() % 2 == 0 ? 0 : 1 + static_cast<unsigned>(rng() % 0x1FFF);
+                p[at + 2] = static_cast<std::uint8_t>(off >> 5);
+                p[at + 3] = static_cast<std::uint8_t>((off << 3) | (rng() & 1));
+            }
+            else
+            {
+                p[at + 1] = static_cast<std::uint8_t>(size / 8 - 1);
+            }
+            nh_at = at;
+        }
+        p[nh_at] = kL4[rng() % std::size(kL4)];
+        const std::size_t l4 = p.size();
+        p.resize(l4 + 8 + rng() % 64);
+        for (std::size_t k = l4; k < p.size(); ++k)
+        {
+            p[k] = Pick(rng);
+        }
+        p[4] = static_cast<std::uint8_t>((p.size() - 40) >> 8);
+        p[5] = static_cast<std::uint8_t>(p.size() - 40);
+        return p;
+    }
+
+    /**
+     * @brief Случайный пакет; часть обрезается на случайной длине, часть — не IP.
+     * @param simple Простой IPv4 (чтобы собирались целые четвёрки для AVX2).
+     */
+    Bytes RandomPacket(std::mt19937_64 &rng, bool simple)
+    {
+        Bytes p;
+        if (simple)
+        {
+            p = Ipv4(rng, true);
+            if (rng() % 16 == 0)
+            {
+                p.resize(20 + rng() % 8);
+            }
+            return p;
+        }
+        const unsigned kind = static_cast<unsigned>(rng() % 10);
+        if (kind < 3)
+        {
+            p = Ipv4(rng, false);
+        }
+        else if (kind < 8)
+        {
+            p = Ipv6(rng);
+        }
+        else
+        {
+            p.resize(rng() % 80);
+            for (auto &b : p)
+            {
+                b = static_cast<std::uint8_t>(rng());
+            }
+        }
+        if (rng() % 5 == 0)
+        {
+            p.resize(rng() % (p.size() + 1));
+        }
+        return p;
+    }
+
+    /// @brief Совпадают ли столбцы записи i двух разборов.
+    bool SameRow(const PacketMeta &a, std::size_t i, const PacketMeta &b, std::size_t j)
+    {
+        return a.Flags(i) == b.Flags(j) && a.NextHeader(i) == b.NextHeader(j) && a.Proto(i) == b.Proto(j) &&
+               a.Dscp(i) == b.Dscp(j) && a.Ecn(i) == b.Ecn(j) && a.Length(i) == b.Length(j) &&
+               a.IpLength(i) == b.IpLength(j) && a.L4Offset(i) == b.L4Offset(j) &&
+               a.SrcPort(i) == b.SrcPort(j) && a.DstPort(i) == b.DstPort(j) &&
+               std::memcmp(a.Src(i), b.Src(j), 16) == 0 && std::memcmp(a.Dst(i), b.Dst(j), 16) == 0;
+    }
+
+    /// @brief IPv4 с неверным IHL: по метаданным — не IP, по байтам классификатор его ещё разбирает.
+    bool BadIhl(const Bytes &p)
+    {
+        return p.size() >= 20 && (p[0] >> 4) == 4 &&
+               ((p[0] & 0x0F) < 5 || p.size() < static_cast<std::size_t>(p[0] & 0x0F) * 4);
+    }
+
+    std::vector<Classifier::Rule> MakeRules(std::mt19937_64 &rng)
+    {
+        std::vector<Classifier::Rule> rules;
+        for (unsigned r = 0; r < 40; ++r)
+        {
+            Classifier::Rule rule;
+            rule.target = r;
+            if (rng() % 3 == 0)
+            {
+                rule.proto = kL4[rng() % std::size(kL4)];
+            }
+            if (rng() % 4 == 0)
+            {
+                rule.dscp = static_cast<int>(rng() % 64);
+            }
+            if (rng() % 2 == 0)
+            {
+                Classifier::Prefix &pfx = rng() % 2 == 0 ? rule.src : rule.dst;
+                if (rng() % 2 == 0)
+                {
+                    pfx.addr[10] = pfx.addr[11] = 0xFF;
+                    pfx.addr[12] = static_cast<std::uint8_t>(rng() % 4);
+                    pfx.len      = 96 + 6 + static_cast<unsigned>(rng() % 3);
+                }
+                else
+                {
+                    pfx.addr[0] = static_cast<std::uint8_t>(rng() % 4);
+                    pfx.len     = 6;
+                }
+            }
+            if (rng() % 3 == 0)
+            {
+                rule.dport_lo = static_cast<std::uint16_t>(rng() % 800);
+                rule.dport_hi = static_cast<std::uint16_t>(rule.dport_lo + rng() % 800);
+            }
+            if (rng() % 5 == 0)
+            {
+                rule.sport_lo = static_cast<std::uint16_t>(rng() % 1000);
+                rule.sport_hi = static_cast<std::uint16_t>(rule.sport_lo + rng() % 30000);
+            }
+            rules.push_back(rule);
+        }
+        return rules;
+    }
+
+    /**
+     * @brief 200 000 пакетов пачками по 64: разбор пачки (AVX2 по четвёркам) против разбора по одному
+     * (скалярный путь), стадии по метаданным против разбора байт.
+     */
+    void TestRandom(std::mt19937_64 &rng)
+    {
+        constexpr std::size_t kPackets = 200000;
+        constexpr std::size_t kBatch   = PacketMeta::kDefaultCapacity;
+        PacketMeta batch(kBatch), one(1);
+        const Classifier cls(MakeRules(rng));
+
+        std::size_t columns = 0, classifier = 0, keys = 0, hashes = 0, simple_quads = 0, matched = 0;
+        std::vector<Bytes>                pkts(kBatch);
+        std::vector<const std::uint8_t *> ptrs(kBatch);
+        std::vector<std::size_t>          lens(kBatch);
+        for (std::size_t done = 0; done < kPackets; done += kBatch)
+        {
+            // Половина пачек — почти одни простые IPv4 (целые четвёрки), остальные — смесь.
+            const bool mostly_simple = rng() % 2 == 0;
+            for (std::size_t j = 0; j < kBatch; ++j)
+            {
+                pkts[j] = RandomPacket(rng, mostly_simple ? rng() % 32 != 0 : rng() % 4 == 0);
+                // Точно по длине: чтение за концом пакета поймает ASan.
+                pkts[j].shrink_to_fit();
+                ptrs[j] = pkts[j].data();
+                lens[j] = pkts[j].size();
+            }
+            Expect(batch.Parse(ptrs.data(), lens.data(), kBatch) == kBatch, "random: whole batch parsed");
+            for (std::size_t j = 0; j < kBatch; ++j)
+            {
+                one.Parse(&ptrs[j], &lens[j], 1);
+                columns += SameRow(batch, j, one, 0) ? 0u : 1u;
+
+                if (!BadIhl(pkts[j]))
+                {
+                    const int want = cls.MatchIndex(ptrs[j], lens[j]);
+                    classifier += cls.MatchIndex(batch, j) == want ? 0u : 1u;
+                    matched += want >= 0 ? 1u : 0u;
+                }
+                FlowTable::Key kb, km;
+                const bool     rb = FlowTable::ExtractKey(ptrs[j], lens[j], &kb);
+                const bool     rm = FlowTable::ExtractKey(batch, j, &km);
+                keys += rb == rm && kb == km ? 0u : 1u;
+                if (batch.Ip(j))
+                {
+                    hashes += FqCodel::FlowHash(ptrs[j], lens[j], 0x5EED) == FqCodel::FlowHash(batch, j, 0x5EED) ? 0u : 1u;
+                }
+            }
+            for (std::size_t q = 0; q + 4 <= kBatch; q += 4)
+            {
+                bool all = true;
+                for (std::size_t k = q; k < q + 4; ++k)
+                {
+                    all &= lens[k] >= 24 && pkts[k][0] == 0x45 && (Headers::Load16(&pkts[k][6]) & 0x3FFF) == 0;
+                }
+                simple_quads += all ? 1u : 0u;
+            }
+        }
+        Expect(columns == 0, "random: batch columns equal the one-by-one scalar parse");
+        Expect(classifier == 0, "random: Classifier on metadata equals the byte path");
+        Expect(keys == 0, "random: FlowTable::ExtractKey on metadata equals the byte path");
+        Expect(hashes == 0, "random: FqCodel::FlowHash on metadata equals the byte path");
+        Expect(simple_quads > kPackets / 16, "random: many all-simple IPv4 quads (vector path exercised)");
+        Expect(matched > kPackets / 10, "random: classifier rules actually match");
+    }
+
+    /// @brief Значения полей на разобранных вручную пакетах.
+    void TestFields()
+    {
+        // IPv4 TCP, DSCP 46, ECN 1, 10.0.0.1:1234 -> 10.0.0.2:443.
+        Bytes v4(40, 0);
+        v4[0] = 0x45;
+        v4[1] = static_cast<std::uint8_t>(46 << 2 | 1);
+        v4[3] = 40;
+        v4[9] = 6;
+        v4[12] = 10;
+        v4[15] = 1;
+        v4[16] = 10;
+        v4[19] = 2;
+        v4[20] = 0x04;
+        v4[21] = 0xD2;
+        v4[22] = 0x01;
+        v4[23] = 0xBB;
+        // IPv6: hop-by-hop (8) -> fragment (первый) -> UDP 53 -> 5353.
+        Bytes v6(40 + 8 + 8 + 8, 0);
+        v6[0] = 0x6B;
+        v6[1] = 0x80;
+        v6[5] = 24;
+        v6[6] = 0;
+        v6[8] = 0x20;
+        v6[24] = 0x20;
+        v6[40] = 44;
+        v6[48] = 17;
+        v6[56 + 1] = 53;
+        v6[56 + 2] = 0x14;
+        v6[56 + 3] = 0xE9;
+        Bytes v4_later = v4;   // Продолжение фрагмента: портов нет.
+        v4_later[7] = 1;
+        Bytes cut = v6;        // Цепочка обрезана до L4.
+        cut.resize(50);
+
+        const std::uint8_t *ptrs[] = {v4.data(), v6.data(), v4_later.data(), cut.data()};
+        const std::size_t   lens[] = {v4.size(), v6.size(), v4_later.size(), cut.size()};
+        PacketMeta          m(2);
+        Expect(m.Parse(ptrs, lens, 4) == 2 && m.Size() == 2 && m.Capacity() == 2, "fields: batch clipped to capacity");
+        PacketMeta meta;
+        meta.Parse(ptrs, lens, 4);
+
+        Expect(meta.Version(0) == 4 && meta.Proto(0) == 6 && meta.Dscp(0) == 46 && meta.Ecn(0) == 1 &&
+               meta.IpLength(0) == 40 && meta.L4Offset(0) == 20 && meta.SrcPort(0) == 1234 &&
+               meta.DstPort(0) == 443 && meta.Src(0)[11] == 0xFF && meta.Src(0)[15] == 1 && meta.Dst(0)[15] == 2 &&
+               meta.Flags(0) == (PacketMeta::kIpv4 | PacketMeta::kPorts),
+               "fields: IPv4 TCP");
+        Expect(meta.Version(1) == 6 && meta.NextHeader(1) == 0 && meta.Proto(1) == 17 && meta.Dscp(1) == 46 &&
+               meta.Ecn(1) == 0 && meta.IpLength(1) == 64 && meta.L4Offset(1) == 56 && meta.SrcPort(1) == 53 &&
+               meta.DstPort(1) == 5353 &&
+               meta.Flags(1) == (PacketMeta::kIpv6 | PacketMeta::kPorts | PacketMeta::kFragment),
+               "fields: IPv6 extension chain to UDP");
+        Expect(meta.Flags(2) == (PacketMeta::kIpv4 | PacketMeta::kFragment) && meta.L4Offset(2) == 0 &&
+               meta.SrcPort(2) == 0,
+               "fields: later IPv4 fragment has no ports");
+        Expect(meta.Flags(3) == PacketMeta::kIpv6 && meta.L4Offset(3) == 0, "fields: truncated chain has no L4");
+
+        bool threw = false;
+        try
+        {
+            PacketMeta zero(0);
+        }
+        catch (const std::invalid_argument &)
+        {
+            threw = true;
+        }
+        Expect(threw, "fields: zero capacity rejected");
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(72);
+    TestFields();
+    TestRandom(rng);
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("PacketMeta: OK (backend %s)\n", PacketMeta::Backend());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,448 @@
+// SegmenterTest.cpp — нарезка Segmenter: суперпакеты IPv4/IPv6 от 1 до 65423 байт данных с частичной и полной
+// суммой — верные суммы, seq, IP ID и флаги по правилам tcp_gso_segment, те же данные; досчёт частичной суммы
+// без нарезки (TCP, UDP с нулём), переполнение буфера, неверные описания; круг GRO -> TSO даёт исходные сегменты.
+
+#include "Core/Checksum.hpp"
+#include "Core/Gro.hpp"
+#include "Core/Headers.hpp"
+#include "Core/Segmenter.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using Bytes = std::vector<std::uint8_t>;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    constexpr std::uint8_t kFin = 0x01;
+    constexpr std::uint8_t kPsh = 0x08;
+    constexpr std::uint8_t kAck = 0x10;
+    constexpr std::uint8_t kEce = 0x40;
+    constexpr std::uint8_t kCwr = 0x80;
+
+    /// @brief Заголовок TCP с опцией timestamps.
+    constexpr std::size_t   kTcpHeader = 32;
+    constexpr std::uint16_t kGso       = 1448;
+
+    /**
+     * @brief Поля пакета TCP, которые меняются от пакета к пакету.
+     */
+    struct Spec
+    {
+        bool          v6 = false;
+        std::uint16_t sport = 40000;
+        std::uint32_t seq = 0;
+        std::uint16_t id = 0;
+        std::uint8_t  flags = kAck;
+    };
+
+    /// @brief Пакет TCP с данными data; сумма TCP — полная или, как у ядра, частичная (псевдозаголовок).
+    Bytes Tcp(const Spec &s, const Bytes &data, bool partial)
+    {
+        const std::size_t ip  = s.v6 ? 40 : 20;
+        const std::size_t len = ip + kTcpHeader + data.size();
+        Bytes             p(len, 0);
+        if (s.v6)
+        {
+            p[0] = 0x60;
+            Headers::Store16(&p[4], static_cast<std::uint16_t>(len - 40));
+            p[6] = Headers::kProtoTcp;
+            p[7] = 64;
+            p[8] = 0x20;
+            p[23] = 1;
+            p[24] = 0x20;
+            p[39] = 2;
+        }
+        else
+        {
+            p[0] = 0x45;
+            Headers::Store16(&p[2], static_cast<std::uint16_t>(len));
+            Headers::Store16(&p[4], s.id);
+            p[6] = 0x40;
+            p[8] = 64;
+            p[9] = Headers::kProtoTcp;
+            p[12] = 10;
+            p[15] = 1;
+            p[16] = 10;
+            p[19] = 2;
+            Headers::Store16(&p[10], Checksum::Finish(Checksum::Reference(p.data(), 20)));
+        }
+        std::uint8_t *t = &p[ip];
+        Headers::Store16(t, s.sport);
+        Headers::Store16(t + 2, 443);
+        Headers::Store32(t + 4, s.seq);
+        Headers::Store32(t + 8, 0x01020304);
+        t[12] = static_cast<std::uint8_t>(kTcpHeader / 4 << 4);
+        t[13] = s.flags;
+        Headers::Store16(t + 14, 502);
+        t[20] = 1;
+        t[21] = 1;
+        t[22] = 8;
+        t[23] = 10;
+        Headers::Store32(t + 24, 1000);
+        Headers::Store32(t + 28, 77);
+        if (!data.empty())
+        {
+            std::memcpy(t + kTcpHeader, data.data(), data.size());
+        }
+        const std::size_t   tcp_len = kTcpHeader + data.size();
+        const std::uint32_t pseudo  = Checksum::Pseudo(p.data(), Headers::kProtoTcp, tcp_len);
+        Headers::Store16(t + 16, partial ? static_cast<std::uint16_t>(pseudo)
+                                         : Checksum::Finish(Checksum::Reference(t, tcp_len, pseudo)));
+        return p;
+    }
+
+    std::size_t IpLen(const Bytes &p)
+    {
+        return (p[0] >> 4) == 6 ? 40 : static_cast<std::size_t>(p[0] & 0x0F) * 4;
+    }
+
+    /// @brief Длины и суммы IP и L4 сходятся с размером пакета.
+    bool Valid(const Bytes &p, std::uint8_t proto = Headers::kProtoTcp)
+    {
+        const std::size_t ip = IpLen(p);
+        if (ip == 40)
+        {
+            if (Headers::Load16(&p[4]) + 40u != p.size())
+            {
+                return false;
+            }
+        }
+        else if (Headers::Load16(&p[2]) != p.size() || Checksum::Reference(p.data(), ip) != 0xFFFF)
+        {
+            return false;
+        }
+        const std::size_t l4_len = p.size() - ip;
+        return Checksum::Reference(&p[ip], l4_len, Checksum::Pseudo(p.data(), proto, l4_len)) == 0xFFFF;
+    }
+
+    Bytes Random(std::size_t n, std::mt19937_64 &rng)
+    {
+        Bytes b(n);
+        for (auto &x : b)
+        {
+            x = static_cast<std::uint8_t>(rng());
+        }
+        return b;
+    }
+
+    /// @brief Все сегменты загруженного пакета.
+    std::vector<Bytes> Drain(Segmenter &seg, std::size_t size = 65536)
+    {
+        std::vector<Bytes> out;
+        Bytes              buf(size);
+        while (seg.Pending())
+        {
+            const std::size_t n = seg.Next(buf.data(), buf.size());
+            if (n == 0)
+            {
+                break;
+            }
+            out.emplace_back(buf.begin(), buf.begin() + static_cast<std::ptrdiff_t>(n));
+        }
+        return out;
+    }
+
+    /**
+     * @brief Суперпакеты с 1..65423 байтами данных: каждый сегмент по правилам tcp_gso_segment.
+     */
+    void TestSuperPackets(std::mt19937_64 &rng)
+    {
+        std::vector<std::size_t> sizes = {1, 100, kGso - 1u, kGso, kGso + 1u, 2u * kGso, 10000, 65423};
+        for (int i = 0; i < 40; ++i)
+        {
+            sizes.push_back(1 + rng() % 65423);
+        }
+        Segmenter seg;
+        bool      valid = true, seq = true, id = true, flags = true, data = true, count = true;
+        for (const bool v6 : {false, true})
+        {
+            for (const bool partial : {true, false})
+            {
+                for (const std::size_t n : sizes)
+                {
+                    Spec s;
+                    s.v6    = v6;
+                    s.seq   = static_cast<std::uint32_t>(rng());
+                    s.id    = static_cast<std::uint16_t>(rng());
+                    s.flags = static_cast<std::uint8_t>(kAck | (rng() % 2 != 0 ? kPsh : 0) | (rng() % 4 == 0 ? kFin : 0) |
+                                                        (rng() % 4 == 0 ? kCwr | kEce : 0));
+                    const Bytes payload = Random(n, rng);
+                    const Bytes super   = Tcp(s, payload, partial);
+                    const auto  ip      = static_cast<std::uint16_t>(IpLen(super));
+
+                    Segmenter::Offload off;
+                    off.gso_size    = kGso;
+                    off.partial     = partial;
+                    off.csum_start  = ip;
+                    off.csum_offset = 16;
+                    Expect(seg.Load(super.data(), super.size(), off), "super: loads");
+                    const unsigned          want = static_cast<unsigned>((n + kGso - 1) / kGso);
+                    const std::vector<Bytes> out = Drain(seg);
+                    count &= seg.Count() == want && out.size() == want;
+
+                    Bytes joined;
+                    for (std::size_t k = 0; k < out.size(); ++k)
+                    {
+                        const Bytes  &o    = out[k];
+                        const bool    last = k + 1 == out.size();
+                        std::uint8_t  want_flags = s.flags;
+                        if (!last && want > 1)
+                        {
+                            want_flags = static_cast<std::uint8_t>(want_flags & ~(kFin | kPsh));
+                        }
+                        if (k != 0)
+                        {
+                            want_flags = static_cast<std::uint8_t>(want_flags & ~kCwr);
+                        }
+                        valid &= Valid(o) && (last || o.size() == ip + kTcpHeader + kGso);
+                        seq   &= Headers::Load32(&o[ip + 4]) == s.seq + static_cast<std::uint32_t>(k * kGso);
+                        id    &= v6 || Headers::Load16(&o[4]) == static_cast<std::uint16_t>(s.id + k);
+                        flags &= o[ip + 13] == want_flags;
+                        // Заголовки, кроме длины, ID, сумм, seq и флагов, — как у суперпакета.
+                        data &= std::memcmp(&o[ip + 8], &super[ip + 8], 5) == 0 &&
+                                std::memcmp(&o[ip + 14], &super[ip + 14], 2) == 0 &&
+                                std::memcmp(&o[ip + 18], &super[ip + 18], kTcpHeader - 18) == 0;
+                        joined.insert(joined.end(), o.begin() + static_cast<std::ptrdiff_t>(ip + kTcpHeader), o.end());
+                    }
+                    data &= joined == payload;
+                }
+            }
+        }
+        Expect(count, "super: Count() and segments match ceil(payload / gso_size)");
+        Expect(valid, "super: every segment has valid IP/TCP checksums and full size but the last");
+        Expect(seq, "super: seq advances by the payload offset");
+        Expect(id, "super: IPv4 ID increments per segment");
+        Expect(flags, "super: FIN/PSH only on the last segment, CWR only on the first");
+        Expect(data, "super: headers kept and payload concatenates to the input");
+    }
+
+    /// @brief UDP с частичной суммой; adjust — подобрать два байта данных так, чтобы сумма вышла нулевой.
+    Bytes Udp(std::size_t n, bool zero_sum, std::mt19937_64 &rng)
+    {
+        Bytes p(20 + 8 + n, 0);
+        p[0] = 0x45;
+        Headers::Store16(&p[2], static_cast<std::uint16_t>(p.size()));
+        p[8] = 64;
+        p[9] = Headers::kProtoUdp;
+        p[12] = 10;
+        p[15] = 1;
+        p[16] = 10;
+        p[19] = 2;
+        Headers::Store16(&p[10], Checksum::Finish(Checksum::Reference(p.data(), 20)));
+        Headers::Store16(&p[20], 5000);
+        Headers::Store16(&p[22], 53);
+        Headers::Store16(&p[24], static_cast<std::uint16_t>(8 + n));
+        for (std::size_t i = 28; i < p.size(); ++i)
+        {
+            p[i] = static_cast<std::uint8_t>(rng());
+        }
+        const std::uint32_t pseudo = Checksum::Pseudo(p.data(), Headers::kProtoUdp, 8 + n);
+        if (zero_sum)
+        {
+            // Слово в начале данных — дополнение суммы остального: полная сумма 0xFFFF, поле — 0.
+            p[28] = 0;
+            p[29] = 0;
+            Headers::Store16(&p[28], Checksum::Finish(Checksum::Reference(&p[20], 8 + n, pseudo)));
+        }
+        Headers::Store16(&p[26], static_cast<std::uint16_t>(pseudo));
+        return p;
+    }
+
+    /// @brief Пакеты без нарезки: частичная сумма досчитывается; переполнение; неверные описания.
+    void TestWholeAndErrors(std::mt19937_64 &rng)
+    {
+        Segmenter seg;
+
+        // TCP с данными не длиннее сегмента и без gso_size.
+        for (const std::uint16_t gso : {std::uint16_t{0}, kGso})
+        {
+            Spec s;
+            const Bytes p = Tcp(s, Random(500, rng), true);
+            Segmenter::Offload off;
+            off.gso_size    = gso;
+            off.partial     = true;
+            off.csum_start  = 20;
+            off.csum_offset = 16;
+            Expect(seg.Load(p.data(), p.size(), off) && seg.Count() == 1, "whole: single packet");
+            const std::vector<Bytes> out = Drain(seg);
+            Expect(out.size() == 1 && Valid(out[0]), "whole: partial TCP checksum completed");
+        }
+
+        // UDP: обычная сумма и сумма, вышедшая нулём (в поле — 0xFFFF).
+        for (const bool zero : {false, true})
+        {
+            const Bytes p = Udp(301, zero, rng);
+            Segmenter::Offload off;
+            off.partial     = true;
+            off.csum_start  = 20;
+            off.csum_offset = 6;
+            Expect(seg.Load(p.data(), p.size(), off), "whole: UDP loads");
+            const std::vector<Bytes> out = Drain(seg);
+            Expect(out.size() == 1 && Valid(out[0], Headers::kProtoUdp), "whole: partial UDP checksum completed");
+            if (zero && out.size() == 1)
+            {
+                Expect(Headers::Load16(&out[0][26]) == 0xFFFF, "whole: zero UDP checksum sent as 0xFFFF");
+            }
+        }
+        Expect(seg.GetStats().csum == 4, "whole: completed checksums counted");
+
+        // Буфер меньше сегмента: ноль, остаток отброшен.
+        {
+            Spec s;
+            const Bytes p = Tcp(s, Random(5000, rng), false);
+            Segmenter::Offload off;
+            off.gso_size = kGso;
+            Expect(seg.Load(p.data(), p.size(), off) && seg.Count() == 4, "oversize: loads");
+            Bytes buf(1000);
+            Expect(seg.Next(buf.data(), buf.size()) == 0 && !seg.Pending() && seg.GetStats().oversize == 1,
+                   "oversize: segment longer than the buffer is dropped with the rest");
+            Expect(seg.Load(p.data(), p.size(), off) && Drain(seg, 1500).size() == 4, "oversize: MTU buffer is enough");
+        }
+
+        // Неверные описания и заголовки.
+        {
+            Spec        s;
+            const Bytes tcp4 = Tcp(s, Random(3000, rng), true);
+            s.v6 = true;
+            const Bytes tcp6 = Tcp(s, Random(3000, rng), true);
+            const Bytes udp  = Udp(3000, false, rng);
+
+            Segmenter::Offload off;
+            off.gso_size    = kGso;
+            off.partial     = true;
+            off.csum_start  = 20;
+            off.csum_offset = 16;
+            const std::uint64_t before = seg.GetStats().malformed;
+            int                 rejected = 0;
+            rejected += !seg.Load(udp.data(), udp.size(), off);              // Нарезка не TCP.
+            rejected += !seg.Load(tcp4.data(), 19, off);                     // Короче заголовка IP.
+            Segmenter::Offload far = off;
+            far.csum_start = static_cast<std::uint16_t>(tcp4.size());
+            rejected += !seg.Load(tcp4.data(), tcp4.size(), far);             // Поле суммы за пакетом.
+            Segmenter::Offload moved = off;
+            moved.csum_start = 24;
+            rejected += !seg.Load(tcp4.data(), tcp4.size(), moved);           // TCP не там, где заголовок IPv4.
+            Segmenter::Offload inside = off;
+            inside.csum_start = 32;
+            rejected += !seg.Load(tcp6.data(), tcp6.size(), inside);          // TCP внутри заголовка IPv6.
+            Bytes bad_doff = tcp4;
+            bad_doff[20 + 12] = 0x40;
+            rejected += !seg.Load(bad_doff.data(), bad_doff.size(), off);     // Длина заголовка TCP меньше 20.
+            Bytes junk = tcp4;
+            junk[0] = 0x00;
+            rejected += !seg.Load(junk.data(), junk.size(), off);             // Не IP.
+            Expect(rejected == 7 && seg.GetStats().malformed == before + 7 && !seg.Pending(),
+                   "malformed: bad descriptions rejected and counted");
+        }
+    }
+
+    /**
+     * @brief Круг GRO -> TSO: сегменты нескольких потоков склеиваются Gro с частичной суммой, склеенное
+     * режется Segmenter по описанию Gro — и получаются побайтно исходные сегменты каждого потока.
+     */
+    void TestRoundTrip(std::mt19937_64 &rng)
+    {
+        std::map<std::uint16_t, std::vector<Bytes>> sent, got;
+        Segmenter seg;
+        unsigned  supers = 0;
+
+        Gro::Options opts;
+        opts.partial_csum = true;
+        opts.flows        = 3;
+        Gro gro(opts, [&](const Gro::Packet &p) {
+            Segmenter::Offload off;
+            if (p.segments > 1)
+            {
+                off.gso_size    = p.gso_size;
+                off.csum_start  = p.csum_start;
+                off.csum_offset = 16;
+                off.partial     = true;
+                ++supers;
+            }
+            if (!seg.Load(p.data, p.len, off))
+            {
+                Expect(false, "round trip: Gro output loads into Segmenter");
+                return;
+            }
+            for (Bytes &b : Drain(seg, 2048))
+            {
+                const std::uint16_t port = Headers::Load16(&b[IpLen(b)]);
+                got[port].push_back(std::move(b));
+            }
+        });
+
+        std::vector<Spec> flows(5);
+        for (std::size_t i = 0; i < flows.size(); ++i)
+        {
+            flows[i].v6    = i % 2 != 0;
+            flows[i].sport = static_cast<std::uint16_t>(50000 + i);
+            flows[i].seq   = static_cast<std::uint32_t>(rng());
+            flows[i].id    = static_cast<std::uint16_t>(rng());
+        }
+        auto now = Gro::Clock::now();
+        for (int train = 0; train < 2000; ++train)
+        {
+            Spec          &f   = flows[rng() % flows.size()];
+            const unsigned len = 1 + static_cast<unsigned>(rng() % 60);
+            for (unsigned k = 0; k < len; ++k)
+            {
+                const bool  last = k + 1 == len;
+                std::size_t n    = kGso;
+                f.flags          = kAck;
+                if (last && rng() % 2 == 0)
+                {
+                    // Хвост поезда: короткий сегмент и/или PSH.
+                    n       = 1 + rng() % kGso;
+                    f.flags = static_cast<std::uint8_t>(kAck | (rng() % 2 != 0 ? kPsh : 0));
+                }
+                const Bytes s = Tcp(f, Random(n, rng), false);
+                sent[f.sport].push_back(s);
+                f.seq += static_cast<std::uint32_t>(n);
+                ++f.id;
+                now += std::chrono::microseconds(5);
+                if (!gro.Push(s.data(), s.size(), now))
+                {
+                    got[f.sport].push_back(s);
+                }
+            }
+            gro.Poll(now);
+        }
+        gro.Flush();
+        Expect(supers > 0, "round trip: trains were merged");
+        Expect(got == sent, "round trip: GRO then TSO reproduces the original segments byte for byte");
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(70);
+    TestSuperPackets(rng);
+    TestWholeAndErrors(rng);
+    TestRoundTrip(rng);
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("Segmenter: OK\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,364 @@
+// TimerServiceTest.cpp — TimerService на виртуальных часах против упорядоченного эталона: случайные сроки
+// на всех уровнях колеса, снятие и перестановка из колбэков, переход через границы уровней, периодические
+// таймеры, устаревшие дескрипторы; на реальных часах — ни одного раннего срабатывания и CancelWait.
+
+#include "Core/TimerService.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Clock  = TimerService::Clock;
+    using Handle = TimerService::Handle;
+
+    int failures = 0;
+
+    void Expect(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    TimerService::Options Virtual(std::size_t capacity)
+    {
+        TimerService::Options o;
+        o.tick          = 1ms;
+        o.capacity      = capacity;
+        o.virtual_clock = true;
+        return o;
+    }
+
+    /**
+     * @brief Эталон: поставленные таймеры со сроками в шагах.
+     *
+     * Колбэк обязан прийти ровно в свой шаг и не раньше любого другого поставленного таймера;
+     * порядок внутри одного шага не проверяется.
+     */
+    struct Reference
+    {
+        std::map<Handle, std::uint64_t>             deadline;
+        std::set<std::pair<std::uint64_t, Handle>>  order;
+
+        void Add(Handle h, std::uint64_t at)
+        {
+            deadline[h] = at;
+            order.emplace(at, h);
+        }
+
+        bool Remove(Handle h)
+        {
+            const auto it = deadline.find(h);
+            if (it == deadline.end())
+            {
+                return false;
+            }
+            order.erase({it->second, h});
+            deadline.erase(it);
+            return true;
+        }
+    };
+
+    /// @brief Задержка от 1 шага до 2^33 (≈ 99 суток): равномерно по порядку величины, все уровни колеса.
+    std::uint64_t RandomDelay(std::mt19937_64 &rng)
+    {
+        const unsigned bits = static_cast<unsigned>(rng() % 34);
+        return 1 + (bits == 0 ? 0 : rng() % (std::uint64_t{1} << bits));
+    }
+
+    /**
+     * @brief 10 000 случайных таймеров; колбэки снимают, переставляют и ставят таймеры (в т.ч. уже
+     * отработавшие и свои), те же действия — между Advance. Каждое срабатывание сверяется с эталоном.
+     */
+    void TestRandomAgainstReference(std::mt19937_64 &rng)
+    {
+        TimerService     svc(Virtual(16384));
+        const auto       epoch = svc.Now();
+        Reference        ref;
+        std::vector<Handle> issued;
+        std::uint64_t    fired = 0;
+        bool             on_time = true, in_order = true, known = true, returns = true;
+
+        auto now_tick = [&] { return static_cast<std::uint64_t>((svc.Now() - epoch) / 1ms); };
+
+        std::function<void(Handle)> on_fire;
+        auto arm = [&](std::uint64_t delay) {
+            const std::uint64_t at = now_tick() + delay;
+            auto                h  = std::make_shared<Handle>(TimerService::kNoTimer);
+            *h = svc.After(std::chrono::milliseconds(delay), [&, h] { on_fire(*h); });
+            ref.Add(*h, at);
+            issued.push_back(*h);
+        };
+        // Одно случайное действие над случайным когда-либо выданным дескриптором.
+        auto mutate = [&] {
+            const unsigned op = static_cast<unsigned>(rng() % 10);
+            if (op < 3)
+            {
+                arm(RandomDelay(rng));
+            }
+            else if (op < 5 && !issued.empty())
+            {
+                const Handle h = issued[rng() % issued.size()];
+                returns &= svc.Cancel(h) == ref.Remove(h);
+            }
+            else if (op < 7 && !issued.empty())
+            {
+                const Handle        h     = issued[rng() % issued.size()];
+                const std::uint64_t delay = RandomDelay(rng);
+                const bool          armed = ref.Remove(h);
+                if (armed)
+                {
+                    ref.Add(h, now_tick() + delay);
+                }
+                returns &= svc.Restart(h, std::chrono::milliseconds(delay)) == armed;
+            }
+        };
+        on_fire = [&](Handle self) {
+            ++fired;
+            const std::uint64_t t  = now_tick();
+            const auto          it = ref.deadline.find(self);
+            if (it == ref.deadline.end())
+            {
+                known = false;
+                return;
+            }
+            on_time  &= it->second == t;
+            in_order &= ref.order.begin()->first == t;
+            ref.Remove(self);
+            // Свой дескриптор в колбэке уже не снимается и не переставляется.
+            returns &= !svc.Cancel(self) && !svc.Restart(self, 1ms);
+            if (rng() % 2 == 0)
+            {
+                mutate();
+            }
+        };
+
+        for (int i = 0; i < 10000; ++i)
+        {
+            arm(RandomDelay(rng));
+        }
+        std::size_t calls = 0;
+        int         rounds = 0;
+        while (!ref.deadline.empty() && rounds < 100000)
+        {
+            ++rounds;
+            const std::uint64_t before = fired;
+            const unsigned      bits   = static_cast<unsigned>(rng() % 31);
+            calls += svc.Advance(std::chrono::milliseconds(1 + rng() % (std::uint64_t{1} << bits)));
+            Expect(calls == fired && fired >= before, "random: Advance returns the number of callbacks");
+            mutate();
+        }
+        Expect(on_time, "random: every timer fires exactly at its rounded deadline");
+        Expect(in_order, "random: no timer fires before an earlier pending one");
+        Expect(known, "random: only armed timers fire");
+        Expect(returns, "random: Cancel/Restart report whether the timer was armed");
+        Expect(ref.deadline.empty() && svc.Pending() == 0, "random: everything fired or was cancelled");
+        Expect(fired > 10000 / 2, "random: most timers fired");
+    }
+
+    /// @brief Сроки по обе стороны границ уровней (256, 2^16, 2^24, 2^32 шагов) и 60 суток вперёд.
+    void TestLevelBoundaries()
+    {
+        const std::uint64_t edges[] = {255, 256, 257, 65535, 65536, 65537,
+                                       (1u << 24) - 1, 1u << 24, (1u << 24) + 1,
+                                       (std::uint64_t{1} << 32) - 1, std::uint64_t{1} << 32,
+                                       (std::uint64_t{1} << 32) + 1, 60ull * 86400 * 1000};
+
+        // Одним большим Advance: порядок по срокам сохраняется при каскаде.
+        {
+            TimerService               svc(Virtual(64));
+            const auto                 epoch = svc.Now();
+            std::vector<std::uint64_t> seen;
+            for (const std::uint64_t at : edges)
+            {
+                svc.After(std::chrono::milliseconds(at), [&] {
+                    seen.push_back(static_cast<std::uint64_t>((svc.Now() - epoch) / 1ms));
+                });
+            }
+            svc.Advance(std::chrono::milliseconds(edges[std::size(edges) - 1] + 1000));
+            Expect(seen == std::vector<std::uint64_t>(std::begin(edges), std::end(edges)),
+                   "levels: single Advance fires at each boundary deadline in order");
+        }
+        // До срока без одного шага — тишина, ещё шаг — срабатывание.
+        {
+            TimerService svc(Virtual(64));
+            int          count = 0;
+            for (const std::uint64_t at : edges)
+            {
+                svc.After(std::chrono::milliseconds(at), [&] { ++count; });
+            }
+            bool          exact = true;
+            std::uint64_t now   = 0;
+            int           want  = 0;
+            for (const std::uint64_t at : edges)
+            {
+                svc.Advance(std::chrono::milliseconds(at - 1 - now));
+                exact &= count == want;
+                svc.Advance(1ms);
+                exact &= count == ++want;
+                now = at;
+            }
+            Expect(exact, "levels: never early, never late across cascades");
+        }
+    }
+
+    /// @brief Периодический таймер: пропущенные периоды отдаются по порядку, снятие из своего колбэка.
+    void TestPeriodic()
+    {
+        TimerService               svc(Virtual(16));
+        const auto                 epoch = svc.Now();
+        std::vector<std::uint64_t> ticks;
+        Handle                     h = TimerService::kNoTimer;
+        h = svc.Every(7ms, [&] {
+            ticks.push_back(static_cast<std::uint64_t>((svc.Now() - epoch) / 1ms));
+            if (ticks.size() == 5)
+            {
+                Expect(svc.Cancel(h), "periodic: Cancel from own callback succeeds");
+            }
+        });
+        Expect(svc.Advance(30ms) == 4, "periodic: four periods in 30 ms");
+        Expect(svc.Advance(100ms) == 1, "periodic: stops after Cancel in the callback");
+        Expect(ticks == std::vector<std::uint64_t>{7, 14, 21, 28, 35}, "periodic: phase kept");
+        Expect(svc.Pending() == 0 && !svc.Cancel(h), "periodic: slot released");
+
+        bool threw = false;
+        try
+        {
+            svc.Every(0ms, [] {});
+        }
+        catch (const std::invalid_argument &)
+        {
+            threw = true;
+        }
+        Expect(threw, "periodic: zero period rejected");
+    }
+
+    /// @brief Дескрипторы переиспользованных слотов, ёмкость, исключения в колбэках, Stop.
+    void TestHandles()
+    {
+        TimerService svc(Virtual(2));
+        int          a = 0, b = 0;
+        const Handle first = svc.After(1ms, [&] { ++a; });
+        svc.Advance(1ms);
+        const Handle second = svc.After(1ms, [&] { ++b; });
+        Expect(!svc.Cancel(first) && !svc.Restart(first, 5ms), "handles: fired handle is stale");
+        svc.Advance(1ms);
+        Expect(a == 1 && b == 1, "handles: stale handle does not touch the reused slot");
+        (void)second;
+
+        svc.After(1ms, [] { throw std::runtime_error("boom"); });
+        svc.After(1ms, [&] { ++a; });
+        bool full = false;
+        try
+        {
+            svc.After(1ms, [] {});
+        }
+        catch (const std::length_error &)
+        {
+            full = true;
+        }
+        Expect(full, "handles: capacity exhausted throws length_error");
+        Expect(svc.Advance(1ms) == 2 && a == 2, "handles: throwing callback does not stop the batch");
+
+        svc.Stop();
+        Expect(svc.After(1ms, [] {}) == TimerService::kNoTimer, "handles: After after Stop returns kNoTimer");
+
+        bool bad = false;
+        try
+        {
+            TimerService::Options o = Virtual(0);
+            TimerService          broken(o);
+        }
+        catch (const std::invalid_argument &)
+        {
+            bad = true;
+        }
+        Expect(bad, "handles: zero capacity rejected");
+    }
+
+    /// @brief Реальные часы: ни одного раннего срабатывания; CancelWait дожидается идущего колбэка.
+    void TestRealClock(std::mt19937_64 &rng)
+    {
+        TimerService              svc(TimerService::Options{});
+        constexpr int             kTimers = 500;
+        std::atomic<int>          done{0};
+        std::atomic<bool>         early{false};
+        for (int i = 0; i < kTimers; ++i)
+        {
+            const auto delay = std::chrono::milliseconds(1 + rng() % 30);
+            const auto due   = Clock::now() + delay;
+            svc.After(delay, [&, due] {
+                if (Clock::now() < due)
+                {
+                    early = true;
+                }
+                ++done;
+            });
+        }
+        const auto limit = Clock::now() + 5s;
+        while (done < kTimers && Clock::now() < limit)
+        {
+            std::this_thread::sleep_for(1ms);
+        }
+        Expect(done == kTimers, "real: all timers fired");
+        Expect(!early, "real: no timer fired early");
+
+        std::atomic<bool> started{false}, finished{false};
+        const Handle      slow = svc.After(1ms, [&] {
+            started = true;
+            std::this_thread::sleep_for(50ms);
+            finished = true;
+        });
+        while (!started && Clock::now() < limit + 5s)
+        {
+            std::this_thread::sleep_for(1ms);
+        }
+        svc.CancelWait(slow);
+        Expect(started && finished, "real: CancelWait waits for the running callback");
+
+        bool logic = false;
+        try
+        {
+            svc.Advance(1ms);
+        }
+        catch (const std::logic_error &)
+        {
+            logic = true;
+        }
+        Expect(logic, "real: Advance rejected without virtual clock");
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(65);
+    TestRandomAgainstReference(rng);
+    TestLevelBoundaries();
+    TestPeriodic();
+    TestHandles();
+    TestRealClock(rng);
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("TimerService: OK\n");
+    return EXIT_SUCCESS;
+}